@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "audio_capture.h"
+
+#define cap_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define cap_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+void audio_capture_init(audio_capture_t *c, int16_t *buf, uint32_t period, void (*notify)(void *arg), void *arg)
+{
+    memset(c, 0, sizeof(*c));
+    c->buf = buf;
+    c->period = period;
+    c->notify = notify;
+    c->notify_arg = arg;
+}
+
+void audio_capture_write(audio_capture_t *c, const int16_t *samples, uint32_t n, uint32_t now_ms)
+{
+    while (n) {
+        uint32_t slot = c->filled % AUDIO_CAPTURE_BUFS;
+
+        /* a period gets its buffer when it starts, or is lost as a whole */
+        if (0 == c->fill) {
+            c->skipping = c->filled - cap_load(&c->taken) >= AUDIO_CAPTURE_BUFS;
+        }
+        uint32_t len = c->period - c->fill < n ? c->period - c->fill : n;
+        if (!c->skipping) {
+            memcpy(c->buf + slot * c->period + c->fill, samples, len * sizeof(int16_t));
+        }
+        c->fill += len;
+        samples += len;
+        n -= len;
+        if (c->fill < c->period) {
+            break;
+        }
+
+        c->periods++;
+        if (c->skipping) {
+            c->lost++;
+        } else {
+            audio_period_t *p = &c->per[slot];
+            p->pcm = c->buf + slot * c->period;
+            p->seq = c->seq;
+            p->sample = (uint64_t)c->seq * c->period;
+            p->ts_ms = now_ms;
+            cap_store(&c->filled, c->filled + 1);
+            if (c->notify) {
+                c->notify(c->notify_arg);
+            }
+        }
+        c->seq++;
+        c->fill = 0;
+    }
+}
+
+const audio_period_t *audio_capture_take(audio_capture_t *c)
+{
+    uint32_t taken = c->taken;
+
+    if (cap_load(&c->filled) == taken) {
+        return NULL;
+    }
+    return &c->per[taken % AUDIO_CAPTURE_BUFS];
+}
+
+void audio_capture_release(audio_capture_t *c)
+{
+    cap_store(&c->taken, c->taken + 1);
+}
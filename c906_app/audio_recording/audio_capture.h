@@ -0,0 +1,62 @@
+#ifndef __AUDIO_CAPTURE_H__
+#define __AUDIO_CAPTURE_H__
+
+#include <stdint.h>
+
+/*
+ * Period based capture between the audio backend and the task processing
+ * the audio. The backend writes samples as they come in whatever pieces the
+ * hardware has (audio_capture_write(), it never waits and may run in an
+ * interrupt or timer context); every full period is handed over in one of
+ * two buffers and the backend calls notify() once, the task sleeps until
+ * then instead of polling:
+ *
+ *   backend   audio_capture_write()    fills a period, notify() when full
+ *   task      audio_capture_take()     oldest full period, or NULL
+ *   task      audio_capture_release()  done, the buffer is the backend's again
+ *
+ * With two buffers the task has a whole period of time to release one
+ * before the backend needs it again. If it is later than that, the period
+ * the backend starts has nowhere to go: it is counted as lost and skipped,
+ * and the next one handed over carries the gap in its seq and first sample.
+ * Nothing is ever overwritten while the task holds it.
+ */
+
+#define AUDIO_CAPTURE_BUFS (2)
+
+typedef struct {
+    const int16_t *pcm; /* period samples */
+    uint32_t seq;       /* periods since the start, lost ones included */
+    uint64_t sample;    /* index of pcm[0] in the stream */
+    uint32_t ts_ms;     /* backend's clock when the period filled */
+} audio_period_t;
+
+typedef struct {
+    int16_t *buf; /* AUDIO_CAPTURE_BUFS * period samples */
+    uint32_t period;
+    void (*notify)(void *arg); /* from the backend, a period is ready */
+    void *notify_arg;
+
+    audio_period_t per[AUDIO_CAPTURE_BUFS];
+    volatile uint32_t filled; /* backend: periods handed over, ever */
+    volatile uint32_t taken;  /* task: periods released, ever */
+
+    /* backend side */
+    uint32_t fill;    /* samples in the current period */
+    uint32_t seq;     /* of the current period */
+    int skipping;     /* current period has no buffer, it's lost */
+    uint32_t periods; /* completed, handed over or not */
+    uint32_t lost;    /* completed without a buffer */
+} audio_capture_t;
+
+/* buf holds AUDIO_CAPTURE_BUFS * period samples. notify may be NULL to poll. */
+void audio_capture_init(audio_capture_t *c, int16_t *buf, uint32_t period, void (*notify)(void *arg), void *arg);
+
+/* Backend: n samples that arrived at now_ms. */
+void audio_capture_write(audio_capture_t *c, const int16_t *samples, uint32_t n, uint32_t now_ms);
+
+/* Task: the oldest full period, valid until audio_capture_release(), or NULL. */
+const audio_period_t *audio_capture_take(audio_capture_t *c);
+void audio_capture_release(audio_capture_t *c);
+
+#endif /* __AUDIO_CAPTURE_H__ */
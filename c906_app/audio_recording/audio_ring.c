@@ -0,0 +1,55 @@
+#include <string.h>
+
+#include "audio_ring.h"
+
+#define ring_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ring_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+int audio_ring_init(audio_ring_t *r, int16_t *buf, uint32_t size)
+{
+    if (0 == size || (size & (size - 1))) {
+        return -1;
+    }
+    memset(r, 0, sizeof(*r));
+    r->buf = buf;
+    r->size = size;
+    return 0;
+}
+
+uint32_t audio_ring_used(audio_ring_t *r)
+{
+    return ring_load(&r->head) - ring_load(&r->tail);
+}
+
+uint32_t audio_ring_write(audio_ring_t *r, const int16_t *samples, uint32_t n)
+{
+    uint32_t head = r->head;
+    uint32_t room = r->size - (head - ring_load(&r->tail));
+    uint32_t todo = n < room ? n : room;
+    uint32_t off = head & (r->size - 1);
+    uint32_t first = todo < r->size - off ? todo : r->size - off;
+
+    memcpy(r->buf + off, samples, first * sizeof(int16_t));
+    memcpy(r->buf, samples + first, (todo - first) * sizeof(int16_t));
+    ring_store(&r->head, head + todo);
+
+    if (todo < n) {
+        r->overruns++;
+        r->dropped += n - todo;
+    }
+    return todo;
+}
+
+uint32_t audio_ring_read(audio_ring_t *r, int16_t *out, uint32_t max)
+{
+    uint32_t tail = r->tail;
+    uint32_t avail = ring_load(&r->head) - tail;
+    uint32_t todo = max < avail ? max : avail;
+    uint32_t off = tail & (r->size - 1);
+    uint32_t first = todo < r->size - off ? todo : r->size - off;
+
+    memcpy(out, r->buf + off, first * sizeof(int16_t));
+    memcpy(out + first, r->buf, (todo - first) * sizeof(int16_t));
+    ring_store(&r->tail, tail + todo);
+    return todo;
+}
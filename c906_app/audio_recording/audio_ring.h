@@ -0,0 +1,39 @@
+#ifndef __AUDIO_RING_H__
+#define __AUDIO_RING_H__
+
+#include <stdint.h>
+
+/*
+ * Single producer / single consumer ring of 16 bit samples. The producer is
+ * whatever receives the audio buffers, the consumer the task writing them
+ * out; neither ever waits for the other and no lock is taken, each side
+ * only writes its own index.
+ *
+ * When the consumer falls behind, the producer keeps what fits and drops
+ * the rest of the buffer (it can't move the read index): one overrun, and
+ * the lost samples are counted so the gap in the recording is known.
+ */
+
+typedef struct {
+    int16_t *buf;
+    uint32_t size;          /* samples, power of 2 */
+    volatile uint32_t head; /* producer: samples written, ever */
+    volatile uint32_t tail; /* consumer: samples read, ever */
+
+    /* producer side */
+    uint32_t overruns;
+    uint32_t dropped; /* samples */
+} audio_ring_t;
+
+/* size must be a power of 2. Returns 0 or -1. */
+int audio_ring_init(audio_ring_t *r, int16_t *buf, uint32_t size);
+
+/* Producer: copies up to n samples in. Returns how many fit, the rest is dropped and counted. */
+uint32_t audio_ring_write(audio_ring_t *r, const int16_t *samples, uint32_t n);
+
+/* Consumer: copies up to max samples out. Returns how many. */
+uint32_t audio_ring_read(audio_ring_t *r, int16_t *out, uint32_t max);
+
+uint32_t audio_ring_used(audio_ring_t *r);
+
+#endif /* __AUDIO_RING_H__ */
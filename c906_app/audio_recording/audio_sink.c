@@ -0,0 +1,32 @@
+#include "audio_sink.h"
+
+void audio_sink_init(audio_sink_t *s, audio_ring_t *ring, wav_writer_t *wav, uint32_t starve_ms, uint32_t now_ms)
+{
+    s->ring = ring;
+    s->wav = wav;
+    s->starve_ms = starve_ms;
+    s->last_data_ms = now_ms;
+    s->starved = 0;
+    s->underruns = 0;
+    s->samples = 0;
+}
+
+int audio_sink_step(audio_sink_t *s, uint32_t now_ms, int16_t *block, uint32_t block_n)
+{
+    uint32_t n = audio_ring_read(s->ring, block, block_n);
+
+    if (0 == n) {
+        if (!s->starved && now_ms - s->last_data_ms >= s->starve_ms) {
+            s->starved = 1;
+            s->underruns++;
+        }
+        return 0;
+    }
+    s->last_data_ms = now_ms;
+    s->starved = 0;
+    if (0 != wav_write(s->wav, block, n)) {
+        return -1;
+    }
+    s->samples += n;
+    return n;
+}
@@ -0,0 +1,33 @@
+#ifndef __AUDIO_SINK_H__
+#define __AUDIO_SINK_H__
+
+#include <stdint.h>
+
+#include "audio_ring.h"
+#include "wav_writer.h"
+
+/*
+ * Consumer side of the capture ring: moves samples into the WAV file a
+ * block at a time and notices when the source stops delivering. An
+ * underrun is counted once per stretch of starve_ms or more with the ring
+ * empty, which with a steady source means the driver stopped handing over
+ * buffers, not that the writer was early.
+ */
+
+typedef struct {
+    audio_ring_t *ring;
+    wav_writer_t *wav;
+    uint32_t starve_ms;
+
+    uint32_t last_data_ms;
+    int starved;
+    uint32_t underruns;
+    uint32_t samples; /* written to the file */
+} audio_sink_t;
+
+void audio_sink_init(audio_sink_t *s, audio_ring_t *ring, wav_writer_t *wav, uint32_t starve_ms, uint32_t now_ms);
+
+/* One pass with a scratch block of block_n samples. Returns the samples written, or -1 on a write error. */
+int audio_sink_step(audio_sink_t *s, uint32_t now_ms, int16_t *block, uint32_t block_n);
+
+#endif /* __AUDIO_SINK_H__ */
@@ -0,0 +1,40 @@
+#include "audio_synth.h"
+
+/* a quarter of a sine, 64 steps, full scale */
+static const int16_t s_quarter[65] = {
+    0,     804,   1608,  2410,  3212,  4011,  4808,  5602,  6393,  7179,  7962,  8739,  9512,
+    10278, 11039, 11793, 12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530, 18204, 18868,
+    19519, 20159, 20787, 21403, 22005, 22594, 23170, 23731, 24279, 24811, 25329, 25832, 26319,
+    26790, 27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956, 30273, 30571, 30852, 31113,
+    31356, 31580, 31785, 31971, 32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757, 32767,
+};
+
+static int16_t sine(uint32_t phase)
+{
+    uint32_t q = phase >> 30;          /* quadrant */
+    uint32_t i = (phase >> 24) & 0x3f; /* step within it */
+    int16_t v = (q & 1) ? s_quarter[64 - i] : s_quarter[i];
+    return (q & 2) ? -v : v;
+}
+
+void audio_synth_init(audio_synth_t *s, int mode, uint32_t rate, uint32_t freq_hz)
+{
+    s->mode = mode;
+    s->index = 0;
+    s->phase = 0;
+    s->step = rate ? (uint32_t)(((uint64_t)freq_hz << 32) / rate) : 0;
+    s->amplitude = 8192; /* -12 dBFS */
+}
+
+void audio_synth_fill(audio_synth_t *s, int16_t *out, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        if (AUDIO_SYNTH_COUNT == s->mode) {
+            out[i] = audio_synth_count_sample(s->index);
+        } else {
+            out[i] = (int16_t)((sine(s->phase) * s->amplitude) >> 15);
+            s->phase += s->step;
+        }
+        s->index++;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef __AUDIO_SYNTH_H__
+#define __AUDIO_SYNTH_H__
+
+#include <stdint.h>
+
+/*
+ * Synthetic 16 bit PCM in place of the microphone, for the pipeline on the
+ * board without sound and for tools/audio_check.c on the host.
+ *
+ *   AUDIO_SYNTH_TONE   a sine, to listen to
+ *   AUDIO_SYNTH_COUNT  sample i is i * AUDIO_SYNTH_MUL (mod 2^16); the
+ *                      multiplier is odd, so every sample tells its own
+ *                      index and a reader finds any gap or repeat
+ */
+
+#define AUDIO_SYNTH_TONE (0)
+#define AUDIO_SYNTH_COUNT (1)
+
+#define AUDIO_SYNTH_MUL (40503)
+#define AUDIO_SYNTH_MUL_INV (30599) /* AUDIO_SYNTH_MUL * AUDIO_SYNTH_MUL_INV == 1 mod 2^16 */
+
+typedef struct {
+    int mode;
+    uint32_t index; /* next sample */
+    uint32_t phase; /* tone, 2^32 per period */
+    uint32_t step;
+    int16_t amplitude;
+} audio_synth_t;
+
+void audio_synth_init(audio_synth_t *s, int mode, uint32_t rate, uint32_t freq_hz);
+void audio_synth_fill(audio_synth_t *s, int16_t *out, uint32_t n);
+
+static inline int16_t audio_synth_count_sample(uint32_t index)
+{
+    return (int16_t)(uint16_t)(index * AUDIO_SYNTH_MUL);
+}
+
+/* the index modulo 2^16 of a AUDIO_SYNTH_COUNT sample */
+static inline uint16_t audio_synth_count_index(int16_t sample)
+{
+    return (uint16_t)((uint16_t)sample * AUDIO_SYNTH_MUL_INV);
+}
+
+#endif /* __AUDIO_SYNTH_H__ */
@@ -0,0 +1,182 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "frame_ring.h"
+
+#ifdef __linux__
+/* one coherent address space, only the ordering matters */
+#define fring_cache_clean(addr, len) ((void)(addr), (void)(len))
+#define fring_cache_invalid(addr, len) ((void)(addr), (void)(len))
+#else
+#include <csi_core.h>
+#define fring_cache_clean(addr, len) csi_dcache_clean_range((void *)(addr), (len))
+#define fring_cache_invalid(addr, len) csi_dcache_invalid_range((void *)(addr), (len))
+#endif
+
+#define ALIGNDOWN(x, r) ((x) & ~((r)-1))
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+
+#define fring_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define fring_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/* whole lines only, a partial line would clean or drop a neighbour's data */
+static void clean_range(uintptr_t addr, uint32_t len)
+{
+    uintptr_t start = ALIGNDOWN(addr, FRAME_RING_LINE);
+    fring_cache_clean(start, ALIGNUP(addr + len, FRAME_RING_LINE) - start);
+}
+
+static void invalid_range(uintptr_t addr, uint32_t len)
+{
+    uintptr_t start = ALIGNDOWN(addr, FRAME_RING_LINE);
+    fring_cache_invalid(start, ALIGNUP(addr + len, FRAME_RING_LINE) - start);
+}
+
+static uint32_t read_shared(volatile uint32_t *p)
+{
+    invalid_range((uintptr_t)p, sizeof(*p));
+    return fring_load(p);
+}
+
+static void write_shared(volatile uint32_t *p, uint32_t v)
+{
+    fring_store(p, v);
+    clean_range((uintptr_t)p, sizeof(*p));
+}
+
+#ifdef __linux__
+int fring_shm_reserved(void)
+{
+    return 1; /* the host tools map their own block */
+}
+#else
+/* the heap region of the SDK's linker script, weak so a script without them reads as unknown */
+extern uint8_t _heap_start[] __attribute__((weak));
+extern uint8_t _heap_size[] __attribute__((weak));
+
+int fring_shm_reserved(void)
+{
+    uintptr_t start = (uintptr_t)_heap_start, size = (uintptr_t)_heap_size;
+
+    if (0 == start || 0 == size) {
+        return 0;
+    }
+    return !FRAME_RING_SHM_OVERLAPS(start, size);
+}
+#endif
+
+int fring_init_producer(fring_t *r, void *shm)
+{
+    if (FRAME_RING_SHM_OVERLAPS(shm, sizeof(fring_shm_t)) && !fring_shm_reserved()) {
+        return -1;
+    }
+    memset(r, 0, sizeof(*r));
+    r->shm = shm;
+    memset(shm, 0, sizeof(fring_shm_t));
+    clean_range((uintptr_t)shm, sizeof(fring_shm_t));
+
+    r->shm->prod.slots = FRAME_RING_SLOTS;
+    r->shm->prod.head = 0;
+    /* magic last, the consumer takes it as "formatted" */
+    write_shared(&r->shm->prod.magic, FRAME_RING_MAGIC);
+    return 0;
+}
+
+int fring_attach_consumer(fring_t *r, void *shm)
+{
+    memset(r, 0, sizeof(*r));
+    r->shm = shm;
+    if (FRAME_RING_MAGIC != read_shared(&r->shm->prod.magic)) {
+        return -1;
+    }
+    invalid_range((uintptr_t)&r->shm->prod, sizeof(r->shm->prod));
+    if (FRAME_RING_SLOTS != r->shm->prod.slots) {
+        return -1;
+    }
+    /* a restarted consumer picks up where the producer stands, no replay */
+    r->tail = r->released = read_shared(&r->shm->prod.head);
+    write_shared(&r->shm->cons.tail, r->tail);
+    write_shared(&r->shm->rel.released, r->released);
+    return 0;
+}
+
+/* a slot is free once reclaimed, its descriptor still holds the cookie until then */
+uint32_t fring_free_slots(fring_t *r)
+{
+    return FRAME_RING_SLOTS - (r->head - r->reclaimed);
+}
+
+int fring_push(fring_t *r, uint32_t addr, uint32_t len, uint32_t ts_ms, uint32_t cookie)
+{
+    if (addr & (FRAME_RING_LINE - 1)) {
+        return -1;
+    }
+    if (0 == fring_free_slots(r)) {
+        r->full++;
+        return -1;
+    }
+
+    /* frame data must reach memory before the descriptor that points at it */
+    clean_range(addr, len);
+
+    fring_desc_t *d = &r->shm->desc[r->head % FRAME_RING_SLOTS];
+    d->addr = addr;
+    d->len = len;
+    d->seq = r->head;
+    d->ts_ms = ts_ms;
+    d->cookie = cookie;
+    clean_range((uintptr_t)d, sizeof(*d));
+
+    r->head++;
+    write_shared(&r->shm->prod.head, r->head);
+    r->pushed++;
+    if (r->notify) {
+        r->notify(r->notify_arg);
+    }
+    return 0;
+}
+
+int fring_reclaim(fring_t *r, void (*done)(void *arg, const fring_desc_t *d), void *arg)
+{
+    uint32_t released = read_shared(&r->shm->rel.released);
+    int n = 0;
+
+    /* descriptors are the producer's own lines, still valid in its cache */
+    for (; r->reclaimed != released; r->reclaimed++, n++) {
+        if (done) {
+            done(arg, &r->shm->desc[r->reclaimed % FRAME_RING_SLOTS]);
+        }
+    }
+    return n;
+}
+
+int fring_pop(fring_t *r, fring_desc_t *d)
+{
+    if (r->tail == read_shared(&r->shm->prod.head)) {
+        return 0;
+    }
+
+    fring_desc_t *src = &r->shm->desc[r->tail % FRAME_RING_SLOTS];
+    invalid_range((uintptr_t)src, sizeof(*src));
+    *d = *src;
+    d->addr = FRAME_RING_PEER_ADDR(d->addr);
+    /* drop stale lines of a buffer this core may have read in an earlier round */
+    invalid_range(d->addr, d->len);
+
+    r->tail++;
+    write_shared(&r->shm->cons.tail, r->tail);
+    r->popped++;
+    return 1;
+}
+
+void fring_release(fring_t *r)
+{
+    if (r->released == r->tail) {
+        return; /* nothing popped */
+    }
+    r->released++;
+    write_shared(&r->shm->rel.released, r->released);
+    if (r->notify) {
+        r->notify(r->notify_arg);
+    }
+}
@@ -0,0 +1,142 @@
+#ifndef __FRAME_RING_H__
+#define __FRAME_RING_H__
+
+#include <stdint.h>
+
+/*
+ * Single producer / single consumer descriptor ring in memory shared by the
+ * C906 (producer, camera) and the E907 (consumer, network). Frames stay in
+ * the producer's buffers, only descriptors move:
+ *
+ *   producer  fring_push()     clean frame + descriptor from D-cache, bump head
+ *   consumer  fring_pop()      invalidate, read descriptor, bump tail
+ *   consumer  fring_release()  done with the buffer, bump released
+ *   producer  fring_reclaim()  buffers behind released belong to it again
+ *
+ * Neither core snoops the other's cache, so every cache line of the shared
+ * block has exactly one writer: head and the descriptors belong to the
+ * producer, tail and released to the consumer, each on its own line. A line
+ * written by both would lose one side's update on write back.
+ *
+ * This file is shared as is between c906_app/camera_streaming_through_wifi,
+ * c906_app/uvc_demo, c906_app/audio_recording and e907_app/firmware, keep
+ * all copies identical.
+ */
+
+#define FRAME_RING_MAGIC (0x474e5246) /* "FRNG" */
+#define FRAME_RING_SLOTS (8)          /* power of 2 */
+#define FRAME_RING_LINE (64)          /* C906 line size, a multiple of the E907's 32 */
+
+/*
+ * Shared block, must be reserved on both sides (kept out of both heaps) and
+ * be reachable at the same address from both cores. The default is the last
+ * 64 KB of the M1s' 64 MB PSRAM, the top of a 192 KB window shared by all
+ * the cross-core blocks:
+ *
+ *   0x53fd0000  uvc_cfg.h     UVC_CFG_SHM_BASE
+ *   0x53fe0000  xrpc_msg.h    XRPC_SHM_BASE
+ *   0x53ff0000  this file     FRAME_RING_SHM_BASE
+ *
+ * Nothing in these projects' makefiles can reserve it, the heaps come from
+ * the SDK's linker scripts. The C906 heap runs from the end of the image to
+ * the end of the psram region of the bl808 C906 linker script: shrink that
+ * region's LENGTH by FRAME_RING_SHM_RESERVED (0x30000) so the heap ends at
+ * 0x53fd0000. The E907 heap stays in its own RAM and needs no change as long
+ * as its linker script doesn't move it into PSRAM.
+ *
+ * On a stock SDK the window is C906 heap, so every user of it is opt-in and
+ * checks fring_shm_reserved() first: it compares the window with the heap
+ * the linker script hands to FreeRTOS (_heap_start, _heap_size). The C906
+ * is the first to write in every block (the ring, the xrpc request line),
+ * the E907 waits for that, so a C906 that refuses leaves the window alone.
+ */
+#ifndef FRAME_RING_SHM_BASE
+#define FRAME_RING_SHM_BASE (0x53ff0000)
+#endif
+#define FRAME_RING_SHM_RESERVED_BASE (0x53fd0000)
+#define FRAME_RING_SHM_RESERVED (0x30000)
+#define FRAME_RING_SHM_OVERLAPS(addr, len)                                            \
+    ((uintptr_t)(addr) < FRAME_RING_SHM_RESERVED_BASE + FRAME_RING_SHM_RESERVED && \
+     (uintptr_t)(addr) + (len) > FRAME_RING_SHM_RESERVED_BASE)
+
+/* producer buffer address as the consumer sees it */
+#ifndef FRAME_RING_PEER_ADDR
+#define FRAME_RING_PEER_ADDR(addr) (addr)
+#endif
+
+typedef struct {
+    uint32_t addr;  /* frame buffer, producer's address */
+    uint32_t len;
+    uint32_t seq;
+    uint32_t ts_ms;
+    uint32_t cookie; /* producer's buffer id, returned by fring_reclaim() */
+    uint8_t pad[FRAME_RING_LINE - 5 * sizeof(uint32_t)];
+} fring_desc_t;
+
+typedef struct {
+    struct {
+        volatile uint32_t magic;
+        volatile uint32_t slots;
+        volatile uint32_t head; /* descriptors pushed */
+        uint8_t pad[FRAME_RING_LINE - 3 * sizeof(uint32_t)];
+    } prod;
+    struct {
+        volatile uint32_t tail; /* descriptors popped */
+        uint8_t pad[FRAME_RING_LINE - sizeof(uint32_t)];
+    } cons;
+    struct {
+        volatile uint32_t released; /* descriptors whose buffer is free again */
+        uint8_t pad[FRAME_RING_LINE - sizeof(uint32_t)];
+    } rel;
+    fring_desc_t desc[FRAME_RING_SLOTS];
+} fring_shm_t;
+
+/* local view of the ring, one per core */
+typedef struct {
+    fring_shm_t *shm;
+    uint32_t head;      /* producer: next to push */
+    uint32_t reclaimed; /* producer: next to hand back */
+    uint32_t tail;      /* consumer: next to pop */
+    uint32_t released;  /* consumer: next to release */
+
+    uint32_t pushed;
+    uint32_t full;      /* push refused, no free slot */
+    uint32_t popped;
+    void (*notify)(void *arg); /* doorbell to the other core, NULL to poll */
+    void *notify_arg;
+} fring_t;
+
+/* 1 if this core's heap stays clear of the shared window, 0 if it reaches in or can't be told */
+int fring_shm_reserved(void);
+
+/*
+ * producer: format the shared block, before the consumer attaches. Returns
+ * -1 without touching it if it is in the window and fring_shm_reserved() is 0.
+ */
+int fring_init_producer(fring_t *r, void *shm);
+/* consumer: returns -1 until the producer has formatted the block */
+int fring_attach_consumer(fring_t *r, void *shm);
+
+/*
+ * Buffers must start on a FRAME_RING_LINE boundary and own their last line,
+ * the consumer invalidates whole lines. Returns 0, or -1 when all slots are
+ * in use (fring_reclaim(), then retry or drop the frame) or addr is not line
+ * aligned.
+ */
+int fring_push(fring_t *r, uint32_t addr, uint32_t len, uint32_t ts_ms, uint32_t cookie);
+
+/*
+ * Calls done() for every buffer the consumer has released and frees their
+ * slots. Returns the count.
+ */
+int fring_reclaim(fring_t *r, void (*done)(void *arg, const fring_desc_t *d), void *arg);
+
+/* Copies the next descriptor out. Returns 1 if there was one, 0 if empty. */
+int fring_pop(fring_t *r, fring_desc_t *d);
+
+/* Hands back the oldest popped buffer; releases must follow pop order. */
+void fring_release(fring_t *r);
+
+uint32_t fring_free_slots(fring_t *r);
+
+#endif /* __FRAME_RING_H__ */
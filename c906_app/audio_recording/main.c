@@ -1,33 +1,346 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 /* FreeRTOS */
 #include <FreeRTOS.h>
 #include <task.h>
 
+/* m1s_lfs_c906 */
+#include <lfs_c906.h>
+
 #include "m1s_c906_xram_audio.h"
 
+#include "audio_capture.h"
+#include "audio_ring.h"
+#include "audio_sink.h"
+#include "audio_synth.h"
+#include "frame_ring.h"
+#include "mfcc.h"
+#include "resample.h"
+#include "vad.h"
+#include "wav_writer.h"
+
 #define AUDIO_BUFF_SIZE (4096)
+#define AUDIO_RATE (16000)
+#define AUDIO_CHANNELS (1)
+#define AUDIO_CAPTURE_RATE (AUDIO_RATE) /* what the source delivers, resampled to AUDIO_RATE if different */
+#define AUDIO_RS_CHUNK (256)            /* capture samples per resampler call */
+#define AUDIO_PERIOD (256)              /* capture samples handed to the processing task at a time */
+#define AUDIO_PERIOD_MS (AUDIO_PERIOD * 1000 / AUDIO_CAPTURE_RATE)
+
+#define AUDIO_RING_SAMPLES (32 * 1024) /* 2 s, room for the file system to stall */
+#define AUDIO_BLOCK (1024)             /* samples per write */
+#define AUDIO_STARVE_MS (500)          /* no buffer this long is an underrun */
+#define AUDIO_CHECKPOINT_MS (1000)
+#define AUDIO_RECORD_S (10)
+#define AUDIO_FILE "/lfs/rec.wav"
+#define AUDIO_VAD_SENSITIVITY (2)
+
+/* define to record the counting test source instead of the microphone */
+// #define AUDIO_SRC_SYNTH
+
+/* define to also hand 20 ms blocks to the E907 through the shared frame ring ("audio_udp <ip> <port> pcm mic") */
+// #define AUDIO_STREAM_FRING
+#define AUDIO_STREAM_BLOCK (AUDIO_RATE / 50)
+
+#define now_ms() (xTaskGetTickCount() * portTICK_PERIOD_MS)
+
+static audio_capture_t s_cap;
+static int16_t s_cap_buf[AUDIO_CAPTURE_BUFS * AUDIO_PERIOD];
+static TaskHandle_t s_proc_task, s_main_task;
+static audio_ring_t s_ring;
+static int16_t s_ring_buf[AUDIO_RING_SAMPLES];
+static int16_t s_block[AUDIO_BLOCK];
+static wav_writer_t s_wav;
+static volatile int s_capturing = 0;
+static mfcc_t s_mfcc;
+static float s_feat[MFCC_MAX_MELS];
+static vad_t s_vad;
+#if AUDIO_CAPTURE_RATE != AUDIO_RATE
+static rs_t s_rs;
+static int16_t s_rs_out[(uint64_t)AUDIO_RS_CHUNK * AUDIO_RATE / AUDIO_CAPTURE_RATE + 2];
+#endif
+#ifdef AUDIO_STREAM_FRING
+static fring_t s_fring;
+static int16_t s_stream_buf[FRAME_RING_SLOTS][AUDIO_STREAM_BLOCK] __attribute__((aligned(FRAME_RING_LINE)));
+static volatile uint8_t s_stream_busy[FRAME_RING_SLOTS];
+static int16_t s_stream_acc[AUDIO_STREAM_BLOCK];
+static uint32_t s_stream_fill, s_stream_blocks, s_stream_dropped;
+
+static void stream_done(void *arg, const fring_desc_t *d)
+{
+    s_stream_busy[d->cookie % FRAME_RING_SLOTS] = 0;
+}
+
+/*
+ * Block k goes out of buffer k % FRAME_RING_SLOTS with k as the cookie, the
+ * E907 timestamps it from that. A block whose buffer the E907 still holds
+ * is dropped and leaves a gap in the numbers.
+ */
+static void stream_write(const int16_t *samples, uint32_t n)
+{
+    if (NULL == s_fring.shm) {
+        return; /* no ring, see fring_init_producer() in main() */
+    }
+    while (n) {
+        uint32_t len = AUDIO_STREAM_BLOCK - s_stream_fill < n ? AUDIO_STREAM_BLOCK - s_stream_fill : n;
+        memcpy(s_stream_acc + s_stream_fill, samples, len * sizeof(int16_t));
+        s_stream_fill += len;
+        samples += len;
+        n -= len;
+        if (AUDIO_STREAM_BLOCK == s_stream_fill) {
+            uint32_t k = s_stream_blocks++, i = k % FRAME_RING_SLOTS;
+            s_stream_fill = 0;
+            fring_reclaim(&s_fring, stream_done, NULL);
+            if (s_stream_busy[i]) {
+                s_stream_dropped++;
+                continue;
+            }
+            memcpy(s_stream_buf[i], s_stream_acc, sizeof(s_stream_acc));
+            s_stream_busy[i] = 1;
+            if (0 != fring_push(&s_fring, (uint32_t)(uintptr_t)s_stream_buf[i], sizeof(s_stream_acc), now_ms(), k)) {
+                s_stream_busy[i] = 0;
+                s_stream_dropped++;
+            }
+        }
+    }
+}
+#endif
+
+/* called for each period the source hands over, nothing in here may wait */
+static void on_audio_buffer(const int16_t *samples, uint32_t n)
+{
+#if AUDIO_CAPTURE_RATE != AUDIO_RATE
+    while (n) {
+        uint32_t len = n < AUDIO_RS_CHUNK ? n : AUDIO_RS_CHUNK;
+        uint32_t out = rs_process_s16(&s_rs, samples, len, s_rs_out);
+        audio_ring_write(&s_ring, s_rs_out, out);
+#ifdef AUDIO_STREAM_FRING
+        stream_write(s_rs_out, out);
+#endif
+        samples += len;
+        n -= len;
+    }
+#else
+    audio_ring_write(&s_ring, samples, n);
+#ifdef AUDIO_STREAM_FRING
+    stream_write(samples, n);
+#endif
+#endif
+}
+
+/* from the backend: a period is ready */
+static void on_period(void *arg)
+{
+    xTaskNotifyGive(s_proc_task);
+}
+
+/*
+ * The backends below are woken by the tick clock once per period. The
+ * counting source is made up on the spot; the XRAM channel from the E907
+ * has no interrupt to wait on, but the buffer given to m1s_xram_audio_init()
+ * holds many periods, so draining it once a period loses nothing and
+ * doesn't spin on an empty channel every tick.
+ */
+#ifdef AUDIO_SRC_SYNTH
+static void audio_feed_task(void *arg)
+{
+    static int16_t buf[256];
+    audio_synth_t synth;
+    uint32_t start = now_ms();
+    uint32_t sent = 0;
+    TickType_t wake = xTaskGetTickCount();
+
+    audio_synth_init(&synth, AUDIO_SYNTH_COUNT, AUDIO_CAPTURE_RATE, 0);
+    while (s_capturing) {
+        /* real time pace, in whole buffers */
+        while (sent + 256 <= (uint64_t)(now_ms() - start) * AUDIO_CAPTURE_RATE / 1000) {
+            audio_synth_fill(&synth, buf, 256);
+            audio_capture_write(&s_cap, buf, 256, now_ms());
+            sent += 256;
+        }
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(AUDIO_PERIOD_MS));
+    }
+    vTaskDelete(NULL);
+}
+#else
+static void audio_feed_task(void *arg)
+{
+    uint16_t *rec_buff;
+    uint32_t rec_buff_size;
+    TickType_t wake = xTaskGetTickCount();
+
+    while (s_capturing) {
+        while (0 == m1s_xram_audio_get(&rec_buff, &rec_buff_size) && rec_buff_size > 0) {
+            audio_capture_write(&s_cap, (const int16_t *)rec_buff, rec_buff_size >> 1, now_ms());
+            m1s_xram_audio_pop();
+        }
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(AUDIO_PERIOD_MS));
+    }
+    vTaskDelete(NULL);
+}
+#endif
+
+/* sleeps until the backend has a period, the timeout is only there to notice the end */
+static void audio_proc_task(void *arg)
+{
+    const audio_period_t *p;
+
+    while (s_capturing) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        while (NULL != (p = audio_capture_take(&s_cap))) {
+            on_audio_buffer(p->pcm, s_cap.period);
+            audio_capture_release(&s_cap);
+            xTaskNotifyGive(s_main_task);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+/* the front-end on a second of tone, vector kernels against the scalar reference */
+static void mfcc_bench(void)
+{
+    static float frame[MFCC_MAX_NFFT];
+    static int16_t pcm[AUDIO_RATE];
+    audio_synth_t synth;
+    float ref[MFCC_MAX_MELS], max_diff = 0.0f;
+    uint32_t frames = 0, t, t_vec, t_ref;
+    int ready;
+
+    audio_synth_init(&synth, AUDIO_SYNTH_TONE, AUDIO_RATE, 1000);
+    audio_synth_fill(&synth, pcm, AUDIO_RATE);
+    for (uint32_t i = 0; i < s_mfcc.cfg.frame_len; i++) {
+        frame[i] = pcm[i] * (1.0f / 32768.0f);
+    }
+
+    t = now_ms();
+    for (uint32_t i = 0; i < 1000; i++) {
+        mfcc_frame(&s_mfcc, frame, s_feat);
+    }
+    t_vec = now_ms() - t;
+    t = now_ms();
+    for (uint32_t i = 0; i < 1000; i++) {
+        mfcc_frame_ref(&s_mfcc, frame, ref);
+    }
+    t_ref = now_ms() - t;
+    mfcc_frame(&s_mfcc, frame, s_feat);
+    for (uint32_t i = 0; i < s_mfcc.n_out; i++) {
+        float d = s_feat[i] > ref[i] ? s_feat[i] - ref[i] : ref[i] - s_feat[i];
+        max_diff = d > max_diff ? d : max_diff;
+    }
+
+    mfcc_reset(&s_mfcc);
+    for (uint32_t off = 0; off < AUDIO_RATE;) {
+        off += mfcc_push(&s_mfcc, pcm + off, AUDIO_RATE - off, s_feat, &ready);
+        frames += ready;
+    }
+    mfcc_reset(&s_mfcc);
+    printf("[mfcc] %lu frames/s, scalar %lu frames/s, max diff %f, %lu frames per second of audio\r\n",
+           t_vec ? 1000000UL / t_vec : 0, t_ref ? 1000000UL / t_ref : 0, max_diff, (unsigned long)frames);
+}
 
 void main()
 {
+    audio_sink_t sink;
+    mfcc_cfg_t mfcc_cfg;
+    vad_cfg_t vad_cfg;
+    vad_event_t ev;
+    uint32_t total = AUDIO_RECORD_S * AUDIO_RATE * AUDIO_CHANNELS;
+
+    lfs_register();
+    audio_ring_init(&s_ring, s_ring_buf, AUDIO_RING_SAMPLES);
+#if AUDIO_CAPTURE_RATE != AUDIO_RATE
+    rs_cfg_t rs_cfg;
+    rs_default_cfg(&rs_cfg);
+    rs_cfg.rate_in = AUDIO_CAPTURE_RATE;
+    rs_cfg.rate_out = AUDIO_RATE;
+    rs_cfg.dc_block = 1;
+    if (0 != rs_init(&s_rs, &rs_cfg)) {
+        printf("[audio] can't resample %d Hz to %d Hz\r\n", AUDIO_CAPTURE_RATE, AUDIO_RATE);
+        return;
+    }
+#endif
+    mfcc_default_cfg(&mfcc_cfg);
+    mfcc_init(&s_mfcc, &mfcc_cfg);
+    mfcc_bench();
+    vad_default_cfg(&vad_cfg, AUDIO_RATE, AUDIO_VAD_SENSITIVITY);
+    vad_init(&s_vad, &vad_cfg);
+    if (0 != wav_open(&s_wav, AUDIO_FILE, AUDIO_RATE, AUDIO_CHANNELS)) {
+        printf("[audio] can't create %s\r\n", AUDIO_FILE);
+        return;
+    }
+
     printf("Audio init..\r\n");
+#ifndef AUDIO_SRC_SYNTH
     uint16_t *buff = pvPortMalloc(AUDIO_BUFF_SIZE * 2);
     assert(buff);
     m1s_xram_audio_init(buff, AUDIO_BUFF_SIZE * 2);
+#endif
+#ifdef AUDIO_STREAM_FRING
+    if (0 != fring_init_producer(&s_fring, (void *)FRAME_RING_SHM_BASE)) {
+        printf("[audio] heap reaches into the shared window, not streaming, see frame_ring.h\r\n");
+    }
+#endif
+    s_main_task = xTaskGetCurrentTaskHandle();
+    audio_capture_init(&s_cap, s_cap_buf, AUDIO_PERIOD, on_period, NULL);
+    s_capturing = 1;
+    xTaskCreate(audio_proc_task, "audio_proc", 1024, NULL, 14, &s_proc_task);
+    xTaskCreate(audio_feed_task, "audio_feed", 1024, NULL, 15, NULL);
 
-    uint16_t *rec_buff;
-    uint32_t rec_buff_size;
-    while (1) {
-        if (0 == m1s_xram_audio_get(&rec_buff, &rec_buff_size) && rec_buff_size > 0) {
-            for (int i = 0; i < rec_buff_size >> 1; i++) {
-                if (i % 256 == 0) printf("\r\n");
-                printf("%d, ", rec_buff[i]);
+    uint32_t start = now_ms();
+    uint32_t last_checkpoint = start;
+    audio_sink_init(&sink, &s_ring, &s_wav, AUDIO_STARVE_MS, start);
+    while (sink.samples < total) {
+        uint32_t want = total - sink.samples;
+        int n = audio_sink_step(&sink, now_ms(), s_block, want < AUDIO_BLOCK ? want : AUDIO_BLOCK);
+        if (n < 0) {
+            printf("[audio] write error, stopping\r\n");
+            break;
+        }
+        /* features only over speech, as a keyword spotter would want them */
+        vad_process(&s_vad, s_block, n);
+        while (vad_event_pop(&s_vad, &ev)) {
+            if (VAD_SPEECH_START == ev.type) {
+                mfcc_reset(&s_mfcc);
             }
-            m1s_xram_audio_pop();
+            printf("[vad] speech %s at %lu ms\r\n", VAD_SPEECH_START == ev.type ? "start" : "end",
+                   (unsigned long)((uint64_t)ev.sample * 1000 / AUDIO_RATE));
+        }
+        for (int off = 0, ready; s_vad.active && off < n;) {
+            off += mfcc_push(&s_mfcc, s_block + off, n - off, s_feat, &ready);
+        }
+        if (now_ms() - last_checkpoint >= AUDIO_CHECKPOINT_MS) {
+            last_checkpoint = now_ms();
+            wav_checkpoint(&s_wav);
+            printf("[audio] %lu ms: %lu samples, %lu periods (%lu lost), ring %lu, overruns %lu (%lu dropped), "
+                   "underruns %lu, speech %d, floor %d dB, %lu feature frames, c0 %d\r\n",
+                   (unsigned long)(last_checkpoint - start), (unsigned long)sink.samples, (unsigned long)s_cap.periods,
+                   (unsigned long)s_cap.lost, (unsigned long)audio_ring_used(&s_ring), (unsigned long)s_ring.overruns,
+                   (unsigned long)s_ring.dropped, (unsigned long)sink.underruns, s_vad.active,
+                   (int)s_vad.floor_db, (unsigned long)s_mfcc.frames, (int)s_feat[0]);
+#ifdef AUDIO_STREAM_FRING
+            printf("[audio] stream: %lu blocks, %lu dropped\r\n", (unsigned long)s_stream_blocks,
+                   (unsigned long)s_stream_dropped);
+#endif
         }
-        vTaskDelay(1);
+        if (0 == n) {
+            /* woken per period by the processing task */
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        }
+    }
+    s_capturing = 0;
+    vTaskDelay(pdMS_TO_TICKS(200)); /* let the feeder and the processing task see it */
+
+    if (0 != wav_close(&s_wav)) {
+        printf("[audio] %s not finalised\r\n", AUDIO_FILE);
     }
+    printf("[audio] %s: %lu samples, lost periods %lu, overruns %lu (%lu dropped), underruns %lu\r\n", AUDIO_FILE,
+           (unsigned long)sink.samples, (unsigned long)s_cap.lost, (unsigned long)s_ring.overruns,
+           (unsigned long)s_ring.dropped, (unsigned long)sink.underruns);
+#ifndef AUDIO_SRC_SYNTH
     m1s_xram_audio_deinit();
-}
\ No newline at end of file
+#endif
+    lfs_unregister();
+}
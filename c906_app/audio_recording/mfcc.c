@@ -0,0 +1,414 @@
+#include <math.h>
+#include <string.h>
+
+#include "mfcc.h"
+
+#if defined(__riscv_vector) && !defined(MFCC_FORCE_SCALAR)
+#define MFCC_USE_RVV (1)
+#include <riscv_vector.h>
+#else
+#define MFCC_USE_RVV (0)
+#endif
+
+#ifndef M_PI
+#define M_PI (3.14159265358979323846)
+#endif
+
+void mfcc_default_cfg(mfcc_cfg_t *cfg)
+{
+    cfg->rate = 16000;
+    cfg->frame_len = 400;
+    cfg->hop = 160;
+    cfg->nfft = 512;
+    cfg->n_mels = 40;
+    cfg->n_mfcc = 13;
+    cfg->preemph = 0.97f;
+    cfg->fmin = 20.0f;
+    cfg->fmax = 8000.0f;
+}
+
+static inline double hz_to_mel(double hz)
+{
+    return 2595.0 * log10(1.0 + hz / 700.0);
+}
+
+static inline double mel_to_hz(double mel)
+{
+    return 700.0 * (pow(10.0, mel / 2595.0) - 1.0);
+}
+
+static void mel_init(mfcc_t *m)
+{
+    const mfcc_cfg_t *c = &m->cfg;
+    uint32_t bins = c->nfft / 2 + 1, off = 0;
+    double lo = hz_to_mel(c->fmin), hi = hz_to_mel(c->fmax);
+
+    for (uint32_t b = 0; b < c->n_mels; b++) {
+        double f0 = mel_to_hz(lo + (hi - lo) * b / (c->n_mels + 1));
+        double f1 = mel_to_hz(lo + (hi - lo) * (b + 1) / (c->n_mels + 1));
+        double f2 = mel_to_hz(lo + (hi - lo) * (b + 2) / (c->n_mels + 1));
+
+        m->mel_start[b] = 0;
+        m->mel_len[b] = 0;
+        m->mel_off[b] = off;
+        for (uint32_t k = 0; k < bins; k++) {
+            double f = (double)k * c->rate / c->nfft;
+            double w = f < f1 ? (f - f0) / (f1 - f0) : (f2 - f) / (f2 - f1);
+            if (w <= 0.0) {
+                continue;
+            }
+            if (0 == m->mel_len[b]) {
+                m->mel_start[b] = k;
+            }
+            m->mel_w[off++] = (float)w;
+            m->mel_len[b]++;
+        }
+    }
+}
+
+int mfcc_init(mfcc_t *m, const mfcc_cfg_t *cfg)
+{
+    uint32_t nfft = cfg->nfft, half = nfft / 2, bits = 0;
+
+    if (nfft < 8 || nfft > MFCC_MAX_NFFT || (nfft & (nfft - 1)) || 0 == cfg->frame_len || cfg->frame_len > nfft ||
+        0 == cfg->hop || cfg->hop > cfg->frame_len || 0 == cfg->n_mels || cfg->n_mels > MFCC_MAX_MELS ||
+        cfg->n_mfcc > cfg->n_mels || cfg->n_mfcc > MFCC_MAX_COEFFS || cfg->fmin < 0.0f || cfg->fmin >= cfg->fmax ||
+        cfg->fmax > cfg->rate / 2.0f) {
+        return -1;
+    }
+    memset(m, 0, sizeof(*m));
+    m->cfg = *cfg;
+    m->n_out = cfg->n_mfcc ? cfg->n_mfcc : cfg->n_mels;
+
+    /* Hamming over the frame, zero in the padding */
+    for (uint32_t i = 0; i < cfg->frame_len; i++) {
+        m->window[i] = cfg->frame_len > 1 ? (float)(0.54 - 0.46 * cos(2.0 * M_PI * i / (cfg->frame_len - 1))) : 1.0f;
+    }
+    for (uint32_t t = 0; t < half / 2; t++) {
+        m->twr[t] = (float)cos(2.0 * M_PI * t / half);
+        m->twi[t] = (float)-sin(2.0 * M_PI * t / half);
+    }
+    for (uint32_t k = 0; k < half; k++) {
+        m->spr[k] = (float)cos(2.0 * M_PI * k / nfft);
+        m->spi[k] = (float)-sin(2.0 * M_PI * k / nfft);
+    }
+    while ((1u << bits) < half) {
+        bits++;
+    }
+    for (uint32_t i = 0; i < half; i++) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        m->bitrev[i] = r;
+    }
+    mel_init(m);
+    for (uint32_t j = 0; j < cfg->n_mels; j++) {
+        for (uint32_t k = 0; k < cfg->n_mfcc; k++) {
+            double s = sqrt((0 == k ? 1.0 : 2.0) / cfg->n_mels);
+            m->dct[j * cfg->n_mfcc + k] = (float)(s * cos(M_PI * k * (j + 0.5) / cfg->n_mels));
+        }
+    }
+    return 0;
+}
+
+void mfcc_reset(mfcc_t *m)
+{
+    m->fill = 0;
+    m->prev = 0.0f;
+    m->frames = 0;
+}
+
+/* the packed frame into bit reversed order for the in place FFT */
+static void bitrev_permute(mfcc_t *m)
+{
+    uint32_t half = m->cfg.nfft / 2;
+
+    for (uint32_t i = 0; i < half; i++) {
+        uint32_t j = m->bitrev[i];
+        if (i < j) {
+            float t = m->re[i];
+            m->re[i] = m->re[j];
+            m->re[j] = t;
+            t = m->im[i];
+            m->im[i] = m->im[j];
+            m->im[j] = t;
+        }
+    }
+}
+
+/* ln into out, or in place when the DCT follows */
+static void log_mel(mfcc_t *m, float *out)
+{
+    float *dst = m->cfg.n_mfcc ? m->mel : out;
+
+    for (uint32_t b = 0; b < m->cfg.n_mels; b++) {
+        dst[b] = logf(m->mel[b] > MFCC_LOG_FLOOR ? m->mel[b] : MFCC_LOG_FLOOR);
+    }
+}
+
+static void window_ref(mfcc_t *m, const float *frame)
+{
+    uint32_t len = m->cfg.frame_len, half = m->cfg.nfft / 2;
+
+    for (uint32_t i = 0; i < half; i++) {
+        m->re[i] = 2 * i < len ? frame[2 * i] * m->window[2 * i] : 0.0f;
+        m->im[i] = 2 * i + 1 < len ? frame[2 * i + 1] * m->window[2 * i + 1] : 0.0f;
+    }
+}
+
+static void fft_ref(mfcc_t *m)
+{
+    uint32_t half = m->cfg.nfft / 2;
+    float *re = m->re, *im = m->im;
+
+    for (uint32_t h = 1; h < half; h <<= 1) {
+        uint32_t ts = half / (2 * h);
+        for (uint32_t g = 0; g < half; g += 2 * h) {
+            for (uint32_t j = 0; j < h; j++) {
+                uint32_t a = g + j, b = a + h;
+                float wr = m->twr[j * ts], wi = m->twi[j * ts];
+                float tr = wr * re[b] - wi * im[b];
+                float ti = wr * im[b] + wi * re[b];
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/* the nfft/2 point complex FFT of the packed frame back to nfft real points, then |X|^2 */
+static void power_ref(mfcc_t *m)
+{
+    uint32_t half = m->cfg.nfft / 2;
+    const float *re = m->re, *im = m->im;
+
+    m->power[0] = (re[0] + im[0]) * (re[0] + im[0]);
+    m->power[half] = (re[0] - im[0]) * (re[0] - im[0]);
+    for (uint32_t k = 1; k < half; k++) {
+        float er = 0.5f * (re[k] + re[half - k]), ei = 0.5f * (im[k] - im[half - k]);
+        float odr = 0.5f * (im[k] + im[half - k]), odi = 0.5f * (re[half - k] - re[k]);
+        float xr = er + m->spr[k] * odr - m->spi[k] * odi;
+        float xi = ei + m->spr[k] * odi + m->spi[k] * odr;
+        m->power[k] = xr * xr + xi * xi;
+    }
+}
+
+static void mel_ref(mfcc_t *m)
+{
+    for (uint32_t b = 0; b < m->cfg.n_mels; b++) {
+        const float *p = m->power + m->mel_start[b], *w = m->mel_w + m->mel_off[b];
+        float sum = 0.0f;
+        for (uint32_t i = 0; i < m->mel_len[b]; i++) {
+            sum += p[i] * w[i];
+        }
+        m->mel[b] = sum;
+    }
+}
+
+static void dct_ref(mfcc_t *m, float *out)
+{
+    uint32_t n = m->cfg.n_mfcc;
+
+    for (uint32_t k = 0; k < n; k++) {
+        float sum = 0.0f;
+        for (uint32_t j = 0; j < m->cfg.n_mels; j++) {
+            sum += m->mel[j] * m->dct[j * n + k];
+        }
+        out[k] = sum;
+    }
+}
+
+void mfcc_frame_ref(mfcc_t *m, const float *frame, float *out)
+{
+    window_ref(m, frame);
+    bitrev_permute(m);
+    fft_ref(m);
+    power_ref(m);
+    mel_ref(m);
+    log_mel(m, out);
+    if (m->cfg.n_mfcc) {
+        dct_ref(m, out);
+    }
+}
+
+#if MFCC_USE_RVV
+static void window_rvv(mfcc_t *m, const float *frame)
+{
+    uint32_t len = m->cfg.frame_len, half = m->cfg.nfft / 2, pairs = len / 2;
+    const float *x = frame, *w = m->window;
+    float *re = m->re, *im = m->im;
+
+    for (size_t vl, n = pairs; n > 0; n -= vl, x += 2 * vl, w += 2 * vl, re += vl, im += vl) {
+        vl = vsetvl_e32m4(n);
+        vfloat32m4_t e = vfmul_vv_f32m4(vlse32_v_f32m4(x, 8, vl), vlse32_v_f32m4(w, 8, vl), vl);
+        vfloat32m4_t o = vfmul_vv_f32m4(vlse32_v_f32m4(x + 1, 8, vl), vlse32_v_f32m4(w + 1, 8, vl), vl);
+        vse32_v_f32m4(re, e, vl);
+        vse32_v_f32m4(im, o, vl);
+    }
+    for (uint32_t i = pairs; i < half; i++) {
+        m->re[i] = 2 * i < len ? frame[2 * i] * m->window[2 * i] : 0.0f;
+        m->im[i] = 0.0f;
+    }
+}
+
+/*
+ * Radix-2 stages on split re/im arrays. Spans of 8 and up run along each
+ * group with unit stride loads; the narrow first stages would leave most
+ * of the vector idle that way, so those run across the groups instead,
+ * one twiddle at a time, with strided loads.
+ */
+static void fft_rvv(mfcc_t *m)
+{
+    uint32_t half = m->cfg.nfft / 2;
+    float *re = m->re, *im = m->im;
+
+    for (uint32_t h = 1; h < half; h <<= 1) {
+        uint32_t ts = half / (2 * h);
+        if (h < 8) {
+            ptrdiff_t stride = 2 * h * sizeof(float);
+            for (uint32_t j = 0; j < h; j++) {
+                float wr = m->twr[j * ts], wi = m->twi[j * ts];
+                float *ra = re + j, *ia = im + j;
+                for (size_t vl, n = half / (2 * h); n > 0; n -= vl, ra += vl * 2 * h, ia += vl * 2 * h) {
+                    vl = vsetvl_e32m2(n);
+                    vfloat32m2_t ar = vlse32_v_f32m2(ra, stride, vl);
+                    vfloat32m2_t ai = vlse32_v_f32m2(ia, stride, vl);
+                    vfloat32m2_t br = vlse32_v_f32m2(ra + h, stride, vl);
+                    vfloat32m2_t bi = vlse32_v_f32m2(ia + h, stride, vl);
+                    vfloat32m2_t tr = vfnmsac_vf_f32m2(vfmul_vf_f32m2(br, wr, vl), wi, bi, vl);
+                    vfloat32m2_t ti = vfmacc_vf_f32m2(vfmul_vf_f32m2(bi, wr, vl), wi, br, vl);
+                    vsse32_v_f32m2(ra + h, stride, vfsub_vv_f32m2(ar, tr, vl), vl);
+                    vsse32_v_f32m2(ia + h, stride, vfsub_vv_f32m2(ai, ti, vl), vl);
+                    vsse32_v_f32m2(ra, stride, vfadd_vv_f32m2(ar, tr, vl), vl);
+                    vsse32_v_f32m2(ia, stride, vfadd_vv_f32m2(ai, ti, vl), vl);
+                }
+            }
+            continue;
+        }
+        ptrdiff_t wstride = ts * sizeof(float);
+        for (uint32_t g = 0; g < half; g += 2 * h) {
+            float *ra = re + g, *ia = im + g;
+            const float *twr = m->twr, *twi = m->twi;
+            for (size_t vl, n = h; n > 0; n -= vl, ra += vl, ia += vl, twr += vl * ts, twi += vl * ts) {
+                vl = vsetvl_e32m2(n);
+                vfloat32m2_t ar = vle32_v_f32m2(ra, vl);
+                vfloat32m2_t ai = vle32_v_f32m2(ia, vl);
+                vfloat32m2_t br = vle32_v_f32m2(ra + h, vl);
+                vfloat32m2_t bi = vle32_v_f32m2(ia + h, vl);
+                vfloat32m2_t wr = vlse32_v_f32m2(twr, wstride, vl);
+                vfloat32m2_t wi = vlse32_v_f32m2(twi, wstride, vl);
+                vfloat32m2_t tr = vfnmsac_vv_f32m2(vfmul_vv_f32m2(wr, br, vl), wi, bi, vl);
+                vfloat32m2_t ti = vfmacc_vv_f32m2(vfmul_vv_f32m2(wr, bi, vl), wi, br, vl);
+                vse32_v_f32m2(ra + h, vfsub_vv_f32m2(ar, tr, vl), vl);
+                vse32_v_f32m2(ia + h, vfsub_vv_f32m2(ai, ti, vl), vl);
+                vse32_v_f32m2(ra, vfadd_vv_f32m2(ar, tr, vl), vl);
+                vse32_v_f32m2(ia, vfadd_vv_f32m2(ai, ti, vl), vl);
+            }
+        }
+    }
+}
+
+/* as power_ref(), Z[half - k] read backwards with a negative stride */
+static void power_rvv(mfcc_t *m)
+{
+    uint32_t half = m->cfg.nfft / 2;
+    const float *re = m->re, *im = m->im;
+
+    m->power[0] = (re[0] + im[0]) * (re[0] + im[0]);
+    m->power[half] = (re[0] - im[0]) * (re[0] - im[0]);
+    for (size_t vl, k = 1; k < half; k += vl) {
+        vl = vsetvl_e32m2(half - k);
+        vfloat32m2_t ar = vle32_v_f32m2(re + k, vl);
+        vfloat32m2_t ai = vle32_v_f32m2(im + k, vl);
+        vfloat32m2_t br = vlse32_v_f32m2(re + half - k, -(ptrdiff_t)sizeof(float), vl);
+        vfloat32m2_t bi = vlse32_v_f32m2(im + half - k, -(ptrdiff_t)sizeof(float), vl);
+        vfloat32m2_t er = vfmul_vf_f32m2(vfadd_vv_f32m2(ar, br, vl), 0.5f, vl);
+        vfloat32m2_t ei = vfmul_vf_f32m2(vfsub_vv_f32m2(ai, bi, vl), 0.5f, vl);
+        vfloat32m2_t odr = vfmul_vf_f32m2(vfadd_vv_f32m2(ai, bi, vl), 0.5f, vl);
+        vfloat32m2_t odi = vfmul_vf_f32m2(vfsub_vv_f32m2(br, ar, vl), 0.5f, vl);
+        vfloat32m2_t wr = vle32_v_f32m2(m->spr + k, vl);
+        vfloat32m2_t wi = vle32_v_f32m2(m->spi + k, vl);
+        vfloat32m2_t xr = vfnmsac_vv_f32m2(vfmacc_vv_f32m2(er, wr, odr, vl), wi, odi, vl);
+        vfloat32m2_t xi = vfmacc_vv_f32m2(vfmacc_vv_f32m2(ei, wr, odi, vl), wi, odr, vl);
+        vse32_v_f32m2(m->power + k, vfmacc_vv_f32m2(vfmul_vv_f32m2(xr, xr, vl), xi, xi, vl), vl);
+    }
+}
+
+static void mel_rvv(mfcc_t *m)
+{
+    size_t vl = vsetvl_e32m1(1);
+    vfloat32m1_t zero = vfmv_v_f_f32m1(0.0f, vl);
+
+    for (uint32_t b = 0; b < m->cfg.n_mels; b++) {
+        const float *p = m->power + m->mel_start[b], *w = m->mel_w + m->mel_off[b];
+        vfloat32m1_t acc = zero;
+        for (size_t n = m->mel_len[b]; n > 0; n -= vl, p += vl, w += vl) {
+            vl = vsetvl_e32m8(n);
+            vfloat32m8_t v = vfmul_vv_f32m8(vle32_v_f32m8(p, vl), vle32_v_f32m8(w, vl), vl);
+            acc = vfredusum_vs_f32m8_f32m1(acc, v, acc, vl);
+        }
+        m->mel[b] = vfmv_f_s_f32m1_f32(acc);
+    }
+}
+
+/* along the coefficients, one log-mel at a time: no reductions */
+static void dct_rvv(mfcc_t *m, float *out)
+{
+    uint32_t n = m->cfg.n_mfcc;
+
+    for (size_t vl, k = 0; k < n; k += vl) {
+        vl = vsetvl_e32m8(n - k);
+        vfloat32m8_t acc = vfmv_v_f_f32m8(0.0f, vl);
+        for (uint32_t j = 0; j < m->cfg.n_mels; j++) {
+            acc = vfmacc_vf_f32m8(acc, m->mel[j], vle32_v_f32m8(m->dct + j * n + k, vl), vl);
+        }
+        vse32_v_f32m8(out + k, acc, vl);
+    }
+}
+
+void mfcc_frame(mfcc_t *m, const float *frame, float *out)
+{
+    window_rvv(m, frame);
+    bitrev_permute(m);
+    fft_rvv(m);
+    power_rvv(m);
+    mel_rvv(m);
+    /* no vector log in the toolchain, keep it scalar */
+    log_mel(m, out);
+    if (m->cfg.n_mfcc) {
+        dct_rvv(m, out);
+    }
+}
+#else
+void mfcc_frame(mfcc_t *m, const float *frame, float *out)
+{
+    mfcc_frame_ref(m, frame, out);
+}
+#endif
+
+uint32_t mfcc_push(mfcc_t *m, const int16_t *pcm, uint32_t n, float *out, int *ready)
+{
+    uint32_t len = m->cfg.frame_len, hop = m->cfg.hop;
+    uint32_t todo = len - m->fill < n ? len - m->fill : n;
+    float a = m->cfg.preemph, prev = m->prev;
+
+    *ready = 0;
+    for (uint32_t i = 0; i < todo; i++) {
+        float x = pcm[i] * (1.0f / 32768.0f);
+        m->hist[m->fill + i] = x - a * prev;
+        prev = x;
+    }
+    m->prev = prev;
+    m->fill += todo;
+    if (m->fill == len) {
+        mfcc_frame(m, m->hist, out);
+        memmove(m->hist, m->hist + hop, (len - hop) * sizeof(float));
+        m->fill = len - hop;
+        m->frames++;
+        *ready = 1;
+    }
+    return todo;
+}
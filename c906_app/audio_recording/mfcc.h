@@ -0,0 +1,92 @@
+#ifndef __MFCC_H__
+#define __MFCC_H__
+
+#include <stdint.h>
+
+/*
+ * Audio front-end for keyword spotting: log-mel energies or MFCCs, frame by
+ * frame over a stream of 16 bit PCM.
+ *
+ *   x[n]    = pcm[n] / 32768
+ *   y[n]    = x[n] - preemph * x[n-1]                (x[-1] = 0)
+ *   frame i = y[i*hop .. i*hop+frame_len), Hamming window, zero padded to nfft
+ *   P[k]    = |FFT(frame)[k]|^2, k = 0..nfft/2
+ *   mel[b]  = sum_k P[k] * tri_b(k * rate / nfft), n_mels HTK mel triangles
+ *             spread evenly in mel over [fmin, fmax]
+ *   out[b]  = ln(max(mel[b], MFCC_LOG_FLOOR))                 (n_mfcc == 0)
+ *   out[c]  = orthonormal DCT-II of the log-mel, c < n_mfcc    (n_mfcc > 0)
+ *
+ * Kernels use RVV when the compiler targets it (__riscv_vector), define
+ * MFCC_FORCE_SCALAR to build the scalar reference only. mfcc_frame_ref()
+ * is always available for checking the vector path. Everything lives in
+ * mfcc_t, sized for the limits below; nothing is allocated.
+ */
+
+#define MFCC_MAX_NFFT (512)
+#define MFCC_MAX_BINS (MFCC_MAX_NFFT / 2 + 1)
+#define MFCC_MAX_MELS (64)
+#define MFCC_MAX_COEFFS (40)
+#define MFCC_LOG_FLOOR (1e-10f)
+
+typedef struct {
+    uint32_t rate;      /* Hz */
+    uint32_t frame_len; /* samples, <= nfft */
+    uint32_t hop;       /* samples, <= frame_len */
+    uint32_t nfft;      /* power of 2 */
+    uint32_t n_mels;
+    uint32_t n_mfcc; /* 0 for log-mel output */
+    float preemph;
+    float fmin;
+    float fmax; /* <= rate / 2 */
+} mfcc_cfg_t;
+
+typedef struct {
+    mfcc_cfg_t cfg;
+    uint32_t n_out; /* floats per frame: n_mfcc, or n_mels for log-mel */
+
+    float window[MFCC_MAX_NFFT];
+    float twr[MFCC_MAX_NFFT / 4]; /* e^(-2 pi i t / (nfft/2)), t < nfft/4 */
+    float twi[MFCC_MAX_NFFT / 4];
+    float spr[MFCC_MAX_NFFT / 2]; /* e^(-2 pi i k / nfft), k < nfft/2: real FFT split */
+    float spi[MFCC_MAX_NFFT / 2];
+    uint16_t bitrev[MFCC_MAX_NFFT / 2];
+    uint16_t mel_start[MFCC_MAX_MELS]; /* first bin of each triangle */
+    uint16_t mel_len[MFCC_MAX_MELS];
+    uint16_t mel_off[MFCC_MAX_MELS]; /* into mel_w */
+    float mel_w[2 * MFCC_MAX_BINS];
+    float dct[MFCC_MAX_MELS * MFCC_MAX_COEFFS]; /* [n_mels][n_mfcc] */
+
+    /* scratch */
+    float re[MFCC_MAX_NFFT / 2];
+    float im[MFCC_MAX_NFFT / 2];
+    float power[MFCC_MAX_BINS];
+    float mel[MFCC_MAX_MELS];
+
+    /* streaming */
+    float hist[MFCC_MAX_NFFT]; /* pre-emphasised samples of the next frame */
+    uint32_t fill;
+    float prev;
+    uint32_t frames;
+} mfcc_t;
+
+/* 16 kHz, 25 ms frames every 10 ms, 512 point FFT, 40 mels over 20..8000 Hz, 13 MFCCs */
+void mfcc_default_cfg(mfcc_cfg_t *cfg);
+
+/* Returns 0, or -1 when cfg is outside the limits. Resets the stream. */
+int mfcc_init(mfcc_t *m, const mfcc_cfg_t *cfg);
+
+/* forget the stream, the next frame starts at the next sample pushed */
+void mfcc_reset(mfcc_t *m);
+
+/**
+ * Takes samples until a frame completes or pcm runs out, and returns how
+ * many it took. When a frame completed, its n_out features are in out and
+ * *ready is 1. Call again with the rest of pcm for the following frames.
+ */
+uint32_t mfcc_push(mfcc_t *m, const int16_t *pcm, uint32_t n, float *out, int *ready);
+
+/* one frame of frame_len pre-emphasised samples to n_out features */
+void mfcc_frame(mfcc_t *m, const float *frame, float *out);
+void mfcc_frame_ref(mfcc_t *m, const float *frame, float *out);
+
+#endif /* __MFCC_H__ */
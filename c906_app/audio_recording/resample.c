@@ -0,0 +1,511 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resample.h"
+
+#if defined(__riscv_vector) && !defined(RS_FORCE_SCALAR)
+#define RS_USE_RVV (1)
+#include <riscv_vector.h>
+#else
+#define RS_USE_RVV (0)
+#endif
+
+#ifndef M_PI
+#define M_PI (3.14159265358979323846)
+#endif
+
+#define RS_KAISER_BETA (8.0)
+#define RS_TRANSITION (5.08) /* Kaiser transition width at RS_KAISER_BETA, in lower Nyquists times crossings */
+
+void rs_default_cfg(rs_cfg_t *cfg)
+{
+    cfg->rate_in = 16000;
+    cfg->rate_out = 16000;
+    cfg->channels = 1;
+    cfg->mono = 0;
+    cfg->dc_block = 0;
+    cfg->zero_crossings = 24;
+}
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* zeroth order modified Bessel function of the first kind */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+
+    for (int k = 1; k < 50 && term > 1e-12 * sum; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static inline int16_t sat16(int64_t v)
+{
+    return v > 32767 ? 32767 : v < -32768 ? -32768 : (int16_t)v;
+}
+
+int rs_init(rs_t *r, const rs_cfg_t *cfg)
+{
+    uint32_t g, up, down, k, n, taps, z = cfg->zero_crossings;
+
+    if (0 == cfg->rate_in || 0 == cfg->rate_out || 0 == z || (1 != cfg->channels && 2 != cfg->channels)) {
+        return -1;
+    }
+    g = gcd(cfg->rate_in, cfg->rate_out);
+    up = cfg->rate_out / g;
+    down = cfg->rate_in / g;
+    k = up > down ? up : down;
+    n = 2 * z * k;
+    taps = (n + up - 1) / up;
+    if (up > RS_MAX_PHASES || taps > RS_MAX_TAPS || (uint64_t)taps * up > RS_MAX_COEFFS) {
+        return -1;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->cfg = *cfg;
+    r->up = up;
+    r->down = down;
+    r->taps = taps;
+    r->out_channels = 2 == cfg->channels && !cfg->mono ? 2 : 1;
+
+    /* cutoff halfway through the transition, which ends at the lower Nyquist */
+    double cutoff = 1.0 - RS_TRANSITION / 2.0 / z;
+    if (cutoff < 0.5) {
+        cutoff = 0.5;
+    }
+    r->passband = (float)(2.0 * cutoff - 1.0);
+    double fc = cutoff * 0.5 / k; /* cycles per prototype sample */
+    double i0_beta = bessel_i0(RS_KAISER_BETA);
+
+    for (uint32_t p = 0; p < up; p++) {
+        float *c = r->coef + p * taps;
+        double sum = 0.0;
+        for (uint32_t j = 0; j < taps; j++) {
+            uint32_t i = p + j * up;
+            double h = 0.0;
+            if (i < n) {
+                double t = i - (n - 1) / 2.0, u = 2.0 * i / (n - 1) - 1.0;
+                h = 2.0 * fc * (0.0 == t ? 1.0 : sin(2.0 * M_PI * fc * t) / (2.0 * M_PI * fc * t));
+                h *= bessel_i0(RS_KAISER_BETA * sqrt(u * u < 1.0 ? 1.0 - u * u : 0.0)) / i0_beta;
+            }
+            c[taps - 1 - j] = (float)h;
+            sum += h;
+        }
+        for (uint32_t j = 0; j < taps; j++) {
+            c[j] = (float)(c[j] / sum);
+        }
+    }
+
+    /*
+     * int16 path: the vector kernels keep even and odd taps in separate 32
+     * bit accumulators, so full scale input against every coefficient's
+     * sign must fit either one.
+     */
+    for (uint32_t i = 0; i < taps * up; i++) {
+        long q = lrint(r->coef[i] * 32768.0);
+        r->coef_q15[i] = q > 32767 ? 32767 : q < -32768 ? -32768 : (int16_t)q;
+    }
+    for (uint32_t p = 0; p < up; p++) {
+        int32_t half[2] = {0, 0};
+        for (uint32_t j = 0; j < taps; j++) {
+            half[j & 1] += abs(r->coef_q15[p * taps + j]);
+        }
+        if (half[0] > 65535 || half[1] > 65535) {
+            return -1;
+        }
+    }
+
+    r->dc_r = 1.0f - 2.0f * (float)M_PI * RS_DC_HZ / cfg->rate_in;
+    r->dc_r_q15 = (int32_t)lrintf(r->dc_r * 32768.0f);
+    return 0;
+}
+
+void rs_reset(rs_t *r)
+{
+    memset(r->buf, 0, sizeof(r->buf));
+    memset(r->buf16, 0, sizeof(r->buf16));
+    memset(r->dc_x, 0, sizeof(r->dc_x));
+    memset(r->dc_y, 0, sizeof(r->dc_y));
+    memset(r->dc_x16, 0, sizeof(r->dc_x16));
+    memset(r->dc_y16, 0, sizeof(r->dc_y16));
+    r->pos = 0;
+    r->phase = 0;
+}
+
+uint32_t rs_out_max(const rs_t *r, uint32_t frames)
+{
+    return (uint32_t)(((uint64_t)frames * r->up + r->down - 1) / r->down) + 1;
+}
+
+/* deinterleave, DC block and downmix into the block part of the buffers */
+static void load_f32_ref(rs_t *r, const float *in, uint32_t nb)
+{
+    uint32_t ch = r->cfg.channels, t0 = r->taps - 1;
+
+    for (uint32_t i = 0; i < nb; i++) {
+        float x[2];
+        for (uint32_t c = 0; c < ch; c++) {
+            x[c] = in[i * ch + c];
+            if (r->cfg.dc_block) {
+                float y = x[c] - r->dc_x[c] + r->dc_r * r->dc_y[c];
+                r->dc_x[c] = x[c];
+                r->dc_y[c] = y;
+                x[c] = y;
+            }
+        }
+        if (2 == ch && r->cfg.mono) {
+            r->buf[0][t0 + i] = 0.5f * (x[0] + x[1]);
+        } else {
+            for (uint32_t c = 0; c < ch; c++) {
+                r->buf[c][t0 + i] = x[c];
+            }
+        }
+    }
+}
+
+static void load_s16_ref(rs_t *r, const int16_t *in, uint32_t nb)
+{
+    uint32_t ch = r->cfg.channels, t0 = r->taps - 1;
+
+    for (uint32_t i = 0; i < nb; i++) {
+        int32_t x[2];
+        for (uint32_t c = 0; c < ch; c++) {
+            x[c] = in[i * ch + c];
+            if (r->cfg.dc_block) {
+                int64_t y = (int64_t)(x[c] - r->dc_x16[c]) * 32768 + ((r->dc_r_q15 * r->dc_y16[c]) >> 15);
+                r->dc_x16[c] = x[c];
+                r->dc_y16[c] = y;
+                x[c] = sat16((y + (1 << 14)) >> 15);
+            }
+        }
+        if (2 == ch && r->cfg.mono) {
+            r->buf16[0][t0 + i] = (x[0] + x[1]) >> 1;
+        } else {
+            for (uint32_t c = 0; c < ch; c++) {
+                r->buf16[c][t0 + i] = x[c];
+            }
+        }
+    }
+}
+
+static uint32_t filter_f32_ref(rs_t *r, uint32_t nb, float *out)
+{
+    uint32_t taps = r->taps, oc = r->out_channels, pos = r->pos, phase = r->phase, n = 0;
+
+    while (pos < nb) {
+        const float *c = r->coef + phase * taps;
+        for (uint32_t ch = 0; ch < oc; ch++) {
+            const float *x = r->buf[ch] + pos;
+            float sum = 0.0f;
+            for (uint32_t i = 0; i < taps; i++) {
+                sum += c[i] * x[i];
+            }
+            out[n * oc + ch] = sum;
+        }
+        n++;
+        phase += r->down;
+        pos += phase / r->up;
+        phase %= r->up;
+    }
+    r->pos = pos - nb;
+    r->phase = phase;
+    return n;
+}
+
+static uint32_t filter_s16_ref(rs_t *r, uint32_t nb, int16_t *out)
+{
+    uint32_t taps = r->taps, oc = r->out_channels, pos = r->pos, phase = r->phase, n = 0;
+
+    while (pos < nb) {
+        const int16_t *c = r->coef_q15 + phase * taps;
+        for (uint32_t ch = 0; ch < oc; ch++) {
+            const int16_t *x = r->buf16[ch] + pos;
+            int64_t sum = 0;
+            for (uint32_t i = 0; i < taps; i++) {
+                sum += c[i] * x[i];
+            }
+            out[n * oc + ch] = sat16((sum + (1 << 14)) >> 15);
+        }
+        n++;
+        phase += r->down;
+        pos += phase / r->up;
+        phase %= r->up;
+    }
+    r->pos = pos - nb;
+    r->phase = phase;
+    return n;
+}
+
+/* the block's newest taps - 1 inputs become the next block's history */
+static void shift_f32(rs_t *r, uint32_t nb)
+{
+    for (uint32_t ch = 0; ch < r->out_channels; ch++) {
+        memmove(r->buf[ch], r->buf[ch] + nb, (r->taps - 1) * sizeof(float));
+    }
+}
+
+static void shift_s16(rs_t *r, uint32_t nb)
+{
+    for (uint32_t ch = 0; ch < r->out_channels; ch++) {
+        memmove(r->buf16[ch], r->buf16[ch] + nb, (r->taps - 1) * sizeof(int16_t));
+    }
+}
+
+uint32_t rs_process_f32_ref(rs_t *r, const float *in, uint32_t frames, float *out)
+{
+    uint32_t n = 0;
+
+    while (frames) {
+        uint32_t nb = frames < RS_BLOCK ? frames : RS_BLOCK;
+        load_f32_ref(r, in, nb);
+        n += filter_f32_ref(r, nb, out + n * r->out_channels);
+        shift_f32(r, nb);
+        in += nb * r->cfg.channels;
+        frames -= nb;
+    }
+    return n;
+}
+
+uint32_t rs_process_s16_ref(rs_t *r, const int16_t *in, uint32_t frames, int16_t *out)
+{
+    uint32_t n = 0;
+
+    while (frames) {
+        uint32_t nb = frames < RS_BLOCK ? frames : RS_BLOCK;
+        load_s16_ref(r, in, nb);
+        n += filter_s16_ref(r, nb, out + n * r->out_channels);
+        shift_s16(r, nb);
+        in += nb * r->cfg.channels;
+        frames -= nb;
+    }
+    return n;
+}
+
+#if RS_USE_RVV
+/* strided loads do the deinterleave; the DC blocker is recursive and stays scalar */
+static void load_f32_rvv(rs_t *r, const float *in, uint32_t nb)
+{
+    uint32_t ch = r->cfg.channels, t0 = r->taps - 1;
+    ptrdiff_t stride = ch * sizeof(float);
+
+    if (r->cfg.dc_block) {
+        load_f32_ref(r, in, nb);
+        return;
+    }
+    for (size_t vl, i = 0; i < nb; i += vl, in += vl * ch) {
+        vl = vsetvl_e32m4(nb - i);
+        vfloat32m4_t x0 = vlse32_v_f32m4(in, stride, vl);
+        if (1 == ch) {
+            vse32_v_f32m4(r->buf[0] + t0 + i, x0, vl);
+            continue;
+        }
+        vfloat32m4_t x1 = vlse32_v_f32m4(in + 1, stride, vl);
+        if (r->cfg.mono) {
+            vse32_v_f32m4(r->buf[0] + t0 + i, vfmul_vf_f32m4(vfadd_vv_f32m4(x0, x1, vl), 0.5f, vl), vl);
+        } else {
+            vse32_v_f32m4(r->buf[0] + t0 + i, x0, vl);
+            vse32_v_f32m4(r->buf[1] + t0 + i, x1, vl);
+        }
+    }
+}
+
+static void load_s16_rvv(rs_t *r, const int16_t *in, uint32_t nb)
+{
+    uint32_t ch = r->cfg.channels, t0 = r->taps - 1;
+    ptrdiff_t stride = ch * sizeof(int16_t);
+
+    if (r->cfg.dc_block) {
+        load_s16_ref(r, in, nb);
+        return;
+    }
+    for (size_t vl, i = 0; i < nb; i += vl, in += vl * ch) {
+        vl = vsetvl_e16m2(nb - i);
+        vint16m2_t x0 = vlse16_v_i16m2(in, stride, vl);
+        if (1 == ch) {
+            vse16_v_i16m2(r->buf16[0] + t0 + i, x0, vl);
+            continue;
+        }
+        vint16m2_t x1 = vlse16_v_i16m2(in + 1, stride, vl);
+        if (r->cfg.mono) {
+            vse16_v_i16m2(r->buf16[0] + t0 + i, vnsra_wx_i16m2(vwadd_vv_i32m4(x0, x1, vl), 1, vl), vl);
+        } else {
+            vse16_v_i16m2(r->buf16[0] + t0 + i, x0, vl);
+            vse16_v_i16m2(r->buf16[1] + t0 + i, x1, vl);
+        }
+    }
+}
+
+/*
+ * L == 1: consecutive outputs are down inputs apart and share the one
+ * phase, so a vector holds that many outputs and each tap is one strided
+ * load and one multiply-add, with no reductions.
+ */
+static uint32_t decimate_f32_rvv(rs_t *r, uint32_t nb, float *out)
+{
+    uint32_t taps = r->taps, oc = r->out_channels, m = r->down, pos = r->pos;
+    uint32_t count = pos < nb ? (nb - pos + m - 1) / m : 0;
+    ptrdiff_t stride = m * sizeof(float), ostride = oc * sizeof(float);
+
+    for (uint32_t ch = 0; ch < oc; ch++) {
+        for (size_t vl, k = 0; k < count; k += vl) {
+            const float *x = r->buf[ch] + pos + k * m;
+            vl = vsetvl_e32m4(count - k);
+            vfloat32m4_t acc = vfmv_v_f_f32m4(0.0f, vl);
+            for (uint32_t i = 0; i < taps; i++) {
+                acc = vfmacc_vf_f32m4(acc, r->coef[i], vlse32_v_f32m4(x + i, stride, vl), vl);
+            }
+            vsse32_v_f32m4(out + k * oc + ch, ostride, acc, vl);
+        }
+    }
+    r->pos = pos + count * m - nb;
+    return count;
+}
+
+/*
+ * Products widen into 32 bit lanes, even and odd taps into separate
+ * accumulators (rs_init() makes sure neither can overflow, and the two
+ * chains overlap). Their sum needs 33 bits: add the high parts and the
+ * carry out of the low parts instead, then vnclip saturates.
+ */
+static uint32_t decimate_s16_rvv(rs_t *r, uint32_t nb, int16_t *out)
+{
+    uint32_t taps = r->taps, oc = r->out_channels, m = r->down, pos = r->pos;
+    uint32_t count = pos < nb ? (nb - pos + m - 1) / m : 0;
+    ptrdiff_t stride = m * sizeof(int16_t), ostride = oc * sizeof(int16_t);
+    const int16_t *c = r->coef_q15;
+
+    for (uint32_t ch = 0; ch < oc; ch++) {
+        for (size_t vl, k = 0; k < count; k += vl) {
+            const int16_t *x = r->buf16[ch] + pos + k * m;
+            vl = vsetvl_e16m2(count - k);
+            vint32m4_t even = vmv_v_x_i32m4(0, vl), odd = even;
+            uint32_t i = 0;
+            for (; i + 1 < taps; i += 2) {
+                even = vwmacc_vx_i32m4(even, c[i], vlse16_v_i16m2(x + i, stride, vl), vl);
+                odd = vwmacc_vx_i32m4(odd, c[i + 1], vlse16_v_i16m2(x + i + 1, stride, vl), vl);
+            }
+            if (i < taps) {
+                even = vwmacc_vx_i32m4(even, c[i], vlse16_v_i16m2(x + i, stride, vl), vl);
+            }
+            vint32m4_t hi = vadd_vv_i32m4(vsra_vx_i32m4(even, 15, vl), vsra_vx_i32m4(odd, 15, vl), vl);
+            vint32m4_t lo = vadd_vv_i32m4(vand_vx_i32m4(even, 0x7fff, vl), vand_vx_i32m4(odd, 0x7fff, vl), vl);
+            hi = vadd_vv_i32m4(hi, vsra_vx_i32m4(vadd_vx_i32m4(lo, 1 << 14, vl), 15, vl), vl);
+            vsse16_v_i16m2(out + k * oc + ch, ostride, vnclip_wx_i16m2(hi, 0, vl), vl);
+        }
+    }
+    r->pos = pos + count * m - nb;
+    return count;
+}
+
+/* other ratios: each output has its own phase, one vector dot product per output (int16 reduces into 64 bits) */
+static uint32_t filter_f32_rvv(rs_t *r, uint32_t nb, float *out)
+{
+    uint32_t taps = r->taps, oc = r->out_channels, pos = r->pos, phase = r->phase, n = 0;
+    size_t vl = vsetvl_e32m1(1);
+    vfloat32m1_t zero = vfmv_v_f_f32m1(0.0f, vl);
+
+    if (1 == r->up) {
+        return decimate_f32_rvv(r, nb, out);
+    }
+    while (pos < nb) {
+        for (uint32_t ch = 0; ch < oc; ch++) {
+            const float *c = r->coef + phase * taps, *x = r->buf[ch] + pos;
+            vfloat32m1_t sum = zero;
+            for (size_t left = taps; left > 0; left -= vl, c += vl, x += vl) {
+                vl = vsetvl_e32m8(left);
+                vfloat32m8_t p = vfmul_vv_f32m8(vle32_v_f32m8(c, vl), vle32_v_f32m8(x, vl), vl);
+                sum = vfredusum_vs_f32m8_f32m1(sum, p, sum, vl);
+            }
+            out[n * oc + ch] = vfmv_f_s_f32m1_f32(sum);
+        }
+        n++;
+        phase += r->down;
+        pos += phase / r->up;
+        phase %= r->up;
+    }
+    r->pos = pos - nb;
+    r->phase = phase;
+    return n;
+}
+
+static uint32_t filter_s16_rvv(rs_t *r, uint32_t nb, int16_t *out)
+{
+    uint32_t taps = r->taps, oc = r->out_channels, pos = r->pos, phase = r->phase, n = 0;
+    size_t vl = vsetvl_e64m1(1);
+    vint64m1_t zero = vmv_v_x_i64m1(0, vl);
+
+    if (1 == r->up) {
+        return decimate_s16_rvv(r, nb, out);
+    }
+    while (pos < nb) {
+        for (uint32_t ch = 0; ch < oc; ch++) {
+            const int16_t *c = r->coef_q15 + phase * taps, *x = r->buf16[ch] + pos;
+            vint64m1_t sum = zero;
+            for (size_t left = taps; left > 0; left -= vl, c += vl, x += vl) {
+                vl = vsetvl_e16m4(left);
+                vint32m8_t p = vwmul_vv_i32m8(vle16_v_i16m4(c, vl), vle16_v_i16m4(x, vl), vl);
+                sum = vwredsum_vs_i32m8_i64m1(sum, p, sum, vl);
+            }
+            out[n * oc + ch] = sat16((vmv_x_s_i64m1_i64(sum) + (1 << 14)) >> 15);
+        }
+        n++;
+        phase += r->down;
+        pos += phase / r->up;
+        phase %= r->up;
+    }
+    r->pos = pos - nb;
+    r->phase = phase;
+    return n;
+}
+
+uint32_t rs_process_f32(rs_t *r, const float *in, uint32_t frames, float *out)
+{
+    uint32_t n = 0;
+
+    while (frames) {
+        uint32_t nb = frames < RS_BLOCK ? frames : RS_BLOCK;
+        load_f32_rvv(r, in, nb);
+        n += filter_f32_rvv(r, nb, out + n * r->out_channels);
+        shift_f32(r, nb);
+        in += nb * r->cfg.channels;
+        frames -= nb;
+    }
+    return n;
+}
+
+uint32_t rs_process_s16(rs_t *r, const int16_t *in, uint32_t frames, int16_t *out)
+{
+    uint32_t n = 0;
+
+    while (frames) {
+        uint32_t nb = frames < RS_BLOCK ? frames : RS_BLOCK;
+        load_s16_rvv(r, in, nb);
+        n += filter_s16_rvv(r, nb, out + n * r->out_channels);
+        shift_s16(r, nb);
+        in += nb * r->cfg.channels;
+        frames -= nb;
+    }
+    return n;
+}
+#else
+uint32_t rs_process_f32(rs_t *r, const float *in, uint32_t frames, float *out)
+{
+    return rs_process_f32_ref(r, in, frames, out);
+}
+
+uint32_t rs_process_s16(rs_t *r, const int16_t *in, uint32_t frames, int16_t *out)
+{
+    return rs_process_s16_ref(r, in, frames, out);
+}
+#endif
@@ -0,0 +1,88 @@
+#ifndef __RESAMPLE_H__
+#define __RESAMPLE_H__
+
+#include <stdint.h>
+
+/*
+ * Polyphase FIR sample rate conversion by rate_out / rate_in reduced to
+ * L / M: up by L, low-pass, down by M, only computing the outputs that are
+ * kept. L == 1 is plain decimation (or filtering, with M == 1 too) and
+ * runs vectorised across outputs; other ratios run one dot product per
+ * output.
+ *
+ * The prototype is a Kaiser windowed sinc (beta 8, about 80 dB stopband)
+ * with zero_crossings per side at the lower of the two rates. Its stopband
+ * starts at the lower Nyquist frequency and the passband ends at
+ * 1 - 5.1 / zero_crossings of it: 0.79 for the default 24. Every phase is
+ * normalised to unity DC gain. The prototype has to fit RS_MAX_COEFFS, so
+ * awkward ratios (44.1 kHz to 16 kHz is 160 / 441) take fewer crossings.
+ *
+ * Input is interleaved, one or two channels. Two channels stay two,
+ * interleaved again on output, or are averaged to one first (mono). An
+ * optional DC blocker (one pole high-pass at RS_DC_HZ) runs on the input.
+ *
+ * int16 (Q15 coefficients, exact sums, rounded and saturated) and float
+ * paths. Kernels use RVV when the compiler targets it (__riscv_vector),
+ * define RS_FORCE_SCALAR to build the scalar reference only; the *_ref
+ * functions are always available for checking the vector paths. One rs_t
+ * runs one stream, with one of the two paths.
+ */
+
+#define RS_MAX_PHASES (160)
+#define RS_MAX_TAPS (256) /* per output */
+#define RS_MAX_COEFFS (8192)
+#define RS_BLOCK (256) /* input frames per pass */
+#define RS_DC_HZ (10.0f)
+
+typedef struct {
+    uint32_t rate_in;
+    uint32_t rate_out;
+    uint32_t channels; /* 1 or 2, interleaved */
+    int mono;          /* average two channels to one */
+    int dc_block;
+    uint32_t zero_crossings;
+} rs_cfg_t;
+
+typedef struct {
+    rs_cfg_t cfg;
+    uint32_t up, down; /* L, M */
+    uint32_t taps;     /* per output */
+    uint32_t out_channels;
+    float passband; /* fraction of the lower Nyquist */
+
+    float coef[RS_MAX_COEFFS]; /* [phase][taps], each phase reversed */
+    int16_t coef_q15[RS_MAX_COEFFS];
+
+    /* per output channel: taps - 1 samples of history, then the block */
+    float buf[2][RS_MAX_TAPS + RS_BLOCK];
+    int16_t buf16[2][RS_MAX_TAPS + RS_BLOCK];
+    uint32_t pos;   /* next output's newest input, into the block */
+    uint32_t phase; /* and its phase */
+
+    /* DC blocker, per input channel */
+    float dc_x[2], dc_y[2];
+    int32_t dc_x16[2];
+    int64_t dc_y16[2]; /* Q15 */
+    float dc_r;
+    int32_t dc_r_q15;
+} rs_t;
+
+/* 16 kHz to 16 kHz, mono, no DC blocker, 24 zero crossings: fill in the rates */
+void rs_default_cfg(rs_cfg_t *cfg);
+
+/* Returns 0, or -1 when the ratio or channel setup is outside the limits. */
+int rs_init(rs_t *r, const rs_cfg_t *cfg);
+
+/* forget the stream */
+void rs_reset(rs_t *r);
+
+/* the most output frames rs_process_*() can return for frames of input */
+uint32_t rs_out_max(const rs_t *r, uint32_t frames);
+
+/* Takes frames of interleaved input, returns the output frames written to out. */
+uint32_t rs_process_s16(rs_t *r, const int16_t *in, uint32_t frames, int16_t *out);
+uint32_t rs_process_s16_ref(rs_t *r, const int16_t *in, uint32_t frames, int16_t *out);
+uint32_t rs_process_f32(rs_t *r, const float *in, uint32_t frames, float *out);
+uint32_t rs_process_f32_ref(rs_t *r, const float *in, uint32_t frames, float *out);
+
+#endif /* __RESAMPLE_H__ */
@@ -0,0 +1,365 @@
+/*
+ * audio_check - the capture ring, sink and WAV writer on the host.
+ *
+ * A producer thread plays the audio driver: AUDIO_SYNTH_COUNT samples in
+ * bursts of random size, each written to the ring once. A consumer thread
+ * runs audio_sink_step() into a WAV file and checkpoints it now and then,
+ * checking each time that the header on disk already describes what was
+ * written. The file is then read back: RIFF/fmt/data fields, sizes, and
+ * every sample against the index it should carry.
+ *
+ *   lossless  the producer only writes a burst when it fits, so the file
+ *             has to be the exact, gapless count with no overrun
+ *   overrun   a small ring and a consumer that sleeps; the producer keeps
+ *             what audio_ring_write() took of each burst, the file has to
+ *             be exactly those samples, and the drop and overrun counters
+ *             have to agree with what was refused
+ *   underrun  the sink on a made up clock: one underrun per silence of
+ *             starve_ms or more, none for shorter gaps
+ *
+ * Build and run on Linux:
+ *   cc -O2 -pthread -I.. -o audio_check audio_check.c ../audio_ring.c ../audio_sink.c ../wav_writer.c ../audio_synth.c
+ *   ./audio_check -n 2000000
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "audio_ring.h"
+#include "audio_sink.h"
+#include "audio_synth.h"
+#include "wav_writer.h"
+
+#define RATE (16000)
+#define MAX_BURST (512)
+#define BLOCK (256)
+#define CHECKPOINT_BLOCKS (200)
+
+static uint32_t nsamples = 2000000;
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+typedef struct {
+    const char *path;
+    audio_ring_t ring;
+    int16_t *ring_buf;
+    int lossless;         /* producer waits for room instead of dropping */
+    uint32_t consumer_us; /* consumer sleep after each block */
+
+    volatile int producing;
+    uint32_t *accepted; /* producer: the indices that went into the ring, in order */
+    uint32_t naccepted;
+    uint32_t refused;
+    uint32_t partial_bursts;
+    uint32_t samples; /* consumer: written */
+    int error;
+} run_t;
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static double now_s(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static inline uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static void *producer(void *arg)
+{
+    run_t *run = arg;
+    audio_synth_t synth;
+    int16_t burst[MAX_BURST];
+    uint32_t s = seed;
+
+    audio_synth_init(&synth, AUDIO_SYNTH_COUNT, RATE, 0);
+    while (synth.index < nsamples) {
+        uint32_t first = synth.index;
+        uint32_t n = 1 + xorshift(&s) % MAX_BURST;
+        if (n > nsamples - first) {
+            n = nsamples - first;
+        }
+        if (run->lossless) {
+            while (run->ring.size - audio_ring_used(&run->ring) < n) {
+                sched_yield();
+            }
+        }
+        audio_synth_fill(&synth, burst, n);
+        uint32_t took = audio_ring_write(&run->ring, burst, n);
+        for (uint32_t i = 0; i < took; i++) {
+            run->accepted[run->naccepted++] = first + i;
+        }
+        if (took < n) {
+            run->refused += n - took;
+            run->partial_bursts++;
+        }
+        if (0 == (xorshift(&s) & 7)) {
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&run->producing, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/* the header on disk while the writer still has the file open */
+static void check_checkpoint(const char *path, uint32_t samples)
+{
+    uint8_t hdr[WAV_HDR_SIZE];
+    FILE *f = fopen(path, "rb");
+
+    CHECK(f && WAV_HDR_SIZE == fread(hdr, 1, WAV_HDR_SIZE, f), "%s: no header at checkpoint", path);
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        CHECK(get32(hdr + 40) == samples * 2, "checkpoint: data size %u, %u samples written", get32(hdr + 40),
+              samples);
+        CHECK(get32(hdr + 4) == 36 + samples * 2, "checkpoint: RIFF size %u", get32(hdr + 4));
+        CHECK(ftell(f) >= (long)(WAV_HDR_SIZE + samples * 2), "checkpoint: file %ld bytes, %u samples", ftell(f),
+              samples);
+        fclose(f);
+    }
+}
+
+static void *consumer(void *arg)
+{
+    run_t *run = arg;
+    audio_sink_t sink;
+    wav_writer_t wav;
+    int16_t block[BLOCK];
+    uint32_t blocks = 0;
+
+    if (0 != wav_open(&wav, run->path, RATE, 1)) {
+        run->error = 1;
+        return NULL;
+    }
+    audio_sink_init(&sink, &run->ring, &wav, 1000, 0);
+    for (;;) {
+        int producing = __atomic_load_n(&run->producing, __ATOMIC_ACQUIRE);
+        int n = audio_sink_step(&sink, 0, block, BLOCK);
+        if (n < 0) {
+            run->error = 1;
+            break;
+        }
+        if (0 == n) {
+            if (!producing) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        if (0 == ++blocks % CHECKPOINT_BLOCKS) {
+            CHECK(0 == wav_checkpoint(&wav), "wav_checkpoint");
+            check_checkpoint(run->path, sink.samples);
+        }
+        if (run->consumer_us) {
+            usleep(run->consumer_us);
+        }
+    }
+    run->samples = sink.samples;
+    if (0 != wav_close(&wav)) {
+        run->error = 1;
+    }
+    return NULL;
+}
+
+/* The file against the indices the producer got into the ring. */
+static void verify(run_t *run)
+{
+    uint8_t hdr[WAV_HDR_SIZE];
+    int16_t buf[4096];
+    uint32_t at = 0, bad = 0;
+    FILE *f = fopen(run->path, "rb");
+
+    CHECK(f, "%s: can't open", run->path);
+    if (!f) {
+        return;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    CHECK(WAV_HDR_SIZE == fread(hdr, 1, WAV_HDR_SIZE, f), "short header");
+    CHECK(0 == memcmp(hdr, "RIFF", 4) && 0 == memcmp(hdr + 8, "WAVEfmt ", 8) && 0 == memcmp(hdr + 36, "data", 4),
+          "not RIFF/WAVE/fmt/data");
+    CHECK(get32(hdr + 16) == 16 && get16(hdr + 20) == 1 && get16(hdr + 22) == 1, "fmt: not 16 byte PCM mono");
+    CHECK(get32(hdr + 24) == RATE && get32(hdr + 28) == RATE * 2, "fmt: rate %u, byte rate %u", get32(hdr + 24),
+          get32(hdr + 28));
+    CHECK(get16(hdr + 32) == 2 && get16(hdr + 34) == 16, "fmt: block align %u, %u bits", get16(hdr + 32),
+          get16(hdr + 34));
+    CHECK(get32(hdr + 40) == run->samples * 2, "data size %u, %u samples written", get32(hdr + 40), run->samples);
+    CHECK(get32(hdr + 4) == 36 + run->samples * 2, "RIFF size %u", get32(hdr + 4));
+    CHECK(size == (long)(WAV_HDR_SIZE + run->samples * 2), "file is %ld bytes", size);
+    CHECK(run->samples == run->naccepted, "%u samples in the file, %u went into the ring", run->samples,
+          run->naccepted);
+
+    size_t n;
+    while ((n = fread(buf, 2, 4096, f)) > 0) {
+        for (size_t i = 0; i < n; i++, at++) {
+            if (at >= run->naccepted || buf[i] != audio_synth_count_sample(run->accepted[at])) {
+                if (bad++ < 5) {
+                    printf("FAIL: sample %u is %d (index %u mod 2^16), expected index %u\n", at, buf[i],
+                           audio_synth_count_index(buf[i]), at < run->naccepted ? run->accepted[at] : 0);
+                }
+            }
+        }
+    }
+    CHECK(0 == bad, "%u samples out of place", bad);
+    fclose(f);
+}
+
+static void run(const char *path, const char *name, uint32_t ring_size, int lossless, uint32_t consumer_us)
+{
+    run_t r;
+    pthread_t pt, ct;
+    double t;
+
+    memset(&r, 0, sizeof(r));
+    r.path = path;
+    r.lossless = lossless;
+    r.consumer_us = consumer_us;
+    r.ring_buf = malloc(ring_size * sizeof(int16_t));
+    r.accepted = malloc(nsamples * sizeof(uint32_t));
+    if (!r.ring_buf || !r.accepted || 0 != audio_ring_init(&r.ring, r.ring_buf, ring_size)) {
+        CHECK(0, "%s: setup", name);
+        free(r.ring_buf);
+        free(r.accepted);
+        return;
+    }
+
+    r.producing = 1;
+    t = now_s();
+    pthread_create(&ct, NULL, consumer, &r);
+    pthread_create(&pt, NULL, producer, &r);
+    pthread_join(pt, NULL);
+    pthread_join(ct, NULL);
+    t = now_s() - t;
+
+    CHECK(!r.error, "%s: write error", name);
+    verify(&r);
+    CHECK(r.ring.dropped == r.refused, "%s: ring dropped %u, producer saw %u refused", name, r.ring.dropped,
+          r.refused);
+    CHECK(r.ring.overruns == r.partial_bursts, "%s: %u overruns, %u bursts cut short", name, r.ring.overruns,
+          r.partial_bursts);
+    CHECK(r.naccepted + r.refused == nsamples, "%s: %u in + %u dropped != %u", name, r.naccepted, r.refused, nsamples);
+    if (lossless) {
+        CHECK(0 == r.ring.overruns && r.samples == nsamples, "%s: %u of %u samples, %u overruns", name, r.samples,
+              nsamples, r.ring.overruns);
+    } else {
+        CHECK(r.ring.overruns > 0, "%s: the consumer never fell behind", name);
+    }
+    printf("%s: %u samples in %u, %u overruns (%u dropped), %.1f Msamples/s\n", name, r.samples, nsamples,
+           r.ring.overruns, r.ring.dropped, nsamples / t / 1e6);
+
+    free(r.ring_buf);
+    free(r.accepted);
+}
+
+/* the starvation detector, single threaded on a clock of our own */
+static void underrun(void)
+{
+    audio_ring_t ring;
+    int16_t ring_buf[1024], block[BLOCK], burst[64];
+    audio_synth_t synth;
+    audio_sink_t sink;
+    wav_writer_t wav;
+    const char *path = "/tmp/audio_check_underrun.wav";
+    uint32_t ms = 0;
+
+    audio_ring_init(&ring, ring_buf, 1024);
+    audio_synth_init(&synth, AUDIO_SYNTH_COUNT, RATE, 0);
+    CHECK(0 == wav_open(&wav, path, RATE, 1), "%s: wav_open", path);
+    audio_sink_init(&sink, &ring, &wav, 100, ms);
+
+    /* a buffer every 4 ms, then gaps of 50, 150 and 250 ms, the last two starve */
+    uint32_t gaps[] = {4, 4, 50, 4, 150, 4, 4, 250, 4};
+    for (uint32_t g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++) {
+        for (uint32_t t = 0; t < gaps[g]; t++) {
+            audio_sink_step(&sink, ms++, block, BLOCK);
+        }
+        audio_synth_fill(&synth, burst, 64);
+        audio_ring_write(&ring, burst, 64);
+    }
+    audio_sink_step(&sink, ms, block, BLOCK);
+    CHECK(2 == sink.underruns, "%u underruns for two starved gaps", sink.underruns);
+    CHECK(sink.samples == synth.index, "%u of %u samples written", sink.samples, synth.index);
+    CHECK(0 == ring.overruns, "%u overruns", ring.overruns);
+    CHECK(0 == wav_close(&wav), "wav_close");
+    unlink(path);
+    printf("underrun: %u underruns over %u ms\n", sink.underruns, ms);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = "/tmp/audio_check.wav";
+    uint32_t ring_size = 16 * 1024;
+    int keep = 0, opt;
+
+    while ((opt = getopt(argc, argv, "o:n:r:s:kh")) != -1) {
+        switch (opt) {
+            case 'o':
+                path = optarg;
+                break;
+            case 'n':
+                nsamples = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                ring_size = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keep = 1;
+                break;
+            default:
+                printf("Usage: %s [-o file.wav] [-n samples] [-r ring samples] [-s seed] [-k]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (0 == nsamples || 0 == seed || ring_size < MAX_BURST || (ring_size & (ring_size - 1))) {
+        printf("samples and seed must be > 0, the ring a power of 2 of at least %u\n", MAX_BURST);
+        return 2;
+    }
+
+    run(path, "lossless", ring_size, 1, 0);
+    run(path, "overrun", 1024, 0, 50);
+    underrun();
+
+    if (!keep) {
+        unlink(path);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,459 @@
+/*
+ * capture_check - the period capture layer with a fake audio device.
+ *
+ * The device plays the audio hardware: every chunk (4 ms of
+ * AUDIO_SYNTH_COUNT samples by default, or random sizes around it with -v)
+ * is handed to audio_capture_write() when its last sample is due, as an
+ * interrupt handler would. The processing task sleeps until notified, like
+ * the board's audio_proc task in ulTaskNotifyTake(pdTRUE, ...), and checks
+ * every period it gets: sequence numbers one after the other, the first
+ * sample index matching the sequence, every sample carrying its own index,
+ * and the timestamp not before the period's last sample was due.
+ *
+ * The asserted runs are a simulation on a virtual microsecond clock, no
+ * threads: the device preempts the task, the task spends exactly its work
+ * time on each period, so every run is the same on any machine:
+ *
+ *   gapless   -w us of work per period: no period may be lost
+ *   tight     work one microsecond short of a period, less the longest
+ *             chunk with -v, the most the two buffers allow: still none
+ *             lost
+ *   stall     the task holds a period for three periods now and then; the
+ *             periods lost must be exactly the gaps it sees, and everything
+ *             it does get must still be intact
+ *   unit      two periods fit, the rest of a burst is lost whole, partial
+ *             writes assemble, a release frees exactly one
+ *
+ * The same gapless and stall runs then go once more on real threads, a
+ * timer thread for the device and a mutex and condition variable for the
+ * notification, -x times faster than real time. Their data is checked the
+ * same way, but whether the host runs the threads in time is not up to
+ * the code under test: the periods they lose, released late or device
+ * chunks late are printed, not checked.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -pthread -I.. -o capture_check capture_check.c ../audio_capture.c ../audio_synth.c
+ *   ./capture_check -t 3600 -x 20 -v
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_capture.h"
+#include "audio_synth.h"
+
+#define RATE (16000)
+#define PERIOD (256)
+#define CHUNK (64)
+#define MAX_CHUNK (4 * CHUNK)
+
+static double seconds = 120, speed = 10;
+static uint32_t work_us = 200;
+static int vary;
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static struct timespec t0;
+
+static double real_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (t.tv_sec - t0.tv_sec) + (t.tv_nsec - t0.tv_nsec) / 1e9;
+}
+
+/* the device's clock, speed times real time */
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(real_s() * speed * 1000);
+}
+
+/* xTaskNotifyGive() / ulTaskNotifyTake(pdTRUE, timeout) */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t count;
+    uint32_t given;
+} notify_t;
+
+static void notify_give(void *arg)
+{
+    notify_t *n = arg;
+    pthread_mutex_lock(&n->lock);
+    n->count++;
+    n->given++;
+    pthread_cond_signal(&n->cond);
+    pthread_mutex_unlock(&n->lock);
+}
+
+static uint32_t notify_take(notify_t *n, uint32_t timeout_ms)
+{
+    struct timespec until;
+    uint32_t count;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += (long)timeout_ms * 1000000;
+    until.tv_sec += until.tv_nsec / 1000000000;
+    until.tv_nsec %= 1000000000;
+    pthread_mutex_lock(&n->lock);
+    while (0 == n->count) {
+        if (ETIMEDOUT == pthread_cond_timedwait(&n->cond, &n->lock, &until)) {
+            break;
+        }
+    }
+    count = n->count;
+    n->count = 0;
+    pthread_mutex_unlock(&n->lock);
+    return count;
+}
+
+typedef struct {
+    const char *name;
+    audio_capture_t cap;
+    int16_t buf[AUDIO_CAPTURE_BUFS * PERIOD];
+    notify_t notify;
+    uint32_t stall_every; /* periods, 0 for never */
+    uint32_t total;       /* samples the device delivers */
+    volatile int running;
+
+    /* processing thread */
+    uint32_t got, gaps, gap_periods, bad_samples, bad_seq, bad_ts, wakeups, empty_wakeups;
+    uint32_t late;        /* released a period or more after it was due, the device may have needed the buffer */
+    uint32_t device_late; /* device: chunks half a period or more late, the host didn't run the "interrupt" */
+    uint32_t max_delay_ms;
+    uint32_t expect; /* next seq */
+} run_t;
+
+static void check_period(run_t *r, const audio_period_t *p, uint32_t now)
+{
+    if (p->seq != r->expect) {
+        r->gaps++;
+        r->gap_periods += p->seq - r->expect;
+    }
+    r->bad_seq += p->sample != (uint64_t)p->seq * PERIOD;
+    for (uint32_t i = 0; i < PERIOD; i++) {
+        r->bad_samples += p->pcm[i] != audio_synth_count_sample((uint32_t)p->sample + i);
+    }
+    /* the device's clock is sampled after the period's due time */
+    r->bad_ts += (uint64_t)p->ts_ms * RATE < (p->sample + PERIOD) * 1000 - RATE;
+    r->max_delay_ms = now - p->ts_ms > r->max_delay_ms ? now - p->ts_ms : r->max_delay_ms;
+    r->expect = p->seq + 1;
+    r->got++;
+}
+
+/* what holds for any run, however the periods were scheduled */
+static void check_run(run_t *r)
+{
+    const char *name = r->name;
+    uint32_t periods = r->total / PERIOD;
+
+    CHECK(r->cap.periods == periods, "%s: %u periods for %u samples", name, r->cap.periods, r->total);
+    CHECK(r->got + r->cap.lost == periods, "%s: %u got + %u lost != %u periods", name, r->got, r->cap.lost,
+          periods);
+    /* lost at the very end, nothing came after them to show the gap */
+    uint32_t trailing = periods - r->expect;
+    CHECK(r->gap_periods + trailing == r->cap.lost, "%s: %u periods missing in sequence, %u at the end, %u lost", name,
+          r->gap_periods, trailing, r->cap.lost);
+    CHECK(0 == r->bad_samples, "%s: %u samples out of place", name, r->bad_samples);
+    CHECK(0 == r->bad_seq, "%s: %u periods with the wrong first sample", name, r->bad_seq);
+    CHECK(0 == r->bad_ts, "%s: %u periods stamped before they were complete", name, r->bad_ts);
+    if (r->stall_every) {
+        CHECK(r->cap.lost > 0, "%s: stalls never lost a period", name);
+    }
+}
+
+static void count_notify(void *arg)
+{
+    (*(uint32_t *)arg)++;
+}
+
+static void *device(void *arg)
+{
+    run_t *r = arg;
+    audio_synth_t synth;
+    int16_t chunk[MAX_CHUNK];
+    uint32_t s = seed;
+
+    audio_synth_init(&synth, AUDIO_SYNTH_COUNT, RATE, 0);
+    while (synth.index < r->total) {
+        uint32_t n = vary ? 1 + xorshift(&s) % (2 * CHUNK - 1) : CHUNK;
+        n = n < r->total - synth.index ? n : r->total - synth.index;
+
+        /* the interrupt for these samples comes when the last of them is in */
+        double due = (double)(synth.index + n) / RATE / speed;
+        struct timespec ts = t0;
+        ts.tv_sec += (time_t)due;
+        ts.tv_nsec += (long)((due - (time_t)due) * 1e9);
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        r->device_late += (real_s() - due) * speed * RATE >= PERIOD / 2;
+
+        audio_synth_fill(&synth, chunk, n);
+        audio_capture_write(&r->cap, chunk, n, now_ms());
+    }
+    __atomic_store_n(&r->running, 0, __ATOMIC_RELEASE);
+    notify_give(&r->notify);
+    return NULL;
+}
+
+static void busy_us(uint32_t us)
+{
+    double end = real_s() + us / 1e6;
+    while (real_s() < end) {
+    }
+}
+
+static void *processing(void *arg)
+{
+    run_t *r = arg;
+    const audio_period_t *p;
+
+    for (;;) {
+        int running = __atomic_load_n(&r->running, __ATOMIC_ACQUIRE);
+        notify_take(&r->notify, 100);
+        r->wakeups++;
+        if (NULL == audio_capture_take(&r->cap)) {
+            r->empty_wakeups++;
+        }
+        while (NULL != (p = audio_capture_take(&r->cap))) {
+            check_period(r, p, now_ms());
+
+            busy_us(work_us);
+            if (r->stall_every && 0 == p->seq % r->stall_every) {
+                usleep((useconds_t)(3 * PERIOD * 1e6 / RATE / speed));
+            }
+            r->late += now_ms() - (p->sample + PERIOD) * 1000 / RATE >= PERIOD * 1000 / RATE - 1;
+            audio_capture_release(&r->cap);
+        }
+        if (!running) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void run(const char *name, uint32_t stall_every)
+{
+    run_t *r = calloc(1, sizeof(run_t));
+    pthread_t dt, pt;
+
+    r->name = name;
+    r->stall_every = stall_every;
+    r->total = (uint32_t)(seconds * RATE);
+    r->running = 1;
+    pthread_mutex_init(&r->notify.lock, NULL);
+    pthread_cond_init(&r->notify.cond, NULL);
+    audio_capture_init(&r->cap, r->buf, PERIOD, notify_give, &r->notify);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_create(&pt, NULL, processing, r);
+    pthread_create(&dt, NULL, device, r);
+    /* priorities as on the board, the device above the processing above everything else, where allowed */
+    struct sched_param sp = {.sched_priority = 2};
+    pthread_setschedparam(dt, SCHED_FIFO, &sp);
+    sp.sched_priority = 1;
+    pthread_setschedparam(pt, SCHED_FIFO, &sp);
+    pthread_join(dt, NULL);
+    pthread_join(pt, NULL);
+    double t = real_s();
+
+    check_run(r);
+    CHECK(r->notify.given == r->got + 1, "%s: %u notifications for %u periods", name, r->notify.given, r->got);
+    /* the host's scheduling, not the code's: reported only */
+    printf("%s: %.0f s of audio in %.1f s, %u periods, %u lost in %u gaps, %u released late, %u device chunks "
+           "late, %u wakeups (%u empty), delay up to %u ms\n",
+           name, seconds, t, r->total / PERIOD, r->cap.lost, r->gaps, r->late, r->device_late, r->wakeups,
+           r->empty_wakeups, r->max_delay_ms);
+    free(r);
+}
+
+/*
+ * The device and the task on a virtual clock in microseconds. The device
+ * is the interrupt: at a tie it goes first, and it runs while the task
+ * works. The task wakes on a notification, works work us on every period
+ * it takes (plus three periods on every stall_every-th) and releases it,
+ * then takes the next or sleeps again.
+ */
+static void sim(const char *name, uint32_t work, uint32_t stall_every, int gapless)
+{
+    run_t *r = calloc(1, sizeof(run_t));
+    audio_synth_t synth;
+    int16_t chunk[MAX_CHUNK];
+    uint32_t s = seed, pending = 0, n = 0;
+    uint64_t t = 0, dev_due = 0, busy_until = 0;
+    const audio_period_t *p = NULL; /* the period the task works on */
+
+    r->name = name;
+    r->stall_every = stall_every;
+    r->total = (uint32_t)(seconds * RATE);
+    audio_capture_init(&r->cap, r->buf, PERIOD, count_notify, &pending);
+    audio_synth_init(&synth, AUDIO_SYNTH_COUNT, RATE, 0);
+
+    for (;;) {
+        if (0 == n && synth.index < r->total) {
+            n = vary ? 1 + xorshift(&s) % (2 * CHUNK - 1) : CHUNK;
+            n = n < r->total - synth.index ? n : r->total - synth.index;
+            dev_due = (uint64_t)(synth.index + n) * 1000000 / RATE;
+        }
+        if (n && (NULL == p || dev_due <= busy_until)) {
+            t = dev_due;
+            audio_synth_fill(&synth, chunk, n);
+            audio_capture_write(&r->cap, chunk, n, (uint32_t)(t / 1000));
+            n = 0;
+        } else if (p) {
+            t = busy_until;
+            /* released a period or more after it was due: the device may have needed the buffer */
+            r->late += t - (p->sample + PERIOD) * 1000000 / RATE >= (uint64_t)PERIOD * 1000000 / RATE;
+            audio_capture_release(&r->cap);
+            p = NULL;
+        } else {
+            break; /* the device is done and so is the task */
+        }
+
+        if (NULL == p && (pending || r->got)) {
+            /* ulTaskNotifyTake() clears the count, then the task takes what there is */
+            r->wakeups += 0 != pending;
+            pending = 0;
+            if (NULL != (p = audio_capture_take(&r->cap))) {
+                check_period(r, p, (uint32_t)(t / 1000));
+                busy_until = t + work;
+                if (stall_every && 0 == p->seq % stall_every) {
+                    busy_until += 3ull * PERIOD * 1000000 / RATE;
+                }
+            }
+        }
+    }
+
+    check_run(r);
+    if (gapless) {
+        CHECK(0 == r->cap.lost, "%s: %u of %u periods lost with %u us of work each", name, r->cap.lost,
+              r->cap.periods, work);
+    }
+    printf("%s: %.0f s of audio, %u us of work a period, %u periods, %u lost in %u gaps, %u released late, "
+           "%u wakeups, delay up to %u ms\n",
+           name, seconds, work, r->cap.periods, r->cap.lost, r->gaps, r->late, r->wakeups, r->max_delay_ms);
+    free(r);
+}
+
+static void unit(void)
+{
+    static audio_capture_t cap;
+    int16_t buf[AUDIO_CAPTURE_BUFS * 8], in[64];
+    uint32_t notified = 0;
+    const audio_period_t *p;
+
+    for (uint32_t i = 0; i < 64; i++) {
+        in[i] = audio_synth_count_sample(i);
+    }
+    audio_capture_init(&cap, buf, 8, count_notify, &notified);
+    CHECK(NULL == audio_capture_take(&cap), "unit: period before any sample");
+
+    /* 3 + 5: one period out of two writes */
+    audio_capture_write(&cap, in, 3, 1);
+    CHECK(NULL == audio_capture_take(&cap) && 0 == notified, "unit: period after 3 of 8 samples");
+    audio_capture_write(&cap, in + 3, 5, 2);
+    p = audio_capture_take(&cap);
+    CHECK(p && 0 == p->seq && 0 == p->sample && 2 == p->ts_ms && 0 == memcmp(p->pcm, in, 8 * sizeof(int16_t)),
+          "unit: first period");
+    CHECK(1 == notified, "unit: %u notifications for one period", notified);
+
+    /* the task holds period 0, period 1 gets the other buffer, 2..6 are lost, 7 is half done */
+    audio_capture_write(&cap, in + 8, 52, 3);
+    CHECK(2 == notified && 5 == cap.lost && 7 == cap.periods, "unit: %u notified, %u lost of %u", notified,
+          cap.lost, cap.periods);
+    CHECK(p == audio_capture_take(&cap), "unit: take moved without a release");
+    CHECK(0 == memcmp(p->pcm, in, 8 * sizeof(int16_t)), "unit: held period overwritten");
+    audio_capture_release(&cap);
+    p = audio_capture_take(&cap);
+    CHECK(p && 1 == p->seq && 8 == p->sample && 0 == memcmp(p->pcm, in + 8, 8 * sizeof(int16_t)),
+          "unit: second period");
+
+    /* period 7 started without a buffer, it stays lost even though one is free now */
+    audio_capture_write(&cap, in + 60, 4, 4);
+    CHECK(6 == cap.lost && 2 == notified, "unit: %u lost after a period started without a buffer", cap.lost);
+    audio_capture_release(&cap);
+    CHECK(NULL == audio_capture_take(&cap), "unit: period out of nothing");
+
+    /* and the next one goes through, seq and first sample telling the gap */
+    audio_capture_write(&cap, in, 8, 5);
+    p = audio_capture_take(&cap);
+    CHECK(p && 8 == p->seq && 64 == p->sample && 3 == notified, "unit: period after the gap");
+    printf("unit: %u periods, %u lost\n", cap.periods, cap.lost);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-t seconds] [-x speed] [-w work us] [-v] [-s seed]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:x:w:vs:h")) != -1) {
+        switch (opt) {
+            case 't':
+                seconds = atof(optarg);
+                break;
+            case 'x':
+                speed = atof(optarg);
+                break;
+            case 'w':
+                work_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                vary = 1;
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (seconds <= 0 || speed <= 0 || 0 == seed) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    unit();
+    sim("gapless", work_us, 0, 1);
+    sim("tight", (PERIOD - (vary ? 2 * CHUNK : 0)) * 1000000 / RATE - 1, 0, 1);
+    sim("stall", work_us, 100, 0);
+    run("threads gapless", 0);
+    run("threads stall", 100);
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
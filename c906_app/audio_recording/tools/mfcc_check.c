@@ -0,0 +1,408 @@
+/*
+ * mfcc_check - mfcc.c against features computed the slow way, then timed.
+ *
+ * Every WAV given on the command line (16 bit mono at the configured rate)
+ * or, without any, a set of generated ones (tone, chirp, noise, clicks in
+ * silence, full scale square) written with wav_writer.c and read back, is
+ * run through mfcc_push() in random sized pieces. Each frame is compared
+ * with a double precision reference built here from the definition in
+ * mfcc.h: direct DFT, mel triangles evaluated per bin, textbook DCT-II.
+ * The same stream pushed in one piece has to give bit identical frames,
+ * and mfcc_frame() has to match mfcc_frame_ref() (identical on the host,
+ * where both are the scalar code; build with -D__riscv_vector against an
+ * RVV toolchain or an emulation header to compare the vector kernels).
+ *
+ * Three configurations: the default MFCCs, log-mel only, and an odd frame
+ * length with a smaller FFT.
+ *
+ * Then frames/s for mfcc_frame() and mfcc_frame_ref(), and how many times
+ * real time that is at the default 10 ms hop.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -o mfcc_check mfcc_check.c ../mfcc.c ../wav_writer.c -lm
+ *   ./mfcc_check [-b frames] [-s seed] [-k] [file.wav ...]
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "mfcc.h"
+#include "wav_writer.h"
+
+#define RATE (16000)
+#define GEN_SAMPLES (RATE * 2)
+#define TOL_LOGMEL (2e-3) /* natural log units, ~0.01 dB */
+#define TOL_MFCC (5e-3)
+
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static double now_s(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static inline uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/* 16 bit mono PCM, walking the chunks. Returns the samples (malloc'd) or NULL. */
+static int16_t *wav_load(const char *path, uint32_t *n, uint32_t *rate)
+{
+    uint8_t hdr[12], ch[8], fmt[16];
+    int16_t *pcm = NULL;
+    int have_fmt = 0;
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        return NULL;
+    }
+    if (12 != fread(hdr, 1, 12, f) || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) {
+        fclose(f);
+        return NULL;
+    }
+    while (8 == fread(ch, 1, 8, f)) {
+        uint32_t len = get32(ch + 4);
+        if (0 == memcmp(ch, "fmt ", 4) && len >= 16 && 16 == fread(fmt, 1, 16, f)) {
+            have_fmt = get16(fmt) == 1 && get16(fmt + 2) == 1 && get16(fmt + 14) == 16;
+            *rate = get32(fmt + 4);
+            fseek(f, (len - 16 + 1) & ~1u, SEEK_CUR);
+        } else if (0 == memcmp(ch, "data", 4) && have_fmt) {
+            *n = len / 2;
+            pcm = malloc(len + 2);
+            if (pcm && *n != fread(pcm, 2, *n, f)) {
+                free(pcm);
+                pcm = NULL;
+            }
+            break;
+        } else {
+            fseek(f, (len + 1) & ~1u, SEEK_CUR);
+        }
+    }
+    fclose(f);
+    return pcm;
+}
+
+static int wav_generate(const char *path, int kind)
+{
+    static int16_t pcm[GEN_SAMPLES];
+    wav_writer_t w;
+    uint32_t s = seed;
+    double phase = 0.0;
+
+    for (uint32_t i = 0; i < GEN_SAMPLES; i++) {
+        double t = (double)i / RATE, v;
+        switch (kind) {
+            case 0: /* 1 kHz, -6 dBFS */
+                v = 0.5 * sin(2.0 * M_PI * 1000.0 * t);
+                break;
+            case 1: /* 50 Hz to 7.5 kHz sweep */
+                phase += 2.0 * M_PI * (50.0 + 7450.0 * i / GEN_SAMPLES) / RATE;
+                v = 0.3 * sin(phase);
+                break;
+            case 2: /* white noise */
+                v = ((int32_t)(xorshift(&s) & 0xffff) - 32768) / 65536.0;
+                break;
+            case 3: /* clicks every 100 ms in digital silence */
+                v = 0 == i % (RATE / 10) ? 0.9 : 0.0;
+                break;
+            default: /* 440 Hz square at full scale */
+                v = fmod(t * 440.0, 1.0) < 0.5 ? 0.99997 : -1.0;
+                break;
+        }
+        pcm[i] = (int16_t)lrint(v * 32768.0);
+    }
+    if (0 != wav_open(&w, path, RATE, 1)) {
+        return -1;
+    }
+    wav_write(&w, pcm, GEN_SAMPLES);
+    return wav_close(&w);
+}
+
+/* the definition in mfcc.h, in double, with nothing shared with mfcc.c */
+static uint32_t reference(const mfcc_cfg_t *c, const int16_t *pcm, uint32_t n, double *out, uint32_t n_out)
+{
+    uint32_t len = c->frame_len, bins = c->nfft / 2 + 1, frames = 0;
+    double *y = malloc(n * sizeof(double));
+    double *cs = malloc(c->nfft * sizeof(double)), *sn = malloc(c->nfft * sizeof(double));
+    double *power = malloc(bins * sizeof(double)), logmel[MFCC_MAX_MELS];
+    double lo = 2595.0 * log10(1.0 + c->fmin / 700.0), hi = 2595.0 * log10(1.0 + c->fmax / 700.0);
+    double edge[MFCC_MAX_MELS + 2];
+
+    for (uint32_t i = 0; i < n; i++) {
+        y[i] = pcm[i] / 32768.0 - (double)c->preemph * (i ? pcm[i - 1] / 32768.0 : 0.0);
+    }
+    for (uint32_t i = 0; i < c->nfft; i++) {
+        cs[i] = cos(2.0 * M_PI * i / c->nfft);
+        sn[i] = sin(2.0 * M_PI * i / c->nfft);
+    }
+    for (uint32_t b = 0; b < c->n_mels + 2; b++) {
+        edge[b] = 700.0 * (pow(10.0, (lo + (hi - lo) * b / (c->n_mels + 1)) / 2595.0) - 1.0);
+    }
+
+    for (uint32_t start = 0; start + len <= n; start += c->hop, frames++) {
+        for (uint32_t k = 0; k < bins; k++) {
+            double re = 0.0, im = 0.0;
+            for (uint32_t i = 0; i < len; i++) {
+                double w = len > 1 ? 0.54 - 0.46 * cos(2.0 * M_PI * i / (len - 1)) : 1.0;
+                double v = y[start + i] * w;
+                re += v * cs[(uint64_t)k * i % c->nfft];
+                im -= v * sn[(uint64_t)k * i % c->nfft];
+            }
+            power[k] = re * re + im * im;
+        }
+        for (uint32_t b = 0; b < c->n_mels; b++) {
+            double sum = 0.0;
+            for (uint32_t k = 0; k < bins; k++) {
+                double f = (double)k * c->rate / c->nfft;
+                double up = (f - edge[b]) / (edge[b + 1] - edge[b]);
+                double down = (edge[b + 2] - f) / (edge[b + 2] - edge[b + 1]);
+                double w = fmin(up, down);
+                if (w > 0.0) {
+                    sum += w * power[k];
+                }
+            }
+            logmel[b] = log(fmax(sum, MFCC_LOG_FLOOR));
+        }
+        double *o = out + (size_t)frames * n_out;
+        if (0 == c->n_mfcc) {
+            memcpy(o, logmel, c->n_mels * sizeof(double));
+            continue;
+        }
+        for (uint32_t k = 0; k < c->n_mfcc; k++) {
+            double sum = 0.0;
+            for (uint32_t j = 0; j < c->n_mels; j++) {
+                sum += logmel[j] * cos(M_PI * k * (j + 0.5) / c->n_mels);
+            }
+            o[k] = sum * sqrt((0 == k ? 1.0 : 2.0) / c->n_mels);
+        }
+    }
+    free(y);
+    free(cs);
+    free(sn);
+    free(power);
+    return frames;
+}
+
+/* all of pcm through mfcc_push() in pieces of 1..max_piece samples */
+static uint32_t stream(mfcc_t *m, const int16_t *pcm, uint32_t n, uint32_t max_piece, float *out)
+{
+    uint32_t s = seed, frames = 0;
+
+    mfcc_reset(m);
+    while (n) {
+        uint32_t piece = 1 + xorshift(&s) % max_piece;
+        if (piece > n) {
+            piece = n;
+        }
+        n -= piece;
+        while (piece) {
+            int ready;
+            uint32_t k = mfcc_push(m, pcm, piece, out + (size_t)frames * m->n_out, &ready);
+            pcm += k;
+            piece -= k;
+            frames += ready;
+        }
+    }
+    return frames;
+}
+
+static void check_file(const char *path, const char *cfg_name, const mfcc_cfg_t *cfg)
+{
+    static mfcc_t m;
+    uint32_t n = 0, rate = 0;
+    int16_t *pcm = wav_load(path, &n, &rate);
+
+    CHECK(pcm, "%s: not a 16 bit mono WAV", path);
+    if (!pcm) {
+        return;
+    }
+    if (rate != cfg->rate || n < cfg->frame_len) {
+        printf("%s: %u Hz, %u samples, skipped for %s\n", path, rate, n, cfg_name);
+        free(pcm);
+        return;
+    }
+    CHECK(0 == mfcc_init(&m, cfg), "%s: mfcc_init", cfg_name);
+
+    uint32_t expect = 1 + (n - cfg->frame_len) / cfg->hop;
+    double *ref = malloc((size_t)expect * m.n_out * sizeof(double));
+    float *feat = malloc((size_t)expect * m.n_out * sizeof(float));
+    float *whole = malloc((size_t)expect * m.n_out * sizeof(float));
+    float *frame = malloc(cfg->frame_len * sizeof(float)), vec[MFCC_MAX_MELS], sca[MFCC_MAX_MELS];
+
+    uint32_t got = stream(&m, pcm, n, 700, feat);
+    CHECK(got == expect && m.frames == expect, "%s/%s: %u frames, expected %u", path, cfg_name, got, expect);
+    CHECK(expect == stream(&m, pcm, n, n, whole), "%s/%s: one piece", path, cfg_name);
+    CHECK(0 == memcmp(feat, whole, (size_t)expect * m.n_out * sizeof(float)),
+          "%s/%s: pieces and one piece differ", path, cfg_name);
+    CHECK(expect == reference(cfg, pcm, n, ref, m.n_out), "%s/%s: reference frame count", path, cfg_name);
+
+    double max_err = 0.0, max_vs = 0.0;
+    for (size_t i = 0; i < (size_t)expect * m.n_out; i++) {
+        double err = fabs(feat[i] - ref[i]);
+        max_err = err > max_err ? err : max_err;
+    }
+    CHECK(max_err <= (cfg->n_mfcc ? TOL_MFCC : TOL_LOGMEL), "%s/%s: %.2g from the reference", path, cfg_name, max_err);
+
+    /* vector against scalar, on frames rebuilt the way mfcc_push() does it */
+    for (uint32_t f = 0; f < expect; f++) {
+        uint32_t start = f * cfg->hop;
+        for (uint32_t i = 0; i < cfg->frame_len; i++) {
+            uint32_t j = start + i;
+            frame[i] = pcm[j] * (1.0f / 32768.0f) - cfg->preemph * (j ? pcm[j - 1] * (1.0f / 32768.0f) : 0.0f);
+        }
+        mfcc_frame(&m, frame, vec);
+        mfcc_frame_ref(&m, frame, sca);
+        for (uint32_t i = 0; i < m.n_out; i++) {
+            double d = fabs(vec[i] - sca[i]);
+            max_vs = d > max_vs ? d : max_vs;
+        }
+    }
+    CHECK(max_vs <= (cfg->n_mfcc ? TOL_MFCC : TOL_LOGMEL), "%s/%s: vector %.2g from scalar", path, cfg_name, max_vs);
+    printf("%s/%s: %u frames, max error %.2g, vector vs scalar %.2g\n", path, cfg_name, expect, max_err, max_vs);
+
+    free(pcm);
+    free(ref);
+    free(feat);
+    free(whole);
+    free(frame);
+}
+
+static void bench(uint32_t frames)
+{
+    static mfcc_t m;
+    mfcc_cfg_t cfg;
+    float frame[MFCC_MAX_NFFT], out[MFCC_MAX_MELS];
+    uint32_t s = seed;
+    double t, fps, fps_ref;
+
+    mfcc_default_cfg(&cfg);
+    mfcc_init(&m, &cfg);
+    for (uint32_t i = 0; i < cfg.frame_len; i++) {
+        frame[i] = ((int32_t)(xorshift(&s) & 0xffff) - 32768) / 65536.0f;
+    }
+    t = now_s();
+    for (uint32_t i = 0; i < frames; i++) {
+        mfcc_frame(&m, frame, out);
+    }
+    fps = frames / (now_s() - t);
+    t = now_s();
+    for (uint32_t i = 0; i < frames; i++) {
+        mfcc_frame_ref(&m, frame, out);
+    }
+    fps_ref = frames / (now_s() - t);
+    printf("mfcc_frame: %.0f frames/s (%.0fx real time), mfcc_frame_ref: %.0f frames/s\n", fps,
+           fps * cfg.hop / cfg.rate, fps_ref);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const names[] = {"tone", "chirp", "noise", "clicks", "square"};
+    char gen[5][64];
+    static mfcc_t scratch;
+    mfcc_cfg_t cfgs[3];
+    const char *cfg_names[3] = {"mfcc", "logmel", "odd"};
+    uint32_t bench_frames = 20000;
+    int keep = 0, opt;
+
+    while ((opt = getopt(argc, argv, "b:s:kh")) != -1) {
+        switch (opt) {
+            case 'b':
+                bench_frames = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keep = 1;
+                break;
+            default:
+                printf("Usage: %s [-b bench frames] [-s seed] [-k] [file.wav ...]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        printf("seed must be > 0\n");
+        return 2;
+    }
+
+    mfcc_default_cfg(&cfgs[0]);
+    cfgs[1] = cfgs[0];
+    cfgs[1].n_mfcc = 0;
+    cfgs[2] = cfgs[0];
+    cfgs[2].frame_len = 255;
+    cfgs[2].hop = 100;
+    cfgs[2].nfft = 256;
+    cfgs[2].n_mels = 23;
+    cfgs[2].n_mfcc = 20;
+    cfgs[2].fmin = 0.0f;
+    cfgs[2].fmax = 4000.0f;
+
+    for (int c = 0; c < 3; c++) {
+        if (optind < argc) {
+            for (int i = optind; i < argc; i++) {
+                check_file(argv[i], cfg_names[c], &cfgs[c]);
+            }
+            continue;
+        }
+        for (int k = 0; k < 5; k++) {
+            snprintf(gen[k], sizeof(gen[k]), "/tmp/mfcc_check_%s.wav", names[k]);
+            if (0 == c) {
+                CHECK(0 == wav_generate(gen[k], k), "%s: can't write", gen[k]);
+            }
+            check_file(gen[k], cfg_names[c], &cfgs[c]);
+        }
+    }
+    if (optind == argc && !keep) {
+        for (int k = 0; k < 5; k++) {
+            unlink(gen[k]);
+        }
+    }
+
+    mfcc_cfg_t bad = cfgs[0];
+    bad.nfft = 384;
+    CHECK(0 != mfcc_init(&scratch, &bad), "nfft 384 accepted");
+    bad = cfgs[0];
+    bad.fmax = 9000.0f;
+    CHECK(0 != mfcc_init(&scratch, &bad), "fmax above Nyquist accepted");
+
+    if (bench_frames) {
+        bench(bench_frames);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
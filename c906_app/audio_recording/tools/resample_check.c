@@ -0,0 +1,424 @@
+/*
+ * resample_check - resample.c frequency response, alias / image rejection
+ * and streaming, then timed.
+ *
+ * Six setups: 48 kHz to 16 kHz decimation, 16 kHz to 48 kHz, 44.1 kHz to
+ * 16 kHz (160 / 441, fewer zero crossings to fit), stereo 32 kHz to 16 kHz
+ * with a different tone per channel, stereo 48 kHz to 16 kHz averaged to
+ * mono, and 48 kHz to 16 kHz through the DC blocker with an offset added.
+ *
+ * Each runs a sine sweep through all four paths (float and int16, vector
+ * and reference). Below the passband edge the output is fitted with a sine
+ * at the input frequency: the gain has to be within TOL_GAIN_DB of 0 dB
+ * (of the DC blocker's own response, with it) and what the fit leaves over
+ * (aliases, images, the other channel, the offset) under TOL_RESID_DB. When decimating, tones at or above the output
+ * Nyquist frequency have to come out under TOL_STOP_DB.
+ *
+ * Noise pushed in random sized pieces has to give the same output as one
+ * call, the int16 path has to stay within TOL_LSB of the float one, and
+ * the vector paths have to match the references (identical on the host,
+ * where both are the scalar code; build with -D__riscv_vector against an
+ * RVV toolchain or an emulation header to compare the vector kernels).
+ *
+ * Then input frames/s of each path per setup, and how many times real time.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -o resample_check resample_check.c ../resample.c -lm
+ *   ./resample_check [-b seconds] [-s seed]
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "resample.h"
+
+#define AMP (0.5)
+#define SWEEP_S (0.2)
+#define PASS_TONES (20)
+#define STOP_TONES (12)
+#define TOL_GAIN_DB (0.05)
+#define TOL_RESID_DB (-70.0)
+#define TOL_STOP_DB (-70.0)
+#define TOL_LSB (8)      /* Q15 coefficient rounding against half scale noise */
+#define TOL_VEC (1e-5)   /* float vector against reference, full scale 1 */
+
+#define MAX_IN (48000 * 2) /* frames, a second at 48 kHz at most */
+#define MAX_OUT (MAX_IN * 3 + 16)
+
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static double now_s(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+typedef struct {
+    const char *name;
+    uint32_t rate_in, rate_out, channels;
+    int mono, dc_block;
+    uint32_t zero_crossings;
+} setup_t;
+
+static const setup_t setups[] = {
+    {"48k>16k", 48000, 16000, 1, 0, 0, 24},
+    {"16k>48k", 16000, 48000, 1, 0, 0, 24},
+    {"44.1k>16k", 44100, 16000, 1, 0, 0, 9},
+    {"32k>16k stereo", 32000, 16000, 2, 0, 0, 24},
+    {"48k>16k mono", 48000, 16000, 2, 1, 0, 24},
+    {"48k>16k dc", 48000, 16000, 1, 0, 1, 24},
+};
+#define SETUPS (sizeof(setups) / sizeof(setups[0]))
+
+enum { PATH_F32, PATH_F32_REF, PATH_S16, PATH_S16_REF, PATHS };
+static const char *const path_names[PATHS] = {"f32", "f32_ref", "s16", "s16_ref"};
+
+static rs_t rs;
+static int16_t in16[MAX_IN * 2], out16[MAX_OUT * 2];
+static float inf[MAX_IN * 2], outf[MAX_OUT * 2], outf2[MAX_OUT * 2];
+
+static int open_setup(const setup_t *s)
+{
+    rs_cfg_t cfg;
+
+    rs_default_cfg(&cfg);
+    cfg.rate_in = s->rate_in;
+    cfg.rate_out = s->rate_out;
+    cfg.channels = s->channels;
+    cfg.mono = s->mono;
+    cfg.dc_block = s->dc_block;
+    cfg.zero_crossings = s->zero_crossings;
+    return rs_init(&rs, &cfg);
+}
+
+/* frames of in16 / inf in pieces of at most chunk (0: one call), float output in out */
+static uint32_t run(int path, uint32_t frames, uint32_t chunk, float *out)
+{
+    uint32_t ch = rs.cfg.channels, oc = rs.out_channels, n = 0, s = seed;
+
+    rs_reset(&rs);
+    for (uint32_t done = 0; done < frames;) {
+        uint32_t len = frames - done, got = 0;
+        if (chunk) {
+            uint32_t want = 1 + xorshift(&s) % chunk;
+            len = want < len ? want : len;
+        }
+        switch (path) {
+            case PATH_F32:
+                got = rs_process_f32(&rs, inf + done * ch, len, out + n * oc);
+                break;
+            case PATH_F32_REF:
+                got = rs_process_f32_ref(&rs, inf + done * ch, len, out + n * oc);
+                break;
+            case PATH_S16:
+                got = rs_process_s16(&rs, in16 + done * ch, len, out16 + n * oc);
+                break;
+            default:
+                got = rs_process_s16_ref(&rs, in16 + done * ch, len, out16 + n * oc);
+                break;
+        }
+        CHECK(got <= rs_out_max(&rs, len), "%u outputs for %u inputs, rs_out_max %u", got, len,
+              rs_out_max(&rs, len));
+        n += got;
+        done += len;
+    }
+    if (PATH_S16 == path || PATH_S16_REF == path) {
+        for (uint32_t i = 0; i < n * oc; i++) {
+            out[i] = out16[i] / 32768.0f;
+        }
+    }
+    return n;
+}
+
+/* fills both inputs with the same signal, quantised to 16 bit */
+static void set_input(uint32_t i, uint32_t c, double x)
+{
+    long q = lrint(x * 32768.0);
+    q = q > 32767 ? 32767 : q < -32768 ? -32768 : q;
+    in16[i * rs.cfg.channels + c] = (int16_t)q;
+    inf[i * rs.cfg.channels + c] = q / 32768.0f;
+}
+
+static double db(double x)
+{
+    return 20.0 * log10(x + 1e-12);
+}
+
+/* least squares sine at f (cycles per sample) through y: amplitude, and rms of what is left */
+static void fit(const float *y, uint32_t n, uint32_t stride, double f, double *amp, double *resid)
+{
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0, a, b, det, e = 0;
+
+    for (uint32_t k = 0; k < n; k++) {
+        double s = sin(2.0 * M_PI * f * k), c = cos(2.0 * M_PI * f * k), v = y[k * stride];
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        ys += v * s;
+        yc += v * c;
+    }
+    det = ss * cc - sc * sc;
+    a = (ys * cc - yc * sc) / det;
+    b = (yc * ss - ys * sc) / det;
+    for (uint32_t k = 0; k < n; k++) {
+        double v = y[k * stride] - a * sin(2.0 * M_PI * f * k) - b * cos(2.0 * M_PI * f * k);
+        e += v * v;
+    }
+    *amp = sqrt(a * a + b * b);
+    *resid = sqrt(e / n);
+}
+
+static double rms(const float *y, uint32_t n, uint32_t stride)
+{
+    double e = 0;
+
+    for (uint32_t k = 0; k < n; k++) {
+        e += (double)y[k * stride] * y[k * stride];
+    }
+    return sqrt(e / n);
+}
+
+/*
+ * One tone at f Hz (0.7 f on the second channel of a stereo setup), through
+ * one path. Worst channel: gain in dB, residual and output level in dB
+ * relative to the input tone.
+ */
+static void tone(const setup_t *s, int path, double f, double *gain, double *resid, double *level)
+{
+    uint32_t skip_in = 2 * rs.taps * rs.down / rs.up + 16 + (s->dc_block ? s->rate_in / 2 : 0);
+    uint32_t frames = skip_in + (uint32_t)(SWEEP_S * s->rate_in);
+    uint32_t skip = (uint64_t)skip_in * rs.up / rs.down, oc = rs.out_channels, n;
+
+    for (uint32_t i = 0; i < frames; i++) {
+        for (uint32_t c = 0; c < s->channels; c++) {
+            double fc = 2 == s->channels && !s->mono && c ? 0.7 * f : f;
+            set_input(i, c, AMP * sin(2.0 * M_PI * fc * i / s->rate_in) + (s->dc_block ? 0.25 : 0.0));
+        }
+    }
+    n = run(path, frames, 0, outf) - skip;
+    *gain = 0.0;
+    *resid = *level = -1000.0;
+    for (uint32_t c = 0; c < oc; c++) {
+        double fc = c ? 0.7 * f : f, amp, e;
+        fit(outf + skip * oc + c, n, oc, fc / s->rate_out, &amp, &e);
+        if (fabs(db(amp / AMP)) > fabs(*gain)) {
+            *gain = db(amp / AMP);
+        }
+        *resid = fmax(*resid, db(e / (AMP / sqrt(2.0))));
+        *level = fmax(*level, db(rms(outf + skip * oc + c, n, oc) / (AMP / sqrt(2.0))));
+    }
+}
+
+/* the DC blocker's own response at f Hz: y = x - x1 + R y1 */
+static double dc_block_db(const setup_t *s, double f)
+{
+    double w = 2.0 * M_PI * f / s->rate_in, r = rs.dc_r;
+
+    return db(sqrt((2.0 - 2.0 * cos(w)) / (1.0 - 2.0 * r * cos(w) + r * r)));
+}
+
+static void sweep(const setup_t *s)
+{
+    double low_nyq = 0.5 * (s->rate_in < s->rate_out ? s->rate_in : s->rate_out);
+    double pass_hi = 0.95 * rs.passband * low_nyq;
+
+    for (int path = 0; path < PATHS; path++) {
+        double worst_gain = 0.0, worst_resid = -1000.0, worst_stop = -1000.0, gain, resid, level;
+        for (int t = 0; t < PASS_TONES; t++) {
+            double f = 50.0 * pow(pass_hi / 50.0, (double)t / (PASS_TONES - 1));
+            tone(s, path, f, &gain, &resid, &level);
+            gain -= s->dc_block ? dc_block_db(s, f) : 0.0;
+            CHECK(fabs(gain) <= TOL_GAIN_DB, "%s/%s: %.0f Hz gain %.3f dB", s->name, path_names[path], f, gain);
+            CHECK(resid <= TOL_RESID_DB, "%s/%s: %.0f Hz residual %.1f dB", s->name, path_names[path], f, resid);
+            worst_gain = fabs(gain) > fabs(worst_gain) ? gain : worst_gain;
+            worst_resid = fmax(worst_resid, resid);
+        }
+        for (int t = 0; s->rate_out < s->rate_in && t < STOP_TONES; t++) {
+            /* the second channel of a stereo setup plays 0.7 f, keep that in the stopband too */
+            double lo = 2 == s->channels && !s->mono ? low_nyq / 0.7 : low_nyq;
+            double f = lo + (0.49 * s->rate_in - lo) * t / (STOP_TONES - 1);
+            tone(s, path, f, &gain, &resid, &level);
+            CHECK(level <= TOL_STOP_DB, "%s/%s: %.0f Hz passes at %.1f dB", s->name, path_names[path], f, level);
+            worst_stop = fmax(worst_stop, level);
+        }
+        printf("%-15s %-8s passband %.3f dB, residual %.1f dB", s->name, path_names[path], worst_gain, worst_resid);
+        if (s->rate_out < s->rate_in) {
+            printf(", stopband %.1f dB", worst_stop);
+        }
+        printf("\n");
+    }
+}
+
+static void noise(uint32_t frames, int32_t amp)
+{
+    uint32_t s = seed;
+
+    for (uint32_t i = 0; i < frames; i++) {
+        for (uint32_t c = 0; c < rs.cfg.channels; c++) {
+            set_input(i, c, (double)((int32_t)(xorshift(&s) % (2 * amp + 1)) - amp) / 32768.0);
+        }
+    }
+}
+
+static void streaming(const setup_t *s)
+{
+    uint32_t frames = s->rate_in / 4, oc = rs.out_channels, n, m;
+    double max_lsb = 0.0, max_vec = 0.0;
+
+    noise(frames, 16384);
+    for (int path = 0; path < PATHS; path++) {
+        n = run(path, frames, 0, outf);
+        m = run(path, frames, 700, outf2);
+        CHECK(n == m && 0 == memcmp(outf, outf2, (size_t)n * oc * sizeof(float)), "%s/%s: pieces differ from one call",
+              s->name, path_names[path]);
+    }
+
+    /* int16 against float, reference paths */
+    n = run(PATH_F32_REF, frames, 0, outf);
+    m = run(PATH_S16_REF, frames, 0, outf2);
+    CHECK(n == m, "%s: %u float outputs, %u int16", s->name, n, m);
+    for (uint32_t i = 0; i < n * oc; i++) {
+        max_lsb = fmax(max_lsb, fabs(outf[i] - outf2[i]) * 32768.0);
+    }
+    CHECK(max_lsb <= TOL_LSB, "%s: int16 %.1f LSB from float", s->name, max_lsb);
+
+    /* vector against reference */
+    n = run(PATH_F32, frames, 0, outf);
+    m = run(PATH_F32_REF, frames, 0, outf2);
+    for (uint32_t i = 0; i < n * oc; i++) {
+        max_vec = fmax(max_vec, fabs(outf[i] - outf2[i]));
+    }
+    CHECK(n == m && max_vec <= TOL_VEC, "%s: float vector %.2g from reference", s->name, max_vec);
+    n = run(PATH_S16, frames, 0, outf);
+    m = run(PATH_S16_REF, frames, 0, outf2);
+    CHECK(n == m && 0 == memcmp(outf, outf2, (size_t)n * oc * sizeof(float)), "%s: int16 vector differs from reference",
+          s->name);
+
+    /* full scale: sums beyond 16 bits saturate the same way in both */
+    noise(frames, 32768);
+    n = run(PATH_S16, frames, 0, outf);
+    m = run(PATH_S16_REF, frames, 0, outf2);
+    CHECK(n == m && 0 == memcmp(outf, outf2, (size_t)n * oc * sizeof(float)),
+          "%s: int16 vector differs from reference at full scale", s->name);
+    printf("%-15s int16 within %.1f LSB of float, float vector within %.2g\n", s->name, max_lsb, max_vec);
+}
+
+/* L = R comes through at unity (the sweep), L = -R cancels */
+static void downmix(const setup_t *s)
+{
+    uint32_t frames = s->rate_in / 4, n;
+
+    for (uint32_t i = 0; i < frames; i++) {
+        double x = AMP * sin(2.0 * M_PI * 1000.0 * i / s->rate_in);
+        set_input(i, 0, x);
+        set_input(i, 1, -x);
+    }
+    for (int path = 0; path < PATHS; path++) {
+        n = run(path, frames, 0, outf);
+        CHECK(rms(outf, n, 1) < 1e-4, "%s/%s: L = -R leaves %.2g", s->name, path_names[path], rms(outf, n, 1));
+    }
+}
+
+static void bench(const setup_t *s, double seconds)
+{
+    uint32_t frames = s->rate_in < MAX_IN ? s->rate_in : MAX_IN;
+    uint32_t rounds = (uint32_t)ceil(seconds * s->rate_in / frames);
+    double fps[PATHS], t;
+
+    noise(frames, 16384);
+    for (int path = 0; path < PATHS; path++) {
+        t = now_s();
+        for (uint32_t k = 0; k < rounds; k++) {
+            run(path, frames, 0, outf);
+        }
+        fps[path] = (double)frames * rounds / (now_s() - t);
+    }
+    printf("%-15s taps %3u x %3u phases:", s->name, rs.taps, rs.up);
+    for (int path = 0; path < PATHS; path++) {
+        printf(" %s %.0f/s (%.0fx)", path_names[path], fps[path], fps[path] / s->rate_in);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    double bench_s = 10.0;
+    rs_cfg_t bad;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:s:h")) != -1) {
+        switch (opt) {
+            case 'b':
+                bench_s = strtod(optarg, NULL);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                printf("Usage: %s [-b bench seconds of audio] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        printf("seed must be > 0\n");
+        return 2;
+    }
+
+    for (uint32_t k = 0; k < SETUPS; k++) {
+        int ok = 0 == open_setup(&setups[k]);
+        CHECK(ok, "%s: rs_init", setups[k].name);
+        if (!ok) {
+            continue;
+        }
+        sweep(&setups[k]);
+        streaming(&setups[k]);
+        if (setups[k].mono) {
+            downmix(&setups[k]);
+        }
+    }
+
+    rs_default_cfg(&bad);
+    bad.rate_in = 44100;
+    CHECK(0 != rs_init(&rs, &bad), "44.1k>16k with 24 zero crossings accepted");
+    rs_default_cfg(&bad);
+    bad.channels = 3;
+    CHECK(0 != rs_init(&rs, &bad), "3 channels accepted");
+    rs_default_cfg(&bad);
+    bad.rate_out = 0;
+    CHECK(0 != rs_init(&rs, &bad), "rate 0 accepted");
+
+    for (uint32_t k = 0; bench_s > 0.0 && k < SETUPS; k++) {
+        open_setup(&setups[k]);
+        bench(&setups[k], bench_s);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,466 @@
+/*
+ * vad_check - vad.c on speech in noise, with known answers.
+ *
+ * Writes WAV fixtures (with wav_writer.c) of 30 s each: synthetic
+ * utterances at random 1..3 s gaps over a background, and backgrounds
+ * alone. An utterance is a few syllables of a glottal pulse train with
+ * drifting pitch through three formant resonators, some led by a noise
+ * fricative, at -26 dBFS. Backgrounds are digital silence, white noise and
+ * low-passed (rumble) noise at 20, 10 and 5 dB SNR, mains hum, and noise
+ * that steps up 15 dB halfway.
+ *
+ * Each fixture is read back and run through vad_process() in random sized
+ * pieces. Reported per fixture and sensitivity:
+ *   detected  utterances overlapped by a START..END span
+ *   latency   span start - onset, mean and worst, in ms
+ *   false     spans overlapping no utterance, per minute of non-speech
+ *   end       span end - utterance end, mean, in ms (the hangover is 300 ms)
+ * At the default sensitivity (2) speech at 10 dB SNR or better has to be
+ * found within 150 ms (a leading fricative is 60 ms of that: it is not
+ * voiced, the span starts on the vowel) with under one false start a
+ * minute; at 0 nothing but speech may start a span.
+ *
+ * WAVs given on the command line (16 bit mono, 16 kHz) are run instead
+ * and their events listed.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -o vad_check vad_check.c ../vad.c ../wav_writer.c -lm
+ *   ./vad_check [-s seed] [-k] [file.wav ...]
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "vad.h"
+#include "wav_writer.h"
+
+#define RATE (16000)
+#define SECONDS (30)
+#define SAMPLES (RATE * SECONDS)
+#define MAX_UTT (32)
+#define MS(samples) ((double)(samples) * 1000.0 / RATE)
+
+#define BG_SILENCE (0)
+#define BG_WHITE (1)
+#define BG_RUMBLE (2)
+#define BG_HUM (3)
+#define BG_STEP (4)
+
+typedef struct {
+    const char *name;
+    int background;
+    double snr_db; /* background level against the speech, or absolute for no speech */
+    int speech;
+} fixture_t;
+
+static const fixture_t s_fixtures[] = {
+    {"clean", BG_SILENCE, 0, 1},       {"white20", BG_WHITE, 20, 1},    {"white10", BG_WHITE, 10, 1},
+    {"white5", BG_WHITE, 5, 1},        {"rumble10", BG_RUMBLE, 10, 1},  {"hum10", BG_HUM, 10, 1},
+    {"noise_white", BG_WHITE, 10, 0},  {"noise_rumble", BG_RUMBLE, 10, 0}, {"noise_hum", BG_HUM, 0, 0},
+    {"noise_step", BG_STEP, 10, 0},
+};
+
+typedef struct {
+    uint32_t start, end;
+} seg_t;
+
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+/* uniform in [-1, 1) */
+static inline double urand(uint32_t *s)
+{
+    return ((int32_t)(xorshift(s) & 0xffff) - 32768) / 32768.0;
+}
+
+static inline uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/* two pole resonator */
+typedef struct {
+    double a1, a2, g, y1, y2;
+} reson_t;
+
+static void reson_set(reson_t *r, double hz, double bw)
+{
+    double rad = exp(-M_PI * bw / RATE);
+    r->a1 = 2.0 * rad * cos(2.0 * M_PI * hz / RATE);
+    r->a2 = -rad * rad;
+    r->g = 1.0 - rad;
+}
+
+static inline double reson(reson_t *r, double x)
+{
+    double y = r->g * x + r->a1 * r->y1 + r->a2 * r->y2;
+    r->y2 = r->y1;
+    r->y1 = y;
+    return y;
+}
+
+/* one utterance of 2..6 syllables into out, returns its length */
+static uint32_t utterance(double *out, uint32_t max, uint32_t *s)
+{
+    static const double vowels[5][3] = {
+        {730, 1090, 2440}, {270, 2290, 3010}, {530, 1840, 2480}, {570, 840, 2410}, {440, 1020, 2240},
+    };
+    uint32_t n = 0, syllables = 2 + xorshift(s) % 5;
+    double f0 = 100.0 + 120.0 * (urand(s) + 1.0) / 2.0, phase = 0.0;
+
+    for (uint32_t k = 0; k < syllables && n < max; k++) {
+        if (0 == xorshift(s) % 3) { /* fricative, 60 ms */
+            double hp = 0.0, prev = 0.0;
+            for (uint32_t i = 0; i < RATE * 60 / 1000 && n < max; i++, n++) {
+                double x = urand(s);
+                hp = 0.5 * (hp + x - prev);
+                prev = x;
+                out[n] = 0.15 * hp * sin(M_PI * i / (RATE * 60 / 1000));
+            }
+        }
+        const double *f = vowels[xorshift(s) % 5];
+        reson_t r[3];
+        memset(r, 0, sizeof(r));
+        for (int j = 0; j < 3; j++) {
+            reson_set(&r[j], f[j], 60.0 + 40.0 * j);
+        }
+        uint32_t len = RATE * (150 + xorshift(s) % 150) / 1000;
+        for (uint32_t i = 0; i < len && n < max; i++, n++) {
+            double hz = f0 * (1.0 + 0.1 * sin(2.0 * M_PI * i / len));
+            phase += hz / RATE;
+            double pulse = phase >= 1.0 ? 1.0 : 0.0;
+            if (phase >= 1.0) {
+                phase -= 1.0;
+            }
+            double v = reson(&r[0], pulse) + 0.6 * reson(&r[1], pulse) + 0.3 * reson(&r[2], pulse);
+            out[n] = v * sin(M_PI * i / len);
+        }
+    }
+    return n;
+}
+
+static double rms(const double *x, uint32_t n)
+{
+    double sum = 0.0;
+    for (uint32_t i = 0; i < n; i++) {
+        sum += x[i] * x[i];
+    }
+    return n ? sqrt(sum / n) : 0.0;
+}
+
+/* a fixture into pcm, utterances into segs. Returns the number of utterances. */
+static uint32_t fixture(const fixture_t *fx, int16_t *pcm, seg_t *segs)
+{
+    static double sig[SAMPLES], bg[SAMPLES];
+    const double speech_rms = pow(10.0, -26.0 / 20.0);
+    uint32_t s = seed, n = 0, at = RATE;
+
+    memset(sig, 0, sizeof(sig));
+    while (fx->speech && n < MAX_UTT) {
+        at += RATE + xorshift(&s) % (2 * RATE);
+        if (at + 2 * RATE > SAMPLES) {
+            break;
+        }
+        uint32_t len = utterance(sig + at, 2 * RATE, &s);
+        double g = speech_rms / rms(sig + at, len);
+        for (uint32_t i = 0; i < len; i++) {
+            sig[at + i] *= g;
+        }
+        segs[n].start = at;
+        segs[n].end = at + len;
+        n++;
+        at += len;
+    }
+
+    double lp = 0.0;
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        double t = (double)i / RATE;
+        switch (fx->background) {
+            case BG_WHITE:
+            case BG_STEP:
+                bg[i] = urand(&s);
+                break;
+            case BG_RUMBLE:
+                lp += 0.05 * (urand(&s) - lp);
+                bg[i] = lp;
+                break;
+            case BG_HUM:
+                bg[i] = sin(2.0 * M_PI * 50.0 * t) + 0.3 * sin(2.0 * M_PI * 100.0 * t) +
+                        0.1 * sin(2.0 * M_PI * 150.0 * t);
+                break;
+            default:
+                bg[i] = 0.0;
+                break;
+        }
+    }
+    if (BG_SILENCE != fx->background) {
+        /* with speech: snr_db under it, without: as loud as that would have been */
+        double g = speech_rms * pow(10.0, -fx->snr_db / 20.0) / rms(bg, SAMPLES);
+        for (uint32_t i = 0; i < SAMPLES; i++) {
+            bg[i] *= g * (BG_STEP == fx->background && i < SAMPLES / 2 ? pow(10.0, -15.0 / 20.0) : 1.0);
+        }
+    }
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        double v = (sig[i] + bg[i]) * 32768.0;
+        pcm[i] = v > 32767.0 ? 32767 : v < -32768.0 ? -32768 : (int16_t)lrint(v);
+    }
+    return n;
+}
+
+static int16_t *wav_load(const char *path, uint32_t *n, uint32_t *rate)
+{
+    uint8_t hdr[12], ch[8], fmt[16];
+    int16_t *pcm = NULL;
+    int have_fmt = 0;
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        return NULL;
+    }
+    if (12 != fread(hdr, 1, 12, f) || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) {
+        fclose(f);
+        return NULL;
+    }
+    while (8 == fread(ch, 1, 8, f)) {
+        uint32_t len = get32(ch + 4);
+        if (0 == memcmp(ch, "fmt ", 4) && len >= 16 && 16 == fread(fmt, 1, 16, f)) {
+            have_fmt = get16(fmt) == 1 && get16(fmt + 2) == 1 && get16(fmt + 14) == 16;
+            *rate = get32(fmt + 4);
+            fseek(f, (len - 16 + 1) & ~1u, SEEK_CUR);
+        } else if (0 == memcmp(ch, "data", 4) && have_fmt) {
+            *n = len / 2;
+            pcm = malloc(len + 2);
+            if (pcm && *n != fread(pcm, 2, *n, f)) {
+                free(pcm);
+                pcm = NULL;
+            }
+            break;
+        } else {
+            fseek(f, (len + 1) & ~1u, SEEK_CUR);
+        }
+    }
+    fclose(f);
+    return pcm;
+}
+
+/* all of pcm through the detector in random pieces, events into ev. Returns the event count. */
+static uint32_t run_vad(const int16_t *pcm, uint32_t n, int sensitivity, vad_event_t *ev, uint32_t max_ev)
+{
+    static vad_t v;
+    vad_cfg_t cfg;
+    uint32_t s = seed, count = 0;
+
+    vad_default_cfg(&cfg, RATE, sensitivity);
+    vad_init(&v, &cfg);
+    for (uint32_t off = 0; off < n;) {
+        uint32_t piece = 1 + xorshift(&s) % 1000;
+        if (piece > n - off) {
+            piece = n - off;
+        }
+        vad_process(&v, pcm + off, piece);
+        off += piece;
+        /* drained often, as the consumer task would */
+        while (count < max_ev && vad_event_pop(&v, &ev[count])) {
+            count++;
+        }
+    }
+    CHECK(0 == v.ev_dropped, "%u events dropped", v.ev_dropped);
+    return count;
+}
+
+typedef struct {
+    uint32_t utts, detected, false_starts;
+    double lat_sum, lat_max, end_sum, silence_min;
+} score_t;
+
+/*
+ * Events to active spans first. An utterance is found when a span overlaps
+ * it, 100 ms early counting; the latency is from its onset to the span's
+ * start, 0 when the span was already running. A span overlapping nothing
+ * is a false start.
+ */
+static score_t score(const seg_t *segs, uint32_t nsegs, const vad_event_t *ev, uint32_t nev)
+{
+    static seg_t spans[256];
+    uint32_t nspans = 0, speech = 0, ends = 0;
+    score_t r;
+
+    for (uint32_t e = 0; e < nev && nspans < 256; e++) {
+        if (VAD_SPEECH_START == ev[e].type) {
+            spans[nspans].start = ev[e].sample;
+            spans[nspans++].end = SAMPLES;
+        } else if (nspans) {
+            spans[nspans - 1].end = ev[e].sample;
+        }
+    }
+
+    memset(&r, 0, sizeof(r));
+    r.utts = nsegs;
+    for (uint32_t u = 0; u < nsegs; u++) {
+        speech += segs[u].end - segs[u].start;
+        for (uint32_t k = 0; k < nspans; k++) {
+            if (spans[k].start <= segs[u].end && spans[k].end + RATE / 10 >= segs[u].start) {
+                double lat = spans[k].start > segs[u].start ? MS(spans[k].start - segs[u].start) : 0.0;
+                r.detected++;
+                r.lat_sum += lat;
+                r.lat_max = lat > r.lat_max ? lat : r.lat_max;
+                if (spans[k].end < SAMPLES) {
+                    r.end_sum += MS((int64_t)spans[k].end - segs[u].end);
+                    ends++;
+                }
+                break;
+            }
+        }
+    }
+    for (uint32_t k = 0; k < nspans; k++) {
+        int hit = 0;
+        for (uint32_t u = 0; u < nsegs && !hit; u++) {
+            hit = spans[k].start <= segs[u].end && spans[k].end + RATE / 10 >= segs[u].start;
+        }
+        r.false_starts += !hit;
+    }
+    r.silence_min = (SAMPLES - speech) / (60.0 * RATE);
+    if (r.detected) {
+        r.lat_sum /= r.detected;
+    }
+    if (ends) {
+        r.end_sum /= ends;
+    }
+    return r;
+}
+
+static void check_fixtures(int keep)
+{
+    static int16_t pcm[SAMPLES];
+    static vad_event_t ev[256];
+    seg_t segs[MAX_UTT];
+    char path[64];
+
+    printf("%-13s sens  detected  latency ms (mean/max)  false/min  end ms\n", "fixture");
+    for (uint32_t f = 0; f < sizeof(s_fixtures) / sizeof(s_fixtures[0]); f++) {
+        const fixture_t *fx = &s_fixtures[f];
+        wav_writer_t w;
+        uint32_t nsegs = fixture(fx, pcm, segs), n = 0, rate = 0;
+
+        snprintf(path, sizeof(path), "/tmp/vad_check_%s.wav", fx->name);
+        CHECK(0 == wav_open(&w, path, RATE, 1) && 0 == wav_write(&w, pcm, SAMPLES) && 0 == wav_close(&w),
+              "%s: can't write", path);
+        int16_t *back = wav_load(path, &n, &rate);
+        CHECK(back && n == SAMPLES && rate == RATE, "%s: can't read back", path);
+        if (!back) {
+            continue;
+        }
+
+        for (int sens = 0; sens < 4; sens++) {
+            uint32_t nev = run_vad(back, n, sens, ev, 256);
+            score_t r = score(segs, nsegs, ev, nev);
+            double fpm = r.false_starts / r.silence_min;
+
+            printf("%-13s %4d  %4u/%-4u %8.1f / %-8.1f %11.2f  %6.0f\n", fx->name, sens, r.detected, r.utts, r.lat_sum,
+                   r.lat_max, fpm, r.end_sum);
+            if (0 == sens) {
+                /* the conservative end: clean speech all found, nothing else ever */
+                CHECK(0 == r.false_starts, "%s/0: %u false starts", fx->name, r.false_starts);
+                if (BG_SILENCE == fx->background) {
+                    CHECK(r.detected == r.utts, "%s/0: %u of %u utterances", fx->name, r.detected, r.utts);
+                }
+            } else if (2 == sens && fx->speech && fx->snr_db >= 10.0) {
+                /* the default: 10 dB SNR or better found, quickly, without false starts */
+                CHECK(r.detected == r.utts, "%s/2: %u of %u utterances", fx->name, r.detected, r.utts);
+                CHECK(r.lat_max <= 150.0, "%s/2: onset latency up to %.0f ms", fx->name, r.lat_max);
+                CHECK(fpm <= 1.0, "%s/2: %.2f false starts per minute", fx->name, fpm);
+            } else if (2 == sens && fx->speech) {
+                CHECK(r.detected * 10 >= r.utts * 8, "%s/2: %u of %u utterances", fx->name, r.detected, r.utts);
+            } else if (2 == sens) {
+                CHECK(r.false_starts <= (BG_STEP == fx->background ? 1u : 0u), "%s/2: %u false starts in noise",
+                      fx->name, r.false_starts);
+            }
+        }
+        free(back);
+        if (!keep) {
+            unlink(path);
+        }
+    }
+}
+
+static void list_events(const char *path)
+{
+    static vad_event_t ev[1024];
+    uint32_t n = 0, rate = 0;
+    int16_t *pcm = wav_load(path, &n, &rate);
+
+    CHECK(pcm && RATE == rate, "%s: not a 16 bit mono 16 kHz WAV", path);
+    if (!pcm || RATE != rate) {
+        free(pcm);
+        return;
+    }
+    uint32_t nev = run_vad(pcm, n, 2, ev, 1024);
+    for (uint32_t e = 0; e < nev; e++) {
+        printf("%s: %8.3f s %s\n", path, ev[e].sample / (double)RATE,
+               VAD_SPEECH_START == ev[e].type ? "speech start" : "speech end");
+    }
+    free(pcm);
+}
+
+int main(int argc, char **argv)
+{
+    int keep = 0, opt;
+
+    while ((opt = getopt(argc, argv, "s:kh")) != -1) {
+        switch (opt) {
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keep = 1;
+                break;
+            default:
+                printf("Usage: %s [-s seed] [-k] [file.wav ...]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        printf("seed must be > 0\n");
+        return 2;
+    }
+
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            list_events(argv[i]);
+        }
+    } else {
+        check_fixtures(keep);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+#include <math.h>
+#include <string.h>
+
+#include "vad.h"
+
+#ifndef M_PI
+#define M_PI (3.14159265358979323846)
+#endif
+
+#define ev_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ev_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+#define VAD_HP_HZ (200.0f)
+#define VAD_LP_HZ (3400.0f)
+#define VAD_FLOOR_FALL (0.3f)    /* per frame, fraction of the gap */
+#define VAD_ACTIVE_RISE_DIV (16) /* floor rise slowdown during speech */
+
+void vad_default_cfg(vad_cfg_t *cfg, uint32_t rate, int sensitivity)
+{
+    static const float threshold[4] = {12.0f, 9.0f, 6.0f, 4.0f};
+    static const float min_db[4] = {-45.0f, -50.0f, -55.0f, -60.0f};
+    static const float ratio[4] = {0.5f, 0.4f, 0.3f, 0.2f};
+    static const float zcr[4] = {0.18f, 0.2f, 0.22f, 0.25f};
+    static const uint8_t start[4] = {5, 4, 3, 2};
+
+    if (sensitivity < 0) sensitivity = 0;
+    if (sensitivity > 3) sensitivity = 3;
+    cfg->rate = rate;
+    cfg->frame_len = rate / 100;
+    cfg->threshold_db = threshold[sensitivity];
+    cfg->min_db = min_db[sensitivity];
+    cfg->min_ratio = ratio[sensitivity];
+    cfg->max_zcr = zcr[sensitivity];
+    cfg->start_frames = start[sensitivity];
+    cfg->hang_frames = 30;
+    cfg->floor_rise = 0.02f;
+}
+
+int vad_init(vad_t *v, const vad_cfg_t *cfg)
+{
+    if (0 == cfg->frame_len || 0 == cfg->rate) {
+        return -1;
+    }
+    memset(v, 0, sizeof(*v));
+    v->cfg = *cfg;
+
+    float dt = 1.0f / cfg->rate;
+    float hp_rc = 1.0f / (2.0f * (float)M_PI * VAD_HP_HZ);
+    float lp_rc = 1.0f / (2.0f * (float)M_PI * VAD_LP_HZ);
+    v->hp_a = hp_rc / (hp_rc + dt);
+    v->lp_b = dt / (lp_rc + dt);
+    return 0;
+}
+
+static void push_event(vad_t *v, uint8_t type, uint32_t sample)
+{
+    uint32_t head = v->ev_head;
+
+    if (head - ev_load(&v->ev_tail) >= VAD_EVENTS) {
+        v->ev_dropped++;
+        return;
+    }
+    v->events[head & (VAD_EVENTS - 1)].type = type;
+    v->events[head & (VAD_EVENTS - 1)].sample = sample;
+    ev_store(&v->ev_head, head + 1);
+}
+
+int vad_event_pop(vad_t *v, vad_event_t *ev)
+{
+    uint32_t tail = v->ev_tail;
+
+    if (tail == ev_load(&v->ev_head)) {
+        return 0;
+    }
+    *ev = v->events[tail & (VAD_EVENTS - 1)];
+    ev_store(&v->ev_tail, tail + 1);
+    return 1;
+}
+
+/* a frame is complete: features, decision, state. Returns the events queued. */
+static uint32_t frame_done(vad_t *v)
+{
+    const vad_cfg_t *c = &v->cfg;
+    uint32_t frame_start = v->samples - c->frame_len, events = 0;
+
+    v->band_db = 10.0f * log10f(v->sum_band / c->frame_len + 1e-10f);
+    v->ratio = v->sum_band / (v->sum_full + 1e-12f);
+    v->zcr = (float)v->crossings / c->frame_len;
+    v->sum_full = v->sum_band = 0.0f;
+    v->crossings = 0;
+    v->fill = 0;
+    v->frames++;
+
+    if (!v->primed) {
+        v->floor_db = v->band_db;
+        v->primed = 1;
+    }
+    int speech = v->band_db >= v->floor_db + c->threshold_db && v->band_db >= c->min_db &&
+                 v->ratio >= c->min_ratio && v->zcr <= c->max_zcr;
+
+    if (v->band_db < v->floor_db) {
+        v->floor_db += (v->band_db - v->floor_db) * VAD_FLOOR_FALL;
+    } else {
+        v->floor_db += (v->band_db - v->floor_db) * (v->active ? c->floor_rise / VAD_ACTIVE_RISE_DIV : c->floor_rise);
+    }
+
+    if (speech) {
+        v->speech_frames++;
+    }
+    if (!v->active) {
+        if (!speech) {
+            v->run = 0;
+        } else {
+            if (0 == v->run++) {
+                v->run_start = frame_start;
+            }
+            if (v->run >= c->start_frames) {
+                v->active = 1;
+                v->silence = 0;
+                push_event(v, VAD_SPEECH_START, v->run_start);
+                events++;
+            }
+        }
+    } else if (speech) {
+        v->silence = 0;
+    } else if (++v->silence >= c->hang_frames) {
+        v->active = 0;
+        v->run = 0;
+        push_event(v, VAD_SPEECH_END, v->samples);
+        events++;
+    }
+    return events;
+}
+
+uint32_t vad_process(vad_t *v, const int16_t *pcm, uint32_t n)
+{
+    float a = v->hp_a, b = v->lp_b;
+    uint32_t events = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        float x = pcm[i] * (1.0f / 32768.0f);
+        v->hp_y = a * (v->hp_y + x - v->hp_x);
+        v->hp_x = x;
+        v->lp_y += b * (v->hp_y - v->lp_y);
+
+        float band = v->lp_y;
+        v->sum_full += x * x;
+        v->sum_band += band * band;
+        v->crossings += (band >= 0.0f) != (v->last_band >= 0.0f);
+        v->last_band = band;
+        v->samples++;
+        if (++v->fill == v->cfg.frame_len) {
+            events += frame_done(v);
+        }
+    }
+    return events;
+}
@@ -0,0 +1,94 @@
+#ifndef __VAD_H__
+#define __VAD_H__
+
+#include <stdint.h>
+
+/*
+ * Voice activity detector, to keep feature extraction and keyword spotting
+ * asleep while nobody talks. Works on 10 ms frames of 16 bit PCM:
+ *
+ *   band energy   after a one pole 200 Hz high-pass and 3.4 kHz low-pass,
+ *                 in dBFS, against a noise floor that follows it down
+ *                 quickly and up slowly (slower still during speech)
+ *   band ratio    band energy over full band energy: hum and hiss fail it
+ *   zero-crossing rate of the band signal: tones and voice sit low, broad
+ *                 noise high
+ *
+ * A frame is speech when the band energy is threshold_db over the floor
+ * and above min_db, the ratio reaches min_ratio and the ZCR is under
+ * max_zcr. start_frames speech frames in a row start a segment, hang_frames
+ * without one end it. Start and end events go into a small single producer
+ * / single consumer queue, so the detector can run in the capture path and
+ * the heavy work in another task.
+ */
+
+#define VAD_EVENTS (16) /* power of 2 */
+
+#define VAD_SPEECH_START (1)
+#define VAD_SPEECH_END (2)
+
+typedef struct {
+    uint32_t rate;
+    uint32_t frame_len;   /* samples */
+    float threshold_db;   /* over the noise floor */
+    float min_db;         /* dBFS, nothing quieter is speech */
+    float min_ratio;      /* band / full band energy */
+    float max_zcr;        /* crossings per sample */
+    uint32_t start_frames;
+    uint32_t hang_frames;
+    float floor_rise;     /* per frame, fraction of the gap */
+} vad_cfg_t;
+
+typedef struct {
+    uint8_t type;
+    uint32_t sample; /* START: first sample of the first speech frame; END: first sample after the hangover */
+} vad_event_t;
+
+typedef struct {
+    vad_cfg_t cfg;
+
+    /* filters, kept across frames */
+    float hp_a, lp_b;
+    float hp_x, hp_y, lp_y;
+    float last_band;
+
+    /* frame being gathered */
+    uint32_t fill;
+    float sum_full, sum_band;
+    uint32_t crossings;
+
+    float floor_db;
+    int primed;
+    int active;
+    uint32_t run;     /* speech frames in a row */
+    uint32_t silence; /* non-speech frames in a row while active */
+    uint32_t run_start;
+
+    uint32_t samples; /* seen, ever */
+    uint32_t frames;
+    uint32_t speech_frames;
+
+    /* last frame, for stats */
+    float band_db;
+    float ratio;
+    float zcr;
+
+    vad_event_t events[VAD_EVENTS];
+    volatile uint32_t ev_head;
+    volatile uint32_t ev_tail;
+    uint32_t ev_dropped;
+} vad_t;
+
+/* sensitivity 0 (only clear speech) .. 3 (anything voice like) at rate Hz, 10 ms frames */
+void vad_default_cfg(vad_cfg_t *cfg, uint32_t rate, int sensitivity);
+
+/* Returns 0, or -1 for a frame length of 0. */
+int vad_init(vad_t *v, const vad_cfg_t *cfg);
+
+/* Runs n samples through the detector. Returns the number of events queued. */
+uint32_t vad_process(vad_t *v, const int16_t *pcm, uint32_t n);
+
+/* Consumer side of the event queue. Returns 1 with *ev filled, or 0 when empty. */
+int vad_event_pop(vad_t *v, vad_event_t *ev);
+
+#endif /* __VAD_H__ */
@@ -0,0 +1,136 @@
+#include <string.h>
+
+#include "wav_writer.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#define wav_fopen(path) open((path), O_RDWR | O_CREAT | O_TRUNC, 0644)
+#define wav_fclose(fd) close(fd)
+#define wav_fwrite(fd, buf, len) write((fd), (buf), (len))
+#define wav_fseek(fd, off) lseek((fd), (off), SEEK_SET)
+#define wav_fsync(fd) fsync(fd)
+#else
+#include <fcntl.h>
+#include <vfs.h>
+#define wav_fopen(path) aos_open((path), O_RDWR | O_CREAT | O_TRUNC)
+#define wav_fclose(fd) aos_close(fd)
+#define wav_fwrite(fd, buf, len) aos_write((fd), (buf), (len))
+#define wav_fseek(fd, off) aos_lseek((fd), (off), SEEK_SET)
+#define wav_fsync(fd) aos_sync(fd)
+#endif
+
+static inline uint8_t *put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static inline uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+    return p + 4;
+}
+
+void wav_header_build(uint8_t *hdr, uint32_t rate, uint16_t channels, uint32_t data_bytes)
+{
+    uint8_t *p = hdr;
+
+    memcpy(p, "RIFF", 4);
+    p = put32(p + 4, 36 + data_bytes);
+    memcpy(p, "WAVEfmt ", 8);
+    p = put32(p + 8, 16);
+    p = put16(p, 1); /* PCM */
+    p = put16(p, channels);
+    p = put32(p, rate);
+    p = put32(p, rate * channels * 2); /* byte rate */
+    p = put16(p, channels * 2);        /* block align */
+    p = put16(p, 16);                  /* bits per sample */
+    memcpy(p, "data", 4);
+    put32(p + 4, data_bytes);
+}
+
+static int flush(wav_writer_t *w)
+{
+    if (w->error) {
+        return -1;
+    }
+    if (w->fill && (int)w->fill != wav_fwrite(w->fd, w->buf, w->fill)) {
+        w->error = 1;
+        return -1;
+    }
+    w->data_bytes += w->fill;
+    w->fill = 0;
+    return 0;
+}
+
+/* the header rewritten in place, then back to the end of the data */
+static int patch_header(wav_writer_t *w)
+{
+    uint8_t hdr[WAV_HDR_SIZE];
+
+    wav_header_build(hdr, w->rate, w->channels, w->data_bytes);
+    if (wav_fseek(w->fd, 0) < 0 || WAV_HDR_SIZE != wav_fwrite(w->fd, hdr, WAV_HDR_SIZE) ||
+        wav_fseek(w->fd, WAV_HDR_SIZE + w->data_bytes) < 0) {
+        w->error = 1;
+        return -1;
+    }
+    return 0;
+}
+
+int wav_open(wav_writer_t *w, const char *path, uint32_t rate, uint16_t channels)
+{
+    uint8_t hdr[WAV_HDR_SIZE];
+
+    memset(w, 0, sizeof(*w));
+    w->rate = rate;
+    w->channels = channels;
+    if ((w->fd = wav_fopen(path)) < 0) {
+        return -1;
+    }
+    wav_header_build(hdr, rate, channels, 0);
+    if (WAV_HDR_SIZE != wav_fwrite(w->fd, hdr, WAV_HDR_SIZE)) {
+        wav_fclose(w->fd);
+        return -1;
+    }
+    return 0;
+}
+
+int wav_write(wav_writer_t *w, const int16_t *samples, uint32_t n)
+{
+    const uint8_t *src = (const uint8_t *)samples;
+    uint32_t len = n * sizeof(int16_t);
+
+    while (len) {
+        uint32_t k = WAV_WRITER_BUF - w->fill;
+        if (k > len) {
+            k = len;
+        }
+        memcpy(w->buf + w->fill, src, k); /* little endian, as WAV wants it */
+        w->fill += k;
+        src += k;
+        len -= k;
+        if (WAV_WRITER_BUF == w->fill && 0 != flush(w)) {
+            return -1;
+        }
+    }
+    return w->error ? -1 : 0;
+}
+
+int wav_checkpoint(wav_writer_t *w)
+{
+    if (0 != flush(w) || 0 != patch_header(w)) {
+        return -1;
+    }
+    return 0 == wav_fsync(w->fd) ? 0 : -1;
+}
+
+int wav_close(wav_writer_t *w)
+{
+    int ret = wav_checkpoint(w);
+    wav_fclose(w->fd);
+    w->fd = -1;
+    return ret;
+}
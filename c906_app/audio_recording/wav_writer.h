@@ -0,0 +1,42 @@
+#ifndef __WAV_WRITER_H__
+#define __WAV_WRITER_H__
+
+#include <stdint.h>
+
+/*
+ * RIFF/WAVE writer for 16 bit PCM. The 44 byte header goes out first with
+ * zero sizes and is patched on wav_close(); wav_checkpoint() patches it
+ * along the way so a file cut short by a reset still plays up to there.
+ * Samples are collected into WAV_WRITER_BUF bytes before each write, LFS
+ * and FatFs both do far better with few large writes than many small ones.
+ */
+
+#define WAV_HDR_SIZE (44)
+#define WAV_WRITER_BUF (4096)
+
+typedef struct {
+    int fd;
+    uint32_t rate;
+    uint16_t channels;
+    uint32_t data_bytes; /* written to the file */
+    uint32_t fill;
+    uint8_t buf[WAV_WRITER_BUF];
+    int error;
+} wav_writer_t;
+
+/* Fills WAV_HDR_SIZE bytes for data_bytes of 16 bit PCM. */
+void wav_header_build(uint8_t *hdr, uint32_t rate, uint16_t channels, uint32_t data_bytes);
+
+/* Returns 0 or -1. */
+int wav_open(wav_writer_t *w, const char *path, uint32_t rate, uint16_t channels);
+
+/* n samples (frames * channels). Returns 0 or -1 once a write has failed. */
+int wav_write(wav_writer_t *w, const int16_t *samples, uint32_t n);
+
+/* Flushes and patches the header, the file stays open. Returns 0 or -1. */
+int wav_checkpoint(wav_writer_t *w);
+
+/* Flushes, patches the header and closes. Returns 0 or -1. */
+int wav_close(wav_writer_t *w);
+
+#endif /* __WAV_WRITER_H__ */
@@ -0,0 +1,90 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* RISCV */
+#include <csi_core.h>
+
+/* m1s utils */
+#include <imgtool/bilinear_interpolation.h>
+#include <imgtool/rgb_cvt.h>
+
+#include "blai_input.h"
+
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+#define ALIGNDOWN(x, r) ((x) & ~((r)-1))
+
+int blai_input_acquire(BLAI_Model_t *model, blai_input_view_t *view)
+{
+    if (NULL == model || NULL == model->buffer) {
+        return -1;
+    }
+
+    struct blai_net_info_t *net = model->net;
+    view->data = model->buffer;
+    view->w = net->w;
+    view->h = net->h;
+    view->c = (net->c) == 1 ? (net->c) : ALIGNUP((net->c), 4);
+    view->stride = view->w * view->c;
+    view->size = view->stride * view->h;
+    /*
+     * blai_net_info_t carries no input quantiser: the toolchain feeds the
+     * model image bytes as they are (input_type = image in BLAI.cfg), so
+     * identity until the caller sets the tflite input's own
+     */
+    view->scale = 1.0f;
+    view->zero_point = 0;
+    view->aligned = 0 == ((uintptr_t)view->data & (BLAI_INPUT_CACHE_LINE - 1));
+    if (!view->aligned) {
+        printf("[blai_input] input tensor %p is not cache line aligned\r\n", view->data);
+    }
+    return 0;
+}
+
+void blai_input_commit(const blai_input_view_t *view)
+{
+    uintptr_t start = ALIGNDOWN((uintptr_t)view->data, BLAI_INPUT_CACHE_LINE);
+    uintptr_t end = ALIGNUP((uintptr_t)view->data + view->size, BLAI_INPUT_CACHE_LINE);
+    csi_dcache_clean_range((void *)start, end - start);
+}
+
+static inline uint8_t quantize(const blai_input_view_t *view, uint32_t v)
+{
+    if (1.0f == view->scale && 0 == view->zero_point) {
+        return (uint8_t)v;
+    }
+    long q = lrintf((float)v / view->scale) + view->zero_point;
+    return (uint8_t)(q < 0 ? 0 : q > 255 ? 255 : q);
+}
+
+void blai_input_rgba8888_to_gray(const blai_input_view_t *view, const uint32_t *src, uint32_t src_w, uint32_t crop_x,
+                                 uint32_t crop_y, uint32_t crop_w, uint32_t crop_h, uint32_t *scratch, bool invert,
+                                 uint8_t threshold)
+{
+    uint32_t *crop = scratch;
+    uint32_t *rgba = scratch + crop_w * crop_h;
+    uint32_t n = view->w * view->h;
+
+    /* the sdk kernels take whole images, so the window is staged first */
+    for (uint32_t y = 0; y < crop_h; y++) {
+        memcpy(crop + y * crop_w, src + (crop_y + y) * src_w + crop_x, sizeof(uint32_t) * crop_w);
+    }
+    BilinearInterpolation_RGBA8888((void *)crop, crop_w, crop_h, (void *)rgba, view->w, view->h);
+    /* packed gray, one byte per pixel, lands at the start of the tensor */
+    RGBA88882GRAY((void *)rgba, (void *)view->data, view->w, view->h);
+
+    if (1 == view->c && !invert && 0 == threshold && 1.0f == view->scale && 0 == view->zero_point) {
+        return;
+    }
+    /* from the last pixel down, so spreading it over c channels never overwrites a pixel not read yet */
+    for (uint32_t i = n; i-- > 0;) {
+        uint32_t v = view->data[i];
+        if (invert) v = 255 - v;
+        if (v < threshold) v = 0;
+        uint8_t q = quantize(view, v);
+        uint8_t *dst = view->data + (i / view->w) * view->stride + (i % view->w) * view->c;
+        for (uint32_t k = 0; k < view->c; k++) {
+            dst[k] = q;
+        }
+    }
+}
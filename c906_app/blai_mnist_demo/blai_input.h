@@ -0,0 +1,58 @@
+#ifndef __BLAI_INPUT_H__
+#define __BLAI_INPUT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* bl808 ai */
+#include <blai_core.h>
+
+/* C906 L1 D-cache line */
+#define BLAI_INPUT_CACHE_LINE (64)
+
+/**
+ * Writable view of the NPU input tensor held in model->buffer.
+ * Preprocessing kernels write straight into data, then blai_input_commit()
+ * cleans exactly the lines the NPU is going to read.
+ */
+typedef struct {
+    uint8_t *data;    /* first byte of the input tensor */
+    uint32_t w;       /* tensor width */
+    uint32_t h;       /* tensor height */
+    uint32_t c;       /* channels as laid out in memory (aligned to 4 if not 1) */
+    uint32_t stride;  /* bytes per row */
+    uint32_t size;    /* bytes the NPU reads */
+    float scale;      /* real = (q - zero_point) * scale, the kernels quantise with it */
+    int zero_point;   /* 1.0 and 0 from acquire, the bytes as they are */
+    bool aligned;     /* data starts on a cache line */
+} blai_input_view_t;
+
+/**
+ * Fill view with the input tensor of a loaded model.
+ * Returns 0 on success, -1 if the model has no input buffer.
+ */
+int blai_input_acquire(BLAI_Model_t *model, blai_input_view_t *view);
+
+/**
+ * Write back the D-cache lines covering the tensor so the NPU sees the data.
+ */
+void blai_input_commit(const blai_input_view_t *view);
+
+/* 32 bit words of scratch blai_input_rgba8888_to_gray() needs for a crop_w x crop_h window */
+#define BLAI_INPUT_SCRATCH_WORDS(view, crop_w, crop_h) ((crop_w) * (crop_h) + (view)->w * (view)->h)
+
+/**
+ * Bilinear resize a (crop_w x crop_h) window of an RGBA8888 image into the
+ * tensor and convert it to gray, with the sdk's BilinearInterpolation_RGBA8888
+ * and RGBA88882GRAY, so the result is bit for bit what they give through a
+ * staging buffer. With invert set the gray value is inverted, values below
+ * threshold are forced to zero (threshold 0 disables it), then the value is
+ * quantised with the view's scale and zero point and written to every
+ * channel.
+ * scratch holds BLAI_INPUT_SCRATCH_WORDS and must not overlap the window.
+ */
+void blai_input_rgba8888_to_gray(const blai_input_view_t *view, const uint32_t *src, uint32_t src_w, uint32_t crop_x,
+                                 uint32_t crop_y, uint32_t crop_w, uint32_t crop_h, uint32_t *scratch, bool invert,
+                                 uint8_t threshold);
+
+#endif /* __BLAI_INPUT_H__ */
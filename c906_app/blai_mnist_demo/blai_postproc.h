@@ -0,0 +1,79 @@
+#ifndef __BLAI_POSTPROC_H__
+#define __BLAI_POSTPROC_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Post-processing for quantised classifier outputs.
+ * Kernels use RVV when the compiler targets it (__riscv_vector), define
+ * PP_FORCE_SCALAR to build the scalar reference only. The *_ref functions
+ * are always available for checking the vector paths.
+ */
+
+#define PP_TOPK_MAX (8)
+#define PP_VOTE_MAX (16)
+
+typedef struct {
+    uint32_t idx;
+    float score;
+} pp_class_t;
+
+/* out[i] = (q[i] - zero_point) * scale */
+void pp_dequant_u8(const uint8_t *q, float *out, uint32_t n, float scale, int zero_point);
+void pp_dequant_u8_ref(const uint8_t *q, float *out, uint32_t n, float scale, int zero_point);
+
+/* in place, subtracts the max before exponentiation */
+void pp_softmax(float *x, uint32_t n);
+void pp_softmax_ref(float *x, uint32_t n);
+
+/**
+ * Partial selection of the k largest entries, best first. Equal scores keep
+ * the lower index first. Returns the number of entries written (min(k, n)).
+ */
+uint32_t pp_topk(const float *x, uint32_t n, uint32_t k, pp_class_t *out);
+
+/* same on raw quantised output, score is the dequantised value */
+uint32_t pp_topk_u8(const uint8_t *q, uint32_t n, uint32_t k, float scale, int zero_point, pp_class_t *out);
+
+/* exponential moving average over per-class scores */
+typedef struct {
+    float *state; /* n entries, owned by the caller */
+    uint32_t n;
+    float alpha;  /* weight of the newest frame */
+    bool primed;
+} pp_ema_t;
+
+void pp_ema_init(pp_ema_t *ema, float *state, uint32_t n, float alpha);
+/* blend scores into the state and return the state */
+const float *pp_ema_update(pp_ema_t *ema, const float *scores);
+
+/* majority vote over the last len frame decisions */
+typedef struct {
+    uint16_t hist[PP_VOTE_MAX];
+    uint32_t len;
+    uint32_t pos;
+    uint32_t count;
+} pp_vote_t;
+
+void pp_vote_init(pp_vote_t *vote, uint32_t len);
+/* push this frame's class, returns the most frequent class (newest wins ties) */
+uint32_t pp_vote_update(pp_vote_t *vote, uint32_t cls);
+
+/*
+ * Confidence hysteresis: a class becomes active once its confidence reaches
+ * on, and stays active until it drops below off or another class reaches on.
+ * The active class's own confidence is looked at every frame, whichever
+ * class the caller proposes.
+ */
+typedef struct {
+    float on;
+    float off;
+    int active; /* -1 when nothing is active */
+} pp_hyst_t;
+
+void pp_hyst_init(pp_hyst_t *hyst, float on, float off);
+/* cls is this frame's candidate (top-1, voted...), conf the n per-class confidences; returns the active class */
+int pp_hyst_update(pp_hyst_t *hyst, uint32_t cls, const float *conf, uint32_t n);
+
+#endif /* __BLAI_POSTPROC_H__ */
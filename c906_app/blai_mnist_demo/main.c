@@ -6,7 +6,7 @@
 #include <task.h>
 
 /* fs */
-// #include <bl_romfs.h>
+#include <bl_romfs.h>
 #include <fatfs.h>
 
 /* lcd */
@@ -29,7 +29,10 @@
 /* m1s utils */
 #include <imgtool/bilinear_interpolation.h>
 #include <imgtool/rgb_cvt.h>
-#include <mathtool/argmax.h>
+
+#include "blai_input.h"
+#include "blai_postproc.h"
+#include "model_loader.h"
 
 #if 0
 #define DBG_PRINTF(...) printf(__VA_ARGS__)
@@ -83,6 +86,7 @@ static inline void draw_rect_filled(rgb565_frame_t *frame, uint16_t sx, uint16_t
 
 void main()
 {
+    romfs_register();
     fatfs_register();
 
     { /* SPI LCD init... */
@@ -108,54 +112,23 @@ void main()
 
 #define IMG_W (28)
 #define IMG_H (28)
-    static uint32_t input_buf[IMG_W * IMG_H];
 
     BLAI_Model_t *s_blai_model = NULL;
-    { /* load model */
-        s_blai_model = blai_create();
-        if (NULL == s_blai_model) {
-            printf("[failed] create blai handler\r\n");
-            return;
-        }
-
-        int fd = -1;
-        if (0 > (fd = aos_open("/flash/models/mnist.blai", 0))) {
-            printf("[failed] open model file\r\n");
-            return;
-        }
-
-        int model_bin_len = 0;
-        uint8_t *model_bin_buf = NULL;
-
-        model_bin_len = aos_lseek(fd, 0, SEEK_END);
-        if (0 >= model_bin_len) {
-            aos_close(fd);
-            printf("[failed] the length of model file is less then zero\r\n");
-            return;
-        }
-
-        if (NULL == (model_bin_buf = malloc(model_bin_len))) {
-            aos_close(fd);
-            printf("[failed] malloc buffer to read model\r\n");
-            return;
-        }
-
-        aos_lseek(fd, 0, SEEK_SET);
-        if (model_bin_len != aos_read(fd, model_bin_buf, model_bin_len)) {
-            aos_close(fd);
-            printf("[failed] err occur while reading model\r\n");
-            return;
+    { /* load model, romfs copy runs from xip, the udisk copy is read in chunks */
+        const char *model_paths[] = {
+            "/romfs/models/mnist.blai",
+            "/flash/models/mnist.blai",
+        };
+        model_load_info_t info;
+        for (int i = 0; i < sizeof(model_paths) / sizeof(model_paths[0]) && NULL == s_blai_model; i++) {
+            if (NULL != (s_blai_model = model_loader_load(model_paths[i], &info))) {
+                model_loader_dump(model_paths[i], &info);
+            }
         }
-        aos_close(fd);
-
-        if (BLAI_STATUS_NO_ERROR != blai_load_model_from_buffer(s_blai_model, (uint8_t *)model_bin_buf)) {
-            blai_free(s_blai_model);
-            s_blai_model = NULL;
-            free(model_bin_buf);
+        if (NULL == s_blai_model) {
             printf("[failed] load model to npu\r\n");
             return;
         }
-        free(model_bin_buf);
     }
 
     { /* show inout shape */
@@ -174,6 +147,20 @@ void main()
         printf("real output shape %ux%ux%u\r\n", h, w, (c) == 1 ? (c) : ALIGNUP((c), 4));
     }
 
+    blai_input_view_t input;
+    if (0 != blai_input_acquire(s_blai_model, &input) || IMG_W != input.w || IMG_H != input.h) {
+        printf("[failed] model input is not %ux%u\r\n", IMG_W, IMG_H);
+        blai_free(s_blai_model);
+        return;
+    }
+    printf("input tensor %p, %u bytes written in place (no feed copy)\r\n", input.data, input.size);
+
+    /* majority of the last 5 frames, shown from 60% confidence until it drops below 40% */
+    pp_vote_t vote;
+    pp_hyst_t hyst;
+    pp_vote_init(&vote, 5);
+    pp_hyst_init(&hyst, 0.6f, 0.4f);
+
     for (uint64_t __loop_count = 0;; __loop_count++) {
         DBG_PRINTF("[%u] loop..\r\n", __loop_count);
 
@@ -198,40 +185,21 @@ void main()
 #define CROP_H (4 * IMG_H)
 #define CROP_X ((TARGET_WH - CROP_W) / 2)
 #define CROP_Y ((TARGET_WH - CROP_H) / 2)
-            { /* crop */
-                for (uint32_t y = 0; y < CROP_H; y++) {
-                    memcpy(picture + sizeof(uint32_t) * (TARGET_WH * TARGET_WH + y * CROP_W),
-                           picture + sizeof(uint32_t) * (TARGET_WH * (CROP_Y + y) + CROP_X), sizeof(uint32_t) * CROP_W);
-                }
-
-                BilinearInterpolation_RGBA8888(picture + sizeof(uint32_t) * TARGET_WH * TARGET_WH, CROP_W, CROP_H,
-                                               input_buf, IMG_W, IMG_H);
-                RGBA88882GRAY(input_buf, input_buf, IMG_W, IMG_H);
-
-                uint8_t *input_buf_u8 = (uint8_t *)input_buf;
-                for (uint32_t i = 0; i < IMG_H * IMG_W; i++) {
-                    input_buf_u8[i] = ~input_buf_u8[i];
-                    if (input_buf_u8[i] < 128) input_buf_u8[i] = 0;
-                }
+            { /* crop, resize and convert straight into the npu input tensor, staging in the frame's spare tail */
+                blai_input_rgba8888_to_gray(&input, (uint32_t *)picture, TARGET_WH, CROP_X, CROP_Y, CROP_W, CROP_H,
+                                            (uint32_t *)picture + TARGET_WH * TARGET_WH, true, 128);
+                blai_input_commit(&input);
 
                 DBG_PRINTF("\r\n");
-                for (uint32_t ih = 0; ih < IMG_H; ih++) {
-                    DBG_PRINTF("\t[%3u", input_buf_u8[ih * IMG_W]);
-                    for (uint32_t iw = 1; iw < IMG_W; iw++) {
-                        DBG_PRINTF(",%3u", input_buf_u8[ih * IMG_W + iw]);
+                for (uint32_t ih = 0; ih < input.h; ih++) {
+                    DBG_PRINTF("\t[%3u", input.data[ih * input.stride]);
+                    for (uint32_t iw = 1; iw < input.w; iw++) {
+                        DBG_PRINTF(",%3u", input.data[ih * input.stride + iw * input.c]);
                     }
                     DBG_PRINTF("],\r\n");
                 }
             }
 
-            { /* feed model */
-                uint8_t *p_input = s_blai_model->buffer;
-                struct blai_net_info_t *net = s_blai_model->net;
-                uint32_t feed_size = net->w * net->h * ((net->c) == 1 ? (net->c) : ALIGNUP((net->c), 4));
-                memcpy(p_input, input_buf, feed_size);
-                csi_dcache_clean_range((uint8_t *)p_input, feed_size);
-            }
-
             { /* draw cropped edge */
                 for (uint32_t x = 0; x < CROP_W + 2; x++) {
                     ((uint32_t *)picture)[TARGET_WH * (CROP_Y - 1) + CROP_X - 1 + x] = 0xff;
@@ -269,11 +237,23 @@ void main()
             uint32_t c = net->layers[total_layer_cnt - 1].out_c;
             uint32_t output_size = h * w * c;
 
-            uint32_t idx = ARGMAX(output, output_size);
-            printf("[%u/%u]output %d, %f", idx, output_size, output_zero_point, output_scale);
+#define NUM_CLASSES (10)
+            if (output_size > NUM_CLASSES) output_size = NUM_CLASSES;
+            static float scores[NUM_CLASSES];
+            pp_dequant_u8(output, scores, output_size, output_scale, output_zero_point);
+            pp_softmax(scores, output_size);
+
+            pp_class_t top[3];
+            uint32_t top_cnt = pp_topk(scores, output_size, 3, top);
+            uint32_t idx = pp_vote_update(&vote, top[0].idx);
+            int shown = pp_hyst_update(&hyst, idx, scores, output_size);
+            printf("[%u/%u]output %d, %f:", idx, output_size, output_zero_point, output_scale);
+            for (uint32_t i = 0; i < top_cnt; i++) {
+                printf(" %u(%.2f)", top[i].idx, top[i].score);
+            }
 
             rgb565_frame_t *pf = &f;
-            draw_char(pf, pf->w / 2, 16, idx + '0', 0x07e0, 0x0000);
+            draw_char(pf, pf->w / 2, 16, shown >= 0 ? shown + '0' : '?', 0x07e0, 0x0000);
 
             DBG_PRINTF(":\t[%3u", output[0]);
             for (uint32_t i = 1; i < output_size; i++) {
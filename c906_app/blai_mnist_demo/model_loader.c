@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* FreeRTOS */
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* bl808 c906 std driver */
+#include <bl808_glb.h>
+
+/* aos */
+#include <aos/kernel.h>
+#include <fs/vfs_romfs.h>
+#include <vfs.h>
+
+#include "model_loader.h"
+
+static inline void track_heap(uint32_t heap_base, uint32_t *peak)
+{
+    uint32_t used = heap_base - xPortGetFreeHeapSize();
+    if (used > *peak) *peak = used;
+}
+
+static uint8_t *read_chunked(int fd, uint32_t size, uint32_t heap_base, uint32_t *peak)
+{
+    uint8_t *buf = malloc(size);
+    if (NULL == buf) {
+        printf("[model_loader] malloc %u bytes failed\r\n", size);
+        return NULL;
+    }
+    track_heap(heap_base, peak);
+
+    aos_lseek(fd, 0, SEEK_SET);
+    for (uint32_t off = 0; off < size;) {
+        uint32_t n = size - off;
+        if (n > MODEL_LOADER_CHUNK_SIZE) n = MODEL_LOADER_CHUNK_SIZE;
+        if ((int)n != aos_read(fd, buf + off, n)) {
+            printf("[model_loader] short read at %u\r\n", off);
+            free(buf);
+            return NULL;
+        }
+        off += n;
+    }
+    return buf;
+}
+
+BLAI_Model_t *model_loader_load(const char *path, model_load_info_t *info)
+{
+    model_load_info_t tmp;
+    if (NULL == info) info = &tmp;
+
+    uint64_t start_us = CPU_Get_MTimer_US();
+    uint32_t heap_base = xPortGetFreeHeapSize();
+    uint32_t peak = 0;
+
+    int fd = aos_open(path, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    int len = aos_lseek(fd, 0, SEEK_END);
+    if (len <= 0) {
+        printf("[model_loader] %s is empty\r\n", path);
+        aos_close(fd);
+        return NULL;
+    }
+    info->file_size = len;
+
+    romfs_filebuf_t filebuf = {0};
+    uint8_t *model_bin = NULL;
+    uint8_t *file_buf = NULL;
+    if (0 == aos_ioctl(fd, IOCTL_ROMFS_GET_FILEBUF, (long unsigned int)&filebuf) && NULL != filebuf.buf) {
+        info->src = MODEL_SRC_XIP;
+        model_bin = (uint8_t *)filebuf.buf;
+    } else {
+        info->src = MODEL_SRC_CHUNKED;
+        model_bin = file_buf = read_chunked(fd, len, heap_base, &peak);
+    }
+    aos_close(fd);
+    if (NULL == model_bin) {
+        return NULL;
+    }
+
+    BLAI_Model_t *model = blai_create();
+    if (NULL == model) {
+        printf("[model_loader] create blai handler failed\r\n");
+        free(file_buf);
+        return NULL;
+    }
+    if (BLAI_STATUS_NO_ERROR != blai_load_model_from_buffer(model, model_bin)) {
+        printf("[model_loader] load %s to npu failed\r\n", path);
+        blai_free(model);
+        free(file_buf);
+        return NULL;
+    }
+    track_heap(heap_base, &peak);
+    free(file_buf);
+
+    info->peak_heap = peak;
+    info->resident = heap_base - xPortGetFreeHeapSize();
+    info->load_us = (uint32_t)(CPU_Get_MTimer_US() - start_us);
+    return model;
+}
+
+void model_loader_dump(const char *path, const model_load_info_t *info)
+{
+    printf("[model_loader] %s: %s, file %u bytes, %u.%03ums, peak heap %u, resident %u\r\n", path,
+           MODEL_SRC_XIP == info->src ? "xip" : "chunked", info->file_size, info->load_us / 1000, info->load_us % 1000,
+           info->peak_heap, info->resident);
+}
@@ -0,0 +1,39 @@
+#ifndef __MODEL_LOADER_H__
+#define __MODEL_LOADER_H__
+
+#include <stdint.h>
+
+/* bl808 ai */
+#include <blai_core.h>
+
+/* size of each aos_read when the model has to be read into RAM */
+#define MODEL_LOADER_CHUNK_SIZE (16 * 1024)
+
+typedef enum {
+    MODEL_SRC_XIP = 0, /* weights used in place from the flash XIP window */
+    MODEL_SRC_CHUNKED, /* whole file read into a RAM buffer, chunk by chunk */
+} model_src_t;
+
+typedef struct {
+    model_src_t src;
+    uint32_t file_size;  /* bytes of the .blai file */
+    uint32_t load_us;    /* open to blai_load_model_from_buffer() return */
+    uint32_t peak_heap;  /* largest heap usage seen during the load */
+    uint32_t resident;   /* heap still held by the loaded model */
+} model_load_info_t;
+
+/**
+ * Load a .blai file into a new model handle.
+ * Files living in romfs are handed to the NPU straight from their XIP
+ * address, so only the sections blai copies for itself end up in RAM.
+ * Anything else is read in MODEL_LOADER_CHUNK_SIZE pieces into a temporary
+ * buffer of the whole file, released once the model is loaded: libblai
+ * only loads from one complete buffer, so for these the file does sit in
+ * RAM next to what blai copies, the chunks only bound each read.
+ * Returns NULL on failure, info may be NULL.
+ */
+BLAI_Model_t *model_loader_load(const char *path, model_load_info_t *info);
+
+void model_loader_dump(const char *path, const model_load_info_t *info);
+
+#endif /* __MODEL_LOADER_H__ */
@@ -0,0 +1,331 @@
+/*
+ * blai_input_check - blai_input.c against the copy based path it replaced.
+ *
+ * The old main.c staged the crop in the frame's tail, resized it into a
+ * 28x28 RGBA buffer with BilinearInterpolation_RGBA8888, converted that to
+ * gray in place with RGBA88882GRAY, inverted and thresholded it, then
+ * memcpy'd it into model->buffer and cleaned the cache over it. That path
+ * is kept here as it was and both run on the same frames:
+ *
+ *   tensor     random frames, windows, invert and thresholds: the tensor
+ *              blai_input writes in place is byte for byte the one the old
+ *              path fed, and nothing past it in model->buffer is touched
+ *   channels   a 3 channel model (4 in memory) gets that gray value in
+ *              every channel of every pixel
+ *   quant      a scale and zero point other than 1 and 0 quantise the
+ *              value, rounded and clamped to a byte
+ *   commit     the range cleaned covers the tensor, on whole cache lines
+ *              and not a line more
+ *
+ * The SDK kernels are closed, the stand-ins below are a plain bilinear and
+ * a weighted gray. Both paths call the same kernels, which is the point:
+ * blai_input uses the SDK's arithmetic instead of its own, what is checked
+ * is that everything around it (staging, ordering, invert, threshold, the
+ * layout of the tensor) still adds up to the same bytes. It then reports
+ * the bytes each path copies per frame.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -Isdk -o blai_input_check blai_input_check.c ../blai_input.c -lm
+ *   ./blai_input_check -n 2000
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "blai_input.h"
+
+#define CAMERA_W (400)
+#define CAMERA_H (300)
+#define TARGET_WH (CAMERA_H)
+#define IMG_W (28)
+#define IMG_H (28)
+#define BUFFER_SIZE (64 * 1024)
+#define CANARY (0xa5)
+#define MAX_CROP (160) /* the window and its resize fit the 120000 bytes of frame past the square */
+
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+static uintptr_t s_clean_start, s_clean_end;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+void csi_dcache_clean_range(void *addr, int size)
+{
+    s_clean_start = (uintptr_t)addr;
+    s_clean_end = (uintptr_t)addr + size;
+}
+
+/* stand-in: corner aligned 8.8 bilinear on each of the four bytes */
+void BilinearInterpolation_RGBA8888(void *src, uint32_t src_w, uint32_t src_h, void *dst, uint32_t dst_w,
+                                    uint32_t dst_h)
+{
+    const uint32_t *s = src;
+    uint32_t *d = dst;
+
+    for (uint32_t y = 0; y < dst_h; y++) {
+        uint32_t fy = dst_h > 1 ? y * ((src_h - 1) << 8) / (dst_h - 1) : 0;
+        uint32_t y0 = fy >> 8, y1 = y0 + 1 < src_h ? y0 + 1 : y0, wy = fy & 0xff;
+        for (uint32_t x = 0; x < dst_w; x++) {
+            uint32_t fx = dst_w > 1 ? x * ((src_w - 1) << 8) / (dst_w - 1) : 0;
+            uint32_t x0 = fx >> 8, x1 = x0 + 1 < src_w ? x0 + 1 : x0, wx = fx & 0xff;
+            uint32_t p = 0;
+            for (int sh = 0; sh < 32; sh += 8) {
+                uint32_t a = (s[y0 * src_w + x0] >> sh) & 0xff, b = (s[y0 * src_w + x1] >> sh) & 0xff;
+                uint32_t c = (s[y1 * src_w + x0] >> sh) & 0xff, e = (s[y1 * src_w + x1] >> sh) & 0xff;
+                uint32_t top = a * (256 - wx) + b * wx, bot = c * (256 - wx) + e * wx;
+                p |= ((top * (256 - wy) + bot * wy + (1 << 15)) >> 16) << sh;
+            }
+            d[y * dst_w + x] = p;
+        }
+    }
+}
+
+/* stand-in: one gray byte per pixel, packed, in place allowed */
+void RGBA88882GRAY(void *src, void *dst, uint32_t w, uint32_t h)
+{
+    const uint32_t *s = src;
+    uint8_t *d = dst;
+
+    for (uint32_t i = 0; i < w * h; i++) {
+        uint32_t p = s[i];
+        d[i] = (uint8_t)(((p & 0xff) * 38 + ((p >> 8) & 0xff) * 75 + ((p >> 16) & 0xff) * 15) >> 7);
+    }
+}
+
+static uint32_t s_old_copied;
+
+static void old_copy(void *dst, const void *src, uint32_t len)
+{
+    memcpy(dst, src, len);
+    s_old_copied += len;
+}
+
+/* the pre blai_input main.c, with the window and the threshold as parameters */
+static void old_path(BLAI_Model_t *model, uint8_t *picture, uint32_t crop_x, uint32_t crop_y, uint32_t crop_w,
+                     uint32_t crop_h, int invert, uint8_t threshold)
+{
+    static uint32_t input_buf[IMG_W * IMG_H];
+
+    for (uint32_t y = 0; y < crop_h; y++) {
+        old_copy(picture + sizeof(uint32_t) * (TARGET_WH * TARGET_WH + y * crop_w),
+                 picture + sizeof(uint32_t) * (TARGET_WH * (crop_y + y) + crop_x), sizeof(uint32_t) * crop_w);
+    }
+    BilinearInterpolation_RGBA8888(picture + sizeof(uint32_t) * TARGET_WH * TARGET_WH, crop_w, crop_h, input_buf,
+                                   IMG_W, IMG_H);
+    RGBA88882GRAY(input_buf, input_buf, IMG_W, IMG_H);
+
+    uint8_t *input_buf_u8 = (uint8_t *)input_buf;
+    for (uint32_t i = 0; i < IMG_H * IMG_W; i++) {
+        if (invert) input_buf_u8[i] = ~input_buf_u8[i];
+        if (input_buf_u8[i] < threshold) input_buf_u8[i] = 0;
+    }
+
+    uint8_t *p_input = model->buffer;
+    struct blai_net_info_t *net = model->net;
+    uint32_t feed_size = net->w * net->h * net->c;
+    old_copy(p_input, input_buf, feed_size);
+    csi_dcache_clean_range((uint8_t *)p_input, feed_size);
+}
+
+static void random_frame(uint32_t *frame)
+{
+    /* smooth blobs and some noise, so the resize has something to blend */
+    uint32_t cx = xorshift(&seed) % TARGET_WH, cy = xorshift(&seed) % TARGET_WH, r = 20 + xorshift(&seed) % 80;
+    for (uint32_t y = 0; y < CAMERA_H; y++) {
+        for (uint32_t x = 0; x < CAMERA_W; x++) {
+            uint32_t dx = x > cx ? x - cx : cx - x, dy = y > cy ? y - cy : cy - y;
+            uint32_t v = dx * dx + dy * dy < r * r ? 30 : 220;
+            frame[y * CAMERA_W + x] = 0xff000000 | (v + xorshift(&seed) % 32) | (v + xorshift(&seed) % 32) << 8 |
+                                      (v - xorshift(&seed) % 30) << 16;
+        }
+    }
+}
+
+static void check_tensor(uint32_t frames)
+{
+    uint32_t *frame = malloc(sizeof(uint32_t) * CAMERA_W * CAMERA_H);
+    uint32_t *copy = malloc(sizeof(uint32_t) * CAMERA_W * CAMERA_H);
+    uint8_t *old_buffer = aligned_alloc(BLAI_INPUT_CACHE_LINE, BUFFER_SIZE);
+    uint8_t *new_buffer = aligned_alloc(BLAI_INPUT_CACHE_LINE, BUFFER_SIZE);
+    struct blai_net_info_t net = {IMG_W, IMG_H, 1};
+    BLAI_Model_t old_model = {&net, old_buffer}, new_model = {&net, new_buffer};
+    blai_input_view_t view;
+    uint64_t new_copied = 0, old_copied = 0;
+
+    CHECK(0 == blai_input_acquire(&new_model, &view), "tensor: acquire");
+    CHECK(view.data == new_buffer && IMG_W == view.w && IMG_H == view.h && 1 == view.c && IMG_W == view.stride &&
+              IMG_W * IMG_H == view.size && view.aligned && 1.0f == view.scale && 0 == view.zero_point,
+          "tensor: view %ux%ux%u stride %u size %u", view.w, view.h, view.c, view.stride, view.size);
+
+    for (uint32_t f = 0; f < frames; f++) {
+        uint32_t crop_w = 0 == f % 4 ? 4 * IMG_W : IMG_W / 2 + xorshift(&seed) % (MAX_CROP - IMG_W / 2 + 1);
+        uint32_t crop_h = 0 == f % 4 ? 4 * IMG_H : IMG_H / 2 + xorshift(&seed) % (MAX_CROP - IMG_H / 2 + 1);
+        uint32_t crop_x = 0 == f % 4 ? (TARGET_WH - crop_w) / 2 : xorshift(&seed) % (TARGET_WH - crop_w + 1);
+        uint32_t crop_y = 0 == f % 4 ? (TARGET_WH - crop_h) / 2 : xorshift(&seed) % (TARGET_WH - crop_h + 1);
+        int invert = 0 == f % 4 || xorshift(&seed) % 2;
+        uint8_t threshold = 0 == f % 4 ? 128 : 0 == f % 3 ? 0 : xorshift(&seed) % 256;
+
+        /* both start from the 300x300 square main.c makes of the frame */
+        random_frame(frame);
+        for (uint32_t y = 0; y < CAMERA_H; y++) {
+            memmove(frame + y * TARGET_WH, frame + y * CAMERA_W + (CAMERA_W - CAMERA_H) / 2,
+                    sizeof(uint32_t) * TARGET_WH);
+        }
+        memcpy(copy, frame, sizeof(uint32_t) * CAMERA_W * CAMERA_H);
+        memset(old_buffer, CANARY, BUFFER_SIZE);
+        memset(new_buffer, CANARY, BUFFER_SIZE);
+
+        s_old_copied = 0;
+        old_path(&old_model, (uint8_t *)copy, crop_x, crop_y, crop_w, crop_h, invert, threshold);
+        old_copied += s_old_copied;
+
+        blai_input_rgba8888_to_gray(&view, frame, TARGET_WH, crop_x, crop_y, crop_w, crop_h,
+                                    frame + TARGET_WH * TARGET_WH, invert, threshold);
+        blai_input_commit(&view);
+        new_copied += sizeof(uint32_t) * crop_w * crop_h;
+
+        CHECK(0 == memcmp(old_buffer, new_buffer, view.size), "tensor: frame %u (%ux%u at %u,%u, invert %d, >= %u) differs",
+              f, crop_w, crop_h, crop_x, crop_y, invert, threshold);
+        uint32_t i = view.size;
+        while (i < BUFFER_SIZE && CANARY == new_buffer[i]) {
+            i++;
+        }
+        CHECK(BUFFER_SIZE == i, "tensor: frame %u wrote byte %u past the tensor", f, i);
+        CHECK(0 == memcmp(frame, copy, sizeof(uint32_t) * TARGET_WH * TARGET_WH),
+              "tensor: frame %u, the square changed", f);
+
+        CHECK(0 == s_clean_start % BLAI_INPUT_CACHE_LINE && 0 == s_clean_end % BLAI_INPUT_CACHE_LINE &&
+                  s_clean_start <= (uintptr_t)view.data && s_clean_end >= (uintptr_t)view.data + view.size &&
+                  s_clean_end - s_clean_start < view.size + BLAI_INPUT_CACHE_LINE,
+              "commit: cleaned %#lx..%#lx for %u bytes at %p", (unsigned long)s_clean_start,
+              (unsigned long)s_clean_end, view.size, (void *)view.data);
+    }
+
+    printf("per frame: old path copies %llu bytes, in place %llu, the %u byte feed copy and a %u byte buffer avoided\n",
+           (unsigned long long)(frames ? old_copied / frames : 0), (unsigned long long)(frames ? new_copied / frames : 0),
+           view.size, (unsigned)(sizeof(uint32_t) * IMG_W * IMG_H));
+
+    free(frame);
+    free(copy);
+    free(old_buffer);
+    free(new_buffer);
+}
+
+/* a model with 3 channels, 4 in memory, and quantisation other than identity */
+static void check_channels(uint32_t frames)
+{
+    uint32_t *frame = malloc(sizeof(uint32_t) * CAMERA_W * CAMERA_H);
+    uint8_t *gray_buffer = aligned_alloc(BLAI_INPUT_CACHE_LINE, BUFFER_SIZE);
+    uint8_t *rgb_buffer = aligned_alloc(BLAI_INPUT_CACHE_LINE, BUFFER_SIZE);
+    struct blai_net_info_t gray_net = {IMG_W, IMG_H, 1}, rgb_net = {IMG_W, IMG_H, 3};
+    BLAI_Model_t gray_model = {&gray_net, gray_buffer}, rgb_model = {&rgb_net, rgb_buffer};
+    blai_input_view_t gray, rgb;
+
+    blai_input_acquire(&gray_model, &gray);
+    CHECK(0 == blai_input_acquire(&rgb_model, &rgb), "channels: acquire");
+    CHECK(4 == rgb.c && 4 * IMG_W == rgb.stride && 4 * IMG_W * IMG_H == rgb.size, "channels: view c %u stride %u size %u",
+          rgb.c, rgb.stride, rgb.size);
+
+    for (uint32_t f = 0; f < frames; f++) {
+        int invert = xorshift(&seed) % 2, quant = f % 2;
+        uint8_t threshold = xorshift(&seed) % 200;
+
+        random_frame(frame);
+        memset(rgb_buffer, CANARY, BUFFER_SIZE);
+        rgb.scale = quant ? 0.5f + (xorshift(&seed) % 100) / 50.0f : 1.0f;
+        rgb.zero_point = quant ? (int)(xorshift(&seed) % 64) - 32 : 0;
+        blai_input_rgba8888_to_gray(&gray, frame, CAMERA_W, 50, 40, 4 * IMG_W, 4 * IMG_H, frame + TARGET_WH * TARGET_WH,
+                                    invert, threshold);
+        blai_input_rgba8888_to_gray(&rgb, frame, CAMERA_W, 50, 40, 4 * IMG_W, 4 * IMG_H, frame + TARGET_WH * TARGET_WH,
+                                    invert, threshold);
+
+        uint32_t bad = 0;
+        for (uint32_t y = 0; y < IMG_H; y++) {
+            for (uint32_t x = 0; x < IMG_W; x++) {
+                long q = lrintf(gray.data[y * gray.stride + x] / rgb.scale) + rgb.zero_point;
+                q = q < 0 ? 0 : q > 255 ? 255 : q;
+                for (uint32_t k = 0; k < rgb.c; k++) {
+                    bad += q != rgb.data[y * rgb.stride + x * rgb.c + k];
+                }
+            }
+        }
+        CHECK(0 == bad, "channels: frame %u, %u bytes wrong (scale %.2f, zero point %d)", f, bad, rgb.scale,
+              rgb.zero_point);
+        CHECK(CANARY == rgb_buffer[rgb.size], "channels: frame %u wrote past the tensor", f);
+    }
+
+    free(frame);
+    free(gray_buffer);
+    free(rgb_buffer);
+}
+
+static void check_acquire(void)
+{
+    uint8_t *buffer = aligned_alloc(BLAI_INPUT_CACHE_LINE, BUFFER_SIZE);
+    struct blai_net_info_t net = {IMG_W, IMG_H, 1};
+    BLAI_Model_t model = {&net, NULL};
+    blai_input_view_t view;
+
+    CHECK(-1 == blai_input_acquire(&model, &view), "acquire: no buffer accepted");
+    CHECK(-1 == blai_input_acquire(NULL, &view), "acquire: no model accepted");
+    model.buffer = buffer + 8;
+    CHECK(0 == blai_input_acquire(&model, &view) && !view.aligned, "acquire: misaligned tensor reported aligned");
+    blai_input_commit(&view);
+    CHECK(s_clean_start == (uintptr_t)buffer && s_clean_end == (uintptr_t)buffer + 13 * BLAI_INPUT_CACHE_LINE,
+          "acquire: misaligned commit cleaned %#lx..%#lx", (unsigned long)(s_clean_start - (uintptr_t)buffer),
+          (unsigned long)(s_clean_end - (uintptr_t)buffer));
+    free(buffer);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = 500;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                printf("Usage: %s [-n frames] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        printf("seed must be > 0\n");
+        return 2;
+    }
+
+    check_acquire();
+    check_tensor(frames);
+    check_channels(frames / 4 + 1);
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,359 @@
+/*
+ * blai_inspect - host side report of what a BLAI model needs on the BL808.
+ *
+ * It does not decode the .blai file. The container is produced and consumed
+ * by the closed blai toolchain and libblai, its layout is not described
+ * anywhere in this tree and no .blai file ships with it to check a decoder
+ * against. So it reports no per-tensor quantization parameters either, only
+ * the data_type of BLAI.cfg. What is described is the layer table
+ * blai_toolchain prints while converting (see bl808_npu_guide.md): the
+ * layers are read from that log, the memory plan from BLAI.cfg, and of the
+ * .blai file only its size is used.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -o blai_inspect blai_inspect.c
+ *   ./blai_toolchain | tee mnist.log
+ *   ./blai_inspect -c BLAI.cfg -m mnist/model.blai mnist.log
+ *
+ * Exit status is 1 if a layer is not supported by the NPU or the peak
+ * activation memory does not fit in patch_size * patch_num, 0 otherwise.
+ */
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MAX_LAYERS (512)
+
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+
+typedef enum {
+    OP_NPU = 0, /* runs on the NPU */
+    OP_CPU,     /* supported, falls back to the CPU */
+    OP_BAD,     /* not supported */
+} op_where_t;
+
+typedef struct {
+    int idx;
+    char type[32];
+    int filters;
+    int groups;
+    int kw, kh;
+    int stride;
+    int dilation;
+    int in_w, in_h, in_c;
+    int out_w, out_h, out_c;
+    int in[3];
+
+    op_where_t where;
+    char note[64];
+    uint64_t act_bytes;
+    uint64_t weight_bytes;
+    uint64_t macs;
+    int last_use;
+} layer_t;
+
+typedef struct {
+    char username[64];
+    char app_type[32];
+    char data_type[16];
+    char input_format[16];
+    uint32_t patch_size;
+    uint32_t patch_num;
+} cfg_t;
+
+static layer_t s_layers[MAX_LAYERS];
+static int s_layer_cnt;
+
+/* channel count as laid out in NPU memory */
+static int npu_c(int c)
+{
+    return c == 1 ? c : ALIGNUP(c, 4);
+}
+
+static char *trim(char *s)
+{
+    while (isspace((unsigned char)*s)) s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) *--e = '\0';
+    return s;
+}
+
+static int parse_cfg(const char *path, cfg_t *cfg)
+{
+    FILE *fp = fopen(path, "r");
+    if (NULL == fp) {
+        perror(path);
+        return -1;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *eq = strchr(line, '=');
+        if (NULL == eq) continue;
+        *eq = '\0';
+        char *key = trim(line);
+        char *val = trim(eq + 1);
+
+        if (0 == strcmp(key, "username")) {
+            snprintf(cfg->username, sizeof(cfg->username), "%s", val);
+        } else if (0 == strcmp(key, "app_type")) {
+            snprintf(cfg->app_type, sizeof(cfg->app_type), "%s", val);
+        } else if (0 == strcmp(key, "data_type")) {
+            snprintf(cfg->data_type, sizeof(cfg->data_type), "%s", val);
+        } else if (0 == strcmp(key, "input_format")) {
+            snprintf(cfg->input_format, sizeof(cfg->input_format), "%s", val);
+        } else if (0 == strcmp(key, "patch_size")) {
+            cfg->patch_size = strtoul(val, NULL, 0);
+        } else if (0 == strcmp(key, "patch_num")) {
+            cfg->patch_num = strtoul(val, NULL, 0);
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+/*
+ * One layer line of the blai_toolchain log:
+ *     0 CONV           12/   1   3 x   3 / 2(1)    28 x  28 x   1  ->   14 x  14 x  12  -1  -9  -9
+ */
+static int parse_layer(const char *line, layer_t *l)
+{
+    memset(l, 0, sizeof(*l));
+    int n = sscanf(line, " %d %31s %d / %d %d x %d / %d ( %d ) %d x %d x %d -> %d x %d x %d %d %d %d", &l->idx,
+                   l->type, &l->filters, &l->groups, &l->kw, &l->kh, &l->stride, &l->dilation, &l->in_w, &l->in_h,
+                   &l->in_c, &l->out_w, &l->out_h, &l->out_c, &l->in[0], &l->in[1], &l->in[2]);
+    if (n < 14) return -1;
+    for (int i = n - 14; i < 3; i++) l->in[i] = -9;
+    for (char *p = l->type; *p; p++) *p = toupper((unsigned char)*p);
+    return 0;
+}
+
+static int parse_log(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (NULL == fp) {
+        perror(path);
+        return -1;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), fp) && s_layer_cnt < MAX_LAYERS) {
+        layer_t l;
+        if (0 == parse_layer(line, &l) && l.idx == s_layer_cnt) {
+            s_layer_cnt++;
+            s_layers[l.idx] = l;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int is_one_of(int v, const int *set, int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (v == set[i]) return 1;
+    }
+    return 0;
+}
+
+/* operator rules from the table in bl808_npu_guide.md */
+static void classify(layer_t *l)
+{
+    static const int conv_k[] = {1, 3, 5, 7};
+    static const int strides[] = {1, 2};
+    const char *t = l->type;
+    int in_c = l->in_c;
+    int k2 = l->kw * l->kh;
+    uint64_t out_px = (uint64_t)l->out_w * l->out_h;
+    int groups = l->groups > 0 ? l->groups : 1;
+
+    l->where = OP_NPU;
+    if (0 == strcmp(t, "CONV") || 0 == strcmp(t, "DWCONV") || 0 == strcmp(t, "DEPTHWISE")) {
+        int dw = 0 != strcmp(t, "CONV") || (groups > 1 && groups == in_c);
+        if (l->kw != l->kh || !is_one_of(l->kw, conv_k, 4)) {
+            l->where = OP_BAD;
+            snprintf(l->note, sizeof(l->note), "kernel %dx%d, NPU takes 1/3/5/7", l->kw, l->kh);
+        } else if (!is_one_of(l->stride, strides, 2)) {
+            l->where = OP_BAD;
+            snprintf(l->note, sizeof(l->note), "stride %d, NPU takes 1/2", l->stride);
+        }
+        if (dw) {
+            l->weight_bytes = (uint64_t)l->out_c * k2 + 4 * l->out_c;
+            l->macs = out_px * l->out_c * k2;
+        } else {
+            l->weight_bytes = (uint64_t)l->filters * k2 * (in_c / groups) + 4 * l->filters;
+            l->macs = out_px * l->filters * k2 * (in_c / groups);
+        }
+    } else if (0 == strcmp(t, "MATMUL") || 0 == strcmp(t, "FC") || 0 == strcmp(t, "CONNECTED")) {
+        uint64_t in = (uint64_t)l->in_w * l->in_h * in_c;
+        l->weight_bytes = in * l->out_c + 4 * l->out_c;
+        l->macs = in * l->out_c * out_px;
+    } else if (0 == strcmp(t, "MAXPOOL")) {
+        if (l->kw != 3 || !is_one_of(l->stride, strides, 2)) {
+            l->where = OP_BAD;
+            snprintf(l->note, sizeof(l->note), "maxpool %dx%d/%d, NPU takes 3x3/1,2", l->kw, l->kh, l->stride);
+        }
+        l->macs = out_px * l->out_c * k2;
+    } else if (0 == strcmp(t, "AVGPOOL") || 0 == strcmp(t, "GAP") || 0 == strcmp(t, "GMP")) {
+        l->where = OP_CPU;
+        l->macs = (uint64_t)l->in_w * l->in_h * in_c;
+    } else if (0 == strcmp(t, "PRELU") || 0 == strcmp(t, "SIGMOID") || 0 == strcmp(t, "BN") ||
+               0 == strcmp(t, "SLICE")) {
+        l->where = OP_CPU;
+    } else if (0 == strcmp(t, "MUL")) {
+        snprintf(l->note, sizeof(l->note), "CPU+NPU");
+    } else if (0 == strcmp(t, "CONCAT")) {
+        snprintf(l->note, sizeof(l->note), "axis=1 only");
+    } else if (0 == strcmp(t, "DECONV") || 0 == strcmp(t, "UPSAMPLE")) {
+        snprintf(l->note, sizeof(l->note), "runs as upsample+conv");
+    } else if (0 == strcmp(t, "RELU") || 0 == strcmp(t, "RELU6") || 0 == strcmp(t, "ADD") ||
+               0 == strcmp(t, "PAD") || 0 == strcmp(t, "RESHAPE") || 0 == strcmp(t, "ROUTE") ||
+               0 == strcmp(t, "SHORTCUT")) {
+        /* NPU or pure layout change */
+    } else {
+        l->where = OP_BAD;
+        snprintf(l->note, sizeof(l->note), "operator not listed in the NPU guide");
+    }
+    if (OP_CPU == l->where && '\0' == l->note[0]) {
+        snprintf(l->note, sizeof(l->note), "CPU fallback");
+    }
+    l->act_bytes = out_px * npu_c(l->out_c);
+}
+
+/* peak of simultaneously live activations, each output lives until its last consumer */
+static uint64_t plan_activations(uint64_t input_bytes, int *peak_at)
+{
+    for (int i = 0; i < s_layer_cnt; i++) {
+        s_layers[i].last_use = i + 1 < s_layer_cnt ? i + 1 : i;
+    }
+    int input_last = 0;
+    for (int i = 0; i < s_layer_cnt; i++) {
+        for (int j = 0; j < 3; j++) {
+            int src = s_layers[i].in[j];
+            if (src >= 0 && src < s_layer_cnt && s_layers[src].last_use < i) {
+                s_layers[src].last_use = i;
+            } else if (-1 == src && input_last < i) {
+                input_last = i;
+            }
+        }
+    }
+
+    uint64_t peak = 0;
+    *peak_at = 0;
+    for (int i = 0; i < s_layer_cnt; i++) {
+        uint64_t live = i <= input_last ? input_bytes : 0;
+        for (int j = 0; j <= i; j++) {
+            if (s_layers[j].last_use >= i) live += s_layers[j].act_bytes;
+        }
+        if (live > peak) {
+            peak = live;
+            *peak_at = i;
+        }
+    }
+    return peak;
+}
+
+static long file_size(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (NULL == fp) {
+        perror(path);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c BLAI.cfg] [-m model.blai] <blai_toolchain.log>\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *cfg_path = NULL;
+    const char *model_path = NULL;
+    const char *log_path = NULL;
+    cfg_t cfg = {0};
+
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "-c") && i + 1 < argc) {
+            cfg_path = argv[++i];
+        } else if (0 == strcmp(argv[i], "-m") && i + 1 < argc) {
+            model_path = argv[++i];
+        } else if ('-' == argv[i][0]) {
+            usage(argv[0]);
+            return 2;
+        } else {
+            log_path = argv[i];
+        }
+    }
+    if (NULL == log_path) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (cfg_path && 0 != parse_cfg(cfg_path, &cfg)) return 2;
+    if (0 != parse_log(log_path)) return 2;
+    if (0 == s_layer_cnt) {
+        fprintf(stderr, "%s: no layer table found\n", log_path);
+        return 2;
+    }
+
+    if (cfg_path) {
+        printf("model    %s\n", cfg.username[0] ? cfg.username : "-");
+        printf("app_type %s, data_type %s, input_format %s\n", cfg.app_type[0] ? cfg.app_type : "-",
+               cfg.data_type[0] ? cfg.data_type : "-", cfg.input_format[0] ? cfg.input_format : "-");
+    }
+    layer_t *first = &s_layers[0];
+    layer_t *last = &s_layers[s_layer_cnt - 1];
+    uint64_t input_bytes = (uint64_t)first->in_w * first->in_h * npu_c(first->in_c);
+    printf("input    %dx%dx%d (%dx%dx%d in memory)\n", first->in_w, first->in_h, first->in_c, first->in_w,
+           first->in_h, npu_c(first->in_c));
+    printf("output   %dx%dx%d (%dx%dx%d in memory)\n\n", last->out_w, last->out_h, last->out_c, last->out_w,
+           last->out_h, npu_c(last->out_c));
+
+    printf("%5s %-10s %-10s %-16s %-16s %10s %10s %12s  %s\n", "layer", "type", "k/s", "input", "output", "act(B)",
+           "weight(B)", "MACs", "note");
+    uint64_t total_w = 0, total_macs = 0;
+    int bad = 0, cpu = 0;
+    for (int i = 0; i < s_layer_cnt; i++) {
+        layer_t *l = &s_layers[i];
+        classify(l);
+        char ks[16], in[24], out[24];
+        snprintf(ks, sizeof(ks), "%dx%d/%d", l->kw, l->kh, l->stride);
+        snprintf(in, sizeof(in), "%dx%dx%d", l->in_w, l->in_h, l->in_c);
+        snprintf(out, sizeof(out), "%dx%dx%d", l->out_w, l->out_h, l->out_c);
+        printf("%5d %-10s %-10s %-16s %-16s %10llu %10llu %12llu  %s%s\n", l->idx, l->type, ks, in, out,
+               (unsigned long long)l->act_bytes, (unsigned long long)l->weight_bytes, (unsigned long long)l->macs,
+               OP_BAD == l->where ? "UNSUPPORTED: " : "", l->note);
+        total_w += l->weight_bytes;
+        total_macs += l->macs;
+        bad += OP_BAD == l->where;
+        cpu += OP_CPU == l->where;
+    }
+
+    int peak_at;
+    uint64_t peak = plan_activations(input_bytes, &peak_at);
+    printf("\nlayers      %d (%d on CPU, %d unsupported)\n", s_layer_cnt, cpu, bad);
+    printf("weights     %llu bytes estimated (int8 + int32 bias)\n", (unsigned long long)total_w);
+    if (model_path) {
+        long size = file_size(model_path);
+        if (size >= 0) printf("model file  %ld bytes\n", size);
+    }
+    printf("MACs        %llu (%.2f M)\n", (unsigned long long)total_macs, total_macs / 1e6);
+    printf("activations peak %llu bytes live at layer %d\n", (unsigned long long)peak, peak_at);
+    if (cfg.patch_size && cfg.patch_num) {
+        uint64_t arena = (uint64_t)cfg.patch_size * cfg.patch_num;
+        printf("arena       %u x %u = %llu bytes, %s\n", cfg.patch_num, cfg.patch_size, (unsigned long long)arena,
+               peak <= arena ? "fits" : "TOO SMALL");
+        if (peak > arena) bad++;
+    }
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+/*
+ * model_load_host - model_loader.c on Linux, XIP path against chunked reads.
+ *
+ * model_loader.c is built as it is against the stand-ins in sdk/: the
+ * romfs ioctl hands out an mmap of the file, read-only and never copied,
+ * as the flash XIP window would; without it the loader reads the file in
+ * MODEL_LOADER_CHUNK_SIZE pieces into a heap buffer. malloc goes to a
+ * counting heap, which is what xPortGetFreeHeapSize() reports on the board.
+ *
+ * The stand-in of blai_load_model_from_buffer() allocates the activation
+ * arena (-a, patch_size * patch_num of BLAI.cfg), copies -c bytes of the
+ * file for itself and reads the rest in place, as libblai does with the
+ * weights. The file is a .blai model or, without one, -s bytes of random
+ * data. Both paths then run -n times and report:
+ *
+ *   peak       the counting heap's high water mark during the load, and
+ *              what the loader measured itself
+ *   resident   heap still held once loaded
+ *   time       the loader's load_us, best and average
+ *
+ * and check the model saw the file's bytes on both, that the XIP path
+ * never holds the file in the heap, that the chunked one holds it exactly
+ * once, and that blai_free() gives everything back. Times are the host's
+ * page cache, not the board's flash; what carries over is the heap.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -Isdk -o model_load_host model_load_host.c ../model_loader.c
+ *   ./model_load_host -s 4194304
+ *   ./model_load_host tj.blai
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* the stand-ins of sdk/ */
+#include <FreeRTOS.h>
+#include <bl808_glb.h>
+#include <fs/vfs_romfs.h>
+#include <vfs.h>
+
+#include "model_loader.h"
+
+/* the real ones from here on, the counting heap is built on them */
+#undef malloc
+#undef free
+
+#define HEAP_SIZE (64u * 1024 * 1024)
+
+static uint32_t arena = 65536 * 45, copied, size = 1024 * 1024, runs = 20;
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+static int s_xip;
+static size_t s_heap_used, s_heap_peak;
+static uint32_t s_file_sum, s_file_size;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static uint32_t sum(const uint8_t *p, uint32_t len)
+{
+    uint32_t s = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        s = s * 31 + p[i];
+    }
+    return s;
+}
+
+/* the counting heap, a size word in front of every block */
+void *host_malloc(size_t n)
+{
+    if (s_heap_used + n > HEAP_SIZE) {
+        return NULL;
+    }
+    size_t *p = malloc(sizeof(size_t) + n);
+    if (NULL == p) {
+        return NULL;
+    }
+    *p = n;
+    s_heap_used += n;
+    if (s_heap_used > s_heap_peak) s_heap_peak = s_heap_used;
+    return p + 1;
+}
+
+void host_free(void *ptr)
+{
+    if (NULL == ptr) {
+        return;
+    }
+    size_t *p = (size_t *)ptr - 1;
+    s_heap_used -= *p;
+    free(p);
+}
+
+size_t xPortGetFreeHeapSize(void)
+{
+    return HEAP_SIZE - s_heap_used;
+}
+
+uint64_t CPU_Get_MTimer_US(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int aos_open(const char *path, int flags)
+{
+    (void)flags;
+    return open(path, O_RDONLY);
+}
+
+int aos_close(int fd)
+{
+    return close(fd);
+}
+
+int aos_read(int fd, void *buf, size_t nbytes)
+{
+    return (int)read(fd, buf, nbytes);
+}
+
+long aos_lseek(int fd, long offset, int whence)
+{
+    return (long)lseek(fd, offset, whence);
+}
+
+/* romfs files never move and are never unmapped, neither is this */
+int aos_ioctl(int fd, int cmd, unsigned long arg)
+{
+    if (!s_xip || IOCTL_ROMFS_GET_FILEBUF != cmd) {
+        return -1;
+    }
+    struct stat st;
+    if (0 != fstat(fd, &st)) {
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == map) {
+        return -1;
+    }
+    romfs_filebuf_t *filebuf = (romfs_filebuf_t *)arg;
+    filebuf->buf = map;
+    filebuf->bufsize = st.st_size;
+    return 0;
+}
+
+typedef struct {
+    BLAI_Model_t model;
+    uint8_t *copy;
+    uint32_t weights_sum;
+} host_model_t;
+
+BLAI_Model_t *blai_create(void)
+{
+    host_model_t *m = host_malloc(sizeof(*m));
+    if (NULL == m) {
+        return NULL;
+    }
+    memset(m, 0, sizeof(*m));
+    return &m->model;
+}
+
+int blai_load_model_from_buffer(BLAI_Model_t *model, uint8_t *bin)
+{
+    host_model_t *m = (host_model_t *)model;
+
+    if (NULL == (m->model.buffer = host_malloc(arena))) {
+        return -1;
+    }
+    memset(m->model.buffer, 0, arena);
+    if (copied) {
+        if (NULL == (m->copy = host_malloc(copied))) {
+            return -1;
+        }
+        memcpy(m->copy, bin, copied);
+    }
+    m->weights_sum = sum(bin, s_file_size);
+    return BLAI_STATUS_NO_ERROR;
+}
+
+void blai_free(BLAI_Model_t *model)
+{
+    host_model_t *m = (host_model_t *)model;
+    if (NULL == m) {
+        return;
+    }
+    host_free(m->copy);
+    host_free(m->model.buffer);
+    host_free(m);
+}
+
+typedef struct {
+    size_t peak;
+    uint32_t loader_peak;
+    uint32_t resident;
+    uint32_t best_us;
+    uint64_t total_us;
+} path_result_t;
+
+static void run_path(const char *file, int xip, path_result_t *r)
+{
+    const char *name = xip ? "xip" : "chunked";
+
+    memset(r, 0, sizeof(*r));
+    r->best_us = UINT32_MAX;
+    s_xip = xip;
+    for (uint32_t i = 0; i < runs; i++) {
+        model_load_info_t info;
+
+        s_heap_peak = s_heap_used;
+        BLAI_Model_t *model = model_loader_load(file, &info);
+        CHECK(NULL != model, "%s: load %u failed", name, i);
+        if (NULL == model) {
+            return;
+        }
+        CHECK((xip ? MODEL_SRC_XIP : MODEL_SRC_CHUNKED) == info.src && s_file_size == info.file_size,
+              "%s: loaded as src %d, %u bytes", name, info.src, info.file_size);
+        CHECK(s_file_sum == ((host_model_t *)model)->weights_sum, "%s: the model saw other bytes than the file", name);
+
+        if (s_heap_peak > r->peak) r->peak = s_heap_peak;
+        if (info.peak_heap > r->loader_peak) r->loader_peak = info.peak_heap;
+        r->resident = info.resident;
+        r->total_us += info.load_us;
+        if (info.load_us < r->best_us) r->best_us = info.load_us;
+
+        blai_free(model);
+        CHECK(0 == s_heap_used, "%s: %zu bytes still held after blai_free", name, s_heap_used);
+    }
+
+    printf("%-8s peak %8zu (loader saw %8u), resident %8u, load %7.3f ms best, %7.3f ms average\n", name, r->peak,
+           r->loader_peak, r->resident, r->best_us / 1000.0, r->total_us / 1000.0 / runs);
+}
+
+static int make_file(char *path)
+{
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    uint8_t *buf = malloc(size);
+    for (uint32_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)xorshift(&seed);
+    }
+    int ret = size == write(fd, buf, size) ? 0 : -1;
+    free(buf);
+    close(fd);
+    return ret;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-a arena] [-c copied] [-s size] [-n runs] [model.blai]\n", prog);
+    printf("\t-a bytes of activation arena blai allocates, default %u\n", arena);
+    printf("\t-c bytes of the file blai copies for itself, default %u\n", copied);
+    printf("\t-s bytes of the random file used without a model, default %u\n", size);
+}
+
+int main(int argc, char **argv)
+{
+    char tmp[] = "/tmp/model_load_host.XXXXXX";
+    const char *file = tmp;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:c:s:n:h")) != -1) {
+        switch (opt) {
+            case 'a':
+                arena = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                copied = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                size = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                runs = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind < argc) {
+        file = argv[optind];
+    } else if (0 == size || 0 != make_file(tmp)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int fd = open(file, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || 0 != fstat(fd, &st) || 0 == st.st_size || 0 == runs) {
+        printf("can't read %s\n", file);
+        return 2;
+    }
+    s_file_size = st.st_size;
+    if (copied > s_file_size) copied = s_file_size;
+    uint8_t *map = mmap(NULL, s_file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    s_file_sum = sum(map, s_file_size);
+    munmap(map, s_file_size);
+    close(fd);
+
+    printf("%s: %u bytes, arena %u, %u copied by blai, %u runs\n", file, s_file_size, arena, copied, runs);
+    path_result_t xip, chunked;
+    run_path(file, 1, &xip);
+    run_path(file, 0, &chunked);
+
+    /* the model itself, its arena and copies, is the same on both; only the chunked path adds the file */
+    uint32_t model = sizeof(host_model_t) + arena + copied;
+    CHECK(xip.peak == model, "xip: peak %zu, the model alone is %u", xip.peak, model);
+    CHECK(chunked.peak == model + s_file_size, "chunked: peak %zu, model %u and file %u", chunked.peak, model,
+          s_file_size);
+    CHECK(xip.resident == model && chunked.resident == model, "resident xip %u, chunked %u, model %u", xip.resident,
+          chunked.resident, model);
+    CHECK(xip.loader_peak == xip.peak && chunked.loader_peak <= chunked.peak && chunked.loader_peak >= s_file_size,
+          "loader peaks xip %u chunked %u against %zu and %zu", xip.loader_peak, chunked.loader_peak, xip.peak,
+          chunked.peak);
+    printf("xip saves %zu bytes of peak heap (%.0f%%)\n", chunked.peak - xip.peak,
+           100.0 * (chunked.peak - xip.peak) / chunked.peak);
+
+    if (file == tmp) {
+        unlink(tmp);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * postproc_check - randomised tests of blai_postproc.c against brute force models.
+ *
+ *   hyst       random confidence streams, drifting between classes, with
+ *              the top-1 or a random class proposed: the active class
+ *              always has at least off, only a proposed class at on or
+ *              above takes over, an active class below off is dropped
+ *              whatever is proposed, and nothing else changes it. Plus the
+ *              fading case, a class losing the lead while nobody reaches on
+ *   topk       both flavours against a stable sort, ties to the lower index
+ *   vote       against counting the window, newest wins ties
+ *   ema        against the blend written out
+ *   softmax    against the reference, sums to 1
+ *
+ * blai_postproc.c is shared as is with tom_and_jerry_classification_demo,
+ * build against either copy.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -o postproc_check postproc_check.c ../blai_postproc.c -lm
+ *   ./postproc_check -n 100000
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "blai_postproc.h"
+
+#define MAX_N (32)
+
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static float frand(void)
+{
+    return (xorshift(&seed) & 0xffffff) / (float)0x1000000;
+}
+
+static uint32_t top1(const float *conf, uint32_t n)
+{
+    uint32_t best = 0;
+    for (uint32_t i = 1; i < n; i++) {
+        if (conf[i] > conf[best]) best = i;
+    }
+    return best;
+}
+
+static void check_hyst(uint32_t frames)
+{
+    float conf[MAX_N], logits[MAX_N];
+    pp_hyst_t hyst;
+    uint32_t n = 2, favourite = 0, changes = 0, drops = 0;
+
+    for (uint32_t f = 0; f < frames; f++) {
+        if (0 == f % 500) {
+            /* a new stream: class count, thresholds */
+            n = 2 + xorshift(&seed) % (MAX_N - 1);
+            float on = 0.3f + 0.6f * frand();
+            pp_hyst_init(&hyst, on, on * frand());
+            CHECK(-1 == hyst.active, "hyst: active %d after init", hyst.active);
+            memset(logits, 0, sizeof(logits));
+        }
+        if (0 == xorshift(&seed) % 40) {
+            favourite = xorshift(&seed) % n;
+        }
+        /* logits random walk pulled towards the favourite, so classes rise and fade */
+        for (uint32_t i = 0; i < n; i++) {
+            logits[i] += 0.6f * (frand() - 0.5f) + (i == favourite ? 0.15f : -0.05f);
+            if (logits[i] > 6.0f) logits[i] = 6.0f;
+            if (logits[i] < -6.0f) logits[i] = -6.0f;
+            conf[i] = logits[i];
+        }
+        pp_softmax(conf, n);
+
+        uint32_t cls = xorshift(&seed) % 4 ? top1(conf, n) : xorshift(&seed) % n;
+        int prev = hyst.active;
+        int r = pp_hyst_update(&hyst, cls, conf, n);
+
+        CHECK(r == hyst.active, "hyst: returned %d, active %d", r, hyst.active);
+        CHECK(r >= -1 && r < (int)n, "hyst: active %d of %u classes", r, n);
+        if (r >= 0) {
+            CHECK(conf[r] >= hyst.off, "hyst: frame %u, class %d active at %.3f, off %.3f", f, r, conf[r], hyst.off);
+        }
+        if (r != prev && r >= 0) {
+            CHECK((uint32_t)r == cls && conf[cls] >= hyst.on, "hyst: frame %u, %d took over from %d, proposed %u at %.3f",
+                  f, r, prev, cls, conf[cls]);
+        }
+        if (prev >= 0 && conf[prev] < hyst.off) {
+            CHECK(r != prev, "hyst: frame %u, %d kept at %.3f below off %.3f (proposed %u)", f, prev, conf[prev],
+                  hyst.off, cls);
+        }
+        if (conf[cls] >= hyst.on) {
+            CHECK(r == (int)cls, "hyst: frame %u, proposed %u at %.3f >= on, active %d", f, cls, conf[cls], r);
+        }
+        if (prev >= 0 && conf[prev] >= hyst.off && conf[cls] < hyst.on) {
+            CHECK(r == prev, "hyst: frame %u, %d at %.3f dropped, proposed %u at %.3f", f, prev, conf[prev], cls,
+                  conf[cls]);
+        }
+        if (prev < 0 && conf[cls] < hyst.on) {
+            CHECK(-1 == r, "hyst: frame %u, %d active from nothing, proposed %u at %.3f", f, r, cls, conf[cls]);
+        }
+        changes += r != prev;
+        drops += prev >= 0 && r < 0;
+    }
+    CHECK(changes > frames / 200 && drops > frames / 1000, "hyst: the streams only made %u changes, %u drops",
+          changes, drops);
+
+    /* class 0 active, then fades while class 1 leads but stays below on: 0 must drop */
+    float fade[3][3] = {{0.8f, 0.1f, 0.1f}, {0.35f, 0.45f, 0.2f}, {0.25f, 0.5f, 0.25f}};
+    pp_hyst_init(&hyst, 0.6f, 0.3f);
+    CHECK(0 == pp_hyst_update(&hyst, 0, fade[0], 3), "hyst: fade, 0 not taken at 0.8");
+    CHECK(0 == pp_hyst_update(&hyst, 1, fade[1], 3), "hyst: fade, 0 dropped at 0.35");
+    CHECK(-1 == pp_hyst_update(&hyst, 1, fade[2], 3), "hyst: fade, 0 kept at 0.25 while 1 leads at 0.5");
+    /* a class index past n never becomes active and drops one that is */
+    pp_hyst_init(&hyst, 0.6f, 0.3f);
+    pp_hyst_update(&hyst, 2, fade[0] /* 2 at 0.1 */, 3);
+    CHECK(-1 == pp_hyst_update(&hyst, 5, fade[0], 3), "hyst: out of range class taken");
+    hyst.active = 2;
+    CHECK(-1 == pp_hyst_update(&hyst, 0, fade[0], 2) || 0 == hyst.active, "hyst: active past n kept");
+
+    printf("hyst: %u frames, %u changes, %u drops\n", frames, changes, drops);
+}
+
+static void check_topk(uint32_t rounds)
+{
+    float x[MAX_N];
+    uint8_t q[MAX_N];
+    pp_class_t out[PP_TOPK_MAX + 1], want[MAX_N];
+
+    for (uint32_t r = 0; r < rounds; r++) {
+        uint32_t n = 1 + xorshift(&seed) % MAX_N;
+        uint32_t k = xorshift(&seed) % (PP_TOPK_MAX + 3);
+        float scale = 0.01f + frand();
+        int zp = (int)(xorshift(&seed) % 256);
+        for (uint32_t i = 0; i < n; i++) {
+            /* few distinct values so ties are common */
+            q[i] = (uint8_t)(xorshift(&seed) % (r % 2 ? 8 : 256));
+            x[i] = q[i];
+        }
+
+        /* stable insertion sort, descending, lower index first on ties */
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t j = i;
+            while (j > 0 && x[i] > want[j - 1].score) {
+                want[j] = want[j - 1];
+                j--;
+            }
+            want[j].idx = i;
+            want[j].score = x[i];
+        }
+        uint32_t kk = k > PP_TOPK_MAX ? PP_TOPK_MAX : k;
+        uint32_t expect = kk < n ? kk : n;
+
+        uint32_t cnt = pp_topk(x, n, k, out);
+        uint32_t bad = cnt != expect;
+        for (uint32_t i = 0; i < cnt && i < expect; i++) {
+            bad += out[i].idx != want[i].idx || out[i].score != want[i].score;
+        }
+        CHECK(0 == bad, "topk: n %u k %u, %u of %u wrong", n, k, bad, cnt);
+
+        cnt = pp_topk_u8(q, n, k, scale, zp, out);
+        bad = cnt != expect;
+        for (uint32_t i = 0; i < cnt && i < expect; i++) {
+            bad += out[i].idx != want[i].idx || fabsf(out[i].score - (want[i].score - zp) * scale) > 1e-4f;
+        }
+        CHECK(0 == bad, "topk_u8: n %u k %u, %u of %u wrong", n, k, bad, cnt);
+    }
+}
+
+static void check_vote(uint32_t rounds)
+{
+    pp_vote_t vote;
+    uint16_t hist[4096];
+    uint32_t len = 1, pushed = 0;
+
+    for (uint32_t r = 0; r < rounds; r++) {
+        if (0 == r % 300) {
+            len = xorshift(&seed) % (PP_VOTE_MAX + 3);
+            pp_vote_init(&vote, len);
+            len = len > PP_VOTE_MAX ? PP_VOTE_MAX : (len ? len : 1);
+            pushed = 0;
+        }
+        uint32_t cls = xorshift(&seed) % (1 + r % 5);
+        hist[pushed++ % 4096] = (uint16_t)cls;
+        uint32_t got = pp_vote_update(&vote, cls);
+
+        /* most frequent in the window; newest first, so the newest of the tied classes */
+        uint32_t window = pushed < len ? pushed : len, best = cls, best_cnt = 0;
+        for (uint32_t i = 0; i < window; i++) {
+            uint32_t c = hist[(pushed - 1 - i) % 4096], cnt = 0;
+            for (uint32_t j = 0; j < window; j++) {
+                cnt += hist[(pushed - 1 - j) % 4096] == c;
+            }
+            if (cnt > best_cnt) {
+                best = c;
+                best_cnt = cnt;
+            }
+        }
+        CHECK(got == best, "vote: len %u, frame %u, got %u want %u", len, pushed, got, best);
+    }
+}
+
+static void check_ema_softmax(uint32_t rounds)
+{
+    float state[MAX_N], model[MAX_N], x[MAX_N], ref[MAX_N];
+    pp_ema_t ema;
+
+    for (uint32_t r = 0; r < rounds; r++) {
+        uint32_t n = 1 + xorshift(&seed) % MAX_N;
+        float alpha = frand();
+        pp_ema_init(&ema, state, n, alpha);
+        for (uint32_t f = 0; f < 8; f++) {
+            for (uint32_t i = 0; i < n; i++) {
+                x[i] = 20.0f * (frand() - 0.5f);
+                model[i] = 0 == f ? x[i] : model[i] + alpha * (x[i] - model[i]);
+            }
+            const float *s = pp_ema_update(&ema, x);
+            uint32_t bad = s != state;
+            for (uint32_t i = 0; i < n; i++) {
+                bad += fabsf(s[i] - model[i]) > 1e-4f;
+            }
+            CHECK(0 == bad, "ema: n %u alpha %.3f frame %u, %u wrong", n, alpha, f, bad);
+        }
+
+        memcpy(ref, x, sizeof(x));
+        pp_softmax(x, n);
+        pp_softmax_ref(ref, n);
+        float sum = 0.0f;
+        uint32_t bad = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            sum += x[i];
+            bad += fabsf(x[i] - ref[i]) > 1e-6f || x[i] < 0.0f;
+        }
+        CHECK(0 == bad && fabsf(sum - 1.0f) < 1e-4f, "softmax: n %u, %u off the reference, sums to %f", n, bad, sum);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rounds = 20000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                printf("Usage: %s [-n rounds] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        printf("seed must be > 0\n");
+        return 2;
+    }
+
+    check_hyst(rounds * 5);
+    check_topk(rounds);
+    check_vote(rounds);
+    check_ema_softmax(rounds / 10);
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
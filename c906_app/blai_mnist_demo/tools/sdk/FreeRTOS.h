@@ -0,0 +1,17 @@
+/*
+ * host stand-in for FreeRTOS.h: on the board malloc is the FreeRTOS heap,
+ * here it goes to the check's counting heap so xPortGetFreeHeapSize() sees it
+ */
+#ifndef __FREERTOS_H__
+#define __FREERTOS_H__
+
+#include <stddef.h>
+
+size_t xPortGetFreeHeapSize(void);
+void *host_malloc(size_t size);
+void host_free(void *p);
+
+#define malloc(size) host_malloc(size)
+#define free(p) host_free(p)
+
+#endif /* __FREERTOS_H__ */
@@ -0,0 +1,24 @@
+/* host stand-in for what blai_input.c and model_loader.c use of libblai's blai_core.h */
+#ifndef __BLAI_CORE_H__
+#define __BLAI_CORE_H__
+
+#include <stdint.h>
+
+#define BLAI_STATUS_NO_ERROR (0)
+
+struct blai_net_info_t {
+    uint32_t w;
+    uint32_t h;
+    uint32_t c;
+};
+
+typedef struct {
+    struct blai_net_info_t *net;
+    uint8_t *buffer;
+} BLAI_Model_t;
+
+BLAI_Model_t *blai_create(void);
+int blai_load_model_from_buffer(BLAI_Model_t *model, uint8_t *bin);
+void blai_free(BLAI_Model_t *model);
+
+#endif /* __BLAI_CORE_H__ */
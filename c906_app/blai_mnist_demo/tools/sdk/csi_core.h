@@ -0,0 +1,7 @@
+/* host stand-in for csi_core.h, the check records what is cleaned */
+#ifndef __CSI_CORE_H__
+#define __CSI_CORE_H__
+
+void csi_dcache_clean_range(void *addr, int size);
+
+#endif /* __CSI_CORE_H__ */
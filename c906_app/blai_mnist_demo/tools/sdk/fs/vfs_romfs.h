@@ -0,0 +1,14 @@
+/* host stand-in for the romfs ioctl that hands out a file's XIP address */
+#ifndef __VFS_ROMFS_H__
+#define __VFS_ROMFS_H__
+
+#include <stdint.h>
+
+#define IOCTL_ROMFS_GET_FILEBUF (1)
+
+typedef struct {
+    char *buf;
+    uint32_t bufsize;
+} romfs_filebuf_t;
+
+#endif /* __VFS_ROMFS_H__ */
@@ -0,0 +1,10 @@
+/* host stand-in for the m1s sdk's imgtool/bilinear_interpolation.h, implemented by the check */
+#ifndef __BILINEAR_INTERPOLATION_H__
+#define __BILINEAR_INTERPOLATION_H__
+
+#include <stdint.h>
+
+void BilinearInterpolation_RGBA8888(void *src, uint32_t src_w, uint32_t src_h, void *dst, uint32_t dst_w,
+                                    uint32_t dst_h);
+
+#endif /* __BILINEAR_INTERPOLATION_H__ */
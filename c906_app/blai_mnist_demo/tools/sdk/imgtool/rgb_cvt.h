@@ -0,0 +1,9 @@
+/* host stand-in for the m1s sdk's imgtool/rgb_cvt.h, implemented by the check */
+#ifndef __RGB_CVT_H__
+#define __RGB_CVT_H__
+
+#include <stdint.h>
+
+void RGBA88882GRAY(void *src, void *dst, uint32_t w, uint32_t h);
+
+#endif /* __RGB_CVT_H__ */
@@ -0,0 +1,4 @@
+/* host stand-in for FreeRTOS task.h */
+#ifndef __TASK_H__
+#define __TASK_H__
+#endif /* __TASK_H__ */
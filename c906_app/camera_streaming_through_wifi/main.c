@@ -1,5 +1,6 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 /* FreeRTOS */
 #include <FreeRTOS.h>
@@ -11,12 +12,150 @@
 
 #include <m1s_c906_xram_wifi.h>
 
+#include "frame_ring.h"
+
+/*
+ * By default the SDK's m1s_xram_wifi_upload_stream() sends the frames, it
+ * copies every one through the XRAM ring to the E907 and speaks main.py's
+ * default protocol.
+ *
+ * With CAMERA_STREAM_FRING this is the producer side of the shared frame
+ * ring instead: MJPEG frames are copied once out of the encoder's buffer
+ * into line aligned buffers of our own and pushed, the E907 sends them
+ * straight out of those (`fring stream <ip> <port>` on its console,
+ * `main.py --window` on the PC) and hands them back once TCP has taken
+ * them. When the network is behind and every buffer is queued, frames are
+ * dropped here. The ring lives in the window frame_ring.h describes, which
+ * the SDK's linker script has to keep out of the heap; without that it
+ * refuses to start.
+ */
+
+/* define to stream through the shared frame ring and the E907's `fring stream` */
+// #define CAMERA_STREAM_FRING
+
+#define WIFI_SSID "liuxo_desktop"
+#define WIFI_PASSWORD "12345678"
+
+static void camera_init(void)
+{
+    for (int retry = 0; retry < 100; retry++) {
+        if (0 == bl_cam_mipi_mjpeg_init()) {
+            return;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    printf("[cam] camera init failed\r\n");
+}
+
+#ifdef CAMERA_STREAM_FRING
+#define FRAME_BUFS (3)
+#define FRAME_BUF_SIZE (512 * 1024) /* MAX_FRAME of main.py */
+
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+
+static fring_t s_ring;
+static uint8_t *s_buf[FRAME_BUFS];
+static volatile uint8_t s_busy[FRAME_BUFS];
+
+static uint32_t s_sent, s_dropped, s_oversize;
+
+static void buf_done(void *arg, const fring_desc_t *d)
+{
+    s_busy[d->cookie] = 0;
+}
+
+static int buf_get(void)
+{
+    fring_reclaim(&s_ring, buf_done, NULL);
+    for (int i = 0; i < FRAME_BUFS; i++) {
+        if (!s_busy[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int buf_alloc(void)
+{
+    for (int i = 0; i < FRAME_BUFS; i++) {
+        uint8_t *p = pvPortMalloc(FRAME_BUF_SIZE + FRAME_RING_LINE);
+        if (NULL == p) {
+            return -1;
+        }
+        /* never freed, so the unaligned start doesn't need keeping */
+        s_buf[i] = (uint8_t *)ALIGNUP((uintptr_t)p, FRAME_RING_LINE);
+    }
+    return 0;
+}
+
+static void stream_ring(void)
+{
+    uint64_t report_us = 0;
+
+    if (0 != fring_init_producer(&s_ring, (void *)FRAME_RING_SHM_BASE)) {
+        printf("[cam] heap reaches into the shared window at %08lx, see frame_ring.h\r\n",
+               (unsigned long)FRAME_RING_SHM_RESERVED_BASE);
+        return;
+    }
+    if (0 != buf_alloc()) {
+        printf("[cam] no memory for frame buffers\r\n");
+        return;
+    }
+    printf("[cam] frame ring at %08lx, run `fring stream <ip> <port>` on the e907\r\n",
+           (unsigned long)FRAME_RING_SHM_BASE);
+
+    for (;;) {
+        uint8_t *pic = NULL;
+        uint32_t len = 0;
+
+        if (0 != bl_cam_mjpeg_get(&pic, &len)) {
+            fring_reclaim(&s_ring, buf_done, NULL);
+            vTaskDelay(1);
+            continue;
+        }
+        int i = buf_get();
+        if (i < 0 || len > FRAME_BUF_SIZE) {
+            /* the network is behind and all buffers are queued, or the frame is more than main.py takes */
+            bl_cam_mjpeg_pop();
+            if (i < 0) {
+                s_dropped++;
+            } else {
+                s_oversize++;
+            }
+            vTaskDelay(1);
+            continue;
+        }
+        memcpy(s_buf[i], pic, len);
+        bl_cam_mjpeg_pop();
+
+        uint64_t now = CPU_Get_MTimer_US();
+        s_busy[i] = 1;
+        if (0 != fring_push(&s_ring, (uint32_t)(uintptr_t)s_buf[i], len, now / 1000, i)) {
+            s_busy[i] = 0;
+            s_dropped++;
+            continue;
+        }
+        s_sent++;
+
+        if (now - report_us >= 5000000) {
+            printf("[cam] sent %lu, dropped %lu, oversize %lu\r\n", (unsigned long)s_sent, (unsigned long)s_dropped,
+                   (unsigned long)s_oversize);
+            report_us = now;
+        }
+    }
+}
+#endif
+
 void main()
 {
     vTaskDelay(1);
-    bl_cam_mipi_mjpeg_init();
+    camera_init();
 
     m1s_xram_wifi_init();
-    m1s_xram_wifi_connect("liuxo_desktop", "12345678");
+    m1s_xram_wifi_connect(WIFI_SSID, WIFI_PASSWORD);
+#ifdef CAMERA_STREAM_FRING
+    stream_ring();
+#else
     m1s_xram_wifi_upload_stream("10.42.0.1", 8888);
-}
\ No newline at end of file
+#endif
+}
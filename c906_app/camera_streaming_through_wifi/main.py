@@ -1,56 +1,133 @@
+import argparse
 import socket
+import struct
+import time
+
 import numpy as np
 import cv2 as cv
 
+# 窗口化帧协议, 与 e907_app/firmware/frame_stream.h 保持一致
+FRAME_MAGIC = 0x4653314d      # "M1SF"
+ACK_MAGIC = 0x4b41314d        # "M1AK"
+FRAME_VERSION = 2
+HDR = struct.Struct('<IHHIIIQ')  # magic, version, flags, seq, frame, len, ts_us
+ACK = struct.Struct('<III')     # magic, next_seq, window
+MAX_FRAME = 512 * 1024
+
+
+def recv_exact(sock, view):
+    # 直接收进预分配的缓冲区, 不产生中间bytes对象
+    got = 0
+    while got < len(view):
+        n = sock.recv_into(view[got:])
+        if n == 0:
+            raise ConnectionError('peer closed')
+        got += n
+
+
+def show(jpeg, show_window):
+    if jpeg[:2] != b'\xff\xd8' or jpeg[-2:] != b'\xff\xd9':
+        return False
+    if show_window:
+        img = cv.imdecode(np.frombuffer(jpeg, 'uint8'), cv.IMREAD_COLOR)
+        cv.imshow('stream', img)
+        if cv.waitKey(1) == ord('q'):
+            exit(0)
+    return True
+
+
+def serve_legacy(tcp_client, show_window):
+    # 旧协议: 4字节长度, 回显长度作为应答, 再接收JPEG
+    buf = bytearray(MAX_FRAME)
+    view = memoryview(buf)
+    while True:
+        recv_data = tcp_client.recv(4)
+        mjpeg_len = int.from_bytes(recv_data, 'little')
+        print("recv len: ", mjpeg_len)
+        tcp_client.send(recv_data)
+        if mjpeg_len > MAX_FRAME:
+            raise ValueError('frame too large: %d' % mjpeg_len)
+        recv_exact(tcp_client, view[:mjpeg_len])
+        print("recv stream success")
+        show(view[:mjpeg_len].tobytes(), show_window)
+
+
+def serve_window(tcp_client, window, show_window):
+    # 新协议: 帧头 + JPEG, 接收端用累计应答发放窗口, 发送端最多 window 帧在途
+    hdr_buf = bytearray(HDR.size)
+    buf = bytearray(MAX_FRAME)
+    view = memoryview(buf)
+    next_seq = next_frame = 0
+    frames = dropped = corrupt = 0
+    goodput = 0
+    t_report = time.monotonic()
+
+    tcp_client.sendall(ACK.pack(ACK_MAGIC, next_seq, window))
+    while True:
+        recv_exact(tcp_client, memoryview(hdr_buf))
+        magic, version, flags, seq, frame, length, ts_us = HDR.unpack(hdr_buf)
+        if magic != FRAME_MAGIC or version != FRAME_VERSION:
+            raise ValueError('bad frame header %08x v%d' % (magic, version))
+        if length > MAX_FRAME:
+            raise ValueError('frame too large: %d' % length)
+        recv_exact(tcp_client, view[:length])
+
+        # seq 只给发出的帧编号, 应答按它累计, 不会跳变
+        if seq != next_seq:
+            raise ValueError('seq %d, expected %d' % (seq, next_seq))
+        # 发送端没有窗口或码率控制跳过的帧也占帧号, 帧号跳变即为丢帧数
+        dropped += (frame - next_frame) & 0xffffffff
+        next_seq = (seq + 1) & 0xffffffff
+        next_frame = (frame + 1) & 0xffffffff
+        frames += 1
+        goodput += length
+        if not show(view[:length].tobytes(), show_window):
+            corrupt += 1
+        tcp_client.sendall(ACK.pack(ACK_MAGIC, next_seq, window))
+
+        now = time.monotonic()
+        if now - t_report >= 1.0:
+            dt = now - t_report
+            print("%.1f fps, %.1f KB/s, seq %d, frame %d, drop %d, corrupt %d" %
+                  (frames / dt, goodput / dt / 1024, seq, frame, dropped, corrupt))
+            frames = goodput = 0
+            t_report = now
+
 
 if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--port', type=int, default=8888)
+    parser.add_argument('--window', type=int, default=0,
+                        help='use the windowed frame protocol with N frames in flight, 0 for the old protocol')
+    parser.add_argument('--no-show', action='store_true', help='do not decode and display frames')
+    args = parser.parse_args()
+
     # 创建tcp服务端套接字
-    # 参数同客户端配置一致，这里不再重复
     tcp_server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
 
     # 设置端口号复用，让程序退出端口号立即释放，否则的话在30秒-2分钟之内这个端口是不会被释放的，这是TCP的为了保证传输可靠性的机制。
     tcp_server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, True)
 
     # 给客户端绑定端口号，客户端需要知道服务器的端口号才能进行建立连接。IP地址不用设置，默认就为本机的IP地址。
-    tcp_server.bind(("", 8888))
+    tcp_server.bind(("", args.port))
 
     # 设置监听
-    # 128:最大等待建立连接的个数， 提示： 目前是单任务的服务端，同一时刻只能服务与一个客户端，后续使用多任务能够让服务端同时服务与多个客户端
-    # 不需要让客户端进行等待建立连接
-    # listen后的这个套接字只负责接收客户端连接请求，不能收发消息，收发消息使用返回的这个新套接字tcp_client来完成
     tcp_server.listen(128)
 
     # 等待客户端建立连接的请求, 只有客户端和服务端建立连接成功代码才会解阻塞，代码才能继续往下执行
-    # 1. 专门和客户端通信的套接字： tcp_client
-    # 2. 客户端的ip地址和端口号： tcp_client_address
     tcp_client, tcp_client_address = tcp_server.accept()
+    tcp_client.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, True)
 
     # 代码执行到此说明连接建立成功
     print("客户端的ip地址和端口号:", tcp_client_address)
 
-    while True:
-        # 接收客户端发送的数据, 这次接收数据的最大字节数是4
-        recv_data = tcp_client.recv(4)
-        mjpeg_len = int.from_bytes(recv_data, 'little')
-        print("recv len: ", mjpeg_len)
-        tcp_client.send(recv_data)
-        recv_data_mjpeg = b''
-        remained_bytes = mjpeg_len
-        while remained_bytes > 0:
-            recv_data_mjpeg += tcp_client.recv(remained_bytes)
-            remained_bytes = mjpeg_len - len(recv_data_mjpeg)
-        print("recv stream success")
-        if recv_data_mjpeg[:2] != b'\xff\xd8' \
-                or recv_data_mjpeg[-2:] != b'\xff\xd9':
-            continue
-        mjpeg_data = np.frombuffer(recv_data_mjpeg, 'uint8')
-        img = cv.imdecode(mjpeg_data, cv.IMREAD_COLOR)
-        cv.imshow('stream', img)
-        if cv.waitKey(1) == 'q':
-            exit(0)
-
-    # 关闭服务与客户端的套接字， 终止和客户端通信的服务
-    tcp_client.close()
-
-    # 关闭服务端的套接字, 终止和客户端提供建立连接请求的服务 但是正常来说服务器的套接字是不需要关闭的，因为服务器需要一直运行。
-    # tcp_server.close()
+    try:
+        if args.window > 0:
+            serve_window(tcp_client, args.window, not args.no_show)
+        else:
+            serve_legacy(tcp_client, not args.no_show)
+    except ConnectionError:
+        print("客户端断开连接")
+    finally:
+        # 关闭服务与客户端的套接字， 终止和客户端通信的服务
+        tcp_client.close()
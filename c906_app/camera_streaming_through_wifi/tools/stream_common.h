@@ -0,0 +1,144 @@
+#ifndef __STREAM_COMMON_H__
+#define __STREAM_COMMON_H__
+
+/*
+ * Shared by stream_source and stream_sink: the frames both sides agree on,
+ * so the sink can check every received frame without a checksum on the wire.
+ *
+ * Legacy protocol of m1s_xram_wifi_upload_stream and main.py, per frame:
+ *   source -> sink: uint32 length, little endian
+ *   sink -> source: the same 4 bytes back
+ *   source -> sink: length bytes of JPEG
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STREAM_MAX_FRAME (512 * 1024)
+#define STREAM_MAX_REF (4096)
+
+static inline uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline uint32_t crc32_update(uint32_t crc, const uint8_t *p, uint32_t len)
+{
+    static uint32_t table[256];
+    if (0 == table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+    }
+    crc = ~crc;
+    while (len--) {
+        crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static inline int jpeg_markers_ok(const uint8_t *p, uint32_t len)
+{
+    return len >= 4 && 0xff == p[0] && 0xd8 == p[1] && 0xff == p[len - 2] && 0xd9 == p[len - 1];
+}
+
+/*
+ * Frame n of the synthetic stream: SOI, a COM segment carrying n, pseudo
+ * random stuffed entropy data whose size varies like a real scene, EOI.
+ */
+static inline uint32_t synth_frame(uint32_t n, uint8_t *out, uint32_t size)
+{
+    uint32_t x = n * 2654435761u + 1;
+    uint32_t body = 8000 + (n * 7919) % 24000;
+    uint32_t len = 0;
+
+    if (size < body * 2 + 16) {
+        return 0;
+    }
+    out[len++] = 0xff;
+    out[len++] = 0xd8;
+    out[len++] = 0xff;
+    out[len++] = 0xfe;
+    out[len++] = 0;
+    out[len++] = 6;
+    out[len++] = n >> 24;
+    out[len++] = n >> 16;
+    out[len++] = n >> 8;
+    out[len++] = n;
+    for (uint32_t i = 0; i < body; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        out[len++] = x;
+        if (0xff == (uint8_t)x) {
+            out[len++] = 0;
+        }
+    }
+    out[len++] = 0xff;
+    out[len++] = 0xd9;
+    return len;
+}
+
+typedef struct {
+    uint8_t *data;
+    uint32_t count;
+    uint32_t off[STREAM_MAX_REF];
+    uint32_t len[STREAM_MAX_REF];
+} replay_t;
+
+/* load the SOI..EOI frames of a concatenated MJPEG file */
+static inline int replay_load(replay_t *r, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    memset(r, 0, sizeof(*r));
+    if (NULL == fp) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    if (size <= 0 || NULL == (r->data = malloc(size)) || size != (long)fread(r->data, 1, size, fp)) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    long start = -1;
+    for (long i = 1; i < size && r->count < STREAM_MAX_REF; i++) {
+        if (0xff != r->data[i - 1]) {
+            continue;
+        }
+        if (start < 0 && 0xd8 == r->data[i]) {
+            start = i - 1;
+        } else if (start >= 0 && 0xd9 == r->data[i]) {
+            r->off[r->count] = start;
+            r->len[r->count] = i + 1 - start;
+            r->count++;
+            start = -1;
+        }
+    }
+    return r->count ? 0 : -1;
+}
+
+/* frame n of the stream, from the replay file or synthetic */
+static inline uint32_t stream_frame(const replay_t *r, uint32_t n, uint8_t *buf, uint32_t size, const uint8_t **frame)
+{
+    if (r && r->count) {
+        uint32_t i = n % r->count;
+        *frame = r->data + r->off[i];
+        return r->len[i];
+    }
+    *frame = buf;
+    return synth_frame(n, buf, size);
+}
+
+#endif /* __STREAM_COMMON_H__ */
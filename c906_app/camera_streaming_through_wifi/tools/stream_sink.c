@@ -0,0 +1,178 @@
+/*
+ * stream_sink - stands in for main.py and the laptop at 10.42.0.1.
+ *
+ * Accepts one connection speaking the length/echo protocol of
+ * m1s_xram_wifi_upload_stream and checks every frame: SOI/EOI markers and
+ * the CRC32 of the frame stream_source sends at that position (synthetic, or
+ * replayed from the same file given with -f). Prints per second and final
+ * throughput and the spread of frame inter-arrival times.
+ *
+ * Build and run on Linux, as a regression test of the streaming path:
+ *   cc -O2 -o stream_sink stream_sink.c
+ *   cc -O2 -o stream_source stream_source.c
+ *   ./stream_sink -p 8888 -f capture.mjpeg & ./stream_source -p 8888 -f capture.mjpeg
+ *   wait $!
+ *
+ * Exit status is 1 if any frame was corrupt or the protocol broke, 0 if all
+ * frames arrived intact.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "stream_common.h"
+
+static int recv_all(int sock, uint8_t *p, uint32_t len)
+{
+    while (len > 0) {
+        ssize_t n = recv(sock, p, len, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-p port] [-f file.mjpeg] [-n frames] [-q]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    uint16_t port = 8888;
+    uint32_t frames = 0;
+    int quiet = 0, opt;
+
+    while ((opt = getopt(argc, argv, "p:f:n:qh")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                path = optarg;
+                break;
+            case 'n':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    static replay_t replay;
+    if (path && 0 != replay_load(&replay, path)) {
+        printf("no jpeg frames in %s\n", path);
+        return 2;
+    }
+
+    int srv = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+    setsockopt(srv, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (srv < 0 || 0 != bind(srv, (struct sockaddr *)&addr, sizeof(addr)) || 0 != listen(srv, 1)) {
+        perror("listen");
+        return 2;
+    }
+    int sock = accept(srv, NULL, NULL);
+    close(srv);
+    if (sock < 0) {
+        perror("accept");
+        return 2;
+    }
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    static uint8_t buf[STREAM_MAX_FRAME], ref_buf[STREAM_MAX_FRAME];
+    uint32_t cap = 1024, count = 0, bad_marker = 0, bad_crc = 0, protocol_error = 0;
+    uint32_t *gaps = malloc(cap * sizeof(uint32_t));
+    uint64_t bytes = 0, t_first = 0, t_last = 0, t_report = now_us(), report_bytes = 0;
+    uint32_t report_frames = 0;
+
+    while (0 == frames || count < frames) {
+        uint8_t hdr[4];
+        if (0 != recv_all(sock, hdr, 4)) {
+            break; /* source finished */
+        }
+        uint32_t len = hdr[0] | (hdr[1] << 8) | (hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
+        if (0 == len || len > STREAM_MAX_FRAME) {
+            printf("frame %u: bad length %u\n", count, len);
+            protocol_error = 1;
+            break;
+        }
+        if (4 != send(sock, hdr, 4, MSG_NOSIGNAL) || 0 != recv_all(sock, buf, len)) {
+            printf("frame %u: link lost mid frame\n", count);
+            protocol_error = 1;
+            break;
+        }
+
+        uint64_t t = now_us();
+        if (count) {
+            if (count - 1 == cap) {
+                cap *= 2;
+                gaps = realloc(gaps, cap * sizeof(uint32_t));
+            }
+            gaps[count - 1] = t - t_last;
+        } else {
+            t_first = t;
+        }
+        t_last = t;
+
+        const uint8_t *ref;
+        uint32_t ref_len = stream_frame(&replay, count, ref_buf, sizeof(ref_buf), &ref);
+        if (!jpeg_markers_ok(buf, len)) {
+            bad_marker++;
+            printf("frame %u: %u bytes, missing SOI/EOI\n", count, len);
+        } else if (ref_len != len || crc32_update(0, ref, ref_len) != crc32_update(0, buf, len)) {
+            bad_crc++;
+            printf("frame %u: %u bytes, crc %08x, expected %u bytes crc %08x\n", count, len, crc32_update(0, buf, len),
+                   ref_len, crc32_update(0, ref, ref_len));
+        }
+        count++;
+        bytes += len;
+
+        if (!quiet && t - t_report >= 1000000) {
+            printf("%.1f fps, %.1f KB/s\n", (count - report_frames) * 1e6 / (t - t_report),
+                   (bytes - report_bytes) * 1e6 / 1024 / (t - t_report));
+            report_frames = count;
+            report_bytes = bytes;
+            t_report = t;
+        }
+    }
+    close(sock);
+
+    double secs = count > 1 ? (t_last - t_first) / 1e6 : 0;
+    printf("frames    %u, %.1f KB", count, bytes / 1024.0);
+    if (secs > 0) {
+        printf(", %.1f fps, %.1f KB/s", (count - 1) / secs, bytes / 1024.0 / secs);
+    }
+    printf("\n");
+    if (count > 1) {
+        uint32_t n = count - 1;
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            sum += gaps[i];
+        }
+        qsort(gaps, n, sizeof(uint32_t), cmp_u32);
+        printf("interval  min %u us, avg %llu us, p50 %u us, p95 %u us, p99 %u us, max %u us\n", gaps[0],
+               (unsigned long long)(sum / n), gaps[n / 2], gaps[n * 95 / 100], gaps[n * 99 / 100], gaps[n - 1]);
+    }
+    printf("integrity %u bad markers, %u bad crc%s\n", bad_marker, bad_crc, protocol_error ? ", protocol error" : "");
+    free(gaps);
+
+    return (bad_marker || bad_crc || protocol_error || 0 == count) ? 1 : 0;
+}
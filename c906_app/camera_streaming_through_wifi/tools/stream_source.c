@@ -0,0 +1,163 @@
+/*
+ * stream_source - stands in for the board in the camera streaming demo.
+ *
+ * Connects to a sink (main.py or stream_sink) and sends MJPEG frames with the
+ * same length/echo protocol as m1s_xram_wifi_upload_stream. Frames come from
+ * a recorded MJPEG file, or are synthetic when no file is given, and repeat
+ * in order so the sink can check them against the same source.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -o stream_source stream_source.c
+ *   ./stream_source -H 127.0.0.1 -p 8888 -f capture.mjpeg -n 600 -r 30
+ *
+ * -x N corrupts one byte of every Nth frame to check that the sink notices.
+ * Exit status is 1 if the sink echoes a wrong length or the link fails.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "stream_common.h"
+
+static int send_all(int sock, const uint8_t *p, uint32_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(sock, p, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int recv_all(int sock, uint8_t *p, uint32_t len)
+{
+    while (len > 0) {
+        ssize_t n = recv(sock, p, len, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-H host] [-p port] [-f file.mjpeg] [-n frames] [-r fps] [-x N]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1", *path = NULL;
+    uint16_t port = 8888;
+    uint32_t frames = 300, fps = 30, corrupt_every = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:p:f:n:r:x:h")) != -1) {
+        switch (opt) {
+            case 'H':
+                host = optarg;
+                break;
+            case 'p':
+                port = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                path = optarg;
+                break;
+            case 'n':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                fps = strtoul(optarg, NULL, 0);
+                break;
+            case 'x':
+                corrupt_every = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    static replay_t replay;
+    if (path && 0 != replay_load(&replay, path)) {
+        printf("no jpeg frames in %s\n", path);
+        return 2;
+    }
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr = inet_addr(host);
+    if (sock < 0 || 0 != connect(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        perror("connect");
+        return 1;
+    }
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    static uint8_t buf[STREAM_MAX_FRAME], bad[STREAM_MAX_FRAME];
+    uint64_t period_us = fps ? 1000000 / fps : 0;
+    uint64_t t_start = now_us(), next_us = t_start, rtt_sum = 0, bytes = 0;
+    uint32_t rtt_min = UINT32_MAX, rtt_max = 0, sent = 0, corrupted = 0;
+    int ret = 0;
+
+    for (uint32_t n = 0; 0 == frames || n < frames; n++) {
+        const uint8_t *frame;
+        uint32_t len = stream_frame(&replay, n, buf, sizeof(buf), &frame);
+
+        if (corrupt_every && 0 == (n + 1) % corrupt_every) {
+            memcpy(bad, frame, len);
+            bad[len / 2] ^= 0x5a;
+            frame = bad;
+            corrupted++;
+        }
+
+        uint8_t hdr[4] = {len, len >> 8, len >> 16, len >> 24}, echo[4];
+        uint64_t t0 = now_us();
+        if (0 != send_all(sock, hdr, 4) || 0 != recv_all(sock, echo, 4)) {
+            printf("link lost at frame %u\n", n);
+            ret = 1;
+            break;
+        }
+        uint32_t rtt = now_us() - t0;
+        if (0 != memcmp(hdr, echo, 4)) {
+            printf("frame %u: echo %02x%02x%02x%02x for length %u\n", n, echo[3], echo[2], echo[1], echo[0], len);
+            ret = 1;
+            break;
+        }
+        if (0 != send_all(sock, frame, len)) {
+            printf("link lost at frame %u\n", n);
+            ret = 1;
+            break;
+        }
+        rtt_min = rtt < rtt_min ? rtt : rtt_min;
+        rtt_max = rtt > rtt_max ? rtt : rtt_max;
+        rtt_sum += rtt;
+        bytes += len;
+        sent++;
+
+        if (period_us) {
+            next_us += period_us;
+            uint64_t now = now_us();
+            if (next_us > now) {
+                usleep(next_us - now);
+            }
+        }
+    }
+    close(sock);
+
+    double secs = (now_us() - t_start) / 1e6;
+    printf("sent %u frames (%u corrupted on purpose), %.1f KB in %.2f s, %.1f fps\n", sent, corrupted, bytes / 1024.0,
+           secs, sent / secs);
+    if (sent) {
+        printf("length echo rtt min %u us, avg %llu us, max %u us\n", rtt_min, (unsigned long long)(rtt_sum / sent),
+               rtt_max);
+    }
+    return ret;
+}
@@ -12,7 +12,7 @@
 /* bl808 c906 std driver */
 #include <bl808_glb.h>
 
-#include "m1s_c906_xram_flash.h"
+#include "flash_io.h"
 
 void cmd_c906_flash(char *buf, int len, int argc, char **argv)
 {
@@ -61,13 +61,13 @@ void cmd_c906_flash(char *buf, int len, int argc, char **argv)
 
     switch (op) {
         case 'r':
-            ret = m1s_xram_flash_read(o, a, l);
+            ret = flash_io_read(flash_io_get(), o, (void *)(uintptr_t)a, l);
             break;
         case 'w':
-            ret = m1s_xram_flash_write(o, a, l);
+            ret = flash_io_write(flash_io_get(), o, (const void *)(uintptr_t)a, l);
             break;
         case 'e':
-            ret = m1s_xram_flash_erase(o, l);
+            ret = flash_io_erase(flash_io_get(), o, l);
             break;
         default:
             printf("no changed, select <r><w><e>\r\n");
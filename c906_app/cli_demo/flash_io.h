@@ -0,0 +1,95 @@
+#ifndef __FLASH_IO_H__
+#define __FLASH_IO_H__
+
+#include <stdint.h>
+
+/*
+ * One way to the SPI flash from the C906. The E907 owns the flash
+ * controller, erases and writes always go to it (m1s_xram_flash_*, the
+ * "RPC" path); reads of a range the flash controller maps into the XIP
+ * window are a memcpy instead, no round trip to the other core:
+ *
+ *   flash_io_read()   XIP where mapped and coherent, RPC for the rest
+ *   flash_io_erase()  RPC, whole FLASH_IO_SECTORs
+ *   flash_io_write()  RPC, then the XIP lines of the range are invalidated
+ *   flash_io_sync()   every write before it is visible on both paths
+ *
+ * The XIP window goes through the D-cache and knows nothing about the
+ * E907 changing the flash behind it, so after an erase or write its cached
+ * lines would still show the old contents until evicted; they are
+ * invalidated when the call returns. While an erase or write is in flight
+ * the chip is busy and doesn't answer XIP fetches, so reads take the RPC
+ * path, which the E907 queues behind the write. That only covers reads
+ * that start while one is under way: a task reading over XIP when another
+ * starts writing isn't stopped, tasks sharing a flash_io_t keep the two
+ * apart themselves.
+ *
+ * The platform below is flash_io_m1s.c on the board, the tools use a
+ * file-backed one. flash_io.{c,h} and flash_io_m1s.c are shared as is
+ * between c906_app/flash_demo, c906_app/cli_demo and c906_app/lfs_demo,
+ * keep all copies identical.
+ */
+
+#define FLASH_IO_SECTOR (4096)
+#define FLASH_IO_RPC_CHUNK (4096) /* most bytes per XRAM call */
+#define FLASH_IO_MAX_MAPS (2)
+
+/* the media partition (partition_cfg_16M_m1sdock.toml) and where it shows up in the XIP window */
+#define FLASH_IO_MEDIA_OFFSET (0x300000)
+#define FLASH_IO_MEDIA_SIZE (0xC00000)
+#define FLASH_IO_MEDIA_XIP (0x582f0000)
+
+typedef enum {
+    FLASH_IO_AUTO = 0,
+    FLASH_IO_XIP, /* fails for anything not mapped */
+    FLASH_IO_RPC,
+} flash_io_path_t;
+
+typedef struct {
+    uint32_t offset; /* in flash */
+    uint32_t size;
+    uintptr_t xip; /* where offset shows up */
+} flash_io_map_t;
+
+typedef struct {
+    flash_io_map_t map[FLASH_IO_MAX_MAPS];
+    uint32_t maps;
+    volatile uint32_t inflight; /* erases and writes not done yet */
+
+    uint32_t xip_reads;
+    uint32_t rpc_reads;
+    uint64_t xip_bytes;
+    uint64_t rpc_bytes;
+    uint32_t rpc_calls;
+    uint32_t erases;
+    uint32_t writes;
+    uint32_t invalidated; /* bytes of XIP window */
+    uint32_t errors;
+} flash_io_t;
+
+void flash_io_init(flash_io_t *f);
+
+/* Adds an XIP window of size bytes from flash offset. Returns 0, or -1 when all FLASH_IO_MAX_MAPS are used. */
+int flash_io_map(flash_io_t *f, uint32_t offset, uint32_t size, uintptr_t xip);
+
+/* The XIP address of the whole range, or NULL if it isn't mapped in one piece. */
+const void *flash_io_xip_addr(flash_io_t *f, uint32_t offset, uint32_t len);
+
+/* Returns 0 or -1. */
+int flash_io_read(flash_io_t *f, uint32_t offset, void *dst, uint32_t len);
+int flash_io_read_via(flash_io_t *f, flash_io_path_t path, uint32_t offset, void *dst, uint32_t len);
+int flash_io_erase(flash_io_t *f, uint32_t offset, uint32_t len);
+int flash_io_write(flash_io_t *f, uint32_t offset, const void *src, uint32_t len);
+int flash_io_sync(flash_io_t *f);
+
+/* Drops the XIP lines of a range the E907 changed some other way (xrpc batches), before reading it back. */
+void flash_io_invalidate(flash_io_t *f, uint32_t offset, uint32_t len);
+
+/* platform */
+flash_io_t *flash_io_get(void); /* the board's flash, media partition mapped */
+int flash_port_read(uint32_t offset, void *dst, uint32_t len);
+int flash_port_erase(uint32_t offset, uint32_t len);
+int flash_port_write(uint32_t offset, const void *src, uint32_t len);
+void flash_port_xip_invalidate(uintptr_t xip, uint32_t len);
+
+#endif /* __FLASH_IO_H__ */
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "flash_prog.h"
+
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+
+#define JOURNAL_HDR (16)
+
+uint32_t flash_prog_crc32(uint32_t crc, const void *buf, uint32_t len)
+{
+    /* reflected 0xedb88320, a nibble at a time: 64 bytes of table instead of 1 KB */
+    static const uint32_t t[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    const uint8_t *b = buf;
+
+    crc = ~crc;
+    while (len--) {
+        crc ^= *b++;
+        crc = (crc >> 4) ^ t[crc & 0xf];
+        crc = (crc >> 4) ^ t[crc & 0xf];
+    }
+    return ~crc;
+}
+
+static int journal_open(flash_prog_t *p)
+{
+    uint32_t hdr[4], want[4] = {FLASH_PROG_JOURNAL_MAGIC, p->offset, p->len, p->tag};
+    uint8_t bitmap[sizeof(p->done)];
+    uint32_t bytes = (p->regions + 7) / 8;
+
+    memset(p->done, 0, sizeof(p->done));
+    if (FLASH_PROG_NO_JOURNAL == p->journal) {
+        return 0;
+    }
+    if (0 != flash_io_read(p->io, p->journal, hdr, sizeof(hdr))) {
+        return -1;
+    }
+    if (0 == memcmp(hdr, want, sizeof(hdr))) {
+        if (0 != flash_io_read(p->io, p->journal + JOURNAL_HDR, bitmap, bytes)) {
+            return -1;
+        }
+        for (uint32_t k = 0; k < p->regions; k++) {
+            if (!(bitmap[k / 8] & (1 << (k % 8)))) {
+                p->done[k / 8] |= 1 << (k % 8);
+                p->resumed++;
+            }
+        }
+        return 0;
+    }
+    /* someone else's: the image fields first, the magic last, so a reset in between leaves no valid journal */
+    if (0 != flash_io_erase(p->io, p->journal, FLASH_IO_SECTOR) ||
+        0 != flash_io_write(p->io, p->journal + 4, &want[1], sizeof(want) - 4) ||
+        0 != flash_io_write(p->io, p->journal, &want[0], 4)) {
+        return -1;
+    }
+    return 0;
+}
+
+static int journal_mark(flash_prog_t *p, uint32_t k)
+{
+    uint8_t bit = ~(1 << (k % 8)); /* writing the other bits as 1 leaves them alone */
+
+    p->done[k / 8] |= 1 << (k % 8);
+    if (FLASH_PROG_NO_JOURNAL == p->journal) {
+        return 0;
+    }
+    return flash_io_write(p->io, p->journal + JOURNAL_HDR + k / 8, &bit, 1);
+}
+
+int flash_prog_begin(flash_prog_t *p, flash_io_t *io, const flash_prog_port_t *port, uint32_t offset, uint32_t len,
+                     uint32_t tag, uint32_t journal, flash_prog_src_t src, void *src_arg)
+{
+    memset(p, 0, sizeof(*p));
+    p->io = io;
+    p->port = *port;
+    p->offset = offset;
+    p->len = len;
+    p->tag = tag;
+    p->journal = journal;
+    p->src = src;
+    p->src_arg = src_arg;
+    p->regions = (len + FLASH_PROG_REGION - 1) / FLASH_PROG_REGION;
+
+    if (0 == len || (offset & (FLASH_IO_SECTOR - 1)) || offset + len < offset ||
+        p->regions > FLASH_PROG_MAX_REGIONS) {
+        return -1;
+    }
+    if (FLASH_PROG_NO_JOURNAL != journal &&
+        ((journal & (FLASH_IO_SECTOR - 1)) ||
+         (journal + FLASH_IO_SECTOR > offset && journal < offset + ALIGNUP(len, FLASH_IO_SECTOR)))) {
+        return -1;
+    }
+    if (0 != journal_open(p)) {
+        return -1;
+    }
+    return p->resumed;
+}
+
+static int submit(flash_prog_t *p, uint32_t *n)
+{
+    if (0 == *n) {
+        return 0;
+    }
+    p->batches++;
+    int ret = p->port.submit(p->port.arg, p->op, *n);
+    *n = 0;
+    return ret;
+}
+
+/* erases region k and queues its pages, the CRC of what went out goes to crc */
+static int program_region(flash_prog_t *p, uint32_t k, uint32_t *crc)
+{
+    uint32_t pos = k * FLASH_PROG_REGION;
+    uint32_t len = p->len - pos < FLASH_PROG_REGION ? p->len - pos : FLASH_PROG_REGION;
+    uint32_t n = 0, pages = 0;
+
+    p->op[n].code = FLASH_PROG_ERASE;
+    p->op[n].offset = p->offset + pos;
+    p->op[n].len = ALIGNUP(len, FLASH_IO_SECTOR);
+    n++;
+
+    *crc = 0;
+    for (uint32_t done = 0; done < len; done += FLASH_PROG_PAGE) {
+        uint32_t chunk = len - done < FLASH_PROG_PAGE ? len - done : FLASH_PROG_PAGE;
+        if (FLASH_PROG_BATCH_PAGES == pages) {
+            if (0 != submit(p, &n)) {
+                return -1;
+            }
+            pages = 0;
+        }
+        uint8_t *d = p->data + pages * FLASH_PROG_PAGE;
+        if (0 != p->src(p->src_arg, pos + done, d, chunk)) {
+            return -1;
+        }
+        *crc = flash_prog_crc32(*crc, d, chunk);
+        p->op[n].code = FLASH_PROG_WRITE;
+        p->op[n].offset = p->offset + pos + done;
+        p->op[n].len = chunk;
+        p->op[n].src = d;
+        n++;
+        pages++;
+        p->bytes += chunk;
+    }
+    if (0 != submit(p, &n)) {
+        return -1;
+    }
+    return p->port.drain(p->port.arg);
+}
+
+static int verify_region(flash_prog_t *p, uint32_t k, uint32_t crc)
+{
+    uint32_t offset = p->offset + k * FLASH_PROG_REGION;
+    uint32_t len = p->len - k * FLASH_PROG_REGION;
+    uint32_t got = 0;
+
+    len = len < FLASH_PROG_REGION ? len : FLASH_PROG_REGION;
+    /* the port may have gone around flash_io */
+    flash_io_invalidate(p->io, offset, len);
+    for (uint32_t done = 0; done < len; done += sizeof(p->check)) {
+        uint32_t chunk = len - done < sizeof(p->check) ? len - done : sizeof(p->check);
+        if (0 != flash_io_read(p->io, offset + done, p->check, chunk)) {
+            return -1;
+        }
+        got = flash_prog_crc32(got, p->check, chunk);
+    }
+    return got == crc ? 0 : -1;
+}
+
+int flash_prog_run(flash_prog_t *p)
+{
+    for (uint32_t k = 0; k < p->regions; k++) {
+        uint32_t crc;
+        if (p->done[k / 8] & (1 << (k % 8))) {
+            continue;
+        }
+        for (uint32_t tries = 0;; tries++) {
+            if (0 == program_region(p, k, &crc) && 0 == verify_region(p, k, crc)) {
+                break;
+            }
+            if (FLASH_PROG_RETRIES == tries) {
+                printf("[flash_prog] region %u at 0x%08x failed\r\n", k, p->offset + k * FLASH_PROG_REGION);
+                return -1;
+            }
+            p->retries++;
+        }
+        if (0 != journal_mark(p, k)) {
+            return -1;
+        }
+        p->programmed++;
+    }
+    return 0;
+}
+
+static int sync_submit(void *arg, const flash_prog_op_t *op, uint32_t n)
+{
+    flash_io_t *io = arg;
+
+    for (uint32_t i = 0; i < n; i++) {
+        int ret = FLASH_PROG_ERASE == op[i].code ? flash_io_erase(io, op[i].offset, op[i].len)
+                                                 : flash_io_write(io, op[i].offset, op[i].src, op[i].len);
+        if (0 != ret) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int sync_drain(void *arg)
+{
+    return flash_io_sync(arg);
+}
+
+void flash_prog_port_sync(flash_prog_port_t *port, flash_io_t *io)
+{
+    port->submit = sync_submit;
+    port->drain = sync_drain;
+    port->arg = io;
+}
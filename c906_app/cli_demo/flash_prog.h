@@ -0,0 +1,110 @@
+#ifndef __FLASH_PROG_H__
+#define __FLASH_PROG_H__
+
+#include <stdint.h>
+
+#include "flash_io.h"
+
+/*
+ * Programs a multi-MB image (a model, a picture set) into flash without
+ * waiting on the E907 for every sector. The image is cut into
+ * FLASH_PROG_REGIONs, each one is
+ *
+ *   erase     one op for the whole region, the E907 picks block or sector
+ *             erases
+ *   write     page ops queued right behind the erase, FLASH_PROG_BATCH_PAGES
+ *             to a batch; a port that runs batches in the background (xrpc)
+ *             takes the next one as soon as the previous is done, so the
+ *             C906 fetches and CRCs page n + 1 while page n is programmed
+ *   verify    once the queue has drained: CRC of the region read back (XIP
+ *             where mapped) against the CRC of what was queued, a mismatch
+ *             programs the region again, up to FLASH_PROG_RETRIES times
+ *   journal   one bit cleared in the journal sector, the region is done
+ *
+ * The verify step reads with the flash idle, XIP fetches aren't answered
+ * while it is busy, which costs one bubble per region (a few ms against the
+ * hundreds a region takes to program). A reset loses only the region in
+ * progress: flash_prog_begin() with the same image (offset, len, tag) finds
+ * the journal and skips every region it marks done. Journal layout, one
+ * sector, programmed with NOR rules so marking never needs an erase:
+ *
+ *   magic | offset | len | tag | bitmap, bit k cleared once region k is verified
+ */
+
+#define FLASH_PROG_REGION (64 * 1024)
+#define FLASH_PROG_PAGE (256)
+#define FLASH_PROG_BATCH_PAGES (14) /* with op headers that is the most one XRPC_BUF_SIZE request carries */
+#define FLASH_PROG_MAX_OPS (FLASH_PROG_BATCH_PAGES + 1)
+#define FLASH_PROG_MAX_REGIONS (256) /* 16 MB */
+#define FLASH_PROG_RETRIES (2)
+#define FLASH_PROG_NO_JOURNAL (0xffffffff)
+#define FLASH_PROG_JOURNAL_MAGIC (0x4a525046) /* "FPRJ" */
+
+typedef enum {
+    FLASH_PROG_ERASE = 0,
+    FLASH_PROG_WRITE,
+} flash_prog_code_t;
+
+typedef struct {
+    uint8_t code;
+    uint32_t offset;
+    uint32_t len;
+    const uint8_t *src; /* writes only */
+} flash_prog_op_t;
+
+/*
+ * Where the ops go. submit() may return before the batch has run, but not
+ * before the one submitted ahead of it is done, and the batch's memory is
+ * the caller's again when it returns. drain() waits for everything
+ * submitted. Both return 0 or -1; a port that can't see the result of a
+ * write (fire and forget) leaves it to the verify step.
+ */
+typedef struct {
+    int (*submit)(void *arg, const flash_prog_op_t *op, uint32_t n);
+    int (*drain)(void *arg);
+    void *arg;
+} flash_prog_port_t;
+
+/* Copies len bytes of the image from pos to dst. Returns 0 or -1. */
+typedef int (*flash_prog_src_t)(void *arg, uint32_t pos, uint8_t *dst, uint32_t len);
+
+typedef struct {
+    flash_io_t *io; /* journal, read back */
+    flash_prog_port_t port;
+    uint32_t offset;  /* in flash, sector aligned */
+    uint32_t len;
+    uint32_t tag;     /* tells images at the same place apart, a version or CRC */
+    uint32_t journal; /* in flash, sector aligned, or FLASH_PROG_NO_JOURNAL */
+    flash_prog_src_t src;
+    void *src_arg;
+
+    uint32_t regions;
+    uint8_t done[FLASH_PROG_MAX_REGIONS / 8]; /* bit set: region verified */
+    flash_prog_op_t op[FLASH_PROG_MAX_OPS];
+    uint8_t data[FLASH_PROG_BATCH_PAGES * FLASH_PROG_PAGE];
+    uint8_t check[FLASH_IO_SECTOR];
+
+    uint32_t resumed; /* regions found done by flash_prog_begin() */
+    uint32_t programmed;
+    uint32_t retries;
+    uint32_t batches;
+    uint64_t bytes; /* queued for writing, retries included */
+} flash_prog_t;
+
+/*
+ * Sets p up for an image of len bytes at offset and opens the journal: the
+ * same image's journal is picked up, anything else there is erased and
+ * replaced. Returns how many regions are done already, or -1.
+ */
+int flash_prog_begin(flash_prog_t *p, flash_io_t *io, const flash_prog_port_t *port, uint32_t offset, uint32_t len,
+                     uint32_t tag, uint32_t journal, flash_prog_src_t src, void *src_arg);
+
+/* Programs every region not done yet. Returns 0 once the whole image is verified, or -1. */
+int flash_prog_run(flash_prog_t *p);
+
+/* a port that runs each op through flash_io as it is submitted, nothing in the background */
+void flash_prog_port_sync(flash_prog_port_t *port, flash_io_t *io);
+
+uint32_t flash_prog_crc32(uint32_t crc, const void *buf, uint32_t len);
+
+#endif /* __FLASH_PROG_H__ */
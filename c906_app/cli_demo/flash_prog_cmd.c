@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* aos */
+#include <cli.h>
+
+/* utils */
+#include <utils_getopt.h>
+
+/* RISCV */
+#include <csi_core.h>
+
+#include "flash_prog.h"
+#include "xrpc_client.h"
+
+/* a 64 KB erase is ~150 ms typical but up to seconds on a worn part */
+#define FLASHBENCH_TIMEOUT_MS (5000)
+#define FLASHBENCH_LEN (1024 * 1024)
+
+static xrpc_client_t s_client;
+static flash_prog_t s_prog;
+
+/* the pipelined port: fire and forget batches, the next one is built while the e907 programs this one */
+static int xrpc_submit(void *arg, const flash_prog_op_t *op, uint32_t n)
+{
+    xrpc_client_t *c = arg;
+
+    xrpc_batch_begin(c);
+    for (uint32_t i = 0; i < n; i++) {
+        int idx = FLASH_PROG_ERASE == op[i].code ? xrpc_batch_flash_erase(c, op[i].offset, op[i].len)
+                                                 : xrpc_batch_flash_write(c, op[i].offset, op[i].src, op[i].len);
+        if (idx < 0) {
+            xrpc_batch_begin(c);
+            return -1;
+        }
+    }
+    return xrpc_batch_submit(c, 1, FLASHBENCH_TIMEOUT_MS);
+}
+
+/* a nop with a reply: back once every batch before it has run */
+static int xrpc_drain(void *arg)
+{
+    xrpc_client_t *c = arg;
+
+    xrpc_batch_begin(c);
+    xrpc_batch_nop(c);
+    return xrpc_batch_submit(c, 0, FLASHBENCH_TIMEOUT_MS);
+}
+
+/* the bench image: pseudo random, the same bytes for the same tag whatever order they are asked for in */
+static int pattern_src(void *arg, uint32_t pos, uint8_t *dst, uint32_t len)
+{
+    uint32_t tag = *(uint32_t *)arg;
+
+    for (uint32_t i = 0; i < len; i++, pos++) {
+        uint32_t x = (pos >> 2) * 0x9e3779b9 ^ tag;
+        x ^= x >> 16;
+        x *= 0x85ebca6b;
+        x ^= x >> 13;
+        dst[i] = x >> ((pos & 3) * 8);
+    }
+    return 0;
+}
+
+static int bench_run(const char *name, const flash_prog_port_t *port, uint32_t offset, uint32_t len, uint32_t tag,
+                     uint32_t journal)
+{
+    flash_prog_t *p = &s_prog;
+    int resumed = flash_prog_begin(p, flash_io_get(), port, offset, len, tag, journal, pattern_src, &tag);
+
+    if (resumed < 0) {
+        printf("[flashbench] %s: bad image or journal\r\n", name);
+        return -1;
+    }
+    uint64_t t0 = CPU_Get_MTimer_US();
+    int ret = flash_prog_run(p);
+    uint64_t us = CPU_Get_MTimer_US() - t0;
+    if (0 == us) {
+        us = 1;
+    }
+    printf("[flashbench] %-9s %s, %u of %u regions (%d resumed) in %lu ms, %lu KB/s, %u batches, %u retries\r\n",
+           name, 0 == ret ? "verified" : "FAILED", p->programmed, p->regions, resumed, (unsigned long)(us / 1000),
+           (unsigned long)(p->bytes * 1000000 / 1024 / us), p->batches, p->retries);
+    return ret;
+}
+
+static void print_usage()
+{
+    printf("Usage: flashbench -o<offset> <-l<len>> <-j<journal>> <-t<tag>> <-m<s|p>> <-r>\r\n");
+    printf("\tprograms a pseudo random image of <len> bytes at <offset> and verifies it\r\n");
+    printf("\tDESTROYS what is there: the media partition 0x%08x-0x%08x holds LittleFS (/lfs),\r\n",
+           FLASH_IO_MEDIA_OFFSET, FLASH_IO_MEDIA_OFFSET + FLASH_IO_MEDIA_SIZE);
+    printf("\tpoint -o at space nothing uses; there is no default\r\n");
+    printf("\t<len> is 1 MB by default, the journal the sector before <offset> unless -j, erased too\r\n");
+    printf("\t-m s: sector by sector through flash_io, p: pipelined xrpc batches, both by default\r\n");
+    printf("\t-t image tag, seeds the pattern, 1 by default; each run of a bench uses its own\r\n");
+    printf("\t-r resume: one pipelined run of the image <tag>, skipping what an interrupted run finished\r\n");
+    printf("\tpipelined runs need \"xrpc start\" on the e907 first\r\n");
+    printf("\r\n");
+}
+
+void cmd_c906_flashbench(char *buf, int len, int argc, char **argv)
+{
+    uint32_t offset = 0, size = FLASHBENCH_LEN, journal = 0;
+    uint32_t tag = 1;
+    int mode = 0, resume = 0, journal_set = 0, offset_set = 0;
+    flash_prog_port_t sync_port, xrpc_port = {xrpc_submit, xrpc_drain, &s_client};
+
+    int opt;
+    getopt_env_t getopt_env;
+    utils_getopt_init(&getopt_env, 0);
+    // put ':' in the starting of the string so that program can distinguish
+    // between '?' and ':'
+    while ((opt = utils_getopt(&getopt_env, argc, argv, ":o:l:j:t:m:rh")) != -1) {
+        switch (opt) {
+            case 'o':
+                offset = strtoul(getopt_env.optarg, NULL, 0);
+                offset_set = 1;
+                break;
+            case 'l':
+                size = strtoul(getopt_env.optarg, NULL, 0);
+                break;
+            case 'j':
+                journal = strtoul(getopt_env.optarg, NULL, 0);
+                journal_set = 1;
+                break;
+            case 't':
+                tag = strtoul(getopt_env.optarg, NULL, 0);
+                break;
+            case 'm':
+                mode = getopt_env.optarg[0];
+                break;
+            case 'r':
+                resume = 1;
+                break;
+            case 'h':
+                print_usage();
+                return;
+            case ':':
+                // printf("%s: %c requires an argument\r\n", *argv, getopt_env.optopt);
+                break;
+            case '?':
+                // printf("unknow option: %c\r\n", getopt_env.optopt);
+                break;
+        }
+    }
+    if (!journal_set) {
+        journal = offset - FLASH_IO_SECTOR;
+    }
+    /* erases and rewrites whatever is there, so never without being told where */
+    if (!offset_set || (mode && 's' != mode && 'p' != mode) || (resume && 's' == mode)) {
+        print_usage();
+        return;
+    }
+
+    flash_prog_port_sync(&sync_port, flash_io_get());
+    int ret = 's' != mode ? xrpc_client_init(&s_client, (void *)XRPC_SHM_BASE) : 0;
+    if (0 != ret) {
+        if (-2 == ret) {
+            printf("[flashbench] heap reaches into the xrpc mailbox at %08lx, see xrpc_msg.h\r\n",
+                   (unsigned long)XRPC_SHM_BASE);
+        } else {
+            printf("[flashbench] xrpc server not running, \"xrpc start\" on the e907, then again\r\n");
+        }
+        if (resume || 'p' == mode) {
+            return;
+        }
+        mode = 's';
+    }
+
+    printf("[flashbench] %u KB at 0x%08x, journal at 0x%08x\r\n", size >> 10, offset, journal);
+    if (resume) {
+        bench_run("resume", &xrpc_port, offset, size, tag, journal);
+        return;
+    }
+    /* a tag of its own per run, or the second would find the first's journal and skip everything */
+    if ('p' != mode) {
+        bench_run("sync", &sync_port, offset, size, tag, journal);
+    }
+    if ('s' != mode) {
+        bench_run("pipelined", &xrpc_port, offset, size, tag + 1, journal);
+        printf("[flashbench] xrpc %u batches, %u ops, %u timeouts\r\n", s_client.batches, s_client.ops,
+               s_client.timeouts);
+    }
+}
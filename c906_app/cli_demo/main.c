@@ -16,10 +16,16 @@
 extern void cmd_c906_gpio(char *buf, int len, int argc, char **argv);
 extern void cmd_c906_mdl(char *buf, int len, int argc, char **argv);
 extern void cmd_c906_flash(char *buf, int len, int argc, char **argv);
+extern void cmd_c906_mdls(char *buf, int len, int argc, char **argv);
+extern void cmd_c906_xbench(char *buf, int len, int argc, char **argv);
+extern void cmd_c906_flashbench(char *buf, int len, int argc, char **argv);
 const static struct cli_command cmds_user[] STATIC_CLI_CMD_ATTRIBUTE = {
     {"gpio", "c906 gpio command", cmd_c906_gpio},
     {"mdl", "c906 npu model command", cmd_c906_mdl},
     {"flash", "c906 flash command", cmd_c906_flash},
+    {"mdls", "c906 multi-model scheduler command", cmd_c906_mdls},
+    {"xbench", "c906 batched xram call benchmark", cmd_c906_xbench},
+    {"flashbench", "c906 pipelined flash programming benchmark", cmd_c906_flashbench},
 };
 
 void main() 
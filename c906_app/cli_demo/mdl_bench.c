@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mdl_bench.h"
+
+int mdl_bench_run(mdl_bench_t *b, mdl_bench_run_t run, void *arg, mdl_bench_clock_t now_us)
+{
+    uint32_t checksum = 0;
+    int ret;
+
+    b->done = 0;
+    b->total_us = 0;
+    b->checksum_mismatch = 0;
+
+    for (uint32_t i = 0; i < b->warmup; i++) {
+        if (0 != (ret = run(arg, &checksum))) {
+            return ret;
+        }
+    }
+    b->ref_checksum = checksum;
+
+    for (uint32_t i = 0; i < b->iters; i++) {
+        uint64_t t0 = now_us();
+        ret = run(arg, &checksum);
+        uint64_t t1 = now_us();
+        if (0 != ret) {
+            mdl_bench_stats(b);
+            return ret;
+        }
+
+        if (0 == b->warmup && 0 == i) {
+            b->ref_checksum = checksum;
+        } else if (checksum != b->ref_checksum) {
+            b->checksum_mismatch++;
+        }
+        b->samples_us[i] = (uint32_t)(t1 - t0);
+        b->total_us += t1 - t0;
+        b->done++;
+    }
+    mdl_bench_stats(b);
+    return 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* nearest-rank percentile on a sorted array */
+static uint32_t percentile(const uint32_t *sorted, uint32_t n, uint32_t pct)
+{
+    uint32_t rank = (pct * n + 99) / 100;
+    if (rank == 0) rank = 1;
+    return sorted[rank - 1];
+}
+
+void mdl_bench_stats(mdl_bench_t *b)
+{
+    b->min_us = b->max_us = b->avg_us = b->p50_us = b->p99_us = 0;
+    if (0 == b->done) {
+        return;
+    }
+
+    uint32_t *sorted = malloc(b->done * sizeof(uint32_t));
+    if (NULL == sorted) {
+        printf("[mdl_bench] no memory for statistics\r\n");
+        return;
+    }
+    memcpy(sorted, b->samples_us, b->done * sizeof(uint32_t));
+    qsort(sorted, b->done, sizeof(uint32_t), cmp_u32);
+
+    b->min_us = sorted[0];
+    b->max_us = sorted[b->done - 1];
+    b->avg_us = (uint32_t)(b->total_us / b->done);
+    b->p50_us = percentile(sorted, b->done, 50);
+    b->p99_us = percentile(sorted, b->done, 99);
+    free(sorted);
+}
+
+void mdl_bench_dump(const mdl_bench_t *b)
+{
+    printf("\r\n[mdl_bench] %u runs (+%u warmup)\r\n", b->done, b->warmup);
+    if (0 == b->done) {
+        return;
+    }
+    printf("\tlatency min %u.%03ums avg %u.%03ums p50 %u.%03ums p99 %u.%03ums max %u.%03ums\r\n", b->min_us / 1000,
+           b->min_us % 1000, b->avg_us / 1000, b->avg_us % 1000, b->p50_us / 1000, b->p50_us % 1000,
+           b->p99_us / 1000, b->p99_us % 1000, b->max_us / 1000, b->max_us % 1000);
+    if (b->total_us) {
+        uint32_t fps_x100 = (uint32_t)((uint64_t)b->done * 100000000ULL / b->total_us);
+        printf("\tthroughput %u.%02u inf/s\r\n", fps_x100 / 100, fps_x100 % 100);
+    }
+    printf("\toutput checksum %08x, %u mismatched run(s)%s\r\n", b->ref_checksum, b->checksum_mismatch,
+           b->checksum_mismatch ? " <- UNSTABLE" : "");
+}
+
+void mdl_bench_dump_csv(const mdl_bench_t *b)
+{
+    printf("run,latency_us\r\n");
+    for (uint32_t i = 0; i < b->done; i++) {
+        printf("%u,%u\r\n", i, b->samples_us[i]);
+    }
+}
+
+uint32_t mdl_bench_checksum(const uint8_t *data, uint32_t size)
+{
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < size; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
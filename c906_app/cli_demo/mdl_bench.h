@@ -0,0 +1,49 @@
+#ifndef __MDL_BENCH_H__
+#define __MDL_BENCH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * One inference. Returns 0 on success and stores a checksum of the output
+ * so the bench can tell whether repeated runs are stable.
+ */
+typedef int (*mdl_bench_run_t)(void *arg, uint32_t *checksum);
+
+/* monotonic microsecond clock */
+typedef uint64_t (*mdl_bench_clock_t)(void);
+
+typedef struct {
+    /* config */
+    uint32_t iters;
+    uint32_t warmup;
+    uint32_t *samples_us; /* iters entries, owned by the caller */
+
+    /* results */
+    uint32_t done;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t avg_us;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint64_t total_us;
+    uint32_t ref_checksum;
+    uint32_t checksum_mismatch;
+} mdl_bench_t;
+
+/**
+ * Run warmup + iters inferences and fill in the statistics.
+ * Returns 0 on success, or the first non zero value returned by run.
+ */
+int mdl_bench_run(mdl_bench_t *b, mdl_bench_run_t run, void *arg, mdl_bench_clock_t now_us);
+
+/* recompute min/avg/p50/p99 over samples_us[0..done) */
+void mdl_bench_stats(mdl_bench_t *b);
+
+void mdl_bench_dump(const mdl_bench_t *b);
+void mdl_bench_dump_csv(const mdl_bench_t *b);
+
+/* FNV-1a over the output tensor */
+uint32_t mdl_bench_checksum(const uint8_t *data, uint32_t size);
+
+#endif /* __MDL_BENCH_H__ */
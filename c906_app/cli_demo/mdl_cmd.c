@@ -1,6 +1,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* aos */
 #include <cli.h>
@@ -19,12 +20,24 @@
 #include <fs/vfs_romfs.h>
 #include <vfs.h>
 
+/* RISCV */
+#include <csi_core.h>
+
+#include "mdl_bench.h"
+
+/* benchmarked when -n comes without -f or -l, the path bl808_npu_guide.md puts it at */
+#define MDL_BENCH_DEFAULT_MODEL "/romfs/models/mnist.blai"
+
 static void print_usage()
 {
     printf("Usage: mdl -l<model_path> -o<output_size> <-i<input_bin_path>> <-u>\r\n");
+    printf("       mdl -n<iters> <-w<warmup>> <-f<model_path>> <-i<input_bin_path>> <-c>\r\n");
     printf("\t-o must be specified if you want to see your result\r\n");
     printf("\twithout -i it will use random ram data as input\r\n");
     printf("\twith -u it will print output with hex format, otherwise float format\r\n");
+    printf("\twith -n it runs the model <iters> times after <warmup> runs and prints latency statistics\r\n");
+    printf("\t-f (or -l) picks the model to benchmark, %s by default\r\n", MDL_BENCH_DEFAULT_MODEL);
+    printf("\twith -c it also dumps per-run latency as csv\r\n");
     printf("\r\n");
 }
 
@@ -38,25 +51,77 @@ static int get_file_from_romfs(char *name, char **xip_addr)
         return -1;
     }
 
-    aos_ioctl(fd, IOCTL_ROMFS_GET_FILEBUF, (long unsigned int)&filebuf);
+    if (0 != aos_ioctl(fd, IOCTL_ROMFS_GET_FILEBUF, (long unsigned int)&filebuf)) {
+        printf("%s is not in romfs!\r\n", name);
+        aos_close(fd);
+        return -1;
+    }
     *xip_addr = filebuf.buf;
     printf("Found file %s. XIP Addr %p, len %#x\r\n", name, filebuf.buf, filebuf.bufsize);
     return filebuf.bufsize;
 }
 
+typedef struct {
+    blai_model_hdl_t hdl;
+    uint8_t *output;
+    uint32_t output_size;
+} mdl_bench_ctx_t;
+
+static int mdl_bench_once(void *arg, uint32_t *checksum)
+{
+    mdl_bench_ctx_t *ctx = arg;
+    blai_startCompute(ctx->hdl);
+    csi_dcache_invalid_range((uint64_t *)ctx->output, ctx->output_size);
+    *checksum = mdl_bench_checksum(ctx->output, ctx->output_size);
+    return 0;
+}
+
+static uint64_t mdl_bench_now_us(void)
+{
+    return CPU_Get_MTimer_US();
+}
+
+static void mdl_benchmark(blai_model_hdl_t hdl, uint8_t *output, uint32_t output_size, uint32_t iters,
+                          uint32_t warmup, bool csv)
+{
+    mdl_bench_ctx_t ctx = {
+        .hdl = hdl,
+        .output = output,
+        .output_size = output_size,
+    };
+    mdl_bench_t b = {
+        .iters = iters,
+        .warmup = warmup,
+    };
+
+    if (NULL == (b.samples_us = malloc(iters * sizeof(uint32_t)))) {
+        printf("no memory for %u samples\r\n", iters);
+        return;
+    }
+    mdl_bench_run(&b, mdl_bench_once, &ctx, mdl_bench_now_us);
+    mdl_bench_dump(&b);
+    if (csv) {
+        mdl_bench_dump_csv(&b);
+    }
+    free(b.samples_us);
+}
+
 void cmd_c906_mdl(char *buf, int len, int argc, char **argv)
 {
     char *model_path = NULL;
     char *input_bin_path = NULL;
     uint32_t output_size = 0;
     bool printhex = false;
+    uint32_t iters = 0;
+    uint32_t warmup = 1;
+    bool csv = false;
 
     int opt;
     getopt_env_t getopt_env;
     utils_getopt_init(&getopt_env, 0);
     // put ':' in the starting of the string so that program can distinguish
     // between '?' and ':'
-    while ((opt = utils_getopt(&getopt_env, argc, argv, ":hul:i:o:")) != -1) {
+    while ((opt = utils_getopt(&getopt_env, argc, argv, ":hucl:f:i:o:n:w:")) != -1) {
         switch (opt) {
             case 'h':
                 print_usage();
@@ -64,12 +129,22 @@ void cmd_c906_mdl(char *buf, int len, int argc, char **argv)
             case 'u':
                 printhex = true;
                 break;
+            case 'c':
+                csv = true;
+                break;
+            case 'n':
+                iters = (uint32_t)atoi(getopt_env.optarg);
+                break;
+            case 'w':
+                warmup = (uint32_t)atoi(getopt_env.optarg);
+                break;
             case 'l':
+            case 'f':
             case 'i':
             case 'o':
                 // printf("option: %c\r\n", opt);
                 // printf("optarg: %s\r\n", getopt_env.optarg);
-                if ('l' == opt) {
+                if ('l' == opt || 'f' == opt) {
                     /* load model path */
                     model_path = getopt_env.optarg;
                 } else if ('i' == opt) {
@@ -93,6 +168,9 @@ void cmd_c906_mdl(char *buf, int len, int argc, char **argv)
         printf("extra arguments: %s\r\n", argv[getopt_env.optind]);
     }
 
+    if (NULL == model_path && iters > 0) {
+        model_path = MDL_BENCH_DEFAULT_MODEL;
+    }
     if (NULL == model_path) {
         printf("model path unset\r\n");
         return;
@@ -104,8 +182,10 @@ void cmd_c906_mdl(char *buf, int len, int argc, char **argv)
     }
     printf("alloc model success\r\n");
 
-    const char *model_xip_addr;
-    get_file_from_romfs(model_path, &model_xip_addr);
+    char *model_xip_addr;
+    if (0 >= get_file_from_romfs(model_path, &model_xip_addr)) {
+        goto exit;
+    }
 
     blai_load_model_from_buffer(model_hdl, (uint8_t *)model_xip_addr);
     printf("load model success\r\n");
@@ -121,10 +201,13 @@ void cmd_c906_mdl(char *buf, int len, int argc, char **argv)
     }
     uint32_t img_size = net->w * net->h * net->c;
 
-    const char *input_bin_xip_addr;
+    char *input_bin_xip_addr;
     if (input_bin_path) {
-        uint32_t input_bin_size = get_file_from_romfs(input_bin_path, &input_bin_xip_addr);
-        if (img_size > input_bin_size) img_size = input_bin_size;
+        int input_bin_size = get_file_from_romfs(input_bin_path, &input_bin_xip_addr);
+        if (0 >= input_bin_size) {
+            goto exit;
+        }
+        if (img_size > (uint32_t)input_bin_size) img_size = input_bin_size;
         memcpy(img_buf, input_bin_xip_addr, img_size);
     }
     csi_dcache_clean_range((uint64_t *)img_buf, img_size);
@@ -169,6 +252,13 @@ void cmd_c906_mdl(char *buf, int len, int argc, char **argv)
     }
     printf("\r\n");
 
+    if (iters > 0) {
+        uint32_t out_c = net->layers[net->layer_cnt - 1].out_c;
+        uint32_t real_output_size = net->layers[net->layer_cnt - 1].out_h * net->layers[net->layer_cnt - 1].out_w *
+                                    (out_c == 1 ? out_c : ((out_c + 3) & ~3));
+        mdl_benchmark(model_hdl, output, real_output_size, iters, warmup, csv);
+    }
+
 exit:
     blai_free(model_hdl);
 }
\ No newline at end of file
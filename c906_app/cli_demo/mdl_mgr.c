@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* FreeRTOS */
+#include <FreeRTOS.h>
+#include <semphr.h>
+#include <task.h>
+
+/* aos */
+#include <aos/kernel.h>
+#include <fs/vfs_romfs.h>
+#include <vfs.h>
+
+/* bl808 c906 std driver */
+#include <bl808_glb.h>
+
+/* RISCV */
+#include <csi_core.h>
+
+/* bl808 npu */
+#include <blai_core.h>
+
+#include "mdl_mgr.h"
+
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+
+typedef struct {
+    int id;
+    uint32_t seq;
+    uint64_t submit_us;
+    const uint8_t *input;
+    uint32_t size;
+    mdl_mgr_done_cb_t cb;
+    void *arg;
+} mdl_mgr_req_t;
+
+static mdl_mgr_model_t s_models[MDL_MGR_MAX_MODELS];
+static int s_model_cnt;
+
+static mdl_mgr_req_t s_pending[MDL_MGR_MAX_PENDING];
+static int s_pending_cnt;
+static uint32_t s_seq;
+static SemaphoreHandle_t s_wakeup;
+
+/* only touched by the worker */
+static int s_resident = -1;
+static BLAI_Model_t *s_model;
+static uint32_t s_switches;
+static uint32_t s_bypassed; /* picks in a row that went past an older request for the resident model */
+
+static int make_resident(int id)
+{
+    if (id == s_resident) {
+        return 0;
+    }
+    if (NULL != s_model) {
+        blai_free(s_model);
+        s_model = NULL;
+        s_resident = -1;
+    }
+
+    mdl_mgr_model_t *m = &s_models[id];
+    uint32_t heap_base = xPortGetFreeHeapSize();
+    if (NULL == (s_model = blai_create())) {
+        printf("[mdl_mgr] create blai handler failed\r\n");
+        return -1;
+    }
+    if (BLAI_STATUS_NO_ERROR != blai_load_model_from_buffer(s_model, (uint8_t *)m->xip)) {
+        printf("[mdl_mgr] load %s failed\r\n", m->path);
+        blai_free(s_model);
+        s_model = NULL;
+        return -1;
+    }
+    blai_npu_initCfg(s_model);
+
+    uint32_t used = heap_base - xPortGetFreeHeapSize();
+    if (used > m->arena_bytes) m->arena_bytes = used;
+    m->loads++;
+    s_switches++;
+    s_resident = id;
+    return 0;
+}
+
+/* a runs before b: higher priority, then older */
+static inline int runs_before(const mdl_mgr_req_t *a, const mdl_mgr_req_t *b)
+{
+    uint8_t pa = s_models[a->id].priority;
+    uint8_t pb = s_models[b->id].priority;
+    if (pa != pb) {
+        return pa > pb;
+    }
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+/*
+ * The first request in priority and submission order, unless the resident
+ * model has one of the same priority queued and hasn't jumped the queue
+ * MDL_MGR_MAX_BYPASS times already: then that one, saving a switch.
+ */
+static int pick_next(mdl_mgr_req_t *req)
+{
+    int best = -1;
+    int resident = -1;
+
+    taskENTER_CRITICAL();
+    for (int i = 0; i < s_pending_cnt; i++) {
+        const mdl_mgr_req_t *a = &s_pending[i];
+        if (best < 0 || runs_before(a, &s_pending[best])) {
+            best = i;
+        }
+        if (a->id == s_resident && (resident < 0 || runs_before(a, &s_pending[resident]))) {
+            resident = i;
+        }
+    }
+    if (resident >= 0 && resident != best && s_bypassed < MDL_MGR_MAX_BYPASS &&
+        s_models[s_pending[resident].id].priority == s_models[s_pending[best].id].priority) {
+        best = resident;
+        s_bypassed++;
+    } else if (best >= 0) {
+        s_bypassed = 0;
+    }
+    if (best >= 0) {
+        *req = s_pending[best];
+        s_pending[best] = s_pending[--s_pending_cnt];
+    }
+    taskEXIT_CRITICAL();
+    return best;
+}
+
+static void run_request(const mdl_mgr_req_t *req)
+{
+    mdl_mgr_model_t *m = &s_models[req->id];
+    if (0 != make_resident(req->id)) {
+        mdl_mgr_result_t result = {
+            .status = -1,
+            .latency_us = (uint32_t)(CPU_Get_MTimer_US() - req->submit_us),
+        };
+        m->errors++;
+        if (req->cb) {
+            req->cb(req->id, &result, req->arg);
+        }
+        return;
+    }
+
+    struct blai_net_info_t *net = s_model->net;
+    if (req->input) {
+        uint8_t *img_buf = blai_getInputBuffer(s_model);
+        uint32_t img_size = net->w * net->h * ((net->c) == 1 ? (net->c) : ALIGNUP((net->c), 4));
+        memcpy(img_buf, req->input, req->size < img_size ? req->size : img_size);
+        csi_dcache_clean_range((uint64_t *)img_buf, img_size);
+    }
+
+    uint64_t t0 = CPU_Get_MTimer_US();
+    blai_startCompute(s_model);
+    uint64_t t1 = CPU_Get_MTimer_US();
+
+    uint32_t last = net->layer_cnt - 1;
+    uint32_t out_c = net->layers[last].out_c;
+    mdl_mgr_result_t result = {
+        .output = (uint8_t *)s_model->buffer + net->layers[last].out_layer_mem * net->patch_size,
+        .output_size = net->layers[last].out_h * net->layers[last].out_w * (out_c == 1 ? out_c : ALIGNUP(out_c, 4)),
+        .scale = net->layers[last].output_scale,
+        .zero_point = (int)net->layers[last].tf_output_offset,
+        .latency_us = (uint32_t)(t1 - req->submit_us),
+        .compute_us = (uint32_t)(t1 - t0),
+    };
+    csi_dcache_invalid_range((uint64_t *)result.output, result.output_size);
+
+    m->runs++;
+    m->total_us += result.latency_us;
+    if (result.latency_us > m->max_us) m->max_us = result.latency_us;
+
+    if (req->cb) {
+        req->cb(req->id, &result, req->arg);
+    }
+}
+
+static void mdl_mgr_task(void *arg)
+{
+    mdl_mgr_req_t req;
+
+    (void)arg;
+    while (1) {
+        xSemaphoreTake(s_wakeup, portMAX_DELAY);
+        while (pick_next(&req) >= 0) {
+            run_request(&req);
+        }
+    }
+}
+
+int mdl_mgr_init(void)
+{
+    if (NULL != s_wakeup) {
+        return 0;
+    }
+    if (NULL == (s_wakeup = xSemaphoreCreateBinary())) {
+        return -1;
+    }
+    if (pdPASS != xTaskCreate(mdl_mgr_task, "mdl_mgr", 1024, NULL, 10, NULL)) {
+        vSemaphoreDelete(s_wakeup);
+        s_wakeup = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int mdl_mgr_register(const char *path, uint8_t priority)
+{
+    if (s_model_cnt >= MDL_MGR_MAX_MODELS) {
+        printf("[mdl_mgr] too many models\r\n");
+        return -1;
+    }
+
+    int fd = aos_open(path, 0);
+    if (fd < 0) {
+        printf("[mdl_mgr] %s not found\r\n", path);
+        return -1;
+    }
+    romfs_filebuf_t filebuf = {0};
+    int ret = aos_ioctl(fd, IOCTL_ROMFS_GET_FILEBUF, (long unsigned int)&filebuf);
+    aos_close(fd);
+    if (0 != ret || NULL == filebuf.buf) {
+        printf("[mdl_mgr] %s is not xip mapped\r\n", path);
+        return -1;
+    }
+
+    mdl_mgr_model_t *m = &s_models[s_model_cnt];
+    memset(m, 0, sizeof(*m));
+    m->path = strdup(path);
+    m->xip = (const uint8_t *)filebuf.buf;
+    m->priority = priority;
+    return s_model_cnt++;
+}
+
+int mdl_mgr_submit(int id, const uint8_t *input, uint32_t size, mdl_mgr_done_cb_t cb, void *arg)
+{
+    if (id < 0 || id >= s_model_cnt || NULL == s_wakeup) {
+        return -1;
+    }
+
+    int ret = -1;
+    taskENTER_CRITICAL();
+    if (s_pending_cnt < MDL_MGR_MAX_PENDING) {
+        mdl_mgr_req_t *req = &s_pending[s_pending_cnt++];
+        req->id = id;
+        req->seq = s_seq++;
+        req->submit_us = CPU_Get_MTimer_US();
+        req->input = input;
+        req->size = size;
+        req->cb = cb;
+        req->arg = arg;
+        ret = 0;
+    }
+    taskEXIT_CRITICAL();
+
+    if (0 == ret) {
+        xSemaphoreGive(s_wakeup);
+    }
+    return ret;
+}
+
+const mdl_mgr_model_t *mdl_mgr_get(int id)
+{
+    return (id >= 0 && id < s_model_cnt) ? &s_models[id] : NULL;
+}
+
+int mdl_mgr_count(void)
+{
+    return s_model_cnt;
+}
+
+void mdl_mgr_dump(void)
+{
+    uint32_t sum = 0, max = 0;
+
+    printf("[mdl_mgr] %d model(s), resident %d, %u switch(es)\r\n", s_model_cnt, s_resident, s_switches);
+    for (int i = 0; i < s_model_cnt; i++) {
+        const mdl_mgr_model_t *m = &s_models[i];
+        uint32_t avg = m->runs ? (uint32_t)(m->total_us / m->runs) : 0;
+        printf("\t[%d] %s prio %u arena %u loads %u runs %u errors %u avg %u.%03ums max %u.%03ums\r\n", i, m->path,
+               m->priority, m->arena_bytes, m->loads, m->runs, m->errors, avg / 1000, avg % 1000, m->max_us / 1000,
+               m->max_us % 1000);
+        sum += m->arena_bytes;
+        if (m->arena_bytes > max) max = m->arena_bytes;
+    }
+    /* one resident at a time holds at most the largest measured arena, all of them resident would hold the sum */
+    printf("\tone at a time %u bytes at most vs %u bytes all resident, saved %u bytes\r\n", max, sum, sum - max);
+}
@@ -0,0 +1,65 @@
+#ifndef __MDL_MGR_H__
+#define __MDL_MGR_H__
+
+#include <stdint.h>
+
+#define MDL_MGR_MAX_MODELS (4)
+#define MDL_MGR_MAX_PENDING (16)
+/* times in a row the resident model may run ahead of an older request of the same priority */
+#define MDL_MGR_MAX_BYPASS (4)
+
+typedef struct {
+    int status; /* 0, or -1 if the model could not be loaded, nothing else but latency_us set then */
+    const uint8_t *output;
+    uint32_t output_size;
+    float scale;
+    int zero_point;
+    uint32_t latency_us; /* submit to completion */
+    uint32_t compute_us; /* npu only */
+} mdl_mgr_result_t;
+
+typedef void (*mdl_mgr_done_cb_t)(int id, const mdl_mgr_result_t *result, void *arg);
+
+typedef struct {
+    const char *path;
+    const uint8_t *xip;   /* model image, used in place from flash */
+    uint8_t priority;     /* higher runs first */
+    uint32_t arena_bytes; /* heap held while resident, 0 until first load */
+    uint32_t loads;
+    uint32_t runs;
+    uint32_t errors; /* requests completed with status -1 */
+    uint64_t total_us;
+    uint32_t max_us;
+} mdl_mgr_model_t;
+
+/**
+ * Start the worker task. Only one model is resident at a time: switching
+ * frees the current model and loads the next one from its XIP image, so
+ * the heap its activations took is what the next one's are allocated from.
+ * libblai allocates them itself and takes no arena from the caller, so the
+ * sharing is this one-at-a-time, not a buffer handed from model to model;
+ * arena_bytes is what each load measured off the heap.
+ *
+ * Requests run by priority, then in submission order. A request for the
+ * resident model may go ahead of older ones of the same priority to save a
+ * switch, at most MDL_MGR_MAX_BYPASS times in a row.
+ */
+int mdl_mgr_init(void);
+
+/* register a romfs model, returns its id or -1 */
+int mdl_mgr_register(const char *path, uint8_t priority);
+
+/**
+ * Queue one inference. input (size bytes) is copied into the model input
+ * tensor when the request runs and must stay valid until cb is called;
+ * NULL keeps whatever the tensor holds. cb is called for every queued
+ * request, with status -1 if its model failed to load.
+ * Returns 0 or -1 if the queue is full.
+ */
+int mdl_mgr_submit(int id, const uint8_t *input, uint32_t size, mdl_mgr_done_cb_t cb, void *arg);
+
+const mdl_mgr_model_t *mdl_mgr_get(int id);
+int mdl_mgr_count(void);
+void mdl_mgr_dump(void);
+
+#endif /* __MDL_MGR_H__ */
@@ -0,0 +1,113 @@
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* aos */
+#include <cli.h>
+
+/* utils */
+#include <utils_getopt.h>
+#include <utils_log.h>
+
+#include "mdl_mgr.h"
+
+static void print_usage()
+{
+    printf("Usage: mdls -a<model_path> <-p<priority>>\r\n");
+    printf("       mdls -r<id> <-n<count>>\r\n");
+    printf("       mdls -s\r\n");
+    printf("\t-a registers a romfs model, one model is resident at a time so they share its heap\r\n");
+    printf("\t-r queues <count> inferences of model <id>, higher priority models run first\r\n");
+    printf("\t-s prints per-model latency and the memory saved against all models resident\r\n");
+    printf("\r\n");
+}
+
+static void mdls_done_cb(int id, const mdl_mgr_result_t *result, void *arg)
+{
+    if (0 != result->status) {
+        printf("[mdls] model %d failed to load, request dropped\r\n", id);
+        return;
+    }
+
+    uint32_t idx = 0;
+    for (uint32_t i = 1; i < result->output_size; i++) {
+        if (result->output[i] > result->output[idx]) idx = i;
+    }
+    printf("[mdls] model %d top %u, latency %u.%03ums (npu %u.%03ums)\r\n", id, idx, result->latency_us / 1000,
+           result->latency_us % 1000, result->compute_us / 1000, result->compute_us % 1000);
+}
+
+void cmd_c906_mdls(char *buf, int len, int argc, char **argv)
+{
+    char *model_path = NULL;
+    int priority = 0;
+    int run_id = -1;
+    int count = 1;
+    bool stats = false;
+
+    int opt;
+    getopt_env_t getopt_env;
+    utils_getopt_init(&getopt_env, 0);
+    // put ':' in the starting of the string so that program can distinguish
+    // between '?' and ':'
+    while ((opt = utils_getopt(&getopt_env, argc, argv, ":hsa:p:r:n:")) != -1) {
+        switch (opt) {
+            case 'h':
+                print_usage();
+                break;
+            case 's':
+                stats = true;
+                break;
+            case 'a':
+                model_path = getopt_env.optarg;
+                break;
+            case 'p':
+                priority = atoi(getopt_env.optarg);
+                break;
+            case 'r':
+                run_id = atoi(getopt_env.optarg);
+                break;
+            case 'n':
+                count = atoi(getopt_env.optarg);
+                break;
+            case ':':
+                // printf("%s: %c requires an argument\r\n", *argv, getopt_env.optopt);
+                break;
+            case '?':
+                // printf("unknow option: %c\r\n", getopt_env.optopt);
+                break;
+        }
+    }
+    // optind is for the extra arguments which are not parsed
+    for (; getopt_env.optind < argc; getopt_env.optind++) {
+        printf("extra arguments: %s\r\n", argv[getopt_env.optind]);
+    }
+
+    if (0 != mdl_mgr_init()) {
+        printf("mdl_mgr init failed\r\n");
+        return;
+    }
+
+    if (model_path) {
+        int id = mdl_mgr_register(model_path, (uint8_t)priority);
+        if (id >= 0) {
+            printf("registered %s as model %d, priority %d\r\n", model_path, id, priority);
+        }
+    }
+
+    if (run_id >= 0) {
+        int queued = 0;
+        for (int i = 0; i < count; i++) {
+            if (0 != mdl_mgr_submit(run_id, NULL, 0, mdls_done_cb, NULL)) {
+                break;
+            }
+            queued++;
+        }
+        printf("queued %d/%d inference(s) for model %d\r\n", queued, count, run_id);
+    }
+
+    if (stats) {
+        mdl_mgr_dump();
+    }
+}
@@ -0,0 +1,400 @@
+/*
+ * flash_prog_check - flash_prog.c on the file-backed flash of flash_demo/tools,
+ * with NOR erase and program times, then MB/s of both ports.
+ *
+ * The pipelined port here stands in for xrpc: a thread plays the E907,
+ * submit() hands it a batch once the previous one is done and returns, so
+ * the caller builds the next batch while this one is "programmed". Its
+ * writes go straight to the platform, past flash_io, like the E907's do;
+ * the window of the file-backed flash stays stale until invalidated, so a
+ * read back that forgot to would fail to verify.
+ *
+ *   image      an image not a multiple of the region size, on both ports,
+ *              read back byte for byte
+ *   reset      the port dies 100 batches in; a second flash_prog_begin()
+ *              of the same image resumes from the journal, programs only
+ *              the regions left and ends up with the whole image
+ *   done       a third begin finds every region done and writes nothing
+ *   dropped    a write the E907 silently lost is caught by the CRC and the
+ *              region programmed again
+ *   journal    a header without its magic (a reset while writing it) and
+ *              another image's journal start over
+ *   args       unaligned offsets, journals inside the image
+ *
+ * Times are the typical figures of the board's flash divided by -x; -c is
+ * the C906's cost per page (fetching the image, the CRC), -p the round trip
+ * per call to the E907, both spun on the CPU.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -I../../flash_demo/tools -o flash_prog_check flash_prog_check.c ../flash_prog.c ../flash_io.c \
+ *       ../../flash_demo/tools/flash_file.c -lpthread
+ *   ./flash_prog_check -x 10
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "flash_file.h"
+#include "flash_prog.h"
+
+#define FLASH_SIZE (FLASH_IO_MEDIA_OFFSET + 4 * 1024 * 1024)
+#define IMAGE_OFFSET (FLASH_IO_MEDIA_OFFSET + 0x100000) /* in the XIP window */
+#define IMAGE_LEN (1024 * 1024 + 1234)
+#define JOURNAL (IMAGE_OFFSET - FLASH_IO_SECTOR)
+#define LOW_OFFSET (0x200000) /* below it, read back over RPC */
+
+static uint32_t checks, failed;
+static uint32_t src_us = 20, call_us = 30;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static uint64_t now_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static void spin_us(uint32_t us)
+{
+    uint64_t t0 = now_us();
+    while (now_us() - t0 < us) {
+    }
+}
+
+/* the C906 side of a page: make it up and pay for fetching it */
+static int pattern_src(void *arg, uint32_t pos, uint8_t *dst, uint32_t len)
+{
+    uint32_t tag = *(uint32_t *)arg;
+
+    for (uint32_t i = 0; i < len; i++, pos++) {
+        uint32_t x = (pos >> 2) * 0x9e3779b9 ^ tag;
+        x ^= x >> 16;
+        x *= 0x85ebca6b;
+        x ^= x >> 13;
+        dst[i] = x >> ((pos & 3) * 8);
+    }
+    spin_us(src_us);
+    return 0;
+}
+
+/* the image as it should be in flash */
+static int image_ok(uint32_t offset, uint32_t len, uint32_t tag)
+{
+    uint8_t *want = malloc(len), *got = malloc(len);
+    uint32_t saved = src_us;
+    int ok;
+
+    src_us = 0;
+    pattern_src(&tag, 0, want, len);
+    src_us = saved;
+    ok = want && got && 0 == flash_port_read(offset, got, len) && 0 == memcmp(want, got, len);
+    free(want);
+    free(got);
+    return ok;
+}
+
+/* the sync port with a round trip per op */
+static flash_prog_port_t s_sync;
+
+static int sync_submit(void *arg, const flash_prog_op_t *op, uint32_t n)
+{
+    (void)arg;
+    spin_us(call_us * n);
+    return s_sync.submit(s_sync.arg, op, n);
+}
+
+static int sync_drain(void *arg)
+{
+    (void)arg;
+    return s_sync.drain(s_sync.arg);
+}
+
+/* the pipelined port: one batch in flight, a round trip per batch */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    flash_prog_op_t op[FLASH_PROG_MAX_OPS];
+    uint8_t data[FLASH_PROG_BATCH_PAGES * FLASH_PROG_PAGE];
+    uint32_t n;
+    int pending;
+    int quit;
+    int errors;
+
+    uint32_t batches;
+    uint32_t writes;
+    uint32_t die_after; /* batches until a "reset", 0 never */
+    uint32_t drop;      /* write to lose, counted from 1, 0 none */
+} e907_t;
+
+static e907_t s_e907;
+
+static void *e907_task(void *arg)
+{
+    e907_t *e = arg;
+
+    pthread_mutex_lock(&e->lock);
+    while (!e->quit) {
+        if (!e->pending) {
+            pthread_cond_wait(&e->cond, &e->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&e->lock);
+        for (uint32_t i = 0; i < e->n; i++) {
+            const flash_prog_op_t *op = &e->op[i];
+            int ret = 0;
+            if (FLASH_PROG_ERASE == op->code) {
+                ret = flash_port_erase(op->offset, op->len);
+            } else if (++e->writes != e->drop) {
+                ret = flash_port_write(op->offset, op->src, op->len);
+            }
+            e->errors += 0 != ret;
+        }
+        pthread_mutex_lock(&e->lock);
+        e->pending = 0;
+        pthread_cond_broadcast(&e->cond);
+    }
+    pthread_mutex_unlock(&e->lock);
+    return NULL;
+}
+
+static int e907_submit(void *arg, const flash_prog_op_t *op, uint32_t n)
+{
+    e907_t *e = arg;
+    uint32_t used = 0;
+
+    pthread_mutex_lock(&e->lock);
+    while (e->pending) {
+        pthread_cond_wait(&e->cond, &e->lock);
+    }
+    if (e->die_after && e->batches >= e->die_after) {
+        pthread_mutex_unlock(&e->lock);
+        return -1;
+    }
+    /* copied, as xrpc copies into the shared request buffer */
+    for (uint32_t i = 0; i < n; i++) {
+        e->op[i] = op[i];
+        if (FLASH_PROG_WRITE == op[i].code) {
+            memcpy(e->data + used, op[i].src, op[i].len);
+            e->op[i].src = e->data + used;
+            used += op[i].len;
+        }
+    }
+    e->n = n;
+    e->batches++;
+    spin_us(call_us);
+    e->pending = 1;
+    pthread_cond_broadcast(&e->cond);
+    pthread_mutex_unlock(&e->lock);
+    return 0;
+}
+
+static int e907_drain(void *arg)
+{
+    e907_t *e = arg;
+    int ret;
+
+    pthread_mutex_lock(&e->lock);
+    while (e->pending) {
+        pthread_cond_wait(&e->cond, &e->lock);
+    }
+    ret = e->errors ? -1 : 0;
+    e->errors = 0;
+    pthread_mutex_unlock(&e->lock);
+    return ret;
+}
+
+static flash_prog_t s_prog;
+
+static int run(const char *name, const flash_prog_port_t *port, uint32_t offset, uint32_t len, uint32_t tag,
+               uint32_t journal, int *resumed)
+{
+    flash_prog_t *p = &s_prog;
+    uint64_t t0 = now_us();
+
+    *resumed = flash_prog_begin(p, flash_io_get(), port, offset, len, tag, journal, pattern_src, &tag);
+    if (*resumed < 0) {
+        return -1;
+    }
+    int ret = flash_prog_run(p);
+    uint64_t us = now_us() - t0 + 1;
+    printf("%-10s %s, %u of %u regions (%d resumed), %u KB in %.2f s, %.1f KB/s, %u batches, %u retries\n", name,
+           0 == ret ? "ok" : "failed", p->programmed, p->regions, *resumed, (uint32_t)(p->bytes >> 10), us / 1e6,
+           p->bytes * 1e6 / 1024 / us, p->batches, p->retries);
+    return ret;
+}
+
+static void image(const flash_prog_port_t *sync, const flash_prog_port_t *pipe)
+{
+    int resumed;
+
+    CHECK(0 == run("pipelined", pipe, IMAGE_OFFSET, IMAGE_LEN, 1, JOURNAL, &resumed), "image: pipelined run");
+    CHECK(0 == resumed && 0 == s_prog.retries, "image: pipelined %d resumed, %u retries", resumed, s_prog.retries);
+    CHECK(image_ok(IMAGE_OFFSET, IMAGE_LEN, 1), "image: pipelined image differs");
+
+    CHECK(0 == run("sync", sync, IMAGE_OFFSET, IMAGE_LEN, 2, JOURNAL, &resumed), "image: sync run");
+    CHECK(0 == resumed && 0 == s_prog.retries, "image: sync %d resumed, %u retries", resumed, s_prog.retries);
+    CHECK(image_ok(IMAGE_OFFSET, IMAGE_LEN, 2), "image: sync image differs");
+
+    CHECK(0 == run("low", pipe, LOW_OFFSET, 200 * 1024, 3, FLASH_PROG_NO_JOURNAL, &resumed), "image: unmapped run");
+    CHECK(image_ok(LOW_OFFSET, 200 * 1024, 3), "image: unmapped image differs");
+}
+
+static void reset(const flash_prog_port_t *pipe)
+{
+    flash_prog_t *p = &s_prog;
+    int resumed;
+
+    s_e907.die_after = s_e907.batches + 100; /* a few regions in */
+    CHECK(0 != run("reset", pipe, IMAGE_OFFSET, IMAGE_LEN, 4, JOURNAL, &resumed), "reset: run survived the reset");
+    uint32_t before = p->programmed;
+    s_e907.die_after = 0;
+
+    CHECK(0 == run("resume", pipe, IMAGE_OFFSET, IMAGE_LEN, 4, JOURNAL, &resumed), "reset: resumed run");
+    CHECK(before > 0 && (uint32_t)resumed == before, "reset: %d regions resumed, %u were done", resumed, before);
+    CHECK(p->programmed == p->regions - resumed, "reset: programmed %u after resuming %d", p->programmed, resumed);
+    CHECK(image_ok(IMAGE_OFFSET, IMAGE_LEN, 4), "reset: image differs after resuming");
+
+    CHECK(0 == run("done", pipe, IMAGE_OFFSET, IMAGE_LEN, 4, JOURNAL, &resumed), "done: run");
+    CHECK((uint32_t)resumed == p->regions && 0 == p->bytes, "done: %d resumed, %llu bytes written", resumed,
+          (unsigned long long)p->bytes);
+}
+
+static void dropped(const flash_prog_port_t *pipe)
+{
+    int resumed;
+
+    s_e907.drop = s_e907.writes + 300;
+    CHECK(0 == run("dropped", pipe, IMAGE_OFFSET, 256 * 1024, 5, JOURNAL, &resumed), "dropped: run");
+    CHECK(1 == s_prog.retries, "dropped: %u retries", s_prog.retries);
+    CHECK(image_ok(IMAGE_OFFSET, 256 * 1024, 5), "dropped: image differs");
+    s_e907.drop = 0;
+}
+
+static void journal(const flash_prog_port_t *sync)
+{
+    flash_io_t *io = flash_io_get();
+    uint32_t hdr[4] = {0xffffffff, IMAGE_OFFSET, 64 * 1024, 6};
+    uint32_t saved = src_us;
+    int resumed;
+
+    src_us = 0;
+    /* a reset between the image fields and the magic, every bit of the bitmap cleared */
+    flash_io_erase(io, JOURNAL, FLASH_IO_SECTOR);
+    flash_io_write(io, JOURNAL, hdr, sizeof(hdr));
+    flash_io_write(io, JOURNAL + sizeof(hdr), "\0\0\0\0", 4);
+    CHECK(0 == run("no magic", sync, IMAGE_OFFSET, 64 * 1024, 6, JOURNAL, &resumed) && 0 == resumed,
+          "journal: header without magic resumed %d", resumed);
+    CHECK(0 == run("other", sync, IMAGE_OFFSET, 64 * 1024, 7, JOURNAL, &resumed) && 0 == resumed,
+          "journal: another image's journal resumed %d", resumed);
+    CHECK(image_ok(IMAGE_OFFSET, 64 * 1024, 7), "journal: image differs");
+    src_us = saved;
+}
+
+static void args(const flash_prog_port_t *sync)
+{
+    flash_prog_t *p = &s_prog;
+    uint32_t tag = 8;
+
+    CHECK(0 > flash_prog_begin(p, flash_io_get(), sync, IMAGE_OFFSET + 256, 4096, tag, JOURNAL, pattern_src, &tag),
+          "args: unaligned offset");
+    CHECK(0 > flash_prog_begin(p, flash_io_get(), sync, IMAGE_OFFSET, 0, tag, JOURNAL, pattern_src, &tag),
+          "args: empty image");
+    CHECK(0 > flash_prog_begin(p, flash_io_get(), sync, IMAGE_OFFSET, 8192 + 1, tag, IMAGE_OFFSET + 8192,
+                               pattern_src, &tag),
+          "args: journal in the image's last sector");
+    CHECK(0 > flash_prog_begin(p, flash_io_get(), sync, IMAGE_OFFSET, 4096, tag, JOURNAL + 1, pattern_src, &tag),
+          "args: unaligned journal");
+    CHECK(0 > flash_prog_begin(p, flash_io_get(), sync, 0, (FLASH_PROG_MAX_REGIONS + 1) * FLASH_PROG_REGION, tag,
+                               FLASH_PROG_NO_JOURNAL, pattern_src, &tag),
+          "args: image over %u regions", FLASH_PROG_MAX_REGIONS);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-o flash.bin] [-x time divisor] [-c page us] [-p call us] [-k]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = "/tmp/flash_prog_check.bin";
+    uint32_t scale = 10;
+    int keep = 0, opt;
+
+    while ((opt = getopt(argc, argv, "o:x:c:p:kh")) != -1) {
+        switch (opt) {
+            case 'o':
+                path = optarg;
+                break;
+            case 'x':
+                scale = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                src_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                call_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keep = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (0 == scale) {
+        usage(argv[0]);
+        return 2;
+    }
+    unlink(path);
+    if (0 != flash_file_open(path, FLASH_SIZE)) {
+        return 1;
+    }
+    flash_file.sector_erase_us = 45000 / scale;
+    flash_file.block_erase_us = 150000 / scale;
+    flash_file.page_us = 700 / scale;
+
+    flash_prog_port_t sync = {sync_submit, sync_drain, NULL};
+    flash_prog_port_t pipe = {e907_submit, e907_drain, &s_e907};
+    flash_prog_port_sync(&s_sync, flash_io_get());
+    pthread_mutex_init(&s_e907.lock, NULL);
+    pthread_cond_init(&s_e907.cond, NULL);
+    pthread_create(&s_e907.thread, NULL, e907_task, &s_e907);
+
+    image(&sync, &pipe);
+    reset(&pipe);
+    dropped(&pipe);
+    journal(&sync);
+    args(&sync);
+
+    pthread_mutex_lock(&s_e907.lock);
+    s_e907.quit = 1;
+    pthread_cond_broadcast(&s_e907.cond);
+    pthread_mutex_unlock(&s_e907.lock);
+    pthread_join(s_e907.thread, NULL);
+
+    flash_file_close();
+    if (!keep) {
+        unlink(path);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
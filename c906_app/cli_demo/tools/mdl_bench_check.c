@@ -0,0 +1,290 @@
+/*
+ * mdl_bench_check - mdl_bench.c against a fake backend and a fake clock.
+ *
+ * The backend stands in for blai_startCompute(): every run advances the
+ * clock by a latency drawn for it and reports a checksum, both scripted, so
+ * every statistic is known in advance.
+ *
+ *   stats      random latencies, iteration and warmup counts: min, max,
+ *              avg, p50 and p99 against a sorted copy (nearest rank),
+ *              total, done, and warmup runs neither timed nor counted
+ *   ranks      the p50 and p99 of 1..100, 1..1000 and a single run
+ *   checksum   outputs changing on chosen runs: the reference is the last
+ *              warmup run's, or the first timed one's without warmup, and
+ *              every other output is one mismatch
+ *   errors     a run failing in warmup or on run k: its status returned,
+ *              the k runs before it kept and their statistics filled in
+ *   fnv        mdl_bench_checksum() against the FNV-1a test vectors
+ *
+ * mdl_bench.c has no SDK dependency and builds as it is.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -o mdl_bench_check mdl_bench_check.c ../mdl_bench.c
+ *   ./mdl_bench_check -n 2000
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mdl_bench.h"
+
+#define MAX_RUNS (1200)
+
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+/* the fake backend: run i takes lat[i] us, outputs sum[i], returns ret[i] */
+typedef struct {
+    uint32_t lat[MAX_RUNS];
+    uint32_t sum[MAX_RUNS];
+    int ret[MAX_RUNS];
+    uint32_t calls;
+} fake_t;
+
+static uint64_t s_clock;
+static uint32_t s_clock_reads;
+
+static uint64_t fake_now_us(void)
+{
+    s_clock_reads++;
+    return s_clock;
+}
+
+static int fake_run(void *arg, uint32_t *checksum)
+{
+    fake_t *f = arg;
+    uint32_t i = f->calls++;
+
+    s_clock += f->lat[i];
+    *checksum = f->sum[i];
+    return f->ret[i];
+}
+
+static void fake_reset(fake_t *f)
+{
+    memset(f, 0, sizeof(*f));
+    s_clock = 1000000 + xorshift(&seed); /* anywhere, only differences count */
+    s_clock_reads = 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* what the statistics of the runs that took lat[0..n) must be */
+static void check_stats(const char *what, const mdl_bench_t *b, const uint32_t *lat, uint32_t n)
+{
+    static uint32_t sorted[MAX_RUNS];
+    uint64_t total = 0;
+
+    CHECK(b->done == n, "%s: done %u, want %u", what, b->done, n);
+    if (0 == n) {
+        CHECK(0 == b->min_us && 0 == b->max_us && 0 == b->avg_us && 0 == b->p50_us && 0 == b->p99_us,
+              "%s: statistics of no runs not 0", what);
+        return;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        total += lat[i];
+        CHECK(b->samples_us[i] == lat[i], "%s: sample %u is %u, the run took %u", what, i, b->samples_us[i], lat[i]);
+    }
+    memcpy(sorted, lat, n * sizeof(uint32_t));
+    qsort(sorted, n, sizeof(uint32_t), cmp_u32);
+
+    /* nearest rank: the smallest sample with at least pct% of them at or below it */
+    uint32_t p50 = sorted[(n * 50 + 99) / 100 - 1], p99 = sorted[(n * 99 + 99) / 100 - 1];
+    CHECK(b->total_us == total, "%s: total %llu, want %llu", what, (unsigned long long)b->total_us,
+          (unsigned long long)total);
+    CHECK(b->min_us == sorted[0] && b->max_us == sorted[n - 1], "%s: min %u max %u, want %u %u", what, b->min_us,
+          b->max_us, sorted[0], sorted[n - 1]);
+    CHECK(b->avg_us == total / n, "%s: avg %u, want %llu", what, b->avg_us, (unsigned long long)(total / n));
+    CHECK(b->p50_us == p50 && b->p99_us == p99, "%s: p50 %u p99 %u, want %u %u of %u runs", what, b->p50_us,
+          b->p99_us, p50, p99, n);
+}
+
+static void check_random(uint32_t rounds)
+{
+    static fake_t f;
+    static uint32_t samples[MAX_RUNS];
+
+    for (uint32_t r = 0; r < rounds; r++) {
+        fake_reset(&f);
+        mdl_bench_t b = {
+            .iters = xorshift(&seed) % (MAX_RUNS - 100),
+            .warmup = xorshift(&seed) % 8,
+            .samples_us = samples,
+        };
+        for (uint32_t i = 0; i < b.iters + b.warmup; i++) {
+            /* a model's latency: a base, jitter and now and then a long stall */
+            f.lat[i] = 5000 + xorshift(&seed) % 300 + (0 == xorshift(&seed) % 50 ? xorshift(&seed) % 100000 : 0);
+            f.sum[i] = 0xabcd;
+        }
+
+        int ret = mdl_bench_run(&b, fake_run, &f, fake_now_us);
+        CHECK(0 == ret, "stats: returned %d", ret);
+        CHECK(f.calls == b.warmup + b.iters, "stats: %u calls for %u warmup and %u runs", f.calls, b.warmup,
+              b.iters);
+        CHECK(s_clock_reads == 2 * b.iters, "stats: clock read %u times for %u runs", s_clock_reads, b.iters);
+        CHECK(0 == b.checksum_mismatch && (0 == f.calls || 0xabcd == b.ref_checksum), "stats: %u mismatches, ref %08x",
+              b.checksum_mismatch, b.ref_checksum);
+        check_stats("stats", &b, f.lat + b.warmup, b.iters);
+    }
+}
+
+static void check_ranks(void)
+{
+    static fake_t f;
+    static uint32_t samples[MAX_RUNS];
+    const struct {
+        uint32_t n, p50, p99;
+    } cases[] = {{100, 50, 99}, {1000, 500, 990}, {1, 1, 1}, {2, 1, 2}};
+
+    for (uint32_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        fake_reset(&f);
+        mdl_bench_t b = {.iters = cases[c].n, .samples_us = samples};
+        /* 1..n in a shuffled order */
+        for (uint32_t i = 0; i < cases[c].n; i++) {
+            f.lat[i] = i + 1;
+        }
+        for (uint32_t i = cases[c].n; i > 1; i--) {
+            uint32_t j = xorshift(&seed) % i, t = f.lat[i - 1];
+            f.lat[i - 1] = f.lat[j];
+            f.lat[j] = t;
+        }
+        mdl_bench_run(&b, fake_run, &f, fake_now_us);
+        CHECK(b.p50_us == cases[c].p50 && b.p99_us == cases[c].p99, "ranks: 1..%u gave p50 %u p99 %u, want %u %u",
+              cases[c].n, b.p50_us, b.p99_us, cases[c].p50, cases[c].p99);
+        CHECK(1 == b.min_us && cases[c].n == b.max_us, "ranks: 1..%u gave min %u max %u", cases[c].n, b.min_us,
+              b.max_us);
+    }
+}
+
+static void check_checksum(uint32_t rounds)
+{
+    static fake_t f;
+    static uint32_t samples[MAX_RUNS];
+
+    for (uint32_t r = 0; r < rounds; r++) {
+        fake_reset(&f);
+        mdl_bench_t b = {
+            .iters = 1 + xorshift(&seed) % 200,
+            .warmup = xorshift(&seed) % 3,
+            .samples_us = samples,
+        };
+        uint32_t n = b.warmup + b.iters, ref = xorshift(&seed), want = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            f.lat[i] = 100;
+            /* warmup outputs may differ, the NPU settles: only the last one is the reference */
+            f.sum[i] = i < b.warmup - 1 + (0 == b.warmup) ? xorshift(&seed) : ref;
+        }
+        for (uint32_t i = b.warmup + (0 == b.warmup); i < n; i++) {
+            if (0 == xorshift(&seed) % 8) {
+                f.sum[i] = ref ^ (1 + xorshift(&seed) % 0xffff);
+                want++;
+            }
+        }
+
+        mdl_bench_run(&b, fake_run, &f, fake_now_us);
+        CHECK(b.ref_checksum == ref, "checksum: reference %08x, want %08x (warmup %u)", b.ref_checksum, ref,
+              b.warmup);
+        CHECK(b.checksum_mismatch == want, "checksum: %u mismatches, want %u of %u runs (warmup %u)",
+              b.checksum_mismatch, want, b.iters, b.warmup);
+    }
+}
+
+static void check_errors(uint32_t rounds)
+{
+    static fake_t f;
+    static uint32_t samples[MAX_RUNS];
+
+    for (uint32_t r = 0; r < rounds; r++) {
+        fake_reset(&f);
+        mdl_bench_t b = {
+            .iters = 1 + xorshift(&seed) % 300,
+            .warmup = xorshift(&seed) % 4,
+            .samples_us = samples,
+        };
+        uint32_t n = b.warmup + b.iters, bad = xorshift(&seed) % n;
+        for (uint32_t i = 0; i < n; i++) {
+            f.lat[i] = 1 + xorshift(&seed) % 10000;
+        }
+        f.ret[bad] = -1 - (int)(xorshift(&seed) % 100);
+
+        int ret = mdl_bench_run(&b, fake_run, &f, fake_now_us);
+        CHECK(ret == f.ret[bad], "errors: returned %d, run %u failed with %d", ret, bad, f.ret[bad]);
+        CHECK(f.calls == bad + 1, "errors: %u calls, run %u failed", f.calls, bad);
+        uint32_t kept = bad < b.warmup ? 0 : bad - b.warmup;
+        check_stats("errors", &b, f.lat + b.warmup, kept);
+    }
+}
+
+static void check_fnv(void)
+{
+    const struct {
+        const char *s;
+        uint32_t h;
+    } vectors[] = {{"", 0x811c9dc5}, {"a", 0xe40c292c}, {"foobar", 0xbf9cf968}};
+
+    for (uint32_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        uint32_t h = mdl_bench_checksum((const uint8_t *)vectors[i].s, strlen(vectors[i].s));
+        CHECK(h == vectors[i].h, "fnv: \"%s\" gave %08x, want %08x", vectors[i].s, h, vectors[i].h);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rounds = 500;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                printf("Usage: %s [-n rounds] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        printf("seed must be > 0\n");
+        return 2;
+    }
+
+    check_random(rounds);
+    check_ranks();
+    check_checksum(rounds);
+    check_errors(rounds);
+    check_fnv();
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
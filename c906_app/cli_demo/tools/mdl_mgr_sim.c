@@ -0,0 +1,688 @@
+/*
+ * mdl_mgr_sim - mdl_mgr.c on Linux with a reference CPU backend in place of the NPU.
+ *
+ * mdl_mgr.c is built as it is against the stand-ins in sdk/: FreeRTOS
+ * over pthreads, romfs over in-memory model images, and libblai as a CPU
+ * backend. A model image here is a small header (input shape, classes,
+ * the activation bytes blai allocates, the NPU's time per inference) and
+ * int8 weights of one fully connected layer; blai_load_model_from_buffer()
+ * allocates the activations from the counting heap behind
+ * xPortGetFreeHeapSize() and reads the weights in place, as libblai does
+ * from XIP, and blai_startCompute() computes the layer into the arena and
+ * takes the NPU's time.
+ *
+ *   memory     all models loaded at once, as separate demos would hold
+ *              them, against the manager's own high water mark over the
+ *              whole run: one model's arena at most
+ *   order      the resident model runs ahead of an older request of the
+ *              same priority MDL_MGR_MAX_BYPASS times, then the older one
+ *              runs; a higher priority request runs next
+ *   errors     a model whose image does not load completes each of its
+ *              requests with status -1, and the rest keep running
+ *   load       -n random requests to random models, random inputs, paced
+ *              by -g: every one completes once, with the output the
+ *              reference computes from its input, and the per model
+ *              latency is reported
+ *
+ * NPU times are the model's header divided by -x.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -pthread -I.. -Isdk -o mdl_mgr_sim mdl_mgr_sim.c ../mdl_mgr.c
+ *   ./mdl_mgr_sim -n 5000 -x 4
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* the stand-ins of sdk/ */
+#include <FreeRTOS.h>
+#include <bl808_glb.h>
+#include <blai_core.h>
+#include <fs/vfs_romfs.h>
+#include <vfs.h>
+
+#include "mdl_mgr.h"
+
+/* the real ones from here on, the counting heap is built on them */
+#undef malloc
+#undef free
+
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+
+#define HEAP_SIZE (16u * 1024 * 1024)
+#define SIM_MAGIC (0x4d49534du)
+#define PATCH (4096)
+#define MAX_REQS (65536)
+
+static uint32_t requests = 2000, gap_us = 300, speed = 4;
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+/* ---- FreeRTOS and the heap ---- */
+
+static pthread_mutex_t s_critical = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t s_heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t s_heap_used, s_heap_peak;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int given;
+} host_sem_t;
+
+void host_enter_critical(void)
+{
+    pthread_mutex_lock(&s_critical);
+}
+
+void host_exit_critical(void)
+{
+    pthread_mutex_unlock(&s_critical);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    host_sem_t *sem = calloc(1, sizeof(*sem));
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    return sem;
+}
+
+int xSemaphoreTake(SemaphoreHandle_t handle, uint32_t ticks)
+{
+    host_sem_t *sem = handle;
+    (void)ticks;
+    pthread_mutex_lock(&sem->lock);
+    while (!sem->given) {
+        pthread_cond_wait(&sem->cond, &sem->lock);
+    }
+    sem->given = 0;
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+int xSemaphoreGive(SemaphoreHandle_t handle)
+{
+    host_sem_t *sem = handle;
+    pthread_mutex_lock(&sem->lock);
+    sem->given = 1;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t handle)
+{
+    free(handle);
+}
+
+typedef struct {
+    TaskFunction_t fn;
+    void *arg;
+} host_task_t;
+
+static void *task_main(void *p)
+{
+    host_task_t t = *(host_task_t *)p;
+    free(p);
+    t.fn(t.arg);
+    return NULL;
+}
+
+int xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, int prio, void *handle)
+{
+    pthread_t th;
+    host_task_t *t = malloc(sizeof(*t));
+    (void)name;
+    (void)stack;
+    (void)prio;
+    (void)handle;
+    t->fn = fn;
+    t->arg = arg;
+    if (0 != pthread_create(&th, NULL, task_main, t)) {
+        free(t);
+        return 0;
+    }
+    pthread_detach(th);
+    return pdPASS;
+}
+
+/* the counting heap, a size word in front of every block */
+void *host_malloc(size_t n)
+{
+    size_t *p = NULL;
+
+    pthread_mutex_lock(&s_heap_lock);
+    if (s_heap_used + n <= HEAP_SIZE && NULL != (p = malloc(sizeof(size_t) + n))) {
+        *p++ = n;
+        s_heap_used += n;
+        if (s_heap_used > s_heap_peak) s_heap_peak = s_heap_used;
+    }
+    pthread_mutex_unlock(&s_heap_lock);
+    return p;
+}
+
+void host_free(void *ptr)
+{
+    if (NULL == ptr) {
+        return;
+    }
+    size_t *p = (size_t *)ptr - 1;
+    pthread_mutex_lock(&s_heap_lock);
+    s_heap_used -= *p;
+    pthread_mutex_unlock(&s_heap_lock);
+    free(p);
+}
+
+size_t xPortGetFreeHeapSize(void)
+{
+    pthread_mutex_lock(&s_heap_lock);
+    size_t free_bytes = HEAP_SIZE - s_heap_used;
+    pthread_mutex_unlock(&s_heap_lock);
+    return free_bytes;
+}
+
+static size_t heap_reset_peak(void)
+{
+    pthread_mutex_lock(&s_heap_lock);
+    s_heap_peak = s_heap_used;
+    size_t used = s_heap_used;
+    pthread_mutex_unlock(&s_heap_lock);
+    return used;
+}
+
+uint64_t CPU_Get_MTimer_US(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* ---- romfs: the model images, each at its own path ---- */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t w, h, c;
+    uint32_t classes;
+    uint32_t arena;      /* activation bytes blai allocates */
+    uint32_t compute_us; /* the NPU's time for one inference */
+    int8_t weights[];    /* classes x w * h * c */
+} sim_image_t;
+
+typedef struct {
+    const char *path;
+    uint8_t priority;
+    uint32_t w, h, c, classes, arena, compute_us;
+    int broken;
+    sim_image_t *image;
+    int id;
+} sim_model_t;
+
+enum { SMALL, BIG, URGENT, BROKEN, MODELS }; /* MDL_MGR_MAX_MODELS */
+
+static sim_model_t s_sim[MODELS] = {
+    [SMALL] = {"/romfs/models/small.blai", 0, 28, 28, 1, 10, 256 * 1024, 400},
+    [BIG] = {"/romfs/models/big.blai", 0, 64, 64, 3, 20, 1536 * 1024, 2400},
+    [URGENT] = {"/romfs/models/urgent.blai", 2, 16, 16, 1, 2, 128 * 1024, 200},
+    [BROKEN] = {"/romfs/models/broken.blai", 0, 16, 16, 1, 2, 64 * 1024, 100, 1},
+};
+
+static uint32_t input_size(const sim_model_t *m)
+{
+    return m->w * m->h * (1 == m->c ? 1 : ALIGNUP(m->c, 4));
+}
+
+static void make_images(void)
+{
+    for (int i = 0; i < MODELS; i++) {
+        sim_model_t *m = &s_sim[i];
+        uint32_t n = m->classes * input_size(m);
+        m->image = calloc(1, sizeof(sim_image_t) + n);
+        m->image->magic = m->broken ? 0 : SIM_MAGIC;
+        m->image->w = m->w;
+        m->image->h = m->h;
+        m->image->c = m->c;
+        m->image->classes = m->classes;
+        m->image->arena = m->arena;
+        m->image->compute_us = m->compute_us;
+        for (uint32_t k = 0; k < n; k++) {
+            m->image->weights[k] = (int8_t)xorshift(&seed);
+        }
+    }
+}
+
+int aos_open(const char *path, int flags)
+{
+    (void)flags;
+    for (int i = 0; i < MODELS; i++) {
+        if (0 == strcmp(path, s_sim[i].path)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int aos_close(int fd)
+{
+    (void)fd;
+    return 0;
+}
+
+int aos_read(int fd, void *buf, size_t nbytes)
+{
+    (void)fd;
+    (void)buf;
+    (void)nbytes;
+    return -1;
+}
+
+long aos_lseek(int fd, long offset, int whence)
+{
+    (void)fd;
+    (void)offset;
+    (void)whence;
+    return -1;
+}
+
+int aos_ioctl(int fd, int cmd, unsigned long arg)
+{
+    if (fd < 0 || fd >= MODELS || IOCTL_ROMFS_GET_FILEBUF != cmd) {
+        return -1;
+    }
+    romfs_filebuf_t *filebuf = (romfs_filebuf_t *)arg;
+    filebuf->buf = (char *)s_sim[fd].image;
+    filebuf->bufsize = sizeof(sim_image_t) + s_sim[fd].classes * input_size(&s_sim[fd]);
+    return 0;
+}
+
+/* ---- libblai: the reference CPU backend ---- */
+
+typedef struct {
+    BLAI_Model_t model;
+    struct blai_net_info_t net;
+    struct blai_layer_t layer;
+    const sim_image_t *image;
+} host_model_t;
+
+static pthread_mutex_t s_npu_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_npu_cond = PTHREAD_COND_INITIALIZER;
+static int s_npu_paused, s_npu_busy;
+
+static void npu_pause(void)
+{
+    pthread_mutex_lock(&s_npu_lock);
+    s_npu_paused = 1;
+    pthread_mutex_unlock(&s_npu_lock);
+}
+
+static void npu_resume(void)
+{
+    pthread_mutex_lock(&s_npu_lock);
+    s_npu_paused = 0;
+    pthread_cond_broadcast(&s_npu_cond);
+    pthread_mutex_unlock(&s_npu_lock);
+}
+
+/* until an inference is held by the pause */
+static void npu_wait_busy(void)
+{
+    pthread_mutex_lock(&s_npu_lock);
+    while (!s_npu_busy) {
+        pthread_cond_wait(&s_npu_cond, &s_npu_lock);
+    }
+    pthread_mutex_unlock(&s_npu_lock);
+}
+
+static uint32_t output_offset(const sim_image_t *img)
+{
+    return ALIGNUP(img->w * img->h * (1 == img->c ? 1 : ALIGNUP(img->c, 4)), PATCH);
+}
+
+BLAI_Model_t *blai_create(void)
+{
+    host_model_t *m = host_malloc(sizeof(*m));
+    if (NULL == m) {
+        return NULL;
+    }
+    memset(m, 0, sizeof(*m));
+    m->model.net = &m->net;
+    return &m->model;
+}
+
+int blai_load_model_from_buffer(BLAI_Model_t *model, uint8_t *bin)
+{
+    host_model_t *m = (host_model_t *)model;
+    const sim_image_t *img = (const sim_image_t *)bin;
+
+    if (SIM_MAGIC != img->magic || output_offset(img) + img->classes > img->arena) {
+        return -1;
+    }
+    if (NULL == (m->model.buffer = host_malloc(img->arena))) {
+        return -1;
+    }
+    /* blai writes the whole arena while loading, so it is really there */
+    memset(m->model.buffer, 0, img->arena);
+    m->image = img;
+    m->net.w = img->w;
+    m->net.h = img->h;
+    m->net.c = img->c;
+    m->net.layer_cnt = 1;
+    m->net.patch_size = PATCH;
+    m->net.layers = &m->layer;
+    m->layer.out_h = 1;
+    m->layer.out_w = 1;
+    m->layer.out_c = img->classes;
+    m->layer.out_layer_mem = output_offset(img) / PATCH;
+    m->layer.output_scale = 1.0f / 16;
+    m->layer.tf_output_offset = -128;
+    return BLAI_STATUS_NO_ERROR;
+}
+
+void blai_npu_initCfg(BLAI_Model_t *model)
+{
+    (void)model;
+}
+
+uint8_t *blai_getInputBuffer(BLAI_Model_t *model)
+{
+    return model->buffer;
+}
+
+/* one fully connected layer, the reference both the backend and the check use */
+static void reference(const sim_image_t *img, const uint8_t *in, uint8_t *out)
+{
+    uint32_t n = img->w * img->h * (1 == img->c ? 1 : ALIGNUP(img->c, 4));
+    for (uint32_t k = 0; k < img->classes; k++) {
+        int32_t acc = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            acc += (int32_t)in[i] * img->weights[k * n + i];
+        }
+        acc = 128 + acc / 4096;
+        out[k] = (uint8_t)(acc < 0 ? 0 : acc > 255 ? 255 : acc);
+    }
+}
+
+void blai_startCompute(BLAI_Model_t *model)
+{
+    host_model_t *m = (host_model_t *)model;
+
+    pthread_mutex_lock(&s_npu_lock);
+    s_npu_busy = 1;
+    pthread_cond_broadcast(&s_npu_cond);
+    while (s_npu_paused) {
+        pthread_cond_wait(&s_npu_cond, &s_npu_lock);
+    }
+    s_npu_busy = 0;
+    pthread_mutex_unlock(&s_npu_lock);
+
+    reference(m->image, m->model.buffer, m->model.buffer + m->layer.out_layer_mem * PATCH);
+    usleep(m->image->compute_us / speed);
+}
+
+void blai_free(BLAI_Model_t *model)
+{
+    host_model_t *m = (host_model_t *)model;
+    if (NULL == m) {
+        return;
+    }
+    host_free(m->model.buffer);
+    host_free(m);
+}
+
+/* ---- requests ---- */
+
+typedef struct {
+    int model; /* index in s_sim */
+    uint8_t *input;
+    int done;
+    int status;
+    uint32_t order; /* completions before this one */
+    int output_ok;
+} sim_req_t;
+
+static sim_req_t s_reqs[MAX_REQS];
+static uint32_t s_req_cnt;
+static pthread_mutex_t s_done_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_done_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t s_done, s_twice;
+
+static void done_cb(int id, const mdl_mgr_result_t *result, void *arg)
+{
+    sim_req_t *r = arg;
+    const sim_model_t *m = &s_sim[r->model];
+
+    r->status = result->status;
+    if (0 == result->status) {
+        uint8_t expect[64];
+        reference(m->image, r->input, expect);
+        r->output_ok = id == m->id && (1 == m->classes ? 1 : ALIGNUP(m->classes, 4)) == result->output_size &&
+                       0 == memcmp(expect, result->output, m->classes);
+    }
+    pthread_mutex_lock(&s_done_lock);
+    if (r->done) s_twice++;
+    r->done = 1;
+    r->order = s_done++;
+    pthread_cond_broadcast(&s_done_cond);
+    pthread_mutex_unlock(&s_done_lock);
+}
+
+static sim_req_t *submit(int model)
+{
+    sim_req_t *r = &s_reqs[s_req_cnt++];
+    const sim_model_t *m = &s_sim[model];
+    uint32_t size = input_size(m);
+
+    memset(r, 0, sizeof(*r));
+    r->model = model;
+    r->input = malloc(size);
+    for (uint32_t i = 0; i < size; i++) {
+        r->input[i] = (uint8_t)xorshift(&seed);
+    }
+    while (0 != mdl_mgr_submit(m->id, r->input, size, done_cb, r)) {
+        usleep(100); /* queue full */
+    }
+    return r;
+}
+
+/* until every request completed, or 10 s without one doing so; returns how many never did */
+static uint32_t wait_all(void)
+{
+    uint32_t last = UINT32_MAX;
+
+    pthread_mutex_lock(&s_done_lock);
+    while (s_done < s_req_cnt && s_done != last) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += 10;
+        last = s_done;
+        while (s_done == last && s_done < s_req_cnt) {
+            if (0 != pthread_cond_timedwait(&s_done_cond, &s_done_lock, &ts)) {
+                break;
+            }
+        }
+    }
+    uint32_t lost = s_req_cnt - s_done;
+    pthread_mutex_unlock(&s_done_lock);
+    return lost;
+}
+
+/* checks the requests from first on and starts over */
+static void settle(const char *phase, uint32_t first)
+{
+    uint32_t bad = 0, errors = 0;
+    uint32_t lost = wait_all();
+
+    CHECK(0 == lost, "%s: %u requests never completed", phase, lost);
+    if (lost) {
+        printf("%u checks, %u failed\n", checks, failed);
+        exit(1);
+    }
+    for (uint32_t i = first; i < s_req_cnt; i++) {
+        sim_req_t *r = &s_reqs[i];
+        if (s_sim[r->model].broken) {
+            errors += 0 == r->status;
+        } else {
+            bad += 0 != r->status || !r->output_ok;
+        }
+    }
+    CHECK(0 == bad, "%s: %u requests failed or got a wrong output", phase, bad);
+    CHECK(0 == errors, "%s: %u requests of the broken model did not fail", phase, errors);
+    CHECK(0 == s_twice, "%s: %u requests completed twice", phase, s_twice);
+}
+
+static void check_order(void)
+{
+    uint32_t first = s_req_cnt, base = s_done;
+
+    /* small resident, busy; then one big, MAX_BYPASS + 4 small */
+    npu_pause();
+    sim_req_t *a0 = submit(SMALL);
+    npu_wait_busy();
+    sim_req_t *b0 = submit(BIG);
+    for (int i = 0; i < MDL_MGR_MAX_BYPASS + 4; i++) {
+        submit(SMALL);
+    }
+    npu_resume();
+    settle("order", first);
+    CHECK(0 == a0->order - base, "order: the busy request finished %u-th", a0->order - base);
+    CHECK(1 + MDL_MGR_MAX_BYPASS == b0->order - base, "order: big ran %u-th, after %u smalls submitted after it",
+          b0->order - base, b0->order - base - 1);
+
+    /* a higher priority request goes first */
+    first = s_req_cnt;
+    base = s_done;
+    npu_pause();
+    submit(SMALL);
+    npu_wait_busy();
+    submit(BIG);
+    sim_req_t *u0 = submit(URGENT);
+    npu_resume();
+    settle("order", first);
+    CHECK(1 == u0->order - base, "order: urgent ran %u-th", u0->order - base);
+}
+
+static void check_errors(void)
+{
+    uint32_t first = s_req_cnt;
+    const mdl_mgr_model_t *broken = mdl_mgr_get(s_sim[BROKEN].id);
+    uint32_t before = broken->errors;
+
+    submit(BROKEN);
+    submit(SMALL);
+    submit(BROKEN);
+    submit(BIG);
+    settle("errors", first);
+    CHECK(before + 2 == broken->errors, "errors: %u errors counted for 2 failed loads", broken->errors - before);
+}
+
+static void check_load(void)
+{
+    uint32_t first = s_req_cnt;
+    /* now and then the broken one, it prints a line each time */
+    static const int pick[32] = {SMALL, SMALL, SMALL, SMALL, SMALL, SMALL, SMALL, SMALL, SMALL, SMALL, SMALL,
+                                 SMALL, SMALL, SMALL, BIG,   BIG,   BIG,   BIG,   BIG,   BIG,   BIG,   BIG,
+                                 BIG,   BIG,   URGENT, URGENT, URGENT, URGENT, URGENT, URGENT, URGENT, BROKEN};
+
+    for (uint32_t i = 0; i < requests && s_req_cnt < MAX_REQS; i++) {
+        submit(pick[xorshift(&seed) % (sizeof(pick) / sizeof(pick[0]))]);
+        if (gap_us) {
+            usleep(xorshift(&seed) % (2 * gap_us));
+        }
+    }
+    settle("load", first);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:g:x:s:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                requests = strtoul(optarg, NULL, 0);
+                break;
+            case 'g':
+                gap_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'x':
+                speed = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                printf("Usage: %s [-n requests] [-g gap_us] [-x speed] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed || 0 == speed) {
+        printf("seed and speed must be > 0\n");
+        return 2;
+    }
+    make_images();
+
+    /* every model loaded at once, as one demo each would hold them */
+    size_t base = heap_reset_peak();
+    BLAI_Model_t *all[MODELS] = {0};
+    size_t largest = 0;
+    for (int i = 0; i < MODELS; i++) {
+        if (s_sim[i].broken) {
+            continue;
+        }
+        size_t before = s_heap_used;
+        all[i] = blai_create();
+        CHECK(BLAI_STATUS_NO_ERROR == blai_load_model_from_buffer(all[i], (uint8_t *)s_sim[i].image),
+              "memory: %s does not load", s_sim[i].path);
+        if (s_heap_used - before > largest) largest = s_heap_used - before;
+    }
+    size_t separate = s_heap_peak - base;
+    for (int i = 0; i < MODELS; i++) {
+        blai_free(all[i]);
+    }
+
+    base = heap_reset_peak();
+    CHECK(0 == mdl_mgr_init(), "init failed");
+    for (int i = 0; i < MODELS; i++) {
+        s_sim[i].id = mdl_mgr_register(s_sim[i].path, s_sim[i].priority);
+        CHECK(s_sim[i].id >= 0, "register %s failed", s_sim[i].path);
+    }
+
+    check_order();
+    check_errors();
+    check_load();
+
+    size_t shared = s_heap_peak - base;
+    CHECK(shared == largest, "memory: the manager held %zu at most, the largest model takes %zu", shared, largest);
+
+    mdl_mgr_dump();
+    printf("%u requests, heap high water %zu bytes one model at a time vs %zu all loaded, %zu saved\n", s_req_cnt,
+           shared, separate, separate - shared);
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * host stand-in for the FreeRTOS calls mdl_mgr.c makes, implemented by the
+ * simulation over pthreads. On the board malloc is the FreeRTOS heap, here
+ * it goes to the simulation's counting heap so xPortGetFreeHeapSize() sees it.
+ */
+#ifndef __FREERTOS_H__
+#define __FREERTOS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define pdPASS (1)
+#define pdTRUE (1)
+#define portMAX_DELAY (0xffffffffu)
+
+typedef void *SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+int xSemaphoreTake(SemaphoreHandle_t sem, uint32_t ticks);
+int xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+int xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, int prio, void *handle);
+
+void host_enter_critical(void);
+void host_exit_critical(void);
+#define taskENTER_CRITICAL() host_enter_critical()
+#define taskEXIT_CRITICAL() host_exit_critical()
+
+size_t xPortGetFreeHeapSize(void);
+void *host_malloc(size_t size);
+void host_free(void *p);
+
+#define malloc(size) host_malloc(size)
+#define free(p) host_free(p)
+
+#endif /* __FREERTOS_H__ */
@@ -0,0 +1,4 @@
+/* host stand-in for aos/kernel.h */
+#ifndef __AOS_KERNEL_H__
+#define __AOS_KERNEL_H__
+#endif /* __AOS_KERNEL_H__ */
@@ -0,0 +1,9 @@
+/* host stand-in for bl808_glb.h, the machine timer */
+#ifndef __BL808_GLB_H__
+#define __BL808_GLB_H__
+
+#include <stdint.h>
+
+uint64_t CPU_Get_MTimer_US(void);
+
+#endif /* __BL808_GLB_H__ */
@@ -0,0 +1,44 @@
+/*
+ * host stand-in for what cli_demo uses of libblai's blai_core.h, the
+ * simulation implements it as a reference CPU backend
+ */
+#ifndef __BLAI_CORE_H__
+#define __BLAI_CORE_H__
+
+#include <stdint.h>
+
+#define BLAI_STATUS_NO_ERROR (0)
+
+struct blai_layer_t {
+    uint32_t out_h;
+    uint32_t out_w;
+    uint32_t out_c;
+    uint32_t out_layer_mem; /* in patches, from buffer */
+    float output_scale;
+    int tf_output_offset;
+};
+
+struct blai_net_info_t {
+    uint32_t w;
+    uint32_t h;
+    uint32_t c;
+    uint32_t layer_cnt;
+    uint32_t patch_size;
+    struct blai_layer_t *layers;
+};
+
+typedef struct {
+    struct blai_net_info_t *net;
+    uint8_t *buffer;
+} BLAI_Model_t;
+
+typedef BLAI_Model_t *blai_model_hdl_t;
+
+BLAI_Model_t *blai_create(void);
+int blai_load_model_from_buffer(BLAI_Model_t *model, uint8_t *bin);
+void blai_npu_initCfg(BLAI_Model_t *model);
+uint8_t *blai_getInputBuffer(BLAI_Model_t *model);
+void blai_startCompute(BLAI_Model_t *model);
+void blai_free(BLAI_Model_t *model);
+
+#endif /* __BLAI_CORE_H__ */
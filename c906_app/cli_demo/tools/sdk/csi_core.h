@@ -0,0 +1,8 @@
+/* host stand-in for csi_core.h, caches are coherent on the host */
+#ifndef __CSI_CORE_H__
+#define __CSI_CORE_H__
+
+#define csi_dcache_clean_range(addr, size) ((void)(addr), (void)(size))
+#define csi_dcache_invalid_range(addr, size) ((void)(addr), (void)(size))
+
+#endif /* __CSI_CORE_H__ */
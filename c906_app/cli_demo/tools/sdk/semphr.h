@@ -0,0 +1,4 @@
+/* host stand-in, the semaphores are declared in FreeRTOS.h */
+#ifndef __SEMPHR_H__
+#define __SEMPHR_H__
+#endif /* __SEMPHR_H__ */
@@ -0,0 +1,4 @@
+/* host stand-in, the task calls are declared in FreeRTOS.h */
+#ifndef __TASK_H__
+#define __TASK_H__
+#endif /* __TASK_H__ */
@@ -0,0 +1,14 @@
+/* host stand-in for the aos vfs calls, implemented by the host tool */
+#ifndef __VFS_H__
+#define __VFS_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+int aos_open(const char *path, int flags);
+int aos_close(int fd);
+int aos_read(int fd, void *buf, size_t nbytes);
+long aos_lseek(int fd, long offset, int whence);
+int aos_ioctl(int fd, int cmd, unsigned long arg);
+
+#endif /* __VFS_H__ */
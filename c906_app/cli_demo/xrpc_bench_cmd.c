@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* aos */
+#include <cli.h>
+
+/* utils */
+#include <utils_getopt.h>
+
+/* RISCV */
+#include <csi_core.h>
+
+#include "m1s_c906_xram_flash.h"
+#include "m1s_c906_xram_pwm.h"
+#include "mdl_bench.h"
+#include "xrpc_client.h"
+
+#define XBENCH_TIMEOUT_MS (1000)
+
+typedef struct {
+    xrpc_client_t *c;
+    uint32_t batch;
+    uint32_t offset;
+    uint32_t len;
+    uint8_t *buf; /* batch * len */
+    int pwm_port;
+    int pwm_pin;
+    uint32_t calls;
+} xbench_ctx_t;
+
+static xrpc_client_t s_client;
+
+static uint64_t xbench_now_us(void)
+{
+    return CPU_Get_MTimer_US();
+}
+
+/* one sample is `batch` ops either way, so per op figures compare directly */
+static int read_single(void *arg, uint32_t *checksum)
+{
+    xbench_ctx_t *x = arg;
+    for (uint32_t i = 0; i < x->batch; i++) {
+        uint8_t *dst = x->buf + i * x->len;
+        if (0 != m1s_xram_flash_read(x->offset + i * x->len, (uint32_t)(uintptr_t)dst, x->len)) {
+            return -1;
+        }
+        csi_dcache_invalid_range((void *)dst, x->len);
+    }
+    *checksum = mdl_bench_checksum(x->buf, x->batch * x->len);
+    return 0;
+}
+
+static int read_batched(void *arg, uint32_t *checksum)
+{
+    xbench_ctx_t *x = arg;
+    xrpc_batch_begin(x->c);
+    for (uint32_t i = 0; i < x->batch; i++) {
+        xrpc_batch_flash_read(x->c, x->offset + i * x->len, x->len);
+    }
+    if (0 != xrpc_batch_submit(x->c, 0, XBENCH_TIMEOUT_MS)) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < x->batch; i++) {
+        if (0 != xrpc_batch_result(x->c, i, x->buf + i * x->len, x->len)) {
+            return -1;
+        }
+    }
+    *checksum = mdl_bench_checksum(x->buf, x->batch * x->len);
+    return 0;
+}
+
+static int nop_batched(void *arg, uint32_t *checksum)
+{
+    xbench_ctx_t *x = arg;
+    xrpc_batch_begin(x->c);
+    for (uint32_t i = 0; i < x->batch; i++) {
+        xrpc_batch_nop(x->c);
+    }
+    *checksum = 0;
+    return xrpc_batch_submit(x->c, 0, XBENCH_TIMEOUT_MS);
+}
+
+/* duty walks 10..90 so every call really changes something */
+static uint8_t next_duty(xbench_ctx_t *x)
+{
+    return 10 + (x->calls++ % 81);
+}
+
+static int pwm_single(void *arg, uint32_t *checksum)
+{
+    xbench_ctx_t *x = arg;
+    for (uint32_t i = 0; i < x->batch; i++) {
+        if (0 != m1s_xram_pwm_set_duty(x->pwm_port, x->pwm_pin, 2000, next_duty(x))) {
+            return -1;
+        }
+    }
+    *checksum = 0;
+    return 0;
+}
+
+static int pwm_forget(void *arg, uint32_t *checksum)
+{
+    xbench_ctx_t *x = arg;
+    xrpc_batch_begin(x->c);
+    for (uint32_t i = 0; i < x->batch; i++) {
+        xrpc_batch_pwm_set_duty(x->c, x->pwm_port, x->pwm_pin, 2000, next_duty(x));
+    }
+    *checksum = 0;
+    return xrpc_batch_submit(x->c, 1, XBENCH_TIMEOUT_MS);
+}
+
+static void xbench_report(const char *name, const mdl_bench_t *b, uint32_t ops_per_run)
+{
+    if (0 == b->done || 0 == b->total_us) {
+        printf("%-14s failed\r\n", name);
+        return;
+    }
+    uint64_t ops = (uint64_t)b->done * ops_per_run;
+    uint32_t op_ns = (uint32_t)(b->total_us * 1000 / ops);
+    uint32_t ops_s = (uint32_t)(ops * 1000000 / b->total_us);
+    printf("%-14s %8u %8u %8u %8u.%03u %9u  %08x\r\n", name, b->avg_us, b->p50_us, b->p99_us, op_ns / 1000,
+           op_ns % 1000, ops_s, b->ref_checksum);
+}
+
+static int xbench_run(const char *name, mdl_bench_t *b, mdl_bench_run_t run, xbench_ctx_t *x)
+{
+    int ret = mdl_bench_run(b, run, x, xbench_now_us);
+    if (0 != ret) {
+        printf("%-14s error after %u runs\r\n", name, b->done);
+    }
+    xbench_report(name, b, x->batch);
+    return ret;
+}
+
+static void print_usage()
+{
+    printf("Usage: xbench <-n<iters>> <-b<batch>> <-l<len>> <-o<offset>> <-p<pin>>\r\n");
+    printf("\tcompares single m1s_xram calls with xrpc batches of the same ops\r\n");
+    printf("\tneeds \"xrpc start\" on the e907 first\r\n");
+    printf("\t-n runs per test, 200 by default\r\n");
+    printf("\t-b ops per run, 16 by default, up to %u\r\n", XRPC_MAX_OPS);
+    printf("\t-l and -o: flash reads of <len> bytes from <offset>, 128 from 0x100000 by default\r\n");
+    printf("\twith -p it also sets the duty of pwm0 <pin>, fire and forget for xrpc\r\n");
+    printf("\r\n");
+}
+
+void cmd_c906_xbench(char *buf, int len, int argc, char **argv)
+{
+    xbench_ctx_t x = {.c = &s_client, .batch = 16, .offset = 0x100000, .len = 128, .pwm_pin = -1};
+    mdl_bench_t b = {.iters = 200, .warmup = 5};
+    uint32_t ref = 0;
+    uint8_t *raw;
+
+    int opt;
+    getopt_env_t getopt_env;
+    utils_getopt_init(&getopt_env, 0);
+    // put ':' in the starting of the string so that program can distinguish
+    // between '?' and ':'
+    while ((opt = utils_getopt(&getopt_env, argc, argv, ":n:b:l:o:p:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                b.iters = strtoul(getopt_env.optarg, NULL, 0);
+                break;
+            case 'b':
+                x.batch = strtoul(getopt_env.optarg, NULL, 0);
+                break;
+            case 'l':
+                x.len = strtoul(getopt_env.optarg, NULL, 0);
+                break;
+            case 'o':
+                x.offset = strtoul(getopt_env.optarg, NULL, 0);
+                break;
+            case 'p':
+                x.pwm_port = 0;
+                x.pwm_pin = strtoul(getopt_env.optarg, NULL, 0);
+                break;
+            case 'h':
+                print_usage();
+                return;
+            case ':':
+                // printf("%s: %c requires an argument\r\n", *argv, getopt_env.optopt);
+                break;
+            case '?':
+                // printf("unknow option: %c\r\n", getopt_env.optopt);
+                break;
+        }
+    }
+
+    /* every read of a batch has to fit in one reply */
+    uint32_t rec = XRPC_REC_HDR_SIZE + ((x.len + 3) & ~3u);
+    if (0 == b.iters || 0 == x.batch || x.batch > XRPC_MAX_OPS || 0 == x.len ||
+        XRPC_HDR_SIZE + x.batch * rec > XRPC_BUF_SIZE) {
+        printf("bad arguments, batch * (len + %u) must stay below %u\r\n", XRPC_REC_HDR_SIZE, XRPC_BUF_SIZE);
+        print_usage();
+        return;
+    }
+    int ret = xrpc_client_init(&s_client, (void *)XRPC_SHM_BASE);
+    if (-2 == ret) {
+        printf("[xbench] heap reaches into the xrpc mailbox at %08lx, see xrpc_msg.h\r\n",
+               (unsigned long)XRPC_SHM_BASE);
+        return;
+    }
+    if (0 != ret) {
+        printf("[xbench] xrpc server not running, \"xrpc start\" on the e907, then again\r\n");
+        return;
+    }
+
+    b.samples_us = malloc(b.iters * sizeof(uint32_t));
+    /* line aligned, the single calls invalidate what the e907 wrote */
+    raw = malloc(x.batch * x.len + 2 * 64);
+    x.buf = (uint8_t *)(((uintptr_t)raw + 63) & ~(uintptr_t)63);
+    if (NULL == b.samples_us || NULL == raw) {
+        printf("[xbench] no memory\r\n");
+        goto exit;
+    }
+
+    printf("[xbench] %u runs of %u ops, flash reads of %u bytes at 0x%08x\r\n", b.iters, x.batch, x.len,
+           x.offset);
+    printf("%-14s %8s %8s %8s %12s %9s  %8s\r\n", "test", "avg us", "p50 us", "p99 us", "us/op", "ops/s",
+           "checksum");
+    if (0 == xbench_run("read single", &b, read_single, &x)) {
+        ref = b.ref_checksum;
+    }
+    if (0 == xbench_run("read batched", &b, read_batched, &x) && ref && ref != b.ref_checksum) {
+        printf("[xbench] batched reads differ from single reads <- BROKEN\r\n");
+    }
+    xbench_run("nop batched", &b, nop_batched, &x);
+    if (x.pwm_pin >= 0) {
+        xbench_run("pwm single", &b, pwm_single, &x);
+        xbench_run("pwm forget", &b, pwm_forget, &x);
+    }
+    printf("[xbench] client %u batches, %u ops, %u timeouts\r\n", s_client.batches, s_client.ops,
+           s_client.timeouts);
+
+exit:
+    free(raw);
+    free(b.samples_us);
+}
@@ -0,0 +1,185 @@
+#include <string.h>
+
+/* FreeRTOS */
+#include <FreeRTOS.h>
+#include <task.h>
+
+/* RISCV */
+#include <csi_core.h>
+
+#include "xrpc_client.h"
+
+/* spin this long for an ack before yielding the tick away */
+#define XRPC_SPIN_US (200)
+
+#define ALIGNDOWN(x, r) ((x) & ~((r)-1))
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+
+static void clean_range(void *addr, uint32_t len)
+{
+    uintptr_t start = ALIGNDOWN((uintptr_t)addr, XRPC_LINE);
+    csi_dcache_clean_range((void *)start, ALIGNUP((uintptr_t)addr + len, XRPC_LINE) - start);
+}
+
+static void invalid_range(void *addr, uint32_t len)
+{
+    uintptr_t start = ALIGNDOWN((uintptr_t)addr, XRPC_LINE);
+    csi_dcache_invalid_range((void *)start, ALIGNUP((uintptr_t)addr + len, XRPC_LINE) - start);
+}
+
+static uint32_t read_ack(xrpc_shm_t *shm)
+{
+    invalid_range(&shm->resp, sizeof(shm->resp));
+    return __atomic_load_n(&shm->resp.ack, __ATOMIC_ACQUIRE);
+}
+
+static int wait_ack(xrpc_client_t *c, uint32_t timeout_ms)
+{
+    uint64_t t0 = CPU_Get_MTimer_US();
+
+    while (read_ack(c->shm) != c->seq) {
+        uint64_t waited = CPU_Get_MTimer_US() - t0;
+        if (waited > (uint64_t)timeout_ms * 1000) {
+            c->timeouts++;
+            return -1;
+        }
+        if (waited > XRPC_SPIN_US) {
+            vTaskDelay(1);
+        }
+    }
+    return 0;
+}
+
+/* the heap region of the SDK's linker script, weak so a script without them reads as unknown */
+extern uint8_t _heap_start[] __attribute__((weak));
+extern uint8_t _heap_size[] __attribute__((weak));
+
+static int heap_clear_of(const void *addr, uint32_t len)
+{
+    uintptr_t start = (uintptr_t)_heap_start, end = start + (uintptr_t)_heap_size;
+
+    if (0 == start || end == start) {
+        return 0;
+    }
+    return (uintptr_t)addr + len <= start || (uintptr_t)addr >= end;
+}
+
+int xrpc_client_init(xrpc_client_t *c, void *shm)
+{
+    memset(c, 0, sizeof(*c));
+    c->shm = shm;
+    if (!heap_clear_of(shm, sizeof(xrpc_shm_t))) {
+        return -2;
+    }
+    invalid_range(&c->shm->resp, sizeof(c->shm->resp));
+    int serving = XRPC_SHM_MAGIC == c->shm->resp.magic;
+
+    /* the request line goes out either way, "xrpc start" waits for it */
+    c->seq = serving ? read_ack(c->shm) : c->shm->req.seq;
+    c->shm->req.seq = c->seq;
+    c->shm->req.magic = XRPC_SHM_MAGIC;
+    clean_range(&c->shm->req, sizeof(c->shm->req));
+    if (!serving) {
+        return -1;
+    }
+    xrpc_batch_begin(c);
+    return 0;
+}
+
+void xrpc_batch_begin(xrpc_client_t *c)
+{
+    xrpc_req_begin(&c->w, c->buf, sizeof(c->buf));
+}
+
+static int add(xrpc_client_t *c, uint8_t code, uint32_t a0, uint32_t a1, uint32_t a2, const void *p, uint16_t len)
+{
+    xrpc_op_t op = {.code = code, .a0 = a0, .a1 = a1, .a2 = a2, .payload = p, .payload_len = len};
+    return xrpc_req_add(&c->w, &op);
+}
+
+int xrpc_batch_nop(xrpc_client_t *c)
+{
+    return add(c, XRPC_OP_NOP, 0, 0, 0, NULL, 0);
+}
+
+int xrpc_batch_flash_read(xrpc_client_t *c, uint32_t offset, uint32_t len)
+{
+    return add(c, XRPC_OP_FLASH_READ, offset, len, 0, NULL, 0);
+}
+
+int xrpc_batch_flash_write(xrpc_client_t *c, uint32_t offset, const void *src, uint16_t len)
+{
+    return add(c, XRPC_OP_FLASH_WRITE, offset, 0, 0, src, len);
+}
+
+int xrpc_batch_flash_erase(xrpc_client_t *c, uint32_t offset, uint32_t len)
+{
+    return add(c, XRPC_OP_FLASH_ERASE, offset, len, 0, NULL, 0);
+}
+
+int xrpc_batch_pwm_set_duty(xrpc_client_t *c, uint8_t port, uint8_t pin, uint32_t freq, uint8_t duty)
+{
+    return add(c, XRPC_OP_PWM_SET_DUTY, (port << 8) | pin, freq, duty, NULL, 0);
+}
+
+int xrpc_batch_submit(xrpc_client_t *c, int no_reply, uint32_t timeout_ms)
+{
+    xrpc_shm_t *shm = c->shm;
+    xrpc_reader_t r;
+    uint16_t count = c->w.count;
+
+    c->done = 0;
+    if (0 == count) {
+        return 0;
+    }
+    /* the previous batch may still be running, req_buf is ours again once it is acked */
+    if (0 != wait_ack(c, timeout_ms)) {
+        xrpc_batch_begin(c);
+        return -1;
+    }
+
+    uint32_t len = xrpc_req_end(&c->w, c->seq + 1, no_reply ? XRPC_F_NO_REPLY : 0);
+    memcpy(shm->req_buf, c->buf, len);
+    clean_range(shm->req_buf, len);
+    shm->req.len = len;
+    c->seq++;
+    /* the doorbell, after the request is in memory */
+    __atomic_store_n(&shm->req.seq, c->seq, __ATOMIC_RELEASE);
+    clean_range(&shm->req, sizeof(shm->req));
+    c->batches++;
+    c->ops += count;
+    xrpc_batch_begin(c);
+
+    if (no_reply) {
+        return 0;
+    }
+    if (0 != wait_ack(c, timeout_ms)) {
+        return -1;
+    }
+
+    invalid_range(&shm->resp, sizeof(shm->resp));
+    len = shm->resp.len;
+    if (len > XRPC_BUF_SIZE) {
+        return -1;
+    }
+    invalid_range(shm->resp_buf, len);
+    if (0 != xrpc_resp_parse(&r, shm->resp_buf, len) || r.seq != c->seq) {
+        return -1;
+    }
+    while (c->done < XRPC_MAX_OPS &&
+           xrpc_resp_next(&r, &c->status[c->done], &c->data[c->done], &c->data_len[c->done])) {
+        c->done++;
+    }
+    return c->done == count ? 0 : -1;
+}
+
+int32_t xrpc_batch_result(xrpc_client_t *c, int idx, void *dst, uint32_t max)
+{
+    if (idx < 0 || idx >= c->done) {
+        return -1;
+    }
+    if (dst && c->data[idx]) {
+        memcpy(dst, c->data[idx], c->data_len[idx] < max ? c->data_len[idx] : max);
+    }
+    return c->status[idx];
+}
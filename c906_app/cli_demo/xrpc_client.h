@@ -0,0 +1,66 @@
+#ifndef __XRPC_CLIENT_H__
+#define __XRPC_CLIENT_H__
+
+#include <stdint.h>
+
+#include "xrpc_msg.h"
+
+/*
+ * Batches calls to the E907 (xrpc_server.c there) into one message. Ops are
+ * queued locally, xrpc_batch_submit() hands the whole batch over with a
+ * single doorbell and, unless it is fire and forget, waits for the
+ * completion vector:
+ *
+ *   xrpc_batch_begin(c);
+ *   a = xrpc_batch_flash_read(c, 0x1000, 256);
+ *   b = xrpc_batch_flash_read(c, 0x2000, 256);
+ *   xrpc_batch_submit(c, 0, 100);
+ *   xrpc_batch_result(c, a, dst, 256);
+ *
+ * A fire and forget batch returns as soon as the server has the doorbell;
+ * the next submit waits for it to finish, so the next batch is built while
+ * the server still runs the previous one.
+ */
+
+typedef struct {
+    xrpc_shm_t *shm;
+    uint32_t seq; /* last submitted */
+    xrpc_writer_t w;
+    uint8_t buf[XRPC_BUF_SIZE];
+
+    /* completion vector of the last replied batch */
+    uint16_t done;
+    int32_t status[XRPC_MAX_OPS];
+    const uint8_t *data[XRPC_MAX_OPS];
+    uint32_t data_len[XRPC_MAX_OPS];
+
+    uint32_t batches;
+    uint32_t ops;
+    uint32_t timeouts;
+} xrpc_client_t;
+
+/*
+ * Publishes the request line, then returns -1 until the server runs
+ * ("xrpc start" on the E907, which refuses before the request line is
+ * there). Returns -2, writing nothing, when the heap reaches into shm.
+ */
+int xrpc_client_init(xrpc_client_t *c, void *shm);
+
+void xrpc_batch_begin(xrpc_client_t *c);
+/* Each returns the op's index in the completion vector, or -1 if the batch is full. */
+int xrpc_batch_nop(xrpc_client_t *c);
+int xrpc_batch_flash_read(xrpc_client_t *c, uint32_t offset, uint32_t len);
+int xrpc_batch_flash_write(xrpc_client_t *c, uint32_t offset, const void *src, uint16_t len);
+int xrpc_batch_flash_erase(xrpc_client_t *c, uint32_t offset, uint32_t len);
+int xrpc_batch_pwm_set_duty(xrpc_client_t *c, uint8_t port, uint8_t pin, uint32_t freq, uint8_t duty);
+
+/*
+ * Returns 0 once the batch is done (or handed over, with no_reply), -1 on
+ * timeout or a malformed reply. An empty batch is not sent.
+ */
+int xrpc_batch_submit(xrpc_client_t *c, int no_reply, uint32_t timeout_ms);
+
+/* Copies up to max bytes of op idx's data to dst. Returns the op's status. */
+int32_t xrpc_batch_result(xrpc_client_t *c, int idx, void *dst, uint32_t max);
+
+#endif /* __XRPC_CLIENT_H__ */
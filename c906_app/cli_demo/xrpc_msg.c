@@ -0,0 +1,192 @@
+#include <string.h>
+
+#include "xrpc_msg.h"
+
+#define ALIGN4(x) (((x) + 3) & ~3u)
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* header: magic, seq, count | flags << 16, total length */
+static void put_hdr(uint8_t *p, uint32_t magic, uint32_t seq, uint16_t count, uint16_t flags, uint32_t len)
+{
+    put_le32(p, magic);
+    put_le32(p + 4, seq);
+    put_le32(p + 8, count | ((uint32_t)flags << 16));
+    put_le32(p + 12, len);
+}
+
+static int parse_hdr(xrpc_reader_t *r, uint32_t magic, const uint8_t *buf, uint32_t len)
+{
+    memset(r, 0, sizeof(*r));
+    if (len < XRPC_HDR_SIZE || magic != get_le32(buf)) {
+        return -1;
+    }
+    uint32_t total = get_le32(buf + 12);
+    if (total < XRPC_HDR_SIZE || total > len) {
+        return -1;
+    }
+    r->buf = buf;
+    r->len = total;
+    r->pos = XRPC_HDR_SIZE;
+    r->seq = get_le32(buf + 4);
+    r->count = get_le32(buf + 8) & 0xffff;
+    r->flags = get_le32(buf + 8) >> 16;
+    return r->count <= XRPC_MAX_OPS ? 0 : -1;
+}
+
+void xrpc_req_begin(xrpc_writer_t *w, uint8_t *buf, uint32_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = XRPC_HDR_SIZE;
+    w->last = 0;
+    w->count = 0;
+}
+
+int xrpc_req_add(xrpc_writer_t *w, const xrpc_op_t *op)
+{
+    uint32_t need = XRPC_OP_HDR_SIZE + ALIGN4(op->payload_len);
+    if (w->count >= XRPC_MAX_OPS || w->len > w->size || need > w->size - w->len) {
+        return -1;
+    }
+    uint8_t *p = w->buf + w->len;
+    put_le32(p, op->code | (op->flags << 8) | ((uint32_t)op->payload_len << 16));
+    put_le32(p + 4, op->a0);
+    put_le32(p + 8, op->a1);
+    put_le32(p + 12, op->a2);
+    if (op->payload_len) {
+        memcpy(p + XRPC_OP_HDR_SIZE, op->payload, op->payload_len);
+        memset(p + XRPC_OP_HDR_SIZE + op->payload_len, 0, ALIGN4(op->payload_len) - op->payload_len);
+    }
+    w->len += need;
+    return w->count++;
+}
+
+uint32_t xrpc_req_end(xrpc_writer_t *w, uint32_t seq, uint16_t flags)
+{
+    put_hdr(w->buf, XRPC_REQ_MAGIC, seq, w->count, flags, w->len);
+    return w->len;
+}
+
+int xrpc_req_parse(xrpc_reader_t *r, const uint8_t *buf, uint32_t len)
+{
+    if (0 != parse_hdr(r, XRPC_REQ_MAGIC, buf, len)) {
+        return -1;
+    }
+    /* walk once so that xrpc_req_next() never meets a truncated op */
+    uint32_t pos = XRPC_HDR_SIZE;
+    for (uint16_t i = 0; i < r->count; i++) {
+        if (pos + XRPC_OP_HDR_SIZE > r->len) {
+            return -1;
+        }
+        uint32_t w0 = get_le32(buf + pos);
+        if ((w0 & 0xff) >= XRPC_OP_MAX || ALIGN4(w0 >> 16) > r->len - pos - XRPC_OP_HDR_SIZE) {
+            return -1;
+        }
+        pos += XRPC_OP_HDR_SIZE + ALIGN4(w0 >> 16);
+    }
+    return 0;
+}
+
+int xrpc_req_next(xrpc_reader_t *r, xrpc_op_t *op)
+{
+    if (r->idx >= r->count) {
+        return 0;
+    }
+    const uint8_t *p = r->buf + r->pos;
+    uint32_t w0 = get_le32(p);
+    op->code = w0 & 0xff;
+    op->flags = (w0 >> 8) & 0xff;
+    op->payload_len = w0 >> 16;
+    op->a0 = get_le32(p + 4);
+    op->a1 = get_le32(p + 8);
+    op->a2 = get_le32(p + 12);
+    op->payload = op->payload_len ? p + XRPC_OP_HDR_SIZE : NULL;
+    r->pos += XRPC_OP_HDR_SIZE + ALIGN4(op->payload_len);
+    r->idx++;
+    return 1;
+}
+
+void xrpc_resp_begin(xrpc_writer_t *w, uint8_t *buf, uint32_t size)
+{
+    xrpc_req_begin(w, buf, size);
+}
+
+uint8_t *xrpc_resp_add(xrpc_writer_t *w, int32_t status, uint32_t data_len)
+{
+    if (w->len + XRPC_REC_HDR_SIZE > w->size) {
+        return NULL; /* can't even say it failed, the client sees a short reply */
+    }
+    uint8_t *p = w->buf + w->len;
+    /* data_len comes from the other core: compared before ALIGN4, which wraps for the last 3 values */
+    uint32_t room = w->size - w->len - XRPC_REC_HDR_SIZE;
+    int fits = data_len <= room && ALIGN4(data_len) <= room;
+    if (!fits) {
+        status = -1;
+        data_len = 0;
+    }
+    put_le32(p, status);
+    put_le32(p + 4, data_len);
+    memset(p + XRPC_REC_HDR_SIZE + data_len, 0, ALIGN4(data_len) - data_len);
+    w->last = w->len;
+    w->len += XRPC_REC_HDR_SIZE + ALIGN4(data_len);
+    w->count++;
+    return fits ? p + XRPC_REC_HDR_SIZE : NULL;
+}
+
+void xrpc_resp_set_status(xrpc_writer_t *w, int32_t status)
+{
+    if (w->last) {
+        put_le32(w->buf + w->last, status);
+    }
+}
+
+uint32_t xrpc_resp_end(xrpc_writer_t *w, uint32_t seq)
+{
+    put_hdr(w->buf, XRPC_RESP_MAGIC, seq, w->count, 0, w->len);
+    return w->len;
+}
+
+int xrpc_resp_parse(xrpc_reader_t *r, const uint8_t *buf, uint32_t len)
+{
+    if (0 != parse_hdr(r, XRPC_RESP_MAGIC, buf, len)) {
+        return -1;
+    }
+    uint32_t pos = XRPC_HDR_SIZE;
+    for (uint16_t i = 0; i < r->count; i++) {
+        if (pos + XRPC_REC_HDR_SIZE > r->len) {
+            return -1;
+        }
+        uint32_t data_len = get_le32(buf + pos + 4);
+        if (data_len > r->len - pos - XRPC_REC_HDR_SIZE || ALIGN4(data_len) > r->len - pos - XRPC_REC_HDR_SIZE) {
+            return -1;
+        }
+        pos += XRPC_REC_HDR_SIZE + ALIGN4(data_len);
+    }
+    return 0;
+}
+
+int xrpc_resp_next(xrpc_reader_t *r, int32_t *status, const uint8_t **data, uint32_t *data_len)
+{
+    if (r->idx >= r->count) {
+        return 0;
+    }
+    const uint8_t *p = r->buf + r->pos;
+    *status = (int32_t)get_le32(p);
+    *data_len = get_le32(p + 4);
+    *data = *data_len ? p + XRPC_REC_HDR_SIZE : NULL;
+    r->pos += XRPC_REC_HDR_SIZE + ALIGN4(*data_len);
+    r->idx++;
+    return 1;
+}
@@ -0,0 +1,174 @@
+#include <string.h>
+
+#include "flash_io.h"
+
+void flash_io_init(flash_io_t *f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+int flash_io_map(flash_io_t *f, uint32_t offset, uint32_t size, uintptr_t xip)
+{
+    if (f->maps == FLASH_IO_MAX_MAPS || 0 == size) {
+        return -1;
+    }
+    f->map[f->maps].offset = offset;
+    f->map[f->maps].size = size;
+    f->map[f->maps].xip = xip;
+    f->maps++;
+    return 0;
+}
+
+/* the window holding offset, and how many bytes of it are left from there */
+static const flash_io_map_t *find_map(flash_io_t *f, uint32_t offset, uint32_t *left)
+{
+    for (uint32_t i = 0; i < f->maps; i++) {
+        const flash_io_map_t *m = &f->map[i];
+        if (offset - m->offset < m->size) {
+            *left = m->size - (offset - m->offset);
+            return m;
+        }
+    }
+    return NULL;
+}
+
+/* bytes from offset (not in any window) to the next window, at most len */
+static uint32_t gap_len(flash_io_t *f, uint32_t offset, uint32_t len)
+{
+    for (uint32_t i = 0; i < f->maps; i++) {
+        if (f->map[i].offset - offset < len) {
+            len = f->map[i].offset - offset;
+        }
+    }
+    return len;
+}
+
+const void *flash_io_xip_addr(flash_io_t *f, uint32_t offset, uint32_t len)
+{
+    uint32_t left;
+    const flash_io_map_t *m = find_map(f, offset, &left);
+
+    return m && len <= left ? (const void *)(m->xip + (offset - m->offset)) : NULL;
+}
+
+void flash_io_invalidate(flash_io_t *f, uint32_t offset, uint32_t len)
+{
+    while (len) {
+        uint32_t left, n;
+        const flash_io_map_t *m = find_map(f, offset, &left);
+        if (NULL == m) {
+            n = gap_len(f, offset, len);
+        } else {
+            n = len < left ? len : left;
+            flash_port_xip_invalidate(m->xip + (offset - m->offset), n);
+            f->invalidated += n;
+        }
+        offset += n;
+        len -= n;
+    }
+}
+
+static int rpc_read(flash_io_t *f, uint32_t offset, uint8_t *dst, uint32_t len)
+{
+    f->rpc_reads++;
+    f->rpc_bytes += len;
+    while (len) {
+        uint32_t n = len < FLASH_IO_RPC_CHUNK ? len : FLASH_IO_RPC_CHUNK;
+        f->rpc_calls++;
+        if (0 != flash_port_read(offset, dst, n)) {
+            f->errors++;
+            return -1;
+        }
+        offset += n;
+        dst += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int flash_io_read_via(flash_io_t *f, flash_io_path_t path, uint32_t offset, void *dst, uint32_t len)
+{
+    uint8_t *d = dst;
+
+    if (FLASH_IO_RPC == path || (FLASH_IO_AUTO == path && __atomic_load_n(&f->inflight, __ATOMIC_ACQUIRE))) {
+        return rpc_read(f, offset, d, len);
+    }
+    while (len) {
+        uint32_t left, n;
+        const flash_io_map_t *m = find_map(f, offset, &left);
+        if (m) {
+            n = len < left ? len : left;
+            memcpy(d, (const void *)(m->xip + (offset - m->offset)), n);
+            f->xip_reads++;
+            f->xip_bytes += n;
+        } else {
+            if (FLASH_IO_XIP == path) {
+                return -1;
+            }
+            n = gap_len(f, offset, len);
+            if (0 != rpc_read(f, offset, d, n)) {
+                return -1;
+            }
+        }
+        offset += n;
+        d += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int flash_io_read(flash_io_t *f, uint32_t offset, void *dst, uint32_t len)
+{
+    return flash_io_read_via(f, FLASH_IO_AUTO, offset, dst, len);
+}
+
+int flash_io_erase(flash_io_t *f, uint32_t offset, uint32_t len)
+{
+    int ret;
+
+    if ((offset | len) & (FLASH_IO_SECTOR - 1)) {
+        return -1;
+    }
+    __atomic_add_fetch(&f->inflight, 1, __ATOMIC_ACQ_REL);
+    ret = flash_port_erase(offset, len);
+    flash_io_invalidate(f, offset, len);
+    __atomic_sub_fetch(&f->inflight, 1, __ATOMIC_ACQ_REL);
+    f->erases++;
+    if (0 != ret) {
+        f->errors++;
+        return -1;
+    }
+    return 0;
+}
+
+int flash_io_write(flash_io_t *f, uint32_t offset, const void *src, uint32_t len)
+{
+    const uint8_t *s = src;
+    uint32_t o = offset, n = len;
+    int ret = 0;
+
+    __atomic_add_fetch(&f->inflight, 1, __ATOMIC_ACQ_REL);
+    while (n && 0 == ret) {
+        uint32_t chunk = n < FLASH_IO_RPC_CHUNK ? n : FLASH_IO_RPC_CHUNK;
+        ret = flash_port_write(o, s, chunk);
+        o += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+    /* also after a failure, part of the range may have changed */
+    flash_io_invalidate(f, offset, len);
+    __atomic_sub_fetch(&f->inflight, 1, __ATOMIC_ACQ_REL);
+    f->writes++;
+    if (0 != ret) {
+        f->errors++;
+        return -1;
+    }
+    return 0;
+}
+
+int flash_io_sync(flash_io_t *f)
+{
+    /* each erase and write has reached the flash and dropped its XIP lines by the time it returns */
+    (void)f;
+    return 0;
+}
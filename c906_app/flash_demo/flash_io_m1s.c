@@ -0,0 +1,54 @@
+#include <stdint.h>
+
+/* RISCV */
+#include <csi_core.h>
+
+#include "flash_io.h"
+#include "m1s_c906_xram_flash.h"
+
+/*
+ * The E907 moves the data with its own bus accesses, past the C906's
+ * D-cache: a source is cleaned before it goes over, a destination is
+ * cleaned and invalidated before (so no dirty line is written back on top
+ * of what arrives, partial lines at the ends included) and invalidated
+ * after.
+ */
+
+int flash_port_read(uint32_t offset, void *dst, uint32_t len)
+{
+    csi_dcache_clean_invalid_range(dst, len);
+    if (0 != m1s_xram_flash_read(offset, (uint32_t)(uintptr_t)dst, len)) {
+        return -1;
+    }
+    csi_dcache_invalid_range(dst, len);
+    return 0;
+}
+
+int flash_port_erase(uint32_t offset, uint32_t len)
+{
+    return 0 == m1s_xram_flash_erase(offset, len) ? 0 : -1;
+}
+
+int flash_port_write(uint32_t offset, const void *src, uint32_t len)
+{
+    csi_dcache_clean_range((void *)src, len);
+    return 0 == m1s_xram_flash_write(offset, (uint32_t)(uintptr_t)src, len) ? 0 : -1;
+}
+
+void flash_port_xip_invalidate(uintptr_t xip, uint32_t len)
+{
+    csi_dcache_invalid_range((void *)xip, len);
+}
+
+flash_io_t *flash_io_get(void)
+{
+    static flash_io_t s_flash;
+    static int s_init;
+
+    if (!s_init) {
+        flash_io_init(&s_flash);
+        flash_io_map(&s_flash, FLASH_IO_MEDIA_OFFSET, FLASH_IO_MEDIA_SIZE, FLASH_IO_MEDIA_XIP);
+        s_init = 1;
+    }
+    return &s_flash;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* FreeRTOS */
 #include <FreeRTOS.h>
@@ -8,10 +9,14 @@
 /* aos */
 #include <cli.h>
 
-#include "m1s_c906_xram_flash.h"
-// partion media
-#define MEDIA_OFFSET_IN_FLASH (0x300000)
-#define MEDIA_OFFSET_IN_XIP (0x582f0000)
+/* RISCV */
+#include <csi_core.h>
+
+#include "flash_io.h"
+
+#define BENCH_OFFSET (FLASH_IO_MEDIA_OFFSET + 0x100000) /* clear of the sector the demo rewrites */
+#define BENCH_BUF (32 * 1024)
+#define BENCH_TOTAL (1024 * 1024)
 
 extern void cmd_c906_flash(char *buf, int len, int argc, char **argv);
 const static struct cli_command cmds_user[] STATIC_CLI_CMD_ATTRIBUTE = {
@@ -46,27 +51,72 @@ static inline void log_hex(uint32_t *a, uint32_t l)
         for (uint32_t i = 0; i < length / 4; i++) addr[i] = 0; \
     } while (0)
 
+/* read MB/s of each path; "cold" XIP starts from an invalidated window, "warm" reads what the D-cache kept */
+static void read_bench(flash_io_t *f)
+{
+    static const struct {
+        const char *name;
+        flash_io_path_t path;
+        int cold;
+    } runs[] = {
+        {"xip cold", FLASH_IO_XIP, 1},
+        {"xip warm", FLASH_IO_XIP, 0},
+        {"rpc", FLASH_IO_RPC, 0},
+    };
+    uint8_t *buf = pvPortMalloc(BENCH_BUF);
+
+    if (NULL == buf) {
+        printf("[bench] no memory\r\n");
+        return;
+    }
+    for (uint32_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+        uint32_t rpc_calls = f->rpc_calls;
+        uint64_t us = 0;
+        int ret = 0;
+        for (uint32_t done = 0; done < BENCH_TOTAL && 0 == ret; done += BENCH_BUF) {
+            /* warm runs go over the same 32 KB, well within the C906's D-cache */
+            uint32_t offset = BENCH_OFFSET + (runs[r].cold ? done : 0);
+            if (runs[r].cold) {
+                flash_port_xip_invalidate((uintptr_t)flash_io_xip_addr(f, offset, BENCH_BUF), BENCH_BUF);
+            }
+            uint64_t t0 = CPU_Get_MTimer_US();
+            ret = flash_io_read_via(f, runs[r].path, offset, buf, BENCH_BUF);
+            us += CPU_Get_MTimer_US() - t0;
+        }
+        if (0 != ret) {
+            printf("[bench] %s: read failed\r\n", runs[r].name);
+            continue;
+        }
+        printf("[bench] %-8s %u KB in %lu us, %lu.%02lu MB/s, %lu xram calls\r\n", runs[r].name, BENCH_TOTAL >> 10,
+               (unsigned long)us, (unsigned long)(BENCH_TOTAL / us), (unsigned long)(BENCH_TOTAL % us * 100 / us),
+               (unsigned long)(f->rpc_calls - rpc_calls));
+    }
+    vPortFree(buf);
+}
+
 void main()
 {
     vTaskDelay(500);
     srand(CPU_Get_MTimer_Counter());
-    uint32_t offset = MEDIA_OFFSET_IN_FLASH;
+    flash_io_t *f = flash_io_get();
+    uint32_t offset = FLASH_IO_MEDIA_OFFSET;
     uint32_t addr[32];
     uint32_t length = sizeof(addr);
+    const uint32_t *xip = flash_io_xip_addr(f, offset, length);
     printf("xip:\r\n");
-    log_hex(MEDIA_OFFSET_IN_XIP, length);
+    log_hex((uint32_t *)xip, length);
 
     printf("[flash] read\r\n");
     CLRRAM();
-    m1s_xram_flash_read(offset, addr, length);
+    flash_io_read(f, offset, addr, length);
     LOGDATA();
 
     printf("[flash] erase\r\n");
-    m1s_xram_flash_erase(offset, length);
+    flash_io_erase(f, offset, FLASH_IO_SECTOR);
 
     printf("[flash] read\r\n");
     CLRRAM();
-    m1s_xram_flash_read(offset, addr, length);
+    flash_io_read(f, offset, addr, length);
     LOGDATA();
 
     printf("[ram] modified\r\n");
@@ -74,10 +124,16 @@ void main()
     LOGDATA();
 
     printf("[flash] write\r\n");
-    m1s_xram_flash_write(offset, addr, length);
+    flash_io_write(f, offset, addr, length);
+    printf("[flash] xip %s the write\r\n", 0 == memcmp(xip, addr, length) ? "shows" : "DOESN'T show");
 
-    printf("[flash] read\r\n");
+    printf("[flash] read over rpc\r\n");
     CLRRAM();
-    m1s_xram_flash_read(offset, addr, length);
+    flash_io_read_via(f, FLASH_IO_RPC, offset, addr, length);
     LOGDATA();
+
+    read_bench(f);
+    printf("[flash] %lu xip reads, %lu rpc reads, %lu erases, %lu writes, %lu errors\r\n",
+           (unsigned long)f->xip_reads, (unsigned long)f->rpc_reads, (unsigned long)f->erases,
+           (unsigned long)f->writes, (unsigned long)f->errors);
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "flash_file.h"
+#include "flash_io.h"
+
+flash_file_t flash_file;
+
+static int s_fd = -1;
+static uint32_t s_size;
+static uint8_t *s_xip;
+
+static void spin_us(uint32_t us)
+{
+    struct timespec t0, t;
+
+    if (0 == us) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t);
+    } while ((t.tv_sec - t0.tv_sec) * 1000000 + (t.tv_nsec - t0.tv_nsec) / 1000 < us);
+}
+
+static void sleep_us(uint64_t us)
+{
+    struct timespec t = {.tv_sec = us / 1000000, .tv_nsec = us % 1000000 * 1000};
+
+    if (us) {
+        nanosleep(&t, NULL);
+    }
+}
+
+/* 1 to do the whole op, 2 half of it, 0 nothing: the power is gone */
+static int power(void)
+{
+    if (0 == flash_file.cut_after) {
+        return 1;
+    }
+    if (1 == flash_file.cut_after) {
+        flash_file.cut_after = 0xffffffff;
+        flash_file.cuts++;
+        return 2;
+    }
+    if (0xffffffff != flash_file.cut_after) {
+        flash_file.cut_after--;
+        return 1;
+    }
+    return 0;
+}
+
+static uint64_t erase_us(uint32_t offset, uint32_t len)
+{
+    uint64_t us = 0;
+
+    for (uint32_t o = offset; o < offset + len;) {
+        if (0 == (o & 0xffff) && offset + len - o >= 0x10000) {
+            us += flash_file.block_erase_us;
+            o += 0x10000;
+        } else {
+            us += flash_file.sector_erase_us;
+            o += FLASH_IO_SECTOR;
+        }
+    }
+    return us;
+}
+
+int flash_file_open(const char *path, uint32_t size)
+{
+    struct stat st;
+    uint8_t ff[FLASH_IO_SECTOR];
+
+    s_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (s_fd < 0 || 0 != fstat(s_fd, &st) || NULL == (s_xip = malloc(size))) {
+        perror(path);
+        return -1;
+    }
+    memset(ff, 0xff, sizeof(ff));
+    for (uint32_t o = st.st_size; o < size; o += sizeof(ff)) {
+        uint32_t n = size - o < sizeof(ff) ? size - o : sizeof(ff);
+        if ((ssize_t)n != pwrite(s_fd, ff, n, o)) {
+            return -1;
+        }
+    }
+    s_size = size;
+    if ((ssize_t)size != pread(s_fd, s_xip, size, 0)) {
+        return -1;
+    }
+    return 0;
+}
+
+void flash_file_close(void)
+{
+    if (s_fd >= 0) {
+        close(s_fd);
+    }
+    free(s_xip);
+    s_fd = -1;
+    s_xip = NULL;
+}
+
+uint8_t *flash_file_xip(void)
+{
+    return s_xip;
+}
+
+flash_io_t *flash_io_get(void)
+{
+    static flash_io_t s_flash;
+    static int s_init;
+
+    if (!s_init && s_size > FLASH_IO_MEDIA_OFFSET) {
+        uint32_t size = s_size - FLASH_IO_MEDIA_OFFSET;
+        flash_io_init(&s_flash);
+        flash_io_map(&s_flash, FLASH_IO_MEDIA_OFFSET, size < FLASH_IO_MEDIA_SIZE ? size : FLASH_IO_MEDIA_SIZE,
+                     (uintptr_t)(s_xip + FLASH_IO_MEDIA_OFFSET));
+        s_init = 1;
+    }
+    return &s_flash;
+}
+
+int flash_port_read(uint32_t offset, void *dst, uint32_t len)
+{
+    flash_file.reads++;
+    spin_us(flash_file.rpc_us);
+    if (offset > s_size || len > s_size - offset) {
+        return -1;
+    }
+    return (ssize_t)len == pread(s_fd, dst, len, offset) ? 0 : -1;
+}
+
+int flash_port_erase(uint32_t offset, uint32_t len)
+{
+    uint8_t ff[FLASH_IO_SECTOR];
+
+    flash_file.erases++;
+    spin_us(flash_file.rpc_us + flash_file.op_us);
+    if (flash_file.during_write) {
+        flash_file.during_write(flash_file.during_write_arg);
+    }
+    if ((offset | len) & (FLASH_IO_SECTOR - 1) || offset > s_size || len > s_size - offset) {
+        return -1;
+    }
+    sleep_us(erase_us(offset, len));
+    switch (power()) {
+        case 0:
+            return 0;
+        case 2:
+            /* an erase cut short leaves a half erased range, not the old contents */
+            len /= 2;
+            break;
+    }
+    memset(ff, 0xff, sizeof(ff));
+    for (uint32_t o = 0; o < len; o += sizeof(ff)) {
+        uint32_t n = len - o < sizeof(ff) ? len - o : sizeof(ff);
+        if ((ssize_t)n != pwrite(s_fd, ff, n, offset + o)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int flash_port_write(uint32_t offset, const void *src, uint32_t len)
+{
+    const uint8_t *s = src;
+    uint8_t old[256];
+
+    flash_file.writes++;
+    spin_us(flash_file.rpc_us + flash_file.op_us);
+    if (flash_file.during_write) {
+        flash_file.during_write(flash_file.during_write_arg);
+    }
+    if (offset > s_size || len > s_size - offset) {
+        return -1;
+    }
+    if (len) {
+        sleep_us((uint64_t)flash_file.page_us * (((offset + len - 1) >> 8) - (offset >> 8) + 1));
+    }
+    switch (power()) {
+        case 0:
+            return 0;
+        case 2:
+            len /= 2;
+            break;
+    }
+    /* programming only clears bits */
+    for (uint32_t o = 0; o < len; o += sizeof(old)) {
+        uint32_t n = len - o < sizeof(old) ? len - o : sizeof(old);
+        if ((ssize_t)n != pread(s_fd, old, n, offset + o)) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            old[i] &= s[o + i];
+        }
+        if ((ssize_t)n != pwrite(s_fd, old, n, offset + o)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void flash_port_xip_invalidate(uintptr_t xip, uint32_t len)
+{
+    uint32_t offset = xip - (uintptr_t)s_xip;
+
+    flash_file.invalidates++;
+    if (offset <= s_size && len <= s_size - offset) {
+        pread(s_fd, s_xip + offset, len, offset);
+    }
+}
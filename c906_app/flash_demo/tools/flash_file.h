@@ -0,0 +1,59 @@
+#ifndef __FLASH_FILE_H__
+#define __FLASH_FILE_H__
+
+#include <stdint.h>
+
+/*
+ * flash_io's platform on the host: the whole flash is a file, the E907's
+ * RPC path reads and programs it with NOR rules (erase sets whole sectors
+ * to 0xff, a write can only clear bits), and the XIP window is a copy of
+ * the file in memory that, like the D-cache in front of the real window,
+ * only picks up changes to a range when it is invalidated. A layer that
+ * forgets to invalidate reads stale data here as it would on the board.
+ *
+ * flash_io_get() maps the media partition the way flash_io_m1s.c does,
+ * everything below it is RPC only.
+ */
+
+typedef struct {
+    uint32_t rpc_us; /* added to every RPC call, the cross-core round trip */
+    uint32_t op_us;  /* added to every erase and write, the chip being busy */
+
+    /*
+     * NOR timing, slept through rather than spun: the chip is busy, the CPU
+     * isn't. Typical figures of the 16 MB parts on the board are 45000,
+     * 150000 and 700.
+     */
+    uint32_t sector_erase_us; /* per 4 KB sector */
+    uint32_t block_erase_us;  /* per aligned 64 KB block, instead of 16 sectors */
+    uint32_t page_us;         /* per 256 byte page a write touches */
+
+    /*
+     * Power loss: the cut_after-th erase or write from now (1 the next one)
+     * is torn, half of it reaching the flash, and every one after it is
+     * lost while still returning 0, until the caller "reboots" by setting
+     * cut_after to 0 again. 0 never.
+     */
+    uint32_t cut_after;
+    uint32_t cuts; /* power losses so far */
+
+    /* called inside every erase and write, while it is in flight */
+    void (*during_write)(void *arg);
+    void *during_write_arg;
+
+    uint32_t reads;
+    uint32_t erases;
+    uint32_t writes;
+    uint32_t invalidates;
+} flash_file_t;
+
+extern flash_file_t flash_file;
+
+/* Opens or creates path as a flash of size bytes (new space erased). Returns 0 or -1. */
+int flash_file_open(const char *path, uint32_t size);
+void flash_file_close(void);
+
+/* the in-memory XIP window, flash offset 0 */
+uint8_t *flash_file_xip(void);
+
+#endif /* __FLASH_FILE_H__ */
@@ -0,0 +1,302 @@
+/*
+ * flash_io_check - flash_io.c on a file-backed flash, then read MB/s per path.
+ *
+ * Random erases, writes and reads go through flash_io against a model of
+ * the flash in memory (NOR rules: erase to 0xff, writes only clear bits),
+ * spread over the end of the RPC-only area and the start of the media
+ * partition so reads straddle the XIP window's edge. Every read is checked
+ * against the model on all three paths: auto, XIP only and RPC only.
+ *
+ * Then the parts that make XIP safe:
+ *   stale      a write behind flash_io's back (straight to the platform)
+ *              isn't seen over XIP until invalidated, so the file-backed
+ *              window really is as stale as the board's D-cache would be,
+ *              and a write through flash_io is seen at once
+ *   inflight   a read issued while an erase or write is in flight takes
+ *              the RPC path
+ *   edges      unaligned erases, XIP-only reads of unmapped ranges, XIP
+ *              addresses of ranges running off the window are refused
+ *
+ * The benchmark reads -m MB over each path in -b byte reads. On the host
+ * XIP is a memcpy and RPC a pread; -l adds a fixed cost to every RPC call
+ * to stand in for the cross-core round trip.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -I. -o flash_io_check flash_io_check.c flash_file.c ../flash_io.c
+ *   ./flash_io_check -n 20000 -l 30
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "flash_file.h"
+#include "flash_io.h"
+
+#define FLASH_SIZE (FLASH_IO_MEDIA_OFFSET + 1024 * 1024) /* the RPC-only area and 1 MB of media */
+#define AREA (256 * 1024)                                /* random ops within this much either side of the edge */
+#define AREA_START (FLASH_IO_MEDIA_OFFSET - AREA)
+#define MAX_OP (3 * FLASH_IO_SECTOR)
+
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static double now_s(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* what the flash holds, AREA either side of the media partition's start */
+static uint8_t model[2 * AREA];
+
+static void random_ops(flash_io_t *f, uint32_t ops)
+{
+    static uint8_t buf[MAX_OP], got[MAX_OP];
+    uint32_t bad = 0, erases = 0, writes = 0, reads = 0;
+
+    /* start from a known state */
+    CHECK(0 == flash_io_erase(f, AREA_START, sizeof(model)), "random: erase");
+    memset(model, 0xff, sizeof(model));
+
+    for (uint32_t i = 0; i < ops; i++) {
+        uint32_t kind = xorshift(&seed) % 8;
+        if (0 == kind) {
+            uint32_t sector = xorshift(&seed) % (sizeof(model) / FLASH_IO_SECTOR);
+            uint32_t n = 1 + xorshift(&seed) % 2;
+            n = sector + n <= sizeof(model) / FLASH_IO_SECTOR ? n : 1;
+            CHECK(0 == flash_io_erase(f, AREA_START + sector * FLASH_IO_SECTOR, n * FLASH_IO_SECTOR),
+                  "random: erase %u sectors at %#x", n, AREA_START + sector * FLASH_IO_SECTOR);
+            memset(model + sector * FLASH_IO_SECTOR, 0xff, n * FLASH_IO_SECTOR);
+            erases++;
+            continue;
+        }
+        uint32_t len = 1 + xorshift(&seed) % MAX_OP;
+        uint32_t at = xorshift(&seed) % (sizeof(model) - len);
+        if (kind < 4) {
+            for (uint32_t k = 0; k < len; k++) {
+                buf[k] = xorshift(&seed);
+            }
+            CHECK(0 == flash_io_write(f, AREA_START + at, buf, len), "random: write %u at %#x", len, AREA_START + at);
+            for (uint32_t k = 0; k < len; k++) {
+                model[at + k] &= buf[k];
+            }
+            writes++;
+            continue;
+        }
+        static const flash_io_path_t paths[] = {FLASH_IO_AUTO, FLASH_IO_XIP, FLASH_IO_RPC};
+        for (uint32_t p = 0; p < 3; p++) {
+            int mapped = AREA_START + at >= FLASH_IO_MEDIA_OFFSET;
+            memset(got, 0x5a, len);
+            int ret = flash_io_read_via(f, paths[p], AREA_START + at, got, len);
+            if (FLASH_IO_XIP == paths[p] && !mapped) {
+                CHECK(0 != ret, "random: xip read of unmapped %#x", AREA_START + at);
+                continue;
+            }
+            CHECK(0 == ret, "random: read %u at %#x, path %d", len, AREA_START + at, paths[p]);
+            bad += 0 != memcmp(got, model + at, len);
+        }
+        reads++;
+    }
+    CHECK(0 == bad, "random: %u reads differ from the model", bad);
+    CHECK(0 == flash_io_sync(f), "random: sync");
+    printf("random: %u erases, %u writes, %u reads on 3 paths, %u xip / %u rpc reads, %u KB invalidated\n", erases,
+           writes, reads, f->xip_reads, f->rpc_reads, f->invalidated >> 10);
+}
+
+static void stale(flash_io_t *f)
+{
+    uint32_t at = FLASH_IO_MEDIA_OFFSET + 64 * 1024;
+    uint8_t a[64], b[64];
+
+    memset(a, 0x11, sizeof(a));
+    CHECK(0 == flash_io_erase(f, at, FLASH_IO_SECTOR), "stale: erase");
+    CHECK(0 == flash_port_write(at, a, sizeof(a)), "stale: write behind flash_io");
+    CHECK(0 == flash_io_read_via(f, FLASH_IO_XIP, at, b, sizeof(b)), "stale: xip read");
+    CHECK(0 != memcmp(a, b, sizeof(a)), "stale: xip window saw a write nobody invalidated");
+    CHECK(0 == flash_io_read_via(f, FLASH_IO_RPC, at, b, sizeof(b)), "stale: rpc read");
+    CHECK(0 == memcmp(a, b, sizeof(a)), "stale: rpc read misses the write");
+
+    memset(a, 0x01, sizeof(a));
+    CHECK(0 == flash_io_write(f, at, a, sizeof(a)), "stale: write");
+    CHECK(0 == flash_io_read(f, at, b, sizeof(b)) && 0 == memcmp(a, b, sizeof(a)),
+          "stale: auto read after a flash_io write");
+    CHECK(f->xip_reads > 0 && 0 == memcmp(flash_io_xip_addr(f, at, sizeof(a)), a, sizeof(a)),
+          "stale: xip window after a flash_io write");
+    printf("stale: xip stale until invalidated, fresh after flash_io_write()\n");
+}
+
+typedef struct {
+    flash_io_t *f;
+    uint32_t reads, rpc, ok;
+} inflight_t;
+
+static void read_during_write(void *arg)
+{
+    inflight_t *in = arg;
+    uint8_t buf[32];
+    uint32_t xip = in->f->xip_reads, rpc = in->f->rpc_reads;
+
+    in->reads++;
+    flash_file.during_write = NULL; /* the read must not recurse into itself */
+    in->ok += 0 == flash_io_read(in->f, FLASH_IO_MEDIA_OFFSET, buf, sizeof(buf));
+    in->rpc += in->f->xip_reads == xip && in->f->rpc_reads == rpc + 1;
+    flash_file.during_write = read_during_write;
+}
+
+static void inflight(flash_io_t *f)
+{
+    inflight_t in = {.f = f};
+    uint8_t buf[32];
+
+    memset(buf, 0, sizeof(buf));
+    flash_file.during_write = read_during_write;
+    flash_file.during_write_arg = &in;
+    CHECK(0 == flash_io_erase(f, FLASH_IO_MEDIA_OFFSET + 128 * 1024, FLASH_IO_SECTOR), "inflight: erase");
+    CHECK(0 == flash_io_write(f, FLASH_IO_MEDIA_OFFSET + 128 * 1024, buf, sizeof(buf)), "inflight: write");
+    flash_file.during_write = NULL;
+    CHECK(2 == in.reads && 2 == in.ok, "inflight: %u of %u reads in flight worked", in.ok, in.reads);
+    CHECK(in.rpc == in.reads, "inflight: %u of %u reads in flight took rpc", in.rpc, in.reads);
+
+    uint32_t rpc = f->rpc_reads;
+    CHECK(0 == flash_io_read(f, FLASH_IO_MEDIA_OFFSET, buf, sizeof(buf)) && f->rpc_reads == rpc,
+          "inflight: read after the write still went over rpc");
+    printf("inflight: %u reads during erase/write, all over rpc\n", in.reads);
+}
+
+static void edges(flash_io_t *f)
+{
+    uint8_t buf[16];
+    uint32_t end = FLASH_IO_MEDIA_OFFSET + (FLASH_SIZE - FLASH_IO_MEDIA_OFFSET);
+
+    CHECK(0 != flash_io_erase(f, FLASH_IO_MEDIA_OFFSET + 100, FLASH_IO_SECTOR), "edges: unaligned erase start");
+    CHECK(0 != flash_io_erase(f, FLASH_IO_MEDIA_OFFSET, 100), "edges: unaligned erase length");
+    CHECK(0 != flash_io_read_via(f, FLASH_IO_XIP, FLASH_IO_MEDIA_OFFSET - 8, buf, sizeof(buf)),
+          "edges: xip read starting before the window");
+    CHECK(0 == flash_io_read(f, FLASH_IO_MEDIA_OFFSET - 8, buf, sizeof(buf)), "edges: auto read across the start");
+    CHECK(NULL == flash_io_xip_addr(f, FLASH_IO_MEDIA_OFFSET - 8, 16), "edges: xip address before the window");
+    CHECK(NULL == flash_io_xip_addr(f, end - 8, 16), "edges: xip address past the window");
+    CHECK(NULL != flash_io_xip_addr(f, end - 16, 16), "edges: xip address of the window's last bytes");
+    CHECK(0 != flash_io_read(f, end - 8, buf, sizeof(buf)), "edges: read past the flash");
+    printf("edges: done\n");
+}
+
+static void bench(flash_io_t *f, uint32_t mb, uint32_t block)
+{
+    static const struct {
+        const char *name;
+        flash_io_path_t path;
+    } runs[] = {
+        {"xip", FLASH_IO_XIP},
+        {"rpc", FLASH_IO_RPC},
+        {"auto", FLASH_IO_AUTO},
+    };
+    uint8_t *buf = malloc(block);
+    uint32_t span = FLASH_SIZE - FLASH_IO_MEDIA_OFFSET;
+
+    for (uint32_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+        uint32_t calls = f->rpc_calls, total = mb << 20, done = 0;
+        double t = now_s();
+        while (done < total) {
+            uint32_t at = FLASH_IO_MEDIA_OFFSET + done % (span - span % block);
+            if (0 != flash_io_read_via(f, runs[r].path, at, buf, block)) {
+                CHECK(0, "bench: %s read at %#x", runs[r].name, at);
+                break;
+            }
+            done += block;
+        }
+        t = now_s() - t;
+        printf("bench: %-4s %u MB in %u byte reads, %.1f MB/s, %u rpc calls\n", runs[r].name, mb, block,
+               done / t / 1e6, f->rpc_calls - calls);
+    }
+    free(buf);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-o flash.bin] [-n ops] [-m bench MB] [-b read bytes] [-l rpc us] [-s seed] [-k]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = "/tmp/flash_io_check.bin";
+    uint32_t ops = 5000, mb = 64, block = 4096, rpc_us = 0;
+    int keep = 0, opt;
+
+    while ((opt = getopt(argc, argv, "o:n:m:b:l:s:kh")) != -1) {
+        switch (opt) {
+            case 'o':
+                path = optarg;
+                break;
+            case 'n':
+                ops = strtoul(optarg, NULL, 0);
+                break;
+            case 'm':
+                mb = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                block = strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                rpc_us = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keep = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed || 0 == block || block > 1024 * 1024) {
+        usage(argv[0]);
+        return 2;
+    }
+    unlink(path);
+    if (0 != flash_file_open(path, FLASH_SIZE)) {
+        return 1;
+    }
+    flash_io_t *f = flash_io_get();
+
+    random_ops(f, ops);
+    stale(f);
+    inflight(f);
+    edges(f);
+    flash_file.rpc_us = rpc_us;
+    bench(f, mb, block);
+
+    flash_file_close();
+    if (!keep) {
+        unlink(path);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
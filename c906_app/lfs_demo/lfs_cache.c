@@ -0,0 +1,266 @@
+#include <string.h>
+
+#include "lfs_cache.h"
+
+int lfs_cache_init(lfs_cache_t *c, flash_io_t *io, uint32_t offset, uint32_t blocks, uint32_t lines,
+                   uint32_t prefetch, int write_back, uint8_t *mem)
+{
+    memset(c, 0, sizeof(*c));
+    if (0 == lines || lines > LFS_CACHE_MAX_LINES || NULL == mem || (offset & (LFS_CACHE_BLOCK - 1))) {
+        return -1;
+    }
+    c->io = io;
+    c->offset = offset;
+    c->blocks = blocks;
+    c->lines = lines;
+    c->prefetch = prefetch;
+    c->write_back = write_back;
+    for (uint32_t i = 0; i < lines; i++) {
+        c->line[i].data = mem + i * LFS_CACHE_BLOCK;
+    }
+    lfs_cache_drop(c);
+    return 0;
+}
+
+void lfs_cache_drop(lfs_cache_t *c)
+{
+    for (uint32_t i = 0; i < c->lines; i++) {
+        c->line[i].block = LFS_CACHE_NONE;
+        c->line[i].prefetched = 0;
+    }
+    c->dirty = -1;
+    c->last_miss = LFS_CACHE_NONE;
+}
+
+void lfs_cache_reset_stats(lfs_cache_t *c)
+{
+    c->reads = c->hits = c->misses = c->prefetches = c->prefetch_hits = 0;
+    c->progs = c->writes = c->erases = c->syncs = c->evictions = c->errors = 0;
+}
+
+static int find(lfs_cache_t *c, uint32_t block)
+{
+    for (uint32_t i = 0; i < c->lines; i++) {
+        if (c->line[i].block == block) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void touch(lfs_cache_t *c, int i)
+{
+    c->line[i].used = ++c->clock;
+}
+
+/* writes the dirty range out; a line that failed to is dropped, its copy may no longer match */
+static int flush(lfs_cache_t *c)
+{
+    lfs_cache_line_t *l;
+
+    if (c->dirty < 0) {
+        return 0;
+    }
+    l = &c->line[c->dirty];
+    c->dirty = -1;
+    c->writes++;
+    if (0 != flash_io_write(c->io, c->offset + l->block * LFS_CACHE_BLOCK + c->dirty_lo, l->data + c->dirty_lo,
+                            c->dirty_hi - c->dirty_lo)) {
+        c->errors++;
+        l->block = LFS_CACHE_NONE;
+        return -1;
+    }
+    return 0;
+}
+
+/* a line for block: a free one or the least recently used, never the dirty one when keep_dirty */
+static int victim(lfs_cache_t *c, uint32_t block, int keep_dirty)
+{
+    int best = -1;
+
+    for (uint32_t i = 0; i < c->lines; i++) {
+        if (keep_dirty && (int)i == c->dirty) {
+            continue;
+        }
+        if (LFS_CACHE_NONE == c->line[i].block) {
+            best = i;
+            break;
+        }
+        if (best < 0 || c->line[i].used < c->line[best].used) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return -1;
+    }
+    if (best == c->dirty && 0 != flush(c)) {
+        return -1;
+    }
+    if (LFS_CACHE_NONE != c->line[best].block) {
+        c->evictions++;
+    }
+    c->line[best].block = block;
+    c->line[best].prefetched = 0;
+    touch(c, best);
+    return best;
+}
+
+static int fill(lfs_cache_t *c, int i)
+{
+    lfs_cache_line_t *l = &c->line[i];
+
+    if (0 != flash_io_read(c->io, c->offset + l->block * LFS_CACHE_BLOCK, l->data, LFS_CACHE_BLOCK)) {
+        c->errors++;
+        l->block = LFS_CACHE_NONE;
+        return -1;
+    }
+    return 0;
+}
+
+/* the line holding block, read in on a miss */
+static int load(lfs_cache_t *c, uint32_t block)
+{
+    int i = victim(c, block, 0);
+
+    return i >= 0 && 0 == fill(c, i) ? i : -1;
+}
+
+static void read_ahead(lfs_cache_t *c, uint32_t block)
+{
+    /* at most half the cache, or a long file read would push everything else out */
+    uint32_t n = c->prefetch < c->lines / 2 ? c->prefetch : c->lines / 2;
+
+    for (uint32_t b = block + 1; b <= block + n && b < c->blocks; b++) {
+        if (find(c, b) >= 0) {
+            continue;
+        }
+        int i = victim(c, b, 1);
+        if (i < 0 || 0 != fill(c, i)) {
+            return;
+        }
+        c->line[i].prefetched = 1;
+        c->prefetches++;
+    }
+}
+
+int lfs_cache_read(lfs_cache_t *c, uint32_t block, uint32_t off, void *dst, uint32_t len)
+{
+    int i;
+
+    c->reads++;
+    if (block >= c->blocks || off > LFS_CACHE_BLOCK || len > LFS_CACHE_BLOCK - off) {
+        return -1;
+    }
+    if ((i = find(c, block)) >= 0) {
+        c->hits++;
+        if (c->line[i].prefetched) {
+            /* the read ahead paid off, keep going from here */
+            c->prefetch_hits++;
+            c->line[i].prefetched = 0;
+            c->last_miss = block;
+        }
+        touch(c, i);
+    } else {
+        int sequential = LFS_CACHE_NONE != c->last_miss && block == c->last_miss + 1;
+        c->misses++;
+        c->last_miss = block;
+        if ((i = load(c, block)) < 0) {
+            return -1;
+        }
+        if (sequential && c->prefetch) {
+            read_ahead(c, block);
+        }
+    }
+    memcpy(dst, c->line[i].data + off, len);
+    return 0;
+}
+
+int lfs_cache_prog(lfs_cache_t *c, uint32_t block, uint32_t off, const void *src, uint32_t len)
+{
+    const uint8_t *s = src;
+    int i;
+
+    c->progs++;
+    if (block >= c->blocks || off > LFS_CACHE_BLOCK || len > LFS_CACHE_BLOCK - off) {
+        return -1;
+    }
+    if (!c->write_back) {
+        int ret = flash_io_write(c->io, c->offset + block * LFS_CACHE_BLOCK + off, src, len);
+        c->writes++;
+        if ((i = find(c, block)) >= 0) {
+            for (uint32_t k = 0; k < len; k++) {
+                c->line[i].data[off + k] &= s[k];
+            }
+            if (0 != ret) {
+                c->line[i].block = LFS_CACHE_NONE;
+            }
+        }
+        if (0 != ret) {
+            c->errors++;
+            return -1;
+        }
+        return 0;
+    }
+
+    if ((i = find(c, block)) < 0 && (i = load(c, block)) < 0) {
+        return -1;
+    }
+    /* one dirty block at a time, the flash sees the progs in order */
+    if (c->dirty >= 0 && c->dirty != i && 0 != flush(c)) {
+        return -1;
+    }
+    for (uint32_t k = 0; k < len; k++) {
+        c->line[i].data[off + k] &= s[k];
+    }
+    if (c->dirty < 0) {
+        c->dirty = i;
+        c->dirty_lo = off;
+        c->dirty_hi = off + len;
+    } else {
+        c->dirty_lo = off < c->dirty_lo ? off : c->dirty_lo;
+        c->dirty_hi = off + len > c->dirty_hi ? off + len : c->dirty_hi;
+    }
+    c->line[i].prefetched = 0;
+    touch(c, i);
+    return 0;
+}
+
+int lfs_cache_erase(lfs_cache_t *c, uint32_t block)
+{
+    int i;
+
+    c->erases++;
+    if (block >= c->blocks) {
+        return -1;
+    }
+    /* progs queued before the erase reach the flash before it */
+    if (0 != flush(c)) {
+        return -1;
+    }
+    int ret = flash_io_erase(c->io, c->offset + block * LFS_CACHE_BLOCK, LFS_CACHE_BLOCK);
+    /* LittleFS progs an erased block next, have it cached without reading it */
+    if ((i = find(c, block)) < 0) {
+        i = victim(c, block, 0);
+    }
+    if (0 != ret) {
+        c->errors++;
+        if (i >= 0) {
+            c->line[i].block = LFS_CACHE_NONE;
+        }
+        return -1;
+    }
+    if (i >= 0) {
+        memset(c->line[i].data, 0xff, LFS_CACHE_BLOCK);
+        c->line[i].prefetched = 0;
+    }
+    return 0;
+}
+
+int lfs_cache_sync(lfs_cache_t *c)
+{
+    c->syncs++;
+    if (0 != flush(c)) {
+        return -1;
+    }
+    return flash_io_sync(c->io);
+}
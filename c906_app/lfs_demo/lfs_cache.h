@@ -0,0 +1,95 @@
+#ifndef __LFS_CACHE_H__
+#define __LFS_CACHE_H__
+
+#include <stdint.h>
+
+#include "flash_io.h"
+
+/*
+ * LittleFS block device over flash_io with a cache of whole blocks in
+ * front of it. LittleFS comes back to the same few blocks all the time
+ * (superblock, directory logs, a small file's one block); each is read
+ * once and then served from RAM:
+ *
+ *   read    hit: memcpy; miss: the whole block from flash (XIP where mapped),
+ *           the least recently used line making room, and if the miss
+ *           follows the one before it (a file read front to back) the next
+ *           `prefetch` blocks along with it
+ *   prog    write-through: to flash at once, the cached copy kept in step;
+ *           write-back: into the cached copy only, written out on sync, on
+ *           eviction, or before any other block is changed
+ *   erase   to flash at once, the block cached as 0xff without reading it
+ *   sync    writes the dirty block out
+ *
+ * Only one block is dirty at a time, so flash sees the progs in the order
+ * LittleFS issued them and a power loss leaves it as it would have been
+ * without the cache at some earlier point: everything up to the last sync
+ * is there, LittleFS syncs at the end of every commit. Writes a block gets
+ * between syncs (LittleFS appending to a directory log in prog_size steps)
+ * go out as one flash write.
+ *
+ * Progs are ANDed into the cached copy, as NOR programming does to the
+ * flash, so the copy never disagrees with what is really there.
+ */
+
+#define LFS_CACHE_BLOCK (FLASH_IO_SECTOR)
+#define LFS_CACHE_MAX_LINES (32)
+#define LFS_CACHE_NONE (0xffffffff)
+
+typedef struct {
+    uint32_t block; /* LFS_CACHE_NONE when free */
+    uint32_t used;  /* LRU stamp */
+    uint8_t prefetched; /* read ahead, not asked for yet */
+    uint8_t *data;
+} lfs_cache_line_t;
+
+typedef struct {
+    flash_io_t *io;
+    uint32_t offset; /* of block 0 in flash */
+    uint32_t blocks;
+    uint32_t lines;
+    uint32_t prefetch;  /* blocks read ahead on a sequential miss, may be changed at any time */
+    int write_back;     /* may be changed after lfs_cache_sync() */
+
+    lfs_cache_line_t line[LFS_CACHE_MAX_LINES];
+    uint32_t clock;
+    uint32_t last_miss;
+    int dirty; /* line index, -1 if none */
+    uint32_t dirty_lo, dirty_hi;
+
+    uint32_t reads;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t prefetches;    /* blocks read ahead */
+    uint32_t prefetch_hits; /* of those, asked for later */
+    uint32_t progs;
+    uint32_t writes; /* flash writes the progs turned into */
+    uint32_t erases;
+    uint32_t syncs;
+    uint32_t evictions;
+    uint32_t errors;
+} lfs_cache_t;
+
+/*
+ * blocks of LFS_CACHE_BLOCK bytes from flash offset, lines of them cached
+ * in mem (lines * LFS_CACHE_BLOCK bytes, the caller's). Returns 0 or -1.
+ */
+int lfs_cache_init(lfs_cache_t *c, flash_io_t *io, uint32_t offset, uint32_t blocks, uint32_t lines,
+                   uint32_t prefetch, int write_back, uint8_t *mem);
+
+/* Each returns 0 or -1. */
+int lfs_cache_read(lfs_cache_t *c, uint32_t block, uint32_t off, void *dst, uint32_t len);
+int lfs_cache_prog(lfs_cache_t *c, uint32_t block, uint32_t off, const void *src, uint32_t len);
+int lfs_cache_erase(lfs_cache_t *c, uint32_t block);
+int lfs_cache_sync(lfs_cache_t *c);
+
+/* Forgets every line, a dirty one included: what a reset does to the cache. */
+void lfs_cache_drop(lfs_cache_t *c);
+
+void lfs_cache_reset_stats(lfs_cache_t *c);
+
+/* lfs_cache_lfs.c: points cfg's read/prog/erase/sync at c and fills in the geometry */
+struct lfs_config;
+void lfs_cache_lfs_config(lfs_cache_t *c, struct lfs_config *cfg);
+
+#endif /* __LFS_CACHE_H__ */
@@ -0,0 +1,36 @@
+/* littlefs */
+#include <lfs.h>
+
+#include "lfs_cache.h"
+
+static int bd_read(const struct lfs_config *cfg, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    return 0 == lfs_cache_read(cfg->context, block, off, buffer, size) ? 0 : LFS_ERR_IO;
+}
+
+static int bd_prog(const struct lfs_config *cfg, lfs_block_t block, lfs_off_t off, const void *buffer,
+                   lfs_size_t size)
+{
+    return 0 == lfs_cache_prog(cfg->context, block, off, buffer, size) ? 0 : LFS_ERR_IO;
+}
+
+static int bd_erase(const struct lfs_config *cfg, lfs_block_t block)
+{
+    return 0 == lfs_cache_erase(cfg->context, block) ? 0 : LFS_ERR_IO;
+}
+
+static int bd_sync(const struct lfs_config *cfg)
+{
+    return 0 == lfs_cache_sync(cfg->context) ? 0 : LFS_ERR_IO;
+}
+
+void lfs_cache_lfs_config(lfs_cache_t *c, struct lfs_config *cfg)
+{
+    cfg->context = c;
+    cfg->read = bd_read;
+    cfg->prog = bd_prog;
+    cfg->erase = bd_erase;
+    cfg->sync = bd_sync;
+    cfg->block_size = LFS_CACHE_BLOCK;
+    cfg->block_count = c->blocks;
+}
@@ -1,61 +1,218 @@
-#include <errno.h>
-#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* FreeRTOS */
 #include <FreeRTOS.h>
 #include <task.h>
 
 /* aos */
-#include <aos/kernel.h>
 #include <cli.h>
-#include <vfs.h>
+
+/* utils */
+#include <utils_getopt.h>
 
 /* RISCV */
 #include <csi_core.h>
 
-/* m1s_lfs_c906 */
-#include <lfs_c906.h>
+/* littlefs */
+#include <lfs.h>
+
+#include "flash_io.h"
+#include "lfs_cache.h"
+
+/*
+ * LittleFS on the media partition through lfs_cache.c instead of
+ * m1s_lfs_c906's block device (which reads every block from flash each
+ * time); same partition and block size, so what m1s_lfs_c906 wrote as
+ * /lfs/boot_count is boot_count here. Only one of the two may have the
+ * partition mounted.
+ */
+#define LFS_DEMO_LINES (8)      /* 32 KB of blocks */
+#define LFS_DEMO_PREFETCH (2)
+#define LFS_DEMO_WRITE_BACK (1)
+#define FILE_NAME "boot_count"
+
+static lfs_t s_lfs;
+static int s_mounted;
+static lfs_cache_t s_cache;
+static uint8_t s_cache_mem[LFS_DEMO_LINES * LFS_CACHE_BLOCK];
+static struct lfs_config s_cfg = {
+    .read_size = 16,
+    .prog_size = 256, /* a NOR page */
+    .cache_size = 256,
+    .lookahead_size = 64,
+    .block_cycles = 500,
+};
 
 extern void cmd_c906_flash(char *buf, int len, int argc, char **argv);
+static void cmd_c906_lfscache(char *buf, int len, int argc, char **argv);
 const static struct cli_command cmds_user[] STATIC_CLI_CMD_ATTRIBUTE = {
     {"flash", "c906 flash command", cmd_c906_flash},
+    {"lfscache", "c906 lfs block cache command", cmd_c906_lfscache},
 };
 
-void main()
+static void lfs_cache_print(const lfs_cache_t *c)
+{
+    uint32_t pct = c->reads ? (uint64_t)c->hits * 100 / c->reads : 0;
+
+    printf("[lfscache] %u lines, prefetch %u, %s\r\n", c->lines, c->prefetch,
+           c->write_back ? "write-back" : "write-through");
+    printf("[lfscache] reads %u: %u hits (%u%%), %u misses, %u prefetched, %u of them used\r\n", c->reads, c->hits,
+           pct, c->misses, c->prefetches, c->prefetch_hits);
+    printf("[lfscache] progs %u as %u flash writes, %u erases, %u syncs, %u evictions, %u errors\r\n", c->progs,
+           c->writes, c->erases, c->syncs, c->evictions, c->errors);
+}
+
+/* reads a whole file through LittleFS, to see what the cache makes of it */
+static void lfs_cat(const char *path)
 {
-    lfs_register();
+    static uint8_t buf[512];
+    lfs_file_t file;
+    uint32_t total = 0, sum = 0;
+    int n;
 
-    int fd = -1;
+    if (lfs_file_open(&s_lfs, &file, path, LFS_O_RDONLY) < 0) {
+        printf("[lfscache] %s not found\r\n", path);
+        return;
+    }
+    uint64_t t0 = CPU_Get_MTimer_US();
+    while ((n = lfs_file_read(&s_lfs, &file, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < n; i++) {
+            sum += buf[i];
+        }
+        total += n;
+    }
+    uint64_t us = CPU_Get_MTimer_US() - t0;
+    lfs_file_close(&s_lfs, &file);
+    printf("[lfscache] %s: %u bytes in %lu us, sum %08x\r\n", path, total, (unsigned long)us, sum);
+}
+
+static void print_usage()
+{
+    printf("Usage: lfscache <-r<path>> <-p<blocks>> <-w<0|1>> <-s> <-z>\r\n");
+    printf("       lfscache -F\r\n");
+    printf("\tprints the block cache counters of the lfs mount\r\n");
+    printf("\t-r reads <path> through lfs first\r\n");
+    printf("\t-p read ahead <blocks> on sequential misses, %u by default\r\n", LFS_DEMO_PREFETCH);
+    printf("\t-w 1 write-back, 0 write-through; switching syncs first\r\n");
+    printf("\t-s writes back the dirty block\r\n");
+    printf("\t-z zeroes the counters\r\n");
+    printf("\t-F formats the media partition, only when it failed to mount; everything on it is lost\r\n");
+    printf("\r\n");
+}
+
+/* never on its own: a mount can fail on a filesystem that is still there, a bad read, another layout */
+static void lfs_format_mount(void)
+{
+    int ret;
+
+    if (0 != (ret = lfs_format(&s_lfs, &s_cfg)) || 0 != (ret = lfs_mount(&s_lfs, &s_cfg))) {
+        printf("[lfscache] format failed: %d\r\n", ret);
+        return;
+    }
+    s_mounted = 1;
+    printf("[lfscache] media partition formatted and mounted\r\n");
+}
+
+static void cmd_c906_lfscache(char *buf, int len, int argc, char **argv)
+{
+    int opt;
+    getopt_env_t getopt_env;
+
+    if (2 == argc && 0 == strcmp(argv[1], "-F")) {
+        if (s_mounted) {
+            printf("[lfscache] lfs is mounted, not formatting it\r\n");
+        } else {
+            lfs_format_mount();
+        }
+        return;
+    }
+    if (!s_mounted) {
+        printf("[lfscache] lfs not mounted\r\n");
+        return;
+    }
+    utils_getopt_init(&getopt_env, 0);
+    // put ':' in the starting of the string so that program can distinguish
+    // between '?' and ':'
+    while ((opt = utils_getopt(&getopt_env, argc, argv, ":r:p:w:szh")) != -1) {
+        switch (opt) {
+            case 'r':
+                lfs_cat(getopt_env.optarg);
+                break;
+            case 'p':
+                s_cache.prefetch = strtoul(getopt_env.optarg, NULL, 0);
+                break;
+            case 'w':
+                if (0 != lfs_cache_sync(&s_cache)) {
+                    printf("[lfscache] sync error\r\n");
+                    return;
+                }
+                s_cache.write_back = 0 != strtoul(getopt_env.optarg, NULL, 0);
+                break;
+            case 's':
+                if (0 != lfs_cache_sync(&s_cache)) {
+                    printf("[lfscache] sync error\r\n");
+                }
+                break;
+            case 'z':
+                lfs_cache_reset_stats(&s_cache);
+                break;
+            case 'h':
+                print_usage();
+                return;
+            case ':':
+                // printf("%s: %c requires an argument\r\n", *argv, getopt_env.optopt);
+                break;
+            case '?':
+                // printf("unknow option: %c\r\n", getopt_env.optopt);
+                break;
+        }
+    }
+    lfs_cache_print(&s_cache);
+}
+
+void main()
+{
+    lfs_file_t file;
     int ret = -1;
-#define FILE_NAME "/lfs/boot_count"
+
+    lfs_cache_init(&s_cache, flash_io_get(), FLASH_IO_MEDIA_OFFSET, FLASH_IO_MEDIA_SIZE / LFS_CACHE_BLOCK,
+                   LFS_DEMO_LINES, LFS_DEMO_PREFETCH, LFS_DEMO_WRITE_BACK, s_cache_mem);
+    lfs_cache_lfs_config(&s_cache, &s_cfg);
+    if (0 != (ret = lfs_mount(&s_lfs, &s_cfg))) {
+        printf("[lfs] mount failed: %d, media partition left as it is; `lfscache -F` formats it\r\n", ret);
+        return;
+    }
+    s_mounted = 1;
+
     // read current count
     uint32_t boot_count = 0;
-    if ((fd = aos_open(FILE_NAME, O_RDWR | O_CREAT)) < 0) {
-        printf("%s not found!\r\n", FILE_NAME);
+    if ((ret = lfs_file_open(&s_lfs, &file, FILE_NAME, LFS_O_RDWR | LFS_O_CREAT)) < 0) {
+        printf("%s open error %d\r\n", FILE_NAME, ret);
         return;
     }
-    ret = aos_read(fd, &boot_count, sizeof(boot_count));
+    ret = lfs_file_read(&s_lfs, &file, &boot_count, sizeof(boot_count));
     if (ret < 0) {
         printf("read error %d\r\n", ret);
         return;
     }
     // update boot count
     boot_count += 1;
-    ret = aos_lseek(fd, 0, SEEK_SET);
+    ret = lfs_file_rewind(&s_lfs, &file);
     if (ret != 0) {
-        printf("lseek error %d\r\n", ret);
+        printf("rewind error %d\r\n", ret);
         return;
     }
-    ret = aos_write(fd, &boot_count, sizeof(boot_count));
+    ret = lfs_file_write(&s_lfs, &file, &boot_count, sizeof(boot_count));
     if (ret < 0) {
         printf("write error %d\r\n", ret);
         return;
     }
-    aos_close(fd);
+    // the close commits and syncs, write-back included
+    lfs_file_close(&s_lfs, &file);
 
     // print the boot count
     printf("boot_count: %d\r\n", boot_count);
-
-    lfs_unregister();
-}
\ No newline at end of file
+    lfs_cache_print(&s_cache);
+}
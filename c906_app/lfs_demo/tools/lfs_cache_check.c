@@ -0,0 +1,269 @@
+/*
+ * lfs_cache_check - lfs_cache.c against a model of the flash, no LittleFS needed.
+ *
+ * Random reads, progs, erases and syncs go through the cache and into the
+ * model (NOR rules), over the file-backed flash of flash_demo/tools, for
+ * every mix of lines, read ahead and write-back:
+ *
+ *   reads      always what the model says, dirty blocks included
+ *   power      now and then the cache is dropped unsynced, as a reset
+ *              would; the flash must then hold the model as it was after
+ *              some op since the last sync, in order, nothing after a later
+ *              op without everything before it. That is what keeps
+ *              LittleFS consistent on top (lfs_power_check runs LittleFS
+ *              itself)
+ *   counters   one miss for a block read over and over, read ahead turning
+ *              a front to back read into a third of the misses, write-back
+ *              turning a block's page progs into a single flash write
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -I../../flash_demo/tools -o lfs_cache_check lfs_cache_check.c ../lfs_cache.c ../flash_io.c \
+ *       ../../flash_demo/tools/flash_file.c
+ *   ./lfs_cache_check -n 20000
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "flash_file.h"
+#include "lfs_cache.h"
+
+#define BLOCKS (64)
+#define SIZE (BLOCKS * LFS_CACHE_BLOCK)
+#define FLASH_SIZE (FLASH_IO_MEDIA_OFFSET + SIZE)
+#define HOT (6)     /* blocks most ops go to, so lines get reused */
+#define WINDOW (24) /* most ops between syncs */
+
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static uint8_t s_mem[LFS_CACHE_MAX_LINES * LFS_CACHE_BLOCK];
+static uint8_t model[SIZE];
+/* the model after each op since the last sync, [0] as of the sync */
+static uint8_t snap[WINDOW + 1][SIZE];
+static uint32_t snaps;
+
+static void snap_take(int reset)
+{
+    if (reset) {
+        snaps = 0;
+    }
+    memcpy(snap[snaps++], model, SIZE);
+}
+
+/* after a power loss: which of the snapshots the flash holds, -1 if none */
+static int flash_state(void)
+{
+    static uint8_t flash[SIZE];
+
+    flash_port_read(FLASH_IO_MEDIA_OFFSET, flash, SIZE);
+    for (int i = snaps - 1; i >= 0; i--) {
+        if (0 == memcmp(flash, snap[i], SIZE)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void random_ops(uint32_t lines, uint32_t prefetch, int write_back, uint32_t ops)
+{
+    lfs_cache_t c;
+    flash_io_t *io = flash_io_get();
+    static uint8_t buf[LFS_CACHE_BLOCK];
+    uint32_t bad = 0, cuts = 0, lost = 0, since_sync = 0;
+    uint32_t cursor[HOT] = {0};
+
+    CHECK(0 == lfs_cache_init(&c, io, FLASH_IO_MEDIA_OFFSET, BLOCKS, lines, prefetch, write_back, s_mem),
+          "random: init");
+    for (uint32_t b = 0; b < BLOCKS; b++) {
+        lfs_cache_erase(&c, b);
+    }
+    lfs_cache_sync(&c);
+    memset(model, 0xff, sizeof(model));
+    snap_take(1);
+
+    for (uint32_t i = 0; i < ops; i++) {
+        uint32_t kind = xorshift(&seed) % 16;
+        uint32_t h = xorshift(&seed) % HOT;
+        uint32_t block = xorshift(&seed) % 4 ? h * 7 % BLOCKS : xorshift(&seed) % BLOCKS;
+
+        if (kind < 7) {
+            uint32_t off = xorshift(&seed) % LFS_CACHE_BLOCK;
+            uint32_t len = 1 + xorshift(&seed) % (LFS_CACHE_BLOCK - off);
+            CHECK(0 == lfs_cache_read(&c, block, off, buf, len), "random: read");
+            bad += 0 != memcmp(buf, model + block * LFS_CACHE_BLOCK + off, len);
+            continue;
+        }
+        if (kind == 15 && 0 == xorshift(&seed) % 8) {
+            /* a reset: RAM gone, the flash as it is */
+            int state = flash_state();
+            CHECK(state >= 0, "random: after a power loss the flash holds none of the %u states since the sync",
+                  snaps);
+            lost += snaps - 1 - (state >= 0 ? state : 0);
+            lfs_cache_drop(&c);
+            flash_port_read(FLASH_IO_MEDIA_OFFSET, model, SIZE);
+            snap_take(1);
+            since_sync = 0;
+            cuts++;
+            continue;
+        }
+        if (kind >= 13 || since_sync == WINDOW - 1) {
+            CHECK(0 == lfs_cache_sync(&c), "random: sync");
+            CHECK(0 == flash_state() - (int)(snaps - 1), "random: synced flash differs from the model");
+            snap_take(1);
+            since_sync = 0;
+            continue;
+        }
+        if (kind == 12) {
+            CHECK(0 == lfs_cache_erase(&c, block), "random: erase");
+            memset(model + block * LFS_CACHE_BLOCK, 0xff, LFS_CACHE_BLOCK);
+        } else {
+            /* mostly appends to a hot block, the way LittleFS extends a log */
+            uint32_t len = 1 + xorshift(&seed) % 512, off;
+            if (block == h * 7 % BLOCKS && cursor[h] + len <= LFS_CACHE_BLOCK) {
+                off = cursor[h];
+                cursor[h] += len;
+            } else {
+                off = xorshift(&seed) % (LFS_CACHE_BLOCK - len);
+            }
+            for (uint32_t k = 0; k < len; k++) {
+                buf[k] = xorshift(&seed) | (xorshift(&seed) & 1 ? 0x80 : 0);
+            }
+            CHECK(0 == lfs_cache_prog(&c, block, off, buf, len), "random: prog");
+            for (uint32_t k = 0; k < len; k++) {
+                model[block * LFS_CACHE_BLOCK + off + k] &= buf[k];
+            }
+        }
+        snap_take(0);
+        since_sync++;
+    }
+    CHECK(0 == bad, "random: %u reads differ from the model", bad);
+    CHECK(0 == c.errors, "random: %u errors", c.errors);
+    printf("random: %2u lines, prefetch %u, %-13s %u%% hits, %u progs as %u writes, %u power losses (%u ops lost)\n",
+           lines, prefetch, write_back ? "write-back," : "write-through,",
+           c.reads ? (uint32_t)((uint64_t)c.hits * 100 / c.reads) : 0, c.progs, c.writes, cuts, lost);
+}
+
+static void counters(void)
+{
+    lfs_cache_t c;
+    flash_io_t *io = flash_io_get();
+    static uint8_t buf[LFS_CACHE_BLOCK];
+    uint32_t reads;
+
+    lfs_cache_init(&c, io, FLASH_IO_MEDIA_OFFSET, BLOCKS, 8, 2, 1, s_mem);
+    reads = io->xip_reads + io->rpc_reads;
+    for (int i = 0; i < 100; i++) {
+        lfs_cache_read(&c, 3, i, buf, 16);
+    }
+    CHECK(1 == c.misses && 99 == c.hits, "counters: one block 100 times, %u misses", c.misses);
+    CHECK(1 == io->xip_reads + io->rpc_reads - reads, "counters: %u flash reads for one block",
+          io->xip_reads + io->rpc_reads - reads);
+
+    lfs_cache_drop(&c);
+    lfs_cache_reset_stats(&c);
+    for (uint32_t b = 0; b < 32; b++) {
+        lfs_cache_read(&c, b, 0, buf, LFS_CACHE_BLOCK);
+    }
+    CHECK(12 == c.misses && 20 == c.prefetch_hits, "counters: 32 blocks front to back, %u misses, %u read ahead",
+          c.misses, c.prefetch_hits);
+    printf("counters: 32 blocks in order, %u misses, %u read ahead and used\n", c.misses, c.prefetch_hits);
+
+    for (int wb = 0; wb < 2; wb++) {
+        lfs_cache_drop(&c);
+        lfs_cache_reset_stats(&c);
+        c.write_back = wb;
+        lfs_cache_erase(&c, 40);
+        for (uint32_t k = 0; k < 16; k++) {
+            memset(buf, k, 256);
+            lfs_cache_prog(&c, 40, k * 256, buf, 256);
+        }
+        lfs_cache_sync(&c);
+        CHECK((wb ? 1u : 16u) == c.writes, "counters: %s, 16 progs as %u writes", wb ? "write-back" : "write-through",
+              c.writes);
+        flash_port_read(FLASH_IO_MEDIA_OFFSET + 40 * LFS_CACHE_BLOCK + 15 * 256, buf, 256);
+        CHECK(15 == buf[0] && 15 == buf[255], "counters: the last prog isn't in flash");
+    }
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-o flash.bin] [-n ops] [-s seed] [-k]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        uint32_t lines, prefetch;
+        int write_back;
+    } mixes[] = {
+        {1, 0, 0}, {1, 0, 1}, {4, 0, 1}, {4, 2, 0}, {8, 2, 1}, {LFS_CACHE_MAX_LINES, 4, 1},
+    };
+    const char *path = "/tmp/lfs_cache_check.bin";
+    uint32_t ops = 20000;
+    int keep = 0, opt;
+
+    while ((opt = getopt(argc, argv, "o:n:s:kh")) != -1) {
+        switch (opt) {
+            case 'o':
+                path = optarg;
+                break;
+            case 'n':
+                ops = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keep = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        usage(argv[0]);
+        return 2;
+    }
+    unlink(path);
+    if (0 != flash_file_open(path, FLASH_SIZE)) {
+        return 1;
+    }
+
+    for (uint32_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+        random_ops(mixes[m].lines, mixes[m].prefetch, mixes[m].write_back, ops);
+    }
+    counters();
+
+    flash_file_close();
+    if (!keep) {
+        unlink(path);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
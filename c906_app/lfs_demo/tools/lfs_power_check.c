@@ -0,0 +1,291 @@
+/*
+ * lfs_power_check - LittleFS on lfs_cache.c on the file-backed flash, with the
+ * power cut at random points.
+ *
+ * Every round mounts, checks every file, then rewrites, creates and
+ * removes files until the power goes at a random erase or write (torn
+ * halfway, nothing after it reaches the flash). Then a "reboot": the cache
+ * and the XIP window dropped, LittleFS state thrown away, mounted again.
+ *
+ *   mount      never fails after a power loss
+ *   files      each is whole (its header and every byte as written) and is
+ *              the version the last close that returned with the power on
+ *              left, or the one being written when it went
+ *   writable   the next round's changes work on what the last one left
+ *
+ * Runs with write-back and write-through, several cache sizes. Needs the
+ * littlefs sources (v2.x, the SDK's or upstream), LFS_DIR below.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -I../../flash_demo/tools -I$LFS_DIR -o lfs_power_check lfs_power_check.c ../lfs_cache.c \
+ *       ../lfs_cache_lfs.c ../flash_io.c ../../flash_demo/tools/flash_file.c $LFS_DIR/lfs.c $LFS_DIR/lfs_util.c
+ *   ./lfs_power_check -n 200
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lfs.h>
+
+#include "flash_file.h"
+#include "lfs_cache.h"
+
+#define BLOCKS (128)
+#define FLASH_SIZE (FLASH_IO_MEDIA_OFFSET + BLOCKS * LFS_CACHE_BLOCK)
+#define FILES (8)
+#define MAX_FILE (12 * 1024)
+#define MAGIC (0x4b43504c) /* "LPCK" */
+
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static lfs_t s_lfs;
+static lfs_cache_t s_cache;
+static uint8_t s_mem[LFS_CACHE_MAX_LINES * LFS_CACHE_BLOCK];
+static struct lfs_config s_cfg = {
+    .read_size = 16,
+    .prog_size = 256,
+    .cache_size = 256,
+    .lookahead_size = 16,
+    .block_cycles = 100,
+};
+
+/* seq of each file's version: what must be there, and what may be instead; 0 for no file */
+static uint32_t durable[FILES], pending[FILES];
+
+/* a file is a header and bytes that follow from it */
+static uint32_t fill(uint8_t *buf, uint32_t f, uint32_t seq)
+{
+    uint32_t s = f * 7919 + seq * 104729 + 1;
+    uint32_t len = 16 + xorshift(&s) % (MAX_FILE - 16);
+    uint32_t hdr[4] = {MAGIC, f, seq, len};
+
+    memcpy(buf, hdr, sizeof(hdr));
+    for (uint32_t i = sizeof(hdr); i < len; i++) {
+        buf[i] = xorshift(&s);
+    }
+    return len;
+}
+
+static int powered(uint32_t cuts)
+{
+    return flash_file.cuts == cuts;
+}
+
+/* the seq of file f as found, 0 if there is none, -1 if it is broken */
+static int64_t read_file(uint32_t f)
+{
+    static uint8_t got[MAX_FILE], want[MAX_FILE];
+    char path[16];
+    lfs_file_t file;
+    uint32_t hdr[4];
+
+    snprintf(path, sizeof(path), "f%u", f);
+    int err = lfs_file_open(&s_lfs, &file, path, LFS_O_RDONLY);
+    if (LFS_ERR_NOENT == err) {
+        return 0;
+    }
+    if (err < 0) {
+        return -1;
+    }
+    lfs_ssize_t n = lfs_file_read(&s_lfs, &file, got, sizeof(got));
+    lfs_file_close(&s_lfs, &file);
+    if (n < (lfs_ssize_t)sizeof(hdr)) {
+        return -1;
+    }
+    memcpy(hdr, got, sizeof(hdr));
+    if (MAGIC != hdr[0] || f != hdr[1] || 0 == hdr[2] || (uint32_t)n != fill(want, f, hdr[2]) ||
+        0 != memcmp(got, want, n)) {
+        return -1;
+    }
+    return hdr[2];
+}
+
+static int write_file(uint32_t f, uint32_t seq)
+{
+    static uint8_t buf[MAX_FILE];
+    char path[16];
+    lfs_file_t file;
+    uint32_t len = fill(buf, f, seq);
+
+    snprintf(path, sizeof(path), "f%u", f);
+    if (lfs_file_open(&s_lfs, &file, path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0) {
+        return -1;
+    }
+    /* in pieces, as an application writes */
+    for (uint32_t done = 0; done < len;) {
+        uint32_t n = 1 + xorshift(&seed) % 3000;
+        n = n < len - done ? n : len - done;
+        if ((lfs_ssize_t)n != lfs_file_write(&s_lfs, &file, buf + done, n)) {
+            lfs_file_close(&s_lfs, &file);
+            return -1;
+        }
+        done += n;
+    }
+    return lfs_file_close(&s_lfs, &file);
+}
+
+static int remove_file(uint32_t f)
+{
+    char path[16];
+
+    snprintf(path, sizeof(path), "f%u", f);
+    return lfs_remove(&s_lfs, path);
+}
+
+static void reboot(void)
+{
+    flash_file.cut_after = 0;
+    flash_io_invalidate(flash_io_get(), FLASH_IO_MEDIA_OFFSET, BLOCKS * LFS_CACHE_BLOCK);
+    lfs_cache_drop(&s_cache);
+    memset(&s_lfs, 0, sizeof(s_lfs));
+}
+
+/* mounts and checks every file against what may be there */
+static int check_files(uint32_t round)
+{
+    int err = lfs_mount(&s_lfs, &s_cfg);
+
+    CHECK(0 == err, "round %u: mount after a power loss: %d", round, err);
+    if (0 != err) {
+        return -1;
+    }
+    for (uint32_t f = 0; f < FILES; f++) {
+        int64_t seq = read_file(f);
+        CHECK(seq == durable[f] || seq == pending[f], "round %u: f%u is %lld, %u or %u expected", round, f,
+              (long long)seq, durable[f], pending[f]);
+        durable[f] = pending[f] = seq > 0 ? seq : 0;
+    }
+    return 0;
+}
+
+static void power_rounds(uint32_t lines, uint32_t prefetch, int write_back, uint32_t rounds)
+{
+    uint32_t next_seq = 1, ops = 0, torn = 0;
+
+    lfs_cache_init(&s_cache, flash_io_get(), FLASH_IO_MEDIA_OFFSET, BLOCKS, lines, prefetch, write_back, s_mem);
+    lfs_cache_lfs_config(&s_cache, &s_cfg);
+    memset(&s_lfs, 0, sizeof(s_lfs));
+    CHECK(0 == lfs_format(&s_lfs, &s_cfg), "format");
+    memset(durable, 0, sizeof(durable));
+    memset(pending, 0, sizeof(pending));
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        if (0 != check_files(round)) {
+            reboot();
+            continue;
+        }
+        uint32_t cuts = flash_file.cuts;
+        flash_file.cut_after = 1 + xorshift(&seed) % 600;
+        while (powered(cuts)) {
+            uint32_t f = xorshift(&seed) % FILES;
+            int ret;
+            if (xorshift(&seed) % 5) {
+                pending[f] = next_seq++;
+                ret = write_file(f, pending[f]);
+            } else {
+                pending[f] = 0;
+                ret = remove_file(f);
+                ret = LFS_ERR_NOENT == ret ? 0 : ret;
+            }
+            if (!powered(cuts)) {
+                torn++;
+                break;
+            }
+            CHECK(0 == ret, "round %u: f%u with the power on: %d", round, f, ret);
+            /* back with the power on: this version is the one now */
+            durable[f] = pending[f];
+            ops++;
+        }
+        reboot();
+    }
+    CHECK(0 == check_files(rounds), "final mount");
+    lfs_unmount(&s_lfs);
+    printf("power: %2u lines, prefetch %u, %-13s %u rounds, %u ops done, %u cut short, %u%% cache hits\n", lines,
+           prefetch, write_back ? "write-back," : "write-through,", rounds, ops, torn,
+           s_cache.reads ? (uint32_t)((uint64_t)s_cache.hits * 100 / s_cache.reads) : 0);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-o flash.bin] [-n rounds] [-s seed] [-k]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        uint32_t lines, prefetch;
+        int write_back;
+    } mixes[] = {
+        {1, 0, 1},
+        {4, 2, 0},
+        {8, 2, 1},
+        {LFS_CACHE_MAX_LINES, 4, 1},
+    };
+    const char *path = "/tmp/lfs_power_check.bin";
+    uint32_t rounds = 200;
+    int keep = 0, opt;
+
+    while ((opt = getopt(argc, argv, "o:n:s:kh")) != -1) {
+        switch (opt) {
+            case 'o':
+                path = optarg;
+                break;
+            case 'n':
+                rounds = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keep = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        usage(argv[0]);
+        return 2;
+    }
+    unlink(path);
+    if (0 != flash_file_open(path, FLASH_SIZE)) {
+        return 1;
+    }
+
+    for (uint32_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+        power_rounds(mixes[m].lines, mixes[m].prefetch, mixes[m].write_back, rounds);
+    }
+
+    flash_file_close();
+    if (!keep) {
+        unlink(path);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+#include <math.h>
+#include <string.h>
+
+#include "blai_postproc.h"
+
+#if defined(__riscv_vector) && !defined(PP_FORCE_SCALAR)
+#define PP_USE_RVV (1)
+#include <riscv_vector.h>
+#else
+#define PP_USE_RVV (0)
+#endif
+
+void pp_dequant_u8_ref(const uint8_t *q, float *out, uint32_t n, float scale, int zero_point)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = (float)((int)q[i] - zero_point) * scale;
+    }
+}
+
+void pp_softmax_ref(float *x, uint32_t n)
+{
+    if (0 == n) return;
+
+    float max = x[0];
+    for (uint32_t i = 1; i < n; i++) {
+        if (x[i] > max) max = x[i];
+    }
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+        x[i] = expf(x[i] - max);
+        sum += x[i];
+    }
+    float inv = 1.0f / sum;
+    for (uint32_t i = 0; i < n; i++) {
+        x[i] *= inv;
+    }
+}
+
+#if PP_USE_RVV
+void pp_dequant_u8(const uint8_t *q, float *out, uint32_t n, float scale, int zero_point)
+{
+    float zp = (float)zero_point;
+    for (size_t vl; n > 0; n -= vl, q += vl, out += vl) {
+        vl = vsetvl_e8m1(n);
+        vuint8m1_t v8 = vle8_v_u8m1(q, vl);
+        vuint16m2_t v16 = vwaddu_vx_u16m2(v8, 0, vl);
+        vuint32m4_t v32 = vwaddu_vx_u32m4(v16, 0, vl);
+        vfloat32m4_t vf = vfcvt_f_xu_v_f32m4(v32, vl);
+        vf = vfsub_vf_f32m4(vf, zp, vl);
+        vf = vfmul_vf_f32m4(vf, scale, vl);
+        vse32_v_f32m4(out, vf, vl);
+    }
+}
+
+void pp_softmax(float *x, uint32_t n)
+{
+    if (0 == n) return;
+
+    size_t vl = vsetvl_e32m1(1);
+    vfloat32m1_t vmax = vfmv_v_f_f32m1(x[0], vl);
+    float *p = x;
+    for (uint32_t left = n; left > 0; left -= vl, p += vl) {
+        vl = vsetvl_e32m8(left);
+        vfloat32m8_t v = vle32_v_f32m8(p, vl);
+        vmax = vfredmax_vs_f32m8_f32m1(vmax, v, vmax, vl);
+    }
+    float max = vfmv_f_s_f32m1_f32(vmax);
+
+    /* no vector exp in the toolchain, keep it scalar */
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+        x[i] = expf(x[i] - max);
+        sum += x[i];
+    }
+
+    float inv = 1.0f / sum;
+    p = x;
+    for (uint32_t left = n; left > 0; left -= vl, p += vl) {
+        vl = vsetvl_e32m8(left);
+        vfloat32m8_t v = vle32_v_f32m8(p, vl);
+        vse32_v_f32m8(p, vfmul_vf_f32m8(v, inv, vl), vl);
+    }
+}
+#else
+void pp_dequant_u8(const uint8_t *q, float *out, uint32_t n, float scale, int zero_point)
+{
+    pp_dequant_u8_ref(q, out, n, scale, zero_point);
+}
+
+void pp_softmax(float *x, uint32_t n)
+{
+    pp_softmax_ref(x, n);
+}
+#endif
+
+/* insert (idx, score) into the sorted list out[0..cnt), dropping the tail at k */
+static inline uint32_t topk_insert(pp_class_t *out, uint32_t cnt, uint32_t k, uint32_t idx, float score)
+{
+    if (cnt == k && score <= out[k - 1].score) {
+        return cnt;
+    }
+
+    uint32_t pos = cnt < k ? cnt : k - 1;
+    while (pos > 0 && score > out[pos - 1].score) {
+        out[pos] = out[pos - 1];
+        pos--;
+    }
+    out[pos].idx = idx;
+    out[pos].score = score;
+    return cnt < k ? cnt + 1 : cnt;
+}
+
+uint32_t pp_topk(const float *x, uint32_t n, uint32_t k, pp_class_t *out)
+{
+    if (k > PP_TOPK_MAX) k = PP_TOPK_MAX;
+    if (0 == k) return 0;
+
+    uint32_t cnt = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        cnt = topk_insert(out, cnt, k, i, x[i]);
+    }
+    return cnt;
+}
+
+uint32_t pp_topk_u8(const uint8_t *q, uint32_t n, uint32_t k, float scale, int zero_point, pp_class_t *out)
+{
+    if (k > PP_TOPK_MAX) k = PP_TOPK_MAX;
+    if (0 == k) return 0;
+
+    /* select on the raw codes, the mapping is monotonic for a positive scale */
+    uint32_t cnt = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        cnt = topk_insert(out, cnt, k, i, (float)q[i]);
+    }
+    for (uint32_t i = 0; i < cnt; i++) {
+        out[i].score = (out[i].score - (float)zero_point) * scale;
+    }
+    return cnt;
+}
+
+void pp_ema_init(pp_ema_t *ema, float *state, uint32_t n, float alpha)
+{
+    ema->state = state;
+    ema->n = n;
+    ema->alpha = alpha;
+    ema->primed = false;
+}
+
+const float *pp_ema_update(pp_ema_t *ema, const float *scores)
+{
+    if (!ema->primed) {
+        memcpy(ema->state, scores, ema->n * sizeof(float));
+        ema->primed = true;
+        return ema->state;
+    }
+
+    float a = ema->alpha;
+    for (uint32_t i = 0; i < ema->n; i++) {
+        ema->state[i] += a * (scores[i] - ema->state[i]);
+    }
+    return ema->state;
+}
+
+void pp_vote_init(pp_vote_t *vote, uint32_t len)
+{
+    memset(vote, 0, sizeof(*vote));
+    vote->len = len > PP_VOTE_MAX ? PP_VOTE_MAX : (len ? len : 1);
+}
+
+uint32_t pp_vote_update(pp_vote_t *vote, uint32_t cls)
+{
+    vote->hist[vote->pos] = (uint16_t)cls;
+    vote->pos = (vote->pos + 1) % vote->len;
+    if (vote->count < vote->len) vote->count++;
+
+    uint32_t best = cls, best_cnt = 0;
+    for (uint32_t i = 0; i < vote->count; i++) {
+        /* newest first, so the newest class wins a tie */
+        uint16_t c = vote->hist[(vote->pos + vote->len - 1 - i) % vote->len];
+        uint32_t cnt = 0;
+        for (uint32_t j = 0; j < vote->count; j++) {
+            if (vote->hist[j] == c) cnt++;
+        }
+        if (cnt > best_cnt) {
+            best = c;
+            best_cnt = cnt;
+        }
+    }
+    return best;
+}
+
+void pp_hyst_init(pp_hyst_t *hyst, float on, float off)
+{
+    hyst->on = on;
+    hyst->off = off;
+    hyst->active = -1;
+}
+
+int pp_hyst_update(pp_hyst_t *hyst, uint32_t cls, const float *conf, uint32_t n)
+{
+    if (hyst->active >= 0 && ((uint32_t)hyst->active >= n || conf[hyst->active] < hyst->off)) {
+        hyst->active = -1;
+    }
+    if (cls < n && (int)cls != hyst->active && conf[cls] >= hyst->on) {
+        hyst->active = (int)cls;
+    }
+    return hyst->active;
+}
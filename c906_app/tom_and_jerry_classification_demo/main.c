@@ -22,7 +22,8 @@
 /* m1s utils */
 #include <imgtool/bilinear_interpolation.h>
 #include <imgtool/rgb_cvt.h>
-#include <mathtool/argmax.h>
+
+#include "blai_postproc.h"
 
 #if 0
 #define DBG_PRINTF(...) printf(__VA_ARGS__)
@@ -82,8 +83,26 @@ static void tj_model_result_cb(model_result_t *result, void *arg)
     // printf("output shape %ux%ux%u\r\n", output_shape[0], output_shape[1], output_shape[2]);
 
     uint32_t output_size = output_shape[0] * output_shape[1] * output_shape[2];
-    uint32_t idx = ARGMAX(output, output_size);
-    printf("[%u/%u]output %d, %f:", idx, output_size, output_zero_point, output_scale);
+#define NUM_CLASSES (2)
+    if (output_size > NUM_CLASSES) output_size = NUM_CLASSES;
+    static float scores[NUM_CLASSES];
+    pp_dequant_u8(output, scores, output_size, output_scale, output_zero_point);
+    pp_softmax(scores, output_size);
+
+    /* smooth the probabilities over frames, switch label from 70% and drop it below 55% */
+    static float ema_state[NUM_CLASSES];
+    static pp_ema_t ema;
+    static pp_hyst_t hyst;
+    if (NULL == ema.state) {
+        pp_ema_init(&ema, ema_state, output_size, 0.3f);
+        pp_hyst_init(&hyst, 0.7f, 0.55f);
+    }
+    const float *smoothed = pp_ema_update(&ema, scores);
+
+    pp_class_t top;
+    pp_topk(smoothed, output_size, 1, &top);
+    int idx = pp_hyst_update(&hyst, top.idx, smoothed, output_size);
+    printf("[%d/%u]output %d, %f: %u(%.2f)", idx, output_size, output_zero_point, output_scale, top.idx, top.score);
     DBG_PRINTF("\t[%3u", output[0]);
     for (uint32_t i = 1; i < output_size; i++) {
         DBG_PRINTF(",%3u", output[i]);
@@ -92,7 +111,7 @@ static void tj_model_result_cb(model_result_t *result, void *arg)
     DBG_PRINTF("]");
 
     rgb565_frame_t *f = arg;
-    draw_string(f, f->w / 2, 16, idx ? "t o m" : "jerry", 0x07e0, 0x0000);
+    draw_string(f, f->w / 2, 16, idx < 0 ? "  ?  " : (idx ? "t o m" : "jerry"), 0x07e0, 0x0000);
     printf("\r\n");
 }
 
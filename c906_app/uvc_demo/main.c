@@ -1,5 +1,6 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 /* FreeRTOS */
 #include <FreeRTOS.h>
@@ -8,12 +9,286 @@
 /* bl808 c906 std driver */
 #include <bl808_glb.h>
 #include <bl_cam.h>
+#include <csi_core.h>
 
 #include <m1s_c906_xram_usb.h>
 
+#include "frame_ring.h"
+#include "uvc_cfg.h"
+
+/*
+ * By default the SDK's m1s_xram_usb_cam_init() serves the camera to the
+ * E907's helper_usb_cam, one MJPEG format.
+ *
+ * With UVC_DEMO_FRING this is the camera side of the E907's own UVC
+ * function instead (e907_app/firmware/uvc_cam.c, FEATURE_ENABLE_UVC_FRING
+ * there). The E907 answers the host's probe/commit and publishes the result
+ * in the uvc_cfg block; this core follows it, runs the camera in the
+ * committed format and pushes frames through the frame ring, paced to the
+ * committed interval. The E907 copies them into ISO packets straight out
+ * of our buffers. Both blocks are in the shared window of frame_ring.h: the
+ * ring is only formatted, and uvc_cfg only read, on a heap clear of it.
+ *
+ *   MJPEG  the camera's own size, frames copied out of the encoder's buffer
+ *   YUY2   the 400x300 RGBA frames, scaled and converted here
+ */
+
+/* define to feed the E907's multi-format `uvc start` through the shared frame ring */
+// #define UVC_DEMO_FRING
+
+#ifdef UVC_DEMO_FRING
+#define CAMERA_W (400)
+#define CAMERA_H (300)
+
+#define FRAME_BUFS (3)
+#define FRAME_BUF_SIZE (512 * 1024) /* UVC_MJPEG_MAX_FRAME of uvc_desc.h, more than 400 * 300 * 2 */
+
+/* cookie: commit generation and buffer index, the E907 drops frames of an older commit */
+#define COOKIE(gen, i) (((gen) << 8) | (i))
+#define COOKIE_BUF(c) ((c)&0xff)
+
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+
+static fring_t s_ring;
+static uint8_t *s_buf[FRAME_BUFS];
+static volatile uint8_t s_busy[FRAME_BUFS];
+
+static uint32_t s_gen;
+static uint32_t s_format; /* 0 while the camera is off */
+static uint32_t s_width, s_height, s_interval_us;
+
+static uint32_t s_sent, s_skipped, s_dropped;
+
+static void buf_done(void *arg, const fring_desc_t *d)
+{
+    s_busy[COOKIE_BUF(d->cookie)] = 0;
+}
+
+static int buf_get(void)
+{
+    fring_reclaim(&s_ring, buf_done, NULL);
+    for (int i = 0; i < FRAME_BUFS; i++) {
+        if (!s_busy[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int buf_alloc(void)
+{
+    for (int i = 0; i < FRAME_BUFS; i++) {
+        uint8_t *p = pvPortMalloc(FRAME_BUF_SIZE + FRAME_RING_LINE);
+        if (NULL == p) {
+            return -1;
+        }
+        /* never freed, so the unaligned start doesn't need keeping */
+        s_buf[i] = (uint8_t *)ALIGNUP((uintptr_t)p, FRAME_RING_LINE);
+    }
+    return 0;
+}
+
+static inline uint8_t clamp_u8(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/*
+ * RGBA8888 (R in the low byte) to YUY2, BT.601 studio range, nearest
+ * neighbour scaling. U and V come from the average of each pixel pair.
+ */
+static void rgba_to_yuy2(const uint32_t *src, uint32_t sw, uint32_t sh, uint8_t *dst, uint32_t dw, uint32_t dh)
+{
+    for (uint32_t y = 0; y < dh; y++) {
+        const uint32_t *row = src + (y * sh / dh) * sw;
+        for (uint32_t x = 0; x < dw; x += 2) {
+            uint32_t p0 = row[x * sw / dw];
+            uint32_t p1 = row[(x + 1) * sw / dw];
+            int r0 = p0 & 0xff, g0 = (p0 >> 8) & 0xff, b0 = (p0 >> 16) & 0xff;
+            int r1 = p1 & 0xff, g1 = (p1 >> 8) & 0xff, b1 = (p1 >> 16) & 0xff;
+            int r = (r0 + r1) >> 1, g = (g0 + g1) >> 1, b = (b0 + b1) >> 1;
+
+            dst[0] = clamp_u8(((66 * r0 + 129 * g0 + 25 * b0 + 128) >> 8) + 16);
+            dst[1] = clamp_u8(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            dst[2] = clamp_u8(((66 * r1 + 129 * g1 + 25 * b1 + 128) >> 8) + 16);
+            dst[3] = clamp_u8(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            dst += 4;
+        }
+    }
+}
+
+static void camera_stop(void)
+{
+    if (UVC_CFG_MJPEG == s_format) {
+        bl_cam_mipi_mjpeg_deinit();
+    } else if (UVC_CFG_YUY2 == s_format) {
+        bl_cam_mipi_yuv_deinit();
+    }
+    s_format = 0;
+}
+
+static void camera_start(uint32_t format)
+{
+    int ret = -1;
+
+    for (int retry = 0; retry < 100 && 0 != ret; retry++) {
+        ret = UVC_CFG_MJPEG == format ? bl_cam_mipi_mjpeg_init() : bl_cam_mipi_yuv_init();
+        if (0 != ret) {
+            vTaskDelay(pdMS_TO_TICKS(5));
+        }
+    }
+    if (0 != ret) {
+        printf("[uvc] camera init failed\r\n");
+        return;
+    }
+    s_format = format;
+}
+
+/* the E907 committed something new, follow it */
+static void reconfigure(volatile uvc_cfg_shm_t *cfg)
+{
+    uint32_t format = cfg->format;
+
+    s_gen = cfg->gen;
+    s_width = cfg->width;
+    s_height = cfg->height;
+    s_interval_us = cfg->interval / 10;
+    if (format != s_format) {
+        camera_stop();
+        camera_start(format);
+    }
+    printf("[uvc] commit %lu: %s %lux%lu, %lu us\r\n", (unsigned long)s_gen,
+           UVC_CFG_MJPEG == format ? "mjpeg" : "yuy2", (unsigned long)s_width, (unsigned long)s_height,
+           (unsigned long)s_interval_us);
+}
+
+/* Fills buffer i with the next camera frame, returns its length, 0 if there was none. */
+static uint32_t frame_grab(int i)
+{
+    uint8_t *pic = NULL;
+    uint32_t len = 0;
+
+    if (UVC_CFG_MJPEG == s_format) {
+        if (0 != bl_cam_mjpeg_get(&pic, &len)) {
+            return 0;
+        }
+        if (len > FRAME_BUF_SIZE) {
+            len = 0; /* doesn't fit what the descriptors promised the host */
+        } else {
+            memcpy(s_buf[i], pic, len);
+        }
+        bl_cam_mjpeg_pop();
+        return len;
+    }
+
+    if (0 != bl_cam_mipi_rgb_frame_get(&pic, &len)) {
+        return 0;
+    }
+    rgba_to_yuy2((const uint32_t *)pic, CAMERA_W, CAMERA_H, s_buf[i], s_width, s_height);
+    bl_cam_mipi_frame_pop();
+    return s_width * s_height * 2;
+}
+
+/* drops what the camera makes while the host isn't streaming, or it stalls on full buffers */
+static void frame_discard(void)
+{
+    uint8_t *pic = NULL;
+    uint32_t len = 0;
+
+    if (UVC_CFG_MJPEG == s_format && 0 == bl_cam_mjpeg_get(&pic, &len)) {
+        bl_cam_mjpeg_pop();
+    } else if (UVC_CFG_YUY2 == s_format && 0 == bl_cam_mipi_rgb_frame_get(&pic, &len)) {
+        bl_cam_mipi_frame_pop();
+    }
+}
+
+static void uvc_ring(void)
+{
+    volatile uvc_cfg_shm_t *cfg = (volatile uvc_cfg_shm_t *)UVC_CFG_SHM_BASE;
+    uint64_t last_us = 0, report_us = 0;
+
+    /* first, nothing in the window is touched on a heap that reaches into it */
+    if (0 != fring_init_producer(&s_ring, (void *)FRAME_RING_SHM_BASE)) {
+        printf("[uvc] heap reaches into the shared window at %08lx, see frame_ring.h\r\n",
+               (unsigned long)FRAME_RING_SHM_RESERVED_BASE);
+        return;
+    }
+    if (0 != buf_alloc()) {
+        printf("[uvc] no memory for frame buffers\r\n");
+        return;
+    }
+
+    printf("[uvc] waiting for `uvc start` on the e907\r\n");
+    for (;;) {
+        csi_dcache_invalid_range((void *)cfg, sizeof(*cfg));
+        if (UVC_CFG_MAGIC == cfg->magic) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+
+    for (;;) {
+        csi_dcache_invalid_range((void *)cfg, sizeof(*cfg));
+        if (cfg->gen != s_gen) {
+            reconfigure(cfg);
+        }
+        if (0 == s_format) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        if (!cfg->streaming) {
+            frame_discard();
+            fring_reclaim(&s_ring, buf_done, NULL);
+            vTaskDelay(1);
+            continue;
+        }
+
+        /* the camera runs at its own rate, frames earlier than the committed interval are skipped */
+        uint64_t now = CPU_Get_MTimer_US();
+        if (now - last_us < s_interval_us * 7 / 8) {
+            frame_discard();
+            s_skipped++;
+            vTaskDelay(1);
+            continue;
+        }
+
+        int i = buf_get();
+        if (i < 0) {
+            frame_discard(); /* USB is behind, all buffers are queued */
+            s_dropped++;
+            vTaskDelay(1);
+            continue;
+        }
+        uint32_t len = frame_grab(i);
+        if (0 == len) {
+            vTaskDelay(1);
+            continue;
+        }
+        last_us = now;
+        s_busy[i] = 1;
+        if (0 != fring_push(&s_ring, (uint32_t)(uintptr_t)s_buf[i], len, now / 1000, COOKIE(s_gen, i))) {
+            s_busy[i] = 0;
+            s_dropped++;
+            continue;
+        }
+        s_sent++;
+
+        if (now - report_us >= 5000000) {
+            printf("[uvc] sent %lu, skipped %lu, dropped %lu\r\n", (unsigned long)s_sent, (unsigned long)s_skipped,
+                   (unsigned long)s_dropped);
+            report_us = now;
+        }
+    }
+}
+#endif
+
 void main()
 {
     vTaskDelay(1);
+#ifdef UVC_DEMO_FRING
+    uvc_ring();
+#else
     bl_cam_mipi_mjpeg_init();
     m1s_xram_usb_cam_init();
-}
\ No newline at end of file
+#endif
+}
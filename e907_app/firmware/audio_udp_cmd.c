@@ -0,0 +1,178 @@
+#include <FreeRTOS.h>
+#include <aos/kernel.h>
+#include <cli.h>
+#include <lwip/sockets.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <task.h>
+
+#include "frame_ring.h"
+#include "rtp_audio.h"
+
+#define AUDIO_UDP_RATE (16000)
+#define AUDIO_UDP_TONE_HZ (1000)
+
+typedef struct {
+    char ip[16];
+    uint16_t port;
+    uint8_t pt;
+    uint8_t mic;
+    uint32_t frame_ms;
+} audio_udp_arg_t;
+
+typedef struct {
+    int sock;
+    struct sockaddr_in addr;
+    uint32_t send_fail;
+} audio_udp_t;
+
+static fring_t s_ring;
+static volatile int s_audio_udp_running;
+
+static int audio_udp_send(void *arg, const uint8_t *pkt, uint32_t len)
+{
+    audio_udp_t *udp = arg;
+    if (sendto(udp->sock, pkt, len, 0, (struct sockaddr *)&udp->addr, sizeof(udp->addr)) < 0) {
+        udp->send_fail++;
+    }
+    return 0;
+}
+
+/*
+ * Sender side of the RTP audio stream. With "tone" a 1 kHz sine is paced
+ * out by the E907's clock. With "mic" the C906 (c906_app/audio_recording
+ * with AUDIO_STREAM_FRING) hands over blocks of 16 kHz mono PCM through the
+ * shared frame ring; each one goes out as one packet straight from its
+ * buffer and is released after. The timestamp follows the block number in
+ * the cookie, so blocks the C906 had to drop show up as a gap the receiver
+ * conceals instead of shifting the rest.
+ */
+static void audio_udp_task(void *pvParameters)
+{
+    audio_udp_arg_t *arg = pvParameters;
+    rtp_audio_tx_t *tx = pvPortMalloc(sizeof(rtp_audio_tx_t));
+    int16_t *tone = NULL;
+    audio_udp_t udp = {.sock = -1};
+    uint32_t frame = AUDIO_UDP_RATE / 1000 * arg->frame_ms, wrong_size = 0;
+    char sdp[256];
+
+    if (NULL == tx) {
+        printf("[audio_udp] no memory\r\n");
+        goto exit;
+    }
+    if ((udp.sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        printf("[audio_udp] socket failed\r\n");
+        goto exit;
+    }
+    udp.addr.sin_family = AF_INET;
+    udp.addr.sin_port = htons(arg->port);
+    udp.addr.sin_addr.s_addr = inet_addr(arg->ip);
+
+    if (arg->mic) {
+        printf("[audio_udp] waiting for the producer at %08lx\r\n", (unsigned long)FRAME_RING_SHM_BASE);
+        while (s_audio_udp_running && 0 != fring_attach_consumer(&s_ring, (void *)FRAME_RING_SHM_BASE)) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+    } else {
+        /* a whole number of periods per frame, the tone repeats seamlessly */
+        if (NULL == (tone = pvPortMalloc(frame * sizeof(int16_t)))) {
+            printf("[audio_udp] no memory\r\n");
+            goto exit;
+        }
+        for (uint32_t i = 0; i < frame; i++) {
+            tone[i] = (int16_t)(8000.0f * sinf(2.0f * (float)M_PI * AUDIO_UDP_TONE_HZ * i / AUDIO_UDP_RATE));
+        }
+    }
+
+    rtp_audio_tx_init(tx, aos_now_ms() * 2654435761u, arg->pt, aos_now_ms() * 40503u);
+    rtp_audio_sdp(sdp, sizeof(sdp), arg->ip, arg->port, arg->pt, AUDIO_UDP_RATE);
+    printf("[audio_udp] %s -> %s:%u, %lu samples per packet, sdp:\r\n%s", arg->mic ? "mic" : "tone", arg->ip,
+           arg->port, (unsigned long)frame, sdp);
+
+    uint32_t ts0 = tx->ts, next_ms = aos_now_ms(), report_ms = next_ms + 1000;
+    uint32_t last_packets = 0;
+    uint64_t last_bytes = 0;
+
+    while (s_audio_udp_running) {
+        if (arg->mic) {
+            fring_desc_t d;
+            if (!fring_pop(&s_ring, &d)) {
+                vTaskDelay(1);
+            } else {
+                uint32_t n = d.len / sizeof(int16_t);
+                if (n > 0 && n <= RTP_AUDIO_MAX_SAMPLES && 0 == (n & 1)) {
+                    rtp_audio_send(tx, (const int16_t *)(uintptr_t)d.addr, n, ts0 + d.cookie * n, audio_udp_send,
+                                   &udp);
+                } else {
+                    wrong_size++;
+                }
+                fring_release(&s_ring);
+            }
+        } else {
+            rtp_audio_send(tx, tone, frame, tx->ts, audio_udp_send, &udp);
+            next_ms += arg->frame_ms;
+            int32_t wait = next_ms - aos_now_ms();
+            if (wait > 0) {
+                vTaskDelay(pdMS_TO_TICKS(wait));
+            }
+        }
+
+        uint32_t now = aos_now_ms();
+        if ((int32_t)(now - report_ms) >= 0) {
+            printf("[audio_udp] %lu packets/s, %lu KB/s, packets %lu, send fail %lu, bad blocks %lu\r\n",
+                   (unsigned long)(tx->packets - last_packets), (unsigned long)((tx->bytes - last_bytes) >> 10),
+                   (unsigned long)tx->packets, (unsigned long)udp.send_fail, (unsigned long)wrong_size);
+            last_packets = tx->packets;
+            last_bytes = tx->bytes;
+            report_ms = now + 1000;
+        }
+    }
+    printf("[audio_udp] stopped, packets %lu\r\n", (unsigned long)tx->packets);
+
+exit:
+    if (udp.sock >= 0) closesocket(udp.sock);
+    vPortFree(tone);
+    vPortFree(tx);
+    vPortFree(arg);
+    s_audio_udp_running = 0;
+    vTaskDelete(NULL);
+}
+
+void cmd_audio_udp(char *buf, int len, int argc, char **argv)
+{
+    if (2 == argc && 0 == strcmp(argv[1], "stop")) {
+        s_audio_udp_running = 0;
+        return;
+    }
+    if (argc < 3) {
+        printf("Usage: audio_udp <ip> <port> [pcm|adpcm] [tone|mic] [frame ms]\r\n");
+        printf("       audio_udp stop\r\n");
+        return;
+    }
+    if (s_audio_udp_running) {
+        printf("audio_udp already running\r\n");
+        return;
+    }
+
+    audio_udp_arg_t *arg = pvPortMalloc(sizeof(*arg));
+    if (NULL == arg) {
+        return;
+    }
+    memset(arg, 0, sizeof(*arg));
+    strncpy(arg->ip, argv[1], sizeof(arg->ip) - 1);
+    arg->port = atoi(argv[2]);
+    arg->pt = argc > 3 && 0 == strcmp(argv[3], "adpcm") ? RTP_AUDIO_PT_DVI4 : RTP_AUDIO_PT_L16;
+    arg->mic = argc > 4 && 0 == strcmp(argv[4], "mic");
+    arg->frame_ms = argc > 5 ? atoi(argv[5]) : 20;
+    if (arg->frame_ms < 1 || AUDIO_UDP_RATE / 1000 * arg->frame_ms > RTP_AUDIO_MAX_SAMPLES) {
+        arg->frame_ms = 20;
+    }
+
+    s_audio_udp_running = 1;
+    if (pdPASS != xTaskCreate(audio_udp_task, "audio_udp", 1024, arg, 10, NULL)) {
+        s_audio_udp_running = 0;
+        vPortFree(arg);
+    }
+}
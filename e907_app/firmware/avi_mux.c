@@ -0,0 +1,136 @@
+#include <string.h>
+
+#include "avi_mux.h"
+
+static inline uint8_t *put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static inline uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+    return p + 4;
+}
+
+#define HDRL_SIZE (4 + (8 + 56) + (12 + (8 + 56) + (8 + 40)))
+#define STRL_SIZE (4 + (8 + 56) + (8 + 40))
+#define JUNK_SIZE (AVI_HDR_SIZE - 12 - (8 + HDRL_SIZE) - 8 - 12)
+
+void avi_header_build(const avi_info_t *info, uint8_t *hdr)
+{
+    uint32_t fps = info->fps ? info->fps : 1;
+    uint32_t riff = AVI_HDR_SIZE - 8 + info->movi_bytes + info->idx_bytes + info->tail_bytes;
+    uint8_t *p = hdr;
+
+    memset(hdr, 0, AVI_HDR_SIZE);
+    p = put32(p, AVI_FOURCC('R', 'I', 'F', 'F'));
+    p = put32(p, riff);
+    p = put32(p, AVI_FOURCC('A', 'V', 'I', ' '));
+
+    p = put32(p, AVI_FOURCC('L', 'I', 'S', 'T'));
+    p = put32(p, HDRL_SIZE);
+    p = put32(p, AVI_FOURCC('h', 'd', 'r', 'l'));
+
+    p = put32(p, AVI_FOURCC('a', 'v', 'i', 'h'));
+    p = put32(p, 56);
+    p = put32(p, 1000000 / fps);                       /* dwMicroSecPerFrame */
+    p = put32(p, info->max_frame * fps);               /* dwMaxBytesPerSec */
+    p = put32(p, 0);                                   /* dwPaddingGranularity */
+    p = put32(p, info->idx_bytes ? AVIF_HASINDEX : 0); /* dwFlags, without idx1 players scan movi */
+    p = put32(p, info->frames);                        /* dwTotalFrames */
+    p = put32(p, 0);                                   /* dwInitialFrames */
+    p = put32(p, 1);                                   /* dwStreams */
+    p = put32(p, info->max_frame);                     /* dwSuggestedBufferSize */
+    p = put32(p, info->width);
+    p = put32(p, info->height);
+    p += 16; /* dwReserved[4] */
+
+    p = put32(p, AVI_FOURCC('L', 'I', 'S', 'T'));
+    p = put32(p, STRL_SIZE);
+    p = put32(p, AVI_FOURCC('s', 't', 'r', 'l'));
+
+    p = put32(p, AVI_FOURCC('s', 't', 'r', 'h'));
+    p = put32(p, 56);
+    p = put32(p, AVI_FOURCC('v', 'i', 'd', 's'));
+    p = put32(p, AVI_FOURCC('M', 'J', 'P', 'G'));
+    p = put32(p, 0);             /* dwFlags */
+    p = put32(p, 0);             /* wPriority, wLanguage */
+    p = put32(p, 0);             /* dwInitialFrames */
+    p = put32(p, 1);             /* dwScale */
+    p = put32(p, fps);           /* dwRate */
+    p = put32(p, 0);             /* dwStart */
+    p = put32(p, info->frames);  /* dwLength */
+    p = put32(p, info->max_frame);
+    p = put32(p, 0xffffffff);    /* dwQuality, default */
+    p = put32(p, 0);             /* dwSampleSize, varies */
+    p = put16(p, 0);             /* rcFrame */
+    p = put16(p, 0);
+    p = put16(p, info->width);
+    p = put16(p, info->height);
+
+    p = put32(p, AVI_FOURCC('s', 't', 'r', 'f'));
+    p = put32(p, 40);
+    p = put32(p, 40); /* BITMAPINFOHEADER.biSize */
+    p = put32(p, info->width);
+    p = put32(p, info->height);
+    p = put16(p, 1);  /* biPlanes */
+    p = put16(p, 24); /* biBitCount */
+    p = put32(p, AVI_FOURCC('M', 'J', 'P', 'G'));
+    p = put32(p, (uint32_t)info->width * info->height * 3);
+    p += 16; /* resolution and palette, unused */
+
+    p = put32(p, AVI_FOURCC('J', 'U', 'N', 'K'));
+    p = put32(p, JUNK_SIZE);
+    p += JUNK_SIZE;
+
+    p = put32(p, AVI_FOURCC('L', 'I', 'S', 'T'));
+    p = put32(p, 4 + info->movi_bytes);
+    put32(p, AVI_FOURCC('m', 'o', 'v', 'i'));
+}
+
+void avi_chunk_hdr(uint8_t *out, uint32_t fourcc, uint32_t len)
+{
+    put32(put32(out, fourcc), len);
+}
+
+void avi_idx_entry(uint8_t *out, uint32_t pos, uint32_t len)
+{
+    uint8_t *p = put32(out, AVI_FOURCC('0', '0', 'd', 'c'));
+    p = put32(p, AVIIF_KEYFRAME);
+    p = put32(p, pos - AVI_MOVI_FOURCC_POS);
+    put32(p, len);
+}
+
+int avi_jpeg_size(const uint8_t *jpeg, uint32_t len, uint16_t *width, uint16_t *height)
+{
+    uint32_t i = 2;
+
+    if (len < 4 || 0xff != jpeg[0] || 0xd8 != jpeg[1]) {
+        return -1;
+    }
+    /* walk the marker segments up to the first SOFn */
+    while (i + 4 <= len) {
+        if (0xff != jpeg[i]) {
+            return -1;
+        }
+        uint8_t m = jpeg[i + 1];
+        uint32_t seg = (jpeg[i + 2] << 8) | jpeg[i + 3];
+        if (m >= 0xc0 && m <= 0xcf && 0xc4 != m && 0xc8 != m && 0xcc != m) {
+            if (i + 9 > len) {
+                return -1;
+            }
+            *height = (jpeg[i + 5] << 8) | jpeg[i + 6];
+            *width = (jpeg[i + 7] << 8) | jpeg[i + 8];
+            return 0;
+        }
+        if (0xda == m || 0xd9 == m) {
+            return -1; /* scan data before any SOF */
+        }
+        i += 2 + seg;
+    }
+    return -1;
+}
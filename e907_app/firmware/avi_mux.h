@@ -0,0 +1,58 @@
+#ifndef __AVI_MUX_H__
+#define __AVI_MUX_H__
+
+#include <stdint.h>
+
+/*
+ * AVI 1.0 (RIFF) layout for a single MJPEG video stream:
+ *
+ *   RIFF 'AVI '
+ *     LIST 'hdrl'  avih, LIST 'strl' (strh, strf)
+ *     JUNK         pads the header to AVI_HDR_SIZE
+ *     LIST 'movi'  '00dc' chunks, one per frame, padded to even length
+ *     idx1         16 bytes per frame, offsets from the 'movi' fourcc
+ *     JUNK         whatever preallocated space is left
+ *
+ * The header has a fixed size so it can be rewritten in place with the
+ * current counts, as whole sectors. Pure code, no OS calls.
+ */
+
+#define AVI_HDR_SIZE (4096)
+#define AVI_MOVI_FOURCC_POS (AVI_HDR_SIZE - 4) /* idx1 offsets count from here */
+#define AVI_CHUNK_HDR (8)
+#define AVI_IDX_ENTRY (16)
+#define AVI_MAX_BYTES (1024u * 1024 * 1024) /* AVI 1.0 players stop trusting sizes past 1 GB */
+
+#define AVI_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+#define AVIF_HASINDEX (0x00000010)
+#define AVIIF_KEYFRAME (0x00000010)
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint32_t fps;
+    uint32_t frames;
+    uint32_t max_frame;  /* largest frame, dwSuggestedBufferSize */
+    uint32_t movi_bytes; /* chunks in the movi list, headers and padding included */
+    uint32_t idx_bytes;  /* 0 while there is no idx1 yet */
+    uint32_t tail_bytes; /* anything after idx1 the RIFF has to cover (JUNK) */
+} avi_info_t;
+
+/* Fills AVI_HDR_SIZE bytes: RIFF, hdrl, JUNK, and the movi LIST header. */
+void avi_header_build(const avi_info_t *info, uint8_t *hdr);
+
+/* 8 byte chunk header; the chunk takes avi_chunk_size(len) bytes in the file */
+void avi_chunk_hdr(uint8_t *out, uint32_t fourcc, uint32_t len);
+static inline uint32_t avi_chunk_size(uint32_t len)
+{
+    return AVI_CHUNK_HDR + len + (len & 1);
+}
+
+/* idx1 entry for a '00dc' chunk at file offset pos */
+void avi_idx_entry(uint8_t *out, uint32_t pos, uint32_t len);
+
+/* Width and height from the JPEG's SOF marker. Returns -1 if there is none. */
+int avi_jpeg_size(const uint8_t *jpeg, uint32_t len, uint16_t *width, uint16_t *height);
+
+#endif /* __AVI_MUX_H__ */
@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avi_rec.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#define avi_open(path) open((path), O_RDWR | O_CREAT | O_TRUNC, 0644)
+#define avi_close(fd) close(fd)
+#define avi_read(fd, buf, len) read((fd), (buf), (len))
+#define avi_write(fd, buf, len) write((fd), (buf), (len))
+#define avi_lseek(fd, off) lseek((fd), (off), SEEK_SET)
+#define avi_sync(fd) fsync(fd)
+#define avi_unlink(path) unlink(path)
+#else
+#include <fcntl.h>
+#include <vfs.h>
+#define avi_open(path) aos_open((path), O_RDWR | O_CREAT | O_TRUNC)
+#define avi_close(fd) aos_close(fd)
+#define avi_read(fd, buf, len) aos_read((fd), (buf), (len))
+#define avi_write(fd, buf, len) aos_write((fd), (buf), (len))
+#define avi_lseek(fd, off) aos_lseek((fd), (off), SEEK_SET)
+#define avi_sync(fd) aos_sync(fd)
+#define avi_unlink(path) aos_unlink(path)
+#endif
+
+#define avi_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define avi_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+void avi_rec_default_cfg(avi_rec_cfg_t *cfg)
+{
+    cfg->block = 32 * 1024;
+    cfg->nblocks = 4;
+    cfg->prealloc = 4 * 1024 * 1024;
+    cfg->fps = 30;
+}
+
+static int fail(avi_rec_t *r)
+{
+    r->stat.errors++;
+    r->error = 1;
+    return -1;
+}
+
+static int write_at(avi_rec_t *r, uint32_t pos, const void *buf, uint32_t len)
+{
+    if (pos != r->fpos && avi_lseek(r->fd, pos) < 0) {
+        return fail(r);
+    }
+    if ((int)len != avi_write(r->fd, buf, len)) {
+        r->fpos = (uint32_t)-1;
+        return fail(r);
+    }
+    r->fpos = pos + len;
+    r->stat.bytes += len;
+    return 0;
+}
+
+/* grows the file past end in prealloc steps, one byte at the new end makes FatFs link the clusters */
+static int prealloc(avi_rec_t *r, uint32_t end)
+{
+    static const uint8_t zero;
+
+    if (0 == r->cfg.prealloc || end <= r->alloc_end) {
+        return 0;
+    }
+    while (r->alloc_end < end) {
+        r->alloc_end += r->cfg.prealloc;
+    }
+    return write_at(r, r->alloc_end - 1, &zero, 1);
+}
+
+static int write_header(avi_rec_t *r, uint32_t frames, uint32_t movi_end, uint32_t idx_bytes, uint32_t tail_bytes)
+{
+    avi_info_t info = {
+        .width = r->width,
+        .height = r->height,
+        .fps = r->cfg.fps,
+        .frames = frames,
+        .max_frame = r->max_frame,
+        .movi_bytes = movi_end - AVI_HDR_SIZE,
+        .idx_bytes = idx_bytes,
+        .tail_bytes = tail_bytes,
+    };
+    avi_header_build(&info, r->hdr);
+    return write_at(r, 0, r->hdr, AVI_HDR_SIZE);
+}
+
+/* index entries queued by the producer -> side file */
+static int idx_flush(avi_rec_t *r)
+{
+    uint32_t head = avi_load(&r->idx_head);
+
+    while (r->idx_tail != head) {
+        uint32_t off = r->idx_tail % AVI_REC_IDX_RING;
+        uint32_t n = head - r->idx_tail;
+        if (n > AVI_REC_IDX_RING - off) {
+            n = AVI_REC_IDX_RING - off;
+        }
+        if ((int)n != avi_write(r->idx_fd, r->idx + off, n)) {
+            return fail(r);
+        }
+        r->idx_bytes += n;
+        avi_store(&r->idx_tail, r->idx_tail + n);
+    }
+    return 0;
+}
+
+int avi_rec_open(avi_rec_t *r, const char *path, const avi_rec_cfg_t *cfg)
+{
+    memset(r, 0, sizeof(*r));
+    r->fd = r->idx_fd = -1;
+    r->cfg = *cfg;
+    if (0 == cfg->block || 0 == cfg->nblocks || (cfg->prealloc % cfg->block) || strlen(path) > AVI_REC_PATH_MAX) {
+        return -1;
+    }
+    r->ring_size = cfg->block * cfg->nblocks;
+    if (NULL == (r->ring = malloc(r->ring_size))) {
+        return -1;
+    }
+    snprintf(r->idx_path, sizeof(r->idx_path), "%s.idx", path);
+    if ((r->fd = avi_open(path)) < 0 || (r->idx_fd = avi_open(r->idx_path)) < 0) {
+        goto err;
+    }
+    r->head = r->tail = AVI_HDR_SIZE;
+    r->alloc_end = 0;
+    if (0 != prealloc(r, AVI_HDR_SIZE) || 0 != write_header(r, 0, AVI_HDR_SIZE, 0, 0)) {
+        goto err;
+    }
+    return 0;
+
+err:
+    if (r->fd >= 0) avi_close(r->fd);
+    if (r->idx_fd >= 0) {
+        avi_close(r->idx_fd);
+        avi_unlink(r->idx_path);
+    }
+    free(r->ring);
+    r->ring = NULL;
+    return -1;
+}
+
+/* copies len bytes to file offset pos of the ring, wrapping */
+static void ring_copy(avi_rec_t *r, uint32_t pos, const uint8_t *src, uint32_t len)
+{
+    uint32_t off = pos % r->ring_size;
+    uint32_t n = len < r->ring_size - off ? len : r->ring_size - off;
+
+    memcpy(r->ring + off, src, n);
+    memcpy(r->ring, src + n, len - n);
+}
+
+int avi_rec_put(avi_rec_t *r, const uint8_t *jpeg, uint32_t len)
+{
+    uint32_t head = r->head;
+    uint32_t need = avi_chunk_size(len);
+    uint8_t ch[AVI_CHUNK_HDR + 1];
+
+    if (r->error) {
+        return -1;
+    }
+    /* room for this chunk and the idx1 it will need at the end */
+    if (head + need - AVI_HDR_SIZE + (r->frames + 1) * AVI_IDX_ENTRY + AVI_CHUNK_HDR > AVI_MAX_BYTES) {
+        r->stat.dropped++;
+        return -1;
+    }
+    if (need > r->ring_size - (head - avi_load(&r->tail)) ||
+        AVI_IDX_ENTRY > AVI_REC_IDX_RING - (r->idx_head - avi_load(&r->idx_tail))) {
+        r->stat.dropped++;
+        return -1;
+    }
+    if (0 == r->width) {
+        avi_jpeg_size(jpeg, len, &r->width, &r->height);
+    }
+    if (len > r->max_frame) {
+        r->max_frame = len;
+    }
+
+    avi_chunk_hdr(ch, AVI_FOURCC('0', '0', 'd', 'c'), len);
+    ring_copy(r, head, ch, AVI_CHUNK_HDR);
+    ring_copy(r, head + AVI_CHUNK_HDR, jpeg, len);
+    if (len & 1) {
+        ch[AVI_CHUNK_HDR] = 0;
+        ring_copy(r, head + AVI_CHUNK_HDR + len, ch + AVI_CHUNK_HDR, 1);
+    }
+
+    /* the idx ring is a multiple of 16, an entry never wraps */
+    avi_idx_entry(r->idx + r->idx_head % AVI_REC_IDX_RING, head, len);
+    avi_store(&r->idx_head, r->idx_head + AVI_IDX_ENTRY);
+    avi_store(&r->frames, r->frames + 1);
+    avi_store(&r->head, head + need);
+    r->stat.frames++;
+    return 0;
+}
+
+/* whole blocks up to head; the first one is short, it starts after the header */
+static int pump_to(avi_rec_t *r, uint32_t head)
+{
+    int written = 0;
+
+    if (r->error) {
+        return -1;
+    }
+    for (;;) {
+        uint32_t end = (r->tail / r->cfg.block + 1) * r->cfg.block;
+        if (head < end) {
+            break;
+        }
+        if (0 != prealloc(r, end) ||
+            0 != write_at(r, r->tail, r->ring + r->tail % r->ring_size, end - r->tail)) {
+            return -1;
+        }
+        written += end - r->tail;
+        r->stat.writes++;
+        avi_store(&r->tail, end);
+    }
+    if (r->idx_head - r->idx_tail >= AVI_REC_IDX_RING / 2 && 0 != idx_flush(r)) {
+        return -1;
+    }
+    return written;
+}
+
+int avi_rec_pump(avi_rec_t *r)
+{
+    return pump_to(r, avi_load(&r->head));
+}
+
+/* what is left of the last block, without moving tail: the block is written again once full */
+static int write_partial(avi_rec_t *r, uint32_t head)
+{
+    if (head == r->tail) {
+        return 0;
+    }
+    if (0 != prealloc(r, head) || 0 != write_at(r, r->tail, r->ring + r->tail % r->ring_size, head - r->tail)) {
+        return -1;
+    }
+    r->stat.partials++;
+    return 0;
+}
+
+int avi_rec_checkpoint(avi_rec_t *r)
+{
+    /* frames first: a header that counts fewer frames than movi holds is still valid */
+    uint32_t frames = avi_load(&r->frames);
+    uint32_t head = avi_load(&r->head);
+
+    if (pump_to(r, head) < 0 || 0 != write_partial(r, head) || 0 != idx_flush(r) || 0 != write_header(r, frames, head, 0, 0)) {
+        return -1;
+    }
+    if (0 != avi_sync(r->fd)) {
+        return fail(r);
+    }
+    r->stat.checkpoints++;
+    return 0;
+}
+
+/* the writer appending to the ring itself, once the producer is gone */
+static int append(avi_rec_t *r, const uint8_t *data, uint32_t len)
+{
+    while (len && !r->error) {
+        uint32_t room = r->ring_size - (r->head - r->tail);
+        uint32_t n = len < room ? len : room;
+        ring_copy(r, r->head, data, n);
+        r->head += n;
+        data += n;
+        len -= n;
+        if (avi_rec_pump(r) < 0) {
+            return -1;
+        }
+    }
+    return r->error ? -1 : 0;
+}
+
+int avi_rec_close(avi_rec_t *r)
+{
+    uint8_t buf[256];
+    uint8_t ch[AVI_CHUNK_HDR];
+    uint32_t movi_end, tail_bytes = 0;
+    int ret = -1;
+
+    if (avi_rec_pump(r) < 0 || 0 != idx_flush(r)) {
+        goto out;
+    }
+    movi_end = r->head;
+
+    /* idx1 from the side file */
+    avi_chunk_hdr(ch, AVI_FOURCC('i', 'd', 'x', '1'), r->idx_bytes);
+    if (0 != append(r, ch, sizeof(ch)) || avi_lseek(r->idx_fd, 0) < 0) {
+        goto out;
+    }
+    for (uint32_t left = r->idx_bytes; left;) {
+        int n = avi_read(r->idx_fd, buf, left < sizeof(buf) ? left : sizeof(buf));
+        if (n <= 0) {
+            fail(r);
+            goto out;
+        }
+        if (0 != append(r, buf, n)) {
+            goto out;
+        }
+        left -= n;
+    }
+
+    /* JUNK over the rest of the preallocated space, all sizes are even so it is too */
+    r->cfg.prealloc = 0;
+    if (r->alloc_end > r->head) {
+        uint32_t rem = r->alloc_end - r->head;
+        avi_chunk_hdr(ch, AVI_FOURCC('J', 'U', 'N', 'K'), rem >= AVI_CHUNK_HDR ? rem - AVI_CHUNK_HDR : 0);
+        tail_bytes = rem >= AVI_CHUNK_HDR ? rem : AVI_CHUNK_HDR;
+        if (0 != append(r, ch, sizeof(ch))) {
+            goto out;
+        }
+    }
+
+    if (0 != write_partial(r, r->head) ||
+        0 != write_header(r, r->frames, movi_end, AVI_CHUNK_HDR + r->idx_bytes, tail_bytes)) {
+        goto out;
+    }
+    if (0 != avi_sync(r->fd)) {
+        fail(r);
+        goto out;
+    }
+    ret = 0;
+
+out:
+    avi_close(r->fd);
+    avi_close(r->idx_fd);
+    avi_unlink(r->idx_path);
+    free(r->ring);
+    r->ring = NULL;
+    return ret;
+}
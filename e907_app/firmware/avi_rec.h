@@ -0,0 +1,100 @@
+#ifndef __AVI_REC_H__
+#define __AVI_REC_H__
+
+#include <stdint.h>
+
+#include "avi_mux.h"
+
+/*
+ * MJPEG to AVI recorder for the SD card. Odd sized frames written one
+ * f_write each leave FatFs doing partial cluster read-modify-writes and a
+ * FAT update per frame, so frames go into a ring instead and only whole,
+ * block aligned blocks reach the file:
+ *
+ *   producer  avi_rec_put()         frame -> '00dc' chunk in the ring, never blocks
+ *   writer    avi_rec_pump()        whole blocks -> file, at block aligned offsets
+ *   writer    avi_rec_checkpoint()  partial block + header with the current counts, sync
+ *   writer    avi_rec_close()       idx1, header, sync
+ *
+ * One producer and one writer task, like frame_ring.c. A block must be a
+ * multiple of the card's cluster size for the writes to stay cluster
+ * aligned. The file is grown prealloc bytes at a time so FatFs allocates
+ * the cluster chain in one go instead of on every write; what is left at
+ * close is covered by a JUNK chunk.
+ *
+ * Power loss: after a checkpoint the file is a valid AVI up to that point,
+ * without idx1 (players scan the movi list then). The index entries go to
+ * a side file, <path>.idx, and are copied in as idx1 on close.
+ */
+
+#define AVI_REC_IDX_RING (4096) /* 256 frames of index entries */
+#define AVI_REC_PATH_MAX (64)
+
+typedef struct {
+    uint32_t block;    /* write size, a multiple of the cluster size */
+    uint32_t nblocks;  /* ring of block * nblocks bytes; chunks over (nblocks - 1) * block never fit */
+    uint32_t prealloc; /* file growth step, a multiple of block, 0 = grow as written */
+    uint32_t fps;      /* nominal, frames carry no timestamps in AVI 1.0 */
+} avi_rec_cfg_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t dropped;     /* ring full, the writer is behind */
+    uint32_t writes;      /* block writes */
+    uint32_t partials;    /* partial block writes, at checkpoints and close */
+    uint32_t checkpoints;
+    uint32_t errors;      /* failed file operations */
+    uint64_t bytes;       /* written to the file */
+} avi_rec_stat_t;
+
+typedef struct {
+    avi_rec_cfg_t cfg;
+    int fd;
+    int idx_fd;
+    char idx_path[AVI_REC_PATH_MAX + 4];
+    uint32_t fpos; /* where fd points, saves a seek on sequential writes */
+
+    uint8_t *ring;
+    uint32_t ring_size;
+    uint8_t hdr[AVI_HDR_SIZE];
+    uint8_t idx[AVI_REC_IDX_RING];
+
+    /* file offsets, ring offset = offset % ring_size */
+    volatile uint32_t head;  /* producer: end of the last chunk */
+    volatile uint32_t tail;  /* writer: written up to here */
+    volatile uint32_t idx_head;
+    volatile uint32_t idx_tail;
+    volatile uint32_t frames;
+    uint32_t alloc_end; /* file size after preallocation */
+    uint32_t idx_bytes; /* in the side file */
+
+    uint16_t width;
+    uint16_t height;
+    uint32_t max_frame;
+    volatile int error;
+    avi_rec_stat_t stat;
+} avi_rec_t;
+
+/* 32 KB blocks (the usual FAT32 cluster of SDHC cards), 4 of them, 4 MB growth, 30 fps */
+void avi_rec_default_cfg(avi_rec_cfg_t *cfg);
+
+/* Creates path and <path>.idx and writes an empty header. Returns 0 or -1. */
+int avi_rec_open(avi_rec_t *r, const char *path, const avi_rec_cfg_t *cfg);
+
+/*
+ * Producer: queues one JPEG. Returns 0, or -1 if it was dropped: the ring
+ * or the index ring is full, the file hit AVI_MAX_BYTES, or the writer
+ * failed. Width and height come from the first frame.
+ */
+int avi_rec_put(avi_rec_t *r, const uint8_t *jpeg, uint32_t len);
+
+/* Writer: writes every complete block. Returns the bytes written, or -1 after an I/O error. */
+int avi_rec_pump(avi_rec_t *r);
+
+/* Writer: makes everything queued so far playable after a power cut. Returns 0 or -1. */
+int avi_rec_checkpoint(avi_rec_t *r);
+
+/* Writer, once the producer has stopped: appends idx1 and finalises. Frees everything. Returns 0 or -1. */
+int avi_rec_close(avi_rec_t *r);
+
+#endif /* __AVI_REC_H__ */
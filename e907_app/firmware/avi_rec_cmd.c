@@ -0,0 +1,213 @@
+#include <FreeRTOS.h>
+#include <aos/kernel.h>
+#include <cli.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <task.h>
+
+#include "avi_rec.h"
+#include "frame_ring.h"
+#include "mjpeg_src.h"
+
+#define AVI_REC_MAX_FRAME (3 * 32 * 1024 - AVI_CHUNK_HDR) /* the most the default ring takes */
+#define AVI_REC_CHECKPOINT_MS (5000)
+
+typedef struct {
+    char path[AVI_REC_PATH_MAX];
+    char src[AVI_REC_PATH_MAX]; /* empty: the camera, through the C906 frame ring */
+    uint32_t fps;
+} avi_rec_arg_t;
+
+static avi_rec_t *s_rec;
+static volatile int s_avirec_running;
+static volatile int s_capture_running;
+static uint32_t s_max_write_ms;
+
+/* producer: frames from an MJPEG file, paced at fps */
+static void capture_file(avi_rec_arg_t *arg)
+{
+    uint8_t *frame = pvPortMalloc(AVI_REC_MAX_FRAME);
+    mjpeg_src_t src = {.fd = -1};
+    uint32_t period_ms = 1000 / arg->fps;
+
+    if (NULL == frame || 0 != mjpeg_src_open(&src, arg->src)) {
+        printf("[avirec] open %s failed\r\n", arg->src);
+        goto exit;
+    }
+    while (s_avirec_running) {
+        uint32_t t0 = aos_now_ms();
+        int len = mjpeg_src_next(&src, frame, AVI_REC_MAX_FRAME);
+        if (0 == len) {
+            printf("[avirec] no jpeg in %s\r\n", arg->src);
+            break;
+        }
+        if (len > 0) {
+            avi_rec_put(s_rec, frame, len);
+        }
+        uint32_t spent = aos_now_ms() - t0;
+        vTaskDelay(pdMS_TO_TICKS(spent < period_ms ? period_ms - spent : 1));
+    }
+
+exit:
+    mjpeg_src_close(&src);
+    vPortFree(frame);
+}
+
+/* producer: camera frames the C906 pushes; put() copies, so the buffer goes straight back */
+static void capture_ring(void)
+{
+    fring_t ring;
+
+    while (s_avirec_running && 0 != fring_attach_consumer(&ring, (void *)FRAME_RING_SHM_BASE)) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    while (s_avirec_running) {
+        fring_desc_t d;
+        if (!fring_pop(&ring, &d)) {
+            vTaskDelay(1);
+            continue;
+        }
+        avi_rec_put(s_rec, (const uint8_t *)(uintptr_t)FRAME_RING_PEER_ADDR(d.addr), d.len);
+        fring_release(&ring);
+    }
+}
+
+static void capture_task(void *pvParameters)
+{
+    avi_rec_arg_t *arg = pvParameters;
+
+    if (arg->src[0]) {
+        capture_file(arg);
+    } else {
+        capture_ring();
+    }
+    s_capture_running = 0;
+    vTaskDelete(NULL);
+}
+
+/*
+ * The only task touching the file: whole blocks as they fill, a checkpoint
+ * every few seconds so a power cut loses at most that much, idx1 at the end.
+ */
+static void writer_task(void *pvParameters)
+{
+    avi_rec_arg_t *arg = pvParameters;
+    uint32_t checkpoint_ms = aos_now_ms() + AVI_REC_CHECKPOINT_MS;
+
+    while (s_capture_running) {
+        uint32_t t0 = aos_now_ms();
+        int n = avi_rec_pump(s_rec);
+        if (n < 0) {
+            printf("[avirec] write failed, stopping\r\n");
+            s_avirec_running = 0;
+            break;
+        }
+        if (n > 0 && aos_now_ms() - t0 > s_max_write_ms) {
+            s_max_write_ms = aos_now_ms() - t0;
+        }
+        if ((int32_t)(aos_now_ms() - checkpoint_ms) >= 0) {
+            avi_rec_checkpoint(s_rec);
+            checkpoint_ms = aos_now_ms() + AVI_REC_CHECKPOINT_MS;
+        }
+        if (0 == n) {
+            vTaskDelay(1);
+        }
+    }
+    while (s_capture_running) {
+        vTaskDelay(1);
+    }
+
+    if (0 != avi_rec_close(s_rec)) {
+        printf("[avirec] %s not finalised\r\n", arg->path);
+    }
+    printf("[avirec] %s: %lu frames, %lu dropped\r\n", arg->path, (unsigned long)s_rec->stat.frames,
+           (unsigned long)s_rec->stat.dropped);
+    vPortFree(s_rec);
+    s_rec = NULL;
+    vPortFree(arg);
+    s_avirec_running = 0;
+    vTaskDelete(NULL);
+}
+
+static void avirec_stat(void)
+{
+    avi_rec_t *r = s_rec;
+
+    if (NULL == r) {
+        printf("avirec not running\r\n");
+        return;
+    }
+    printf("[avirec] %ux%u, frames %lu, dropped %lu, %lu KB written\r\n", r->width, r->height,
+           (unsigned long)r->stat.frames, (unsigned long)r->stat.dropped, (unsigned long)(r->stat.bytes / 1024));
+    printf("  block writes %lu, partial %lu, checkpoints %lu, errors %lu, slowest pump %lu ms\r\n",
+           (unsigned long)r->stat.writes, (unsigned long)r->stat.partials, (unsigned long)r->stat.checkpoints,
+           (unsigned long)r->stat.errors, (unsigned long)s_max_write_ms);
+}
+
+void cmd_avirec(char *buf, int len, int argc, char **argv)
+{
+    if (2 == argc && 0 == strcmp(argv[1], "stop")) {
+        s_avirec_running = 0;
+        return;
+    }
+    if (2 == argc && 0 == strcmp(argv[1], "stat")) {
+        avirec_stat();
+        return;
+    }
+    if (argc < 3 || 0 != strcmp(argv[1], "start")) {
+        printf("Usage: avirec start <file.avi> [fps] [src.mjpeg]\r\n");
+        printf("       avirec stat\r\n");
+        printf("       avirec stop\r\n");
+        return;
+    }
+    if (s_avirec_running) {
+        printf("avirec already running\r\n");
+        return;
+    }
+
+    avi_rec_arg_t *arg = pvPortMalloc(sizeof(*arg));
+    if (NULL == arg) {
+        return;
+    }
+    memset(arg, 0, sizeof(*arg));
+    strncpy(arg->path, argv[2], sizeof(arg->path) - 1);
+    arg->fps = argc > 3 ? atoi(argv[3]) : 0;
+    if (argc > 4) {
+        strncpy(arg->src, argv[4], sizeof(arg->src) - 1);
+    }
+
+    avi_rec_cfg_t cfg;
+    avi_rec_default_cfg(&cfg);
+    if (arg->fps) {
+        cfg.fps = arg->fps;
+    }
+    arg->fps = cfg.fps;
+
+    s_rec = pvPortMalloc(sizeof(*s_rec));
+    if (NULL == s_rec || 0 != avi_rec_open(s_rec, arg->path, &cfg)) {
+        printf("[avirec] can't create %s\r\n", arg->path);
+        vPortFree(s_rec);
+        s_rec = NULL;
+        vPortFree(arg);
+        return;
+    }
+    s_max_write_ms = 0;
+
+    s_avirec_running = 1;
+    s_capture_running = 1;
+    if (pdPASS != xTaskCreate(capture_task, "avirec_cap", 1024, arg, 10, NULL)) {
+        s_capture_running = 0;
+    }
+    if (pdPASS != xTaskCreate(writer_task, "avirec_wr", 1024, arg, 9, NULL)) {
+        /* nothing else closes the file, do it here once the producer is gone */
+        s_avirec_running = 0;
+        while (s_capture_running) {
+            vTaskDelay(1);
+        }
+        avi_rec_close(s_rec);
+        vPortFree(s_rec);
+        s_rec = NULL;
+        vPortFree(arg);
+    }
+}
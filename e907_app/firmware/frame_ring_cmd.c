@@ -0,0 +1,108 @@
+#include <FreeRTOS.h>
+#include <aos/kernel.h>
+#include <cli.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <task.h>
+
+#include "frame_ring.h"
+#include "frame_stream.h"
+
+typedef struct {
+    char ip[16];
+    uint16_t port;
+} fring_arg_t;
+
+static fring_t s_ring;
+static volatile int s_fring_running;
+
+/*
+ * Consumer side of the shared frame ring: frames are sent straight out of
+ * the C906's buffers and released as soon as TCP has copied them, so no
+ * frame is ever copied between the cores. Without a destination frames are
+ * only counted and released.
+ */
+static void fring_task(void *pvParameters)
+{
+    fring_arg_t *arg = pvParameters;
+    fs_sender_t s = {.sock = -1};
+    int streaming = 0 != arg->ip[0];
+    uint32_t dropped = 0, report_ms, last_popped = 0;
+
+    printf("[fring] waiting for the producer at %08lx\r\n", (unsigned long)FRAME_RING_SHM_BASE);
+    while (s_fring_running && 0 != fring_attach_consumer(&s_ring, (void *)FRAME_RING_SHM_BASE)) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    if (streaming && s_fring_running && 0 != frame_stream_connect(&s, arg->ip, arg->port, 3000)) {
+        goto exit;
+    }
+    report_ms = aos_now_ms() + 1000;
+
+    while (s_fring_running) {
+        fring_desc_t d;
+        if (!fring_pop(&s_ring, &d)) {
+            vTaskDelay(1);
+        } else {
+            if (streaming) {
+                int ret = frame_stream_send(&s, (const uint8_t *)(uintptr_t)d.addr, d.len, (uint64_t)d.ts_ms * 1000);
+                if (ret < 0) {
+                    printf("[fring] connection lost\r\n");
+                    fring_release(&s_ring);
+                    break;
+                }
+                dropped += ret;
+            }
+            fring_release(&s_ring);
+        }
+
+        uint32_t now = aos_now_ms();
+        if ((int32_t)(now - report_ms) >= 0) {
+            printf("[fring] %lu fps, popped %lu, dropped %lu, seq %lu\r\n",
+                   (unsigned long)(s_ring.popped - last_popped), (unsigned long)s_ring.popped,
+                   (unsigned long)dropped, (unsigned long)s_ring.tail);
+            last_popped = s_ring.popped;
+            report_ms = now + 1000;
+        }
+    }
+
+exit:
+    if (s.sock >= 0) frame_stream_close(&s);
+    vPortFree(arg);
+    s_fring_running = 0;
+    vTaskDelete(NULL);
+}
+
+void cmd_fring(char *buf, int len, int argc, char **argv)
+{
+    if (2 == argc && 0 == strcmp(argv[1], "stop")) {
+        s_fring_running = 0;
+        return;
+    }
+    if (argc < 2 || (0 != strcmp(argv[1], "count") && (0 != strcmp(argv[1], "stream") || argc < 4))) {
+        printf("Usage: fring count\r\n");
+        printf("       fring stream <ip> <port>\r\n");
+        printf("       fring stop\r\n");
+        return;
+    }
+    if (s_fring_running) {
+        printf("fring already running\r\n");
+        return;
+    }
+
+    fring_arg_t *arg = pvPortMalloc(sizeof(*arg));
+    if (NULL == arg) {
+        return;
+    }
+    memset(arg, 0, sizeof(*arg));
+    if (0 == strcmp(argv[1], "stream")) {
+        strncpy(arg->ip, argv[2], sizeof(arg->ip) - 1);
+        arg->port = atoi(argv[3]);
+    }
+
+    s_fring_running = 1;
+    if (pdPASS != xTaskCreate(fring_task, "fring", 1024, arg, 10, NULL)) {
+        s_fring_running = 0;
+        vPortFree(arg);
+    }
+}
@@ -0,0 +1,228 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define closesocket close
+#else
+#include <lwip/sockets.h>
+#include <lwip/tcp.h>
+#endif
+
+#include "frame_stream.h"
+
+static inline void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, v);
+    put_le16(p + 2, v >> 16);
+}
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+void frame_stream_hdr_pack(const fs_hdr_t *hdr, uint8_t out[FRAME_STREAM_HDR_SIZE])
+{
+    put_le32(out, hdr->magic);
+    put_le16(out + 4, hdr->version);
+    put_le16(out + 6, hdr->flags);
+    put_le32(out + 8, hdr->seq);
+    put_le32(out + 12, hdr->frame);
+    put_le32(out + 16, hdr->len);
+    put_le32(out + 20, (uint32_t)hdr->ts_us);
+    put_le32(out + 24, (uint32_t)(hdr->ts_us >> 32));
+}
+
+int frame_stream_hdr_unpack(const uint8_t in[FRAME_STREAM_HDR_SIZE], fs_hdr_t *hdr)
+{
+    hdr->magic = get_le32(in);
+    hdr->version = get_le16(in + 4);
+    hdr->flags = get_le16(in + 6);
+    hdr->seq = get_le32(in + 8);
+    hdr->frame = get_le32(in + 12);
+    hdr->len = get_le32(in + 16);
+    hdr->ts_us = get_le32(in + 20) | ((uint64_t)get_le32(in + 24) << 32);
+    return FRAME_STREAM_MAGIC == hdr->magic && FRAME_STREAM_VERSION == hdr->version ? 0 : -1;
+}
+
+void frame_stream_ack_pack(const fs_ack_t *ack, uint8_t out[FRAME_STREAM_ACK_SIZE])
+{
+    put_le32(out, ack->magic);
+    put_le32(out + 4, ack->next_seq);
+    put_le32(out + 8, ack->window);
+}
+
+int frame_stream_ack_unpack(const uint8_t in[FRAME_STREAM_ACK_SIZE], fs_ack_t *ack)
+{
+    ack->magic = get_le32(in);
+    ack->next_seq = get_le32(in + 4);
+    ack->window = get_le32(in + 8);
+    return FRAME_STREAM_ACK_MAGIC == ack->magic ? 0 : -1;
+}
+
+uint32_t frame_stream_credits(const fs_sender_t *s)
+{
+    uint32_t in_flight = s->seq - s->acked;
+    return in_flight < s->window ? s->window - in_flight : 0;
+}
+
+/* drain whatever acks have arrived without blocking */
+static int read_acks(fs_sender_t *s)
+{
+    while (1) {
+        int n = recv(s->sock, s->ack_buf + s->ack_fill, FRAME_STREAM_ACK_SIZE - s->ack_fill, MSG_DONTWAIT);
+        if (n == 0) {
+            return -1;
+        }
+        if (n < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        s->ack_fill += n;
+        if (s->ack_fill < FRAME_STREAM_ACK_SIZE) {
+            continue;
+        }
+        s->ack_fill = 0;
+
+        fs_ack_t ack;
+        if (0 != frame_stream_ack_unpack(s->ack_buf, &ack)) {
+            printf("[frame_stream] bad ack magic %08lx\r\n", (unsigned long)ack.magic);
+            return -1;
+        }
+        /* acks are cumulative, ignore stale ones and any beyond what was sent */
+        if ((int32_t)(ack.next_seq - s->acked) >= 0 && (int32_t)(s->seq - ack.next_seq) >= 0) {
+            for (; s->acked != ack.next_seq; s->acked++) {
+                s->acked_bytes += s->inflight_len[s->acked % FRAME_STREAM_MAX_WINDOW];
+            }
+            s->window = ack.window < FRAME_STREAM_MAX_WINDOW ? ack.window : FRAME_STREAM_MAX_WINDOW;
+        }
+    }
+}
+
+int frame_stream_poll(fs_sender_t *s, uint32_t timeout_ms)
+{
+    if (0 != read_acks(s)) {
+        return -1;
+    }
+    if (frame_stream_credits(s) > 0 || 0 == timeout_ms) {
+        return frame_stream_credits(s);
+    }
+
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(s->sock, &rfds);
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    if (select(s->sock + 1, &rfds, NULL, NULL, &tv) < 0) {
+        return -1;
+    }
+    if (0 != read_acks(s)) {
+        return -1;
+    }
+    return frame_stream_credits(s);
+}
+
+static int send_all(int sock, const uint8_t *buf, uint32_t len)
+{
+    while (len > 0) {
+        int n = send(sock, buf, len, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int frame_stream_send(fs_sender_t *s, const uint8_t *jpeg, uint32_t len, uint64_t ts_us)
+{
+    if (frame_stream_poll(s, 0) < 0) {
+        return -1;
+    }
+    if (0 == frame_stream_credits(s)) {
+        s->frame++;
+        s->dropped++;
+        return 1;
+    }
+
+    fs_hdr_t hdr = {
+        .magic = FRAME_STREAM_MAGIC,
+        .version = FRAME_STREAM_VERSION,
+        .flags = 0,
+        .seq = s->seq,
+        .frame = s->frame,
+        .len = len,
+        .ts_us = ts_us,
+    };
+    uint8_t raw[FRAME_STREAM_HDR_SIZE];
+    frame_stream_hdr_pack(&hdr, raw);
+    if (0 != send_all(s->sock, raw, sizeof(raw)) || 0 != send_all(s->sock, jpeg, len)) {
+        return -1;
+    }
+
+    s->inflight_len[s->seq % FRAME_STREAM_MAX_WINDOW] = len;
+    s->seq++;
+    s->frame++;
+    s->sent++;
+    s->bytes += len;
+    return 0;
+}
+
+int frame_stream_connect(fs_sender_t *s, const char *ip, uint16_t port, uint32_t timeout_ms)
+{
+    memset(s, 0, sizeof(*s));
+    if ((s->sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        printf("[frame_stream] socket failed\r\n");
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(s->sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr(ip);
+    if (0 != connect(s->sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        printf("[frame_stream] connect %s:%u failed\r\n", ip, port);
+        frame_stream_close(s);
+        return -1;
+    }
+
+    /* no credit until the receiver tells us its window */
+    if (frame_stream_poll(s, timeout_ms) <= 0) {
+        printf("[frame_stream] no window from %s:%u\r\n", ip, port);
+        frame_stream_close(s);
+        return -1;
+    }
+    return 0;
+}
+
+void frame_stream_close(fs_sender_t *s)
+{
+    if (s->sock >= 0) {
+        closesocket(s->sock);
+    }
+    s->sock = -1;
+}
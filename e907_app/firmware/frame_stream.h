@@ -0,0 +1,103 @@
+#ifndef __FRAME_STREAM_H__
+#define __FRAME_STREAM_H__
+
+#include <stdint.h>
+
+/*
+ * Windowed MJPEG frame transport over TCP.
+ *
+ * sender -> receiver: fs_hdr_t followed by len bytes of JPEG
+ * receiver -> sender: fs_ack_t whenever a frame has been consumed
+ *
+ * The receiver advertises a window of N frames. The sender may have frames
+ * seq < next + window in flight, where next is the first sequence number the
+ * receiver has not consumed yet, so up to N frames are pipelined instead of
+ * waiting one round trip per frame. When no credit is left the frame is not
+ * sent and the caller can drop it. All fields are little endian.
+ *
+ * seq numbers the frames sent and is what acks count, so it never skips.
+ * frame numbers every frame offered to the stream, sent or not: a frame
+ * found without credit, or one the caller skipped with frame_stream_skip()
+ * (rate control), still takes a frame number, and the receiver sees
+ * frame - previous frame - 1 frames missing before this one.
+ */
+
+#define FRAME_STREAM_MAGIC (0x4653314d)     /* "M1SF" */
+#define FRAME_STREAM_ACK_MAGIC (0x4b41314d) /* "M1AK" */
+#define FRAME_STREAM_VERSION (2)
+#define FRAME_STREAM_HDR_SIZE (28)
+#define FRAME_STREAM_ACK_SIZE (12)
+/* frames the sender keeps track of, a larger advertised window is clamped */
+#define FRAME_STREAM_MAX_WINDOW (16)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t seq;
+    uint32_t frame; /* frames offered before this one, sent or not */
+    uint32_t len;
+    uint64_t ts_us; /* capture time */
+} fs_hdr_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t next_seq; /* first frame not consumed yet */
+    uint32_t window;   /* frames the receiver can hold from next_seq on */
+} fs_ack_t;
+
+void frame_stream_hdr_pack(const fs_hdr_t *hdr, uint8_t out[FRAME_STREAM_HDR_SIZE]);
+int frame_stream_hdr_unpack(const uint8_t in[FRAME_STREAM_HDR_SIZE], fs_hdr_t *hdr);
+void frame_stream_ack_pack(const fs_ack_t *ack, uint8_t out[FRAME_STREAM_ACK_SIZE]);
+int frame_stream_ack_unpack(const uint8_t in[FRAME_STREAM_ACK_SIZE], fs_ack_t *ack);
+
+typedef struct {
+    int sock;
+    uint32_t seq;      /* next sequence number to send */
+    uint32_t frame;    /* next frame number, every frame offered */
+    uint32_t acked;    /* receiver's next_seq */
+    uint32_t window;   /* receiver's window */
+    uint8_t ack_buf[FRAME_STREAM_ACK_SIZE];
+    uint32_t ack_fill;
+    uint32_t inflight_len[FRAME_STREAM_MAX_WINDOW];
+
+    uint32_t sent;
+    uint32_t dropped;  /* no credit when the frame was offered */
+    uint32_t skipped;  /* passed over by the caller, frame_stream_skip() */
+    uint64_t bytes;
+    uint64_t acked_bytes;
+} fs_sender_t;
+
+/* connect and wait for the receiver's first window advertisement */
+int frame_stream_connect(fs_sender_t *s, const char *ip, uint16_t port, uint32_t timeout_ms);
+void frame_stream_close(fs_sender_t *s);
+
+/* frames that can be sent right now */
+uint32_t frame_stream_credits(const fs_sender_t *s);
+
+/* bytes sent but not acknowledged yet */
+static inline uint32_t frame_stream_backlog(const fs_sender_t *s)
+{
+    return s->bytes - s->acked_bytes;
+}
+
+/*
+ * Collect pending acks, waiting at most timeout_ms for one when there is no
+ * credit. Returns the credit count, or -1 if the connection failed.
+ */
+int frame_stream_poll(fs_sender_t *s, uint32_t timeout_ms);
+
+/*
+ * Send one frame if there is credit. Returns 0 when sent, 1 when the frame
+ * was dropped for lack of credit, -1 on a socket error.
+ */
+int frame_stream_send(fs_sender_t *s, const uint8_t *jpeg, uint32_t len, uint64_t ts_us);
+
+/* A frame the caller decided not to send; the receiver counts it missing. */
+static inline void frame_stream_skip(fs_sender_t *s)
+{
+    s->frame++;
+    s->skipped++;
+}
+
+#endif /* __FRAME_STREAM_H__ */
@@ -0,0 +1,156 @@
+#include <FreeRTOS.h>
+#include <aos/kernel.h>
+#include <cli.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <task.h>
+#include <vfs.h>
+
+#include "frame_stream.h"
+#include "mjpeg_src.h"
+#include "rate_ctrl.h"
+
+#define STREAM_MAX_FRAME (96 * 1024)
+
+typedef struct {
+    char ip[16];
+    uint16_t port;
+    uint32_t fps;
+    uint32_t target_ms; /* rate control latency target, 0 = off */
+    char path[64];
+} stream_file_arg_t;
+
+static volatile int s_stream_running;
+
+static void stream_file_task(void *pvParameters)
+{
+    stream_file_arg_t *arg = pvParameters;
+    uint8_t *frame = pvPortMalloc(STREAM_MAX_FRAME);
+    mjpeg_src_t src = {.fd = -1};
+    fs_sender_t s;
+
+    if (NULL == frame) {
+        printf("[stream] no memory\r\n");
+        goto exit;
+    }
+    if (0 != mjpeg_src_open(&src, arg->path)) {
+        printf("[stream] open %s failed\r\n", arg->path);
+        goto exit;
+    }
+    if (0 != frame_stream_connect(&s, arg->ip, arg->port, 3000)) {
+        goto exit;
+    }
+    printf("[stream] %s -> %s:%u, window %lu\r\n", arg->path, arg->ip, arg->port, (unsigned long)s.window);
+
+    uint32_t period_ms = 1000 / (arg->fps ? arg->fps : 30);
+    uint32_t report_ms = aos_now_ms() + 1000;
+    uint32_t last_sent = 0, last_dropped = 0;
+    uint64_t last_bytes = 0;
+
+    /*
+     * Frames from a file are already encoded, so only the skip decision
+     * applies here. With the camera the level would pick the encoder's
+     * quality/resolution for the next capture.
+     */
+    rc_t rc;
+    rc_cfg_t rc_cfg;
+    rc_default_cfg(&rc_cfg);
+    rc_cfg.fps = arg->fps ? arg->fps : 30;
+    rc_cfg.target_ms = arg->target_ms;
+    rc_init(&rc, &rc_cfg, aos_now_ms());
+
+    while (s_stream_running) {
+        uint32_t t0 = aos_now_ms();
+        int len = mjpeg_src_next(&src, frame, STREAM_MAX_FRAME);
+        if (0 == len) {
+            printf("[stream] no jpeg in %s\r\n", arg->path);
+            break;
+        }
+        if (len < 0) {
+            printf("[stream] frame over %u bytes, skipped\r\n", STREAM_MAX_FRAME);
+            frame_stream_skip(&s);
+            continue;
+        }
+
+        int send = 1;
+        if (arg->target_ms) {
+            if (frame_stream_poll(&s, 0) < 0) {
+                printf("[stream] connection lost\r\n");
+                break;
+            }
+            rc_sample(&rc, t0, s.acked_bytes, frame_stream_backlog(&s));
+            send = rc_admit(&rc, t0, len, frame_stream_backlog(&s));
+        }
+
+        /* the newest frame replaces one that found no credit, never queue */
+        if (!send) {
+            frame_stream_skip(&s);
+        } else if (frame_stream_send(&s, frame, len, (uint64_t)aos_now_ms() * 1000) < 0) {
+            printf("[stream] connection lost\r\n");
+            break;
+        }
+
+        uint32_t now = aos_now_ms();
+        if ((int32_t)(now - report_ms) >= 0) {
+            printf("[stream] %lu fps, %lu KB/s, dropped %lu, in flight %lu/%lu", (unsigned long)(s.sent - last_sent),
+                   (unsigned long)((s.bytes - last_bytes) >> 10), (unsigned long)(s.dropped - last_dropped),
+                   (unsigned long)(s.seq - s.acked), (unsigned long)s.window);
+            if (arg->target_ms) {
+                printf(", rc skipped %lu, level %u, %lu KB/s est, %lu ms", (unsigned long)rc.skipped, rc_level(&rc),
+                       (unsigned long)(rc.rate_bps >> 10), (unsigned long)rc.lat_ms);
+            }
+            printf("\r\n");
+            last_sent = s.sent;
+            last_dropped = s.dropped;
+            last_bytes = s.bytes;
+            report_ms = now + 1000;
+        }
+        if (now - t0 < period_ms) {
+            vTaskDelay(pdMS_TO_TICKS(period_ms - (now - t0)));
+        }
+    }
+    frame_stream_close(&s);
+    printf("[stream] stopped, sent %lu, dropped %lu\r\n", (unsigned long)s.sent, (unsigned long)s.dropped);
+
+exit:
+    mjpeg_src_close(&src);
+    vPortFree(frame);
+    vPortFree(arg);
+    s_stream_running = 0;
+    vTaskDelete(NULL);
+}
+
+void cmd_stream_file(char *buf, int len, int argc, char **argv)
+{
+    if (2 == argc && 0 == strcmp(argv[1], "stop")) {
+        s_stream_running = 0;
+        return;
+    }
+    if (argc < 4) {
+        printf("Usage: stream_file <ip> <port> <file.mjpeg> [fps] [target_ms]\r\n");
+        printf("       stream_file stop\r\n");
+        return;
+    }
+    if (s_stream_running) {
+        printf("stream already running\r\n");
+        return;
+    }
+
+    stream_file_arg_t *arg = pvPortMalloc(sizeof(*arg));
+    if (NULL == arg) {
+        return;
+    }
+    memset(arg, 0, sizeof(*arg));
+    strncpy(arg->ip, argv[1], sizeof(arg->ip) - 1);
+    arg->port = atoi(argv[2]);
+    strncpy(arg->path, argv[3], sizeof(arg->path) - 1);
+    arg->fps = argc > 4 ? atoi(argv[4]) : 30;
+    arg->target_ms = argc > 5 ? atoi(argv[5]) : 0;
+
+    s_stream_running = 1;
+    if (pdPASS != xTaskCreate(stream_file_task, "stream_file", 1024, arg, 10, NULL)) {
+        s_stream_running = 0;
+        vPortFree(arg);
+    }
+}
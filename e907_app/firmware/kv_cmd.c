@@ -0,0 +1,157 @@
+#include <FreeRTOS.h>
+#include <bl_flash.h>
+#include <cli.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kv_store.h"
+
+/*
+ * 64 KB at the start of the "unused" partition of
+ * partition_cfg_16M_m1sdock.toml; the media partition below it is all
+ * LittleFS's.
+ */
+#define KV_FLASH_OFFSET (0xF00000)
+#define KV_FLASH_SECTORS (16)
+
+static kv_t s_kv;
+static int s_kv_tried;
+static uint8_t s_val[KV_MAX_VAL + 1];
+
+static int port_read(void *arg, uint32_t offset, void *dst, uint32_t len)
+{
+    return bl_flash_read(offset, dst, len);
+}
+
+static int port_write(void *arg, uint32_t offset, const void *src, uint32_t len)
+{
+    return bl_flash_write(offset, (uint8_t *)src, len);
+}
+
+static int port_erase(void *arg, uint32_t offset, uint32_t len)
+{
+    return bl_flash_erase(offset, len);
+}
+
+/* the settings store, mounted on first use; if that failed every call on it returns an error */
+kv_t *kv_settings(void)
+{
+    static const kv_flash_t port = {port_read, port_write, port_erase, NULL};
+
+    if (!s_kv_tried) {
+        s_kv_tried = 1;
+        int ret = kv_mount(&s_kv, &port, KV_FLASH_OFFSET, KV_FLASH_SECTORS);
+        if (0 != ret) {
+            printf("[kv] mount failed: %d\r\n", ret);
+        } else if (s_kv.dropped) {
+            printf("[kv] %lu records of an interrupted commit dropped\r\n", (unsigned long)s_kv.dropped);
+        }
+    }
+    return &s_kv;
+}
+
+static const char *kv_strerror(int ret)
+{
+    switch (ret) {
+        case KV_ERR_NOENT:
+            return "no such key";
+        case KV_ERR_FULL:
+            return "store full";
+        case KV_ERR_INVAL:
+            return "bad key or value, or too much for one commit";
+        default:
+            return "flash error";
+    }
+}
+
+static int print_key(void *arg, const char *key, uint32_t key_len, uint32_t val_len)
+{
+    printf("%.*s (%lu bytes)\r\n", (int)key_len, key, (unsigned long)val_len);
+    return 0;
+}
+
+static void print_value(const uint8_t *val, uint32_t len)
+{
+    uint32_t i;
+
+    for (i = 0; i < len && val[i] >= 0x20 && val[i] < 0x7f; i++) {
+    }
+    if (i == len) {
+        printf("%.*s\r\n", (int)len, val);
+        return;
+    }
+    for (i = 0; i < len; i++) {
+        printf("%02x%s", val[i], 15 == i % 16 || i + 1 == len ? "\r\n" : " ");
+    }
+}
+
+static void print_usage(void)
+{
+    printf("Usage: kv get <key>\r\n");
+    printf("       kv set <key> <value> [<key> <value> ...]\r\n");
+    printf("       kv del <key> [<key> ...]\r\n");
+    printf("       kv list\r\n");
+    printf("       kv stat\r\n");
+    printf("       kv gc\r\n");
+    printf("\tseveral keys to set or del are one commit, all or none of them stored\r\n");
+}
+
+void cmd_kv(char *buf, int len, int argc, char **argv)
+{
+    kv_t *kv = kv_settings();
+    int ret = 0;
+
+    if (argc < 2) {
+        print_usage();
+        return;
+    }
+    if (!kv->mounted) {
+        printf("[kv] not mounted\r\n");
+        return;
+    }
+
+    if (0 == strcmp(argv[1], "get") && 3 == argc) {
+        if ((ret = kv_get(kv, argv[2], s_val, sizeof(s_val))) >= 0) {
+            print_value(s_val, ret);
+            return;
+        }
+    } else if (0 == strcmp(argv[1], "set") && argc >= 4 && 0 == argc % 2) {
+        if (4 == argc) {
+            ret = kv_set(kv, argv[2], argv[3], strlen(argv[3]));
+        } else {
+            kv_txn_begin(kv);
+            for (int i = 2; i < argc; i += 2) {
+                kv_txn_set(kv, argv[i], argv[i + 1], strlen(argv[i + 1]));
+            }
+            ret = kv_txn_commit(kv);
+        }
+    } else if (0 == strcmp(argv[1], "del") && argc >= 3) {
+        if (3 == argc) {
+            ret = kv_del(kv, argv[2]);
+        } else {
+            kv_txn_begin(kv);
+            for (int i = 2; i < argc; i++) {
+                kv_txn_del(kv, argv[i]);
+            }
+            ret = kv_txn_commit(kv);
+        }
+    } else if (0 == strcmp(argv[1], "list") && 2 == argc) {
+        kv_foreach(kv, print_key, NULL);
+    } else if (0 == strcmp(argv[1], "stat") && 2 == argc) {
+        printf("[kv] %lu keys, %lu of %lu bytes live, sector %lu of %lu at %lu, seq %lu\r\n", (unsigned long)kv->keys,
+               (unsigned long)kv->live, (unsigned long)kv_capacity(kv), (unsigned long)kv->active,
+               (unsigned long)kv->sectors, (unsigned long)kv->pos, (unsigned long)kv->seq);
+        printf("[kv] %lu commits, %lu gcs, %lu records copied, %lu erases, %lu dropped on mount\r\n",
+               (unsigned long)kv->commits, (unsigned long)kv->gcs, (unsigned long)kv->copied,
+               (unsigned long)kv->erases, (unsigned long)kv->dropped);
+    } else if (0 == strcmp(argv[1], "gc") && 2 == argc) {
+        ret = kv_gc(kv);
+    } else {
+        print_usage();
+        return;
+    }
+    if (ret < 0) {
+        printf("[kv] %s\r\n", kv_strerror(ret));
+    }
+}
@@ -0,0 +1,626 @@
+#include <string.h>
+
+#include "kv_store.h"
+
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+
+#define KV_MAGIC (0x3153564b) /* "KVS1" */
+#define SECTOR_HDR (12)
+#define REC_HDR (12)
+
+typedef struct {
+    uint32_t crc; /* of the rest of the record, never 0: a 0 word is padding */
+    uint32_t txn;
+    uint8_t flags;
+    uint8_t key_len; /* 0xff where the flash is erased */
+    uint16_t val_len;
+} kv_rec_t;
+
+static uint32_t crc32(uint32_t crc, const void *buf, uint32_t len)
+{
+    /* reflected 0xedb88320, a nibble at a time: 64 bytes of table instead of 1 KB */
+    static const uint32_t t[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    const uint8_t *b = buf;
+
+    crc = ~crc;
+    while (len--) {
+        crc ^= *b++;
+        crc = (crc >> 4) ^ t[crc & 0xf];
+        crc = (crc >> 4) ^ t[crc & 0xf];
+    }
+    return ~crc;
+}
+
+static uint32_t rec_crc(const uint8_t *rec, uint32_t len)
+{
+    uint32_t crc = crc32(0, rec + 4, len - 4);
+
+    return crc ? crc : 1;
+}
+
+static uint32_t rec_size(uint32_t key_len, uint32_t val_len)
+{
+    return ALIGNUP(REC_HDR + key_len + val_len, 4);
+}
+
+static uint32_t fnv1a(const void *key, uint32_t len)
+{
+    const uint8_t *k = key;
+    uint32_t h = 2166136261u;
+
+    while (len--) {
+        h = (h ^ *k++) * 16777619u;
+    }
+    return h;
+}
+
+/* flash access, addresses from the start of the region */
+static uint32_t at(uint32_t sector, uint32_t pos)
+{
+    return sector * KV_SECTOR + pos;
+}
+
+static int rd(kv_t *kv, uint32_t addr, void *dst, uint32_t len)
+{
+    return kv->flash.read(kv->flash.arg, kv->offset + addr, dst, len);
+}
+
+static int wr(kv_t *kv, uint32_t addr, const void *src, uint32_t len)
+{
+    return kv->flash.write(kv->flash.arg, kv->offset + addr, src, len);
+}
+
+static int erase_sector(kv_t *kv, uint32_t sector)
+{
+    kv->erases++;
+    return kv->flash.erase(kv->flash.arg, kv->offset + at(sector, 0), KV_SECTOR);
+}
+
+/* programming 0 clears whatever is there, the log skips it */
+static int zero(kv_t *kv, uint32_t addr, uint32_t len)
+{
+    memset(kv->buf, 0, sizeof(kv->buf));
+    for (uint32_t done = 0; done < len;) {
+        uint32_t n = len - done < sizeof(kv->buf) ? len - done : sizeof(kv->buf);
+        if (0 != wr(kv, addr + done, kv->buf, n)) {
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+/* 0 and seq for a sector with a valid header, 1 for one without, -1 if it can't be read */
+static int sector_seq(kv_t *kv, uint32_t sector, uint32_t *seq)
+{
+    uint32_t hdr[3];
+
+    if (0 != rd(kv, at(sector, 0), hdr, sizeof(hdr))) {
+        return -1;
+    }
+    if (KV_MAGIC != hdr[0] || hdr[1] != ~hdr[2] || 0 == hdr[1] || 0xffffffff == hdr[1]) {
+        return 1;
+    }
+    *seq = hdr[1];
+    return 0;
+}
+
+/* one past the last byte of the sector from pos on that isn't erased, pos if there is none */
+static int tail(kv_t *kv, uint32_t sector, uint32_t pos, uint32_t *end)
+{
+    *end = pos;
+    while (pos < KV_SECTOR) {
+        uint32_t n = KV_SECTOR - pos < sizeof(kv->buf) ? KV_SECTOR - pos : sizeof(kv->buf);
+        if (0 != rd(kv, at(sector, pos), kv->buf, n)) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            if (0xff != kv->buf[i]) {
+                *end = pos + i + 1;
+            }
+        }
+        pos += n;
+    }
+    return 0;
+}
+
+/* the index: open addressing on the key hash, keys compared in flash */
+static int key_is(kv_t *kv, const kv_slot_t *sl, const void *key, uint32_t len)
+{
+    uint8_t k[KV_MAX_KEY];
+
+    return sl->key_len == len && 0 == rd(kv, sl->addr + REC_HDR, k, len) && 0 == memcmp(k, key, len);
+}
+
+static int lookup(kv_t *kv, const void *key, uint32_t len)
+{
+    uint32_t h = fnv1a(key, len);
+
+    for (uint32_t n = 0, i = h % KV_SLOTS; n < KV_SLOTS; n++, i = (i + 1) % KV_SLOTS) {
+        kv_slot_t *sl = &kv->slot[i];
+        if (0 == sl->state) {
+            break;
+        }
+        if (1 == sl->state && sl->hash == h && key_is(kv, sl, key, len)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int index_set(kv_t *kv, const uint8_t *key, uint32_t key_len, uint32_t val_len, uint32_t addr)
+{
+    uint32_t h = fnv1a(key, key_len);
+    int i = lookup(kv, key, key_len);
+
+    if (i >= 0) {
+        kv->live -= rec_size(kv->slot[i].key_len, kv->slot[i].val_len);
+    } else {
+        if (kv->keys >= KV_MAX_KEYS) {
+            return KV_ERR_FULL;
+        }
+        /* fewer keys than slots, there is always a free one */
+        for (i = h % KV_SLOTS; 1 == kv->slot[i].state; i = (i + 1) % KV_SLOTS) {
+        }
+        kv->keys++;
+    }
+    kv->slot[i].hash = h;
+    kv->slot[i].addr = addr;
+    kv->slot[i].key_len = key_len;
+    kv->slot[i].val_len = val_len;
+    kv->slot[i].state = 1;
+    kv->live += rec_size(key_len, val_len);
+    return 0;
+}
+
+static void index_del(kv_t *kv, const uint8_t *key, uint32_t key_len)
+{
+    int i = lookup(kv, key, key_len);
+
+    if (i >= 0) {
+        kv->live -= rec_size(kv->slot[i].key_len, kv->slot[i].val_len);
+        kv->slot[i].state = 2;
+        kv->keys--;
+    }
+}
+
+/* the records of a txn, at addr in flash, into the index */
+static void apply(kv_t *kv, const uint8_t *recs, uint32_t len, uint32_t addr)
+{
+    for (uint32_t p = 0; p < len;) {
+        kv_rec_t r;
+        memcpy(&r, recs + p, REC_HDR);
+        if (r.flags & KV_F_DEL) {
+            index_del(kv, recs + p + REC_HDR, r.key_len);
+        } else if (0 != index_set(kv, recs + p + REC_HDR, r.key_len, r.val_len, addr + p)) {
+            kv->dropped++;
+        }
+        p += rec_size(r.key_len, r.val_len);
+    }
+}
+
+/* writes at the end of the active sector, not past limit */
+static int append(kv_t *kv, const void *data, uint32_t len, uint32_t limit)
+{
+    uint32_t addr = at(kv->active, kv->pos);
+
+    if (kv->pos + len > limit) {
+        return KV_ERR_FULL;
+    }
+    kv->pos += len;
+    if (0 != wr(kv, addr, data, len)) {
+        /* some of it may be there, and would end the log on the next mount */
+        zero(kv, addr, len);
+        return -1;
+    }
+    return 0;
+}
+
+/* a live record to the end of the log, as a txn of its own */
+static int copy(kv_t *kv, kv_slot_t *sl)
+{
+    uint32_t len = REC_HDR + sl->key_len + sl->val_len;
+    uint32_t addr = at(kv->active, kv->pos);
+    kv_rec_t r = {0, kv->txn++, KV_F_END, sl->key_len, sl->val_len};
+    int ret;
+
+    if (0 != rd(kv, sl->addr, kv->buf, len)) {
+        return -1;
+    }
+    memcpy(kv->buf, &r, REC_HDR);
+    r.crc = rec_crc(kv->buf, len);
+    memcpy(kv->buf, &r.crc, sizeof(r.crc));
+    memset(kv->buf + len, 0xff, rec_size(sl->key_len, sl->val_len) - len);
+    /* the copies may use the reserve */
+    if (0 != (ret = append(kv, kv->buf, rec_size(sl->key_len, sl->val_len), KV_SECTOR))) {
+        return ret;
+    }
+    sl->addr = addr;
+    kv->copied++;
+    return 0;
+}
+
+/* empties sector: copies what is live in it to the end of the log, then erases it */
+static int collect(kv_t *kv, uint32_t sector)
+{
+    uint32_t seq, end;
+    int ret = sector_seq(kv, sector, &seq);
+
+    if (ret < 0) {
+        return -1;
+    }
+    if (0 == ret) {
+        for (uint32_t i = 0; i < KV_SLOTS; i++) {
+            kv_slot_t *sl = &kv->slot[i];
+            if (1 == sl->state && sl->addr / KV_SECTOR == sector && 0 != (ret = copy(kv, sl))) {
+                return ret;
+            }
+        }
+        /*
+         * off the log before the erase: one cut short may leave the header
+         * and lose records after it, a delete and not the value it hid
+         */
+        if (0 != zero(kv, at(sector, 0), 4)) {
+            return -1;
+        }
+    } else {
+        if (0 != tail(kv, sector, 0, &end)) {
+            return -1;
+        }
+        if (0 == end) {
+            return 0;
+        }
+    }
+    return erase_sector(kv, sector);
+}
+
+/* the log moves on to the spare sector, the oldest is collected into it */
+static int rotate(kv_t *kv)
+{
+    uint32_t next = (kv->active + 1) % kv->sectors;
+    uint32_t hdr[3] = {KV_MAGIC, kv->seq + 1, ~(kv->seq + 1)};
+
+    if (0 != wr(kv, at(next, 0), hdr, sizeof(hdr))) {
+        erase_sector(kv, next);
+        return -1;
+    }
+    kv->active = next;
+    kv->seq++;
+    kv->pos = SECTOR_HDR;
+    kv->gcs++;
+    return collect(kv, (next + 1) % kv->sectors);
+}
+
+static void drop_pending(kv_t *kv)
+{
+    kv->dropped += kv->stage_keys;
+    kv->stage_len = 0;
+    kv->stage_keys = 0;
+}
+
+/* the committed txns of a sector into the index; end is where its log stops */
+static int scan(kv_t *kv, uint32_t sector, uint32_t *end)
+{
+    uint32_t p = SECTOR_HDR;
+    kv_rec_t r, first;
+
+    while (p + REC_HDR <= KV_SECTOR) {
+        if (0 != rd(kv, at(sector, p), &r, REC_HDR)) {
+            return -1;
+        }
+        if (0 == r.crc) {
+            drop_pending(kv);
+            p += 4;
+            continue;
+        }
+        if (0xffffffff == r.crc && 0xffffffff == r.txn && 0xff == r.flags && 0xff == r.key_len &&
+            0xffff == r.val_len) {
+            break;
+        }
+        uint32_t len = REC_HDR + r.key_len + r.val_len;
+        uint32_t size = rec_size(r.key_len, r.val_len);
+        if (0 == r.key_len || r.key_len > KV_MAX_KEY || r.val_len > KV_MAX_VAL || size > KV_SECTOR - p) {
+            kv->dropped++;
+            break;
+        }
+        if (0 != rd(kv, at(sector, p), kv->buf, len)) {
+            return -1;
+        }
+        if (r.crc != rec_crc(kv->buf, len)) {
+            kv->dropped++;
+            break;
+        }
+        if (r.txn >= kv->txn) {
+            kv->txn = r.txn + 1;
+        }
+        /* records of a txn are contiguous, one of another means the last never ended */
+        if (kv->stage_len) {
+            memcpy(&first, kv->stage, REC_HDR);
+            if (first.txn != r.txn || kv->stage_len + size > KV_TXN_MAX) {
+                drop_pending(kv);
+            }
+        }
+        if (0 == kv->stage_len) {
+            kv->stage_addr = at(sector, p);
+        }
+        memcpy(kv->stage + kv->stage_len, kv->buf, len);
+        kv->stage_len += size;
+        kv->stage_keys++;
+        if (r.flags & KV_F_END) {
+            apply(kv, kv->stage, kv->stage_len, kv->stage_addr);
+            kv->stage_len = 0;
+            kv->stage_keys = 0;
+        }
+        p += size;
+    }
+    drop_pending(kv);
+    *end = p;
+    return 0;
+}
+
+static int format(kv_t *kv)
+{
+    uint32_t end;
+
+    for (uint32_t s = 0; s < kv->sectors; s++) {
+        if (0 != tail(kv, s, 0, &end) || (end && 0 != erase_sector(kv, s))) {
+            return -1;
+        }
+    }
+    kv->active = kv->sectors - 1;
+    kv->seq = 0;
+    if (0 != rotate(kv)) {
+        return -1;
+    }
+    kv->gcs = 0;
+    kv->mounted = 1;
+    return 0;
+}
+
+int kv_mount(kv_t *kv, const kv_flash_t *flash, uint32_t offset, uint32_t sectors)
+{
+    uint32_t seq, end = SECTOR_HDR, last;
+    int found = 0, ret;
+
+    memset(kv, 0, sizeof(*kv));
+    if (NULL == flash || sectors < 2 || sectors > KV_MAX_SECTORS || offset % KV_SECTOR) {
+        return KV_ERR_INVAL;
+    }
+    kv->flash = *flash;
+    kv->offset = offset;
+    kv->sectors = sectors;
+
+    for (uint32_t s = 0; s < sectors; s++) {
+        if ((ret = sector_seq(kv, s, &seq)) < 0) {
+            return -1;
+        }
+        if (0 == ret && (!found || (int32_t)(seq - kv->seq) > 0)) {
+            kv->active = s;
+            kv->seq = seq;
+            found = 1;
+        }
+    }
+    if (!found) {
+        return format(kv);
+    }
+
+    /* oldest to newest, the active sector last */
+    for (uint32_t n = 1; n <= sectors; n++) {
+        uint32_t s = (kv->active + n) % sectors;
+        if ((ret = sector_seq(kv, s, &seq)) < 0 || (0 == ret && 0 != scan(kv, s, &end))) {
+            return -1;
+        }
+    }
+    /* a commit cut short: what it left becomes padding, the log goes on after it */
+    if (0 != tail(kv, kv->active, end, &last)) {
+        return -1;
+    }
+    kv->pos = ALIGNUP(last, 4);
+    if (kv->pos > end && 0 != zero(kv, at(kv->active, end), kv->pos - end)) {
+        return -1;
+    }
+    /* a gc cut short: the sector after the active one isn't erased yet */
+    if (0 != (ret = collect(kv, (kv->active + 1) % sectors))) {
+        return ret;
+    }
+    kv->mounted = 1;
+    return 0;
+}
+
+uint32_t kv_capacity(const kv_t *kv)
+{
+    /* what the log always finds room for, sectors never quite fill up */
+    return (kv->sectors - 1) * (KV_SECTOR - SECTOR_HDR - KV_RESERVE - KV_TXN_MAX);
+}
+
+int kv_get(kv_t *kv, const char *key, void *val, uint32_t max)
+{
+    uint32_t key_len = strlen(key);
+    int i;
+
+    if (!kv->mounted) {
+        return -1;
+    }
+    if (key_len > KV_MAX_KEY || (i = lookup(kv, key, key_len)) < 0) {
+        return KV_ERR_NOENT;
+    }
+    kv_slot_t *sl = &kv->slot[i];
+    max = max < sl->val_len ? max : sl->val_len;
+    if (max && 0 != rd(kv, sl->addr + REC_HDR + key_len, val, max)) {
+        return -1;
+    }
+    return sl->val_len;
+}
+
+void kv_txn_begin(kv_t *kv)
+{
+    kv->stage_len = 0;
+    kv->stage_keys = 0;
+    kv->stage_bad = 0;
+}
+
+static int stage(kv_t *kv, const char *key, const void *val, uint32_t len, uint8_t flags)
+{
+    uint32_t key_len = strlen(key);
+    uint32_t size = rec_size(key_len, len);
+    uint8_t *p = kv->stage + kv->stage_len;
+    kv_rec_t r = {0, 0, flags, key_len, len};
+
+    if (!kv->mounted || 0 == key_len || key_len > KV_MAX_KEY || len > KV_MAX_VAL || kv->stage_keys >= KV_TXN_KEYS ||
+        kv->stage_len + size > KV_TXN_MAX) {
+        kv->stage_bad = 1;
+        return KV_ERR_INVAL;
+    }
+    memset(p, 0xff, size);
+    memcpy(p, &r, REC_HDR);
+    memcpy(p + REC_HDR, key, key_len);
+    if (len) {
+        memcpy(p + REC_HDR + key_len, val, len);
+    }
+    kv->stage_len += size;
+    kv->stage_keys++;
+    return 0;
+}
+
+int kv_txn_set(kv_t *kv, const char *key, const void *val, uint32_t len)
+{
+    return stage(kv, key, val, len, 0);
+}
+
+int kv_txn_del(kv_t *kv, const char *key)
+{
+    return stage(kv, key, NULL, 0, KV_F_DEL);
+}
+
+/* whether the index can take the staged sets; deletes always go through, they are how space comes back */
+static int fits(kv_t *kv)
+{
+    uint32_t fresh = 0, bytes = 0;
+    kv_rec_t r, e;
+
+    for (uint32_t p = 0; p < kv->stage_len; p += rec_size(r.key_len, r.val_len)) {
+        const uint8_t *key = kv->stage + p + REC_HDR;
+        uint32_t q;
+        memcpy(&r, kv->stage + p, REC_HDR);
+        if (r.flags & KV_F_DEL) {
+            continue;
+        }
+        bytes += rec_size(r.key_len, r.val_len);
+        for (q = 0; q < p; q += rec_size(e.key_len, e.val_len)) {
+            memcpy(&e, kv->stage + q, REC_HDR);
+            if (e.key_len == r.key_len && 0 == memcmp(kv->stage + q + REC_HDR, key, r.key_len)) {
+                break;
+            }
+        }
+        fresh += q == p && lookup(kv, key, r.key_len) < 0;
+    }
+    return kv->keys + fresh <= KV_MAX_KEYS && kv->live + bytes <= kv_capacity(kv);
+}
+
+int kv_txn_commit(kv_t *kv)
+{
+    uint32_t addr, last = 0;
+    kv_rec_t r;
+    int ret = 0;
+
+    if (!kv->mounted || kv->stage_bad) {
+        ret = kv->mounted ? KV_ERR_INVAL : -1;
+        goto exit;
+    }
+    if (0 == kv->stage_len) {
+        goto exit;
+    }
+    if (!fits(kv)) {
+        ret = KV_ERR_FULL;
+        goto exit;
+    }
+    /* a txn never spans sectors */
+    for (uint32_t n = 0; kv->pos + kv->stage_len > KV_SECTOR - KV_RESERVE; n++) {
+        if (n == kv->sectors) {
+            ret = KV_ERR_FULL;
+            goto exit;
+        }
+        if (0 != (ret = rotate(kv))) {
+            goto exit;
+        }
+    }
+
+    /* ids are taken now, the copies of a gc take them too */
+    for (uint32_t p = 0; p < kv->stage_len; p += rec_size(r.key_len, r.val_len)) {
+        memcpy(&r, kv->stage + p, REC_HDR);
+        last = p;
+    }
+    for (uint32_t p = 0; p < kv->stage_len; p += rec_size(r.key_len, r.val_len)) {
+        memcpy(&r, kv->stage + p, REC_HDR);
+        r.txn = kv->txn;
+        r.flags |= p == last ? KV_F_END : 0;
+        memcpy(kv->stage + p, &r, REC_HDR);
+        r.crc = rec_crc(kv->stage + p, REC_HDR + r.key_len + r.val_len);
+        memcpy(kv->stage + p, &r.crc, sizeof(r.crc));
+    }
+    kv->txn++;
+
+    addr = at(kv->active, kv->pos);
+    if (0 == (ret = append(kv, kv->stage, kv->stage_len, KV_SECTOR - KV_RESERVE))) {
+        apply(kv, kv->stage, kv->stage_len, addr);
+        kv->commits++;
+    }
+exit:
+    kv_txn_begin(kv);
+    return ret;
+}
+
+int kv_set(kv_t *kv, const char *key, const void *val, uint32_t len)
+{
+    uint32_t key_len = strlen(key);
+    int i;
+
+    /* the same value again, as a PMK saved on every boot would be */
+    if (kv->mounted && key_len <= KV_MAX_KEY && (i = lookup(kv, key, key_len)) >= 0 && kv->slot[i].val_len == len &&
+        len <= sizeof(kv->buf) && 0 == rd(kv, kv->slot[i].addr + REC_HDR + key_len, kv->buf, len) &&
+        (0 == len || 0 == memcmp(kv->buf, val, len))) {
+        return 0;
+    }
+    kv_txn_begin(kv);
+    kv_txn_set(kv, key, val, len);
+    return kv_txn_commit(kv);
+}
+
+int kv_del(kv_t *kv, const char *key)
+{
+    uint32_t key_len = strlen(key);
+
+    if (!kv->mounted) {
+        return -1;
+    }
+    if (key_len > KV_MAX_KEY || lookup(kv, key, key_len) < 0) {
+        return KV_ERR_NOENT;
+    }
+    kv_txn_begin(kv);
+    kv_txn_del(kv, key);
+    return kv_txn_commit(kv);
+}
+
+int kv_gc(kv_t *kv)
+{
+    if (!kv->mounted) {
+        return -1;
+    }
+    return rotate(kv);
+}
+
+void kv_foreach(kv_t *kv, int (*fn)(void *arg, const char *key, uint32_t key_len, uint32_t val_len), void *arg)
+{
+    char key[KV_MAX_KEY];
+
+    for (uint32_t i = 0; kv->mounted && i < KV_SLOTS; i++) {
+        kv_slot_t *sl = &kv->slot[i];
+        if (1 == sl->state && 0 == rd(kv, sl->addr + REC_HDR, key, sl->key_len) &&
+            0 != fn(arg, key, sl->key_len, sl->val_len)) {
+            return;
+        }
+    }
+}
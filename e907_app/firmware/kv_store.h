@@ -0,0 +1,130 @@
+#ifndef __KV_STORE_H__
+#define __KV_STORE_H__
+
+#include <stdint.h>
+
+/*
+ * Small settings store: a log of records in a ring of flash sectors, and
+ * an index in RAM from key hash to the newest record, rebuilt on mount.
+ *
+ *   sector   magic | seq | ~seq | record | record | ...  erased after
+ *   record   crc | txn | flags, key_len, val_len | key | value | pad to 4
+ *
+ * A set or delete appends a record, nothing is rewritten in place. The
+ * records of one commit share a txn id and only the last carries KV_F_END;
+ * mount applies them once it finds that END record intact, so a commit of
+ * several keys (kv_txn_*) lands whole or not at all. A commit is a single
+ * flash write, which a power loss can tear anywhere: the CRC tells, and
+ * mount overwrites what is left of it with zeros, which the log skips a
+ * word at a time.
+ *
+ * The sector after the newest is always kept erased. When the newest is
+ * full the log moves on to it and the oldest is garbage collected into it:
+ * its live records copied, the rest (older values, deletes with nothing
+ * older left to hide) dropped, its magic cleared, then it is erased and
+ * becomes the spare. Reset in the middle of that and mount finishes the
+ * job. Commits leave KV_RESERVE bytes of each sector to the copies, for the
+ * ones a power loss tears on the way.
+ *
+ * Not locked, one task at a time.
+ */
+
+#define KV_SECTOR (4096)
+#define KV_MAX_SECTORS (64)
+#define KV_MAX_KEY (32)
+#define KV_MAX_VAL (512)
+#define KV_MAX_KEYS (128)
+#define KV_SLOTS (2 * KV_MAX_KEYS)
+#define KV_TXN_MAX (1024) /* bytes of records one commit may add */
+#define KV_TXN_KEYS (8)
+#define KV_RESERVE (1024)
+
+#define KV_F_END (1 << 0) /* last record of its txn */
+#define KV_F_DEL (1 << 1)
+
+/* the store's error codes, besides -1 for flash errors */
+#define KV_ERR_NOENT (-2)
+#define KV_ERR_FULL (-3)
+#define KV_ERR_INVAL (-4)
+
+typedef struct {
+    int (*read)(void *arg, uint32_t offset, void *dst, uint32_t len);
+    int (*write)(void *arg, uint32_t offset, const void *src, uint32_t len);
+    int (*erase)(void *arg, uint32_t offset, uint32_t len);
+    void *arg;
+} kv_flash_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t addr; /* of the record, from the start of the region */
+    uint16_t val_len;
+    uint8_t key_len;
+    uint8_t state; /* 0 empty, 1 used, 2 deleted */
+} kv_slot_t;
+
+typedef struct {
+    kv_flash_t flash;
+    uint32_t offset; /* of the region in flash */
+    uint32_t sectors;
+    int mounted;
+
+    uint32_t active; /* sector being appended to */
+    uint32_t seq;    /* its seq */
+    uint32_t pos;    /* where the next record goes in it */
+    uint32_t txn;    /* the next txn id */
+    kv_slot_t slot[KV_SLOTS];
+    uint32_t keys;
+    uint32_t live; /* bytes of the records the index points at */
+
+    /* the commit being built, on mount the records of a txn not yet ended */
+    uint8_t stage[KV_TXN_MAX];
+    uint32_t stage_len;
+    uint32_t stage_keys;
+    uint32_t stage_addr;
+    int stage_bad;
+
+    uint8_t buf[KV_TXN_MAX];
+
+    uint32_t commits;
+    uint32_t gcs;
+    uint32_t copied; /* records moved by gc */
+    uint32_t erases;
+    uint32_t dropped; /* records found torn or not committed on mount */
+} kv_t;
+
+/*
+ * Mounts the store in sectors (2 to KV_MAX_SECTORS) of KV_SECTOR from flash
+ * offset, formatting it when no sector has a valid header. Returns 0 or a
+ * negative code.
+ */
+int kv_mount(kv_t *kv, const kv_flash_t *flash, uint32_t offset, uint32_t sectors);
+
+/* Copies up to max bytes of key's value to val. Returns its full length, or KV_ERR_NOENT. */
+int kv_get(kv_t *kv, const char *key, void *val, uint32_t max);
+/*
+ * One commit each, dropping a txn being built; setting the value already
+ * there writes nothing. Return 0 or a negative code.
+ */
+int kv_set(kv_t *kv, const char *key, const void *val, uint32_t len);
+int kv_del(kv_t *kv, const char *key);
+
+/*
+ * Up to KV_TXN_KEYS sets and deletes, KV_TXN_MAX bytes of records, that
+ * land together. Nothing is visible before kv_txn_commit(), which returns
+ * 0 or a negative code, KV_ERR_INVAL if a set or delete was refused.
+ */
+void kv_txn_begin(kv_t *kv);
+int kv_txn_set(kv_t *kv, const char *key, const void *val, uint32_t len);
+int kv_txn_del(kv_t *kv, const char *key);
+int kv_txn_commit(kv_t *kv);
+
+/* Moves on to the spare sector now, collecting the oldest. Returns 0 or a negative code. */
+int kv_gc(kv_t *kv);
+
+/* Calls fn with every key (not 0 terminated) and its value length; stops when fn returns non zero. */
+void kv_foreach(kv_t *kv, int (*fn)(void *arg, const char *key, uint32_t key_len, uint32_t val_len), void *arg);
+
+/* bytes the live records may take, sets that would go past it return KV_ERR_FULL */
+uint32_t kv_capacity(const kv_t *kv);
+
+#endif /* __KV_STORE_H__ */
@@ -45,6 +45,7 @@
 #include <xram_peripheral.h>
 #include <xram_platform.h>
 
+#include "kv_store.h"
 #include "m1s_e907_xram.h"
 #ifdef SYS_USER_VFS_ROMFS_ENABLE
 #include <bl_romfs.h>
@@ -205,7 +206,10 @@ static void _cli_init()
     network_netutils_ping_cli_register();
     wifi_mgmr_cli_init();
     boot_cpu0_cli_init();
+#ifndef FEATURE_ENABLE_UVC_FRING
+    /* the SDK's own USB camera; `uvc start` takes the same USB device in its place */
     helper_usb_cam_cli_init();
+#endif
 }
 
 static void wifi_sta_connect(char *ssid, char *password)
@@ -279,13 +283,15 @@ static void bssid_str_to_mac(uint8_t *hex, char *bssid, int len)
         hex[i / 2] = (h4 << 4) + l4;
     }
 }
+extern kv_t *kv_settings(void);
 static void _connect_wifi()
 {
     /*XXX caution for BIG STACK*/
     char pmk[66], bssid[32], chan[10];
     char ssid[33], password[66];
     char val_buf[66];
-    // char val_len = sizeof(val_buf) - 1;
+    uint32_t val_len = sizeof(val_buf) - 1;
+    kv_t *kv = kv_settings();
     uint8_t mac[6];
     uint8_t band = 0;
     uint16_t freq = 0;
@@ -303,23 +309,20 @@ static void _connect_wifi()
     memset(chan, 0, sizeof(chan));
 
     memset(val_buf, 0, sizeof(val_buf));
-    /*TODO no easy flash*/
-    // ef_get_env_blob((const char *)WIFI_AP_PSM_INFO_SSID, val_buf, val_len, NULL);
+    kv_get(kv, WIFI_AP_PSM_INFO_SSID, val_buf, val_len);
     if (val_buf[0]) {
         /*We believe that when ssid is set, wifi_confi is OK*/
         strncpy(ssid, val_buf, sizeof(ssid) - 1);
 
         /*setup password ans PMK stuff from ENV*/
         memset(val_buf, 0, sizeof(val_buf));
-        /*TODO no easy flash*/
-        // ef_get_env_blob((const char *)WIFI_AP_PSM_INFO_PASSWORD, val_buf, val_len, NULL);
+        kv_get(kv, WIFI_AP_PSM_INFO_PASSWORD, val_buf, val_len);
         if (val_buf[0]) {
             strncpy(password, val_buf, sizeof(password) - 1);
         }
 
         memset(val_buf, 0, sizeof(val_buf));
-        /*TODO no easy flash*/
-        // ef_get_env_blob((const char *)WIFI_AP_PSM_INFO_PMK, val_buf, val_len, NULL);
+        kv_get(kv, WIFI_AP_PSM_INFO_PMK, val_buf, val_len);
         if (val_buf[0]) {
             strncpy(pmk, val_buf, sizeof(pmk) - 1);
         }
@@ -329,21 +332,17 @@ static void _connect_wifi()
             /*At lease pmk is not illegal, we re-cal now*/
             // XXX time consuming API, so consider lower-prirotiy for cal PSK to avoid sound glitch
             wifi_mgmr_psk_cal(password, ssid, strlen(ssid), pmk);
-            /* TODO add easy flash*/
-            // ef_set_env(WIFI_AP_PSM_INFO_PMK, pmk);
-            // ef_save_env();
+            kv_set(kv, WIFI_AP_PSM_INFO_PMK, pmk, strlen(pmk));
         }
         memset(val_buf, 0, sizeof(val_buf));
-        /*TODO no easy flash*/
-        // ef_get_env_blob((const char *)WIFI_AP_PSM_INFO_CHANNEL, val_buf, val_len, NULL);
+        kv_get(kv, WIFI_AP_PSM_INFO_CHANNEL, val_buf, val_len);
         if (val_buf[0]) {
             strncpy(chan, val_buf, sizeof(chan) - 1);
             printf("connect wifi channel = %s\r\n", chan);
             _chan_str_to_hex(&band, &freq, chan);
         }
         memset(val_buf, 0, sizeof(val_buf));
-        /*TODO no easy flash*/
-        // ef_get_env_blob((const char *)WIFI_AP_PSM_INFO_BSSID, val_buf, val_len, NULL);
+        kv_get(kv, WIFI_AP_PSM_INFO_BSSID, val_buf, val_len);
         if (val_buf[0]) {
             strncpy(bssid, val_buf, sizeof(bssid) - 1);
             printf("connect wifi bssid = %s\r\n", bssid);
@@ -356,8 +355,8 @@ static void _connect_wifi()
     } else {
         /*Won't connect, since ssid config is empty*/
         puts("[APP]    Empty Config\r\n");
-        puts("[APP]    Try to set the following ENV with psm_set command, then reboot\r\n");
-        puts("[APP]    NOTE: " WIFI_AP_PSM_INFO_PMK " MUST be psm_unset when conf is changed\r\n");
+        puts("[APP]    Try to set the following keys with the kv set command, then reboot\r\n");
+        puts("[APP]    NOTE: " WIFI_AP_PSM_INFO_PMK " MUST be kv del when conf is changed\r\n");
         puts("[APP]    env: " WIFI_AP_PSM_INFO_SSID "\r\n");
         puts("[APP]    env: " WIFI_AP_PSM_INFO_PASSWORD "\r\n");
         puts("[APP]    env(optinal): " WIFI_AP_PSM_INFO_PMK "\r\n");
@@ -610,10 +609,30 @@ void send_data_per_second(int sockfd, struct sockaddr_in *client_addr, socklen_t
     }
 }
 
+extern void cmd_stream_file(char *buf, int len, int argc, char **argv);
+extern void cmd_mjpeg_http(char *buf, int len, int argc, char **argv);
+extern void cmd_rtp_file(char *buf, int len, int argc, char **argv);
+extern void cmd_fring(char *buf, int len, int argc, char **argv);
+extern void cmd_xrpc(char *buf, int len, int argc, char **argv);
+extern void cmd_uvc(char *buf, int len, int argc, char **argv);
+extern void cmd_avirec(char *buf, int len, int argc, char **argv);
+extern void cmd_audio_udp(char *buf, int len, int argc, char **argv);
+extern void cmd_kv(char *buf, int len, int argc, char **argv);
 const static struct cli_command cmds_user[] STATIC_CLI_CMD_ATTRIBUTE = {
     {"stack_wifi", "Wi-Fi Stack", cmd_stack_wifi},
     {"stack_mgmr", "Wi-Fi Stack", cmd_stack_mgmr},
     {"wifi", "wifi", cmd_wifi},
+    {"stream_file", "windowed mjpeg stream of a file", cmd_stream_file},
+    {"mjpeg_http", "mjpeg over http server", cmd_mjpeg_http},
+    {"rtp_file", "rtp/jpeg stream of a file", cmd_rtp_file},
+    {"fring", "frames from the c906 shared ring", cmd_fring},
+    {"xrpc", "batched call server for the c906", cmd_xrpc},
+#ifdef FEATURE_ENABLE_UVC_FRING
+    {"uvc", "multi-format uvc camera", cmd_uvc},
+#endif
+    {"avirec", "mjpeg to avi recorder on the sd card", cmd_avirec},
+    {"audio_udp", "rtp audio stream of the microphone or a tone", cmd_audio_udp},
+    {"kv", "settings store on flash", cmd_kv},
 };
 
 void bfl_main()
@@ -0,0 +1,439 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define closesocket close
+#define MH_SEND_FLAGS (MSG_DONTWAIT | MSG_NOSIGNAL)
+#define mh_lock_init(l) pthread_mutex_init(l, NULL)
+#define mh_lock_deinit(l) pthread_mutex_destroy(l)
+#define mh_lock(l) pthread_mutex_lock(l)
+#define mh_unlock(l) pthread_mutex_unlock(l)
+#else
+#include <lwip/sockets.h>
+#include <lwip/tcp.h>
+#define MH_SEND_FLAGS (MSG_DONTWAIT)
+#define mh_lock_init(l) (*(l) = xSemaphoreCreateMutex())
+#define mh_lock_deinit(l) vSemaphoreDelete(*(l))
+#define mh_lock(l) xSemaphoreTake(*(l), portMAX_DELAY)
+#define mh_unlock(l) xSemaphoreGive(*(l))
+#endif
+
+#include "mjpeg_http.h"
+
+#define MH_BOUNDARY "m1sframe"
+
+static const char stream_resp[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: multipart/x-mixed-replace; boundary=" MH_BOUNDARY "\r\n"
+    "Cache-Control: no-cache, no-store\r\n"
+    "Pragma: no-cache\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+static void frame_ref(mh_frame_t *f)
+{
+    f->refs++;
+}
+
+static void frame_unref(mjpeg_http_t *srv, mh_frame_t *f)
+{
+    if (f && 0 == --f->refs) {
+        free(f);
+        srv->frames_alive--;
+    }
+}
+
+static void set_head(mh_client_t *c, const char *text, uint32_t len)
+{
+    if (len > sizeof(c->head)) {
+        len = sizeof(c->head);
+    }
+    memcpy(c->head, text, len);
+    c->head_len = len;
+    c->tail_len = 0;
+    c->off = 0;
+}
+
+static int part_pending(const mh_client_t *c)
+{
+    return c->head_len || c->cur;
+}
+
+static void client_close(mjpeg_http_t *srv, mh_client_t *c)
+{
+    closesocket(c->sock);
+    frame_unref(srv, c->cur);
+    frame_unref(srv, c->next);
+    memset(c, 0, sizeof(*c));
+    c->sock = -1;
+}
+
+/* move the pending frame into the part slot as the next multipart section */
+static void start_stream_part(mh_client_t *c)
+{
+    c->cur = c->next;
+    c->next = NULL;
+    c->head_len = snprintf(c->head, sizeof(c->head),
+                           "--" MH_BOUNDARY "\r\n"
+                           "Content-Type: image/jpeg\r\n"
+                           "Content-Length: %lu\r\n"
+                           "X-Frame-Seq: %lu\r\n"
+                           "\r\n",
+                           (unsigned long)c->cur->len, (unsigned long)c->cur->seq);
+    c->tail_len = 2;
+    c->off = 0;
+}
+
+/*
+ * Send as much as the socket takes without blocking.
+ * Returns 0 to keep the client, -1 to close it.
+ */
+static int client_flush(mjpeg_http_t *srv, mh_client_t *c)
+{
+    while (1) {
+        if (!part_pending(c)) {
+            if (MH_ONESHOT == c->state) {
+                return -1;
+            }
+            if (MH_STREAM != c->state || NULL == c->next) {
+                return 0;
+            }
+            start_stream_part(c);
+        }
+
+        uint32_t jpeg_len = c->cur ? c->cur->len : 0;
+        uint32_t total = c->head_len + jpeg_len + c->tail_len;
+        const uint8_t *p;
+        uint32_t n;
+        if (c->off < c->head_len) {
+            p = (const uint8_t *)c->head + c->off;
+            n = c->head_len - c->off;
+        } else if (c->off < c->head_len + jpeg_len) {
+            p = c->cur->data + (c->off - c->head_len);
+            n = c->head_len + jpeg_len - c->off;
+        } else {
+            p = (const uint8_t *)"\r\n" + (c->off - c->head_len - jpeg_len);
+            n = total - c->off;
+        }
+
+        int ret = send(c->sock, p, n, MH_SEND_FLAGS);
+        if (ret < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        c->off += ret;
+        c->bytes += ret;
+        if (c->off < total) {
+            continue;
+        }
+
+        /* part complete */
+        if (c->cur) {
+            c->frames++;
+            frame_unref(srv, c->cur);
+            c->cur = NULL;
+        }
+        c->head_len = 0;
+        c->tail_len = 0;
+        c->off = 0;
+    }
+}
+
+static void reply_status(mh_client_t *c, const char *status)
+{
+    char text[MJPEG_HTTP_HEAD_SIZE];
+    int len = snprintf(text, sizeof(text), "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+    set_head(c, text, len);
+    c->state = MH_ONESHOT;
+}
+
+static void handle_request(mjpeg_http_t *srv, mh_client_t *c)
+{
+    char path[64];
+
+    if (1 != sscanf(c->req, "GET %63s HTTP/", path)) {
+        reply_status(c, "400 Bad Request");
+        return;
+    }
+    char *query = strchr(path, '?');
+    if (query) {
+        *query = '\0';
+    }
+
+    if (0 == strcmp(path, "/") || 0 == strcmp(path, "/stream")) {
+        set_head(c, stream_resp, sizeof(stream_resp) - 1);
+        c->state = MH_STREAM;
+        /* start with the newest frame instead of waiting a whole tick */
+        if (srv->latest) {
+            frame_ref(srv->latest);
+            c->next = srv->latest;
+        }
+    } else if (0 == strcmp(path, "/snapshot") || 0 == strcmp(path, "/snapshot.jpg")) {
+        if (NULL == srv->latest) {
+            reply_status(c, "503 Service Unavailable");
+            return;
+        }
+        char text[MJPEG_HTTP_HEAD_SIZE];
+        int len = snprintf(text, sizeof(text),
+                           "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: image/jpeg\r\n"
+                           "Content-Length: %lu\r\n"
+                           "Cache-Control: no-cache, no-store\r\n"
+                           "Connection: close\r\n"
+                           "\r\n",
+                           (unsigned long)srv->latest->len);
+        set_head(c, text, len);
+        frame_ref(srv->latest);
+        c->cur = srv->latest;
+        c->state = MH_ONESHOT;
+    } else {
+        reply_status(c, "404 Not Found");
+    }
+}
+
+/* returns -1 when the peer closed or the request is unusable */
+static int client_read(mjpeg_http_t *srv, mh_client_t *c)
+{
+    char scratch[64];
+
+    if (MH_REQUEST != c->state) {
+        /* nothing is expected after the request, only watch for a close */
+        int n = recv(c->sock, scratch, sizeof(scratch), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            return -1;
+        }
+        return 0;
+    }
+
+    int n = recv(c->sock, c->req + c->req_len, sizeof(c->req) - 1 - c->req_len, MSG_DONTWAIT);
+    if (n == 0) {
+        return -1;
+    }
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    c->req_len += n;
+    c->req[c->req_len] = '\0';
+
+    if (strstr(c->req, "\r\n\r\n")) {
+        handle_request(srv, c);
+    } else if (c->req_len >= sizeof(c->req) - 1) {
+        reply_status(c, "431 Request Header Fields Too Large");
+    }
+    return 0;
+}
+
+static void accept_client(mjpeg_http_t *srv)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int sock = accept(srv->listen_sock, (struct sockaddr *)&addr, &addr_len);
+    if (sock < 0) {
+        return;
+    }
+
+    mh_client_t *c = NULL;
+    for (int i = 0; i < MJPEG_HTTP_MAX_CLIENTS; i++) {
+        if (MH_FREE == srv->clients[i].state) {
+            c = &srv->clients[i];
+            break;
+        }
+    }
+    if (NULL == c) {
+        static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send(sock, busy, sizeof(busy) - 1, MH_SEND_FLAGS);
+        closesocket(sock);
+        srv->rejected++;
+        return;
+    }
+
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    memset(c, 0, sizeof(*c));
+    c->sock = sock;
+    c->state = MH_REQUEST;
+    c->ip = ntohl(addr.sin_addr.s_addr);
+    c->port = ntohs(addr.sin_port);
+    srv->accepted++;
+}
+
+int mjpeg_http_start(mjpeg_http_t *srv, uint16_t port)
+{
+    memset(srv, 0, sizeof(*srv));
+    for (int i = 0; i < MJPEG_HTTP_MAX_CLIENTS; i++) {
+        srv->clients[i].sock = -1;
+    }
+    if ((srv->listen_sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        printf("[mjpeg_http] socket failed\r\n");
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(srv->listen_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (0 != bind(srv->listen_sock, (struct sockaddr *)&addr, sizeof(addr)) ||
+        0 != listen(srv->listen_sock, MJPEG_HTTP_MAX_CLIENTS)) {
+        printf("[mjpeg_http] bind/listen on port %u failed\r\n", port);
+        closesocket(srv->listen_sock);
+        srv->listen_sock = -1;
+        return -1;
+    }
+    mh_lock_init(&srv->lock);
+    return 0;
+}
+
+void mjpeg_http_stop(mjpeg_http_t *srv)
+{
+    if (srv->listen_sock < 0) {
+        return;
+    }
+    mh_lock(&srv->lock);
+    for (int i = 0; i < MJPEG_HTTP_MAX_CLIENTS; i++) {
+        if (MH_FREE != srv->clients[i].state) {
+            client_close(srv, &srv->clients[i]);
+        }
+    }
+    frame_unref(srv, srv->latest);
+    srv->latest = NULL;
+    closesocket(srv->listen_sock);
+    srv->listen_sock = -1;
+    mh_unlock(&srv->lock);
+    mh_lock_deinit(&srv->lock);
+}
+
+int mjpeg_http_publish(mjpeg_http_t *srv, const uint8_t *jpeg, uint32_t len)
+{
+    /* the only copy of the frame, made before taking the lock */
+    mh_frame_t *f = malloc(sizeof(mh_frame_t) + len);
+    if (NULL == f) {
+        mh_lock(&srv->lock);
+        srv->alloc_fail++;
+        mh_unlock(&srv->lock);
+        return -1;
+    }
+    memcpy(f->data, jpeg, len);
+    f->len = len;
+    f->refs = 1; /* held as latest */
+
+    int queued = 0;
+    mh_lock(&srv->lock);
+    f->seq = srv->seq++;
+    srv->frames_alive++;
+    frame_unref(srv, srv->latest);
+    srv->latest = f;
+
+    for (int i = 0; i < MJPEG_HTTP_MAX_CLIENTS; i++) {
+        mh_client_t *c = &srv->clients[i];
+        if (MH_STREAM != c->state) {
+            continue;
+        }
+        if (c->next) {
+            frame_unref(srv, c->next);
+            c->dropped++;
+        }
+        frame_ref(f);
+        c->next = f;
+        queued++;
+        /* idle clients get the frame now rather than at the next poll */
+        if (!part_pending(c) && 0 != client_flush(srv, c)) {
+            client_close(srv, c);
+        }
+    }
+    mh_unlock(&srv->lock);
+    return queued;
+}
+
+int mjpeg_http_poll(mjpeg_http_t *srv, uint32_t timeout_ms)
+{
+    fd_set rfds, wfds;
+    int max_fd = srv->listen_sock;
+
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_SET(srv->listen_sock, &rfds);
+
+    mh_lock(&srv->lock);
+    for (int i = 0; i < MJPEG_HTTP_MAX_CLIENTS; i++) {
+        mh_client_t *c = &srv->clients[i];
+        if (MH_FREE == c->state) {
+            continue;
+        }
+        FD_SET(c->sock, &rfds);
+        if (part_pending(c) || c->next) {
+            FD_SET(c->sock, &wfds);
+        }
+        if (c->sock > max_fd) {
+            max_fd = c->sock;
+        }
+    }
+    mh_unlock(&srv->lock);
+
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    int ret = select(max_fd + 1, &rfds, &wfds, NULL, &tv);
+    if (ret < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    int connected = 0;
+    mh_lock(&srv->lock);
+    if (FD_ISSET(srv->listen_sock, &rfds)) {
+        accept_client(srv);
+    }
+    for (int i = 0; i < MJPEG_HTTP_MAX_CLIENTS; i++) {
+        mh_client_t *c = &srv->clients[i];
+        if (MH_FREE == c->state) {
+            continue;
+        }
+        /* a client accepted in this round is not in the fd sets yet */
+        int readable = ret > 0 && FD_ISSET(c->sock, &rfds);
+        int writable = ret > 0 && FD_ISSET(c->sock, &wfds);
+        if (readable && 0 != client_read(srv, c)) {
+            client_close(srv, c);
+            continue;
+        }
+        if ((writable || part_pending(c)) && 0 != client_flush(srv, c)) {
+            client_close(srv, c);
+            continue;
+        }
+        connected++;
+    }
+    mh_unlock(&srv->lock);
+    return connected;
+}
+
+void mjpeg_http_dump(mjpeg_http_t *srv)
+{
+    static const char *state_name[] = {"free", "request", "stream", "oneshot"};
+
+    mh_lock(&srv->lock);
+    printf("[mjpeg_http] published %lu, accepted %lu, rejected %lu, alloc fail %lu, frames alive %lu\r\n",
+           (unsigned long)srv->seq, (unsigned long)srv->accepted, (unsigned long)srv->rejected,
+           (unsigned long)srv->alloc_fail, (unsigned long)srv->frames_alive);
+    for (int i = 0; i < MJPEG_HTTP_MAX_CLIENTS; i++) {
+        mh_client_t *c = &srv->clients[i];
+        if (MH_FREE == c->state) {
+            continue;
+        }
+        printf("  [%d] %lu.%lu.%lu.%lu:%u %s, frames %lu, dropped %lu, %lu KB\r\n", i,
+               (unsigned long)(c->ip >> 24), (unsigned long)(c->ip >> 16 & 0xff), (unsigned long)(c->ip >> 8 & 0xff),
+               (unsigned long)(c->ip & 0xff), c->port, state_name[c->state], (unsigned long)c->frames,
+               (unsigned long)c->dropped, (unsigned long)(c->bytes >> 10));
+    }
+    mh_unlock(&srv->lock);
+}
@@ -0,0 +1,102 @@
+#ifndef __MJPEG_HTTP_H__
+#define __MJPEG_HTTP_H__
+
+#include <stdint.h>
+
+#ifdef __linux__
+#include <pthread.h>
+typedef pthread_mutex_t mh_lock_t;
+#else
+#include <FreeRTOS.h>
+#include <semphr.h>
+typedef SemaphoreHandle_t mh_lock_t;
+#endif
+
+/*
+ * MJPEG over HTTP (multipart/x-mixed-replace) for several clients.
+ *
+ *   GET /  or  /stream    endless multipart stream
+ *   GET /snapshot         latest frame as a single image/jpeg
+ *
+ * mjpeg_http_publish() copies an encoded frame once into a reference counted
+ * buffer shared by every client. Each client is sending at most one frame and
+ * holds at most one more as pending; a newer frame replaces the pending one,
+ * so a slow client skips frames and never holds back the camera or the other
+ * clients. All sockets are non-blocking, one task runs mjpeg_http_poll() and
+ * any other task may publish.
+ */
+
+/* bounded by the lwIP socket count (MEMP_NUM_NETCONN) on the device */
+#ifndef MJPEG_HTTP_MAX_CLIENTS
+#define MJPEG_HTTP_MAX_CLIENTS (4)
+#endif
+#define MJPEG_HTTP_REQ_SIZE (512)
+#define MJPEG_HTTP_HEAD_SIZE (160)
+
+typedef struct {
+    uint32_t refs;
+    uint32_t seq;
+    uint32_t len;
+    uint8_t data[];
+} mh_frame_t;
+
+typedef enum {
+    MH_FREE = 0,
+    MH_REQUEST, /* reading the request header */
+    MH_STREAM,  /* multipart stream */
+    MH_ONESHOT, /* single response, closed once sent */
+} mh_state_t;
+
+typedef struct {
+    int sock;
+    mh_state_t state;
+    char req[MJPEG_HTTP_REQ_SIZE];
+    uint32_t req_len;
+
+    /* part in flight: head, then cur->data, then tail bytes of "\r\n" */
+    char head[MJPEG_HTTP_HEAD_SIZE];
+    uint32_t head_len;
+    uint32_t tail_len;
+    mh_frame_t *cur;
+    mh_frame_t *next;
+    uint32_t off;
+
+    uint32_t frames;
+    uint32_t dropped; /* replaced while pending */
+    uint64_t bytes;
+    uint32_t ip;
+    uint16_t port;
+} mh_client_t;
+
+typedef struct {
+    int listen_sock;
+    mh_lock_t lock;
+    mh_client_t clients[MJPEG_HTTP_MAX_CLIENTS];
+    mh_frame_t *latest;
+
+    uint32_t seq;
+    uint32_t accepted;
+    uint32_t rejected; /* no free client slot */
+    uint32_t alloc_fail;
+    uint32_t frames_alive;
+} mjpeg_http_t;
+
+int mjpeg_http_start(mjpeg_http_t *srv, uint16_t port);
+void mjpeg_http_stop(mjpeg_http_t *srv);
+
+/*
+ * Share one encoded frame with every streaming client. Never blocks on a
+ * client. Returns the number of clients it was queued for, -1 without memory.
+ */
+int mjpeg_http_publish(mjpeg_http_t *srv, const uint8_t *jpeg, uint32_t len);
+
+/*
+ * Accept clients, parse requests and push pending data, waiting at most
+ * timeout_ms for socket activity. Returns the number of connected clients,
+ * or -1 if the listening socket failed.
+ */
+int mjpeg_http_poll(mjpeg_http_t *srv, uint32_t timeout_ms);
+
+void mjpeg_http_dump(mjpeg_http_t *srv);
+
+#endif /* __MJPEG_HTTP_H__ */
@@ -0,0 +1,122 @@
+#include <FreeRTOS.h>
+#include <aos/kernel.h>
+#include <cli.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <task.h>
+
+#include "mjpeg_http.h"
+#include "mjpeg_src.h"
+
+#define HTTP_MAX_FRAME (96 * 1024)
+
+typedef struct {
+    uint16_t port;
+    uint32_t fps;
+    char path[64];
+} mjpeg_http_arg_t;
+
+static mjpeg_http_t s_http;
+static volatile int s_http_running;
+
+/*
+ * One task serves the sockets and, once per tick, publishes the next frame
+ * of the file. A camera driver would call mjpeg_http_publish() from its own
+ * task instead; the server side stays the same.
+ */
+static void mjpeg_http_task(void *pvParameters)
+{
+    mjpeg_http_arg_t *arg = pvParameters;
+    uint8_t *frame = pvPortMalloc(HTTP_MAX_FRAME);
+    mjpeg_src_t src = {.fd = -1};
+    int started = 0;
+
+    if (NULL == frame) {
+        printf("[mjpeg_http] no memory\r\n");
+        goto exit;
+    }
+    if (0 != mjpeg_src_open(&src, arg->path)) {
+        printf("[mjpeg_http] open %s failed\r\n", arg->path);
+        goto exit;
+    }
+    if (0 != mjpeg_http_start(&s_http, arg->port)) {
+        goto exit;
+    }
+    started = 1;
+    printf("[mjpeg_http] serving %s on port %u, http://<ip>:%u/stream\r\n", arg->path, arg->port, arg->port);
+
+    uint32_t period_ms = 1000 / (arg->fps ? arg->fps : 30);
+    uint32_t next_ms = aos_now_ms();
+
+    while (s_http_running) {
+        int32_t wait_ms = (int32_t)(next_ms - aos_now_ms());
+        if (wait_ms > 0) {
+            if (mjpeg_http_poll(&s_http, wait_ms) < 0) {
+                printf("[mjpeg_http] listen socket failed\r\n");
+                break;
+            }
+            continue;
+        }
+        next_ms += period_ms;
+
+        int len = mjpeg_src_next(&src, frame, HTTP_MAX_FRAME);
+        if (0 == len) {
+            printf("[mjpeg_http] no jpeg in %s\r\n", arg->path);
+            break;
+        }
+        if (len > 0) {
+            mjpeg_http_publish(&s_http, frame, len);
+        }
+    }
+
+exit:
+    if (started) {
+        mjpeg_http_dump(&s_http);
+        mjpeg_http_stop(&s_http);
+    }
+    mjpeg_src_close(&src);
+    vPortFree(frame);
+    vPortFree(arg);
+    s_http_running = 0;
+    vTaskDelete(NULL);
+}
+
+void cmd_mjpeg_http(char *buf, int len, int argc, char **argv)
+{
+    if (2 == argc && 0 == strcmp(argv[1], "stop")) {
+        s_http_running = 0;
+        return;
+    }
+    if (2 == argc && 0 == strcmp(argv[1], "stat")) {
+        if (s_http_running) {
+            mjpeg_http_dump(&s_http);
+        }
+        return;
+    }
+    if (argc < 3 || 0 != strcmp(argv[1], "start")) {
+        printf("Usage: mjpeg_http start <file.mjpeg> [port] [fps]\r\n");
+        printf("       mjpeg_http stat\r\n");
+        printf("       mjpeg_http stop\r\n");
+        return;
+    }
+    if (s_http_running) {
+        printf("mjpeg_http already running\r\n");
+        return;
+    }
+
+    mjpeg_http_arg_t *arg = pvPortMalloc(sizeof(*arg));
+    if (NULL == arg) {
+        return;
+    }
+    memset(arg, 0, sizeof(*arg));
+    strncpy(arg->path, argv[2], sizeof(arg->path) - 1);
+    arg->port = argc > 3 ? atoi(argv[3]) : 80;
+    arg->fps = argc > 4 ? atoi(argv[4]) : 30;
+
+    s_http_running = 1;
+    if (pdPASS != xTaskCreate(mjpeg_http_task, "mjpeg_http", 1024, arg, 10, NULL)) {
+        s_http_running = 0;
+        vPortFree(arg);
+    }
+}
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vfs.h>
+
+#include "mjpeg_src.h"
+
+int mjpeg_src_open(mjpeg_src_t *src, const char *path)
+{
+    memset(src, 0, sizeof(*src));
+    src->fd = -1;
+    if (NULL == (src->chunk = malloc(MJPEG_SRC_CHUNK))) {
+        return -1;
+    }
+    if ((src->fd = aos_open(path, 0)) < 0) {
+        free(src->chunk);
+        src->chunk = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void mjpeg_src_close(mjpeg_src_t *src)
+{
+    if (src->fd >= 0) aos_close(src->fd);
+    free(src->chunk);
+    src->chunk = NULL;
+    src->fd = -1;
+}
+
+/* one pass from the current position, 0 at EOF */
+static int scan_frame(mjpeg_src_t *src, uint8_t *frame, uint32_t max)
+{
+    uint32_t len = 0;
+    uint8_t prev = 0;
+    int in_frame = 0;
+
+    while (1) {
+        if (src->pos >= src->len) {
+            int n = aos_read(src->fd, src->chunk, MJPEG_SRC_CHUNK);
+            if (n <= 0) {
+                return 0;
+            }
+            src->pos = 0;
+            src->len = n;
+        }
+        uint8_t b = src->chunk[src->pos++];
+
+        if (!in_frame) {
+            if (0xff == prev && 0xd8 == b) {
+                in_frame = 1;
+                frame[0] = 0xff;
+                frame[1] = 0xd8;
+                len = 2;
+            }
+        } else {
+            if (len >= max) {
+                return -1;
+            }
+            frame[len++] = b;
+            if (0xff == prev && 0xd9 == b) {
+                return len;
+            }
+        }
+        prev = b;
+    }
+}
+
+int mjpeg_src_next(mjpeg_src_t *src, uint8_t *frame, uint32_t max)
+{
+    int len = scan_frame(src, frame, max);
+    if (0 == len) {
+        aos_lseek(src->fd, 0, SEEK_SET);
+        src->pos = src->len = 0;
+        len = scan_frame(src, frame, max);
+    }
+    return len;
+}
@@ -0,0 +1,26 @@
+#ifndef __MJPEG_SRC_H__
+#define __MJPEG_SRC_H__
+
+#include <stdint.h>
+
+#define MJPEG_SRC_CHUNK (4 * 1024)
+
+/* JPEG frames (SOI .. EOI) read back from a file of concatenated frames */
+typedef struct {
+    int fd;
+    uint8_t *chunk;
+    uint32_t pos;
+    uint32_t len;
+} mjpeg_src_t;
+
+int mjpeg_src_open(mjpeg_src_t *src, const char *path);
+void mjpeg_src_close(mjpeg_src_t *src);
+
+/*
+ * Copy the next frame into frame, wrapping to the start of the file at EOF.
+ * Returns the frame length, 0 if the file holds no frame, -1 if a frame is
+ * larger than max (it is skipped).
+ */
+int mjpeg_src_next(mjpeg_src_t *src, uint8_t *frame, uint32_t max);
+
+#endif /* __MJPEG_SRC_H__ */
@@ -0,0 +1,135 @@
+#include <string.h>
+
+#include "rate_ctrl.h"
+
+/* rate estimate never drops below this, so one idle second can't lock us at level 0 */
+#define RC_MIN_RATE (8 * 1024)
+/* a level is only tried when the rate covers its frames with this much spare */
+#define RC_UP_HEADROOM_PCT (130)
+
+void rc_default_cfg(rc_cfg_t *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->target_ms = 200;
+    cfg->fps = 30;
+    cfg->levels = 4;
+    cfg->start_level = 1;
+    cfg->down_hold_ms = 300;
+    cfg->up_hold_ms = 3000;
+}
+
+void rc_init(rc_t *rc, const rc_cfg_t *cfg, uint32_t now_ms)
+{
+    memset(rc, 0, sizeof(*rc));
+    rc->cfg = *cfg;
+    if (0 == rc->cfg.levels || rc->cfg.levels > RC_MAX_LEVELS) {
+        rc->cfg.levels = RC_MAX_LEVELS;
+    }
+    if (0 == rc->cfg.fps) {
+        rc->cfg.fps = 30;
+    }
+    rc->level = cfg->start_level < rc->cfg.levels ? cfg->start_level : rc->cfg.levels - 1;
+
+    /* unknown sizes: each level about 1.5x the one below */
+    uint32_t size = cfg->level_bytes[0] ? cfg->level_bytes[0] : 8 * 1024;
+    for (int i = 0; i < rc->cfg.levels; i++) {
+        if (cfg->level_bytes[i]) {
+            size = cfg->level_bytes[i];
+        }
+        rc->size_est[i] = size;
+        size = size * 3 / 2;
+    }
+    rc->rate_bps = rc->size_est[rc->level] * rc->cfg.fps;
+    rc->last_sample_ms = now_ms;
+    rc->over_since_ms = rc->under_since_ms = now_ms;
+}
+
+void rc_sample(rc_t *rc, uint32_t now_ms, uint64_t delivered, uint32_t backlog)
+{
+    uint32_t dt = now_ms - rc->last_sample_ms;
+    if (dt < 50) {
+        return;
+    }
+    uint32_t measured = (uint32_t)((delivered - rc->last_delivered) * 1000 / dt);
+
+    /*
+     * Only a busy link shows its capacity. While data was waiting the
+     * measurement is the link rate and the estimate follows it both ways;
+     * an idle link only tells us the rate is at least what was delivered.
+     */
+    if (rc->last_backlog > 0 && backlog > 0) {
+        rc->rate_bps = (rc->rate_bps * 3 + measured) / 4;
+        rc->rate_busy = 1;
+    } else {
+        if (measured > rc->rate_bps) {
+            rc->rate_bps = measured;
+        }
+        rc->rate_busy = 0;
+    }
+    if (rc->rate_bps < RC_MIN_RATE) {
+        rc->rate_bps = RC_MIN_RATE;
+    }
+
+    rc->last_delivered = delivered;
+    rc->last_backlog = backlog;
+    rc->last_sample_ms = now_ms;
+}
+
+static void step_level(rc_t *rc, uint32_t now_ms, int over, int under)
+{
+    if (!over) {
+        rc->over = 0;
+    } else if (!rc->over) {
+        rc->over = 1;
+        rc->over_since_ms = now_ms;
+    }
+    if (!under) {
+        rc->under = 0;
+    } else if (!rc->under) {
+        rc->under = 1;
+        rc->under_since_ms = now_ms;
+    }
+
+    if (rc->over && now_ms - rc->over_since_ms >= rc->cfg.down_hold_ms && rc->level > 0) {
+        rc->level--;
+        rc->steps_down++;
+        rc->over_since_ms = now_ms;
+        rc->under = 0;
+        return;
+    }
+
+    if (rc->under && now_ms - rc->under_since_ms >= rc->cfg.up_hold_ms && rc->level + 1 < rc->cfg.levels) {
+        /* an idle link has spare room we can't measure, only a busy one can say no */
+        uint64_t need = (uint64_t)rc->size_est[rc->level + 1] * rc->cfg.fps * RC_UP_HEADROOM_PCT / 100;
+        if (!rc->rate_busy || rc->rate_bps >= need) {
+            rc->level++;
+            rc->steps_up++;
+            rc->over = 0;
+        }
+        rc->under_since_ms = now_ms;
+    }
+}
+
+int rc_admit(rc_t *rc, uint32_t now_ms, uint32_t frame_bytes, uint32_t backlog)
+{
+    rc->offered++;
+
+    /* learn what this level really costs */
+    uint32_t *est = &rc->size_est[rc->level];
+    *est = (*est * 7 + frame_bytes) / 8;
+
+    uint32_t expect_ms = (uint32_t)(((uint64_t)backlog + frame_bytes) * 1000 / rc->rate_bps);
+    rc->lat_ms = (rc->lat_ms * 7 + expect_ms) / 8;
+
+    /* send when the link is empty whatever the estimate says, it is the only way to measure */
+    int send = 0 == backlog || expect_ms <= rc->cfg.target_ms;
+
+    step_level(rc, now_ms, rc->lat_ms > rc->cfg.target_ms || !send, rc->lat_ms < rc->cfg.target_ms / 2 && send);
+
+    if (send) {
+        rc->sent++;
+    } else {
+        rc->skipped++;
+    }
+    return send;
+}
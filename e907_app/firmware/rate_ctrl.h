@@ -0,0 +1,71 @@
+#ifndef __RATE_CTRL_H__
+#define __RATE_CTRL_H__
+
+#include <stdint.h>
+
+/*
+ * Frame rate and quality control for streaming over a link of unknown,
+ * changing bandwidth. No OS or socket calls, so it runs the same on the
+ * board and in tools/rate_ctrl_sim.c.
+ *
+ * The caller reports how many bytes the link has delivered so far and how
+ * many are still queued in it (sent but not acknowledged). For every new
+ * frame rc_admit() says whether to send it now or skip it; a skipped frame
+ * is never queued, so whatever goes out next is the newest capture. Quality
+ * levels (0 = smallest frames) are stepped down quickly when the expected
+ * latency stays over target and up slowly, only once the measured rate has
+ * room for the bigger frames.
+ */
+
+#define RC_MAX_LEVELS (8)
+
+typedef struct {
+    uint32_t target_ms;    /* latency to stay under, capture to delivery */
+    uint32_t fps;          /* capture rate */
+    uint8_t levels;        /* quality levels in use, <= RC_MAX_LEVELS */
+    uint8_t start_level;
+    uint32_t down_hold_ms; /* over target this long: one level down */
+    uint32_t up_hold_ms;   /* well under target this long: one level up */
+    uint32_t level_bytes[RC_MAX_LEVELS]; /* initial frame size guess per level, 0 to derive */
+} rc_cfg_t;
+
+typedef struct {
+    rc_cfg_t cfg;
+    uint8_t level;
+
+    uint32_t rate_bps;    /* delivered bytes per second, estimate */
+    uint8_t rate_busy;    /* estimate taken while the link was saturated */
+    uint32_t lat_ms;      /* smoothed expected latency of sent frames */
+    uint32_t size_est[RC_MAX_LEVELS];
+    uint64_t last_delivered;
+    uint32_t last_backlog;
+    uint32_t last_sample_ms;
+    uint32_t over_since_ms;
+    uint32_t under_since_ms;
+    uint8_t over, under;
+
+    uint32_t offered;
+    uint32_t sent;
+    uint32_t skipped;
+    uint32_t steps_down;
+    uint32_t steps_up;
+} rc_t;
+
+void rc_default_cfg(rc_cfg_t *cfg);
+void rc_init(rc_t *rc, const rc_cfg_t *cfg, uint32_t now_ms);
+
+/* link progress: bytes delivered since start and bytes still in the link */
+void rc_sample(rc_t *rc, uint32_t now_ms, uint64_t delivered, uint32_t backlog);
+
+/*
+ * A frame of frame_bytes was captured at the current level. Returns 1 to
+ * send it, 0 to skip it. May change the level for the next capture.
+ */
+int rc_admit(rc_t *rc, uint32_t now_ms, uint32_t frame_bytes, uint32_t backlog);
+
+static inline uint8_t rc_level(const rc_t *rc)
+{
+    return rc->level;
+}
+
+#endif /* __RATE_CTRL_H__ */
@@ -0,0 +1,368 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rtp_audio.h"
+
+static const int16_t ima_step[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+static const int8_t ima_index[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+static inline uint16_t get_be16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)get_be16(p) << 16) | get_be16(p + 2);
+}
+
+static inline uint8_t *put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+    return p + 2;
+}
+
+static inline uint8_t *put_be32(uint8_t *p, uint32_t v)
+{
+    put_be16(p, v >> 16);
+    return put_be16(p + 2, v);
+}
+
+/* the decoder's step, shared by both sides so they track the same state */
+static void ima_update(ima_state_t *st, uint8_t code)
+{
+    int32_t step = ima_step[st->index], diff = step >> 3, pred = st->predicted;
+    int32_t index = st->index + ima_index[code & 7];
+
+    if (code & 4) diff += step;
+    if (code & 2) diff += step >> 1;
+    if (code & 1) diff += step >> 2;
+    pred += (code & 8) ? -diff : diff;
+    st->predicted = pred > 32767 ? 32767 : pred < -32768 ? -32768 : pred;
+    st->index = index < 0 ? 0 : index > 88 ? 88 : index;
+}
+
+static uint8_t ima_code(ima_state_t *st, int16_t sample)
+{
+    int32_t step = ima_step[st->index], diff = sample - st->predicted;
+    uint8_t code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+    }
+    if (diff >= step >> 1) {
+        code |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= step >> 2) {
+        code |= 1;
+    }
+    ima_update(st, code);
+    return code;
+}
+
+void ima_encode(ima_state_t *st, const int16_t *pcm, uint32_t n, uint8_t *out)
+{
+    for (uint32_t i = 0; i + 1 < n; i += 2) {
+        uint8_t hi = ima_code(st, pcm[i]);
+        *out++ = (hi << 4) | ima_code(st, pcm[i + 1]);
+    }
+}
+
+void ima_decode(ima_state_t *st, const uint8_t *in, uint32_t n, int16_t *pcm)
+{
+    for (uint32_t i = 0; i + 1 < n; i += 2, in++) {
+        ima_update(st, *in >> 4);
+        pcm[i] = st->predicted;
+        ima_update(st, *in & 0x0f);
+        pcm[i + 1] = st->predicted;
+    }
+}
+
+void rtp_audio_tx_init(rtp_audio_tx_t *tx, uint32_t ssrc, uint8_t pt, uint32_t ts)
+{
+    memset(tx, 0, sizeof(*tx));
+    tx->ssrc = ssrc;
+    tx->seq = ssrc >> 16;
+    tx->ts = ts;
+    tx->pt = pt;
+    tx->first = 1;
+}
+
+int rtp_audio_send(rtp_audio_tx_t *tx, const int16_t *pcm, uint32_t n, uint32_t ts, rtp_audio_send_cb_t send_cb,
+                   void *arg)
+{
+    uint8_t *p = tx->pkt;
+
+    if (0 == n || n > RTP_AUDIO_MAX_SAMPLES || (RTP_AUDIO_PT_DVI4 == tx->pt && (n & 1))) {
+        return -1;
+    }
+    *p++ = 0x80;
+    *p++ = (tx->first ? 0x80 : 0) | tx->pt;
+    p = put_be16(p, tx->seq);
+    p = put_be32(p, ts);
+    p = put_be32(p, tx->ssrc);
+
+    if (RTP_AUDIO_PT_DVI4 == tx->pt) {
+        p = put_be16(p, tx->ima.predicted);
+        *p++ = tx->ima.index;
+        *p++ = 0;
+        ima_encode(&tx->ima, pcm, n, p);
+        p += n / 2;
+    } else {
+        for (uint32_t i = 0; i < n; i++) {
+            p = put_be16(p, pcm[i]);
+        }
+    }
+
+    tx->seq++;
+    tx->ts = ts + n;
+    tx->first = 0;
+    tx->packets++;
+    tx->bytes += p - tx->pkt;
+    return send_cb(arg, tx->pkt, p - tx->pkt);
+}
+
+int rtp_audio_parse(const uint8_t *pkt, uint32_t len, rtp_audio_hdr_t *hdr, int16_t *pcm)
+{
+    if (len < RTP_AUDIO_HDR_SIZE || 2 != (pkt[0] >> 6)) {
+        return -1;
+    }
+    uint32_t off = RTP_AUDIO_HDR_SIZE + 4 * (pkt[0] & 0x0f);
+    if (pkt[0] & 0x10) { /* header extension */
+        if (len < off + 4) {
+            return -1;
+        }
+        off += 4 + 4 * get_be16(pkt + off + 2);
+    }
+    if (pkt[0] & 0x20) { /* padding */
+        if (pkt[len - 1] > len) {
+            return -1;
+        }
+        len -= pkt[len - 1];
+    }
+    if (len < off) {
+        return -1;
+    }
+
+    hdr->marker = pkt[1] >> 7;
+    hdr->pt = pkt[1] & 0x7f;
+    hdr->seq = get_be16(pkt + 2);
+    hdr->ts = get_be32(pkt + 4);
+    hdr->ssrc = get_be32(pkt + 8);
+    pkt += off;
+    len -= off;
+
+    if (RTP_AUDIO_PT_L16 == hdr->pt) {
+        if (0 == len || (len & 1) || len / 2 > RTP_AUDIO_MAX_SAMPLES) {
+            return -1;
+        }
+        hdr->samples = len / 2;
+        for (uint32_t i = 0; i < hdr->samples; i++) {
+            pcm[i] = get_be16(pkt + 2 * i);
+        }
+        return 0;
+    }
+    if (RTP_AUDIO_PT_DVI4 == hdr->pt) {
+        if (len <= RTP_AUDIO_DVI4_HDR_SIZE || (len - RTP_AUDIO_DVI4_HDR_SIZE) * 2 > RTP_AUDIO_MAX_SAMPLES ||
+            pkt[2] > 88) {
+            return -1;
+        }
+        ima_state_t st = {.predicted = get_be16(pkt), .index = pkt[2]};
+        hdr->samples = (len - RTP_AUDIO_DVI4_HDR_SIZE) * 2;
+        ima_decode(&st, pkt + RTP_AUDIO_DVI4_HDR_SIZE, hdr->samples, pcm);
+        return 0;
+    }
+    return -1;
+}
+
+void rtp_audio_jb_init(rtp_audio_jb_t *jb, uint32_t rate, uint32_t min_ms, uint32_t max_ms)
+{
+    memset(jb, 0, sizeof(*jb));
+    jb->rate = rate;
+    jb->min_ms = min_ms;
+    jb->max_ms = max_ms > min_ms ? max_ms : min_ms;
+    jb->target_ms = min_ms;
+}
+
+static inline uint32_t jb_slot(const rtp_audio_jb_t *jb, uint32_t ts)
+{
+    return (uint32_t)((int32_t)(ts - jb->base_ts) / (int32_t)jb->frame) & (RTP_AUDIO_JB_SLOTS - 1);
+}
+
+uint32_t rtp_audio_jb_buffered_ms(const rtp_audio_jb_t *jb)
+{
+    int32_t ahead = jb->newest_ts + jb->frame - jb->play_ts;
+
+    return jb->have_stream && ahead > 0 ? (uint64_t)ahead * 1000 / jb->rate : 0;
+}
+
+uint32_t rtp_audio_jb_lost(const rtp_audio_jb_t *jb)
+{
+    uint32_t expected = jb->seq_cycles + jb->max_seq - jb->first_seq + 1;
+
+    return jb->have_stream && expected > jb->received ? expected - jb->received : 0;
+}
+
+void rtp_audio_jb_push(rtp_audio_jb_t *jb, const uint8_t *pkt, uint32_t len, uint32_t now_ms)
+{
+    int16_t pcm[RTP_AUDIO_MAX_SAMPLES];
+    rtp_audio_hdr_t hdr;
+    uint32_t arrival = (uint64_t)now_ms * jb->rate / 1000;
+
+    if (0 != rtp_audio_parse(pkt, len, &hdr, pcm)) {
+        jb->malformed++;
+        return;
+    }
+    if (!jb->have_stream) {
+        jb->have_stream = 1;
+        jb->ssrc = hdr.ssrc;
+        jb->base_ts = jb->play_ts = jb->newest_ts = hdr.ts;
+        jb->frame = hdr.samples;
+        jb->frame_ms = hdr.samples * 1000 / jb->rate;
+        jb->first_seq = jb->max_seq = hdr.seq;
+        jb->last_transit = arrival - hdr.ts;
+    } else if (hdr.ssrc != jb->ssrc || hdr.samples != jb->frame ||
+               0 != (int32_t)(hdr.ts - jb->base_ts) % (int32_t)jb->frame) {
+        jb->foreign++;
+        return;
+    }
+
+    /* sequence (A.1, without the restart heuristics), duplicates by sequence number */
+    int16_t ahead = hdr.seq - jb->max_seq;
+    if (ahead > 0) {
+        if (hdr.seq < jb->max_seq) {
+            jb->seq_cycles += 65536;
+        }
+        jb->max_seq = hdr.seq;
+        jb->seen = ahead < 64 ? jb->seen << ahead | 1 : 1;
+    } else if (0 == jb->received) {
+        jb->seen = 1;
+    } else if (-ahead < 64) {
+        if (jb->seen & (uint64_t)1 << -ahead) {
+            jb->duplicate++;
+            return;
+        }
+        jb->seen |= (uint64_t)1 << -ahead;
+    }
+    if ((int16_t)(hdr.seq - jb->first_seq) < 0) {
+        jb->first_seq = hdr.seq; /* the first packet to arrive wasn't the first sent */
+    }
+    jb->received++;
+
+    /* jitter (A.8) and the playout delay it calls for */
+    int32_t transit = arrival - hdr.ts, d = transit - jb->last_transit;
+    jb->last_transit = transit;
+    jb->jitter += ((d < 0 ? -d : d) - jb->jitter) / 16.0f;
+    jb->target_ms = jb->min_ms + (uint32_t)(4.0f * 1000.0f * jb->jitter / jb->rate);
+    if (jb->target_ms > jb->max_ms) {
+        jb->target_ms = jb->max_ms;
+    }
+
+    int32_t offset = hdr.ts - jb->play_ts, window = RTP_AUDIO_JB_SLOTS * jb->frame;
+    if (offset < 0) {
+        /* before playout starts, an earlier packet moves the start back if the buffer still spans it */
+        if (jb->playing || (int32_t)(jb->newest_ts - hdr.ts) >= window) {
+            jb->late++;
+            return;
+        }
+        jb->play_ts = hdr.ts;
+    } else if (offset >= window) {
+        jb->too_early++;
+        return;
+    }
+
+    uint32_t slot = jb_slot(jb, hdr.ts);
+    if (jb->slot_full[slot] && jb->slot_ts[slot] == hdr.ts) {
+        jb->duplicate++; /* same frame under another sequence number */
+        return;
+    }
+    memcpy(jb->pcm[slot], pcm, jb->frame * sizeof(int16_t));
+    jb->slot_ts[slot] = hdr.ts;
+    jb->slot_full[slot] = 1;
+    if ((int32_t)(hdr.ts - jb->newest_ts) < 0) {
+        jb->reordered++;
+    } else {
+        jb->newest_ts = hdr.ts;
+    }
+}
+
+uint32_t rtp_audio_jb_pull(rtp_audio_jb_t *jb, int16_t *out)
+{
+    uint32_t n = jb->frame, slot;
+
+    if (!jb->have_stream) {
+        return 0;
+    }
+    if (!jb->playing) {
+        if (rtp_audio_jb_buffered_ms(jb) < jb->target_ms) {
+            memset(out, 0, n * sizeof(int16_t));
+            return n;
+        }
+        jb->playing = 1;
+    }
+
+    /* more delay than the jitter needs: skip the oldest frame */
+    if (rtp_audio_jb_buffered_ms(jb) >= jb->target_ms + 3 * jb->frame_ms) {
+        slot = jb_slot(jb, jb->play_ts);
+        jb->slot_full[slot] = 0;
+        jb->play_ts += n;
+        jb->dropped++;
+    }
+
+    slot = jb_slot(jb, jb->play_ts);
+    if (jb->slot_full[slot] && jb->slot_ts[slot] == jb->play_ts) {
+        memcpy(out, jb->pcm[slot], n * sizeof(int16_t));
+        memcpy(jb->last, out, n * sizeof(int16_t));
+        jb->slot_full[slot] = 0;
+        jb->play_ts += n;
+        jb->conceal_run = 0;
+        jb->played++;
+        return n;
+    }
+
+    /* missing: the last frame again, fading linearly to silence over RTP_AUDIO_FADE_FRAMES */
+    float g0 = 1.0f - (float)jb->conceal_run / RTP_AUDIO_FADE_FRAMES;
+    float step = 1.0f / ((float)RTP_AUDIO_FADE_FRAMES * n);
+    for (uint32_t i = 0; i < n; i++) {
+        float g = g0 - step * i;
+        out[i] = g > 0.0f ? (int16_t)lrintf(jb->last[i] * g) : 0;
+    }
+    jb->conceal_run++;
+    jb->concealed++;
+    if (rtp_audio_jb_buffered_ms(jb) < jb->target_ms) {
+        /* less buffered than the jitter calls for: the frame is more likely late than lost, wait for it */
+        jb->stretched++;
+    } else {
+        jb->play_ts += n;
+    }
+    return n;
+}
+
+int rtp_audio_sdp(char *buf, uint32_t size, const char *ip, uint16_t port, uint8_t pt, uint32_t rate)
+{
+    return snprintf(buf, size,
+                    "v=0\r\n"
+                    "o=- 0 0 IN IP4 %s\r\n"
+                    "s=M1s microphone\r\n"
+                    "c=IN IP4 %s\r\n"
+                    "t=0 0\r\n"
+                    "m=audio %u RTP/AVP %d\r\n"
+                    "a=rtpmap:%d %s/%lu%s\r\n",
+                    ip, ip, port, pt, pt, RTP_AUDIO_PT_DVI4 == pt ? "DVI4" : "L16", (unsigned long)rate,
+                    RTP_AUDIO_PT_DVI4 == pt ? "" : "/1");
+}
@@ -0,0 +1,151 @@
+#ifndef __RTP_AUDIO_H__
+#define __RTP_AUDIO_H__
+
+#include <stdint.h>
+
+/*
+ * Mono audio over RTP (RFC 3550 / 3551), one packet per fixed size frame
+ * of samples, timestamps at the sample rate:
+ *
+ *   RTP_AUDIO_PT_L16   16 bit linear PCM, network byte order
+ *   RTP_AUDIO_PT_DVI4  IMA ADPCM, 4 bits per sample: predicted value
+ *                      (16 bit) and step index (8 bit) of the encoder
+ *                      before the first sample, a reserved byte, then two
+ *                      samples per byte, the first in the high nibble.
+ *                      Every packet decodes on its own.
+ *
+ * Both payload types are dynamic, the rate travels in the SDP
+ * (rtp_audio_sdp()); ffplay, VLC and GStreamer play either.
+ *
+ * The receive side is a jitter buffer for a playout clock: packets go in
+ * whenever they arrive (rtp_audio_jb_push()), a frame comes out every frame
+ * period (rtp_audio_jb_pull()). The playout delay follows the measured
+ * interarrival jitter (RFC 3550 A.8): the buffer stretches by concealing a
+ * missing frame without advancing while it holds less than that, and drops
+ * a frame when it holds more than it needs. Lost frames are concealed by repeating the last one,
+ * fading out; packets that come after their frame was played out are
+ * counted as late and discarded.
+ */
+
+#define RTP_AUDIO_PT_L16 (96)
+#define RTP_AUDIO_PT_DVI4 (97)
+#define RTP_AUDIO_MAX_SAMPLES (640) /* per packet: 40 ms at 16 kHz, L16 fits RTP_JPEG_DEFAULT_MTU */
+#define RTP_AUDIO_HDR_SIZE (12)
+#define RTP_AUDIO_DVI4_HDR_SIZE (4)
+#define RTP_AUDIO_MAX_PKT (RTP_AUDIO_HDR_SIZE + 2 * RTP_AUDIO_MAX_SAMPLES)
+
+typedef struct {
+    int16_t predicted;
+    uint8_t index;
+} ima_state_t;
+
+/* n samples to n / 2 bytes (n even), first sample in the high nibble */
+void ima_encode(ima_state_t *st, const int16_t *pcm, uint32_t n, uint8_t *out);
+void ima_decode(ima_state_t *st, const uint8_t *in, uint32_t n, int16_t *pcm);
+
+typedef struct {
+    uint32_t ssrc;
+    uint16_t seq;
+    uint32_t ts;
+    uint8_t pt;
+    uint8_t first; /* marker on the first packet */
+    ima_state_t ima;
+    uint8_t pkt[RTP_AUDIO_MAX_PKT];
+
+    uint32_t packets;
+    uint64_t bytes;
+} rtp_audio_tx_t;
+
+/* returns 0 to go on, anything else is passed back by rtp_audio_send() */
+typedef int (*rtp_audio_send_cb_t)(void *arg, const uint8_t *pkt, uint32_t len);
+
+void rtp_audio_tx_init(rtp_audio_tx_t *tx, uint32_t ssrc, uint8_t pt, uint32_t ts);
+
+/*
+ * One packet of n samples (1..RTP_AUDIO_MAX_SAMPLES, even for DVI4) at
+ * timestamp ts; the next one defaults to ts + n in tx->ts. Returns the
+ * callback's result, or -1 for a bad n.
+ */
+int rtp_audio_send(rtp_audio_tx_t *tx, const int16_t *pcm, uint32_t n, uint32_t ts, rtp_audio_send_cb_t send_cb,
+                   void *arg);
+
+typedef struct {
+    uint8_t pt;
+    uint8_t marker;
+    uint16_t seq;
+    uint32_t ts;
+    uint32_t ssrc;
+    uint32_t samples;
+} rtp_audio_hdr_t;
+
+/* Checks and decodes one packet into pcm (RTP_AUDIO_MAX_SAMPLES). Returns 0, or -1 if malformed. */
+int rtp_audio_parse(const uint8_t *pkt, uint32_t len, rtp_audio_hdr_t *hdr, int16_t *pcm);
+
+#define RTP_AUDIO_JB_SLOTS (32) /* frames, power of 2 */
+#define RTP_AUDIO_FADE_FRAMES (4) /* concealment fades to silence over this many */
+
+typedef struct {
+    uint32_t rate;
+    uint32_t min_ms, max_ms; /* playout delay bounds */
+
+    /* from the first packet: the stream every later packet has to match */
+    uint32_t ssrc;
+    uint32_t base_ts; /* frames sit at whole frames from it */
+    uint32_t frame;   /* samples per packet */
+    uint32_t frame_ms;
+
+    int16_t pcm[RTP_AUDIO_JB_SLOTS][RTP_AUDIO_MAX_SAMPLES];
+    uint32_t slot_ts[RTP_AUDIO_JB_SLOTS];
+    uint8_t slot_full[RTP_AUDIO_JB_SLOTS];
+
+    uint8_t have_stream;
+    uint8_t playing;
+    uint32_t play_ts;   /* timestamp of the next frame out */
+    uint32_t newest_ts; /* latest frame received */
+    uint16_t first_seq, max_seq;
+    uint32_t seq_cycles;
+    uint64_t seen; /* bit i: max_seq - i arrived */
+
+    /* RFC 3550 A.8, in timestamp units */
+    int32_t last_transit;
+    float jitter;
+    uint32_t target_ms;
+
+    int16_t last[RTP_AUDIO_MAX_SAMPLES]; /* what was played last, for concealment */
+    uint32_t conceal_run;
+
+    uint32_t received;  /* distinct sequence numbers */
+    uint32_t duplicate;
+    uint32_t reordered; /* older than one already received, still in time */
+    uint32_t late;      /* arrived after their frame was played out */
+    uint32_t too_early; /* beyond the buffer */
+    uint32_t foreign;   /* other SSRC, frame size or frame grid */
+    uint32_t malformed;
+    uint32_t played;
+    uint32_t concealed; /* frames made up for packets not there in time */
+    uint32_t stretched; /* of those, played without advancing (buffer short) */
+    uint32_t dropped;   /* skipped to cut the delay */
+} rtp_audio_jb_t;
+
+void rtp_audio_jb_init(rtp_audio_jb_t *jb, uint32_t rate, uint32_t min_ms, uint32_t max_ms);
+
+/* one packet as it arrives at now_ms (the receiver's clock) */
+void rtp_audio_jb_push(rtp_audio_jb_t *jb, const uint8_t *pkt, uint32_t len, uint32_t now_ms);
+
+/*
+ * The next frame of playout, jb->frame samples (0 until the first packet).
+ * Returns the samples written: silence while filling up to the playout
+ * delay, concealment when the frame is missing.
+ */
+uint32_t rtp_audio_jb_pull(rtp_audio_jb_t *jb, int16_t *out);
+
+/* how far the buffered frames reach past the playout point */
+uint32_t rtp_audio_jb_buffered_ms(const rtp_audio_jb_t *jb);
+
+/* packets the sender numbered but never arrived (RFC 3550 A.3), late ones count as received */
+uint32_t rtp_audio_jb_lost(const rtp_audio_jb_t *jb);
+
+/* SDP for a player listening on ip:port */
+int rtp_audio_sdp(char *buf, uint32_t size, const char *ip, uint16_t port, uint8_t pt, uint32_t rate);
+
+#endif /* __RTP_AUDIO_H__ */
@@ -0,0 +1,446 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "rtp_jpeg.h"
+
+/* standard Huffman tables (ITU T.81 K.3), assumed by RFC 2435 */
+static const uint8_t lum_dc_codelens[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t lum_dc_symbols[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t lum_ac_codelens[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t lum_ac_symbols[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71,
+    0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37,
+    0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83,
+    0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+    0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+static const uint8_t chm_dc_codelens[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t chm_dc_symbols[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t chm_ac_codelens[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t chm_ac_symbols[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22,
+    0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+    0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36,
+    0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+    0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+    0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba,
+    0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+typedef struct {
+    uint8_t tc_th; /* class << 4 | id */
+    const uint8_t *codelens;
+    const uint8_t *symbols;
+    uint8_t nsymbols;
+} std_huff_t;
+
+static const std_huff_t std_huff[4] = {
+    {0x00, lum_dc_codelens, lum_dc_symbols, sizeof(lum_dc_symbols)},
+    {0x10, lum_ac_codelens, lum_ac_symbols, sizeof(lum_ac_symbols)},
+    {0x01, chm_dc_codelens, chm_dc_symbols, sizeof(chm_dc_symbols)},
+    {0x11, chm_ac_codelens, chm_ac_symbols, sizeof(chm_ac_symbols)},
+};
+
+static inline uint16_t get_be16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint8_t *put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+    return p + 2;
+}
+
+static inline uint8_t *put_be32(uint8_t *p, uint32_t v)
+{
+    p = put_be16(p, v >> 16);
+    return put_be16(p, v);
+}
+
+/* DHT segment contents must match the standard table for the same class/id */
+static int check_dht(const uint8_t *seg, int n)
+{
+    while (n > 17) {
+        const std_huff_t *std = NULL;
+        for (int i = 0; i < 4; i++) {
+            if (std_huff[i].tc_th == seg[0]) {
+                std = &std_huff[i];
+            }
+        }
+        int count = 0;
+        for (int i = 0; i < 16; i++) {
+            count += seg[1 + i];
+        }
+        if (NULL == std || 17 + count > n || count != std->nsymbols || 0 != memcmp(seg + 1, std->codelens, 16) ||
+            0 != memcmp(seg + 17, std->symbols, count)) {
+            return -1;
+        }
+        seg += 17 + count;
+        n -= 17 + count;
+    }
+    return 0 == n ? 0 : -1;
+}
+
+int rtp_jpeg_parse(const uint8_t *jpeg, uint32_t len, rtp_jpeg_info_t *info)
+{
+    int have_sof = 0, have_qt = 0;
+    uint32_t p = 2;
+
+    memset(info, 0, sizeof(*info));
+    if (len < 4 || 0xff != jpeg[0] || 0xd8 != jpeg[1]) {
+        return -1;
+    }
+
+    while (p + 4 <= len) {
+        if (0xff != jpeg[p]) {
+            return -1;
+        }
+        uint8_t marker = jpeg[p + 1];
+        if (0xff == marker) {
+            p++; /* fill byte */
+            continue;
+        }
+        uint16_t seg_len = get_be16(jpeg + p + 2);
+        const uint8_t *seg = jpeg + p + 4;
+        int n = seg_len - 2;
+        if (seg_len < 2 || p + 2 + seg_len > len) {
+            return -1;
+        }
+
+        if (0xdb == marker) { /* DQT */
+            while (n >= 65) {
+                uint8_t pq = seg[0] >> 4, tq = seg[0] & 0xf;
+                if (0 != pq || tq > 1) {
+                    return -1;
+                }
+                memcpy(info->qt[tq], seg + 1, 64);
+                have_qt |= 1 << tq;
+                seg += 65;
+                n -= 65;
+            }
+        } else if (0xc0 == marker) { /* SOF0, baseline */
+            if (n < 15 || 8 != seg[0] || 3 != seg[5]) {
+                return -1;
+            }
+            info->height = get_be16(seg + 1);
+            info->width = get_be16(seg + 3);
+            if (0x21 == seg[7]) {
+                info->type = 0;
+            } else if (0x22 == seg[7]) {
+                info->type = 1;
+            } else {
+                return -1;
+            }
+            if (0 != seg[8] || 0x11 != seg[10] || 1 != seg[11] || 0x11 != seg[13] || 1 != seg[14]) {
+                return -1;
+            }
+            have_sof = 1;
+        } else if (marker > 0xc0 && marker <= 0xcf && 0xc4 != marker && 0xc8 != marker && 0xcc != marker) {
+            return -1; /* progressive, lossless, arithmetic */
+        } else if (0xc4 == marker) {
+            if (0 != check_dht(seg, n)) {
+                return -1;
+            }
+        } else if (0xdd == marker) { /* DRI */
+            info->dri = get_be16(seg);
+        } else if (0xda == marker) { /* SOS, the scan runs to EOI */
+            p += 2 + seg_len;
+            if (!have_sof || 3 != have_qt) {
+                return -1;
+            }
+            info->scan = jpeg + p;
+            info->scan_len = len - p;
+            if (info->scan_len >= 2 && 0xff == jpeg[len - 2] && 0xd9 == jpeg[len - 1]) {
+                info->scan_len -= 2;
+            }
+            break;
+        }
+        p += 2 + seg_len;
+    }
+
+    if (NULL == info->scan || 0 == info->width || 0 == info->height || info->width > 2040 || info->height > 2040 ||
+        (info->width & 7) || (info->height & 7)) {
+        return -1;
+    }
+    if (info->dri) {
+        info->type |= 64;
+    }
+    return 0;
+}
+
+int rtp_jpeg_tx_init(rtp_jpeg_tx_t *tx, uint32_t ssrc, uint16_t mtu)
+{
+    memset(tx, 0, sizeof(*tx));
+    if (mtu && mtu < RTP_JPEG_MIN_MTU) {
+        return -1;
+    }
+    tx->ssrc = ssrc;
+    tx->seq = ssrc >> 16;
+    tx->mtu = (mtu && mtu <= sizeof(tx->pkt)) ? mtu : sizeof(tx->pkt);
+    return 0;
+}
+
+int rtp_jpeg_send_frame(rtp_jpeg_tx_t *tx, const rtp_jpeg_info_t *info, uint32_t ts, rtp_jpeg_send_cb_t send_cb,
+                        void *arg)
+{
+    uint32_t off = 0;
+    int packets = 0;
+
+    do {
+        uint8_t *p = tx->pkt;
+
+        /* RTP: V=2, PT=26, marker on the last fragment, patched below */
+        *p++ = 0x80;
+        *p++ = RTP_JPEG_PT;
+        p = put_be16(p, tx->seq);
+        p = put_be32(p, ts);
+        p = put_be32(p, tx->ssrc);
+        uint8_t *mark = tx->pkt + 1;
+
+        /* JPEG header, Q=255: tables are in the first packet of every frame */
+        p = put_be32(p, off & 0xffffff); /* type-specific 0, fragment offset */
+        *p++ = info->type;
+        *p++ = 255;
+        *p++ = info->width >> 3;
+        *p++ = info->height >> 3;
+
+        if (info->type & 64) {
+            p = put_be16(p, info->dri);
+            p = put_be16(p, 0xffff); /* F=1, L=1, count 0x3fff: not aligned to intervals */
+        }
+        if (0 == off) {
+            *p++ = 0; /* MBZ */
+            *p++ = 0; /* 8 bit tables */
+            p = put_be16(p, 128);
+            memcpy(p, info->qt[0], 64);
+            memcpy(p + 64, info->qt[1], 64);
+            p += 128;
+        }
+
+        if (p - tx->pkt >= tx->mtu) {
+            return -1; /* no room left for scan data, an mtu rtp_jpeg_tx_init() refused */
+        }
+        uint32_t room = tx->mtu - (p - tx->pkt);
+        uint32_t n = info->scan_len - off < room ? info->scan_len - off : room;
+        memcpy(p, info->scan + off, n);
+        p += n;
+        off += n;
+        if (off == info->scan_len) {
+            *mark |= 0x80;
+        }
+
+        if (0 != send_cb(arg, tx->pkt, p - tx->pkt)) {
+            return -1;
+        }
+        tx->seq++;
+        tx->packets++;
+        tx->bytes += p - tx->pkt;
+        packets++;
+    } while (off < info->scan_len);
+
+    tx->frames++;
+    return packets;
+}
+
+static uint8_t *put_huff(uint8_t *p, const std_huff_t *h)
+{
+    *p++ = 0xff;
+    *p++ = 0xc4;
+    p = put_be16(p, 3 + 16 + h->nsymbols);
+    *p++ = h->tc_th;
+    memcpy(p, h->codelens, 16);
+    memcpy(p + 16, h->symbols, h->nsymbols);
+    return p + 16 + h->nsymbols;
+}
+
+uint32_t rtp_jpeg_make_headers(uint8_t *out, uint32_t size, uint8_t type, uint16_t width, uint16_t height,
+                               const uint8_t qt[2][64], uint16_t dri)
+{
+    /* SOI + 2 DQT + DRI + SOF0 + 4 DHT + SOS */
+    if (size < 2 + 2 * 69 + 6 + 19 + 2 * (21 + 12) + 2 * (21 + 162) + 14) {
+        return 0;
+    }
+    uint8_t *p = out;
+
+    *p++ = 0xff;
+    *p++ = 0xd8;
+    for (int i = 0; i < 2; i++) {
+        *p++ = 0xff;
+        *p++ = 0xdb;
+        p = put_be16(p, 67);
+        *p++ = i;
+        memcpy(p, qt[i], 64);
+        p += 64;
+    }
+    if (dri) {
+        *p++ = 0xff;
+        *p++ = 0xdd;
+        p = put_be16(p, 4);
+        p = put_be16(p, dri);
+    }
+
+    *p++ = 0xff;
+    *p++ = 0xc0;
+    p = put_be16(p, 17);
+    *p++ = 8;
+    p = put_be16(p, height);
+    p = put_be16(p, width);
+    *p++ = 3;
+    *p++ = 1; /* Y */
+    *p++ = (type & 63) ? 0x22 : 0x21;
+    *p++ = 0;
+    *p++ = 2; /* Cb */
+    *p++ = 0x11;
+    *p++ = 1;
+    *p++ = 3; /* Cr */
+    *p++ = 0x11;
+    *p++ = 1;
+
+    for (int i = 0; i < 4; i++) {
+        p = put_huff(p, &std_huff[i]);
+    }
+
+    *p++ = 0xff;
+    *p++ = 0xda;
+    p = put_be16(p, 12);
+    *p++ = 3;
+    *p++ = 1;
+    *p++ = 0x00;
+    *p++ = 2;
+    *p++ = 0x11;
+    *p++ = 3;
+    *p++ = 0x11;
+    *p++ = 0;  /* Ss */
+    *p++ = 63; /* Se */
+    *p++ = 0;  /* Ah/Al */
+    return p - out;
+}
+
+void rtp_jpeg_rx_init(rtp_jpeg_rx_t *rx, uint8_t *buf, uint32_t size)
+{
+    memset(rx, 0, sizeof(*rx));
+    rx->buf = buf;
+    rx->size = size;
+}
+
+int rtp_jpeg_rx_push(rtp_jpeg_rx_t *rx, const uint8_t *pkt, uint32_t len)
+{
+    if (len < RTP_HDR_SIZE + RTP_JPEG_HDR_SIZE || 2 != (pkt[0] >> 6) || RTP_JPEG_PT != (pkt[1] & 0x7f)) {
+        return -1;
+    }
+    uint32_t hdr = RTP_HDR_SIZE + 4 * (pkt[0] & 0x0f);
+    if (pkt[0] & 0x10) { /* header extension */
+        if (len < hdr + 4) {
+            return -1;
+        }
+        hdr += 4 + 4 * get_be16(pkt + hdr + 2);
+    }
+    if (pkt[0] & 0x20) { /* padding */
+        if (0 == len || pkt[len - 1] > len) {
+            return -1;
+        }
+        len -= pkt[len - 1];
+    }
+    if (len < hdr + RTP_JPEG_HDR_SIZE) {
+        return -1;
+    }
+
+    int marker = pkt[1] >> 7;
+    uint16_t seq = get_be16(pkt + 2);
+    uint32_t ts = (get_be16(pkt + 4) << 16) | get_be16(pkt + 6);
+
+    if (rx->active || rx->complete || rx->incomplete) {
+        int16_t gap = seq - rx->next_seq;
+        if (gap > 0) {
+            rx->lost_packets += gap;
+            rx->broken = 1;
+        }
+    }
+    rx->next_seq = seq + 1;
+
+    /* a new timestamp before the marker: the old frame lost its tail */
+    if (rx->active && ts != rx->ts) {
+        rx->incomplete++;
+        rx->active = 0;
+    }
+
+    const uint8_t *p = pkt + hdr;
+    uint32_t off = (p[1] << 16) | (p[2] << 8) | p[3];
+    uint8_t type = p[4], q = p[5];
+    uint16_t width = p[6] << 3, height = p[7] << 3;
+    uint16_t dri = 0;
+    p += RTP_JPEG_HDR_SIZE;
+
+    if (type & 64) {
+        if (p + RTP_JPEG_RST_HDR_SIZE > pkt + len) {
+            return -1;
+        }
+        dri = get_be16(p);
+        p += RTP_JPEG_RST_HDR_SIZE;
+    }
+
+    if (!rx->active) {
+        rx->active = 1;
+        rx->ts = ts;
+        rx->len = rx->hdr_len = 0;
+        rx->broken = 0 != off;
+    }
+
+    if (0 == off) {
+        /* only dynamic tables, Q >= 128, as sent by rtp_jpeg_send_frame() */
+        if (q < 128 || p + 4 > pkt + len || 0 != p[1] || 128 != get_be16(p + 2) ||
+            p + RTP_JPEG_QT_HDR_SIZE > pkt + len) {
+            rx->broken = 1;
+        } else {
+            rx->hdr_len = rtp_jpeg_make_headers(rx->buf, rx->size, type, width, height,
+                                                (const uint8_t(*)[64])(p + 4), dri);
+            rx->len = rx->hdr_len;
+            rx->broken = 0 == rx->hdr_len;
+            p += RTP_JPEG_QT_HDR_SIZE;
+        }
+    }
+
+    uint32_t n = pkt + len - p;
+    if (!rx->broken) {
+        if (off != rx->len - rx->hdr_len || rx->len + n + 2 > rx->size) {
+            rx->broken = 1;
+        } else {
+            memcpy(rx->buf + rx->len, p, n);
+            rx->len += n;
+        }
+    }
+
+    if (!marker) {
+        return 0;
+    }
+    rx->active = 0;
+    if (rx->broken) {
+        rx->incomplete++;
+        return 0;
+    }
+    rx->buf[rx->len++] = 0xff;
+    rx->buf[rx->len++] = 0xd9;
+    rx->complete++;
+    return rx->len;
+}
+
+int rtp_jpeg_sdp(char *buf, uint32_t size, const char *ip, uint16_t port)
+{
+    return snprintf(buf, size,
+                    "v=0\r\n"
+                    "o=- 0 0 IN IP4 %s\r\n"
+                    "s=M1s camera\r\n"
+                    "c=IN IP4 %s\r\n"
+                    "t=0 0\r\n"
+                    "m=video %u RTP/AVP %d\r\n"
+                    "a=rtpmap:%d JPEG/%d\r\n",
+                    ip, ip, port, RTP_JPEG_PT, RTP_JPEG_PT, RTP_JPEG_CLOCK);
+}
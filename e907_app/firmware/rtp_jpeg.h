@@ -0,0 +1,103 @@
+#ifndef __RTP_JPEG_H__
+#define __RTP_JPEG_H__
+
+#include <stdint.h>
+
+/*
+ * RTP payload format for JPEG (RFC 2435), payload type 26, 90 kHz clock.
+ *
+ * Only the entropy coded scan travels on the wire. Each packet carries
+ *
+ *   RTP header (12) | JPEG header (8) | [restart header (4)] |
+ *   [quantization table header (4 + 128), first packet only] | scan data
+ *
+ * and the receiver rebuilds SOI/DQT/SOF0/DHT/SOS from the type, size and
+ * tables, so the frame must be baseline, 8 bit, YUV 4:2:2 or 4:2:0 with the
+ * standard Huffman tables, as produced by the camera's MJPEG encoder.
+ * The last packet of a frame has the marker bit set.
+ */
+
+#define RTP_JPEG_PT (26)
+#define RTP_JPEG_CLOCK (90000)
+#define RTP_HDR_SIZE (12)
+#define RTP_JPEG_HDR_SIZE (8)
+#define RTP_JPEG_RST_HDR_SIZE (4)
+#define RTP_JPEG_QT_HDR_SIZE (4 + 2 * 64)
+/* fits one 802.11 frame with IP/UDP headers on a 1500 byte MTU */
+#define RTP_JPEG_DEFAULT_MTU (1400)
+/* a frame's first packet with every header it can carry, and one byte of scan */
+#define RTP_JPEG_MIN_MTU (RTP_HDR_SIZE + RTP_JPEG_HDR_SIZE + RTP_JPEG_RST_HDR_SIZE + RTP_JPEG_QT_HDR_SIZE + 1)
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t type; /* 0: 4:2:2, 1: 4:2:0, +64 when restart markers are used */
+    uint16_t dri;
+    uint8_t qt[2][64]; /* zigzag order, as in DQT */
+    const uint8_t *scan;
+    uint32_t scan_len;
+} rtp_jpeg_info_t;
+
+/* Split a JPEG into its RFC 2435 parameters. Returns -1 if it can't be sent. */
+int rtp_jpeg_parse(const uint8_t *jpeg, uint32_t len, rtp_jpeg_info_t *info);
+
+typedef struct {
+    uint32_t ssrc;
+    uint16_t seq;
+    uint16_t mtu; /* RTP packet size limit, headers included */
+    uint8_t pkt[RTP_JPEG_DEFAULT_MTU];
+
+    uint32_t frames;
+    uint32_t packets;
+    uint64_t bytes;
+} rtp_jpeg_tx_t;
+
+/* returns 0 to go on, anything else aborts the frame */
+typedef int (*rtp_jpeg_send_cb_t)(void *arg, const uint8_t *pkt, uint32_t len);
+
+/*
+ * mtu 0 is RTP_JPEG_DEFAULT_MTU, more is capped to it. Returns -1, leaving
+ * tx unusable, for an mtu below RTP_JPEG_MIN_MTU.
+ */
+int rtp_jpeg_tx_init(rtp_jpeg_tx_t *tx, uint32_t ssrc, uint16_t mtu);
+
+/* Packetize one frame with the 90 kHz timestamp ts. Returns packets sent or -1. */
+int rtp_jpeg_send_frame(rtp_jpeg_tx_t *tx, const rtp_jpeg_info_t *info, uint32_t ts, rtp_jpeg_send_cb_t send_cb,
+                        void *arg);
+
+/*
+ * Reassembly. A frame is complete when the marker packet arrives and every
+ * byte before it was received in order; a gap in sequence numbers or
+ * fragment offsets discards the frame being built.
+ */
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t len; /* rebuilt JPEG so far */
+    uint32_t hdr_len;
+    uint32_t ts;
+    uint16_t next_seq;
+    uint8_t active;
+    uint8_t broken;
+
+    uint32_t complete;
+    uint32_t incomplete; /* frames started but lost or cut short */
+    uint32_t lost_packets;
+} rtp_jpeg_rx_t;
+
+void rtp_jpeg_rx_init(rtp_jpeg_rx_t *rx, uint8_t *buf, uint32_t size);
+
+/*
+ * Feed one RTP packet. Returns the length of a finished JPEG in rx->buf,
+ * 0 while a frame is in progress, -1 for a malformed packet.
+ */
+int rtp_jpeg_rx_push(rtp_jpeg_rx_t *rx, const uint8_t *pkt, uint32_t len);
+
+/* SOI..SOS as a receiver rebuilds it. Returns the length, 0 if size is too small. */
+uint32_t rtp_jpeg_make_headers(uint8_t *out, uint32_t size, uint8_t type, uint16_t width, uint16_t height,
+                               const uint8_t qt[2][64], uint16_t dri);
+
+/* SDP for a player (ffplay/VLC/GStreamer) listening on ip:port */
+int rtp_jpeg_sdp(char *buf, uint32_t size, const char *ip, uint16_t port);
+
+#endif /* __RTP_JPEG_H__ */
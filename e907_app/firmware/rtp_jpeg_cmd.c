@@ -0,0 +1,156 @@
+#include <FreeRTOS.h>
+#include <aos/kernel.h>
+#include <cli.h>
+#include <lwip/sockets.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <task.h>
+
+#include "mjpeg_src.h"
+#include "rtp_jpeg.h"
+
+#define RTP_MAX_FRAME (96 * 1024)
+
+typedef struct {
+    char ip[16];
+    uint16_t port;
+    uint16_t mtu;
+    uint32_t fps;
+    char path[64];
+} rtp_file_arg_t;
+
+typedef struct {
+    int sock;
+    struct sockaddr_in addr;
+    uint32_t send_fail;
+} rtp_udp_t;
+
+static volatile int s_rtp_running;
+
+/* a packet lwIP can't take is lost like one dropped on air, keep going */
+static int rtp_udp_send(void *arg, const uint8_t *pkt, uint32_t len)
+{
+    rtp_udp_t *udp = arg;
+    if (sendto(udp->sock, pkt, len, 0, (struct sockaddr *)&udp->addr, sizeof(udp->addr)) < 0) {
+        udp->send_fail++;
+    }
+    return 0;
+}
+
+static void rtp_file_task(void *pvParameters)
+{
+    rtp_file_arg_t *arg = pvParameters;
+    uint8_t *frame = pvPortMalloc(RTP_MAX_FRAME);
+    rtp_jpeg_tx_t *tx = pvPortMalloc(sizeof(rtp_jpeg_tx_t));
+    mjpeg_src_t src = {.fd = -1};
+    rtp_udp_t udp = {.sock = -1};
+    char sdp[256];
+
+    if (NULL == frame || NULL == tx) {
+        printf("[rtp] no memory\r\n");
+        goto exit;
+    }
+    if (0 != mjpeg_src_open(&src, arg->path)) {
+        printf("[rtp] open %s failed\r\n", arg->path);
+        goto exit;
+    }
+    if ((udp.sock = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        printf("[rtp] socket failed\r\n");
+        goto exit;
+    }
+    udp.addr.sin_family = AF_INET;
+    udp.addr.sin_port = htons(arg->port);
+    udp.addr.sin_addr.s_addr = inet_addr(arg->ip);
+
+    if (0 != rtp_jpeg_tx_init(tx, aos_now_ms() * 2654435761u, arg->mtu)) {
+        printf("[rtp] mtu %u below %u\r\n", arg->mtu, RTP_JPEG_MIN_MTU);
+        goto exit;
+    }
+    rtp_jpeg_sdp(sdp, sizeof(sdp), arg->ip, arg->port);
+    printf("[rtp] %s -> %s:%u, mtu %u, sdp:\r\n%s", arg->path, arg->ip, arg->port, tx->mtu, sdp);
+
+    uint32_t period_ms = 1000 / (arg->fps ? arg->fps : 30);
+    uint32_t report_ms = aos_now_ms() + 1000;
+    uint32_t last_frames = 0, skipped = 0;
+    uint64_t last_bytes = 0;
+
+    while (s_rtp_running) {
+        uint32_t t0 = aos_now_ms();
+        int len = mjpeg_src_next(&src, frame, RTP_MAX_FRAME);
+        if (0 == len) {
+            printf("[rtp] no jpeg in %s\r\n", arg->path);
+            break;
+        }
+
+        rtp_jpeg_info_t info;
+        if (len < 0 || 0 != rtp_jpeg_parse(frame, len, &info)) {
+            skipped++;
+            continue;
+        }
+        uint32_t ts = (uint64_t)aos_now_ms() * (RTP_JPEG_CLOCK / 1000);
+        rtp_jpeg_send_frame(tx, &info, ts, rtp_udp_send, &udp);
+
+        uint32_t now = aos_now_ms();
+        if ((int32_t)(now - report_ms) >= 0) {
+            printf("[rtp] %lu fps, %lu KB/s, packets %lu, send fail %lu, skipped %lu\r\n",
+                   (unsigned long)(tx->frames - last_frames), (unsigned long)((tx->bytes - last_bytes) >> 10),
+                   (unsigned long)tx->packets, (unsigned long)udp.send_fail, (unsigned long)skipped);
+            last_frames = tx->frames;
+            last_bytes = tx->bytes;
+            report_ms = now + 1000;
+        }
+        if (now - t0 < period_ms) {
+            vTaskDelay(pdMS_TO_TICKS(period_ms - (now - t0)));
+        }
+    }
+    printf("[rtp] stopped, frames %lu, packets %lu\r\n", (unsigned long)tx->frames, (unsigned long)tx->packets);
+
+exit:
+    if (udp.sock >= 0) closesocket(udp.sock);
+    mjpeg_src_close(&src);
+    vPortFree(tx);
+    vPortFree(frame);
+    vPortFree(arg);
+    s_rtp_running = 0;
+    vTaskDelete(NULL);
+}
+
+void cmd_rtp_file(char *buf, int len, int argc, char **argv)
+{
+    if (2 == argc && 0 == strcmp(argv[1], "stop")) {
+        s_rtp_running = 0;
+        return;
+    }
+    if (argc < 4) {
+        printf("Usage: rtp_file <ip> <port> <file.mjpeg> [fps] [mtu]\r\n");
+        printf("       rtp_file stop\r\n");
+        return;
+    }
+    if (s_rtp_running) {
+        printf("rtp already running\r\n");
+        return;
+    }
+    int mtu = argc > 5 ? atoi(argv[5]) : RTP_JPEG_DEFAULT_MTU;
+    if (mtu < RTP_JPEG_MIN_MTU || mtu > 0xffff) {
+        printf("mtu must be %u or more\r\n", RTP_JPEG_MIN_MTU);
+        return;
+    }
+
+    rtp_file_arg_t *arg = pvPortMalloc(sizeof(*arg));
+    if (NULL == arg) {
+        return;
+    }
+    memset(arg, 0, sizeof(*arg));
+    strncpy(arg->ip, argv[1], sizeof(arg->ip) - 1);
+    arg->port = atoi(argv[2]);
+    strncpy(arg->path, argv[3], sizeof(arg->path) - 1);
+    arg->fps = argc > 4 ? atoi(argv[4]) : 30;
+    arg->mtu = mtu;
+
+    s_rtp_running = 1;
+    if (pdPASS != xTaskCreate(rtp_file_task, "rtp_file", 1024, arg, 10, NULL)) {
+        s_rtp_running = 0;
+        vPortFree(arg);
+    }
+}
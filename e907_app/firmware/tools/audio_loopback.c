@@ -0,0 +1,430 @@
+/*
+ * audio_loopback - RTP audio sender, a lossy network and the jitter buffer
+ * on localhost.
+ *
+ * A two tone test signal is packetized by rtp_audio_send() (L16 or DVI4)
+ * and every packet is held back before it goes out on a UDP socket on
+ * 127.0.0.1: a base delay plus a uniform random jitter (which also reorders
+ * packets), occasional delay spikes where nothing gets through for a while,
+ * random loss in bursts, and duplicates. A second socket feeds
+ * rtp_audio_jb_push(), and a playout clock, which may run fast or slow by
+ * a few hundred ppm against the sender, takes a frame out with
+ * rtp_audio_jb_pull() every frame period.
+ *
+ * Checks: every frame that is played and not concealed is exactly the frame
+ * sent at its timestamp (decoded, for DVI4), the receiver's loss count
+ * matches the packets the network dropped, concealment covers every frame
+ * that was lost or late, and no more than max-late percent of the packets
+ * come after their playout time. For DVI4 the SNR of the played frames
+ * against the source has to be at least MIN_SNR_DB.
+ *
+ * Time runs -x times faster than real time, sockets and all.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -o audio_loopback audio_loopback.c ../rtp_audio.c -lm
+ *   ./audio_loopback -t 30 -c adpcm -j 40 -l 2 -k 150
+ *   ./audio_loopback -c pcm -z 500 -o playout.wav
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rtp_audio.h"
+
+#define RATE (16000)
+#define MAX_PENDING (1024)
+#define SPIKE_EVERY_MS (5000)
+#define MIN_SNR_DB (20.0)
+
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static uint32_t seed = 1;
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static double uniform(void)
+{
+    return (xorshift(&seed) >> 8) / 16777216.0;
+}
+
+/* the loopback's clock: real time times the speed-up, in ms */
+static double speed = 10.0;
+static struct timespec t0;
+
+static double now_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((t.tv_sec - t0.tv_sec) * 1e3 + (t.tv_nsec - t0.tv_nsec) / 1e6) * speed;
+}
+
+typedef struct {
+    double due_ms;
+    uint32_t len;
+    uint8_t pkt[RTP_AUDIO_MAX_PKT];
+} pending_t;
+
+/* the network between rtp_audio_send() and the socket */
+typedef struct {
+    int sock;
+    struct sockaddr_in to;
+    double base_ms, jitter_ms, spike_ms, loss, burst, dup;
+    uint32_t burst_left;
+    pending_t q[MAX_PENDING];
+    uint32_t nq;
+
+    uint32_t sent, dropped, duplicated, overflow;
+    uint32_t trailing; /* dropped after the last one let through, nobody can know they were sent */
+
+    /* what was sent, decoded, by frame number, for checking the playout */
+    int16_t *frames;
+    uint32_t frame;
+    uint32_t first_ts;
+} net_t;
+
+static void enqueue(net_t *net, const uint8_t *pkt, uint32_t len, double due)
+{
+    if (net->nq == MAX_PENDING) {
+        net->overflow++;
+        return;
+    }
+    net->q[net->nq].due_ms = due;
+    net->q[net->nq].len = len;
+    memcpy(net->q[net->nq].pkt, pkt, len);
+    net->nq++;
+}
+
+static int net_send(void *arg, const uint8_t *pkt, uint32_t len)
+{
+    net_t *net = arg;
+    double now = now_ms(), due = now + net->base_ms + net->jitter_ms * uniform();
+    rtp_audio_hdr_t hdr;
+    int16_t pcm[RTP_AUDIO_MAX_SAMPLES];
+
+    if (0 == rtp_audio_parse(pkt, len, &hdr, pcm)) {
+        memcpy(net->frames + (size_t)(hdr.ts - net->first_ts) / net->frame * net->frame, pcm,
+               hdr.samples * sizeof(int16_t));
+    }
+    net->sent++;
+
+    /* a spike holds everything sent during it until it ends */
+    double in_period = fmod(now, SPIKE_EVERY_MS);
+    if (net->spike_ms > 0 && now > SPIKE_EVERY_MS && in_period < net->spike_ms) {
+        due += net->spike_ms - in_period;
+    }
+
+    /* bursts: a loss event takes 1..2 * burst - 1 packets */
+    if (0 == net->burst_left && uniform() < net->loss / net->burst) {
+        net->burst_left = 1 + (uint32_t)(uniform() * (2 * net->burst - 1));
+    }
+    if (net->burst_left) {
+        net->burst_left--;
+        net->dropped++;
+        net->trailing++;
+        return 0;
+    }
+    net->trailing = 0;
+    enqueue(net, pkt, len, due);
+    if (uniform() < net->dup) {
+        enqueue(net, pkt, len, due + net->jitter_ms * uniform());
+        net->duplicated++;
+    }
+    return 0;
+}
+
+/* sends everything due, returns when the next packet is */
+static double net_flush(net_t *net, double now)
+{
+    double next = 1e30;
+
+    for (uint32_t i = 0; i < net->nq;) {
+        if (net->q[i].due_ms <= now) {
+            sendto(net->sock, net->q[i].pkt, net->q[i].len, 0, (struct sockaddr *)&net->to, sizeof(net->to));
+            net->q[i] = net->q[--net->nq];
+            continue;
+        }
+        next = net->q[i].due_ms < next ? net->q[i].due_ms : next;
+        i++;
+    }
+    return next;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void write_wav(const char *path, const int16_t *pcm, uint32_t n)
+{
+    uint8_t h[44] = "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\0\0\0\0\0\0\0\0\x02\0\x10\0data";
+    FILE *fp = fopen(path, "wb");
+
+    if (NULL == fp) {
+        perror(path);
+        return;
+    }
+    put32(h + 4, 36 + 2 * n);
+    put32(h + 24, RATE);
+    put32(h + 28, 2 * RATE);
+    put32(h + 40, 2 * n);
+    fwrite(h, 1, sizeof(h), fp);
+    fwrite(pcm, 2, n, fp); /* little endian host */
+    fclose(fp);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-t seconds] [-c pcm|adpcm] [-f frame ms] [-d delay ms] [-j jitter ms] [-k spike ms]\n"
+           "          [-l loss%%] [-b burst] [-u dup%%] [-z playout ppm] [-m min ms] [-M max ms] [-L max late%%]\n"
+           "          [-x speed] [-p port] [-s seed] [-o playout.wav]\n",
+           prog);
+}
+
+int main(int argc, char **argv)
+{
+    static net_t net;
+    static rtp_audio_jb_t jb;
+    static rtp_audio_tx_t tx;
+    const char *wav = NULL;
+    double seconds = 20, frame_ms = 20, ppm = 0, max_late = 1.0;
+    uint32_t min_ms = 20, max_ms = 400;
+    uint16_t port = 5006;
+    uint8_t pt = RTP_AUDIO_PT_L16;
+    int opt;
+
+    net.base_ms = 20;
+    net.jitter_ms = 30;
+    net.spike_ms = 0;
+    net.loss = 0.02;
+    net.burst = 2;
+    net.dup = 0.005;
+    while ((opt = getopt(argc, argv, "t:c:f:d:j:k:l:b:u:z:m:M:L:x:p:s:o:h")) != -1) {
+        switch (opt) {
+            case 't':
+                seconds = atof(optarg);
+                break;
+            case 'c':
+                pt = 0 == strcmp(optarg, "adpcm") ? RTP_AUDIO_PT_DVI4 : RTP_AUDIO_PT_L16;
+                break;
+            case 'f':
+                frame_ms = atof(optarg);
+                break;
+            case 'd':
+                net.base_ms = atof(optarg);
+                break;
+            case 'j':
+                net.jitter_ms = atof(optarg);
+                break;
+            case 'k':
+                net.spike_ms = atof(optarg);
+                break;
+            case 'l':
+                net.loss = atof(optarg) / 100;
+                break;
+            case 'b':
+                net.burst = atof(optarg) < 1 ? 1 : atof(optarg);
+                break;
+            case 'u':
+                net.dup = atof(optarg) / 100;
+                break;
+            case 'z':
+                ppm = atof(optarg);
+                break;
+            case 'm':
+                min_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'M':
+                max_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'L':
+                max_late = atof(optarg);
+                break;
+            case 'x':
+                speed = atof(optarg);
+                break;
+            case 'p':
+                port = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                wav = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    uint32_t frame = (uint32_t)(frame_ms * RATE / 1000) & ~1u, total = (uint32_t)(seconds * 1000 / frame_ms);
+    if (0 == seed || speed <= 0 || 0 == frame || frame > RTP_AUDIO_MAX_SAMPLES || 0 == total) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int rx_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(rx_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (rx_sock < 0 || 0 != bind(rx_sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        perror("bind");
+        return 2;
+    }
+    net.sock = socket(AF_INET, SOCK_DGRAM, 0);
+    net.to = addr;
+    net.frame = frame;
+    net.frames = calloc((size_t)total * frame, sizeof(int16_t));
+
+    /* 440 Hz and 1.3 kHz, about -10 dBFS, plus a slow level change */
+    int16_t *src = calloc((size_t)total * frame, sizeof(int16_t));
+    int16_t *out = calloc((size_t)(total * 2 + 64) * frame, sizeof(int16_t));
+    uint8_t *out_real = calloc(total * 2 + 64, 1);
+    for (uint32_t i = 0; i < total * frame; i++) {
+        double t = (double)i / RATE, env = 0.6 + 0.4 * sin(2 * M_PI * 0.3 * t);
+        src[i] = (int16_t)(env * (6000 * sin(2 * M_PI * 440 * t) + 3000 * sin(2 * M_PI * 1300 * t)));
+    }
+
+    net.first_ts = xorshift(&seed);
+    rtp_audio_tx_init(&tx, xorshift(&seed), pt, net.first_ts);
+    rtp_audio_jb_init(&jb, RATE, min_ms, max_ms);
+    char sdp[256];
+    rtp_audio_sdp(sdp, sizeof(sdp), "127.0.0.1", port, pt, RATE);
+    printf("%s", sdp);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    double play_period = frame_ms * (1.0 - ppm / 1e6), next_play = -1, end = -1;
+    uint32_t sent = 0, pulls = 0, buffered_sum = 0, target_max = 0;
+    double signal = 0, noise = 0;
+    uint8_t pkt[RTP_AUDIO_MAX_PKT + 64];
+
+    for (;;) {
+        double now = now_ms();
+        while (sent < total && sent * frame_ms <= now) {
+            rtp_audio_send(&tx, src + sent * frame, frame, tx.ts, net_send, &net);
+            sent++;
+        }
+        double next_net = net_flush(&net, now);
+
+        ssize_t got;
+        while ((got = recv(rx_sock, pkt, sizeof(pkt), MSG_DONTWAIT)) > 0) {
+            rtp_audio_jb_push(&jb, pkt, got, (uint32_t)now);
+            if (next_play < 0) {
+                next_play = now; /* the playout clock starts with the first packet */
+            }
+        }
+
+        while (next_play >= 0 && next_play <= now && pulls < total * 2 + 64) {
+            uint32_t played = jb.played, concealed = jb.concealed;
+            rtp_audio_jb_pull(&jb, out + (size_t)pulls * frame);
+            if (jb.played != played) {
+                uint32_t n = (jb.play_ts - jb.frame - net.first_ts) / frame;
+                const int16_t *want = net.frames + (size_t)n * frame, *from = src + (size_t)n * frame;
+                CHECK(0 == memcmp(out + (size_t)pulls * frame, want, frame * sizeof(int16_t)),
+                      "frame %u played differs from the one sent", n);
+                for (uint32_t i = 0; i < frame; i++) {
+                    double e = out[(size_t)pulls * frame + i] - from[i];
+                    signal += (double)from[i] * from[i];
+                    noise += e * e;
+                }
+                out_real[pulls] = 1;
+            }
+            (void)concealed;
+            buffered_sum += rtp_audio_jb_buffered_ms(&jb);
+            target_max = jb.target_ms > target_max ? jb.target_ms : target_max;
+            pulls++;
+            next_play += play_period;
+        }
+
+        /* done once everything was sent, delivered and played out */
+        if (sent == total && 0 == net.nq && end < 0) {
+            end = now + max_ms + 2 * frame_ms;
+        }
+        if ((end >= 0 && now >= end) || pulls >= total * 2 + 64) {
+            break;
+        }
+
+        double next = next_net;
+        next = sent < total && sent * frame_ms < next ? sent * frame_ms : next;
+        next = next_play >= 0 && next_play < next ? next_play : next;
+        next = end >= 0 && end < next ? end : next;
+        int wait_ms = (int)((next - now) / speed);
+        struct pollfd pfd = {.fd = rx_sock, .events = POLLIN};
+        poll(&pfd, 1, wait_ms < 0 ? 0 : wait_ms > 100 ? 100 : wait_ms);
+    }
+
+    uint32_t lost = rtp_audio_jb_lost(&jb), missing = 0;
+    for (uint32_t i = 0; i < pulls; i++) {
+        missing += !out_real[i];
+    }
+    double snr = noise > 0 ? 10 * log10(signal / noise) : 999;
+
+    printf("sent      %u packets (%s, %u samples), dropped %u, duplicated %u, queue overflow %u\n", net.sent,
+           RTP_AUDIO_PT_DVI4 == pt ? "DVI4" : "L16", frame, net.dropped, net.duplicated, net.overflow);
+    printf("received  %u, lost %u, late %u, reordered %u, duplicate %u, too early %u, foreign %u, malformed %u\n",
+           jb.received, lost, jb.late, jb.reordered, jb.duplicate, jb.too_early, jb.foreign, jb.malformed);
+    printf("playout   %u frames: %u played, %u concealed (%u stretched), %u dropped to cut delay\n", pulls, jb.played,
+           jb.concealed, jb.stretched, jb.dropped);
+    printf("delay     jitter %.1f ms, target %u ms (max %u), buffered %.1f ms average\n", jb.jitter * 1000 / RATE,
+           jb.target_ms, target_max, pulls ? (double)buffered_sum / pulls : 0.0);
+    printf("quality   %.1f dB SNR over played frames\n", snr);
+
+    CHECK(0 == net.overflow, "network queue overflowed");
+    CHECK(lost == net.dropped - net.trailing, "receiver counts %u lost, network dropped %u (%u at the end)", lost,
+          net.dropped, net.trailing);
+    CHECK(jb.played + jb.dropped + lost + jb.late + net.trailing >= total && jb.played <= total,
+          "%u played + %u dropped + %u lost + %u late don't account for %u frames", jb.played, jb.dropped, lost,
+          jb.late, total);
+    CHECK(jb.concealed >= lost - (lost < jb.dropped ? lost : jb.dropped),
+          "%u concealed for %u lost packets", jb.concealed, lost);
+    CHECK(100.0 * jb.late / total <= max_late, "%.2f%% of the packets late, limit %.2f%%", 100.0 * jb.late / total,
+          max_late);
+    if (RTP_AUDIO_PT_DVI4 == pt) {
+        CHECK(snr >= MIN_SNR_DB, "DVI4 SNR %.1f dB", snr);
+    } else {
+        CHECK(noise == 0, "L16 frames not bit exact");
+    }
+    if (wav) {
+        write_wav(wav, out, pulls * frame);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+
+    close(net.sock);
+    close(rx_sock);
+    free(net.frames);
+    free(src);
+    free(out);
+    free(out_real);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * audio_rx - receiver for the E907's audio_udp stream.
+ *
+ * Listens for RTP audio (L16 or DVI4, see rtp_audio.h) on a UDP port, runs
+ * it through the same jitter buffer as audio_loopback with a playout clock
+ * of the frame period, and writes what it plays to a WAV file, or raw
+ * 16 bit PCM to stdout with -o - for a player:
+ *
+ *   ./audio_rx -p 5006 -o - | aplay -f S16_LE -r 16000 -c 1
+ *
+ * Every second it reports the playout delay, the jitter and the loss, late
+ * and concealment counts on stderr. Ctrl-C finishes the WAV file.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -o audio_rx audio_rx.c ../rtp_audio.c -lm
+ *   ./audio_rx -p 5006 -o mic.wav -t 60
+ *
+ * Exit status is 1 if the socket can't be bound or nothing was received.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rtp_audio.h"
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static double now_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/* header with the sizes left open, filled in by wav_finish() */
+static void wav_start(FILE *fp, uint32_t rate)
+{
+    uint8_t h[44] = "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\0\0\0\0\0\0\0\0\x02\0\x10\0data";
+
+    put32(h + 24, rate);
+    put32(h + 28, 2 * rate);
+    fwrite(h, 1, sizeof(h), fp);
+}
+
+static void wav_finish(FILE *fp, uint32_t samples)
+{
+    uint8_t v[4];
+
+    put32(v, 36 + 2 * samples);
+    fseek(fp, 4, SEEK_SET);
+    fwrite(v, 1, 4, fp);
+    put32(v, 2 * samples);
+    fseek(fp, 40, SEEK_SET);
+    fwrite(v, 1, 4, fp);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-p port] [-o out.wav|-] [-t seconds] [-r rate] [-m min ms] [-M max ms]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    static rtp_audio_jb_t jb;
+    const char *path = NULL;
+    double seconds = 0;
+    uint32_t rate = 16000, min_ms = 20, max_ms = 400;
+    uint16_t port = 5006;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:o:t:r:m:M:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                path = optarg;
+                break;
+            case 't':
+                seconds = atof(optarg);
+                break;
+            case 'r':
+                rate = strtoul(optarg, NULL, 0);
+                break;
+            case 'm':
+                min_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'M':
+                max_ms = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (rate < 1000) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = INADDR_ANY};
+    if (sock < 0 || 0 != bind(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        perror("bind");
+        return 1;
+    }
+
+    FILE *out = NULL;
+    int raw = path && 0 == strcmp(path, "-");
+    if (raw) {
+        out = stdout;
+    } else if (path) {
+        if (NULL == (out = fopen(path, "wb"))) {
+            perror(path);
+            return 1;
+        }
+        wav_start(out, rate);
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    rtp_audio_jb_init(&jb, rate, min_ms, max_ms);
+    fprintf(stderr, "[audio_rx] listening on udp port %u, %u Hz\n", port, rate);
+
+    static int16_t pcm[RTP_AUDIO_MAX_SAMPLES];
+    uint8_t pkt[2048];
+    double start = now_ms(), next_play = -1, report = start + 1000;
+    uint32_t samples = 0;
+
+    while (!stop && (seconds <= 0 || now_ms() - start < seconds * 1000)) {
+        double now = now_ms();
+        int wait = next_play < 0 ? 100 : (int)(next_play - now);
+        struct pollfd pfd = {.fd = sock, .events = POLLIN};
+        poll(&pfd, 1, wait < 0 ? 0 : wait > 100 ? 100 : wait);
+
+        ssize_t got;
+        now = now_ms();
+        while ((got = recv(sock, pkt, sizeof(pkt), MSG_DONTWAIT)) > 0) {
+            rtp_audio_jb_push(&jb, pkt, got, (uint32_t)now);
+            if (next_play < 0 && jb.have_stream) {
+                next_play = now;
+                fprintf(stderr, "[audio_rx] ssrc %08x, %u samples per packet\n", jb.ssrc, jb.frame);
+            }
+        }
+
+        /* the playout clock: a frame every frame_ms, catching up if poll() overslept */
+        while (next_play >= 0 && next_play <= now) {
+            uint32_t n = rtp_audio_jb_pull(&jb, pcm);
+            if (out) {
+                fwrite(pcm, sizeof(int16_t), n, out); /* little endian host */
+                if (raw) {
+                    fflush(out);
+                }
+            }
+            samples += n;
+            next_play += (double)jb.frame * 1000 / rate;
+        }
+
+        if (now >= report) {
+            fprintf(stderr,
+                    "[audio_rx] buffered %3u ms, target %3u ms, jitter %5.1f ms | received %u, lost %u, late %u, "
+                    "reordered %u, dup %u | concealed %u, stretched %u, dropped %u\n",
+                    rtp_audio_jb_buffered_ms(&jb), jb.target_ms, jb.jitter * 1000 / rate, jb.received,
+                    rtp_audio_jb_lost(&jb), jb.late, jb.reordered, jb.duplicate, jb.concealed, jb.stretched,
+                    jb.dropped);
+            report += 1000;
+        }
+    }
+
+    if (out && !raw) {
+        wav_finish(out, samples);
+        fclose(out);
+    }
+    close(sock);
+    fprintf(stderr, "[audio_rx] %u packets, %u lost, %u late, %.1f s played\n", jb.received,
+            rtp_audio_jb_lost(&jb), jb.late, (double)samples / rate);
+    return jb.received ? 0 : 1;
+}
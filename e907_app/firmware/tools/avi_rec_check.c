@@ -0,0 +1,401 @@
+/*
+ * avi_rec_check - avi_rec.c writing a real file, then the file taken apart.
+ *
+ * A producer thread feeds odd sized synthetic JPEGs (SOI, SOF0 with the
+ * frame size, filler, EOI) as fast as the ring takes them, a writer thread
+ * pumps blocks and checkpoints like the E907's writer task. The result is
+ * parsed back: RIFF and LIST sizes, avih/strh/strf, every '00dc' chunk
+ * against the frame that was put, idx1 against the chunks, and the JUNK
+ * covering the preallocated tail. Then a power cut is simulated (the file
+ * is dropped after a checkpoint without avi_rec_close()) and what is left
+ * has to be a valid AVI holding at least the checkpointed frames.
+ *
+ * Reports the sustained rate, open to closed and synced. To measure a FAT
+ * file system rather than the host's, write into a loop mounted image:
+ *   mkfs.vfat -C -s 64 sd.img 1048576 && sudo mount -o loop sd.img /mnt
+ *   ./avi_rec_check -o /mnt/rec.avi -k
+ * and play /mnt/rec.avi (filler frames decode as grey, or not at all)
+ * with ffprobe/ffplay to see players accept it.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -pthread -I.. -o avi_rec_check avi_rec_check.c ../avi_rec.c ../avi_mux.c
+ *   ./avi_rec_check -n 600 -b 32
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "avi_rec.h"
+
+#define WIDTH (1920)
+#define HEIGHT (1080)
+#define MIN_FRAME (20 * 1024)
+#define MAX_FRAME (90 * 1024)
+
+static uint32_t nframes = 600;
+static uint32_t seed = 1;
+static uint32_t checkpoint_ms = 50;
+static avi_rec_t rec;
+static volatile int producing;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static double now_s(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static inline uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/* frame i, always the same bytes for the same seed; filler never holds 0xff, so no stray markers */
+static uint32_t make_frame(uint32_t i, uint8_t *buf)
+{
+    uint32_t s = (seed * 2654435761u) ^ (i * 40503u + 1), len;
+    static const uint8_t sof[] = {0xff, 0xc0, 0x00, 0x11, 0x08, HEIGHT >> 8, HEIGHT & 0xff, WIDTH >> 8, WIDTH & 0xff,
+                                  0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01};
+
+    if (0 == s) s = 1;
+    len = MIN_FRAME + xorshift(&s) % (MAX_FRAME - MIN_FRAME);
+    buf[0] = 0xff;
+    buf[1] = 0xd8;
+    memcpy(buf + 2, sof, sizeof(sof));
+    for (uint32_t k = 2 + sizeof(sof); k < len - 2; k++) {
+        buf[k] = xorshift(&s) % 0xff;
+    }
+    buf[len - 2] = 0xff;
+    buf[len - 1] = 0xd9;
+    return len;
+}
+
+static void *producer(void *arg)
+{
+    static uint8_t frame[MAX_FRAME];
+
+    (void)arg;
+    for (uint32_t i = 0; i < nframes; i++) {
+        uint32_t len = make_frame(i, frame);
+        /* wait for room rather than drop, the point is the writer's rate */
+        while (avi_chunk_size(len) > rec.ring_size - (rec.head - __atomic_load_n(&rec.tail, __ATOMIC_ACQUIRE)) ||
+               AVI_IDX_ENTRY > AVI_REC_IDX_RING - (rec.idx_head - __atomic_load_n(&rec.idx_tail, __ATOMIC_ACQUIRE))) {
+            if (rec.error) {
+                goto out;
+            }
+            sched_yield();
+        }
+        CHECK(0 == avi_rec_put(&rec, frame, len), "put %u", i);
+    }
+out:
+    producing = 0;
+    return NULL;
+}
+
+static void *writer(void *arg)
+{
+    (void)arg;
+    double next = now_s() + checkpoint_ms / 1000.0;
+
+    while (producing) {
+        int n = avi_rec_pump(&rec);
+        if (n < 0) {
+            break;
+        }
+        if (now_s() >= next) {
+            avi_rec_checkpoint(&rec);
+            next = now_s() + checkpoint_ms / 1000.0;
+        }
+        if (0 == n) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static uint8_t *load(const char *path, uint32_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf = NULL;
+    long n;
+
+    if (NULL == f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (n > 0 && NULL != (buf = malloc(n)) && 1 != fread(buf, n, 1, f)) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *len = n;
+    return buf;
+}
+
+/*
+ * Walks the file as a player would. final: idx1 and the closing JUNK are
+ * required; otherwise (after a power cut) there is no index and the header
+ * may count fewer frames than movi holds. Returns the frames in movi.
+ */
+static uint32_t verify(const char *path, int final, uint32_t block)
+{
+    static uint8_t frame[MAX_FRAME];
+    uint32_t flen, movi_frames = 0, movi_pos = 0, movi_size = 0, idx_pos = 0, idx_size = 0, junk_end = 0;
+    uint8_t *f = load(path, &flen);
+
+    CHECK(NULL != f && flen >= AVI_HDR_SIZE, "%s: can't read", path);
+    if (NULL == f || flen < AVI_HDR_SIZE) {
+        free(f);
+        return 0;
+    }
+
+    uint32_t riff_end = 8 + get32(f + 4);
+    CHECK(AVI_FOURCC('R', 'I', 'F', 'F') == get32(f) && AVI_FOURCC('A', 'V', 'I', ' ') == get32(f + 8),
+          "RIFF AVI header");
+    CHECK(riff_end <= flen, "RIFF size %u past the file end %u", riff_end, flen);
+    if (final) {
+        CHECK(riff_end == flen, "RIFF ends at %u, file at %u", riff_end, flen);
+    }
+    CHECK(0 == (riff_end & 1), "odd RIFF size");
+
+    /* hdrl */
+    const uint8_t *avih = f + 24, *strh = f + 24 + 64 + 12, *strf = strh + 64;
+    CHECK(AVI_FOURCC('L', 'I', 'S', 'T') == get32(f + 12) && AVI_FOURCC('h', 'd', 'r', 'l') == get32(f + 20), "hdrl");
+    CHECK(AVI_FOURCC('a', 'v', 'i', 'h') == get32(avih) && 56 == get32(avih + 4), "avih");
+    CHECK(AVI_FOURCC('s', 't', 'r', 'h') == get32(strh) && AVI_FOURCC('v', 'i', 'd', 's') == get32(strh + 8) &&
+              AVI_FOURCC('M', 'J', 'P', 'G') == get32(strh + 12),
+          "strh vids/MJPG");
+    CHECK(AVI_FOURCC('s', 't', 'r', 'f') == get32(strf) && 40 == get32(strf + 8), "strf");
+    CHECK(WIDTH == get32(avih + 40) && HEIGHT == get32(avih + 44), "avih size %ux%u", get32(avih + 40),
+          get32(avih + 44));
+    CHECK(WIDTH == get32(strf + 12) && HEIGHT == get32(strf + 16), "strf size");
+    CHECK(WIDTH == get16(strh + 8 + 52) && HEIGHT == get16(strh + 8 + 54), "rcFrame");
+    uint32_t hdr_frames = get32(avih + 24);
+    CHECK(hdr_frames == get32(strh + 8 + 32), "avih frames %u, strh length %u", hdr_frames, get32(strh + 40));
+    CHECK(get32(avih + 36) >= MIN_FRAME || 0 == hdr_frames, "suggested buffer size %u", get32(avih + 36));
+    CHECK(final == !!(get32(avih + 20) & AVIF_HASINDEX), "AVIF_HASINDEX %s", final ? "missing" : "before idx1");
+
+    /* top level chunks after hdrl */
+    uint32_t pos = 12 + 8 + get32(f + 16);
+    while (pos + 8 <= riff_end) {
+        uint32_t id = get32(f + pos), size = get32(f + pos + 4);
+        CHECK(pos + 8 + size <= riff_end, "chunk at %u overruns the RIFF", pos);
+        if (pos + 8 + size > riff_end) {
+            break;
+        }
+        if (AVI_FOURCC('L', 'I', 'S', 'T') == id && AVI_FOURCC('m', 'o', 'v', 'i') == get32(f + pos + 8)) {
+            movi_pos = pos + 8;
+            movi_size = size;
+        } else if (AVI_FOURCC('i', 'd', 'x', '1') == id) {
+            idx_pos = pos + 8;
+            idx_size = size;
+        } else if (AVI_FOURCC('J', 'U', 'N', 'K') == id) {
+            if (movi_pos) {
+                junk_end = pos + 8 + size; /* not the header's padding */
+            }
+        } else {
+            CHECK(0, "unexpected chunk %.4s at %u", (const char *)(f + pos), pos);
+        }
+        pos += 8 + size + (size & 1);
+    }
+    CHECK(movi_pos == AVI_MOVI_FOURCC_POS, "movi at %u", movi_pos);
+
+    /* every frame, in order, byte for byte */
+    for (pos = movi_pos + 4; movi_pos && pos + 8 <= movi_pos + movi_size;) {
+        uint32_t len = get32(f + pos + 4);
+        CHECK(AVI_FOURCC('0', '0', 'd', 'c') == get32(f + pos), "chunk %u at %u is not 00dc", movi_frames, pos);
+        if (pos + 8 + len > movi_pos + movi_size) {
+            CHECK(0, "frame %u overruns movi", movi_frames);
+            break;
+        }
+        uint32_t want = make_frame(movi_frames, frame);
+        CHECK(want == len && 0 == memcmp(frame, f + pos + 8, len), "frame %u differs", movi_frames);
+        pos += avi_chunk_size(len);
+        movi_frames++;
+    }
+    CHECK(pos == movi_pos + movi_size, "movi has %u trailing bytes", movi_pos + movi_size - pos);
+    CHECK(hdr_frames <= movi_frames, "header says %u frames, movi holds %u", hdr_frames, movi_frames);
+
+    if (final) {
+        CHECK(hdr_frames == movi_frames, "header says %u frames, movi holds %u", hdr_frames, movi_frames);
+        CHECK(idx_pos && idx_size == movi_frames * AVI_IDX_ENTRY, "idx1 of %u bytes for %u frames", idx_size,
+              movi_frames);
+        for (uint32_t i = 0; idx_pos && i < idx_size / AVI_IDX_ENTRY; i++) {
+            const uint8_t *e = f + idx_pos + i * AVI_IDX_ENTRY;
+            uint32_t at = AVI_MOVI_FOURCC_POS + get32(e + 8);
+            CHECK(AVI_FOURCC('0', '0', 'd', 'c') == get32(e) && AVIIF_KEYFRAME == get32(e + 4), "idx1 entry %u", i);
+            CHECK(at + 8 <= flen && AVI_FOURCC('0', '0', 'd', 'c') == get32(f + at) && get32(f + at + 4) == get32(e + 12),
+                  "idx1 entry %u points at %u", i, at);
+        }
+        /* the closing JUNK takes the file to its end, whatever preallocation left */
+        CHECK(0 == junk_end || junk_end == flen, "JUNK ends at %u, file at %u", junk_end, flen);
+        /* every block boundary crossed was one whole block write, the header's share excepted */
+        uint32_t end = idx_pos + idx_size + (junk_end ? 8 : 0);
+        CHECK(rec.stat.writes == end / block - AVI_HDR_SIZE / block, "%u block writes up to %u", rec.stat.writes, end);
+    } else {
+        CHECK(0 == idx_pos, "idx1 before close");
+    }
+    free(f);
+    return movi_frames;
+}
+
+static int record(const char *path, avi_rec_cfg_t *cfg, double *secs)
+{
+    pthread_t tp, tw;
+    double t0 = now_s();
+
+    if (0 != avi_rec_open(&rec, path, cfg)) {
+        printf("can't create %s\n", path);
+        return -1;
+    }
+    producing = 1;
+    pthread_create(&tw, NULL, writer, NULL);
+    pthread_create(&tp, NULL, producer, NULL);
+    pthread_join(tp, NULL);
+    pthread_join(tw, NULL);
+    int ret = avi_rec_close(&rec);
+    *secs = now_s() - t0;
+    return ret;
+}
+
+/* single threaded: checkpoint half way, keep writing, then lose power */
+static void power_cut(const char *path, avi_rec_cfg_t *cfg)
+{
+    static uint8_t frame[MAX_FRAME];
+    uint32_t at = nframes / 2, i;
+
+    if (0 != avi_rec_open(&rec, path, cfg)) {
+        CHECK(0, "can't create %s", path);
+        return;
+    }
+    for (i = 0; i < nframes; i++) {
+        uint32_t len = make_frame(i, frame);
+        while (0 != avi_rec_put(&rec, frame, len)) {
+            if (avi_rec_pump(&rec) <= 0) {
+                break;
+            }
+        }
+        avi_rec_pump(&rec);
+        if (i + 1 == at) {
+            CHECK(0 == avi_rec_checkpoint(&rec), "checkpoint");
+        }
+    }
+    close(rec.fd);
+    close(rec.idx_fd);
+    unlink(rec.idx_path);
+    free(rec.ring);
+
+    uint32_t n = verify(path, 0, cfg->block);
+    CHECK(n >= at, "%u frames survived, %u were checkpointed", n, at);
+    printf("power cut: %u of %u frames playable, %u checkpointed\n", n, nframes, at);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = "/tmp/avi_rec_check.avi";
+    char cut_path[256];
+    avi_rec_cfg_t cfg;
+    int keep = 0, opt;
+    double secs = 0;
+
+    avi_rec_default_cfg(&cfg);
+    while ((opt = getopt(argc, argv, "o:n:b:p:c:s:kh")) != -1) {
+        switch (opt) {
+            case 'o':
+                path = optarg;
+                break;
+            case 'n':
+                nframes = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                cfg.block = strtoul(optarg, NULL, 0) * 1024;
+                break;
+            case 'p':
+                cfg.prealloc = strtoul(optarg, NULL, 0) * 1024;
+                break;
+            case 'c':
+                checkpoint_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keep = 1;
+                break;
+            default:
+                printf("Usage: %s [-o file.avi] [-n frames] [-b block KB] [-p prealloc KB] [-c checkpoint ms] "
+                       "[-s seed] [-k]\n",
+                       argv[0]);
+                return 2;
+        }
+    }
+    if (0 == cfg.block || 0 == nframes || (cfg.prealloc % cfg.block)) {
+        printf("block must be > 0 and divide prealloc\n");
+        return 2;
+    }
+    /* the largest frame has to fit next to a partly filled block */
+    while (cfg.block * (cfg.nblocks - 1) < avi_chunk_size(MAX_FRAME)) {
+        cfg.nblocks++;
+    }
+
+    int ret = record(path, &cfg, &secs);
+    CHECK(0 == ret, "record");
+    if (0 != ret) {
+        /* no file to verify, nor a rate to report */
+        if (!keep) {
+            unlink(path);
+        }
+        printf("%u checks, %u failed\n", checks, failed);
+        return 1;
+    }
+    uint32_t n = verify(path, 1, cfg.block);
+    CHECK(n == nframes, "%u of %u frames in the file", n, nframes);
+    printf("%s: %u frames, %llu bytes written in %u block writes, %u partial, %u checkpoints\n", path, n,
+           (unsigned long long)rec.stat.bytes, rec.stat.writes, rec.stat.partials, rec.stat.checkpoints);
+    printf("%.1f MB/s sustained (%.2f s, synced)\n", rec.stat.bytes / secs / (1024 * 1024), secs);
+
+    snprintf(cut_path, sizeof(cut_path), "%s.cut.avi", path);
+    power_cut(cut_path, &cfg);
+
+    if (!keep) {
+        unlink(path);
+        unlink(cut_path);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
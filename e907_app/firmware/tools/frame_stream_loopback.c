@@ -0,0 +1,381 @@
+/*
+ * frame_stream_loopback - frame_stream.c sender and a receiver on localhost.
+ *
+ * The sender offers -n frames of random size as fast as frame_stream_send()
+ * takes them, skipping about one in -k with frame_stream_skip() as the rate
+ * controller would. The receiver does what main.py does: advertises its
+ * window, acks every frame it consumed and counts the frames missing from
+ * the gaps in the frame numbers, but takes 0..-d ms per frame, so the
+ * sender runs out of credit and drops. Every ack is held -r ms before it
+ * goes out, the round trip of a real link that loopback does not have:
+ * without it a window of one frame is credited again at once and all
+ * window sizes look alike. One run per window size (-w, or 1, 2, 4, 8 and
+ * 16), each checking:
+ *
+ *   seq        every header's seq is the one after the last, drops never
+ *              use one up, so the acks stay cumulative
+ *   contents   every frame is the one its frame number says
+ *   missing    the receiver counted exactly the sender's dropped + skipped
+ *   counts     frames received == frames sent, acked == sent at the end
+ *
+ * and reporting the share dropped, frames delivered per second and goodput,
+ * the frame bytes delivered per second, which is what a bigger window buys:
+ * at most window frames per round trip.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -pthread -I.. -o frame_stream_loopback frame_stream_loopback.c ../frame_stream.c
+ *   ./frame_stream_loopback -n 3000 -d 2 -r 10
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frame_stream.h"
+
+#define MAX_FRAME (64 * 1024)
+#define ACK_QUEUE (64) /* acks in flight, never more than the window */
+
+static uint32_t frames = 2000, skip_one_in = 10, delay_ms = 2, rtt_ms = 10;
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline uint8_t pattern(uint32_t frame, uint32_t i)
+{
+    return (uint8_t)((frame * 2654435761u) >> 24 ^ i ^ i >> 8);
+}
+
+typedef struct {
+    uint64_t due_us;
+    uint32_t next_seq;
+} held_ack_t;
+
+typedef struct {
+    int listen_sock;
+    uint32_t window;
+    uint32_t seed;
+
+    /* acks held for the round trip, sent by acker() */
+    int sock;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    held_ack_t acks[ACK_QUEUE];
+    uint32_t ack_head, ack_tail;
+    int done;
+    int ack_error;
+
+    /* results */
+    uint32_t received;
+    uint64_t bytes;
+    uint32_t missing;
+    uint32_t bad_seq;
+    uint32_t bad_data;
+    int error;
+} rx_t;
+
+static int recv_exact(int sock, uint8_t *buf, uint32_t len)
+{
+    while (len > 0) {
+        ssize_t n = recv(sock, buf, len, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int send_ack(int sock, uint32_t next_seq, uint32_t window)
+{
+    fs_ack_t ack = {FRAME_STREAM_ACK_MAGIC, next_seq, window};
+    uint8_t raw[FRAME_STREAM_ACK_SIZE];
+
+    frame_stream_ack_pack(&ack, raw);
+    return sizeof(raw) == send(sock, raw, sizeof(raw), 0) ? 0 : -1;
+}
+
+/* the return path: sends each ack once its round trip is over, in order */
+static void *acker(void *arg)
+{
+    rx_t *rx = arg;
+
+    pthread_mutex_lock(&rx->lock);
+    for (;;) {
+        while (rx->ack_head == rx->ack_tail && !rx->done) {
+            pthread_cond_wait(&rx->cond, &rx->lock);
+        }
+        if (rx->done) {
+            break; /* the sender is gone, nobody to ack */
+        }
+        held_ack_t ack = rx->acks[rx->ack_head % ACK_QUEUE];
+        pthread_mutex_unlock(&rx->lock);
+
+        uint64_t now = now_us();
+        if (ack.due_us > now) {
+            usleep(ack.due_us - now);
+        }
+        int ret = send_ack(rx->sock, ack.next_seq, rx->window);
+
+        pthread_mutex_lock(&rx->lock);
+        rx->ack_head++;
+        if (0 != ret) {
+            rx->ack_error = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&rx->lock);
+    return NULL;
+}
+
+static int hold_ack(rx_t *rx, uint32_t next_seq)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&rx->lock);
+    if (rx->ack_tail - rx->ack_head == ACK_QUEUE) {
+        ret = -1; /* more frames in flight than any window allows */
+    } else {
+        rx->acks[rx->ack_tail++ % ACK_QUEUE] = (held_ack_t){now_us() + rtt_ms * 1000ull, next_seq};
+        pthread_cond_signal(&rx->cond);
+    }
+    pthread_mutex_unlock(&rx->lock);
+    return ret;
+}
+
+/* main.py's serve_window, plus checking the contents */
+static void *receiver(void *arg)
+{
+    rx_t *rx = arg;
+    static uint8_t buf[MAX_FRAME];
+    uint32_t next_seq = 0, next_frame = 0;
+
+    int sock = accept(rx->listen_sock, NULL, NULL);
+    if (sock < 0) {
+        rx->error = 1;
+        return NULL;
+    }
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    pthread_t ack_tid;
+    rx->sock = sock;
+    if (0 != send_ack(sock, next_seq, rx->window) || 0 != pthread_create(&ack_tid, NULL, acker, rx)) {
+        rx->error = 1;
+        close(sock);
+        return NULL;
+    }
+    while (!rx->error) {
+        uint8_t raw[FRAME_STREAM_HDR_SIZE];
+        fs_hdr_t hdr;
+
+        if (0 != recv_exact(sock, raw, sizeof(raw))) {
+            break; /* the sender is done */
+        }
+        if (0 != frame_stream_hdr_unpack(raw, &hdr) || hdr.len > MAX_FRAME || 0 != recv_exact(sock, buf, hdr.len)) {
+            rx->error = 1;
+            break;
+        }
+
+        rx->bad_seq += hdr.seq != next_seq;
+        rx->missing += hdr.frame - next_frame;
+        next_seq = hdr.seq + 1;
+        next_frame = hdr.frame + 1;
+        for (uint32_t i = 0; i < hdr.len; i++) {
+            if (buf[i] != pattern(hdr.frame, i)) {
+                rx->bad_data++;
+                break;
+            }
+        }
+        rx->received++;
+        rx->bytes += hdr.len;
+
+        /* a receiver slower than the sender, decoding and showing the frame */
+        uint32_t d = delay_ms ? xorshift(&rx->seed) % (delay_ms * 1000 + 1) : 0;
+        if (d) {
+            usleep(d);
+        }
+        if (0 != hold_ack(rx, next_seq)) {
+            rx->error = 1;
+        }
+    }
+    pthread_mutex_lock(&rx->lock);
+    rx->done = 1;
+    pthread_cond_signal(&rx->cond);
+    pthread_mutex_unlock(&rx->lock);
+    pthread_join(ack_tid, NULL);
+    rx->error |= rx->ack_error;
+    close(sock);
+    return NULL;
+}
+
+static void run(uint32_t window)
+{
+    static uint8_t frame[MAX_FRAME];
+    rx_t rx = {.window = window, .seed = seed, .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+    fs_sender_t s;
+    pthread_t tid;
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    rx.listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (rx.listen_sock < 0 || 0 != bind(rx.listen_sock, (struct sockaddr *)&addr, sizeof(addr)) ||
+        0 != listen(rx.listen_sock, 1) || 0 != getsockname(rx.listen_sock, (struct sockaddr *)&addr, &addr_len)) {
+        perror("listen");
+        failed++;
+        return;
+    }
+    pthread_create(&tid, NULL, receiver, &rx);
+
+    if (0 != frame_stream_connect(&s, "127.0.0.1", ntohs(addr.sin_port), 3000)) {
+        CHECK(0, "window %u: connect failed", window);
+        shutdown(rx.listen_sock, SHUT_RDWR);
+        pthread_join(tid, NULL);
+        close(rx.listen_sock);
+        return;
+    }
+
+    uint64_t t0 = now_us();
+    int ret = 0;
+    for (uint32_t f = 0; f < frames && ret >= 0; f++) {
+        uint32_t len = 1 + xorshift(&seed) % MAX_FRAME;
+        if (f + 1 < frames && 0 == xorshift(&seed) % skip_one_in) {
+            frame_stream_skip(&s);
+            continue;
+        }
+        /* the frame being offered carries s.frame, fill it in that frame's pattern */
+        for (uint32_t i = 0; i < len; i++) {
+            frame[i] = pattern(s.frame, i);
+        }
+        if (f + 1 == frames) {
+            /* the last one waits for credit, so the receiver sees every gap before it */
+            while ((ret = frame_stream_poll(&s, 1000)) == 0) {
+            }
+        }
+        if (ret >= 0) {
+            ret = frame_stream_send(&s, frame, len, now_us());
+        }
+        usleep(100); /* capture pace, well above what the receiver takes */
+    }
+    CHECK(ret >= 0, "window %u: connection lost", window);
+
+    /* wait for the receiver to consume everything */
+    for (int i = 0; i < 5000 && s.acked != s.seq && frame_stream_poll(&s, 0) >= 0; i++) {
+        usleep(1000);
+    }
+    uint64_t elapsed = now_us() - t0;
+    CHECK(s.acked == s.seq, "window %u: %u of %u frames acked", window, s.acked, s.seq);
+    frame_stream_close(&s);
+    pthread_join(tid, NULL);
+    close(rx.listen_sock);
+
+    CHECK(0 == rx.error, "window %u: receiver failed", window);
+    CHECK(0 == rx.bad_seq, "window %u: %u frames out of seq", window, rx.bad_seq);
+    CHECK(0 == rx.bad_data, "window %u: %u frames with the wrong contents", window, rx.bad_data);
+    CHECK(rx.received == s.sent && s.sent == s.seq, "window %u: received %u, sent %u, seq %u", window, rx.received,
+          s.sent, s.seq);
+    CHECK(rx.missing == s.dropped + s.skipped, "window %u: receiver counted %u missing, sender dropped %u skipped %u",
+          window, rx.missing, s.dropped, s.skipped);
+    CHECK(s.frame == frames, "window %u: %u frame numbers for %u frames offered", window, s.frame, frames);
+
+    printf("window %2u: %5u sent, %5u dropped (%4.1f%%), %4u skipped, receiver saw %5u missing, %6.1f fps, "
+           "%8.1f KB/s\n",
+           window, s.sent, s.dropped, 100.0 * s.dropped / frames, s.skipped, rx.missing, s.sent * 1e6 / elapsed,
+           rx.bytes * 1e6 / 1024 / elapsed);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-n frames] [-w window] [-k skip_one_in] [-d max_delay_ms] [-r rtt_ms] [-s seed]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t window = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:k:d:r:s:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                window = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                skip_one_in = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                delay_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                rtt_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        printf("seed must be > 0\n");
+        return 2;
+    }
+    if (0 == frames || 0 == skip_one_in || window > FRAME_STREAM_MAX_WINDOW) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN); /* a peer gone shows up as a send error */
+    if (window) {
+        run(window);
+    } else {
+        for (window = 1; window <= FRAME_STREAM_MAX_WINDOW; window *= 2) {
+            run(window);
+        }
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * fring_stress - frame_ring.c with the two cores played by two threads.
+ *
+ * The producer fills buffers from a small pool with a pattern derived from
+ * the sequence number and pushes them; the consumer pops, checks sequence
+ * and contents, keeps a few frames for a while and releases them in order;
+ * the producer reclaims released buffers into the pool. Any lost, repeated
+ * or reordered descriptor, torn buffer or buffer coming back twice is an
+ * error. Random stalls on both sides keep the ring swinging between empty
+ * and full.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -pthread -I.. -o fring_stress fring_stress.c ../frame_ring.c
+ *   ./fring_stress -n 2000000
+ *
+ * Exit status is 1 on any error.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "frame_ring.h"
+
+#ifndef MAP_32BIT
+#define MAP_32BIT (0) /* x86-64 only, elsewhere hope for a low mapping */
+#endif
+
+#define POOL (FRAME_RING_SLOTS + 4)
+#define BUF_SIZE (4096)
+#define HOLD_MAX (3)
+
+static fring_shm_t shm __attribute__((aligned(FRAME_RING_LINE)));
+static uint8_t (*pool)[BUF_SIZE]; /* below 4 GB, descriptors carry 32 bit addresses */
+static int in_use[POOL];
+static fring_t prod, cons;
+static uint32_t total = 1000000;
+static volatile uint32_t errors;
+static uint32_t reclaim_seq;
+
+static uint32_t xorshift(uint32_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+static void stall(uint32_t *rnd)
+{
+    uint32_t r = xorshift(rnd) & 1023;
+    if (r < 8) {
+        usleep(r * 20);
+    } else if (r < 64) {
+        sched_yield();
+    }
+}
+
+static void on_reclaim(void *arg, const fring_desc_t *d)
+{
+    (void)arg;
+    if (d->cookie >= POOL || !in_use[d->cookie]) {
+        printf("reclaim: buffer %u was not in use\n", d->cookie);
+        errors++;
+        return;
+    }
+    if (d->seq != reclaim_seq) {
+        printf("reclaim: seq %u, expected %u\n", d->seq, reclaim_seq);
+        errors++;
+    }
+    reclaim_seq = d->seq + 1;
+    in_use[d->cookie] = 0;
+}
+
+static void *producer(void *arg)
+{
+    (void)arg;
+    uint32_t rnd = 0x12345678;
+
+    for (uint32_t seq = 0; seq < total && !errors;) {
+        fring_reclaim(&prod, on_reclaim, NULL);
+
+        int id = -1;
+        for (int i = 0; i < POOL; i++) {
+            if (!in_use[i]) {
+                id = i;
+                break;
+            }
+        }
+        if (id < 0) {
+            sched_yield();
+            continue;
+        }
+
+        uint32_t len = 16 + xorshift(&rnd) % (BUF_SIZE - 16);
+        for (uint32_t i = 0; i < len; i += 4) {
+            *(uint32_t *)&pool[id][i] = seq * 2654435761u ^ i;
+        }
+        in_use[id] = 1;
+        while (0 != fring_push(&prod, (uint32_t)(uintptr_t)pool[id], len, seq, id)) {
+            fring_reclaim(&prod, on_reclaim, NULL);
+            sched_yield();
+        }
+        seq++;
+        stall(&rnd);
+    }
+
+    /* wait for the consumer to hand everything back */
+    while (prod.reclaimed != prod.head && !errors) {
+        fring_reclaim(&prod, on_reclaim, NULL);
+        sched_yield();
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    (void)arg;
+    uint32_t rnd = 0x9abcdef0, expect = 0, held = 0;
+
+    while (expect < total && !errors) {
+        fring_desc_t d;
+        if (!fring_pop(&cons, &d)) {
+            if (held) {
+                fring_release(&cons);
+                held--;
+            }
+            sched_yield();
+            continue;
+        }
+        if (d.seq != expect || d.ts_ms != expect) {
+            printf("pop: seq %u, expected %u\n", d.seq, expect);
+            errors++;
+            break;
+        }
+        const uint8_t *buf = (const uint8_t *)(uintptr_t)d.addr;
+        for (uint32_t i = 0; i < d.len; i += 4) {
+            if (*(const uint32_t *)&buf[i] != (d.seq * 2654435761u ^ i)) {
+                printf("pop: seq %u torn at byte %u\n", d.seq, i);
+                errors++;
+                break;
+            }
+        }
+        expect++;
+
+        /* hold a few frames like a sender waiting for the network */
+        held++;
+        while (held > (xorshift(&rnd) % (HOLD_MAX + 1))) {
+            fring_release(&cons);
+            held--;
+        }
+        stall(&rnd);
+    }
+    while (held--) {
+        fring_release(&cons);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                total = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                printf("Usage: %s [-n descriptors]\n", argv[0]);
+                return 2;
+        }
+    }
+    /* PIE binaries and heaps live above 4 GB on x86-64, MAP_32BIT keeps the pool below */
+    pool = mmap(NULL, POOL * BUF_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (MAP_FAILED == pool || (uintptr_t)pool[POOL - 1] >> 32) {
+        printf("no pool below 4 GB, descriptors carry 32 bit addresses\n");
+        return 2;
+    }
+
+    fring_init_producer(&prod, &shm);
+    if (0 != fring_attach_consumer(&cons, &shm)) {
+        printf("attach failed\n");
+        return 1;
+    }
+
+    pthread_t tp, tc;
+    pthread_create(&tc, NULL, consumer, NULL);
+    pthread_create(&tp, NULL, producer, NULL);
+    pthread_join(tp, NULL);
+    pthread_join(tc, NULL);
+
+    printf("pushed %u, popped %u, reclaimed %u, ring full %u times, errors %u\n", prod.pushed, cons.popped,
+           prod.reclaimed, prod.full, errors);
+    if (!errors && (prod.pushed != total || cons.popped != total || prod.reclaimed != total)) {
+        printf("counts do not match %u\n", total);
+        errors++;
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,427 @@
+/*
+ * kv_check - kv_store.c on the file-backed flash of c906_app/flash_demo/tools,
+ * with the power cut at random points.
+ *
+ *   api        gets, sets, deletes and txns with the power on: values as
+ *              set, bad keys, values and txns refused with nothing
+ *              written, the same value set again not written, the key and
+ *              byte limits, a region of junk formatted
+ *   power      rounds of random sets, deletes, txns of up to 8 keys and
+ *              gcs until the power goes at a random erase or write (torn
+ *              halfway, nothing after it reaches the flash; some writes go
+ *              back half first), then a reboot:
+ *              the mount must work and find every key as the last commit
+ *              that returned with the power on left it, or with the commit
+ *              in flight applied whole, never half of one
+ *
+ * The power rounds run with 16, 3 and 2 sectors; the fewer, the more of
+ * the cuts land in a garbage collection.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -I../../../c906_app/flash_demo -I../../../c906_app/flash_demo/tools -o kv_check kv_check.c \
+ *       ../kv_store.c ../../../c906_app/flash_demo/flash_io.c ../../../c906_app/flash_demo/tools/flash_file.c
+ *   ./kv_check -n 2000
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "flash_file.h"
+#include "flash_io.h"
+#include "kv_store.h"
+
+#define KV_OFFSET (0x10000)
+#define MAX_SECTORS (16)
+#define FLASH_SIZE (KV_OFFSET + MAX_SECTORS * KV_SECTOR)
+#define MAX_KEYS (24)
+
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        checks++;                             \
+        if (!(cond)) {                        \
+            failed++;                         \
+            if (failed < 20) {                \
+                printf("FAIL: " __VA_ARGS__); \
+                printf("\n");                 \
+            }                                 \
+        }                                     \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static int port_read(void *arg, uint32_t offset, void *dst, uint32_t len)
+{
+    (void)arg;
+    return flash_port_read(offset, dst, len);
+}
+
+static int s_split;
+
+static int port_write(void *arg, uint32_t offset, const void *src, uint32_t len)
+{
+    uint32_t half = len / 2 & ~3u;
+
+    (void)arg;
+    /* now and then the back half first, so a cut leaves erased bytes with something after them */
+    if (s_split && half && 0 == xorshift(&seed) % 4) {
+        int ret = flash_port_write(offset + half, (const uint8_t *)src + half, len - half);
+        return ret ? ret : flash_port_write(offset, src, half);
+    }
+    return flash_port_write(offset, src, len);
+}
+
+static int port_erase(void *arg, uint32_t offset, uint32_t len)
+{
+    (void)arg;
+    return flash_port_erase(offset, len);
+}
+
+static const kv_flash_t s_port = {port_read, port_write, port_erase, NULL};
+static kv_t s_kv;
+
+static void erase_region(void)
+{
+    flash_port_erase(KV_OFFSET, MAX_SECTORS * KV_SECTOR);
+}
+
+static const char *key_name(uint32_t k)
+{
+    static char name[MAX_KEYS][16];
+
+    snprintf(name[k], sizeof(name[k]), "conf_%u", k);
+    return name[k];
+}
+
+static uint32_t s_max_val;
+
+/* version ver of key k: its length and bytes follow from both */
+static uint32_t value(uint8_t *buf, uint32_t k, uint32_t ver)
+{
+    uint32_t s = k * 7919 + ver * 104729 + 1;
+    uint32_t len = xorshift(&s) % (s_max_val + 1);
+
+    for (uint32_t i = 0; i < len; i++) {
+        buf[i] = xorshift(&s);
+    }
+    return len;
+}
+
+/* whether key k holds version ver (0 for no key) */
+static int holds(uint32_t k, uint32_t ver)
+{
+    static uint8_t got[KV_MAX_VAL], want[KV_MAX_VAL];
+    int n = kv_get(&s_kv, key_name(k), got, sizeof(got));
+
+    if (0 == ver) {
+        return KV_ERR_NOENT == n;
+    }
+    return n >= 0 && (uint32_t)n == value(want, k, ver) && 0 == memcmp(got, want, n);
+}
+
+static int count_keys(void *arg, const char *key, uint32_t key_len, uint32_t val_len)
+{
+    (void)key;
+    (void)key_len;
+    (void)val_len;
+    (*(uint32_t *)arg)++;
+    return 0;
+}
+
+static uint32_t keys_found(void)
+{
+    uint32_t n = 0;
+
+    kv_foreach(&s_kv, count_keys, &n);
+    return n;
+}
+
+static void api(void)
+{
+    static uint8_t buf[KV_MAX_VAL + 16], big[KV_MAX_VAL + 1];
+    uint32_t writes, cap, n;
+    char key[48];
+    int ret;
+
+    erase_region();
+    CHECK(0 == kv_mount(&s_kv, &s_port, KV_OFFSET, MAX_SECTORS), "api: mount on erased flash");
+    CHECK(KV_ERR_NOENT == kv_get(&s_kv, "ssid", buf, sizeof(buf)), "api: get on an empty store");
+    CHECK(KV_ERR_NOENT == kv_del(&s_kv, "ssid"), "api: del on an empty store");
+
+    CHECK(0 == kv_set(&s_kv, "ssid", "m1s-dock", 8), "api: set");
+    memset(buf, 0xa5, sizeof(buf));
+    CHECK(8 == kv_get(&s_kv, "ssid", buf, 3) && 0 == memcmp(buf, "m1s", 3) && 0xa5 == buf[3],
+          "api: get into a short buffer");
+    CHECK(0 == kv_set(&s_kv, "empty", NULL, 0) && 0 == kv_get(&s_kv, "empty", buf, sizeof(buf)), "api: empty value");
+
+    writes = flash_file.writes;
+    CHECK(0 == kv_set(&s_kv, "ssid", "m1s-dock", 8) && writes == flash_file.writes,
+          "api: the same value set again was written");
+    CHECK(0 == kv_set(&s_kv, "ssid", "m1s-dock2", 9) && writes + 1 == flash_file.writes, "api: a set is one write");
+
+    memset(key, 'k', sizeof(key));
+    key[KV_MAX_KEY + 1] = 0;
+    writes = flash_file.writes;
+    CHECK(KV_ERR_INVAL == kv_set(&s_kv, key, "x", 1), "api: key too long");
+    CHECK(KV_ERR_INVAL == kv_set(&s_kv, "", "x", 1), "api: empty key");
+    CHECK(KV_ERR_INVAL == kv_set(&s_kv, "big", big, sizeof(big)), "api: value too long");
+    key[KV_MAX_KEY] = 0;
+    CHECK(0 == kv_set(&s_kv, key, big, KV_MAX_VAL) && KV_MAX_VAL == kv_get(&s_kv, key, buf, sizeof(buf)),
+          "api: longest key and value");
+
+    /* txns: all or nothing, refused whole */
+    writes = flash_file.writes;
+    kv_txn_begin(&s_kv);
+    for (uint32_t k = 0; k <= KV_TXN_KEYS; k++) {
+        kv_txn_set(&s_kv, key_name(k), "v", 1);
+    }
+    CHECK(KV_ERR_INVAL == kv_txn_commit(&s_kv), "api: txn of too many keys");
+    kv_txn_begin(&s_kv);
+    for (uint32_t k = 0; k < 3; k++) {
+        kv_txn_set(&s_kv, key_name(k), big, 400);
+    }
+    CHECK(KV_ERR_INVAL == kv_txn_commit(&s_kv), "api: txn of too many bytes");
+    CHECK(writes == flash_file.writes && KV_ERR_NOENT == kv_get(&s_kv, key_name(0), buf, sizeof(buf)),
+          "api: a refused txn left something");
+    kv_txn_begin(&s_kv);
+    kv_txn_set(&s_kv, "ssid", "other", 5);
+    kv_txn_set(&s_kv, "psk", "secret", 6);
+    kv_txn_del(&s_kv, "empty");
+    kv_txn_set(&s_kv, "psk", "secret2", 7);
+    CHECK(0 == kv_txn_commit(&s_kv) && writes + 1 == flash_file.writes, "api: txn as one write");
+    CHECK(5 == kv_get(&s_kv, "ssid", buf, sizeof(buf)) && 7 == kv_get(&s_kv, "psk", buf, sizeof(buf)) &&
+              0 == memcmp(buf, "secret2", 7) && KV_ERR_NOENT == kv_get(&s_kv, "empty", buf, sizeof(buf)),
+          "api: txn applied out of order");
+
+    /* the same from flash */
+    CHECK(0 == kv_mount(&s_kv, &s_port, KV_OFFSET, MAX_SECTORS) && 3 == keys_found() &&
+              7 == kv_get(&s_kv, "psk", buf, sizeof(buf)) && 0 == memcmp(buf, "secret2", 7),
+          "api: remount");
+    CHECK(0 == kv_gc(&s_kv) && 0 == kv_mount(&s_kv, &s_port, KV_OFFSET, MAX_SECTORS) && 3 == keys_found(),
+          "api: keys lost by a gc");
+
+    /* as many keys as the index takes */
+    for (n = 0; n < KV_MAX_KEYS + 1; n++) {
+        snprintf(key, sizeof(key), "many%u", n);
+        if (0 != (ret = kv_set(&s_kv, key, "v", 1))) {
+            break;
+        }
+    }
+    CHECK(KV_MAX_KEYS == s_kv.keys && KV_ERR_FULL == ret, "api: %u keys, %d for one more", s_kv.keys, ret);
+    for (uint32_t i = 0; i < n; i++) {
+        snprintf(key, sizeof(key), "many%u", i);
+        kv_del(&s_kv, key);
+    }
+    CHECK(3 == keys_found(), "api: keys left after deleting");
+
+    /* as many bytes as it takes, then deletes make room again */
+    cap = kv_capacity(&s_kv);
+    for (n = 0;; n++) {
+        snprintf(key, sizeof(key), "full%u", n);
+        if (0 != (ret = kv_set(&s_kv, key, big, KV_MAX_VAL))) {
+            break;
+        }
+    }
+    CHECK(KV_ERR_FULL == ret && s_kv.live <= cap && s_kv.live + KV_MAX_VAL > cap - 2 * KV_MAX_VAL,
+          "api: full at %u of %u bytes, %d", s_kv.live, cap, ret);
+    CHECK(0 == kv_mount(&s_kv, &s_port, KV_OFFSET, MAX_SECTORS) && n + 3 == keys_found(), "api: remount when full");
+    for (uint32_t i = 0; i < n; i++) {
+        snprintf(key, sizeof(key), "full%u", i);
+        CHECK(0 == kv_del(&s_kv, key), "api: delete %s when full", key);
+    }
+    CHECK(0 == kv_set(&s_kv, "full", big, KV_MAX_VAL), "api: no room after deleting");
+    CHECK(0 == kv_mount(&s_kv, &s_port, KV_OFFSET, MAX_SECTORS) && 4 == keys_found(), "api: remount after deleting");
+
+    /* junk where the store goes is formatted over */
+    for (uint32_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = xorshift(&seed);
+    }
+    for (uint32_t s = 0; s < MAX_SECTORS; s++) {
+        flash_port_erase(KV_OFFSET + s * KV_SECTOR, KV_SECTOR);
+        flash_port_write(KV_OFFSET + s * KV_SECTOR + s * 16, buf, sizeof(buf));
+    }
+    CHECK(0 == kv_mount(&s_kv, &s_port, KV_OFFSET, MAX_SECTORS) && 0 == keys_found() &&
+              0 == kv_set(&s_kv, "ssid", "x", 1) && 0 == kv_mount(&s_kv, &s_port, KV_OFFSET, MAX_SECTORS) &&
+              1 == keys_found(),
+          "api: junk not formatted");
+    CHECK(KV_ERR_INVAL == kv_mount(&s_kv, &s_port, KV_OFFSET + 1, MAX_SECTORS) &&
+              KV_ERR_INVAL == kv_mount(&s_kv, &s_port, KV_OFFSET, 1),
+          "api: bad mount arguments");
+}
+
+/* versions each key may be in: durable, or the commit in flight applied */
+static uint32_t durable[MAX_KEYS], flight[MAX_KEYS];
+static uint8_t in_flight[MAX_KEYS];
+
+static void power_rounds(uint32_t sectors, uint32_t keys, uint32_t max_val, uint32_t rounds)
+{
+    static uint8_t buf[KV_MAX_VAL];
+    uint32_t next_ver = 1, ops = 0, torn = 0, whole = 0, gcs = 0, copied = 0, erases = 0, dropped = 0;
+    /* as many keys as fit a txn */
+    uint32_t txn_keys = KV_TXN_MAX / (12 + 8 + max_val + 3);
+
+    txn_keys = txn_keys < KV_TXN_KEYS ? txn_keys : KV_TXN_KEYS;
+    s_max_val = max_val;
+    s_split = 1;
+    erase_region();
+    memset(durable, 0, sizeof(durable));
+    CHECK(0 == kv_mount(&s_kv, &s_port, KV_OFFSET, sectors), "power: format");
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        uint32_t cuts = flash_file.cuts;
+        flash_file.cut_after = 1 + xorshift(&seed) % 200;
+
+        while (flash_file.cuts == cuts) {
+            uint32_t kind = xorshift(&seed) % 20;
+            uint32_t k = xorshift(&seed) % keys;
+            int ret;
+
+            memset(in_flight, 0, sizeof(in_flight));
+            if (kind < 9) {
+                in_flight[k] = 1;
+                flight[k] = next_ver++;
+                uint32_t len = value(buf, k, flight[k]);
+                ret = kv_set(&s_kv, key_name(k), buf, len);
+            } else if (kind < 12) {
+                if (0 == durable[k]) {
+                    CHECK(KV_ERR_NOENT == kv_del(&s_kv, key_name(k)), "power: deleted %s twice", key_name(k));
+                    continue;
+                }
+                in_flight[k] = 1;
+                flight[k] = 0;
+                ret = kv_del(&s_kv, key_name(k));
+            } else if (kind < 19) {
+                uint32_t n = 2 + xorshift(&seed) % (txn_keys - 1);
+                kv_txn_begin(&s_kv);
+                for (uint32_t i = 0; i < n; i++) {
+                    k = xorshift(&seed) % keys;
+                    in_flight[k] = 1;
+                    if (xorshift(&seed) % 4) {
+                        flight[k] = next_ver++;
+                        uint32_t len = value(buf, k, flight[k]);
+                        kv_txn_set(&s_kv, key_name(k), buf, len);
+                    } else {
+                        flight[k] = 0;
+                        kv_txn_del(&s_kv, key_name(k));
+                    }
+                }
+                ret = kv_txn_commit(&s_kv);
+            } else {
+                ret = kv_gc(&s_kv);
+            }
+            if (flash_file.cuts != cuts) {
+                torn++;
+                break;
+            }
+            CHECK(0 == ret, "power: %u sectors, round %u: op %u returned %d with the power on", sectors, round, kind,
+                  ret);
+            for (k = 0; k < keys; k++) {
+                durable[k] = in_flight[k] ? flight[k] : durable[k];
+            }
+            ops++;
+        }
+
+        /* reboot */
+        flash_file.cut_after = 0;
+        gcs += s_kv.gcs;
+        copied += s_kv.copied;
+        erases += s_kv.erases;
+        int ret = kv_mount(&s_kv, &s_port, KV_OFFSET, sectors);
+        CHECK(0 == ret, "power: %u sectors, round %u: mount after a power loss: %d", sectors, round, ret);
+        dropped += s_kv.dropped;
+
+        int before = 1, after = 1;
+        uint32_t present = 0;
+        for (uint32_t k = 0; k < keys; k++) {
+            before &= holds(k, durable[k]);
+            after &= holds(k, in_flight[k] ? flight[k] : durable[k]);
+        }
+        CHECK(before || after, "power: %u sectors, round %u: keys neither before nor after the commit in flight",
+              sectors, round);
+        if (after && !before) {
+            for (uint32_t k = 0; k < keys; k++) {
+                durable[k] = in_flight[k] ? flight[k] : durable[k];
+            }
+            whole++;
+        }
+        for (uint32_t k = 0; k < keys; k++) {
+            present += 0 != durable[k];
+        }
+        CHECK(keys_found() == present, "power: %u sectors, round %u: %u keys listed, %u expected", sectors, round,
+              keys_found(), present);
+    }
+    printf("power: %2u sectors, %2u keys, %u rounds, %u ops done, %u cut short (%u landed anyway), "
+           "%u gcs, %u copies, %u erases, %u records dropped on mount\n",
+           sectors, keys, rounds, ops, torn, whole, gcs, copied, erases, dropped);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-o flash.bin] [-n rounds] [-s seed] [-k]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        uint32_t sectors, keys, max_val;
+    } mixes[] = {
+        {MAX_SECTORS, MAX_KEYS, 200},
+        {3, 12, 100},
+        {2, 4, 80},
+    };
+    const char *path = "/tmp/kv_check.bin";
+    uint32_t rounds = 2000;
+    int keep = 0, opt;
+
+    while ((opt = getopt(argc, argv, "o:n:s:kh")) != -1) {
+        switch (opt) {
+            case 'o':
+                path = optarg;
+                break;
+            case 'n':
+                rounds = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                keep = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        usage(argv[0]);
+        return 2;
+    }
+    unlink(path);
+    if (0 != flash_file_open(path, FLASH_SIZE)) {
+        return 1;
+    }
+
+    api();
+    for (uint32_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+        power_rounds(mixes[m].sectors, mixes[m].keys, mixes[m].max_val, rounds);
+    }
+
+    flash_file_close();
+    if (!keep) {
+        unlink(path);
+    }
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,493 @@
+/*
+ * mjpeg_http_load - mjpeg_http.c under many clients on localhost.
+ *
+ * One thread is the board's mjpeg_http task: it polls the sockets and
+ * publishes a frame every tick, -f per second, of random size with SOI/EOI
+ * and a body derived from its sequence number. -c client threads stream
+ * /stream as fast as they can and parse it the way a browser does, one
+ * more reads it through a 4 KB receive buffer, 1 KB every 20 ms, far below
+ * the stream rate. The server's sockets get a send buffer the size of
+ * lwIP's, so the slow client backs up into mjpeg_http and not the kernel.
+ * Each client checks every part it gets:
+ *
+ *   parts      boundary, Content-Type, Content-Length and X-Frame-Seq
+ *              present, the body the length says, then CRLF
+ *   frames     every body is the frame its seq says, seq only goes up
+ *   fast       the fast clients miss at most one frame in 20
+ *   slow       the slow client gets intact frames too, skips some, and the
+ *              server counts them as its drops, not the others'
+ *   camera     no publish takes longer than a tick, the slow client never
+ *              holds back the camera
+ *   other      /snapshot is one whole frame, an unknown path is a 404,
+ *              and after mjpeg_http_stop() no frame is left allocated
+ *
+ * Build and run on Linux (more slots than the board's lwIP allows):
+ *   cc -O2 -pthread -I.. -DMJPEG_HTTP_MAX_CLIENTS=32 -o mjpeg_http_load mjpeg_http_load.c ../mjpeg_http.c
+ *   ./mjpeg_http_load -c 20 -t 5
+ *
+ * Exit status is 1 if any check fails.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mjpeg_http.h"
+
+#define MAX_FRAME (40 * 1024)
+#define SEND_BUF (16 * 1024) /* per client on the server, the order of lwIP's TCP_SND_BUF */
+#define MAX_SEQ (1 << 16) /* frame lengths remembered, more than any run publishes */
+
+static uint32_t clients = 8, fps = 30, seconds = 3;
+static uint32_t seed = 1;
+static uint32_t checks, failed;
+static pthread_mutex_t s_check_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the clients' threads check too; cond is evaluated before taking the lock, it may take the server's */
+#define CHECK(cond, ...)                          \
+    do {                                          \
+        int ok_ = !!(cond);                       \
+        pthread_mutex_lock(&s_check_lock);        \
+        checks++;                                 \
+        if (!ok_) {                               \
+            failed++;                             \
+            if (failed < 20) {                    \
+                printf("FAIL: " __VA_ARGS__);     \
+                printf("\n");                     \
+            }                                     \
+        }                                         \
+        pthread_mutex_unlock(&s_check_lock);      \
+    } while (0)
+
+static inline uint32_t xorshift(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static mjpeg_http_t s_srv;
+static uint16_t s_port;
+static volatile int s_running = 1, s_clients_run = 1;
+static volatile uint32_t s_published;
+static uint32_t s_len[MAX_SEQ];
+static uint32_t s_max_publish_us;
+
+static inline uint8_t pattern(uint32_t seq, uint32_t i)
+{
+    return (uint8_t)((seq * 2654435761u) >> 24 ^ i ^ i >> 8);
+}
+
+/* SOI, the seq's pattern, EOI */
+static void make_frame(uint8_t *f, uint32_t seq, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        f[i] = pattern(seq, i);
+    }
+    f[0] = 0xff;
+    f[1] = 0xd8;
+    f[len - 2] = 0xff;
+    f[len - 1] = 0xd9;
+}
+
+static int frame_ok(const uint8_t *f, uint32_t seq, uint32_t len)
+{
+    if (seq >= MAX_SEQ || len != s_len[seq] || f[0] != 0xff || f[1] != 0xd8 || f[len - 2] != 0xff ||
+        f[len - 1] != 0xd9) {
+        return 0;
+    }
+    for (uint32_t i = 2; i < len - 2; i++) {
+        if (f[i] != pattern(seq, i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* the board's mjpeg_http task: poll until the tick, publish, again */
+static void *server(void *arg)
+{
+    static uint8_t frame[MAX_FRAME];
+    uint32_t s = seed, period_us = 1000000 / fps;
+    uint64_t next = now_us();
+
+    (void)arg;
+    while (s_running) {
+        int64_t wait = (int64_t)(next - now_us());
+        if (wait > 0) {
+            CHECK(mjpeg_http_poll(&s_srv, (uint32_t)(wait + 999) / 1000) >= 0, "poll: listen socket failed");
+            continue;
+        }
+        uint32_t seq = s_published, len = 64 + xorshift(&s) % (MAX_FRAME - 64);
+        if (seq >= MAX_SEQ) {
+            break;
+        }
+        s_len[seq] = len;
+        make_frame(frame, seq, len);
+
+        uint64_t t0 = now_us();
+        CHECK(mjpeg_http_publish(&s_srv, frame, len) >= 0, "publish %u: no memory", seq);
+        uint32_t us = (uint32_t)(now_us() - t0);
+        s_max_publish_us = us > s_max_publish_us ? us : s_max_publish_us;
+        __atomic_store_n(&s_published, seq + 1, __ATOMIC_RELEASE);
+        next += period_us;
+    }
+    return NULL;
+}
+
+/* a buffered reader on a client socket */
+typedef struct {
+    int sock;
+    uint8_t buf[8192];
+    uint32_t pos, fill;
+} reader_t;
+
+static int rd_byte(reader_t *r)
+{
+    if (r->pos == r->fill) {
+        ssize_t n = recv(r->sock, r->buf, sizeof(r->buf), 0);
+        if (n <= 0) {
+            return -1;
+        }
+        r->pos = 0;
+        r->fill = (uint32_t)n;
+    }
+    return r->buf[r->pos++];
+}
+
+static int rd_exact(reader_t *r, uint8_t *out, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        int c = rd_byte(r);
+        if (c < 0) {
+            return -1;
+        }
+        out[i] = (uint8_t)c;
+    }
+    return 0;
+}
+
+/* one header line without its CRLF, -1 at end of stream or a bare LF */
+static int rd_line(reader_t *r, char *line, uint32_t size)
+{
+    uint32_t n = 0;
+    int c;
+
+    while ((c = rd_byte(r)) >= 0) {
+        if ('\n' == c) {
+            if (0 == n || '\r' != line[n - 1]) {
+                return -1;
+            }
+            line[n - 1] = '\0';
+            return (int)(n - 1);
+        }
+        if (n + 1 < size) {
+            line[n++] = (char)c;
+        }
+    }
+    return -1;
+}
+
+static int connect_get(const char *path, int rcvbuf)
+{
+    struct sockaddr_in addr;
+    char req[128];
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (sock < 0) {
+        return -1;
+    }
+    if (rcvbuf) {
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(s_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int len = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n", path);
+    if (0 != connect(sock, (struct sockaddr *)&addr, sizeof(addr)) || len != send(sock, req, len, 0)) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/* status code of the response, headers read up to the blank line; Content-Length into *length */
+static int rd_response(reader_t *r, uint32_t *length, char *type, uint32_t type_size)
+{
+    char line[256];
+    int status = -1;
+
+    if (rd_line(r, line, sizeof(line)) < 0 || 1 != sscanf(line, "HTTP/1.1 %d", &status)) {
+        return -1;
+    }
+    while (rd_line(r, line, sizeof(line)) > 0) {
+        unsigned long v;
+        if (length && 1 == sscanf(line, "Content-Length: %lu", &v)) {
+            *length = (uint32_t)v;
+        } else if (type && 0 == strncmp(line, "Content-Type: ", 14)) {
+            /* cut to fit: the values the callers expect are far shorter */
+            snprintf(type, type_size, "%.*s", (int)type_size - 1, line + 14);
+        }
+    }
+    return status;
+}
+
+typedef struct {
+    int id;
+    int slow;
+    pthread_t tid;
+    uint16_t port; /* ours, the server knows us by it */
+
+    /* results */
+    uint32_t parts, bad_parts, bad_frames, backwards, skipped;
+} client_t;
+
+static void *client(void *arg)
+{
+    client_t *c = arg;
+    static __thread uint8_t body[MAX_FRAME];
+    static __thread reader_t r;
+    char line[256], type[128] = "";
+    int expect = -1;
+
+    r.pos = r.fill = 0;
+    r.sock = connect_get("/stream", c->slow ? 4096 : 0);
+    CHECK(r.sock >= 0, "client %d: connect failed", c->id);
+    if (r.sock < 0) {
+        return NULL;
+    }
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    getsockname(r.sock, (struct sockaddr *)&addr, &addr_len);
+    c->port = ntohs(addr.sin_port);
+    int status = rd_response(&r, NULL, type, sizeof(type));
+    CHECK(200 == status && 0 == strcmp(type, "multipart/x-mixed-replace; boundary=m1sframe"),
+          "client %d: status %d, %s", c->id, status, type);
+
+    while (s_clients_run) {
+        uint32_t len = 0, seq = 0;
+        int has_len = 0, has_seq = 0, jpeg = 0;
+
+        if (rd_line(&r, line, sizeof(line)) < 0) {
+            break;
+        }
+        if (0 != strcmp(line, "--m1sframe")) {
+            c->bad_parts++;
+            break;
+        }
+        while (rd_line(&r, line, sizeof(line)) > 0) {
+            unsigned long v;
+            if (1 == sscanf(line, "Content-Length: %lu", &v)) {
+                len = (uint32_t)v;
+                has_len = 1;
+            } else if (1 == sscanf(line, "X-Frame-Seq: %lu", &v)) {
+                seq = (uint32_t)v;
+                has_seq = 1;
+            } else if (0 == strcmp(line, "Content-Type: image/jpeg")) {
+                jpeg = 1;
+            }
+        }
+        if (!has_len || !has_seq || !jpeg || len > MAX_FRAME || len < 4 || 0 != rd_exact(&r, body, len) ||
+            0 != rd_exact(&r, (uint8_t *)line, 2) || '\r' != line[0] || '\n' != line[1]) {
+            c->bad_parts++;
+            break;
+        }
+
+        c->parts++;
+        c->bad_frames += !frame_ok(body, seq, len);
+        if (expect >= 0 && seq < (uint32_t)expect) {
+            c->backwards++;
+        } else if (expect >= 0) {
+            c->skipped += seq - expect;
+        }
+        expect = seq + 1;
+
+        if (c->slow) {
+            /* reading 1 KB every 20 ms with what's buffered, the part spread over many sleeps */
+            for (uint32_t done = 0; done < len && s_clients_run; done += 1024) {
+                usleep(20000);
+            }
+        }
+    }
+    close(r.sock);
+    return NULL;
+}
+
+static void check_oneshots(void)
+{
+    static uint8_t body[MAX_FRAME];
+    reader_t *r = calloc(1, sizeof(reader_t));
+    uint32_t len = 0;
+    char type[128] = "";
+
+    r->sock = connect_get("/snapshot", 0);
+    int status = rd_response(r, &len, type, sizeof(type));
+    CHECK(200 == status && 0 == strcmp(type, "image/jpeg") && len >= 4 && len <= MAX_FRAME,
+          "snapshot: status %d, %s, %u bytes", status, type, len);
+    if (200 == status && len >= 4 && len <= MAX_FRAME) {
+        int got = 0 == rd_exact(r, body, len);
+        /* whichever frame was latest; its seq isn't in the header, find it by length and contents */
+        uint32_t published = __atomic_load_n(&s_published, __ATOMIC_ACQUIRE), seq = published;
+        for (uint32_t i = published; got && i-- > 0 && seq == published;) {
+            if (s_len[i] == len && frame_ok(body, i, len)) {
+                seq = i;
+            }
+        }
+        CHECK(got && seq < published, "snapshot: %u bytes that are no published frame", len);
+        CHECK(rd_byte(r) < 0, "snapshot: connection not closed after the frame");
+    }
+    close(r->sock);
+
+    memset(r, 0, sizeof(*r));
+    r->sock = connect_get("/nope", 0);
+    status = rd_response(r, NULL, NULL, 0);
+    CHECK(404 == status, "unknown path: status %d", status);
+    close(r->sock);
+    free(r);
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-c clients] [-f fps] [-t seconds] [-s seed]\n", prog);
+    printf("\tclients + 2 must fit MJPEG_HTTP_MAX_CLIENTS, %u in this build\n", MJPEG_HTTP_MAX_CLIENTS);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:f:t:s:h")) != -1) {
+        switch (opt) {
+            case 'c':
+                clients = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                fps = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                seconds = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (0 == seed) {
+        printf("seed must be > 0\n");
+        return 2;
+    }
+    if (0 == fps || fps > 1000 || 0 == seconds || clients + 2 > MJPEG_HTTP_MAX_CLIENTS || fps * seconds >= MAX_SEQ) {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    /* port 0 is any free one, then ask which */
+    if (0 != mjpeg_http_start(&s_srv, 0)) {
+        return 1;
+    }
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    getsockname(s_srv.listen_sock, (struct sockaddr *)&addr, &addr_len);
+    s_port = ntohs(addr.sin_port);
+    /*
+     * Linux grows a socket's send buffer to megabytes, which would take a whole
+     * run of the slow client's frames; lwIP's is a few TCP_MSS. Accepted sockets
+     * inherit the listening socket's.
+     */
+    int sndbuf = SEND_BUF;
+    setsockopt(s_srv.listen_sock, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    pthread_t st;
+    pthread_create(&st, NULL, server, NULL);
+    while (0 == __atomic_load_n(&s_published, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+
+    client_t *cl = calloc(clients + 1, sizeof(client_t));
+    for (uint32_t i = 0; i <= clients; i++) {
+        cl[i].id = (int)i;
+        cl[i].slow = i == clients;
+        pthread_create(&cl[i].tid, NULL, client, &cl[i]);
+    }
+    usleep(seconds * 500000);
+    check_oneshots();
+    usleep(seconds * 500000);
+
+    /* the server's view of every client before they go */
+    uint32_t seen = 0;
+    pthread_mutex_lock(&s_srv.lock);
+    for (int i = 0; i < MJPEG_HTTP_MAX_CLIENTS; i++) {
+        mh_client_t *m = &s_srv.clients[i];
+        for (uint32_t j = 0; MH_STREAM == m->state && j <= clients; j++) {
+            if (cl[j].port != m->port) {
+                continue;
+            }
+            seen++;
+            if (cl[j].slow) {
+                CHECK(m->dropped > 0, "server: slow client sent %u frames, dropped none", m->frames);
+            } else {
+                CHECK(m->dropped * 20 <= m->frames, "server: client %u sent %u frames, dropped %u", j, m->frames,
+                      m->dropped);
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_srv.lock);
+    CHECK(seen == clients + 1, "server: streaming to %u of %u clients", seen, clients + 1);
+
+    /* fast clients are blocked in recv on the next part, the slow one wakes from its sleep */
+    s_clients_run = 0;
+    for (uint32_t i = 0; i <= clients; i++) {
+        pthread_join(cl[i].tid, NULL);
+    }
+    s_running = 0;
+    pthread_join(st, NULL);
+    uint32_t published = s_published;
+
+    uint32_t fast_parts = 0, fast_skipped = 0;
+    for (uint32_t i = 0; i <= clients; i++) {
+        client_t *c = &cl[i];
+        CHECK(0 == c->bad_parts, "client %d: malformed part after %u good ones", c->id, c->parts);
+        CHECK(0 == c->bad_frames, "client %d: %u of %u frames not what their seq says", c->id, c->bad_frames,
+              c->parts);
+        CHECK(0 == c->backwards, "client %d: seq went backwards %u times", c->id, c->backwards);
+        if (c->slow) {
+            CHECK(c->parts > 0 && c->skipped > 0, "slow client: %u frames, %u skipped", c->parts, c->skipped);
+        } else {
+            fast_parts += c->parts;
+            fast_skipped += c->skipped;
+            CHECK(c->skipped * 20 <= c->parts, "client %d: %u frames, %u skipped", c->id, c->parts, c->skipped);
+        }
+    }
+    CHECK(s_max_publish_us < 1000000 / fps, "publish took up to %u us, a tick is %u", s_max_publish_us, 1000000 / fps);
+
+    printf("%u frames published, %u fast clients got %u (%u skipped), slow client got %u (%u skipped), "
+           "publish up to %u us\n",
+           published, clients, fast_parts, fast_skipped, cl[clients].parts, cl[clients].skipped, s_max_publish_us);
+    mjpeg_http_dump(&s_srv);
+    mjpeg_http_stop(&s_srv);
+    CHECK(0 == s_srv.frames_alive, "%u frames still allocated after stop", s_srv.frames_alive);
+
+    free(cl);
+    printf("%u checks, %u failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
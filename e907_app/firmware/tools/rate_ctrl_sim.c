@@ -0,0 +1,305 @@
+/*
+ * rate_ctrl_sim - runs rate_ctrl.c against a bandwidth trace.
+ *
+ * A camera produces frames at a fixed rate, their size set by the quality
+ * level plus some scene noise. They go into a FIFO drained at the trace's
+ * bandwidth, a stand-in for the TCP send buffer and the WiFi link. Frame
+ * latency is capture to last byte delivered. Three runs over the same trace:
+ *
+ *   send all   every frame at the top level, what upload_stream does today
+ *   skip only  rc_admit() skips frames, quality fixed at the top level
+ *   rate_ctrl  skipping plus quality steps
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -o rate_ctrl_sim rate_ctrl_sim.c ../rate_ctrl.c -lm
+ *   ./rate_ctrl_sim                 built-in trace
+ *   ./rate_ctrl_sim -t trace.txt -o lat.csv
+ *
+ * A trace file has "<time_ms> <kbit/s>" lines, each rate holding until the
+ * next line. The CSV has one line per frame for plotting, e.g. gnuplot:
+ *   plot 'lat.csv' using 3:4 with lines title 'send all', '' using 5:6 with lines title 'rate_ctrl'
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rate_ctrl.h"
+
+#define MAX_TRACE (1024)
+#define MAX_QUEUE (4096)
+#define MAX_SECONDS (600)
+
+enum { RUN_ALL = 0, RUN_SKIP, RUN_RC, RUN_COUNT };
+static const char *run_name[RUN_COUNT] = {"send all", "skip only", "rate_ctrl"};
+
+/* 320x240 q50, 640x480 q50, 640x480 q75, 1280x720 q60 */
+static const uint32_t level_bytes[] = {7000, 18000, 28000, 45000};
+#define LEVELS (sizeof(level_bytes) / sizeof(level_bytes[0]))
+
+static uint32_t trace_ms[MAX_TRACE], trace_kbps[MAX_TRACE], trace_len;
+
+static const uint32_t builtin_trace[][2] = {
+    {0, 12000}, {10000, 5000}, {20000, 2000}, {26000, 800}, {32000, 6000}, {45000, 15000}, {60000, 0},
+};
+
+typedef struct {
+    uint32_t capture_ms;
+    uint32_t left;
+} q_frame_t;
+
+typedef struct {
+    uint32_t lat_ms[MAX_SECONDS];  /* worst latency delivered in each second */
+    uint8_t level[MAX_SECONDS];
+    uint32_t frames[MAX_SECONDS];
+    uint32_t *lat;                 /* every delivered frame */
+    uint32_t *lat_t;
+    uint32_t delivered;
+    uint32_t skipped;
+    uint64_t level_sum;
+    uint32_t offered;
+    uint32_t steps;
+} run_result_t;
+
+static uint32_t kbps_at(uint32_t t)
+{
+    uint32_t kbps = trace_kbps[0];
+    for (uint32_t i = 0; i < trace_len && trace_ms[i] <= t; i++) {
+        kbps = trace_kbps[i];
+    }
+    return kbps;
+}
+
+static int load_trace(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (NULL == fp) {
+        return -1;
+    }
+    char line[128];
+    trace_len = 0;
+    while (fgets(line, sizeof(line), fp) && trace_len < MAX_TRACE) {
+        if (2 == sscanf(line, "%u %u", &trace_ms[trace_len], &trace_kbps[trace_len])) {
+            trace_len++;
+        }
+    }
+    fclose(fp);
+    return trace_len >= 2 ? 0 : -1;
+}
+
+static void simulate(int mode, uint32_t duration_ms, const rc_cfg_t *cfg, unsigned seed, run_result_t *r)
+{
+    static q_frame_t q[MAX_QUEUE];
+    uint32_t q_head = 0, q_tail = 0, backlog = 0;
+    uint64_t delivered = 0;
+    double credit = 0;
+    uint32_t period_ms = 1000 / cfg->fps, next_capture = 0;
+    rc_t rc;
+
+    srand(seed);
+    rc_init(&rc, cfg, 0);
+    if (RUN_RC != mode) {
+        rc.level = LEVELS - 1;
+    }
+
+    for (uint32_t t = 0; t < duration_ms; t++) {
+        /* link drains the FIFO */
+        credit += kbps_at(t) / 8.0;
+        while (q_head != q_tail && credit >= 1) {
+            q_frame_t *f = &q[q_head % MAX_QUEUE];
+            uint32_t n = f->left < credit ? f->left : (uint32_t)credit;
+            f->left -= n;
+            credit -= n;
+            backlog -= n;
+            delivered += n;
+            if (0 == f->left) {
+                uint32_t lat = t - f->capture_ms;
+                uint32_t sec = t / 1000;
+                if (lat > r->lat_ms[sec]) {
+                    r->lat_ms[sec] = lat;
+                }
+                r->frames[sec]++;
+                r->lat[r->delivered] = lat;
+                r->lat_t[r->delivered] = t;
+                r->delivered++;
+                q_head++;
+            }
+        }
+        if (q_head == q_tail) {
+            credit = 0; /* an idle link can't bank bandwidth */
+        }
+
+        if (t != next_capture) {
+            continue;
+        }
+        next_capture += period_ms;
+
+        uint8_t level = rc_level(&rc);
+        double noise = 0.8 + 0.4 * rand() / RAND_MAX;
+        uint32_t bytes = level_bytes[level] * noise;
+        int send = 1;
+
+        rc_sample(&rc, t, delivered, backlog);
+        if (RUN_ALL != mode) {
+            send = rc_admit(&rc, t, bytes, backlog);
+            if (RUN_SKIP == mode) {
+                rc.level = LEVELS - 1;
+            }
+        }
+        r->offered++;
+        r->level[t / 1000] = level;
+        r->level_sum += level;
+        if (!send || q_tail - q_head >= MAX_QUEUE) {
+            r->skipped++;
+            continue;
+        }
+        q[q_tail % MAX_QUEUE] = (q_frame_t){.capture_ms = t, .left = bytes};
+        q_tail++;
+        backlog += bytes;
+    }
+    r->steps = RUN_RC == mode ? rc.steps_down + rc.steps_up : 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* log scale, 10 characters per decade from 10 ms */
+static void bar(char *out, uint32_t ms)
+{
+    int n = ms > 10 ? (int)(10 * log10(ms / 10.0)) : 0;
+    n = n > 40 ? 40 : n;
+    memset(out, '#', n);
+    out[n] = '\0';
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-t trace.txt] [-o out.csv] [-l target_ms] [-f fps] [-s seed]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL, *csv_path = NULL;
+    rc_cfg_t cfg;
+    unsigned seed = 1;
+    int opt;
+
+    rc_default_cfg(&cfg);
+    cfg.levels = LEVELS;
+    cfg.start_level = 1;
+    memcpy(cfg.level_bytes, level_bytes, sizeof(level_bytes));
+
+    while ((opt = getopt(argc, argv, "t:o:l:f:s:h")) != -1) {
+        switch (opt) {
+            case 't':
+                trace_path = optarg;
+                break;
+            case 'o':
+                csv_path = optarg;
+                break;
+            case 'l':
+                cfg.target_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                cfg.fps = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (0 == cfg.fps || cfg.fps > 1000) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (trace_path) {
+        if (0 != load_trace(trace_path)) {
+            printf("bad trace %s\n", trace_path);
+            return 2;
+        }
+    } else {
+        trace_len = sizeof(builtin_trace) / sizeof(builtin_trace[0]);
+        for (uint32_t i = 0; i < trace_len; i++) {
+            trace_ms[i] = builtin_trace[i][0];
+            trace_kbps[i] = builtin_trace[i][1];
+        }
+    }
+    uint32_t duration_ms = trace_ms[trace_len - 1];
+    if (duration_ms > MAX_SECONDS * 1000) {
+        duration_ms = MAX_SECONDS * 1000;
+    }
+
+    static run_result_t res[RUN_COUNT];
+    uint32_t max_frames = duration_ms / (1000 / cfg.fps) + 1;
+    for (int m = 0; m < RUN_COUNT; m++) {
+        res[m].lat = calloc(max_frames, sizeof(uint32_t));
+        res[m].lat_t = calloc(max_frames, sizeof(uint32_t));
+        simulate(m, duration_ms, &cfg, seed, &res[m]);
+    }
+
+    printf("target %u ms, %u fps, %u s trace, latency per second (log scale, # = x1.26 from 10 ms)\n\n",
+           cfg.target_ms, cfg.fps, duration_ms / 1000);
+    printf("  t  kbit/s | %-48s | %-48s\n", "send all, worst ms", "rate_ctrl level, worst ms");
+    for (uint32_t s = 0; s < duration_ms / 1000; s++) {
+        char b0[48], b2[48];
+        bar(b0, res[RUN_ALL].lat_ms[s]);
+        bar(b2, res[RUN_RC].lat_ms[s]);
+        printf("%3u %7u | %6u %-41s | L%u %5u %-39s\n", s, kbps_at(s * 1000), res[RUN_ALL].lat_ms[s], b0,
+               res[RUN_RC].level[s], res[RUN_RC].lat_ms[s], b2);
+    }
+
+    printf("\n%-10s %9s %9s %9s %9s %9s %9s %6s\n", "run", "fps", "skipped", "avg ms", "p95 ms", "max ms",
+           "avg level", "steps");
+    for (int m = 0; m < RUN_COUNT; m++) {
+        run_result_t *r = &res[m];
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < r->delivered; i++) {
+            sum += r->lat[i];
+        }
+        uint32_t *sorted = malloc((r->delivered + 1) * sizeof(uint32_t));
+        memcpy(sorted, r->lat, r->delivered * sizeof(uint32_t));
+        qsort(sorted, r->delivered, sizeof(uint32_t), cmp_u32);
+        uint32_t n = r->delivered;
+        printf("%-10s %9.1f %9u %9llu %9u %9u %9.2f %6u\n", run_name[m], n * 1000.0 / duration_ms, r->skipped,
+               (unsigned long long)(n ? sum / n : 0), n ? sorted[n * 95 / 100] : 0, n ? sorted[n - 1] : 0,
+               r->offered ? (double)r->level_sum / r->offered : 0, r->steps);
+        free(sorted);
+    }
+
+    if (csv_path) {
+        FILE *fp = fopen(csv_path, "w");
+        if (NULL == fp) {
+            perror(csv_path);
+            return 2;
+        }
+        /* frames delivered in each run differ, so every run gets its own time column */
+        fprintf(fp, "t_ms,kbps,all_t_ms,all_lat_ms,rc_t_ms,rc_lat_ms\n");
+        uint32_t n = res[RUN_ALL].delivered > res[RUN_RC].delivered ? res[RUN_ALL].delivered : res[RUN_RC].delivered;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t t = i * 1000 / cfg.fps;
+            fprintf(fp, "%u,%u,", t, kbps_at(t));
+            if (i < res[RUN_ALL].delivered) {
+                fprintf(fp, "%u,%u,", res[RUN_ALL].lat_t[i], res[RUN_ALL].lat[i]);
+            } else {
+                fprintf(fp, ",,");
+            }
+            if (i < res[RUN_RC].delivered) {
+                fprintf(fp, "%u,%u\n", res[RUN_RC].lat_t[i], res[RUN_RC].lat[i]);
+            } else {
+                fprintf(fp, ",\n");
+            }
+        }
+        fclose(fp);
+        printf("\nper frame latency written to %s\n", csv_path);
+    }
+    return 0;
+}
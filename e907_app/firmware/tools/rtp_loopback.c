@@ -0,0 +1,230 @@
+/*
+ * rtp_loopback - RTP/JPEG packetizer and receiver round trip on localhost.
+ *
+ * Frames go through rtp_jpeg_send_frame() into a UDP socket on 127.0.0.1,
+ * a second socket feeds rtp_jpeg_rx_push(), and every completed frame is
+ * checked against the scan data that was sent. Packets can be dropped on
+ * the send side to see how many frames still complete: with a loss rate p
+ * and k packets per frame only about (1 - p)^k of the frames survive, which
+ * is what the MTU and the JPEG quality have to be traded against.
+ *
+ * Build and run on Linux:
+ *   cc -O2 -I.. -o rtp_loopback rtp_loopback.c ../rtp_jpeg.c
+ *   ./rtp_loopback -n 300 -l 1
+ *   ./rtp_loopback -f capture.mjpeg -l 2 -m 1200
+ *
+ * Without -f synthetic 640x480 4:2:0 frames are used.
+ * Exit status is 1 if a completed frame differs from the one sent.
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "rtp_jpeg.h"
+
+#define MAX_FRAME (512 * 1024)
+
+typedef struct {
+    int sock;
+    struct sockaddr_in to;
+    double loss; /* 0..1 */
+    uint32_t sent;
+    uint32_t dropped;
+} tx_ctx_t;
+
+static int udp_send(void *arg, const uint8_t *pkt, uint32_t len)
+{
+    tx_ctx_t *ctx = arg;
+    if (ctx->loss > 0 && rand() < ctx->loss * ((double)RAND_MAX + 1)) {
+        ctx->dropped++;
+        return 0;
+    }
+    if (sendto(ctx->sock, pkt, len, 0, (struct sockaddr *)&ctx->to, sizeof(ctx->to)) < 0) {
+        perror("sendto");
+        return -1;
+    }
+    ctx->sent++;
+    return 0;
+}
+
+/* standard luminance/chrominance tables at quality 50, zigzag order */
+static const uint8_t synth_qt[2][64] = {
+    {16, 11, 12, 14, 12, 10, 16, 14, 13, 14, 18, 17, 16, 19, 24, 40, 26, 24, 22, 22, 24, 49,
+     35, 37, 29, 40, 58, 51, 61, 60, 57, 51, 56, 55, 64, 72, 92, 78, 64, 68, 87, 69, 55, 56,
+     80, 109, 81, 87, 95, 98, 103, 104, 103, 62, 77, 113, 121, 112, 100, 120, 92, 101, 103, 99},
+    {17, 18, 18, 24, 21, 24, 47, 26, 26, 47, 99, 66, 56, 66, 99, 99, 99, 99, 99, 99, 99, 99,
+     99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+     99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99},
+};
+
+/* headers as a receiver rebuilds them plus random stuffed entropy data */
+static uint32_t synth_frame(uint8_t *out, uint32_t size, uint32_t n)
+{
+    uint32_t len = rtp_jpeg_make_headers(out, size, 1, 640, 480, synth_qt, 0);
+    uint32_t scan = 20000 + (n * 7919) % 30000;
+    for (uint32_t i = 0; i < scan && len + 4 < size; i++) {
+        uint8_t b = rand();
+        out[len++] = b;
+        if (0xff == b) {
+            out[len++] = 0x00;
+        }
+    }
+    out[len++] = 0xff;
+    out[len++] = 0xd9;
+    return len;
+}
+
+/* next SOI..EOI frame of a concatenated MJPEG file, rewinding once at EOF */
+static uint32_t file_frame(FILE *fp, uint8_t *out, uint32_t size)
+{
+    for (int pass = 0; pass < 2; pass++) {
+        int prev = -1, c, in_frame = 0;
+        uint32_t len = 0;
+        while (EOF != (c = fgetc(fp))) {
+            if (!in_frame) {
+                if (0xff == prev && 0xd8 == c) {
+                    in_frame = 1;
+                    out[0] = 0xff;
+                    out[1] = 0xd8;
+                    len = 2;
+                }
+            } else if (len < size) {
+                out[len++] = c;
+                if (0xff == prev && 0xd9 == c) {
+                    return len;
+                }
+            }
+            prev = c;
+        }
+        rewind(fp);
+    }
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-f file.mjpeg] [-n frames] [-l loss%%] [-m mtu] [-p port] [-s seed]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    uint32_t frames = 300, mtu = RTP_JPEG_DEFAULT_MTU;
+    uint16_t port = 5004;
+    double loss_pct = 0;
+    unsigned seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:n:l:m:p:s:h")) != -1) {
+        switch (opt) {
+            case 'f':
+                path = optarg;
+                break;
+            case 'n':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                loss_pct = atof(optarg);
+                break;
+            case 'm':
+                mtu = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                port = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    srand(seed);
+
+    FILE *fp = NULL;
+    if (path && NULL == (fp = fopen(path, "rb"))) {
+        perror(path);
+        return 2;
+    }
+
+    int rx_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(rx_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (rx_sock < 0 || 0 != bind(rx_sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        perror("bind");
+        return 2;
+    }
+    tx_ctx_t ctx = {.sock = socket(AF_INET, SOCK_DGRAM, 0), .to = addr, .loss = loss_pct / 100};
+
+    static uint8_t frame[MAX_FRAME], rx_buf[MAX_FRAME + 1024], pkt[2048];
+    static rtp_jpeg_tx_t tx;
+    rtp_jpeg_rx_t rx;
+    if (mtu > 0xffff || 0 != rtp_jpeg_tx_init(&tx, 0x4d31730a, mtu)) {
+        printf("mtu must be %u or more\n", RTP_JPEG_MIN_MTU);
+        return 2;
+    }
+    rtp_jpeg_rx_init(&rx, rx_buf, sizeof(rx_buf));
+
+    char sdp[256];
+    rtp_jpeg_sdp(sdp, sizeof(sdp), "127.0.0.1", port);
+    printf("%s\n", sdp);
+
+    uint32_t skipped = 0, mismatch = 0, verified = 0;
+    for (uint32_t n = 0; n < frames; n++) {
+        uint32_t len = fp ? file_frame(fp, frame, sizeof(frame)) : synth_frame(frame, sizeof(frame), n);
+        rtp_jpeg_info_t info;
+        if (0 == len) {
+            printf("no jpeg in %s\n", path);
+            return 2;
+        }
+        if (0 != rtp_jpeg_parse(frame, len, &info)) {
+            skipped++;
+            continue;
+        }
+        if (rtp_jpeg_send_frame(&tx, &info, n * (RTP_JPEG_CLOCK / 30), udp_send, &ctx) < 0) {
+            return 2;
+        }
+
+        /* drain the receiver after every frame so the socket never overflows */
+        int got;
+        while ((got = recv(rx_sock, pkt, sizeof(pkt), MSG_DONTWAIT)) > 0) {
+            int jpeg_len = rtp_jpeg_rx_push(&rx, pkt, got);
+            if (jpeg_len <= 0) {
+                continue;
+            }
+            /* only the scan travels, the headers are rebuilt by the receiver */
+            uint32_t body = jpeg_len - rx.hdr_len - 2;
+            if (body != info.scan_len || 0 != memcmp(rx.buf + rx.hdr_len, info.scan, body)) {
+                mismatch++;
+            }
+            verified++;
+        }
+    }
+
+    uint32_t sent = tx.frames;
+    double pkts_per_frame = sent ? (double)tx.packets / sent : 0;
+    double expect = 1;
+    for (int i = 0; i < (int)(pkts_per_frame + 0.5); i++) {
+        expect *= 1 - ctx.loss;
+    }
+    printf("frames    sent %u, complete %u (%.1f%%), incomplete %u, skipped %u\n", sent, rx.complete,
+           sent ? 100.0 * rx.complete / sent : 0, rx.incomplete, skipped);
+    printf("packets   %u (%.1f per frame, mtu %u), dropped %u, lost seen by rx %u\n", tx.packets, pkts_per_frame,
+           tx.mtu, ctx.dropped, rx.lost_packets);
+    printf("expected  %.1f%% complete at %.2f%% loss\n", 100 * expect, loss_pct);
+    printf("integrity %u verified, %u mismatched\n", verified, mismatch);
+
+    if (fp) fclose(fp);
+    close(ctx.sock);
+    close(rx_sock);
+    return mismatch ? 1 : 0;
+}
@@ -0,0 +1,440 @@
+/*
+ * uvc_check - host test of the UVC descriptor builder, the probe/commit
+ * state machine and the payload framing (uvc_desc.c, uvc_ctrl.c).
+ *
+ *   descriptors  walks the table like a host does: every length, both
+ *                wTotalLength fields, format and frame counts and indices,
+ *                bitrates and intervals against the format table
+ *   negotiation  replays what Linux' uvcvideo sends when an application
+ *                picks a format, plus the malformed and out of range cases
+ *   payloads     splits random frames into ISO payloads and reassembles them
+ *
+ * Build and run on Linux:
+ *   cc -O1 -g -fsanitize=address,undefined -I.. -o uvc_check uvc_check.c ../uvc_desc.c ../uvc_ctrl.c
+ *   ./uvc_check [-v] [-o config.bin]
+ *
+ * -v prints the descriptors, -o writes the configuration descriptor, which
+ * e.g. a usbmon capture or a descriptor parser can be checked against.
+ * Exits 0 if every check passed, 1 otherwise.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "uvc_ctrl.h"
+#include "uvc_desc.h"
+
+static uint32_t s_failed, s_checks;
+static int s_verbose;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        s_checks++;                                                        \
+        if (!(cond)) {                                                     \
+            s_failed++;                                                    \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);        \
+        }                                                                  \
+    } while (0)
+
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+/* checks one format's frame descriptors, returns the bytes they take */
+static uint32_t walk_frames(const uint8_t *p, uint32_t left, const uvc_format_t *f, uint8_t subtype)
+{
+    uint32_t pos = 0;
+    for (int j = 0; j < f->nframes; j++) {
+        const uvc_frame_t *fr = &f->frame[j];
+        const uint8_t *d = p + pos;
+        CHECK(pos + 26 <= left);
+        if (pos + 26 > left) {
+            return pos;
+        }
+        CHECK(d[0] == 26 + 4 * fr->nintervals && 0x24 == d[1] && subtype == d[2] && j + 1 == d[3]);
+        CHECK(get16(d + 5) == fr->width && get16(d + 7) == fr->height);
+        uint32_t min_rate = get32(d + 9), max_rate = get32(d + 13);
+        CHECK(min_rate <= max_rate && 0 != min_rate);
+        CHECK(get32(d + 17) == fr->max_frame_size);
+        CHECK(get32(d + 21) == fr->interval[0]);
+        CHECK(d[25] == fr->nintervals);
+        for (int k = 0; k < fr->nintervals; k++) {
+            CHECK(get32(d + 26 + 4 * k) == fr->interval[k]);
+        }
+        if (s_verbose) {
+            printf("      frame %u: %ux%u, %u bytes max, %u..%u bit/s, intervals", d[3], get16(d + 5), get16(d + 7),
+                   get32(d + 17), min_rate, max_rate);
+            for (int k = 0; k < d[25]; k++) {
+                printf(" %u", get32(d + 26 + 4 * k));
+            }
+            printf("\n");
+        }
+        pos += d[0];
+    }
+    return pos;
+}
+
+static void check_config(const uvc_dev_cfg_t *cfg, const uint8_t *d, uint32_t len)
+{
+    uint32_t pos = 0;
+    int intf = -1, alt = -1, formats = 0, eps = 0, vs_total = 0, vs_start = 0;
+
+    CHECK(len >= 9 && 9 == d[0] && 2 == d[1] && get16(d + 2) == len && 2 == d[4]);
+
+    while (pos + 2 <= len) {
+        const uint8_t *p = d + pos;
+        CHECK(p[0] >= 2 && pos + p[0] <= len);
+        if (p[0] < 2 || pos + p[0] > len) {
+            return;
+        }
+        if (4 == p[1]) {
+            intf = p[2];
+            alt = p[3];
+            CHECK(0x0e == p[5]);
+            CHECK((0 == intf && 1 == p[6]) || (1 == intf && 2 == p[6]));
+            if (s_verbose) {
+                printf("  interface %d alt %d, %s\n", intf, alt, 1 == p[6] ? "control" : "streaming");
+            }
+        } else if (5 == p[1]) {
+            eps++;
+            CHECK(1 == intf && 1 == alt && p[2] == cfg->ep_addr && 0x05 == p[3] && get16(p + 4) == cfg->ep_size);
+        } else if (0x24 == p[1] && 0 == intf && 1 == p[2]) {
+            CHECK(0x0110 == get16(p + 3));
+            /* the control interface's class descriptors follow back to back */
+            uint32_t total = get16(p + 5), n = 0;
+            for (uint32_t q = pos; q < pos + total && q < len && 0x24 == d[q + 1]; q += d[q]) {
+                n += d[q];
+            }
+            CHECK(n == total);
+            CHECK(1 == p[11] && 1 == p[12]);
+        } else if (0x24 == p[1] && 1 == intf && 1 == p[2]) {
+            /* VS input header */
+            CHECK(0 == alt && p[0] == 13 + cfg->nformats && p[3] == cfg->nformats && p[6] == cfg->ep_addr);
+            vs_total = get16(p + 4);
+            vs_start = pos;
+        } else if (0x24 == p[1] && 1 == intf && (4 == p[2] || 6 == p[2])) {
+            const uvc_format_t *f = &cfg->format[formats];
+            CHECK(formats < cfg->nformats);
+            CHECK(p[3] == formats + 1 && p[4] == f->nframes);
+            if (6 == p[2]) {
+                CHECK(11 == p[0] && UVC_CFG_MJPEG == f->type && 1 == p[6]);
+            } else {
+                CHECK(27 == p[0] && UVC_CFG_YUY2 == f->type && 0 == memcmp(p + 5, "YUY2", 4) && 16 == p[21]);
+            }
+            if (s_verbose) {
+                printf("    format %u: %s, %u frames\n", p[3], 6 == p[2] ? "MJPEG" : "YUY2", p[4]);
+            }
+            pos += p[0];
+            pos += walk_frames(d + pos, len - pos, f, 6 == p[2] ? 7 : 5);
+            CHECK(pos + 6 <= len && 6 == d[pos] && 0x24 == d[pos + 1] && 0x0d == d[pos + 2]);
+            pos += 6;
+            formats++;
+            continue;
+        } else if (0x24 == p[1] && 1 == intf) {
+            CHECK(!"stray streaming descriptor");
+        }
+        pos += p[0];
+    }
+    CHECK(pos == len);
+    CHECK(formats == cfg->nformats);
+    CHECK(1 == eps);
+
+    /* the VS header's wTotalLength runs to the alt 1 interface descriptor */
+    uint32_t q = vs_start;
+    while (q < len && !(4 == d[q + 1] && 1 == d[q + 3])) {
+        q += d[q];
+    }
+    CHECK(vs_total && q - vs_start == (uint32_t)vs_total);
+}
+
+static void check_descriptors(const uvc_dev_cfg_t *cfg, const char *out_path)
+{
+    uint8_t buf[1024];
+    int len = uvc_desc_config(cfg, buf, sizeof(buf));
+    CHECK(len > 0);
+    if (len <= 0) {
+        return;
+    }
+    if (s_verbose) {
+        printf("configuration descriptor, %d bytes\n", len);
+    }
+    check_config(cfg, buf, len);
+
+    /* too small a buffer fails instead of writing past it */
+    for (int n = 0; n < len; n += 7) {
+        uint8_t *small = malloc(n ? n : 1);
+        CHECK(-1 == uvc_desc_config(cfg, small, n));
+        free(small);
+    }
+
+    /* the full table: device, config, strings, qualifier, 0 */
+    uint8_t all[2048];
+    int total = uvc_desc_build(cfg, all, sizeof(all));
+    CHECK(total > len);
+    CHECK(18 == all[0] && 1 == all[1] && 0xef == all[4] && get16(all + 8) == cfg->vid);
+    CHECK(0 == memcmp(all + 18, buf, len));
+    uint32_t pos = 18 + len, strings = 0;
+    while (pos < (uint32_t)total && 3 == all[pos + 1]) {
+        pos += all[pos];
+        strings++;
+    }
+    CHECK(4 == strings);
+    CHECK(pos + 11 == (uint32_t)total && 10 == all[pos] && 6 == all[pos + 1] && 0 == all[pos + 10]);
+
+    if (out_path) {
+        FILE *fp = fopen(out_path, "wb");
+        if (NULL == fp || 1 != fwrite(buf, len, 1, fp)) {
+            perror(out_path);
+            s_failed++;
+        }
+        if (fp) {
+            fclose(fp);
+        }
+    }
+
+    /* broken tables are refused */
+    uvc_dev_cfg_t bad = *cfg;
+    bad.format[0].frame[0].interval[1] = bad.format[0].frame[0].interval[0];
+    CHECK(-1 == uvc_desc_config(&bad, buf, sizeof(buf)));
+    bad = *cfg;
+    bad.nformats = 0;
+    CHECK(-1 == uvc_desc_config(&bad, buf, sizeof(buf)));
+    bad = *cfg;
+    bad.format[1].nframes = UVC_MAX_FRAMES + 1;
+    CHECK(-1 == uvc_desc_config(&bad, buf, sizeof(buf)));
+}
+
+static struct {
+    int commits;
+    uint8_t format;
+    uint16_t width;
+    uint32_t interval;
+    int on;
+} s_cb;
+
+static void on_commit(void *arg, const uvc_probe_t *commit, const uvc_format_t *format, const uvc_frame_t *frame)
+{
+    (void)arg;
+    s_cb.commits++;
+    s_cb.format = format->type;
+    s_cb.width = frame->width;
+    s_cb.interval = commit->dwFrameInterval;
+}
+
+static void on_stream(void *arg, int on)
+{
+    (void)arg;
+    s_cb.on = on;
+}
+
+static int req(uvc_ctrl_t *c, uint8_t intf, uint8_t request, uint8_t cs, uint8_t *data, uint32_t len)
+{
+    return uvc_ctrl_request(c, intf, request, cs, data, len);
+}
+
+static uint8_t error_code(uvc_ctrl_t *c)
+{
+    uint8_t e = 0xff;
+    CHECK(1 == req(c, UVC_VC_INTF, UVC_GET_CUR, UVC_VC_REQUEST_ERROR_CODE_CONTROL, &e, 1));
+    return e;
+}
+
+/* uvcvideo's uvc_probe_video(): SET_CUR probe, GET_CUR probe, then SET_CUR commit with what came back */
+static int host_select(uvc_ctrl_t *c, uint8_t format, uint8_t frame, uint32_t interval, uint32_t probe_len,
+                       uvc_probe_t *got)
+{
+    uint8_t buf[UVC_PROBE_LEN];
+    uvc_probe_t p = {.bmHint = 1, .bFormatIndex = format, .bFrameIndex = frame, .dwFrameInterval = interval};
+    uvc_probe_pack(&p, buf);
+    if (0 != req(c, UVC_VS_INTF, UVC_SET_CUR, UVC_VS_PROBE_CONTROL, buf, probe_len)) {
+        return -1;
+    }
+    memset(buf, 0, sizeof(buf));
+    if ((int)probe_len != req(c, UVC_VS_INTF, UVC_GET_CUR, UVC_VS_PROBE_CONTROL, buf, probe_len)) {
+        return -1;
+    }
+    uvc_probe_unpack(got, buf, probe_len);
+    return req(c, UVC_VS_INTF, UVC_SET_CUR, UVC_VS_COMMIT_CONTROL, buf, probe_len);
+}
+
+static void check_negotiation(const uvc_dev_cfg_t *cfg)
+{
+    uvc_ctrl_t c = {.on_commit = on_commit, .on_stream = on_stream};
+    uint8_t buf[64];
+    uvc_probe_t p;
+
+    uvc_ctrl_init(&c, cfg);
+
+    CHECK(2 == req(&c, UVC_VS_INTF, UVC_GET_LEN, UVC_VS_PROBE_CONTROL, buf, 2) && UVC_PROBE_LEN == get16(buf));
+    CHECK(1 == req(&c, UVC_VS_INTF, UVC_GET_INFO, UVC_VS_PROBE_CONTROL, buf, 1) && 3 == buf[0]);
+
+    /* defaults: format 1, frame 1, its default interval and size */
+    CHECK(UVC_PROBE_LEN == req(&c, UVC_VS_INTF, UVC_GET_DEF, UVC_VS_PROBE_CONTROL, buf, UVC_PROBE_LEN));
+    uvc_probe_unpack(&p, buf, UVC_PROBE_LEN);
+    CHECK(1 == p.bFormatIndex && 1 == p.bFrameIndex && p.dwFrameInterval == cfg->format[0].frame[0].interval[0]);
+    CHECK(p.dwMaxVideoFrameSize == cfg->format[0].frame[0].max_frame_size);
+    CHECK(p.dwMaxPayloadTransferSize == cfg->ep_size && UVC_CLOCK_HZ == p.dwClockFrequency);
+
+    /* an exact pick, UVC 1.1 length */
+    const uvc_frame_t *fr = &cfg->format[1].frame[1];
+    CHECK(0 == host_select(&c, 2, 2, fr->interval[2], UVC_PROBE_LEN, &p));
+    CHECK(2 == p.bFormatIndex && 2 == p.bFrameIndex && p.dwFrameInterval == fr->interval[2]);
+    CHECK(p.dwMaxVideoFrameSize == fr->width * fr->height * 2u);
+    CHECK(1 == s_cb.commits && UVC_CFG_YUY2 == s_cb.format && fr->width == s_cb.width);
+    CHECK(s_cb.interval == fr->interval[2] && UVC_ERR_NONE == error_code(&c));
+
+    /* UVC 1.0 length, odd interval: the nearest one is offered and committed */
+    CHECK(0 == host_select(&c, 1, 1, fr->interval[0] + 10, UVC_PROBE_LEN_10, &p));
+    CHECK(1 == p.bFormatIndex && 1 == p.bFrameIndex && cfg->format[0].frame[0].interval[0] == p.dwFrameInterval);
+    CHECK(2 == s_cb.commits && UVC_CFG_MJPEG == s_cb.format);
+
+    /* format and frame out of range are pulled back into range by the probe */
+    CHECK(0 == host_select(&c, 9, 9, 0, UVC_PROBE_LEN, &p));
+    CHECK(1 == p.bFormatIndex && 1 == p.bFrameIndex && 0 != p.dwFrameInterval);
+    CHECK(0 == host_select(&c, 2, 7, 0, UVC_PROBE_LEN, &p));
+    CHECK(2 == p.bFormatIndex && 1 == p.bFrameIndex && cfg->format[1].frame[0].interval[0] == p.dwFrameInterval);
+
+    /* GET_MIN/MAX span the current frame's intervals */
+    CHECK(UVC_PROBE_LEN == req(&c, UVC_VS_INTF, UVC_GET_MIN, UVC_VS_PROBE_CONTROL, buf, UVC_PROBE_LEN));
+    uvc_probe_unpack(&p, buf, UVC_PROBE_LEN);
+    CHECK(p.dwFrameInterval == cfg->format[1].frame[0].interval[0]);
+    CHECK(UVC_PROBE_LEN == req(&c, UVC_VS_INTF, UVC_GET_MAX, UVC_VS_PROBE_CONTROL, buf, UVC_PROBE_LEN));
+    uvc_probe_unpack(&p, buf, UVC_PROBE_LEN);
+    CHECK(p.dwFrameInterval == cfg->format[1].frame[0].interval[cfg->format[1].frame[0].nintervals - 1]);
+
+    /* a commit outside the table stalls and says why, the old commit stays */
+    int commits = s_cb.commits;
+    p = (uvc_probe_t){.bFormatIndex = 2, .bFrameIndex = 1, .dwFrameInterval = 123};
+    uvc_probe_pack(&p, buf);
+    CHECK(-1 == req(&c, UVC_VS_INTF, UVC_SET_CUR, UVC_VS_COMMIT_CONTROL, buf, UVC_PROBE_LEN));
+    CHECK(UVC_ERR_OUT_OF_RANGE == error_code(&c) && commits == s_cb.commits);
+    p.bFormatIndex = 3;
+    uvc_probe_pack(&p, buf);
+    CHECK(-1 == req(&c, UVC_VS_INTF, UVC_SET_CUR, UVC_VS_COMMIT_CONTROL, buf, UVC_PROBE_LEN));
+    CHECK(2 == c.commit.bFormatIndex); /* still the last good one */
+
+    /* short SET data, unknown selector, unknown request */
+    CHECK(-1 == req(&c, UVC_VS_INTF, UVC_SET_CUR, UVC_VS_PROBE_CONTROL, buf, 10));
+    CHECK(UVC_ERR_OUT_OF_RANGE == error_code(&c));
+    CHECK(-1 == req(&c, UVC_VS_INTF, UVC_GET_CUR, 0x09, buf, UVC_PROBE_LEN));
+    CHECK(UVC_ERR_INVALID_CONTROL == error_code(&c));
+    CHECK(-1 == req(&c, UVC_VS_INTF, UVC_GET_RES, UVC_VS_PROBE_CONTROL, buf, UVC_PROBE_LEN));
+    CHECK(UVC_ERR_INVALID_REQUEST == error_code(&c));
+    CHECK(-1 == req(&c, UVC_VC_INTF, UVC_GET_CUR, 0x01, buf, 1));
+    CHECK(-1 == req(&c, 5, UVC_GET_CUR, UVC_VS_PROBE_CONTROL, buf, UVC_PROBE_LEN));
+
+    /* short GET reads are truncated, not overrun */
+    memset(buf, 0xaa, sizeof(buf));
+    CHECK(8 == req(&c, UVC_VS_INTF, UVC_GET_CUR, UVC_VS_PROBE_CONTROL, buf, 8) && 0xaa == buf[8]);
+
+    /* streaming: commits are refused until alt 0 */
+    uvc_ctrl_set_alt(&c, 1);
+    CHECK(1 == s_cb.on && c.streaming);
+    commits = s_cb.commits;
+    CHECK(-1 == host_select(&c, 1, 1, 0, UVC_PROBE_LEN, &p));
+    CHECK(UVC_ERR_WRONG_STATE == error_code(&c) && commits == s_cb.commits);
+    uvc_ctrl_set_alt(&c, 0);
+    CHECK(0 == s_cb.on && !c.streaming);
+    CHECK(0 == host_select(&c, 1, 1, 0, UVC_PROBE_LEN, &p));
+
+    /* alt 1 without any commit commits the probe */
+    uvc_ctrl_init(&c, cfg);
+    commits = s_cb.commits;
+    uvc_ctrl_set_alt(&c, 1);
+    CHECK(commits + 1 == s_cb.commits && c.committed && 1 == c.commit.bFormatIndex);
+    CHECK(c.stat.stalls == 0);
+}
+
+static void check_payloads(uint32_t rounds)
+{
+    static uint8_t frame[300000], out[300000];
+    uint8_t pkt[1024];
+    uvc_payload_t p;
+    int done;
+
+    memset(&p, 0, sizeof(p));
+    /* idle: header only, no EOF */
+    CHECK(UVC_PAYLOAD_HDR == uvc_payload_fill(&p, pkt, sizeof(pkt), &done) && 0 == done);
+    CHECK(2 == pkt[0] && 0 == (pkt[1] & UVC_HDR_EOF));
+
+    uint8_t last_fid = pkt[1] & UVC_HDR_FID;
+    for (uint32_t r = 0; r < rounds; r++) {
+        uint32_t len = 1 + rand() % sizeof(frame);
+        uint32_t size = 16 + rand() % (sizeof(pkt) - 15);
+        for (uint32_t i = 0; i < len; i++) {
+            frame[i] = rand();
+        }
+        uvc_payload_start(&p, frame, len);
+
+        uint32_t got = 0, pkts = 0;
+        int eofs = 0;
+        uint8_t fid = 0xff;
+        do {
+            uint32_t n = uvc_payload_fill(&p, pkt, size, &done);
+            CHECK(n >= UVC_PAYLOAD_HDR && n <= size && 2 == pkt[0] && (pkt[1] & UVC_HDR_EOH));
+            if (0xff == fid) {
+                fid = pkt[1] & UVC_HDR_FID;
+            }
+            CHECK(fid == (pkt[1] & UVC_HDR_FID));
+            eofs += !!(pkt[1] & UVC_HDR_EOF);
+            CHECK(!!(pkt[1] & UVC_HDR_EOF) == done);
+            memcpy(out + got, pkt + UVC_PAYLOAD_HDR, n - UVC_PAYLOAD_HDR);
+            got += n - UVC_PAYLOAD_HDR;
+            pkts++;
+        } while (!done && pkts < len + 2);
+        CHECK(got == len && 1 == eofs && 0 == memcmp(frame, out, len));
+        CHECK(pkts == (len + size - UVC_PAYLOAD_HDR - 1) / (size - UVC_PAYLOAD_HDR));
+        CHECK(fid != last_fid); /* FID flips per frame */
+        last_fid = fid;
+
+        /* after the frame, idle headers carry the same FID and no EOF */
+        CHECK(UVC_PAYLOAD_HDR == uvc_payload_fill(&p, pkt, size, &done) && !done && fid == (pkt[1] & UVC_HDR_FID));
+    }
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-v] [-o config.bin] [-n rounds]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_path = NULL;
+    uint32_t rounds = 200;
+    uvc_dev_cfg_t cfg;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vo:n:h")) != -1) {
+        switch (opt) {
+            case 'v':
+                s_verbose = 1;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'n':
+                rounds = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    uvc_default_cfg(&cfg);
+    CHECK(0 == uvc_cfg_check(&cfg));
+    check_descriptors(&cfg, out_path);
+    check_negotiation(&cfg);
+    check_payloads(rounds);
+
+    printf("%u checks, %u failed\n", s_checks, s_failed);
+    return s_failed ? 1 : 0;
+}
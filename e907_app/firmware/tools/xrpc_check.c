@@ -0,0 +1,325 @@
+/*
+ * xrpc_check - host test of the batched call codec in xrpc_msg.c.
+ *
+ * Round trips random batches of every op through the request and reply
+ * encoders and decoders, then feeds the decoders truncated, corrupted and
+ * oversized messages, which must be rejected without reading past the
+ * buffer (run it under -fsanitize=address to be sure).
+ *
+ * Build and run on Linux:
+ *   cc -O1 -g -fsanitize=address,undefined -I.. -o xrpc_check xrpc_check.c ../xrpc_msg.c
+ *   ./xrpc_check [-n rounds] [-s seed]
+ *
+ * Exits 0 if every check passed, 1 otherwise.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xrpc_msg.h"
+
+static uint32_t s_failed, s_checks;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        s_checks++;                                                        \
+        if (!(cond)) {                                                     \
+            s_failed++;                                                    \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);        \
+        }                                                                  \
+    } while (0)
+
+typedef struct {
+    xrpc_op_t op;
+    uint8_t payload[512];
+} ref_op_t;
+
+/* the server's side of the round trip: read ops, answer each one */
+static uint32_t serve(const uint8_t *req, uint32_t req_len, uint8_t *resp, uint32_t size, const ref_op_t *ref,
+                      uint16_t count, uint32_t seq)
+{
+    xrpc_reader_t r;
+    xrpc_writer_t w;
+    xrpc_op_t op;
+    uint16_t n = 0;
+
+    CHECK(0 == xrpc_req_parse(&r, req, req_len));
+    CHECK(r.seq == seq && r.count == count && 0 == r.flags);
+    xrpc_resp_begin(&w, resp, size);
+    while (xrpc_req_next(&r, &op)) {
+        const xrpc_op_t *e = &ref[n].op;
+        CHECK(n < count);
+        CHECK(op.code == e->code && op.flags == e->flags && op.a0 == e->a0 && op.a1 == e->a1 && op.a2 == e->a2);
+        CHECK(op.payload_len == e->payload_len);
+        CHECK(0 == op.payload_len || 0 == memcmp(op.payload, e->payload, op.payload_len));
+        if (XRPC_OP_FLASH_READ == op.code) {
+            /* data is a function of offset and index, filled in place then status patched */
+            uint8_t *d = xrpc_resp_add(&w, 0, op.a1);
+            CHECK(NULL != d);
+            for (uint32_t i = 0; d && i < op.a1; i++) {
+                d[i] = (uint8_t)(op.a0 + i);
+            }
+            xrpc_resp_set_status(&w, (int32_t)n);
+        } else {
+            xrpc_resp_add(&w, -(int32_t)n, 0);
+        }
+        n++;
+    }
+    CHECK(n == count);
+    CHECK(0 == xrpc_req_next(&r, &op));
+    return xrpc_resp_end(&w, seq);
+}
+
+static void check_round_trip(uint32_t rounds)
+{
+    static uint8_t req[XRPC_BUF_SIZE], resp[XRPC_BUF_SIZE];
+    static ref_op_t ref[XRPC_MAX_OPS];
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        xrpc_writer_t w;
+        uint16_t count = 0;
+        uint32_t resp_room = XRPC_HDR_SIZE;
+
+        xrpc_req_begin(&w, req, sizeof(req));
+        while (count < XRPC_MAX_OPS) {
+            ref_op_t *e = &ref[count];
+            memset(e, 0, sizeof(*e));
+            e->op.code = rand() % XRPC_OP_MAX;
+            e->op.a0 = rand();
+            e->op.a1 = rand() % 300;
+            e->op.a2 = rand() % 101;
+            if (XRPC_OP_FLASH_WRITE == e->op.code) {
+                e->op.payload_len = rand() % sizeof(e->payload);
+                for (uint32_t i = 0; i < e->op.payload_len; i++) {
+                    e->payload[i] = rand();
+                }
+                e->op.payload = e->payload;
+            }
+            /* keep every reply within one buffer, like the client has to */
+            uint32_t need = XRPC_REC_HDR_SIZE + (XRPC_OP_FLASH_READ == e->op.code ? (e->op.a1 + 3) & ~3u : 0);
+            if (resp_room + need > XRPC_BUF_SIZE) {
+                break;
+            }
+            int idx = xrpc_req_add(&w, &e->op);
+            if (idx < 0) {
+                break; /* request buffer full */
+            }
+            CHECK(idx == count);
+            resp_room += need;
+            count++;
+            if (0 == rand() % 40) {
+                break;
+            }
+        }
+        uint32_t req_len = xrpc_req_end(&w, round, 0);
+        CHECK(0 == req_len % 4 && req_len <= sizeof(req));
+
+        uint32_t resp_len = serve(req, req_len, resp, sizeof(resp), ref, count, round);
+        CHECK(resp_len == resp_room);
+
+        xrpc_reader_t r;
+        int32_t status;
+        const uint8_t *data;
+        uint32_t data_len;
+        uint16_t n = 0;
+        CHECK(0 == xrpc_resp_parse(&r, resp, resp_len));
+        CHECK(r.seq == round && r.count == count);
+        while (xrpc_resp_next(&r, &status, &data, &data_len)) {
+            const xrpc_op_t *e = &ref[n].op;
+            if (XRPC_OP_FLASH_READ == e->code) {
+                CHECK(status == n && data_len == e->a1);
+                int same = 1;
+                for (uint32_t i = 0; i < data_len; i++) {
+                    same &= data[i] == (uint8_t)(e->a0 + i);
+                }
+                CHECK(same);
+            } else {
+                CHECK(status == -(int32_t)n && 0 == data_len && NULL == data);
+            }
+            n++;
+        }
+        CHECK(n == count);
+    }
+}
+
+/* a copy of exactly len bytes on the heap, so ASan sees any overread */
+static int parse_copy(int resp, const uint8_t *msg, uint32_t len)
+{
+    uint8_t *p = malloc(len ? len : 1);
+    memcpy(p, msg, len);
+    xrpc_reader_t r;
+    int ret = resp ? xrpc_resp_parse(&r, p, len) : xrpc_req_parse(&r, p, len);
+    if (0 == ret) {
+        /* whatever parses must also walk cleanly */
+        xrpc_op_t op;
+        int32_t status;
+        const uint8_t *data;
+        uint32_t data_len;
+        while (resp ? xrpc_resp_next(&r, &status, &data, &data_len) : xrpc_req_next(&r, &op)) {
+        }
+    }
+    free(p);
+    return ret;
+}
+
+static void check_malformed(void)
+{
+    uint8_t req[256], resp[256];
+    uint8_t pl[5] = {1, 2, 3, 4, 5};
+    xrpc_op_t op = {.code = XRPC_OP_FLASH_WRITE, .a0 = 0x1000, .payload = pl, .payload_len = sizeof(pl)};
+    xrpc_writer_t w;
+
+    xrpc_req_begin(&w, req, sizeof(req));
+    CHECK(0 == xrpc_req_add(&w, &op));
+    op = (xrpc_op_t){.code = XRPC_OP_NOP};
+    CHECK(1 == xrpc_req_add(&w, &op));
+    uint32_t len = xrpc_req_end(&w, 7, XRPC_F_NO_REPLY);
+    CHECK(XRPC_HDR_SIZE + 2 * XRPC_OP_HDR_SIZE + 8 == len);
+    CHECK(0 == parse_copy(0, req, len));
+
+    /* flags come through */
+    xrpc_reader_t r;
+    CHECK(0 == xrpc_req_parse(&r, req, len) && XRPC_F_NO_REPLY == r.flags);
+
+    /* every truncation fails, never overreads */
+    for (uint32_t l = 0; l < len; l++) {
+        CHECK(0 != parse_copy(0, req, l));
+    }
+    /* a reply is not a request and the other way round */
+    CHECK(0 != parse_copy(1, req, len));
+
+    uint8_t bad[256];
+    memcpy(bad, req, len);
+    bad[0] ^= 1; /* magic */
+    CHECK(0 != parse_copy(0, bad, len));
+
+    memcpy(bad, req, len);
+    bad[XRPC_HDR_SIZE] = XRPC_OP_MAX; /* unknown op */
+    CHECK(0 != parse_copy(0, bad, len));
+
+    memcpy(bad, req, len);
+    bad[XRPC_HDR_SIZE + 2] = 0xff; /* payload runs off the end */
+    CHECK(0 != parse_copy(0, bad, len));
+
+    memcpy(bad, req, len);
+    bad[8] = 3; /* more ops than encoded */
+    CHECK(0 != parse_copy(0, bad, len));
+
+    memcpy(bad, req, len);
+    bad[8] = 0xff;
+    bad[9] = 0xff; /* beyond XRPC_MAX_OPS */
+    CHECK(0 != parse_copy(0, bad, len));
+
+    memcpy(bad, req, len);
+    bad[12] = (uint8_t)(len + 4); /* header claims more than there is */
+    CHECK(0 != parse_copy(0, bad, len));
+
+    /* a full op table refuses the next op */
+    static uint8_t big[XRPC_BUF_SIZE];
+    xrpc_req_begin(&w, big, sizeof(big));
+    op = (xrpc_op_t){.code = XRPC_OP_NOP};
+    for (int i = 0; i < XRPC_MAX_OPS; i++) {
+        CHECK(i == xrpc_req_add(&w, &op));
+    }
+    CHECK(-1 == xrpc_req_add(&w, &op));
+
+    /* a full buffer too, leaving the writer untouched */
+    xrpc_req_begin(&w, req, 36);
+    op = (xrpc_op_t){.code = XRPC_OP_FLASH_WRITE, .payload = pl, .payload_len = sizeof(pl)};
+    CHECK(-1 == xrpc_req_add(&w, &op));
+    CHECK(XRPC_HDR_SIZE == w.len && 0 == w.count);
+
+    /* reply records that don't fit turn into failures, not overruns */
+    xrpc_resp_begin(&w, resp, 64);
+    CHECK(NULL != xrpc_resp_add(&w, 0, 16));
+    CHECK(NULL == xrpc_resp_add(&w, 0, 100));
+    CHECK(w.len <= 64);
+    len = xrpc_resp_end(&w, 9);
+    int32_t status;
+    const uint8_t *data;
+    uint32_t data_len;
+    CHECK(0 == xrpc_resp_parse(&r, resp, len) && 2 == r.count);
+    CHECK(xrpc_resp_next(&r, &status, &data, &data_len) && 0 == status && 16 == data_len);
+    CHECK(xrpc_resp_next(&r, &status, &data, &data_len) && -1 == status && 0 == data_len);
+    for (uint32_t l = 0; l < len; l++) {
+        CHECK(0 != parse_copy(1, resp, l));
+    }
+    memcpy(bad, resp, len);
+    bad[XRPC_HDR_SIZE + 4] = 0xf0; /* data_len past the end */
+    CHECK(0 != parse_copy(1, bad, len));
+
+    /* lengths ALIGN4 wraps to 0, on either side */
+    for (uint32_t huge = 0xfffffffd; huge != 0; huge++) {
+        xrpc_resp_begin(&w, resp, 64);
+        CHECK(NULL == xrpc_resp_add(&w, 0, huge));
+        CHECK(w.len <= 64);
+        memcpy(bad, resp, len);
+        bad[XRPC_HDR_SIZE + 4] = huge;
+        bad[XRPC_HDR_SIZE + 5] = huge >> 8;
+        bad[XRPC_HDR_SIZE + 6] = huge >> 16;
+        bad[XRPC_HDR_SIZE + 7] = huge >> 24;
+        CHECK(0 != parse_copy(1, bad, len));
+    }
+}
+
+/* random bytes behind a valid magic, only ASan can fail this one */
+static void check_fuzz(uint32_t rounds)
+{
+    uint8_t msg[128];
+    for (uint32_t i = 0; i < rounds; i++) {
+        uint32_t len = XRPC_HDR_SIZE + rand() % (sizeof(msg) - XRPC_HDR_SIZE);
+        for (uint32_t j = 0; j < len; j++) {
+            msg[j] = rand();
+        }
+        int resp = rand() & 1;
+        uint32_t magic = resp ? XRPC_RESP_MAGIC : XRPC_REQ_MAGIC;
+        memcpy(msg, &magic, 4);
+        msg[8] = rand() % 8;
+        msg[9] = 0;
+        msg[12] = rand() % (len + 8);
+        msg[13] = msg[14] = msg[15] = 0;
+        for (uint32_t j = XRPC_HDR_SIZE; j + 3 < len; j += 4) {
+            if (rand() & 1) {
+                msg[j] %= XRPC_OP_MAX; /* valid code */
+                msg[j + 3] = 0;        /* short payload */
+            }
+        }
+        parse_copy(resp, msg, len);
+    }
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-n rounds] [-s seed]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rounds = 2000;
+    unsigned seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                rounds = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    srand(seed);
+
+    check_round_trip(rounds);
+    check_malformed();
+    check_fuzz(rounds * 10);
+
+    printf("%u checks, %u failed\n", s_checks, s_failed);
+    return s_failed ? 1 : 0;
+}
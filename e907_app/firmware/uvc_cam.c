@@ -0,0 +1,354 @@
+#include <FreeRTOS.h>
+#include <aos/kernel.h>
+#include <cli.h>
+#include <csi_core.h>
+#include <stdio.h>
+#include <string.h>
+#include <task.h>
+
+#include <usbd_core.h>
+
+#include "frame_ring.h"
+#include "uvc_cfg.h"
+#include "uvc_ctrl.h"
+#include "uvc_desc.h"
+
+/*
+ * USB Video function with the formats of uvc_default_cfg(), in place of the
+ * SDK's single format helper_usb_cam. The control side (descriptors,
+ * probe/commit) is uvc_desc.c and uvc_ctrl.c; this file ties them to the
+ * device stack, publishes commits to the C906 (c906_app/uvc_demo) through
+ * the uvc_cfg block and sends the frames it pushes through the frame ring.
+ *
+ * The ISO endpoint is fed from its completion interrupt, one wMaxPacketSize
+ * payload per microframe out of two bounce buffers, copied straight from
+ * the C906's frame. The task only moves frames between the ring and the
+ * interrupt: it pops the next one into s_next and releases the ones the
+ * interrupt has finished, in order, so releases follow pops.
+ *
+ * The uvc_cfg block and the ring are in the shared window of frame_ring.h.
+ * uvc_demo formats the ring only when its heap stays clear of the window,
+ * so `uvc start` refuses until the ring is there and writes nothing before.
+ * Opt-in with FEATURE_ENABLE_UVC_FRING, the SDK's usb camera is the default.
+ */
+
+#define UVC_DESC_SIZE (512)
+#define UVC_KICK_MS (100) /* restart the ISO chain if it went quiet for this long */
+
+static uvc_dev_cfg_t s_cfg;
+static uint8_t s_desc[UVC_DESC_SIZE];
+static uvc_ctrl_t s_ctrl;
+static fring_t s_ring;
+static volatile int s_uvc_running;
+
+/* shared with the ISO interrupt */
+static uvc_payload_t s_payload;
+static uint8_t s_pkt[2][1024] __attribute__((aligned(32)));
+static uint8_t s_pkt_idx;
+static uint32_t s_pkt_len;
+static volatile int s_active;       /* host selected alt 1 */
+/* all three volatile, so the compiler keeps data and len written before valid is set */
+static volatile int s_next_valid;   /* task -> isr */
+static const uint8_t *volatile s_next_data;
+static volatile uint32_t s_next_len; /* 0: a stale frame, finished without sending */
+static volatile uint32_t s_isr_done; /* frames the interrupt is done with */
+static volatile uint32_t s_isr_ms;   /* last completion */
+static uint32_t s_gap_pkts;          /* microframes since the last frame started */
+static uint32_t s_gap_limit;
+static uint8_t s_in_gap;
+
+static uint32_t s_handed;   /* frames given to the interrupt */
+static uint32_t s_released; /* of those, released to the C906 */
+
+/* ---- commit -> C906 ---- */
+
+static void cfg_publish(const uvc_probe_t *commit, const uvc_format_t *format, const uvc_frame_t *frame)
+{
+    volatile uvc_cfg_shm_t *shm = (volatile uvc_cfg_shm_t *)UVC_CFG_SHM_BASE;
+
+    shm->format = format->type;
+    shm->width = frame->width;
+    shm->height = frame->height;
+    shm->interval = commit->dwFrameInterval;
+    shm->streaming = s_ctrl.streaming;
+    shm->magic = UVC_CFG_MAGIC;
+    shm->gen = shm->gen + 1;
+    csi_dcache_clean_range((void *)shm, sizeof(*shm));
+}
+
+static void cfg_streaming(int on)
+{
+    volatile uvc_cfg_shm_t *shm = (volatile uvc_cfg_shm_t *)UVC_CFG_SHM_BASE;
+
+    shm->streaming = on;
+    csi_dcache_clean_range((void *)shm, sizeof(*shm));
+}
+
+static void on_commit(void *arg, const uvc_probe_t *commit, const uvc_format_t *format, const uvc_frame_t *frame)
+{
+    /* at 125 us per microframe, 1.5 intervals without a new frame is an underrun */
+    s_gap_limit = commit->dwFrameInterval * 3 / 2 / 1250;
+    cfg_publish(commit, format, frame);
+}
+
+/* ---- ISO interrupt ---- */
+
+static void iso_send(void)
+{
+    int frame_done = 0;
+
+    if (!s_payload.busy) {
+        if (s_next_valid) {
+            s_next_valid = 0;
+            if (0 == s_next_len) {
+                s_isr_done++;
+            } else {
+                uvc_payload_start(&s_payload, s_next_data, s_next_len);
+                s_gap_pkts = 0;
+                s_in_gap = 0;
+            }
+        } else if (++s_gap_pkts > s_gap_limit && !s_in_gap) {
+            s_in_gap = 1;
+            s_ctrl.stat.underruns++;
+        }
+    }
+
+    uint8_t *pkt = s_pkt[s_pkt_idx];
+    s_pkt_idx ^= 1;
+    s_pkt_len = uvc_payload_fill(&s_payload, pkt, s_cfg.ep_size, &frame_done);
+    if (frame_done) {
+        s_ctrl.stat.frames++;
+        s_isr_done++;
+    }
+    csi_dcache_clean_range(pkt, s_pkt_len);
+    if (0 != usbd_ep_start_write(s_cfg.ep_addr, pkt, s_pkt_len)) {
+        s_ctrl.stat.iso_errors++;
+    }
+}
+
+static void iso_in_cb(uint8_t ep, uint32_t nbytes)
+{
+    s_isr_ms = aos_now_ms();
+    if (!s_active) {
+        return;
+    }
+    if (nbytes != s_pkt_len) {
+        s_ctrl.stat.iso_errors++;
+    }
+    s_ctrl.stat.bytes += nbytes;
+    iso_send();
+}
+
+static void on_stream(void *arg, int on)
+{
+    s_active = on;
+    cfg_streaming(on);
+    if (on) {
+        s_gap_pkts = 0;
+        s_in_gap = 0;
+        s_isr_ms = aos_now_ms();
+        iso_send();
+    }
+}
+
+/* ---- device stack ---- */
+
+static int uvc_class_request(struct usb_setup_packet *setup, uint8_t **data, uint32_t *len)
+{
+    int ret = uvc_ctrl_request(&s_ctrl, setup->wIndex & 0xff, setup->bRequest, setup->wValue >> 8, *data,
+                               setup->wLength);
+    if (ret < 0) {
+        return -1;
+    }
+    *len = ret;
+    return 0;
+}
+
+static void uvc_notify(uint8_t event, void *arg)
+{
+    if (USBD_EVENT_SET_INTERFACE == event) {
+        struct usb_interface_descriptor *intf = arg;
+        if (UVC_VS_INTF == intf->bInterfaceNumber) {
+            uvc_ctrl_set_alt(&s_ctrl, intf->bAlternateSetting);
+        }
+    } else if (USBD_EVENT_RESET == event) {
+        uvc_ctrl_set_alt(&s_ctrl, 0);
+    }
+}
+
+static struct usbd_interface s_vc_intf = {
+    .class_interface_handler = uvc_class_request,
+    .notify_handler = uvc_notify,
+};
+static struct usbd_interface s_vs_intf = {
+    .class_interface_handler = uvc_class_request,
+    .notify_handler = uvc_notify,
+};
+static struct usbd_endpoint s_iso_ep = {
+    .ep_cb = iso_in_cb,
+};
+
+/* ---- frame ring -> interrupt ---- */
+
+static void release_done(void)
+{
+    while (s_released != s_isr_done) {
+        fring_release(&s_ring);
+        s_released++;
+    }
+}
+
+static void uvc_task(void *pvParameters)
+{
+    volatile uvc_cfg_shm_t *shm = (volatile uvc_cfg_shm_t *)UVC_CFG_SHM_BASE;
+
+    while (s_uvc_running) {
+        fring_desc_t d;
+
+        if (!s_active) {
+            /* whatever the interrupt held is dropped with the stream, the C906 gets it all back */
+            taskENTER_CRITICAL();
+            s_payload.busy = 0;
+            s_next_valid = 0;
+            s_isr_done = s_handed;
+            taskEXIT_CRITICAL();
+            release_done();
+            while (fring_pop(&s_ring, &d)) {
+                fring_release(&s_ring);
+            }
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+
+        release_done();
+        if (!s_next_valid && fring_pop(&s_ring, &d)) {
+            s_next_data = (const uint8_t *)(uintptr_t)FRAME_RING_PEER_ADDR(d.addr);
+            s_next_len = d.len;
+            if ((d.cookie >> 8) != (shm->gen & 0xffffff)) {
+                s_next_len = 0; /* pushed before the last commit, the wrong format */
+                s_ctrl.stat.stale++;
+            }
+            s_handed++;
+            s_next_valid = 1;
+        }
+        if (aos_now_ms() - s_isr_ms > UVC_KICK_MS) {
+            /* a refused transfer ends the completion chain, start it again */
+            s_isr_ms = aos_now_ms();
+            taskENTER_CRITICAL();
+            iso_send();
+            taskEXIT_CRITICAL();
+        }
+        vTaskDelay(1);
+    }
+
+    s_active = 0;
+    vTaskDelete(NULL);
+}
+
+static int uvc_start(void)
+{
+    volatile uvc_cfg_shm_t *shm = (volatile uvc_cfg_shm_t *)UVC_CFG_SHM_BASE;
+
+    /* the ring, attached here, is the C906's word that the window is out of its heap */
+    if (0 != fring_attach_consumer(&s_ring, (void *)FRAME_RING_SHM_BASE)) {
+        printf("[uvc] no frame ring at %08lx, start uvc_demo (UVC_DEMO_FRING) on the c906 first\r\n",
+               (unsigned long)FRAME_RING_SHM_BASE);
+        return -1;
+    }
+
+    uvc_default_cfg(&s_cfg);
+    if (0 != uvc_cfg_check(&s_cfg) || uvc_desc_build(&s_cfg, s_desc, sizeof(s_desc)) < 0) {
+        printf("[uvc] bad format table\r\n");
+        return -1;
+    }
+    uvc_ctrl_init(&s_ctrl, &s_cfg);
+    s_ctrl.on_commit = on_commit;
+    s_ctrl.on_stream = on_stream;
+
+    /* the C906 starts the camera in the default format until the host commits */
+    memset((void *)shm, 0, sizeof(*shm));
+    on_commit(NULL, &s_ctrl.commit, uvc_cfg_format(&s_cfg, s_ctrl.commit.bFormatIndex),
+              uvc_cfg_frame(&s_cfg, s_ctrl.commit.bFormatIndex, s_ctrl.commit.bFrameIndex));
+
+    s_iso_ep.ep_addr = s_cfg.ep_addr;
+    usbd_desc_register(s_desc);
+    usbd_add_interface(&s_vc_intf);
+    usbd_add_interface(&s_vs_intf);
+    usbd_add_endpoint(&s_iso_ep);
+    usbd_initialize();
+    return 0;
+}
+
+static void uvc_print_formats(void)
+{
+    for (int i = 0; i < s_cfg.nformats; i++) {
+        const uvc_format_t *f = &s_cfg.format[i];
+        for (int j = 0; j < f->nframes; j++) {
+            const uvc_frame_t *fr = &f->frame[j];
+            printf("  %d/%d %s %ux%u:", i + 1, j + 1, UVC_CFG_MJPEG == f->type ? "mjpeg" : "yuy2", fr->width,
+                   fr->height);
+            for (int k = 0; k < fr->nintervals; k++) {
+                printf(" %lu", (unsigned long)(10000000 / fr->interval[k]));
+            }
+            printf(" fps\r\n");
+        }
+    }
+}
+
+static void uvc_print_stat(void)
+{
+    const uvc_stat_t *st = &s_ctrl.stat;
+    const uvc_probe_t *c = &s_ctrl.commit;
+
+    printf("[uvc] %s, format %u frame %u, %lu us\r\n", s_ctrl.streaming ? "streaming" : "idle", c->bFormatIndex,
+           c->bFrameIndex, (unsigned long)(c->dwFrameInterval / 10));
+    printf("  frames %lu, bytes %llu\r\n", (unsigned long)st->frames, (unsigned long long)st->bytes);
+    printf("  underruns %lu, iso errors %lu, stale %lu\r\n", (unsigned long)st->underruns,
+           (unsigned long)st->iso_errors, (unsigned long)st->stale);
+    printf("  probes %lu, commits %lu, stalls %lu\r\n", (unsigned long)st->probes, (unsigned long)st->commits,
+           (unsigned long)st->stalls);
+}
+
+void cmd_uvc(char *buf, int len, int argc, char **argv)
+{
+    if (2 == argc && 0 == strcmp(argv[1], "stat")) {
+        uvc_print_stat();
+        return;
+    }
+    if (2 == argc && 0 == strcmp(argv[1], "reset")) {
+        taskENTER_CRITICAL();
+        memset(&s_ctrl.stat, 0, sizeof(s_ctrl.stat));
+        taskEXIT_CRITICAL();
+        return;
+    }
+    if (2 == argc && 0 == strcmp(argv[1], "formats")) {
+        uvc_print_formats();
+        return;
+    }
+    if (2 == argc && 0 == strcmp(argv[1], "stop")) {
+        if (s_uvc_running) {
+            usbd_deinitialize();
+            s_uvc_running = 0;
+        }
+        return;
+    }
+    if (2 != argc || 0 != strcmp(argv[1], "start")) {
+        printf("Usage: uvc start\r\n");
+        printf("       uvc stat|reset|formats\r\n");
+        printf("       uvc stop\r\n");
+        return;
+    }
+    if (s_uvc_running) {
+        printf("uvc already running\r\n");
+        return;
+    }
+
+    if (0 != uvc_start()) {
+        return;
+    }
+    s_uvc_running = 1;
+    if (pdPASS != xTaskCreate(uvc_task, "uvc", 1024, NULL, 10, NULL)) {
+        usbd_deinitialize();
+        s_uvc_running = 0;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef __UVC_CFG_H__
+#define __UVC_CFG_H__
+
+#include <stdint.h>
+
+/*
+ * What the USB host committed, written by the E907 (uvc_cam.c) and followed
+ * by the C906 (uvc_demo), which reconfigures the camera and pushes frames in
+ * that format through the frame ring. A single writer, so a plain block:
+ * the E907 fills it and bumps gen last, the C906 reacts to a new gen.
+ *
+ * This file is shared as is between c906_app/uvc_demo and e907_app/firmware,
+ * keep both copies identical.
+ */
+
+#define UVC_CFG_MAGIC (0x43435655) /* "UVCC" */
+
+#ifndef UVC_CFG_SHM_BASE
+#define UVC_CFG_SHM_BASE (0x53fd0000) /* bottom of the window reserved as frame_ring.h describes */
+#endif
+
+/* stream formats, also the format types of uvc_desc.h */
+#define UVC_CFG_MJPEG (1)
+#define UVC_CFG_YUY2 (2)
+
+typedef struct {
+    volatile uint32_t magic;
+    volatile uint32_t gen;      /* bumped on every commit */
+    volatile uint32_t format;   /* UVC_CFG_MJPEG or UVC_CFG_YUY2 */
+    volatile uint32_t width;
+    volatile uint32_t height;
+    volatile uint32_t interval; /* 100 ns units */
+    volatile uint32_t streaming;
+    uint8_t pad[64 - 7 * sizeof(uint32_t)];
+} uvc_cfg_shm_t;
+
+#endif /* __UVC_CFG_H__ */
@@ -0,0 +1,316 @@
+#include <string.h>
+
+#include "uvc_ctrl.h"
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t get32(const uint8_t *p)
+{
+    return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+void uvc_probe_pack(const uvc_probe_t *p, uint8_t *out)
+{
+    put16(out, p->bmHint);
+    out[2] = p->bFormatIndex;
+    out[3] = p->bFrameIndex;
+    put32(out + 4, p->dwFrameInterval);
+    put16(out + 8, p->wKeyFrameRate);
+    put16(out + 10, p->wPFrameRate);
+    put16(out + 12, p->wCompQuality);
+    put16(out + 14, p->wCompWindowSize);
+    put16(out + 16, p->wDelay);
+    put32(out + 18, p->dwMaxVideoFrameSize);
+    put32(out + 22, p->dwMaxPayloadTransferSize);
+    put32(out + 26, p->dwClockFrequency);
+    out[30] = p->bmFramingInfo;
+    out[31] = p->bPreferedVersion;
+    out[32] = p->bMinVersion;
+    out[33] = p->bMaxVersion;
+}
+
+int uvc_probe_unpack(uvc_probe_t *p, const uint8_t *in, uint32_t len)
+{
+    if (len < UVC_PROBE_LEN_10) {
+        return -1;
+    }
+    memset(p, 0, sizeof(*p));
+    p->bmHint = get16(in);
+    p->bFormatIndex = in[2];
+    p->bFrameIndex = in[3];
+    p->dwFrameInterval = get32(in + 4);
+    p->wKeyFrameRate = get16(in + 8);
+    p->wPFrameRate = get16(in + 10);
+    p->wCompQuality = get16(in + 12);
+    p->wCompWindowSize = get16(in + 14);
+    p->wDelay = get16(in + 16);
+    p->dwMaxVideoFrameSize = get32(in + 18);
+    p->dwMaxPayloadTransferSize = get32(in + 22);
+    if (len >= UVC_PROBE_LEN) {
+        p->dwClockFrequency = get32(in + 26);
+        p->bmFramingInfo = in[30];
+        p->bPreferedVersion = in[31];
+        p->bMinVersion = in[32];
+        p->bMaxVersion = in[33];
+    }
+    return 0;
+}
+
+/* the supported interval closest to the asked one, 0 asks for the default */
+static uint32_t nearest_interval(const uvc_frame_t *fr, uint32_t want)
+{
+    uint32_t best = fr->interval[0];
+    if (0 == want) {
+        return best;
+    }
+    for (int i = 1; i < fr->nintervals; i++) {
+        uint32_t d_best = best > want ? best - want : want - best;
+        uint32_t d = fr->interval[i] > want ? fr->interval[i] - want : want - fr->interval[i];
+        if (d < d_best) {
+            best = fr->interval[i];
+        }
+    }
+    return best;
+}
+
+/* turns whatever the host proposed into the closest thing we support, filling in the device's fields */
+static void negotiate(const uvc_dev_cfg_t *cfg, uvc_probe_t *p)
+{
+    if (NULL == uvc_cfg_format(cfg, p->bFormatIndex)) {
+        p->bFormatIndex = 1;
+    }
+    if (NULL == uvc_cfg_frame(cfg, p->bFormatIndex, p->bFrameIndex)) {
+        p->bFrameIndex = 1;
+    }
+    const uvc_frame_t *fr = uvc_cfg_frame(cfg, p->bFormatIndex, p->bFrameIndex);
+
+    p->dwFrameInterval = nearest_interval(fr, p->dwFrameInterval);
+    p->wKeyFrameRate = 0;
+    p->wPFrameRate = 0;
+    p->wCompQuality = 0;
+    p->wCompWindowSize = 0;
+    p->wDelay = 0;
+    p->dwMaxVideoFrameSize = fr->max_frame_size;
+    p->dwMaxPayloadTransferSize = cfg->ep_size;
+    p->dwClockFrequency = UVC_CLOCK_HZ;
+    p->bmFramingInfo = 0x03; /* FID and EOF are used */
+    p->bPreferedVersion = 0;
+    p->bMinVersion = 0;
+    p->bMaxVersion = 0;
+}
+
+static void defaults(const uvc_dev_cfg_t *cfg, uvc_probe_t *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->bmHint = 0x0001; /* dwFrameInterval */
+    p->bFormatIndex = 1;
+    p->bFrameIndex = 1;
+    negotiate(cfg, p);
+}
+
+void uvc_ctrl_init(uvc_ctrl_t *c, const uvc_dev_cfg_t *cfg)
+{
+    c->cfg = cfg;
+    c->committed = 0;
+    c->streaming = 0;
+    c->error = UVC_ERR_NONE;
+    memset(&c->stat, 0, sizeof(c->stat));
+    defaults(cfg, &c->probe);
+    c->commit = c->probe;
+}
+
+static void do_commit(uvc_ctrl_t *c, const uvc_probe_t *p)
+{
+    c->commit = *p;
+    c->committed = 1;
+    c->stat.commits++;
+    if (c->on_commit) {
+        c->on_commit(c->arg, &c->commit, uvc_cfg_format(c->cfg, p->bFormatIndex),
+                     uvc_cfg_frame(c->cfg, p->bFormatIndex, p->bFrameIndex));
+    }
+}
+
+/* a commit has to name a configuration we advertise, exactly */
+static int commit_valid(const uvc_dev_cfg_t *cfg, const uvc_probe_t *p)
+{
+    const uvc_frame_t *fr = uvc_cfg_frame(cfg, p->bFormatIndex, p->bFrameIndex);
+    if (NULL == fr) {
+        return 0;
+    }
+    for (int i = 0; i < fr->nintervals; i++) {
+        if (fr->interval[i] == p->dwFrameInterval) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int stall(uvc_ctrl_t *c, uint8_t error)
+{
+    c->error = error;
+    c->stat.stalls++;
+    return -1;
+}
+
+/* copies a probe out, short reads are fine, hosts ask for 26 or 34 bytes */
+static int reply_probe(uvc_ctrl_t *c, const uvc_probe_t *p, uint8_t *data, uint32_t len)
+{
+    uint8_t buf[UVC_PROBE_LEN];
+    uvc_probe_pack(p, buf);
+    if (len > UVC_PROBE_LEN) {
+        len = UVC_PROBE_LEN;
+    }
+    memcpy(data, buf, len);
+    c->error = UVC_ERR_NONE;
+    return len;
+}
+
+static int vs_request(uvc_ctrl_t *c, uint8_t request, uint8_t cs, uint8_t *data, uint32_t len)
+{
+    uvc_probe_t p;
+
+    if (UVC_VS_PROBE_CONTROL != cs && UVC_VS_COMMIT_CONTROL != cs) {
+        return stall(c, UVC_ERR_INVALID_CONTROL);
+    }
+
+    switch (request) {
+        case UVC_SET_CUR:
+            if (0 != uvc_probe_unpack(&p, data, len)) {
+                return stall(c, UVC_ERR_OUT_OF_RANGE);
+            }
+            if (UVC_VS_PROBE_CONTROL == cs) {
+                negotiate(c->cfg, &p);
+                c->probe = p;
+                c->stat.probes++;
+            } else {
+                if (c->streaming) {
+                    return stall(c, UVC_ERR_WRONG_STATE);
+                }
+                if (!commit_valid(c->cfg, &p)) {
+                    return stall(c, UVC_ERR_OUT_OF_RANGE);
+                }
+                negotiate(c->cfg, &p);
+                do_commit(c, &p);
+            }
+            c->error = UVC_ERR_NONE;
+            return 0;
+        case UVC_GET_CUR:
+            return reply_probe(c, UVC_VS_PROBE_CONTROL == cs ? &c->probe : &c->commit, data, len);
+        case UVC_GET_MIN:
+        case UVC_GET_MAX: {
+            if (UVC_VS_COMMIT_CONTROL == cs) {
+                break;
+            }
+            /* the current format and frame, at their fastest or slowest interval */
+            p = c->probe;
+            const uvc_frame_t *fr = uvc_cfg_frame(c->cfg, p.bFormatIndex, p.bFrameIndex);
+            p.dwFrameInterval = UVC_GET_MIN == request ? fr->interval[0] : fr->interval[fr->nintervals - 1];
+            return reply_probe(c, &p, data, len);
+        }
+        case UVC_GET_DEF:
+            if (UVC_VS_COMMIT_CONTROL == cs) {
+                break;
+            }
+            defaults(c->cfg, &p);
+            return reply_probe(c, &p, data, len);
+        case UVC_GET_LEN:
+            if (len < 2) {
+                break;
+            }
+            put16(data, UVC_PROBE_LEN);
+            c->error = UVC_ERR_NONE;
+            return 2;
+        case UVC_GET_INFO:
+            if (len < 1) {
+                break;
+            }
+            data[0] = 0x03; /* GET and SET */
+            c->error = UVC_ERR_NONE;
+            return 1;
+        default:
+            break;
+    }
+    return stall(c, UVC_ERR_INVALID_REQUEST);
+}
+
+int uvc_ctrl_request(uvc_ctrl_t *c, uint8_t intf, uint8_t request, uint8_t cs, uint8_t *data, uint32_t len)
+{
+    if (UVC_VS_INTF == intf) {
+        return vs_request(c, request, cs, data, len);
+    }
+    if (UVC_VC_INTF == intf && UVC_VC_REQUEST_ERROR_CODE_CONTROL == cs) {
+        if (UVC_GET_CUR == request && len >= 1) {
+            data[0] = c->error; /* reading it doesn't clear it */
+            return 1;
+        }
+        if (UVC_GET_INFO == request && len >= 1) {
+            data[0] = 0x01; /* GET only */
+            return 1;
+        }
+    }
+    return stall(c, UVC_VC_INTF == intf ? UVC_ERR_INVALID_CONTROL : UVC_ERR_INVALID_REQUEST);
+}
+
+void uvc_ctrl_set_alt(uvc_ctrl_t *c, uint8_t alt)
+{
+    int on = 0 != alt;
+    if (on && !c->committed) {
+        do_commit(c, &c->probe);
+    }
+    if (on == c->streaming) {
+        return;
+    }
+    c->streaming = on;
+    if (c->on_stream) {
+        c->on_stream(c->arg, on);
+    }
+}
+
+void uvc_payload_start(uvc_payload_t *p, const uint8_t *data, uint32_t len)
+{
+    p->data = data;
+    p->len = len;
+    p->pos = 0;
+    p->fid ^= UVC_HDR_FID;
+    p->busy = 1;
+}
+
+uint32_t uvc_payload_fill(uvc_payload_t *p, uint8_t *pkt, uint32_t size, int *frame_done)
+{
+    uint32_t n = 0;
+
+    *frame_done = 0;
+    pkt[0] = UVC_PAYLOAD_HDR;
+    pkt[1] = UVC_HDR_EOH | p->fid;
+    if (!p->busy || size <= UVC_PAYLOAD_HDR) {
+        return UVC_PAYLOAD_HDR;
+    }
+
+    n = p->len - p->pos;
+    if (n > size - UVC_PAYLOAD_HDR) {
+        n = size - UVC_PAYLOAD_HDR;
+    }
+    memcpy(pkt + UVC_PAYLOAD_HDR, p->data + p->pos, n);
+    p->pos += n;
+    if (p->pos == p->len) {
+        pkt[1] |= UVC_HDR_EOF;
+        p->busy = 0;
+        *frame_done = 1;
+    }
+    return UVC_PAYLOAD_HDR + n;
+}
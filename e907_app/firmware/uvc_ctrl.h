@@ -0,0 +1,129 @@
+#ifndef __UVC_CTRL_H__
+#define __UVC_CTRL_H__
+
+#include <stdint.h>
+
+#include "uvc_desc.h"
+
+/*
+ * VideoStreaming probe/commit negotiation (UVC 1.1 ch. 4.3.1.1) and the
+ * payload framing of the ISO stream. The host proposes with SET_CUR(PROBE),
+ * reads back what the device can really do with GET_CUR(PROBE), and fixes it
+ * with SET_CUR(COMMIT); the commit reconfigures the camera through
+ * on_commit(). Pure code, no OS calls, tools/uvc_check.c runs it on the host.
+ */
+
+/* class specific requests */
+#define UVC_SET_CUR (0x01)
+#define UVC_GET_CUR (0x81)
+#define UVC_GET_MIN (0x82)
+#define UVC_GET_MAX (0x83)
+#define UVC_GET_RES (0x84)
+#define UVC_GET_LEN (0x85)
+#define UVC_GET_INFO (0x86)
+#define UVC_GET_DEF (0x87)
+
+/* control selectors */
+#define UVC_VS_PROBE_CONTROL (0x01)
+#define UVC_VS_COMMIT_CONTROL (0x02)
+#define UVC_VC_REQUEST_ERROR_CODE_CONTROL (0x02)
+
+/* request error codes */
+#define UVC_ERR_NONE (0x00)
+#define UVC_ERR_WRONG_STATE (0x02)
+#define UVC_ERR_OUT_OF_RANGE (0x04)
+#define UVC_ERR_INVALID_CONTROL (0x06)
+#define UVC_ERR_INVALID_REQUEST (0x07)
+
+#define UVC_PROBE_LEN (34)    /* UVC 1.1 */
+#define UVC_PROBE_LEN_10 (26) /* what UVC 1.0 hosts send */
+
+/* payload header, 2 bytes: bHeaderLength, bmHeaderInfo */
+#define UVC_PAYLOAD_HDR (2)
+#define UVC_HDR_FID (0x01)
+#define UVC_HDR_EOF (0x02)
+#define UVC_HDR_EOH (0x80)
+
+typedef struct {
+    uint16_t bmHint;
+    uint8_t bFormatIndex;
+    uint8_t bFrameIndex;
+    uint32_t dwFrameInterval;
+    uint16_t wKeyFrameRate;
+    uint16_t wPFrameRate;
+    uint16_t wCompQuality;
+    uint16_t wCompWindowSize;
+    uint16_t wDelay;
+    uint32_t dwMaxVideoFrameSize;
+    uint32_t dwMaxPayloadTransferSize;
+    uint32_t dwClockFrequency;
+    uint8_t bmFramingInfo;
+    uint8_t bPreferedVersion;
+    uint8_t bMinVersion;
+    uint8_t bMaxVersion;
+} uvc_probe_t;
+
+typedef struct {
+    uint64_t bytes;
+    uint32_t frames;     /* completely sent */
+    uint32_t underruns;  /* no frame ready 1.5 intervals after the last one started */
+    uint32_t iso_errors; /* transfers the controller refused or cut short */
+    uint32_t stale;      /* frames of an older commit, not sent */
+    uint32_t probes;
+    uint32_t commits;
+    uint32_t stalls;
+} uvc_stat_t;
+
+typedef struct uvc_ctrl {
+    const uvc_dev_cfg_t *cfg;
+    uvc_probe_t probe;
+    uvc_probe_t commit;
+    int committed;
+    int streaming;
+    uint8_t error; /* of the last request, for VC_REQUEST_ERROR_CODE_CONTROL */
+    uvc_stat_t stat;
+
+    /* called on SET_CUR(COMMIT) with the negotiated settings */
+    void (*on_commit)(void *arg, const uvc_probe_t *commit, const uvc_format_t *format, const uvc_frame_t *frame);
+    /* called when the host selects alt 1 (on = 1) or alt 0 */
+    void (*on_stream)(void *arg, int on);
+    void *arg;
+} uvc_ctrl_t;
+
+/* The probe starts at the defaults: first format, first frame, its default interval. */
+void uvc_ctrl_init(uvc_ctrl_t *c, const uvc_dev_cfg_t *cfg);
+
+/*
+ * One class request to interface intf (low byte of wIndex) with control
+ * selector cs (high byte of wValue). data holds len (wLength) bytes, SET
+ * data on the way in, GET data on the way out. Returns the number of bytes
+ * to send back for a GET, 0 for a SET, or -1 to stall; the reason is then
+ * readable through GET_CUR(VC_REQUEST_ERROR_CODE_CONTROL).
+ */
+int uvc_ctrl_request(uvc_ctrl_t *c, uint8_t intf, uint8_t request, uint8_t cs, uint8_t *data, uint32_t len);
+
+/* SET_INTERFACE on the streaming interface. Alt 1 without a commit commits the current probe. */
+void uvc_ctrl_set_alt(uvc_ctrl_t *c, uint8_t alt);
+
+/* wire format, little endian; unpack accepts UVC 1.0's 26 bytes */
+void uvc_probe_pack(const uvc_probe_t *p, uint8_t *out);
+int uvc_probe_unpack(uvc_probe_t *p, const uint8_t *in, uint32_t len);
+
+/*
+ * Splits frames into ISO payloads, each with its 2 byte header. FID flips
+ * on every frame, EOF marks its last payload. Between frames it yields
+ * header only payloads, which hosts treat as "nothing yet".
+ */
+typedef struct {
+    const uint8_t *data;
+    uint32_t len;
+    uint32_t pos;
+    uint8_t fid;
+    uint8_t busy;
+} uvc_payload_t;
+
+void uvc_payload_start(uvc_payload_t *p, const uint8_t *data, uint32_t len);
+/* Fills pkt with at most size bytes, returns the length; frame_done is set on the EOF payload. */
+uint32_t uvc_payload_fill(uvc_payload_t *p, uint8_t *pkt, uint32_t size, int *frame_done);
+
+#endif /* __UVC_CTRL_H__ */
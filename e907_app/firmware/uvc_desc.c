@@ -0,0 +1,392 @@
+#include <string.h>
+
+#include "uvc_desc.h"
+
+/* descriptor types and subtypes, USB 2.0 ch. 9 and UVC 1.1 appendix A */
+#define DT_DEVICE (0x01)
+#define DT_CONFIG (0x02)
+#define DT_STRING (0x03)
+#define DT_INTERFACE (0x04)
+#define DT_ENDPOINT (0x05)
+#define DT_QUALIFIER (0x06)
+#define DT_IAD (0x0b)
+#define CS_INTERFACE (0x24)
+
+#define CC_VIDEO (0x0e)
+#define SC_VIDEOCONTROL (0x01)
+#define SC_VIDEOSTREAMING (0x02)
+#define SC_VIDEO_INTERFACE_COLLECTION (0x03)
+
+#define VC_HEADER (0x01)
+#define VC_INPUT_TERMINAL (0x02)
+#define VC_OUTPUT_TERMINAL (0x03)
+#define VS_INPUT_HEADER (0x01)
+#define VS_FORMAT_UNCOMPRESSED (0x04)
+#define VS_FRAME_UNCOMPRESSED (0x05)
+#define VS_FORMAT_MJPEG (0x06)
+#define VS_FRAME_MJPEG (0x07)
+#define VS_COLORFORMAT (0x0d)
+
+#define ITT_CAMERA (0x0201)
+#define TT_STREAMING (0x0101)
+
+#define CAMERA_TERMINAL_ID (1)
+#define OUTPUT_TERMINAL_ID (2)
+
+static const uint8_t guid_yuy2[16] = {
+    'Y', 'U', 'Y', '2', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71,
+};
+
+/* appends little endian fields, remembers running out of room instead of checking every call */
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t len;
+} wr_t;
+
+static void u8(wr_t *w, uint8_t v)
+{
+    if (w->len < w->size) {
+        w->buf[w->len] = v;
+    }
+    w->len++;
+}
+
+static void u16(wr_t *w, uint16_t v)
+{
+    u8(w, v);
+    u8(w, v >> 8);
+}
+
+static void u32(wr_t *w, uint32_t v)
+{
+    u16(w, v);
+    u16(w, v >> 16);
+}
+
+static void patch16(wr_t *w, uint32_t at, uint16_t v)
+{
+    if (at + 2 <= w->size) {
+        w->buf[at] = v;
+        w->buf[at + 1] = v >> 8;
+    }
+}
+
+#define FPS(n) (10000000 / (n))
+
+void uvc_default_cfg(uvc_dev_cfg_t *cfg)
+{
+    static const uint16_t yuy2_sizes[][2] = {{400, 300}, {320, 240}, {160, 120}};
+
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->vid = 0xffff;
+    cfg->pid = 0xffff;
+    cfg->ep_addr = 0x81;
+    cfg->ep_size = 1024;
+    cfg->manufacturer = "Sipeed";
+    cfg->product = "M1s UVC camera";
+    cfg->serial = "000001";
+
+    cfg->nformats = 2;
+    cfg->format[0].type = UVC_CFG_MJPEG;
+    cfg->format[0].nframes = 1;
+    cfg->format[0].frame[0] = (uvc_frame_t){
+        .width = UVC_MJPEG_WIDTH,
+        .height = UVC_MJPEG_HEIGHT,
+        .max_frame_size = UVC_MJPEG_MAX_FRAME,
+        .nintervals = 4,
+        .interval = {FPS(30), FPS(15), FPS(10), FPS(5)},
+    };
+
+    cfg->format[1].type = UVC_CFG_YUY2;
+    cfg->format[1].nframes = 3;
+    for (int i = 0; i < 3; i++) {
+        cfg->format[1].frame[i] = (uvc_frame_t){
+            .width = yuy2_sizes[i][0],
+            .height = yuy2_sizes[i][1],
+            .max_frame_size = yuy2_sizes[i][0] * yuy2_sizes[i][1] * 2,
+            .nintervals = 4,
+            .interval = {FPS(30), FPS(15), FPS(10), FPS(5)},
+        };
+    }
+}
+
+const uvc_format_t *uvc_cfg_format(const uvc_dev_cfg_t *cfg, uint8_t format_index)
+{
+    if (0 == format_index || format_index > cfg->nformats) {
+        return NULL;
+    }
+    return &cfg->format[format_index - 1];
+}
+
+const uvc_frame_t *uvc_cfg_frame(const uvc_dev_cfg_t *cfg, uint8_t format_index, uint8_t frame_index)
+{
+    const uvc_format_t *f = uvc_cfg_format(cfg, format_index);
+    if (NULL == f || 0 == frame_index || frame_index > f->nframes) {
+        return NULL;
+    }
+    return &f->frame[frame_index - 1];
+}
+
+int uvc_cfg_check(const uvc_dev_cfg_t *cfg)
+{
+    if (0 == cfg->nformats || cfg->nformats > UVC_MAX_FORMATS || 0 == cfg->ep_size || cfg->ep_size > 1024) {
+        return -1;
+    }
+    for (int i = 0; i < cfg->nformats; i++) {
+        const uvc_format_t *f = &cfg->format[i];
+        if ((UVC_CFG_MJPEG != f->type && UVC_CFG_YUY2 != f->type) || 0 == f->nframes || f->nframes > UVC_MAX_FRAMES) {
+            return -1;
+        }
+        for (int j = 0; j < f->nframes; j++) {
+            const uvc_frame_t *fr = &f->frame[j];
+            if (0 == fr->width || 0 == fr->height || 0 == fr->max_frame_size || 0 == fr->nintervals ||
+                fr->nintervals > UVC_MAX_INTERVALS) {
+                return -1;
+            }
+            for (int k = 0; k < fr->nintervals; k++) {
+                if (0 == fr->interval[k] || (k && fr->interval[k] <= fr->interval[k - 1])) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static void frame_desc(wr_t *w, const uvc_format_t *f, int index)
+{
+    const uvc_frame_t *fr = &f->frame[index];
+    /* bits per second at the slowest and the fastest interval */
+    uint64_t bits = (uint64_t)fr->max_frame_size * 8;
+    uint32_t min_rate = bits * 10000000 / fr->interval[fr->nintervals - 1];
+    uint32_t max_rate = bits * 10000000 / fr->interval[0];
+
+    u8(w, 26 + 4 * fr->nintervals);
+    u8(w, CS_INTERFACE);
+    u8(w, UVC_CFG_MJPEG == f->type ? VS_FRAME_MJPEG : VS_FRAME_UNCOMPRESSED);
+    u8(w, index + 1);
+    u8(w, 0); /* bmCapabilities */
+    u16(w, fr->width);
+    u16(w, fr->height);
+    u32(w, min_rate);
+    u32(w, max_rate);
+    u32(w, fr->max_frame_size);
+    u32(w, fr->interval[0]);
+    u8(w, fr->nintervals); /* discrete intervals */
+    for (int k = 0; k < fr->nintervals; k++) {
+        u32(w, fr->interval[k]);
+    }
+}
+
+static void format_desc(wr_t *w, const uvc_format_t *f, int index)
+{
+    if (UVC_CFG_MJPEG == f->type) {
+        u8(w, 11);
+        u8(w, CS_INTERFACE);
+        u8(w, VS_FORMAT_MJPEG);
+        u8(w, index + 1);
+        u8(w, f->nframes);
+        u8(w, 1); /* bmFlags: fixed size samples */
+    } else {
+        u8(w, 27);
+        u8(w, CS_INTERFACE);
+        u8(w, VS_FORMAT_UNCOMPRESSED);
+        u8(w, index + 1);
+        u8(w, f->nframes);
+        for (int i = 0; i < 16; i++) {
+            u8(w, guid_yuy2[i]);
+        }
+        u8(w, 16); /* bBitsPerPixel */
+    }
+    u8(w, 1); /* bDefaultFrameIndex */
+    u8(w, 0); /* bAspectRatioX */
+    u8(w, 0); /* bAspectRatioY */
+    u8(w, 0); /* bmInterlaceFlags */
+    u8(w, 0); /* bCopyProtect */
+
+    for (int i = 0; i < f->nframes; i++) {
+        frame_desc(w, f, i);
+    }
+
+    /* sRGB, BT.601 */
+    u8(w, 6);
+    u8(w, CS_INTERFACE);
+    u8(w, VS_COLORFORMAT);
+    u8(w, 1);
+    u8(w, 1);
+    u8(w, 4);
+}
+
+static void interface_desc(wr_t *w, uint8_t num, uint8_t alt, uint8_t neps, uint8_t subclass, uint8_t str)
+{
+    u8(w, 9);
+    u8(w, DT_INTERFACE);
+    u8(w, num);
+    u8(w, alt);
+    u8(w, neps);
+    u8(w, CC_VIDEO);
+    u8(w, subclass);
+    u8(w, 0); /* PC_PROTOCOL_UNDEFINED */
+    u8(w, str);
+}
+
+static void config_desc(wr_t *w, const uvc_dev_cfg_t *cfg)
+{
+    uint32_t start = w->len;
+
+    u8(w, 9);
+    u8(w, DT_CONFIG);
+    u16(w, 0); /* wTotalLength, patched below */
+    u8(w, 2);  /* bNumInterfaces */
+    u8(w, 1);  /* bConfigurationValue */
+    u8(w, 0);
+    u8(w, 0x80); /* bus powered */
+    u8(w, 100);  /* 200 mA */
+
+    u8(w, 8);
+    u8(w, DT_IAD);
+    u8(w, UVC_VC_INTF);
+    u8(w, 2);
+    u8(w, CC_VIDEO);
+    u8(w, SC_VIDEO_INTERFACE_COLLECTION);
+    u8(w, 0);
+    u8(w, 2); /* iFunction: product */
+
+    /* VideoControl */
+    interface_desc(w, UVC_VC_INTF, 0, 0, SC_VIDEOCONTROL, 2);
+    u8(w, 13);
+    u8(w, CS_INTERFACE);
+    u8(w, VC_HEADER);
+    u16(w, 0x0110);
+    u16(w, 13 + 18 + 9); /* header, camera terminal, output terminal */
+    u32(w, UVC_CLOCK_HZ);
+    u8(w, 1); /* bInCollection */
+    u8(w, UVC_VS_INTF);
+
+    u8(w, 18);
+    u8(w, CS_INTERFACE);
+    u8(w, VC_INPUT_TERMINAL);
+    u8(w, CAMERA_TERMINAL_ID);
+    u16(w, ITT_CAMERA);
+    u8(w, 0); /* bAssocTerminal */
+    u8(w, 0); /* iTerminal */
+    u16(w, 0); /* wObjectiveFocalLengthMin */
+    u16(w, 0); /* wObjectiveFocalLengthMax */
+    u16(w, 0); /* wOcularFocalLength */
+    u8(w, 3); /* bControlSize, no camera controls */
+    u8(w, 0);
+    u8(w, 0);
+    u8(w, 0);
+
+    u8(w, 9);
+    u8(w, CS_INTERFACE);
+    u8(w, VC_OUTPUT_TERMINAL);
+    u8(w, OUTPUT_TERMINAL_ID);
+    u16(w, TT_STREAMING);
+    u8(w, 0);
+    u8(w, CAMERA_TERMINAL_ID);
+    u8(w, 0);
+
+    /* VideoStreaming, alt 0 carries the formats */
+    interface_desc(w, UVC_VS_INTF, 0, 0, SC_VIDEOSTREAMING, 0);
+    uint32_t vs_start = w->len;
+    u8(w, 13 + cfg->nformats);
+    u8(w, CS_INTERFACE);
+    u8(w, VS_INPUT_HEADER);
+    u8(w, cfg->nformats);
+    u16(w, 0); /* wTotalLength, patched below */
+    u8(w, cfg->ep_addr);
+    u8(w, 0); /* bmInfo */
+    u8(w, OUTPUT_TERMINAL_ID);
+    u8(w, 0); /* bStillCaptureMethod */
+    u8(w, 0); /* bTriggerSupport */
+    u8(w, 0); /* bTriggerUsage */
+    u8(w, 1); /* bControlSize */
+    for (int i = 0; i < cfg->nformats; i++) {
+        u8(w, 0);
+    }
+    for (int i = 0; i < cfg->nformats; i++) {
+        format_desc(w, &cfg->format[i], i);
+    }
+    patch16(w, vs_start + 4, w->len - vs_start);
+
+    /* alt 1 streams */
+    interface_desc(w, UVC_VS_INTF, 1, 1, SC_VIDEOSTREAMING, 0);
+    u8(w, 7);
+    u8(w, DT_ENDPOINT);
+    u8(w, cfg->ep_addr);
+    u8(w, 0x05); /* isochronous, asynchronous */
+    u16(w, cfg->ep_size);
+    u8(w, 1); /* every microframe */
+
+    patch16(w, start + 2, w->len - start);
+}
+
+int uvc_desc_config(const uvc_dev_cfg_t *cfg, uint8_t *buf, uint32_t size)
+{
+    wr_t w = {.buf = buf, .size = size};
+    if (0 != uvc_cfg_check(cfg)) {
+        return -1;
+    }
+    config_desc(&w, cfg);
+    return w.len <= size ? (int)w.len : -1;
+}
+
+static void string_desc(wr_t *w, const char *s)
+{
+    uint32_t n = strlen(s);
+    if (n > 126) {
+        n = 126;
+    }
+    u8(w, 2 + 2 * n);
+    u8(w, DT_STRING);
+    for (uint32_t i = 0; i < n; i++) {
+        u16(w, (uint8_t)s[i]); /* ASCII to UTF-16LE */
+    }
+}
+
+int uvc_desc_build(const uvc_dev_cfg_t *cfg, uint8_t *buf, uint32_t size)
+{
+    wr_t w = {.buf = buf, .size = size};
+    if (0 != uvc_cfg_check(cfg)) {
+        return -1;
+    }
+
+    u8(&w, 18);
+    u8(&w, DT_DEVICE);
+    u16(&w, 0x0200);
+    u8(&w, 0xef); /* miscellaneous, interface association */
+    u8(&w, 0x02);
+    u8(&w, 0x01);
+    u8(&w, 64);
+    u16(&w, cfg->vid);
+    u16(&w, cfg->pid);
+    u16(&w, 0x0100);
+    u8(&w, 1);
+    u8(&w, 2);
+    u8(&w, 3);
+    u8(&w, 1);
+
+    config_desc(&w, cfg);
+
+    u8(&w, 4);
+    u8(&w, DT_STRING);
+    u16(&w, 0x0409);
+    string_desc(&w, cfg->manufacturer ? cfg->manufacturer : "");
+    string_desc(&w, cfg->product ? cfg->product : "");
+    string_desc(&w, cfg->serial ? cfg->serial : "");
+
+    u8(&w, 10);
+    u8(&w, DT_QUALIFIER);
+    u16(&w, 0x0200);
+    u8(&w, 0xef);
+    u8(&w, 0x02);
+    u8(&w, 0x01);
+    u8(&w, 64);
+    u8(&w, 1);
+    u8(&w, 0);
+
+    u8(&w, 0);
+    return w.len <= size ? (int)w.len : -1;
+}
@@ -0,0 +1,87 @@
+#ifndef __UVC_DESC_H__
+#define __UVC_DESC_H__
+
+#include <stdint.h>
+
+#include "uvc_cfg.h"
+
+/*
+ * USB Video Class 1.1 descriptors built at run time from a format table,
+ * so formats, frame sizes and intervals are data rather than a hand
+ * counted byte array:
+ *
+ *   IAD, VideoControl (camera terminal -> streaming output terminal),
+ *   VideoStreaming alt 0 with one format descriptor per format, its frame
+ *   descriptors and a color matching descriptor, alt 1 with the ISO endpoint.
+ *
+ * Interface 0 is VideoControl, interface 1 VideoStreaming. Pure code, no OS
+ * calls, tools/uvc_check.c runs it on the host.
+ */
+
+#define UVC_MAX_FORMATS (2)
+#define UVC_MAX_FRAMES (4)
+#define UVC_MAX_INTERVALS (4)
+
+/* the camera's MJPEG output, it can't be scaled on the way */
+#ifndef UVC_MJPEG_WIDTH
+#define UVC_MJPEG_WIDTH (1920)
+#define UVC_MJPEG_HEIGHT (1080)
+#endif
+#ifndef UVC_MJPEG_MAX_FRAME
+#define UVC_MJPEG_MAX_FRAME (512 * 1024)
+#endif
+
+#define UVC_VC_INTF (0)
+#define UVC_VS_INTF (1)
+#define UVC_CLOCK_HZ (48000000)
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint32_t max_frame_size;               /* bytes, w * h * 2 for YUY2 */
+    uint8_t nintervals;
+    uint32_t interval[UVC_MAX_INTERVALS];  /* 100 ns units, shortest first, [0] is the default */
+} uvc_frame_t;
+
+typedef struct {
+    uint8_t type; /* UVC_CFG_MJPEG or UVC_CFG_YUY2 */
+    uint8_t nframes;
+    uvc_frame_t frame[UVC_MAX_FRAMES];
+} uvc_format_t;
+
+typedef struct {
+    uint16_t vid;
+    uint16_t pid;
+    uint8_t ep_addr;  /* ISO IN endpoint, e.g. 0x81 */
+    uint16_t ep_size; /* wMaxPacketSize, one transaction per microframe */
+    const char *manufacturer;
+    const char *product;
+    const char *serial;
+    uint8_t nformats;
+    uvc_format_t format[UVC_MAX_FORMATS];
+} uvc_dev_cfg_t;
+
+/*
+ * The M1s table: MJPEG at the camera's size, YUY2 at its 400x300 RGB size
+ * and two scaled down sizes, 30/15/10/5 fps.
+ */
+void uvc_default_cfg(uvc_dev_cfg_t *cfg);
+
+/* Returns 0 if every index, count and interval is in range and ordered. */
+int uvc_cfg_check(const uvc_dev_cfg_t *cfg);
+
+/* Configuration descriptor with everything under it. Returns its length, or -1 if size is too small. */
+int uvc_desc_config(const uvc_dev_cfg_t *cfg, uint8_t *buf, uint32_t size);
+
+/*
+ * The whole table a USB device stack takes in one go: device, configuration,
+ * strings 0..3, device qualifier and a terminating zero byte. Returns its
+ * length, or -1.
+ */
+int uvc_desc_build(const uvc_dev_cfg_t *cfg, uint8_t *buf, uint32_t size);
+
+/* 1 based, as in the descriptors and in probe/commit; NULL if out of range */
+const uvc_format_t *uvc_cfg_format(const uvc_dev_cfg_t *cfg, uint8_t format_index);
+const uvc_frame_t *uvc_cfg_frame(const uvc_dev_cfg_t *cfg, uint8_t format_index, uint8_t frame_index);
+
+#endif /* __UVC_DESC_H__ */
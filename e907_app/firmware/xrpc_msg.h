@@ -0,0 +1,129 @@
+#ifndef __XRPC_MSG_H__
+#define __XRPC_MSG_H__
+
+#include <stdint.h>
+
+/*
+ * Wire format of batched cross-core calls. One request carries many
+ * operations, the reply carries one completion record per operation in the
+ * same order. Everything is little endian and 4 byte aligned.
+ *
+ *   request:  hdr | op | op | ...      op    = code, flags, payload_len, a0..a2, payload
+ *   reply:    hdr | rec | rec | ...    rec   = status, data_len, data
+ *
+ * Pure encode/decode, no OS calls. This file is shared as is between
+ * c906_app/cli_demo and e907_app/firmware, keep both copies identical.
+ */
+
+#define XRPC_REQ_MAGIC (0x43505258)  /* "XRPC" */
+#define XRPC_RESP_MAGIC (0x52505258) /* "XRPR" */
+#define XRPC_HDR_SIZE (16)
+#define XRPC_OP_HDR_SIZE (16)
+#define XRPC_REC_HDR_SIZE (8)
+#define XRPC_MAX_OPS (64)
+
+/* request flags */
+#define XRPC_F_NO_REPLY (1 << 0) /* fire and forget, no reply is written */
+
+typedef enum {
+    XRPC_OP_NOP = 0,
+    XRPC_OP_FLASH_READ,   /* a0 offset, a1 len; reply data */
+    XRPC_OP_FLASH_WRITE,  /* a0 offset, payload */
+    XRPC_OP_FLASH_ERASE,  /* a0 offset, a1 len */
+    XRPC_OP_PWM_SET_DUTY, /* a0 port << 8 | pin, a1 freq, a2 duty % */
+    XRPC_OP_MAX,
+} xrpc_op_code_t;
+
+typedef struct {
+    uint8_t code;
+    uint8_t flags;
+    uint16_t payload_len;
+    uint32_t a0, a1, a2;
+    const uint8_t *payload;
+} xrpc_op_t;
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t len;
+    uint32_t last; /* offset of the last record */
+    uint16_t count;
+} xrpc_writer_t;
+
+typedef struct {
+    const uint8_t *buf;
+    uint32_t len;
+    uint32_t pos;
+    uint32_t seq;
+    uint16_t count;
+    uint16_t flags;
+    uint16_t idx;
+} xrpc_reader_t;
+
+/* request */
+void xrpc_req_begin(xrpc_writer_t *w, uint8_t *buf, uint32_t size);
+/* Returns the op index, or -1 if the buffer or the op table is full. */
+int xrpc_req_add(xrpc_writer_t *w, const xrpc_op_t *op);
+/* Writes the header, returns the request length. */
+uint32_t xrpc_req_end(xrpc_writer_t *w, uint32_t seq, uint16_t flags);
+
+/* Returns 0 if the header is sane and every op fits in len. */
+int xrpc_req_parse(xrpc_reader_t *r, const uint8_t *buf, uint32_t len);
+/* Returns 1 with the next op, 0 after the last one. */
+int xrpc_req_next(xrpc_reader_t *r, xrpc_op_t *op);
+
+/* reply */
+void xrpc_resp_begin(xrpc_writer_t *w, uint8_t *buf, uint32_t size);
+/*
+ * Appends a record and returns where its data_len bytes go, or NULL if there
+ * is no room; the record is then stored with status -1 and no data.
+ */
+uint8_t *xrpc_resp_add(xrpc_writer_t *w, int32_t status, uint32_t data_len);
+/* Overwrites the status of the last record, for ops that fill their data in place. */
+void xrpc_resp_set_status(xrpc_writer_t *w, int32_t status);
+uint32_t xrpc_resp_end(xrpc_writer_t *w, uint32_t seq);
+
+int xrpc_resp_parse(xrpc_reader_t *r, const uint8_t *buf, uint32_t len);
+/* Returns 1 with the next record, 0 after the last one. */
+int xrpc_resp_next(xrpc_reader_t *r, int32_t *status, const uint8_t **data, uint32_t *data_len);
+
+/*
+ * Mailbox in memory shared by the C906 (client) and the E907 (server). As in
+ * frame_ring.h every cache line has a single writer: the request line and
+ * buffer belong to the client, the reply line and buffer to the server.
+ *
+ *   client  copy request to req_buf, clean, req.seq++    (the doorbell)
+ *   server  sees req.seq != resp.ack, runs every op, writes resp_buf, resp.ack = req.seq
+ *
+ * One batch is in flight at a time; the client waits for the ack before it
+ * reuses req_buf, and only reads resp_buf for batches that asked for a reply.
+ *
+ * The mailbox sits in C906 PSRAM, so the client writes first: it sets
+ * req.magic only once it has checked its heap is clear of the window, and
+ * the server refuses to start until it sees that magic.
+ */
+#ifndef XRPC_SHM_BASE
+#define XRPC_SHM_BASE (0x53fe0000) /* below the frame ring, in the window reserved as frame_ring.h describes */
+#endif
+#define XRPC_SHM_MAGIC (0x4d485358) /* "XSHM" */
+#define XRPC_LINE (64)
+#define XRPC_BUF_SIZE (4096)
+
+typedef struct {
+    struct {
+        volatile uint32_t magic;
+        volatile uint32_t seq; /* batches submitted */
+        volatile uint32_t len;
+        uint8_t pad[XRPC_LINE - 3 * sizeof(uint32_t)];
+    } req;
+    struct {
+        volatile uint32_t magic;
+        volatile uint32_t ack; /* batches done */
+        volatile uint32_t len;
+        uint8_t pad[XRPC_LINE - 3 * sizeof(uint32_t)];
+    } resp;
+    uint8_t req_buf[XRPC_BUF_SIZE];
+    uint8_t resp_buf[XRPC_BUF_SIZE];
+} xrpc_shm_t;
+
+#endif /* __XRPC_MSG_H__ */
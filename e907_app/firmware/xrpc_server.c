@@ -0,0 +1,219 @@
+#include <FreeRTOS.h>
+#include <aos/kernel.h>
+#include <bl_flash.h>
+#include <cli.h>
+#include <csi_core.h>
+#include <hosal_pwm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <task.h>
+
+#include "xrpc_msg.h"
+
+/* keep polling this long after the last batch before sleeping a tick */
+#define XRPC_SPIN_MS (2)
+
+#define ALIGNDOWN(x, r) ((x) & ~((r)-1))
+#define ALIGNUP(x, r) (((x) + ((r)-1)) & ~((r)-1))
+
+typedef struct {
+    uint32_t batches;
+    uint32_t ops;
+    uint32_t errors;
+    uint32_t bad;       /* requests that did not parse */
+    uint32_t max_batch;
+    uint32_t sleeps;
+} xrpc_stat_t;
+
+static xrpc_stat_t s_stat;
+static volatile int s_xrpc_running;
+
+static void clean_range(void *addr, uint32_t len)
+{
+    uintptr_t start = ALIGNDOWN((uintptr_t)addr, XRPC_LINE);
+    csi_dcache_clean_range((void *)start, ALIGNUP((uintptr_t)addr + len, XRPC_LINE) - start);
+}
+
+static void invalid_range(void *addr, uint32_t len)
+{
+    uintptr_t start = ALIGNDOWN((uintptr_t)addr, XRPC_LINE);
+    csi_dcache_invalid_range((void *)start, ALIGNUP((uintptr_t)addr + len, XRPC_LINE) - start);
+}
+
+static int pwm_set_duty(uint32_t port_pin, uint32_t freq, uint32_t duty)
+{
+    hosal_pwm_dev_t pwm = {
+        .port = port_pin >> 8,
+        .config = {.pin = port_pin & 0xff, .freq = freq, .duty_cycle = duty * 100},
+    };
+    return hosal_pwm_para_chg(&pwm, pwm.config);
+}
+
+/* runs one op, its record goes to w */
+static int32_t exec_op(const xrpc_op_t *op, xrpc_writer_t *w)
+{
+    uint8_t *data;
+    int32_t ret = 0;
+
+    switch (op->code) {
+        case XRPC_OP_NOP:
+            xrpc_resp_add(w, 0, 0);
+            break;
+        case XRPC_OP_FLASH_READ:
+            /* a1 is the client's word, never more than a reply holds */
+            if (op->a1 > XRPC_BUF_SIZE) {
+                xrpc_resp_add(w, -1, 0);
+                return -1;
+            }
+            /* straight into the reply buffer, no bounce */
+            if (NULL == (data = xrpc_resp_add(w, 0, op->a1))) {
+                return -1;
+            }
+            ret = bl_flash_read(op->a0, data, op->a1);
+            xrpc_resp_set_status(w, ret);
+            break;
+        case XRPC_OP_FLASH_WRITE:
+            ret = bl_flash_write(op->a0, (uint8_t *)op->payload, op->payload_len);
+            xrpc_resp_add(w, ret, 0);
+            break;
+        case XRPC_OP_FLASH_ERASE:
+            ret = bl_flash_erase(op->a0, op->a1);
+            xrpc_resp_add(w, ret, 0);
+            break;
+        case XRPC_OP_PWM_SET_DUTY:
+            ret = pwm_set_duty(op->a0, op->a1, op->a2);
+            xrpc_resp_add(w, ret, 0);
+            break;
+        default:
+            ret = -1;
+            xrpc_resp_add(w, ret, 0);
+            break;
+    }
+    return ret;
+}
+
+static void handle_batch(xrpc_shm_t *shm, uint32_t seq)
+{
+    uint32_t len = shm->req.len;
+    xrpc_reader_t r;
+    xrpc_writer_t w;
+    xrpc_op_t op;
+
+    if (len > XRPC_BUF_SIZE) {
+        len = XRPC_BUF_SIZE;
+    }
+    invalid_range(shm->req_buf, len);
+
+    xrpc_resp_begin(&w, shm->resp_buf, XRPC_BUF_SIZE);
+    if (0 != xrpc_req_parse(&r, shm->req_buf, len) || r.seq != seq) {
+        s_stat.bad++; /* empty reply, the client sees the count mismatch */
+    } else {
+        while (xrpc_req_next(&r, &op)) {
+            if (0 != exec_op(&op, &w)) {
+                s_stat.errors++;
+            }
+        }
+        s_stat.ops += r.count;
+        if (r.count > s_stat.max_batch) {
+            s_stat.max_batch = r.count;
+        }
+    }
+    s_stat.batches++;
+
+    if (!(r.flags & XRPC_F_NO_REPLY)) {
+        shm->resp.len = xrpc_resp_end(&w, seq);
+        clean_range(shm->resp_buf, shm->resp.len);
+    }
+    /* ack last, it tells the client both req_buf and resp_buf are done */
+    __atomic_store_n(&shm->resp.ack, seq, __ATOMIC_RELEASE);
+    clean_range(&shm->resp, sizeof(shm->resp));
+}
+
+/*
+ * Polls the doorbell: spins while batches keep coming, so back to back
+ * calls don't pay for a tick, then sleeps a tick at a time once idle.
+ */
+static void xrpc_task(void *pvParameters)
+{
+    xrpc_shm_t *shm = (xrpc_shm_t *)XRPC_SHM_BASE;
+    uint32_t last_ms;
+
+    invalid_range(&shm->req, sizeof(shm->req));
+    /* anything submitted before we came up is dropped, not replayed */
+    shm->resp.ack = shm->req.seq;
+    shm->resp.len = 0;
+    shm->resp.magic = XRPC_SHM_MAGIC;
+    clean_range(&shm->resp, sizeof(shm->resp));
+    printf("[xrpc] serving at %08lx\r\n", (unsigned long)XRPC_SHM_BASE);
+
+    last_ms = aos_now_ms();
+    while (s_xrpc_running) {
+        invalid_range(&shm->req, sizeof(shm->req));
+        uint32_t seq = __atomic_load_n(&shm->req.seq, __ATOMIC_ACQUIRE);
+        if (XRPC_SHM_MAGIC == shm->req.magic && seq != shm->resp.ack) {
+            handle_batch(shm, seq);
+            last_ms = aos_now_ms();
+        } else if (aos_now_ms() - last_ms > XRPC_SPIN_MS) {
+            s_stat.sleeps++;
+            vTaskDelay(1);
+        } else {
+            taskYIELD();
+        }
+    }
+
+    shm->resp.magic = 0;
+    clean_range(&shm->resp, sizeof(shm->resp));
+    printf("[xrpc] stopped\r\n");
+    vTaskDelete(NULL);
+}
+
+static void print_usage(void)
+{
+    printf("Usage: xrpc start (after xbench or flashbench on the c906)\r\n");
+    printf("       xrpc stat\r\n");
+    printf("       xrpc stop\r\n");
+}
+
+void cmd_xrpc(char *buf, int len, int argc, char **argv)
+{
+    if (argc < 2) {
+        print_usage();
+        return;
+    }
+
+    if (0 == strcmp(argv[1], "stop")) {
+        s_xrpc_running = 0;
+        return;
+    }
+    if (0 == strcmp(argv[1], "stat")) {
+        printf("[xrpc] %s, %lu batches, %lu ops (avg %lu, max %lu per batch), %lu errors, %lu bad, %lu sleeps\r\n",
+               s_xrpc_running ? "running" : "stopped", s_stat.batches, s_stat.ops,
+               s_stat.batches ? s_stat.ops / s_stat.batches : 0, s_stat.max_batch, s_stat.errors, s_stat.bad,
+               s_stat.sleeps);
+        return;
+    }
+    if (0 != strcmp(argv[1], "start")) {
+        print_usage();
+        return;
+    }
+
+    if (s_xrpc_running) {
+        printf("[xrpc] already running\r\n");
+        return;
+    }
+    /* the mailbox is c906 psram: only touch it once the c906 has shown it is not its heap */
+    xrpc_shm_t *shm = (xrpc_shm_t *)XRPC_SHM_BASE;
+    invalid_range(&shm->req, sizeof(shm->req));
+    if (XRPC_SHM_MAGIC != shm->req.magic) {
+        printf("[xrpc] no request line at %08lx, run xbench or flashbench on the c906 first\r\n",
+               (unsigned long)XRPC_SHM_BASE);
+        return;
+    }
+    memset(&s_stat, 0, sizeof(s_stat));
+    s_xrpc_running = 1;
+    if (pdPASS != xTaskCreate(xrpc_task, "xrpc", 1024, NULL, 10, NULL)) {
+        s_xrpc_running = 0;
+        printf("[xrpc] no memory for task\r\n");
+    }
+}
@@ -46,3 +46,6 @@ CONFIG_USB_HIGHSPEED_ENABLE:= 1
 #EXTRA_LDFLAGS += --specs=nano.specs
 CFLAGS += -DBFLB_USE_HAL_DRIVER -DCPU_M0 -DARCH_RISCV -DSYS_USER_VFS_ROMFS_ENABLE
 
+# `uvc start`, the multi-format camera of uvc_cam.c fed by c906_app/uvc_demo built with UVC_DEMO_FRING,
+# in place of the SDK's usb camera commands
+#CFLAGS += -DFEATURE_ENABLE_UVC_FRING